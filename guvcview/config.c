@@ -60,6 +60,7 @@ static config_t my_config =
 	.fps_denom = 30,
     .cmos_camera = 1, /*guvcview will use CMOS CAMERA on startup*/
 	.audio_device = -1,/*guvcview will use API default in this case*/
+	.video_buffer = 0, /*auto*/
 	.video_fx = 0, /*no video fx*/
 	.audio_fx = 0, /*no audio fx*/
 	.osd_mask = 0, /*REND_OSD_NONE*/
@@ -149,6 +150,8 @@ int config_save(const char *filename)
 	fprintf(fp, "cmos_camera=%i\n", my_config.cmos_camera);
 	fprintf(fp, "#audio device index (-1 - api default)\n");
 	fprintf(fp, "audio_device=%i\n", my_config.audio_device);
+	fprintf(fp, "#video encoder buffer budget in MB (0 - auto)\n");
+	fprintf(fp, "video_buffer=%i\n", my_config.video_buffer);
 	fprintf(fp, "#video fx mask \n");
 	fprintf(fp, "video_fx=0x%x\n", my_config.video_fx);
 	fprintf(fp, "#audio fx mask \n");
@@ -253,7 +256,7 @@ int config_load(const char *filename)
 		else if(strcmp(token, "format") == 0)
 			strncpy(my_config.format, value, 4);
 		else if(strcmp(token, "capture") == 0)
-			strncpy(my_config.capture, value, 4);
+			strncpy(my_config.capture, value, 7);
 		else if(strcmp(token, "audio") == 0)
 			strncpy(my_config.audio, value, 5);
 		else if(strcmp(token, "gui") == 0)
@@ -320,6 +323,8 @@ int config_load(const char *filename)
 			my_config.cmos_camera = (int) strtoul(value, NULL, 10);
 		else if(strcmp(token, "audio_device") == 0)
 			my_config.audio_device = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "video_buffer") == 0)
+			my_config.video_buffer = (int) strtoul(value, NULL, 10);
 		else if(strcmp(token, "video_fx") == 0)
 			my_config.video_fx = (uint32_t) strtoul(value, NULL, 16);
 		else if(strcmp(token, "audio_fx") == 0)
@@ -366,7 +371,7 @@ void config_update(options_t *my_options)
 
 	/*capture method*/
 	if(strlen(my_options->capture) > 3)
-		strncpy(my_config.capture, my_options->capture, 4);
+		strncpy(my_config.capture, my_options->capture, 7);
 
 	/*render API*/
 	if(strlen(my_options->render) > 2)
@@ -384,6 +389,10 @@ void config_update(options_t *my_options)
 	if(my_options->audio_device >= 0)
 		my_config.audio_device = my_options->audio_device;
 
+	/*video encoder buffer budget*/
+	if(my_options->video_buffer >= 0)
+		my_config.video_buffer = my_options->video_buffer;
+
 	/*input format*/
 	if(strlen(my_options->format) > 2)
 		strncpy(my_config.format, my_options->format, 5);
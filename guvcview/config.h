@@ -32,7 +32,7 @@ typedef struct _config_t
 	char render[5];  /*render api*/
 	char gui[5];     /*gui api*/
 	char audio[6];   /*audio api - none; port; pulse*/
-	char capture[5]; /*capture method: read or mmap*/
+	char capture[8]; /*capture method: read, mmap, userptr or dmabuf*/
 	char video_codec[5]; /*video codec*/
 	char audio_codec[5]; /*video codec*/
 	char *profile_path;
@@ -47,6 +47,7 @@ typedef struct _config_t
 	int fps_denom;
     int cmos_camera;    /* using CMOS camera */
 	int audio_device;/*audio device index*/
+	int video_buffer;/*video encoder buffer budget in MB (0 - auto)*/
 	uint32_t video_fx;
 	uint32_t audio_fx;
 	uint32_t osd_mask; /*OSD bit mask*/
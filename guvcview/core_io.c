@@ -32,6 +32,7 @@
 #include <unistd.h>
 
 #include "gviewv4l2core.h"
+#include "core_io.h"
 #include "../config.h"
 
 extern int debug_level;
@@ -444,10 +445,8 @@ unsigned long long get_file_suffix(const char *path, const char* filename)
 }
 
 /*
- * add a number suffix to filename (e.g. name.ext => name-suffix.ext)
- *   the suffix depends on the existing values in the path dir
+ * make the suffixed file name (e.g. name.ext => name-suffix.ext)
  * args:
- * 	  path - string with file path (to dir)
  *    filename - string with file basename (name.ext)
  *    suffix - suffix number
  *
@@ -456,11 +455,8 @@ unsigned long long get_file_suffix(const char *path, const char* filename)
  *
  * returns: newly allocated string with suffixed file name (must free)
  */
-char *add_file_suffix(const char *path, const char *filename)
+static char *suffixed_file_name(const char *filename, unsigned long long suffix)
 {
-	unsigned long long suffix = get_file_suffix(path, filename);
-	/*increment existing suffix*/
-	suffix++;
 	int size_suffix = get_uint64_num_chars(suffix);
 	int size_name = strlen(filename);
 
@@ -471,9 +467,6 @@ char *add_file_suffix(const char *path, const char *filename)
 	if(pname)
 		noextsize = pname - filename;
 
-	char *noextname = strndup(filename, noextsize);
-	char *extension = strdup(pname + 1);
-
 	/*add '-' suffix and '\0' and an extra char just for safety*/
 	char *new_name = calloc(size_name + size_suffix + 3, sizeof(char));
 	if(new_name == NULL)
@@ -481,14 +474,87 @@ char *add_file_suffix(const char *path, const char *filename)
 		fprintf(stderr,"GUVCVIEW: FATAL memory allocation failure (add_file_suffix): %s\n", strerror(errno));
 		exit(-1);
 	}
-	if(noextname && extension)
-	{
-		sprintf(new_name, "%s-%llu.%s", noextname, suffix, extension);
-		free(noextname);
-		free(extension);
-	}
+	if(pname)
+		sprintf(new_name, "%.*s-%llu.%s", noextsize, filename, suffix, pname + 1);
 	else
 		sprintf(new_name, "%s-%llu", filename, suffix);
 
 	return new_name;
 }
+
+/*
+ * add a number suffix to filename (e.g. name.ext => name-suffix.ext)
+ *   the suffix depends on the existing values in the path dir
+ * args:
+ * 	  path - string with file path (to dir)
+ *    filename - string with file basename (name.ext)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: newly allocated string with suffixed file name (must free)
+ */
+char *add_file_suffix(const char *path, const char *filename)
+{
+	unsigned long long suffix = get_file_suffix(path, filename);
+	/*increment existing suffix*/
+	suffix++;
+
+	return suffixed_file_name(filename, suffix);
+}
+
+/*
+ * add a number suffix to filename like add_file_suffix, but the path dir
+ *   is only scanned on the first call (or when path or filename change),
+ *   after that the suffix is incremented in memory
+ * args:
+ *    cache - pointer to suffix cache data (zero initialized)
+ * 	  path - string with file path (to dir)
+ *    filename - string with file basename (name.ext)
+ *
+ * asserts:
+ *    cache is not null
+ *
+ * returns: newly allocated string with suffixed file name (must free)
+ */
+char *add_file_suffix_cached(file_suffix_cache_t *cache, const char *path, const char *filename)
+{
+	/*asserts*/
+	assert(cache != NULL);
+
+	if(cache->path == NULL || cache->filename == NULL ||
+	   strcmp(cache->path, path) != 0 ||
+	   strcmp(cache->filename, filename) != 0)
+	{
+		clean_file_suffix_cache(cache);
+		cache->path = strdup(path);
+		cache->filename = strdup(filename);
+		cache->suffix = get_file_suffix(path, filename);
+	}
+
+	cache->suffix++;
+
+	return suffixed_file_name(filename, cache->suffix);
+}
+
+/*
+ * free the suffix cache strings (next call scans the path dir again)
+ * args:
+ *    cache - pointer to suffix cache data
+ *
+ * asserts:
+ *    cache is not null
+ *
+ * returns: none
+ */
+void clean_file_suffix_cache(file_suffix_cache_t *cache)
+{
+	/*asserts*/
+	assert(cache != NULL);
+
+	free(cache->path);
+	free(cache->filename);
+	cache->path = NULL;
+	cache->filename = NULL;
+	cache->suffix = 0;
+}
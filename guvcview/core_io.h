@@ -23,6 +23,17 @@
 #define CORE_IO_H
 
 #include <inttypes.h>
+
+/*
+ * file suffix cache (add_file_suffix_cached)
+ */
+typedef struct _file_suffix_cache_t
+{
+	char *path;               //scanned dir
+	char *filename;           //base file name
+	unsigned long long suffix; //last suffix used
+} file_suffix_cache_t;
+
 /*
  * converts string to lowercase
  * args:
@@ -164,4 +175,32 @@ unsigned long long get_file_suffix(const char *path, const char* filename);
  */
 char *add_file_suffix(const char *path, const char *filename);
 
+/*
+ * add a number suffix to filename like add_file_suffix, but the path dir
+ *   is only scanned on the first call (or when path or filename change),
+ *   after that the suffix is incremented in memory
+ * args:
+ *    cache - pointer to suffix cache data (zero initialized)
+ * 	  path - string with file path (to dir)
+ *    filename - string with file basename (name.ext)
+ *
+ * asserts:
+ *    cache is not null
+ *
+ * returns: newly allocated string with suffixed file name (must free)
+ */
+char *add_file_suffix_cached(file_suffix_cache_t *cache, const char *path, const char *filename);
+
+/*
+ * free the suffix cache strings (next call scans the path dir again)
+ * args:
+ *    cache - pointer to suffix cache data
+ *
+ * asserts:
+ *    cache is not null
+ *
+ * returns: none
+ */
+void clean_file_suffix_cache(file_suffix_cache_t *cache);
+
 #endif
\ No newline at end of file
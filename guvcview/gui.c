@@ -274,6 +274,32 @@ void gui_click_image_capture_button()
 	}
 }
 
+/*
+ * apply the control values changed by someone else
+ *  (in the thread that owns the controls) and update the widgets
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void gui_update_control_values()
+{
+	switch(gui_api)
+	{
+		case GUI_NONE:
+			v4l2core_update_control_values(get_v4l2_device_handler());
+			break;
+
+		case GUI_GTK3:
+		default:
+			gui_update_control_values_gtk3();
+			break;
+	}
+}
+
 /*
  * click video capture button
  * args:
@@ -840,9 +866,9 @@ void gui_error(
 }
 
 /*
- * adds a message to the status bar
+ * adds a message to the status bar (any thread)
  * args:
- *    message - message string
+ *    message - message string (copied: may be reused on return)
  *
  * asserts:
  *    none
@@ -394,6 +394,19 @@ void set_photo_path(const char *path);
  */
 void gui_click_image_capture_button();
 
+/*
+ * apply the control values changed by someone else
+ *  (in the thread that owns the controls) and update the widgets
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void gui_update_control_values();
+
 /*
  * click video capture button
  * args:
@@ -460,9 +473,9 @@ void gui_error(
 	int fatal);
 
 /*
- * adds a message to the status bar
+ * adds a message to the status bar (any thread)
  * args:
- *    message - message string
+ *    message - message string (copied: may be reused on return)
  *
  * asserts:
  *    none
@@ -71,11 +71,11 @@ static int gtk_devices_timer_id = 0;
 /*
  * sets the status message
  * args:
- *   message - message string
+ *   message - message string (copy from gui_status_message_gtk3 - freed)
  * 
  * returns: FALSE
  */
-static gboolean set_status_message(const char *message)
+static gboolean set_status_message(char *message)
 {
 	if(status_bar)
 	{
@@ -83,6 +83,8 @@ static gboolean set_status_message(const char *message)
 		gtk_statusbar_push (GTK_STATUSBAR(status_bar), status_warning_id, message);
 	}
 	
+	g_free(message);
+
 	/*execute only once*/
 	return FALSE;
 }
@@ -99,8 +101,11 @@ static gboolean set_status_message(const char *message)
  */
 void gui_status_message_gtk3(const char *message)
 {
-	/*this maybe called from a different thread, so protect it*/
-	gdk_threads_add_idle ((GSourceFunc)set_status_message, (gpointer) message);
+	/*
+	 * this maybe called from a different thread, so protect it
+	 * (the caller's buffer may change before the idle callback runs)
+	 */
+	gdk_threads_add_idle ((GSourceFunc)set_status_message, (gpointer) g_strdup(message));
 }
 
 /*
@@ -729,7 +734,7 @@ int gui_attach_gtk3(int width, int height)
 	gtk_notebook_append_page(GTK_NOTEBOOK(tab_box), scroll_1, tab_1);
 
 	/*----------------------------H264 Controls Tab --------------------------*/
-	if(v4l2core_get_h264_unit_id() > 0)
+	if(v4l2core_get_h264_unit_id(get_v4l2_device_handler()) > 0)
 	{
 		GtkWidget *scroll_2 = gtk_scrolled_window_new(NULL,NULL);
 		gtk_scrolled_window_set_placement(GTK_SCROLLED_WINDOW(scroll_2), GTK_CORNER_TOP_LEFT);
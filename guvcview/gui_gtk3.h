@@ -252,6 +252,19 @@ control_widgets_t *gui_gtk3_get_widgets_by_id(int id);
  */
 void gui_gtk3_update_controls_state();
 
+/*
+ * apply the control values changed by someone else and update
+ *  the controls widgets (can be called from any thread)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void gui_update_control_values_gtk3();
+
 /*
  * clean gtk3 control widgets list
  * args:
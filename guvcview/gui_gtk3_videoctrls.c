@@ -64,7 +64,7 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 	if(debug_level > 1)
 		printf("GUVCVIEW: attaching video controls\n");
 
-	int format_index = v4l2core_get_frame_format_index(v4l2core_get_requested_frame_format());
+	int format_index = v4l2core_get_frame_format_index(get_v4l2_device_handler(), v4l2core_get_requested_frame_format(get_v4l2_device_handler()));
 
 	if(format_index < 0)
 	{
@@ -72,10 +72,10 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 		printf("GUVCVIEW: invalid pixel format\n");
 	}
 
-	int resolu_index = v4l2core_get_format_resolution_index(
+	int resolu_index = v4l2core_get_format_resolution_index(get_v4l2_device_handler(), 
 		format_index,
-		v4l2core_get_frame_width(),
-		v4l2core_get_frame_height());
+		v4l2core_get_frame_width(get_v4l2_device_handler()),
+		v4l2core_get_frame_height(get_v4l2_device_handler()));
 
 	if(resolu_index < 0)
 	{
@@ -121,7 +121,7 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 	{
 		/*use current*/
 		gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(get_wgtDevices_gtk3()),
-			v4l2core_get_videodevice());
+			v4l2core_get_videodevice(get_v4l2_device_handler()));
 		gtk_combo_box_set_active(GTK_COMBO_BOX(get_wgtDevices_gtk3()),0);
 	}
 	else
@@ -162,7 +162,7 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 
 	int deffps=0;
 
-	v4l2_stream_formats_t *list_stream_formats = v4l2core_get_formats_list();
+	v4l2_stream_formats_t *list_stream_formats = v4l2core_get_formats_list(get_v4l2_device_handler());
 	
 	if (debug_level > 0)
 		printf("GUVCVIEW: frame rates of resolution index %d = %d \n",
@@ -179,8 +179,8 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 
 		gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(wgtFrameRate), temp_str);
 
-		if (( v4l2core_get_fps_num() == list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_num[i]) &&
-			( v4l2core_get_fps_denom() == list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_denom[i]))
+		if (( v4l2core_get_fps_num(get_v4l2_device_handler()) == list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_num[i]) &&
+			( v4l2core_get_fps_denom(get_v4l2_device_handler()) == list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_denom[i]))
 				deffps=i;//set selected
 	}
 
@@ -191,17 +191,17 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 	if (deffps==0)
 	{
 		if (list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_denom)
-			v4l2core_define_fps(-1, list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_denom[0]);
+			v4l2core_define_fps(get_v4l2_device_handler(), -1, list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_denom[0]);
 
 		if (list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_num)
-			v4l2core_define_fps(list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_num[0], -1);
+			v4l2core_define_fps(get_v4l2_device_handler(), list_stream_formats[format_index].list_stream_cap[resolu_index].framerate_num[0], -1);
 	}
 
 	g_signal_connect (GTK_COMBO_BOX_TEXT(wgtFrameRate), "changed",
 		G_CALLBACK (frame_rate_changed), NULL);
 
 	/*try to sync the device fps (capture thread must have started by now)*/
-	v4l2core_request_framerate_update ();
+	v4l2core_request_framerate_update(get_v4l2_device_handler());
 
 	/*---- Resolution ----*/
 	line++;
@@ -242,8 +242,8 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 
 			gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(wgtResolution), temp_str);
 
-			if ((v4l2core_get_frame_width() == list_stream_formats[format_index].list_stream_cap[i].width) &&
-				(v4l2core_get_frame_height() == list_stream_formats[format_index].list_stream_cap[i].height))
+			if ((v4l2core_get_frame_width(get_v4l2_device_handler()) == list_stream_formats[format_index].list_stream_cap[i].width) &&
+				(v4l2core_get_frame_height(get_v4l2_device_handler()) == list_stream_formats[format_index].list_stream_cap[i].height))
 					defres=i;//set selected resolution index
 		}
 	}
@@ -281,10 +281,10 @@ int gui_attach_gtk3_videoctrls(GtkWidget *parent)
 	gtk_widget_set_sensitive (wgtInpType, TRUE);
 
 	int fmtind=0;
-	for (fmtind=0; fmtind < v4l2core_get_number_formats(); fmtind++)
+	for (fmtind=0; fmtind < v4l2core_get_number_formats(get_v4l2_device_handler()); fmtind++)
 	{
 		gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(wgtInpType), list_stream_formats[fmtind].fourcc);
-		if(v4l2core_get_requested_frame_format() == list_stream_formats[fmtind].format)
+		if(v4l2core_get_requested_frame_format(get_v4l2_device_handler()) == list_stream_formats[fmtind].format)
 			gtk_combo_box_set_active(GTK_COMBO_BOX(wgtInpType), fmtind); /*set active*/
 	}
 
@@ -177,10 +177,27 @@ int main(int argc, char *argv[])
 	
 	if(my_options->disable_libv4l2)
 		v4l2core_disable_libv4l2();
+
+	/*frame queue and decoder workers (pipelined decoding)*/
+	if(my_options->frame_queue > 0)
+		v4l2core_set_frame_queue_size(my_options->frame_queue);
+	else if(my_options->decoder_threads > 0)
+		v4l2core_set_frame_queue_size(my_options->decoder_threads * 2);
+	v4l2core_set_decoder_threads(my_options->decoder_threads);
+
+	/*h264 decoder threads (libav)*/
+	int h264_thread_type = H264_THREAD_AUTO;
+	if(strcasecmp(my_options->h264_thread_mode, "frame") == 0)
+		h264_thread_type = H264_THREAD_FRAME;
+	else if(strcasecmp(my_options->h264_thread_mode, "slice") == 0)
+		h264_thread_type = H264_THREAD_SLICE;
+	v4l2core_set_h264_decoder_threading(my_options->h264_threads, h264_thread_type);
+
 	/*init the device list*/
 	v4l2core_init_device_list();
 	/*init the v4l2core (redefines language catalog)*/
-	if(v4l2core_init_dev(my_options->device) < 0)
+	v4l2_dev_t *vd = create_v4l2_device_handler(my_options->device);
+	if(!vd)
 	{
 		char message[50];
 		snprintf(message, 49, "no video device (%s) found", my_options->device);
@@ -195,15 +212,33 @@ int main(int argc, char *argv[])
 
 	/*select capture method*/
 	if(strcasecmp(my_config->capture, "read") == 0)
-		v4l2core_set_capture_method(IO_READ);
+		v4l2core_set_capture_method(vd, IO_READ);
+	else if(strcasecmp(my_config->capture, "userptr") == 0)
+		v4l2core_set_capture_method(vd, IO_USERPTR);
+	else if(strcasecmp(my_config->capture, "dmabuf") == 0)
+		v4l2core_set_capture_method(vd, IO_DMABUF);
 	else
-		v4l2core_set_capture_method(IO_MMAP);
+		v4l2core_set_capture_method(vd, IO_MMAP);
+
+	/*frame timestamps (driver clock and/or jitter filter)*/
+	if(strcasecmp(my_options->timestamps, "driver") == 0)
+		v4l2core_set_timestamp_mode(vd, TS_MODE_DRIVER);
+	else if(strcasecmp(my_options->timestamps, "smooth") == 0)
+		v4l2core_set_timestamp_mode(vd, TS_MODE_SMOOTH);
+	else if(strcasecmp(my_options->timestamps, "driver+smooth") == 0)
+		v4l2core_set_timestamp_mode(vd, TS_MODE_DRIVER | TS_MODE_SMOOTH);
+	else
+		v4l2core_set_timestamp_mode(vd, TS_MODE_SYSTEM);
+
+	/*dump the raw stream (can be replayed with -d replay:FILE)*/
+	if(my_options->raw_dump != NULL)
+		v4l2core_set_raw_dump(vd, my_options->raw_dump);
 
 	/*set software autofocus sort method*/
 	v4l2core_soft_autofocus_set_sort(AUTOF_SORT_INSERT);
 
 	/*set the intended fps*/
-	v4l2core_define_fps(my_config->fps_num,my_config->fps_denom);
+	v4l2core_define_fps(vd, my_config->fps_num,my_config->fps_denom);
 
 	/*set fx masks*/
 	set_render_fx_mask(my_config->video_fx);
@@ -248,7 +283,7 @@ int main(int argc, char *argv[])
 
 	/*check if need to load a profile*/
 	if(my_options->prof_filename)
-		v4l2core_load_control_profile(my_options->prof_filename);
+		v4l2core_load_control_profile(vd, my_options->prof_filename);
 
 	/*set the profile file*/
 	if(!my_config->profile_name)
@@ -286,6 +321,17 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "GUVCVIEW: couldn't get a valid audio context for the selected api - disabling audio\n");
 	
 	encoder_set_verbosity(debug_level);
+	encoder_set_video_buffer_budget((size_t) my_config->video_buffer * 1024 * 1024);
+
+	int encoder_thread_type = ENCODER_THREAD_AUTO;
+	if(strcasecmp(my_options->encoder_thread_mode, "frame") == 0)
+		encoder_thread_type = ENCODER_THREAD_FRAME;
+	else if(strcasecmp(my_options->encoder_thread_mode, "slice") == 0)
+		encoder_thread_type = ENCODER_THREAD_SLICE;
+	encoder_set_video_threading(
+		my_options->encoder_threads,
+		encoder_thread_type,
+		my_options->encoder_lookahead);
 	/*init the encoder*/
 	encoder_init();
 
@@ -303,20 +349,20 @@ int main(int argc, char *argv[])
                 if(debug_level > 0)
 		printf("GUVCVIEW: setting pixelformat to '%s'\n", my_options->format);
 
-		v4l2core_prepare_new_format(format);
+		v4l2core_prepare_new_format(vd, format);
 		/*prepare resolution*/
-		v4l2core_prepare_new_resolution(my_config->width, my_config->height);
+		v4l2core_prepare_new_resolution(vd, my_config->width, my_config->height);
 		/*try to set the video stream format on the device*/
-		int ret = v4l2core_update_current_format();
+		int ret = v4l2core_update_current_format(vd);
 
 		if(ret != E_OK)
 		{
 			fprintf(stderr, "GUCVIEW: could not set the defined stream format\n");
 			fprintf(stderr, "GUCVIEW: trying first listed stream format\n");
 
-			v4l2core_prepare_valid_format();
-			v4l2core_prepare_valid_resolution();
-			ret = v4l2core_update_current_format();
+			v4l2core_prepare_valid_format(vd);
+			v4l2core_prepare_valid_resolution(vd);
+			ret = v4l2core_update_current_format(vd);
 
 			if(ret != E_OK)
 			{
@@ -332,6 +378,7 @@ int main(int argc, char *argv[])
 			capture_loop_data_t cl_data;
 			cl_data.options = (void *) my_options;
 			cl_data.config = (void *) my_config;
+			cl_data.device = (void *) vd;
 
 			ret = __THREAD_CREATE(&capture_thread, capture_loop, (void *) &cl_data);
 
@@ -357,7 +404,7 @@ int main(int argc, char *argv[])
 	/*closes the audio context (stored staticly in video_capture)*/
 	close_audio_context();
 
-	v4l2core_close_dev();
+	close_v4l2_device_handler();
 
 	v4l2core_close_v4l2_device_list();
 
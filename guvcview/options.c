@@ -76,14 +76,42 @@ static opt_values_t opt_values[] =
 		.opt_long = "device",
 		.req_arg = 1,
 		.opt_help_arg = N_("DEVICE"),
-		.opt_help = N_("Set device name (def: /dev/video0)"),
+		.opt_help = N_("Set device name (def: /dev/video0), replay:FILE or pattern[:WxH]"),
+	},
+	{
+		.opt_short = 'D',
+		.opt_long = "raw_dump",
+		.req_arg = 1,
+		.opt_help_arg = N_("FILENAME"),
+		.opt_help = N_("Dump the raw video stream (replay with -d replay:FILENAME)"),
+	},
+	{
+		.opt_short = 'S',
+		.opt_long = "stats",
+		.req_arg = 1,
+		.opt_help_arg = N_("FILENAME"),
+		.opt_help = N_("Save pipeline latency stats as json (- for stdout)"),
+	},
+	{
+		.opt_short = 'I',
+		.opt_long = "stats_interval",
+		.req_arg = 1,
+		.opt_help_arg = N_("TIME_IN_SEC"),
+		.opt_help = N_("Pipeline stats dump interval (def: 0 - only on exit)"),
+	},
+	{
+		.opt_short = 'P',
+		.opt_long = "timestamps",
+		.req_arg = 1,
+		.opt_help_arg = N_("MODE"),
+		.opt_help = N_("Frame timestamps [system (def) | driver | smooth | driver+smooth]"),
 	},
 	{
 		.opt_short = 'c',
 		.opt_long = "capture",
 		.req_arg = 1,
 		.opt_help_arg = N_("METHOD"),
-		.opt_help = N_("Set capture method [read | mmap (def)]"),
+		.opt_help = N_("Set capture method [read | mmap (def) | userptr | dmabuf]"),
 	},
 	{
 		.opt_short = 'b',
@@ -92,6 +120,69 @@ static opt_values_t opt_values[] =
 		.opt_help_arg = "",
 		.opt_help = N_("disable calls to libv4l2"),
 	},
+	{
+		.opt_short = 'e',
+		.opt_long = "decoder_threads",
+		.req_arg = 1,
+		.opt_help_arg = N_("THREADS"),
+		.opt_help = N_("Number of frame decoder threads (def: 0 - decode in capture thread)"),
+	},
+	{
+		.opt_short = 'l',
+		.opt_long = "frame_queue",
+		.req_arg = 1,
+		.opt_help_arg = N_("SIZE"),
+		.opt_help = N_("Frame queue size (def: 1 or 2 x decoder threads)"),
+	},
+	{
+		.opt_short = 's',
+		.opt_long = "video_buffer",
+		.req_arg = 1,
+		.opt_help_arg = N_("MBYTES"),
+		.opt_help = N_("Video encoder buffer memory budget in MB (def: 0 - auto)"),
+	},
+	{
+		.opt_short = 'H',
+		.opt_long = "h264_threads",
+		.req_arg = 1,
+		.opt_help_arg = N_("THREADS"),
+		.opt_help = N_("Number of H264 decoder threads (def: 0 - codec default)"),
+	},
+	{
+		.opt_short = 'G',
+		.opt_long = "h264_thread_mode",
+		.req_arg = 1,
+		.opt_help_arg = N_("MODE"),
+		.opt_help = N_("H264 decoder threading mode [auto (def) | frame | slice]"),
+	},
+	{
+		.opt_short = 'T',
+		.opt_long = "encoder_threads",
+		.req_arg = 1,
+		.opt_help_arg = N_("THREADS"),
+		.opt_help = N_("Number of video encoder threads (def: 0 - codec default or number of cores)"),
+	},
+	{
+		.opt_short = 'M',
+		.opt_long = "encoder_thread_mode",
+		.req_arg = 1,
+		.opt_help_arg = N_("MODE"),
+		.opt_help = N_("Video encoder threading mode [auto (def) | frame | slice]"),
+	},
+	{
+		.opt_short = 'A',
+		.opt_long = "encoder_lookahead",
+		.req_arg = 1,
+		.opt_help_arg = N_("FRAMES"),
+		.opt_help = N_("Video encoder rate control lookahead - libx264 (def: -1 - codec default)"),
+	},
+	{
+		.opt_short = 'J',
+		.opt_long = "mjpg_encoder",
+		.req_arg = 1,
+		.opt_help_arg = N_("ENCODER"),
+		.opt_help = N_("MJPG video encoder [libav (def) | builtin]"),
+	},
 	{
 		.opt_short = 'x',
 		.opt_long = "resolution",
@@ -197,6 +288,48 @@ static opt_values_t opt_values[] =
 		.opt_help_arg = N_("TOTAL"),
 		.opt_help = N_("total number of captured photos)")
 	},
+	{
+		.opt_short = 'B',
+		.opt_long = "photo_burst",
+		.req_arg = 1,
+		.opt_help_arg = N_("FRAMES"),
+		.opt_help = N_("Consecutive frames saved for each photo (def: 1)"),
+	},
+	{
+		.opt_short = 'L',
+		.opt_long = "timelapse",
+		.req_arg = 1,
+		.opt_help_arg = N_("TIME_IN_SEC"),
+		.opt_help = N_("Time-lapse video: add a frame every TIME_IN_SEC (def: 0 - off)"),
+	},
+	{
+		.opt_short = 'W',
+		.opt_long = "image_workers",
+		.req_arg = 1,
+		.opt_help_arg = N_("THREADS"),
+		.opt_help = N_("Number of image save threads (def: 1, 0 - save in capture thread)"),
+	},
+	{
+		.opt_short = 'Q',
+		.opt_long = "image_queue",
+		.req_arg = 1,
+		.opt_help_arg = N_("SIZE"),
+		.opt_help = N_("Max images waiting to be saved (def: 0 - 2 x image workers)"),
+	},
+	{
+		.opt_short = 'K',
+		.opt_long = "image_queue_policy",
+		.req_arg = 1,
+		.opt_help_arg = N_("POLICY"),
+		.opt_help = N_("Full image queue policy [block (def) | drop (oldest) | skip (newest)]"),
+	},
+	{
+		.opt_short = 'E',
+		.opt_long = "exit_on_term",
+		.req_arg = 0,
+		.opt_help_arg = "",
+		.opt_help = N_("Exit when the video or photo timer ends")
+	},
 	{
 		.opt_short = 'z',
 		.opt_long = "control_panel",
@@ -221,15 +354,28 @@ static options_t my_options =
 	.height = 480,
 	.control_panel = 0,
 	.disable_libv4l2 = 0,
+	.decoder_threads = 0,
+	.frame_queue = 0, /*auto*/
 	.format = "YU12",
 	.render = "sdl",
 	.gui = "gtk3",
 	.audio = "",
 	.audio_device = -1, /*use default*/
+	.video_buffer = -1, /*use config*/
+	.h264_threads = 0, /*codec default*/
+	.h264_thread_mode = "auto",
+	.encoder_threads = 0, /*codec default*/
+	.encoder_thread_mode = "auto",
+	.encoder_lookahead = -1, /*codec default*/
+	.mjpg_encoder = "libav",
     .cmos_camera = 1,   /* use CMOS CAMERA - default */
 	.capture = "mmap",
+	.timestamps = "system",
 	.video_codec = "dx50",
 	.audio_codec = "mp2",
+	.raw_dump = NULL,
+	.stats_file = NULL,
+	.stats_interval = 0,
 	.prof_filename = NULL,
 	.profile_name = NULL,
 	.profile_path = NULL,
@@ -240,6 +386,12 @@ static options_t my_options =
 	.video_timer = 0,
 	.photo_timer = 0,
 	.photo_npics = 0,
+	.photo_burst = 1,
+	.timelapse = 0,
+	.image_workers = 1,
+	.image_queue = 0, /*auto*/
+	.image_queue_policy = "block",
+	.exit_on_term = 0,
 	.render_flag = "none",
 };
 
@@ -454,21 +606,49 @@ int options_parse(int argc, char *argv[])
 			{
 				int str_size = strlen(optarg);
 				if(str_size > 1) /*device needs at least 2 chars*/
-					strncpy(my_options.device, optarg, 29);
+					strncpy(my_options.device, optarg, 255);
 				else
 					fprintf(stderr, "V4L2_CORE: (options) Error in device usage: -d[--device] DEVICENAME \n");
 				break;
 			}
+			case 'D':
+			{
+				if(my_options.raw_dump != NULL)
+					free(my_options.raw_dump);
+				my_options.raw_dump = strdup(optarg);
+				break;
+			}
+			case 'S':
+			{
+				if(my_options.stats_file != NULL)
+					free(my_options.stats_file);
+				my_options.stats_file = strdup(optarg);
+				break;
+			}
+			case 'I':
+				my_options.stats_interval = strtod(optarg, (char **)NULL);
+				if(my_options.stats_interval < 0)
+					my_options.stats_interval = 0;
+				break;
 			case 'z':
 			{
 				my_options.control_panel = 1;
 				break;
 			}
+			case 'P':
+			{
+				int str_size = strlen(optarg);
+				if(str_size >= 6 && str_size < 14) /*timestamp mode*/
+					strncpy(my_options.timestamps, optarg, 13);
+				else
+					fprintf(stderr, "GUVCVIEW: (options) Error in timestamps usage: -P[--timestamps] MODE \n");
+				break;
+			}
 			case 'c':
 			{
 				int str_size = strlen(optarg);
-				if(str_size == 4) /*capture method*/
-					strncpy(my_options.capture, optarg, 4);
+				if(str_size >= 4 && str_size < 8) /*capture method*/
+					strncpy(my_options.capture, optarg, 7);
 				break;
 			}
 			case 'b':
@@ -476,6 +656,57 @@ int options_parse(int argc, char *argv[])
 				my_options.disable_libv4l2 = 1;
 				break;
 			}
+			case 'e':
+				my_options.decoder_threads = atoi(optarg);
+				if(my_options.decoder_threads < 0)
+					my_options.decoder_threads = 0;
+				break;
+			case 'l':
+				my_options.frame_queue = atoi(optarg);
+				if(my_options.frame_queue < 0)
+					my_options.frame_queue = 0;
+				break;
+			case 's':
+				my_options.video_buffer = atoi(optarg);
+				if(my_options.video_buffer < 0)
+					my_options.video_buffer = 0;
+				break;
+			case 'H':
+				my_options.h264_threads = atoi(optarg);
+				if(my_options.h264_threads < 0)
+					my_options.h264_threads = 0;
+				break;
+			case 'G':
+			{
+				int str_size = strlen(optarg);
+				if(str_size > 3 && str_size < 6) /*threading mode*/
+					strncpy(my_options.h264_thread_mode, optarg, 5);
+				break;
+			}
+			case 'T':
+				my_options.encoder_threads = atoi(optarg);
+				if(my_options.encoder_threads < 0)
+					my_options.encoder_threads = 0;
+				break;
+			case 'M':
+			{
+				int str_size = strlen(optarg);
+				if(str_size > 3 && str_size < 6) /*threading mode*/
+					strncpy(my_options.encoder_thread_mode, optarg, 5);
+				break;
+			}
+			case 'A':
+				my_options.encoder_lookahead = atoi(optarg);
+				if(my_options.encoder_lookahead < -1)
+					my_options.encoder_lookahead = -1;
+				break;
+			case 'J':
+			{
+				int str_size = strlen(optarg);
+				if(str_size > 4 && str_size < 8) /*mjpg encoder*/
+					strncpy(my_options.mjpg_encoder, optarg, 7);
+				break;
+			}
 			case 'x':
 				my_options.width = (int) strtoul(optarg, &stopstring, 10);
 				if( *stopstring != 'x')
@@ -623,6 +854,38 @@ int options_parse(int argc, char *argv[])
 			case 't':
 				my_options.photo_timer = strtod(optarg, (char **)NULL);
 				break;
+			case 'E':
+				my_options.exit_on_term = 1;
+				break;
+			case 'B':
+				my_options.photo_burst = atoi(optarg);
+				if(my_options.photo_burst < 1)
+					my_options.photo_burst = 1;
+				break;
+			case 'L':
+				my_options.timelapse = strtod(optarg, (char **)NULL);
+				if(my_options.timelapse < 0)
+					my_options.timelapse = 0;
+				break;
+			case 'W':
+				my_options.image_workers = atoi(optarg);
+				if(my_options.image_workers < 0)
+					my_options.image_workers = 0;
+				break;
+			case 'Q':
+				my_options.image_queue = atoi(optarg);
+				if(my_options.image_queue < 0)
+					my_options.image_queue = 0;
+				break;
+			case 'K':
+			{
+				int str_size = strlen(optarg);
+				if(str_size >= 4 && str_size < 6) /*block, drop or skip*/
+					strncpy(my_options.image_queue_policy, optarg, 5);
+				else
+					fprintf(stderr, "GUVCVIEW: (options) Error in image queue policy usage: -K[--image_queue_policy] POLICY \n");
+				break;
+			}
 			case 'n':
 				my_options.photo_npics = atoi(optarg);
 				break;
@@ -649,6 +912,14 @@ int options_parse(int argc, char *argv[])
  */
 void options_clean()
 {
+	if(my_options.raw_dump != NULL)
+		free(my_options.raw_dump);
+	my_options.raw_dump = NULL;
+
+	if(my_options.stats_file != NULL)
+		free(my_options.stats_file);
+	my_options.stats_file = NULL;
+
 	if(my_options.prof_filename != NULL)
 		free(my_options.prof_filename);
 	my_options.prof_filename = NULL;
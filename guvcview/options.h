@@ -25,20 +25,33 @@
 typedef struct _options_t
 {
 	int  verbosity;  /*verbosity level*/
-	char device[30]; /*device name*/
+	char device[256]; /*device name (or frame source)*/
     int  cmos_camera; /* CMOS camera */
 	int  width;      /*width*/
 	int  height;     /*height*/
 	int  control_panel; /*flag control panel mode*/
 	int  disable_libv4l2; /*set to 1 to disbale libv4l2 calls*/
+	int  decoder_threads; /*number of frame decoder threads (0 - decode in capture thread)*/
+	int  frame_queue; /*frame queue size (0 - auto)*/
+	int  video_buffer; /*video encoder buffer budget in MB (0 - auto, -1 - use config)*/
+	int  h264_threads; /*h264 decoder threads (0 - codec default)*/
+	char h264_thread_mode[6]; /*h264 decoder threading: auto, frame or slice*/
+	int  encoder_threads; /*video encoder threads (0 - codec default)*/
+	char encoder_thread_mode[6]; /*video encoder threading: auto, frame or slice*/
+	int  encoder_lookahead; /*video encoder rc lookahead (-1 - codec default)*/
+	char mjpg_encoder[8]; /*mjpg video encoder: libav or builtin*/
 	char format[5];  /*pixelformat fourcc*/
 	char render[5];  /*render api*/
 	char gui[5];     /*gui api*/
 	char audio[6];   /*audio api - none; port; pulse*/
 	int audio_device; /*audio device index 0..N (-1 = default)*/
-	char capture[5]; /*capture method: read or mmap*/
+	char capture[8]; /*capture method: read, mmap, userptr or dmabuf*/
+	char timestamps[14]; /*frame timestamps: system, driver, smooth or driver+smooth*/
 	char audio_codec[5]; /*audio codec*/
 	char video_codec[5]; /*video codec*/
+	char *raw_dump;  /*raw video stream dump file name*/
+	char *stats_file; /*pipeline stats json file name ("-" for stdout)*/
+	double stats_interval; /*pipeline stats dump interval in seconds (0 - only on exit)*/
 	char *prof_filename; /*profile_filename (if set load it on start)*/
 	char *profile_name;
 	char *profile_path;
@@ -49,6 +62,12 @@ typedef struct _options_t
 	double video_timer; /*video capture time in seconds (double)*/
 	double photo_timer; /*photo capture timer interval in seconds (double)*/
 	int photo_npics; /*number of photo captures*/
+	int photo_burst; /*consecutive frames saved for each photo*/
+	double timelapse; /*time-lapse video frame interval in seconds (0 - off)*/
+	int image_workers; /*image save threads (0 - save in the capture thread)*/
+	int image_queue; /*max images waiting to be saved (0 - 2 x image_workers)*/
+	char image_queue_policy[6]; /*full image queue policy: block, drop or skip*/
+	int exit_on_term; /*exit when the timed captures are done*/
 	char render_flag[5]; /*render window flag => default (none) | FULLSCREEN (full) | MAXIMIZED (max)*/
 } options_t;
 
@@ -0,0 +1,660 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gviewv4l2core.h"
+#include "gview.h"
+#include "pipeline_stats.h"
+
+/*flags*/
+extern int debug_level;
+
+/*
+ * log-linear histogram of microsecond values:
+ *   values under 16 us get a bucket each, then every power of two
+ *   is split in 8 sub buckets (12.5% resolution, up to ~4 hours)
+ */
+#define HIST_LINEAR (16)
+#define HIST_SUB_BITS (3)
+#define HIST_BUCKETS (256)
+
+typedef struct _stats_hist_t
+{
+	uint64_t count;
+	uint64_t sum;   /*nanosec*/
+	uint64_t max;   /*nanosec*/
+	uint64_t bucket[HIST_BUCKETS];
+} stats_hist_t;
+
+static const char *hist_names[STATS_NUM_HISTOGRAMS] =
+{
+	"dqbuf_to_decode",
+	"decode",
+	"decode_to_render",
+	"render",
+	"capture_to_render",
+	"capture_to_enqueue",
+	"enqueue_to_encode",
+	"encode",
+	"capture_to_encoded",
+	"capture_to_mux",
+	"frame_interval",
+	"save_image"
+};
+
+static const char *counter_names[STATS_NUM_COUNTERS] =
+{
+	"frames_captured",
+	"frames_rendered",
+	"frames_enqueued",
+	"encoder_frames_dropped",
+	"frames_encoded",
+	"packets_muxed",
+	"audio_buffers_dropped",
+	"capture_frames_dropped",
+	"images_dropped",
+	"audio_overflows",
+	"audio_underflows",
+	"io_flushes",
+	"io_stall_us",
+	"io_stall_max_us"
+};
+
+static stats_hist_t histograms[STATS_NUM_HISTOGRAMS];
+static uint64_t counters[STATS_NUM_COUNTERS];
+
+/*run description (json "info" object)*/
+#define STATS_MAX_INFO (16)
+static char *info_key[STATS_MAX_INFO];
+static char *info_value[STATS_MAX_INFO];
+static int info_count = 0;
+
+/*
+ * frame timestamp -> dequeue time of the frames in the encoder
+ *  (the encoder only keeps the frame timestamp, that may be a driver
+ *  or smoothed time, or a time-lapse time): more entries than the
+ *  encoder ring buffer (1.5 s of frames) holds
+ */
+#define STATS_FRAME_MAP (256)
+typedef struct _stats_frame_t
+{
+	uint64_t frame_ts;   /*0 - free or being written*/
+	uint64_t dequeue_ts;
+} stats_frame_t;
+
+static stats_frame_t frame_map[STATS_FRAME_MAP];
+static unsigned int frame_map_next = 0; /*capture thread only*/
+
+static int enabled = 0;
+static char *stats_filename = NULL;
+static uint64_t dump_interval = 0; /*nanosec*/
+static uint64_t start_time = 0;
+static uint64_t last_dump_time = 0;
+
+/*
+ * get the histogram bucket for a value
+ * args:
+ *   us - value in microsec
+ *
+ * asserts:
+ *   none
+ *
+ * returns: bucket index
+ */
+static int hist_bucket(uint64_t us)
+{
+	if(us < HIST_LINEAR)
+		return (int) us;
+
+	int e = 63 - __builtin_clzll(us); /*>= 4*/
+	int b = HIST_LINEAR + ((e - 4) << HIST_SUB_BITS) +
+		(int) ((us >> (e - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1));
+
+	return (b < HIST_BUCKETS) ? b : HIST_BUCKETS - 1;
+}
+
+/*
+ * get the lowest value of a histogram bucket
+ * args:
+ *   b - bucket index
+ *
+ * asserts:
+ *   none
+ *
+ * returns: bucket lower bound (microsec)
+ */
+static uint64_t hist_bucket_low(int b)
+{
+	if(b < HIST_LINEAR)
+		return (uint64_t) b;
+
+	int e = 4 + ((b - HIST_LINEAR) >> HIST_SUB_BITS);
+	uint64_t sub = (uint64_t) ((b - HIST_LINEAR) & ((1 << HIST_SUB_BITS) - 1));
+
+	return ((1ULL << HIST_SUB_BITS) + sub) << (e - HIST_SUB_BITS);
+}
+
+/*
+ * get a percentile from a histogram snapshot
+ * args:
+ *   bucket - bucket counts
+ *   total - sum of bucket counts
+ *   max - maximum recorded value (microsec)
+ *   p - percentile [0.0 - 1.0]
+ *
+ * asserts:
+ *   none
+ *
+ * returns: percentile value (bucket midpoint in microsec)
+ */
+static double hist_percentile(const uint64_t *bucket, uint64_t total, double max, double p)
+{
+	if(total == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t) (p * (double) total + 0.5);
+	if(rank < 1)
+		rank = 1;
+
+	uint64_t acc = 0;
+	int b = 0;
+	for(b = 0; b < HIST_BUCKETS; ++b)
+	{
+		acc += bucket[b];
+		if(acc >= rank)
+			break;
+	}
+	if(b >= HIST_BUCKETS)
+		b = HIST_BUCKETS - 1;
+
+	double low = (double) hist_bucket_low(b);
+	double high = (b < HIST_BUCKETS - 1) ? (double) hist_bucket_low(b + 1) : low;
+	double value = (low + high) / 2;
+
+	return (value > max) ? max : value;
+}
+
+/*
+ * clean the run description entries
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void clean_info()
+{
+	int i = 0;
+	for(i = 0; i < info_count; ++i)
+	{
+		free(info_key[i]);
+		free(info_value[i]);
+		info_key[i] = NULL;
+		info_value[i] = NULL;
+	}
+	info_count = 0;
+}
+
+/*
+ * print a json string (quoted and escaped)
+ * args:
+ *   fp - output file
+ *   str - string to print
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void json_print_string(FILE *fp, const char *str)
+{
+	fputc('"', fp);
+	for(; *str; ++str)
+	{
+		if(*str == '"' || *str == '\\')
+			fprintf(fp, "\\%c", *str);
+		else if((unsigned char) *str < 0x20)
+			fprintf(fp, "\\u%04x", (unsigned char) *str);
+		else
+			fputc(*str, fp);
+	}
+	fputc('"', fp);
+}
+
+/*
+ * start collecting pipeline statistics
+ *  (recording is a no-op until this is called)
+ * args:
+ *   filename - json output file ("-" for stdout)
+ *   interval - dump interval in seconds (<= 0 - dump only on stop)
+ *
+ * asserts:
+ *   filename is not null
+ *
+ * returns: none
+ */
+void pipeline_stats_start(const char *filename, double interval)
+{
+	/*assertions*/
+	assert(filename != NULL);
+
+	__atomic_store_n(&enabled, 0, __ATOMIC_RELEASE);
+
+	memset(histograms, 0, sizeof(histograms));
+	memset(counters, 0, sizeof(counters));
+	memset(frame_map, 0, sizeof(frame_map));
+	frame_map_next = 0;
+	clean_info();
+
+	if(stats_filename != NULL)
+		free(stats_filename);
+	stats_filename = strdup(filename);
+	if(stats_filename == NULL)
+	{
+		fprintf(stderr, "GUVCVIEW: FATAL memory allocation failure (pipeline_stats_start): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	dump_interval = (interval > 0) ? (uint64_t) (interval * NSEC_PER_SEC) : 0;
+	start_time = v4l2core_time_get_timestamp();
+	last_dump_time = start_time;
+
+	__atomic_store_n(&enabled, 1, __ATOMIC_RELEASE);
+
+	if(debug_level > 0)
+	{
+		if(dump_interval > 0)
+			printf("GUVCVIEW: pipeline stats enabled (%s every %.1f s)\n", stats_filename, interval);
+		else
+			printf("GUVCVIEW: pipeline stats enabled (%s on exit)\n", stats_filename);
+	}
+}
+
+/*
+ * dump the final statistics and stop collecting
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_stop()
+{
+	if(!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+		return;
+
+	__atomic_store_n(&enabled, 0, __ATOMIC_RELEASE);
+
+	if(pipeline_stats_dump(stats_filename) == 0 && debug_level > 0)
+		printf("GUVCVIEW: pipeline stats saved to %s\n", stats_filename);
+
+	free(stats_filename);
+	stats_filename = NULL;
+
+	clean_info();
+}
+
+/*
+ * check if statistics are being collected
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if enabled, 0 otherwise
+ */
+int pipeline_stats_enabled()
+{
+	return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+/*
+ * set a run description entry (e.g. device, resolution, codec)
+ *  added to the json "info" object so results can be compared
+ * args:
+ *   key - entry name
+ *   value - entry value (replaces any previous value)
+ *
+ * asserts:
+ *   key is not null
+ *   value is not null
+ *
+ * returns: none
+ */
+void pipeline_stats_set_info(const char *key, const char *value)
+{
+	/*assertions*/
+	assert(key != NULL);
+	assert(value != NULL);
+
+	if(!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+		return;
+
+	int i = 0;
+	for(i = 0; i < info_count; ++i)
+		if(strcmp(info_key[i], key) == 0)
+			break;
+
+	if(i >= STATS_MAX_INFO)
+	{
+		fprintf(stderr, "GUVCVIEW: pipeline stats info is full (%s not added)\n", key);
+		return;
+	}
+
+	if(i == info_count)
+	{
+		info_key[i] = strdup(key);
+		info_value[i] = NULL;
+		info_count++;
+	}
+	free(info_value[i]);
+	info_value[i] = strdup(value);
+
+	if(info_key[i] == NULL || info_value[i] == NULL)
+	{
+		fprintf(stderr, "GUVCVIEW: FATAL memory allocation failure (pipeline_stats_set_info): %s\n", strerror(errno));
+		exit(-1);
+	}
+}
+
+/*
+ * record a stage interval (lock-free, any thread)
+ * args:
+ *   hist - histogram index (STATS_DQBUF_TO_DECODE, ...)
+ *   start - interval start (monotonic nanosec - 0 if unknown)
+ *   end - interval end (monotonic nanosec - 0 if unknown)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_record(int hist, uint64_t start, uint64_t end)
+{
+	if(!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+		return;
+
+	if(hist < 0 || hist >= STATS_NUM_HISTOGRAMS || start == 0 || end < start)
+		return;
+
+	stats_hist_t *h = &histograms[hist];
+	uint64_t ns = end - start;
+
+	__atomic_add_fetch(&h->bucket[hist_bucket(ns / 1000)], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->sum, ns, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+
+	uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+	while(ns > max &&
+		!__atomic_compare_exchange_n(&h->max, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/*
+ * remember the dequeue time of a frame added to the encoder
+ *  (lock-free, capture thread only)
+ * args:
+ *   frame_ts - frame timestamp given to the encoder
+ *   dequeue_ts - frame dequeue time (v4l2_frame_buff_t dequeue_ts)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_map_frame(uint64_t frame_ts, uint64_t dequeue_ts)
+{
+	if(!__atomic_load_n(&enabled, __ATOMIC_RELAXED) || frame_ts == 0)
+		return;
+
+	stats_frame_t *entry = &frame_map[frame_map_next % STATS_FRAME_MAP];
+	frame_map_next++;
+
+	/*readers skip the entry while it is being written*/
+	__atomic_store_n(&entry->frame_ts, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&entry->dequeue_ts, dequeue_ts, __ATOMIC_RELEASE);
+	__atomic_store_n(&entry->frame_ts, frame_ts, __ATOMIC_RELEASE);
+}
+
+/*
+ * get the dequeue time of a frame in the encoder (lock-free, any thread)
+ * args:
+ *   frame_ts - frame timestamp given to the encoder
+ *
+ * asserts:
+ *   none
+ *
+ * returns: dequeue time (0 - unknown)
+ */
+uint64_t pipeline_stats_dequeue_ts(uint64_t frame_ts)
+{
+	if(!__atomic_load_n(&enabled, __ATOMIC_RELAXED) || frame_ts == 0)
+		return 0;
+
+	int i = 0;
+	for(i = 0; i < STATS_FRAME_MAP; i++)
+	{
+		if(__atomic_load_n(&frame_map[i].frame_ts, __ATOMIC_ACQUIRE) != frame_ts)
+			continue;
+
+		uint64_t dequeue_ts = __atomic_load_n(&frame_map[i].dequeue_ts, __ATOMIC_ACQUIRE);
+		/*not rewritten in between*/
+		if(__atomic_load_n(&frame_map[i].frame_ts, __ATOMIC_ACQUIRE) == frame_ts)
+			return dequeue_ts;
+	}
+
+	return 0;
+}
+
+/*
+ * increment an event counter (lock-free, any thread)
+ * args:
+ *   counter - counter index (STATS_FRAMES_CAPTURED, ...)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_count(int counter)
+{
+	if(!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+		return;
+
+	if(counter >= 0 && counter < STATS_NUM_COUNTERS)
+		__atomic_add_fetch(&counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * set an event counter that is kept elsewhere (e.g. audio drops)
+ * args:
+ *   counter - counter index (STATS_FRAMES_CAPTURED, ...)
+ *   value - counter value
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_set_count(int counter, uint64_t value)
+{
+	if(!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+		return;
+
+	if(counter >= 0 && counter < STATS_NUM_COUNTERS)
+		__atomic_store_n(&counters[counter], value, __ATOMIC_RELAXED);
+}
+
+/*
+ * dump the statistics if the dump interval has elapsed
+ *  (call it regularly, e.g. once per frame)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_update()
+{
+	if(!__atomic_load_n(&enabled, __ATOMIC_RELAXED) || dump_interval == 0)
+		return;
+
+	uint64_t now = v4l2core_time_get_timestamp();
+	if(now - last_dump_time < dump_interval)
+		return;
+
+	last_dump_time = now;
+	pipeline_stats_dump(stats_filename);
+}
+
+/*
+ * dump the current statistics as json
+ * args:
+ *   filename - output file ("-" for stdout)
+ *
+ * asserts:
+ *   filename is not null
+ *
+ * returns: error code (0 - OK)
+ */
+int pipeline_stats_dump(const char *filename)
+{
+	/*assertions*/
+	assert(filename != NULL);
+
+	int to_stdout = (strcmp(filename, "-") == 0);
+	char *tmp_filename = NULL;
+	FILE *fp = stdout;
+
+	if(!to_stdout)
+	{
+		/*write a temporary file and rename it (readers never see a partial dump)*/
+		tmp_filename = calloc(strlen(filename) + 5, sizeof(char));
+		if(tmp_filename == NULL)
+		{
+			fprintf(stderr, "GUVCVIEW: FATAL memory allocation failure (pipeline_stats_dump): %s\n", strerror(errno));
+			exit(-1);
+		}
+		sprintf(tmp_filename, "%s.tmp", filename);
+
+		fp = fopen(tmp_filename, "w");
+		if(fp == NULL)
+		{
+			fprintf(stderr, "GUVCVIEW: couldn't open %s for write: %s\n", tmp_filename, strerror(errno));
+			free(tmp_filename);
+			return -1;
+		}
+	}
+
+	double elapsed = (double) (v4l2core_time_get_timestamp() - start_time) / NSEC_PER_SEC;
+
+	uint64_t count[STATS_NUM_COUNTERS];
+	int i = 0;
+	for(i = 0; i < STATS_NUM_COUNTERS; ++i)
+		count[i] = __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"info\": {");
+	for(i = 0; i < info_count; ++i)
+	{
+		fprintf(fp, "%s\n    ", (i > 0) ? "," : "");
+		json_print_string(fp, info_key[i]);
+		fprintf(fp, ": ");
+		json_print_string(fp, info_value[i]);
+	}
+	fprintf(fp, "%s},\n", (info_count > 0) ? "\n  " : "");
+
+	fprintf(fp, "  \"elapsed_s\": %.3f,\n", elapsed);
+
+	fprintf(fp, "  \"counters\": {\n");
+	for(i = 0; i < STATS_NUM_COUNTERS; ++i)
+		fprintf(fp, "    \"%s\": %" PRIu64 "%s\n", counter_names[i], count[i],
+			(i < STATS_NUM_COUNTERS - 1) ? "," : "");
+	fprintf(fp, "  },\n");
+
+	fprintf(fp, "  \"throughput_fps\": {\n");
+	fprintf(fp, "    \"captured\": %.2f,\n", elapsed > 0 ? count[STATS_FRAMES_CAPTURED] / elapsed : 0);
+	fprintf(fp, "    \"rendered\": %.2f,\n", elapsed > 0 ? count[STATS_FRAMES_RENDERED] / elapsed : 0);
+	fprintf(fp, "    \"encoded\": %.2f\n", elapsed > 0 ? count[STATS_FRAMES_ENCODED] / elapsed : 0);
+	fprintf(fp, "  },\n");
+
+	fprintf(fp, "  \"latency_us\": {\n");
+	for(i = 0; i < STATS_NUM_HISTOGRAMS; ++i)
+	{
+		stats_hist_t *h = &histograms[i];
+
+		/*snapshot (the counts may move while we read them)*/
+		uint64_t bucket[HIST_BUCKETS];
+		uint64_t total = 0;
+		int b = 0;
+		for(b = 0; b < HIST_BUCKETS; ++b)
+		{
+			bucket[b] = __atomic_load_n(&h->bucket[b], __ATOMIC_RELAXED);
+			total += bucket[b];
+		}
+		uint64_t sum = __atomic_load_n(&h->sum, __ATOMIC_RELAXED);
+		uint64_t hcount = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+		double max = (double) __atomic_load_n(&h->max, __ATOMIC_RELAXED) / 1000;
+
+		fprintf(fp, "    \"%s\": { \"count\": %" PRIu64 ", \"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f }%s\n",
+			hist_names[i],
+			hcount,
+			hcount > 0 ? (double) sum / (double) (hcount * 1000) : 0,
+			hist_percentile(bucket, total, max, 0.50),
+			hist_percentile(bucket, total, max, 0.99),
+			max,
+			(i < STATS_NUM_HISTOGRAMS - 1) ? "," : "");
+	}
+	fprintf(fp, "  }\n");
+	fprintf(fp, "}\n");
+
+	if(to_stdout)
+	{
+		fflush(fp);
+		return 0;
+	}
+
+	int ret = 0;
+	if(fclose(fp) != 0)
+	{
+		fprintf(stderr, "GUVCVIEW: error writing %s: %s\n", tmp_filename, strerror(errno));
+		ret = -1;
+	}
+	else if(rename(tmp_filename, filename) != 0)
+	{
+		fprintf(stderr, "GUVCVIEW: couldn't rename %s to %s: %s\n", tmp_filename, filename, strerror(errno));
+		ret = -1;
+	}
+
+	free(tmp_filename);
+	return ret;
+}
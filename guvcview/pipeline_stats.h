@@ -0,0 +1,202 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <inttypes.h>
+
+/*latency histograms (pipeline stage intervals)*/
+#define STATS_DQBUF_TO_DECODE     (0)  /*frame dequeued -> decode start*/
+#define STATS_DECODE              (1)  /*decode start -> decode end*/
+#define STATS_DECODE_TO_RENDER    (2)  /*decode end -> render start*/
+#define STATS_RENDER              (3)  /*render start -> render end*/
+#define STATS_CAPTURE_TO_RENDER   (4)  /*frame dequeued -> render end*/
+#define STATS_CAPTURE_TO_ENQUEUE  (5)  /*frame dequeued -> added to the encoder*/
+#define STATS_ENQUEUE_TO_ENCODE   (6)  /*added to the encoder -> encode start*/
+#define STATS_ENCODE              (7)  /*encode start -> encode end*/
+#define STATS_CAPTURE_TO_ENCODED  (8)  /*frame dequeued -> encode end*/
+#define STATS_CAPTURE_TO_MUX      (9)  /*frame dequeued -> packet muxed*/
+#define STATS_FRAME_INTERVAL      (10) /*time between dequeued frames*/
+#define STATS_SAVE_IMAGE          (11) /*image (photo) save or queue (snapshot workers) in the capture thread*/
+#define STATS_NUM_HISTOGRAMS      (12)
+
+/*event counters*/
+#define STATS_FRAMES_CAPTURED     (0)
+#define STATS_FRAMES_RENDERED     (1)
+#define STATS_FRAMES_ENQUEUED     (2)
+#define STATS_ENCODER_DROPPED     (3)  /*encoder ring buffer full (or over budget)*/
+#define STATS_FRAMES_ENCODED      (4)
+#define STATS_PACKETS_MUXED       (5)
+#define STATS_AUDIO_DROPPED       (6)  /*audio ring buffer full (set from the audio context)*/
+#define STATS_CAPTURE_DROPPED     (7)  /*frames dropped by the driver (sequence gaps)*/
+#define STATS_IMAGES_DROPPED      (8)  /*snapshots dropped (image save queue full)*/
+#define STATS_AUDIO_OVERFLOWS     (9)  /*audio device input overflows (set from the audio context)*/
+#define STATS_AUDIO_UNDERFLOWS    (10) /*audio device input underflows (set from the audio context)*/
+#define STATS_IO_FLUSHES          (11) /*muxer file buffer flushes (set from the encoder)*/
+#define STATS_IO_STALL_US         (12) /*total time the muxer blocked on flushes (us)*/
+#define STATS_IO_STALL_MAX_US     (13) /*maximum time the muxer blocked on a flush (us)*/
+#define STATS_NUM_COUNTERS        (14)
+
+/*
+ * start collecting pipeline statistics
+ *  (recording is a no-op until this is called)
+ * args:
+ *   filename - json output file ("-" for stdout)
+ *   interval - dump interval in seconds (<= 0 - dump only on stop)
+ *
+ * asserts:
+ *   filename is not null
+ *
+ * returns: none
+ */
+void pipeline_stats_start(const char *filename, double interval);
+
+/*
+ * dump the final statistics and stop collecting
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_stop();
+
+/*
+ * check if statistics are being collected
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if enabled, 0 otherwise
+ */
+int pipeline_stats_enabled();
+
+/*
+ * set a run description entry (e.g. device, resolution, codec)
+ *  added to the json "info" object so results can be compared
+ * args:
+ *   key - entry name
+ *   value - entry value (replaces any previous value)
+ *
+ * asserts:
+ *   key is not null
+ *   value is not null
+ *
+ * returns: none
+ */
+void pipeline_stats_set_info(const char *key, const char *value);
+
+/*
+ * record a stage interval (lock-free, any thread)
+ * args:
+ *   hist - histogram index (STATS_DQBUF_TO_DECODE, ...)
+ *   start - interval start (monotonic nanosec - 0 if unknown)
+ *   end - interval end (monotonic nanosec - 0 if unknown)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_record(int hist, uint64_t start, uint64_t end);
+
+/*
+ * remember the dequeue time of a frame added to the encoder
+ *  (lock-free, capture thread only)
+ * args:
+ *   frame_ts - frame timestamp given to the encoder
+ *   dequeue_ts - frame dequeue time (v4l2_frame_buff_t dequeue_ts)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_map_frame(uint64_t frame_ts, uint64_t dequeue_ts);
+
+/*
+ * get the dequeue time of a frame in the encoder (lock-free, any thread)
+ * args:
+ *   frame_ts - frame timestamp given to the encoder
+ *
+ * asserts:
+ *   none
+ *
+ * returns: dequeue time (0 - unknown)
+ */
+uint64_t pipeline_stats_dequeue_ts(uint64_t frame_ts);
+
+/*
+ * increment an event counter (lock-free, any thread)
+ * args:
+ *   counter - counter index (STATS_FRAMES_CAPTURED, ...)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_count(int counter);
+
+/*
+ * set an event counter that is kept elsewhere (e.g. audio drops)
+ * args:
+ *   counter - counter index (STATS_FRAMES_CAPTURED, ...)
+ *   value - counter value
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_set_count(int counter, uint64_t value);
+
+/*
+ * dump the statistics if the dump interval has elapsed
+ *  (call it regularly, e.g. once per frame)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void pipeline_stats_update();
+
+/*
+ * dump the current statistics as json
+ * args:
+ *   filename - output file ("-" for stdout)
+ *
+ * asserts:
+ *   filename is not null
+ *
+ * returns: error code (0 - OK)
+ */
+int pipeline_stats_dump(const char *filename);
+
+#endif
@@ -43,6 +43,7 @@
 #include "config.h"
 #include "core_io.h"
 #include "gui.h"
+#include "pipeline_stats.h"
 #include "../config.h"
 
 /*flags*/
@@ -74,12 +75,17 @@ static int do_soft_focus = 0;
 /*pointer to audio context data*/
 static audio_context_t *my_audio_ctx = NULL;
 
+/*pointer to v4l2 device data*/
+static v4l2_dev_t *my_vd = NULL;
+
 static __THREAD_TYPE encoder_thread;
 
 static int my_encoder_status = 0;
 
 static char status_message[80];
 
+static file_suffix_cache_t photo_suffix_cache; /*photo suffix numbering*/
+
 /*
  * set render flag
  * args:
@@ -336,7 +342,7 @@ int check_video_timer()
  */
 void set_soft_focus(int value)
 {
-	v4l2core_soft_autofocus_set_focus();
+	v4l2core_soft_autofocus_set_focus(my_vd);
 
 	do_soft_focus = value;
 }
@@ -355,6 +361,73 @@ void request_format_update()
 	restart = 1;
 }
 
+/*
+ * get the file name for the next photo
+ *  (the suffix is only scanned from the photo dir on the first photo)
+ * args:
+ *    force_suffix - add a number suffix even if the suffix flag is off
+ *
+ * asserts:
+ *    none
+ *
+ * returns: newly allocated string with the photo file name (must free)
+ */
+static char *get_next_photo_filename(int force_suffix)
+{
+	char *img_filename = NULL;
+
+	/*get_photo_[name|path] always return a non NULL value*/
+	char *name = strdup(get_photo_name());
+	char *path = strdup(get_photo_path());
+
+	if(get_photo_sufix_flag() || force_suffix)
+	{
+		char *new_name = add_file_suffix_cached(&photo_suffix_cache, path, name);
+		free(name); /*free old name*/
+		name = new_name; /*replace with suffixed name*/
+	}
+	int pathsize = strlen(path);
+	if(path[pathsize] != '/')
+		img_filename = smart_cat(path, '/', name);
+	else
+		img_filename = smart_cat(path, 0, name);
+
+	free(path);
+	free(name);
+
+	return img_filename;
+}
+
+/*
+ * snapshot done callback (called from the snapshot workers)
+ * args:
+ *    filename - image file name
+ *    error - save error code (E_NO_DATA - dropped)
+ *    data - pointer to user data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void snapshot_done(const char *filename, int error, void *data)
+{
+	/*one message per call: workers may finish at the same time*/
+	char message[80];
+
+	if(error == E_OK)
+		snprintf(message, 79, _("saved image to %s"), filename);
+	else if(error == E_NO_DATA)
+	{
+		snprintf(message, 79, _("image %s dropped (save queue full)"), filename);
+		pipeline_stats_count(STATS_IMAGES_DROPPED);
+	}
+	else
+		snprintf(message, 79, _("couldn't save image to %s"), filename);
+
+	gui_status_message(message);
+}
+
 /*
  * quit callback
  * args:
@@ -429,18 +502,18 @@ int key_V_callback(void *data)
  */
 int key_DOWN_callback(void *data)
 {
-	if(v4l2core_has_pantilt_id())
+	if(v4l2core_has_pantilt_id(my_vd))
     {
 		int id = V4L2_CID_TILT_RELATIVE;
-		int value = v4l2core_get_tilt_step();
+		int value = v4l2core_get_tilt_step(my_vd);
 
-		v4l2_ctrl_t *control = v4l2core_get_control_by_id(id);
+		v4l2_ctrl_t *control = v4l2core_get_control_by_id(my_vd, id);
 
 		if(control)
 		{
 			control->value =  value;
 
-			if(v4l2core_set_control_value_by_id(id))
+			if(v4l2core_set_control_value_by_id(my_vd, id))
 				fprintf(stderr, "GUVCVIEW: error setting pan/tilt value\n");
 
 			return 0;
@@ -462,18 +535,18 @@ int key_DOWN_callback(void *data)
  */
 int key_UP_callback(void *data)
 {
-	if(v4l2core_has_pantilt_id())
+	if(v4l2core_has_pantilt_id(my_vd))
     {
 		int id = V4L2_CID_TILT_RELATIVE;
-		int value = - v4l2core_get_tilt_step();
+		int value = - v4l2core_get_tilt_step(my_vd);
 
-		v4l2_ctrl_t *control = v4l2core_get_control_by_id(id);
+		v4l2_ctrl_t *control = v4l2core_get_control_by_id(my_vd, id);
 
 		if(control)
 		{
 			control->value =  value;
 
-			if(v4l2core_set_control_value_by_id(id))
+			if(v4l2core_set_control_value_by_id(my_vd, id))
 				fprintf(stderr, "GUVCVIEW: error setting pan/tilt value\n");
 
 			return 0;
@@ -495,18 +568,18 @@ int key_UP_callback(void *data)
  */
 int key_LEFT_callback(void *data)
 {
-	if(v4l2core_has_pantilt_id())
+	if(v4l2core_has_pantilt_id(my_vd))
     {
 		int id = V4L2_CID_PAN_RELATIVE;
-		int value = v4l2core_get_pan_step();
+		int value = v4l2core_get_pan_step(my_vd);
 
-		v4l2_ctrl_t *control = v4l2core_get_control_by_id(id);
+		v4l2_ctrl_t *control = v4l2core_get_control_by_id(my_vd, id);
 
 		if(control)
 		{
 			control->value =  value;
 
-			if(v4l2core_set_control_value_by_id(id))
+			if(v4l2core_set_control_value_by_id(my_vd, id))
 				fprintf(stderr, "GUVCVIEW: error setting pan/tilt value\n");
 
 			return 0;
@@ -528,18 +601,18 @@ int key_LEFT_callback(void *data)
  */
 int key_RIGHT_callback(void *data)
 {
-	if(v4l2core_has_pantilt_id())
+	if(v4l2core_has_pantilt_id(my_vd))
     {
 		int id = V4L2_CID_PAN_RELATIVE;
-		int value = - v4l2core_get_pan_step();
+		int value = - v4l2core_get_pan_step(my_vd);
 
-		v4l2_ctrl_t *control = v4l2core_get_control_by_id(id);
+		v4l2_ctrl_t *control = v4l2core_get_control_by_id(my_vd, id);
 
 		if(control)
 		{
 			control->value =  value;
 
-			if(v4l2core_set_control_value_by_id(id))
+			if(v4l2core_set_control_value_by_id(my_vd, id))
 				fprintf(stderr, "GUVCVIEW: error setting pan/tilt value\n");
 
 			return 0;
@@ -613,6 +686,101 @@ void close_audio_context()
 	my_audio_ctx = NULL;
 }
 
+/*
+ * copy the audio capture fifo counters into the pipeline stats
+ * args:
+ *    audio_ctx - pointer to audio context
+ *
+ * asserts:
+ *    audio_ctx is not null
+ *
+ * returns: none
+ */
+static void audio_stats_update(audio_context_t *audio_ctx)
+{
+	pipeline_stats_set_count(STATS_AUDIO_DROPPED,
+		__atomic_load_n(&audio_ctx->dropped_buffers, __ATOMIC_RELAXED));
+	pipeline_stats_set_count(STATS_AUDIO_OVERFLOWS,
+		__atomic_load_n(&audio_ctx->overflows, __ATOMIC_RELAXED));
+	pipeline_stats_set_count(STATS_AUDIO_UNDERFLOWS,
+		__atomic_load_n(&audio_ctx->underflows, __ATOMIC_RELAXED));
+}
+
+/*
+ * copy the muxer file writer flush statistics into the pipeline stats
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void io_stats_update()
+{
+	encoder_io_stats_t io_stats;
+	encoder_get_io_stats(&io_stats);
+
+	pipeline_stats_set_count(STATS_IO_FLUSHES, io_stats.flush_count);
+	pipeline_stats_set_count(STATS_IO_STALL_US, io_stats.stall_time / 1000);
+	pipeline_stats_set_count(STATS_IO_STALL_MAX_US, io_stats.stall_time_max / 1000);
+}
+
+/*
+ * create a v4l2 device handler
+ *  the library supports any number of devices, but guvcview runs a
+ *  single stream: the gui, the encoder and the key callbacks all use
+ *  this handler (a new one closes the previous)
+ * args:
+ *    device - device name
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to v4l2 device handler (or NULL on error)
+ */
+v4l2_dev_t *create_v4l2_device_handler(const char *device)
+{
+	close_v4l2_device_handler();
+
+	my_vd = v4l2core_init_dev(device);
+
+	return my_vd;
+}
+
+/*
+ * get the v4l2 device handler
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to v4l2 device handler (or NULL if none)
+ */
+v4l2_dev_t *get_v4l2_device_handler()
+{
+	return my_vd;
+}
+
+/*
+ * close the v4l2 device handler
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void close_v4l2_device_handler()
+{
+	if(my_vd != NULL)
+		v4l2core_close_dev(my_vd);
+
+	my_vd = NULL;
+}
+
 /*
  * audio processing loop (should run in a separate thread)
  * args:
@@ -713,6 +881,25 @@ static void *audio_processing_loop(void *data)
 	return ((void *) 0);
 }
 
+/*
+ * encode a video frame with the builtin jpeg encoder
+ *  (called from the encoder thread, see encoder_set_mjpg_frame_encoder)
+ * args:
+ *    out - pointer to output buffer
+ *    out_size - output buffer size
+ *    in - pointer to input frame
+ *    data - pointer to jpeg encoder context
+ *
+ * asserts:
+ *   none
+ *
+ * returns: encoded frame size or error code (< 0)
+ */
+static int encoder_mjpg_frame(uint8_t *out, int out_size, uint8_t *in, void *data)
+{
+	return v4l2core_jpeg_encode((jpeg_encoder_context_t *) data, in, out, out_size);
+}
+
 /*
  * encoder loop (should run in a separate thread)
  * args:
@@ -739,7 +926,8 @@ static void *encoder_loop(void *data)
 	int channels = 0;
 	int samprate = 0;
 
-	if(audio_ctx)
+	/*no audio track in time-lapse videos*/
+	if(audio_ctx && options_get()->timelapse <= 0)
 	{
 		channels = audio_ctx->channels;
 		samprate = audio_ctx->samprate;
@@ -749,29 +937,55 @@ static void *encoder_loop(void *data)
 		printf("GUVCVIEW: audio [channels= %i; samprate= %i] \n",
 			channels, samprate);
 
+	/*builtin mjpg video encoder*/
+	jpeg_encoder_context_t *jpeg_ctx = NULL;
+	const char *video_4cc = encoder_get_video_codec_4cc(get_video_codec_ind());
+	if(strcasecmp(options_get()->mjpg_encoder, "builtin") == 0 &&
+		video_4cc != NULL && strcasecmp(video_4cc, "MJPG") == 0)
+	{
+#ifdef USE_PLANAR_YUV
+		int jpeg_format = V4L2_PIX_FMT_YUV420;
+#else
+		int jpeg_format = V4L2_PIX_FMT_YUYV;
+#endif
+		jpeg_ctx = v4l2core_jpeg_encoder_create(
+			v4l2core_get_frame_width(my_vd),
+			v4l2core_get_frame_height(my_vd),
+			jpeg_format,
+			0);
+
+		if(jpeg_ctx && options_get()->encoder_threads > 0)
+			v4l2core_jpeg_encoder_set_threads(jpeg_ctx, options_get()->encoder_threads);
+		if(!jpeg_ctx)
+			fprintf(stderr, "GUVCVIEW: couldn't create the builtin jpeg encoder - using libav\n");
+	}
+
 	/*create the encoder context*/
 	encoder_context_t *encoder_ctx = encoder_get_context(
-		v4l2core_get_requested_frame_format(),
+		v4l2core_get_requested_frame_format(my_vd),
 		get_video_codec_ind(),
 		get_audio_codec_ind(),
 		get_video_muxer(),
-		v4l2core_get_frame_width(),
-		v4l2core_get_frame_height(),
-		v4l2core_get_fps_num(),
-		v4l2core_get_fps_denom(),
+		v4l2core_get_frame_width(my_vd),
+		v4l2core_get_frame_height(my_vd),
+		v4l2core_get_fps_num(my_vd),
+		v4l2core_get_fps_denom(my_vd),
 		channels,
 		samprate);
 
+	if(jpeg_ctx)
+		encoder_set_mjpg_frame_encoder(encoder_ctx, encoder_mjpg_frame, jpeg_ctx);
+
 	/*store external SPS and PPS data if needed*/
 	if(encoder_ctx->video_codec_ind == 0 && /*raw - direct input*/
-		v4l2core_get_requested_frame_format() == V4L2_PIX_FMT_H264)
+		v4l2core_get_requested_frame_format(my_vd) == V4L2_PIX_FMT_H264)
 	{
 		/*request a IDR (key) frame*/
-		v4l2core_h264_request_idr();
+		v4l2core_h264_request_idr(my_vd);
 
 		if(debug_level > 0)
 			printf("GUVCVIEW: storing external pps and sps data in encoder context\n");
-		encoder_ctx->h264_pps_size = v4l2core_get_h264_pps_size();
+		encoder_ctx->h264_pps_size = v4l2core_get_h264_pps_size(my_vd);
 		if(encoder_ctx->h264_pps_size > 0)
 		{
 			encoder_ctx->h264_pps = calloc(encoder_ctx->h264_pps_size, sizeof(uint8_t));
@@ -780,10 +994,10 @@ static void *encoder_loop(void *data)
 				fprintf(stderr,"GUVCVIEW: FATAL memory allocation failure (encoder_loop): %s\n", strerror(errno));
 				exit(-1);
 			}
-			memcpy(encoder_ctx->h264_pps, v4l2core_get_h264_pps(), encoder_ctx->h264_pps_size);
+			memcpy(encoder_ctx->h264_pps, v4l2core_get_h264_pps(my_vd), encoder_ctx->h264_pps_size);
 		}
 
-		encoder_ctx->h264_sps_size = v4l2core_get_h264_sps_size();
+		encoder_ctx->h264_sps_size = v4l2core_get_h264_sps_size(my_vd);
 		if(encoder_ctx->h264_sps_size > 0)
 		{
 			encoder_ctx->h264_sps = calloc(encoder_ctx->h264_sps_size, sizeof(uint8_t));
@@ -792,15 +1006,15 @@ static void *encoder_loop(void *data)
 				fprintf(stderr,"GUVCVIEW: FATAL memory allocation failure (encoder_loop): %s\n", strerror(errno));
 				exit(-1);
 			}
-			memcpy(encoder_ctx->h264_sps, v4l2core_get_h264_sps(), encoder_ctx->h264_sps_size);
+			memcpy(encoder_ctx->h264_sps, v4l2core_get_h264_sps(my_vd), encoder_ctx->h264_sps_size);
 		}
 	}
 
 	uint32_t current_framerate = 0;
-	if(v4l2core_get_requested_frame_format() == V4L2_PIX_FMT_H264)
+	if(v4l2core_get_requested_frame_format(my_vd) == V4L2_PIX_FMT_H264)
 	{
 		/* store framerate since it may change due to scheduler*/
-		current_framerate = v4l2core_get_h264_frame_rate_config();
+		current_framerate = v4l2core_get_h264_frame_rate_config(my_vd);
 	}
 
 	char *video_filename = NULL;
@@ -852,16 +1066,31 @@ static void *encoder_loop(void *data)
 		/*process the video buffer*/
 		if(encoder_process_next_video_buffer(encoder_ctx) > 0)
 		{
-			/* 
+			/*
 			 * no buffers to process
-			 * sleep a couple of milisec
+			 * wait for the next frame (timeout so that
+			 * the save video flag is still checked)
 			 */
-			 struct timespec req = {
-				.tv_sec = 0,
-				.tv_nsec = 1000000};/*nanosec*/
-			 nanosleep(&req, NULL);
-			 
-		}	
+			encoder_wait_video_buffer(20);
+		}
+		else if(pipeline_stats_enabled())
+		{
+			encoder_video_timing_t timing;
+			encoder_get_video_timing(&timing);
+
+			pipeline_stats_count(STATS_FRAMES_ENCODED);
+			pipeline_stats_record(STATS_ENQUEUE_TO_ENCODE, timing.enqueue_ts, timing.encode_start);
+			pipeline_stats_record(STATS_ENCODE, timing.encode_start, timing.encode_end);
+			pipeline_stats_record(STATS_CAPTURE_TO_ENCODED,
+				pipeline_stats_dequeue_ts(timing.frame_ts), timing.encode_end);
+			if(timing.mux_end > 0)
+			{
+				pipeline_stats_count(STATS_PACKETS_MUXED);
+				pipeline_stats_record(STATS_CAPTURE_TO_MUX,
+					pipeline_stats_dequeue_ts(timing.packet_ts), timing.mux_end);
+				io_stats_update();
+			}
+		}
 
 		/*disk supervisor*/
 		if(encoder_ctx->enc_video_ctx->pts - last_check_pts > 2 * NSEC_PER_SEC)
@@ -890,13 +1119,20 @@ static void *encoder_loop(void *data)
 	/*close the muxer*/
 	encoder_muxer_close(encoder_ctx);
 
+	if(pipeline_stats_enabled())
+		io_stats_update();
+
 	/*close the encoder context (clean up)*/
 	encoder_close(encoder_ctx);
 
-	if(v4l2core_get_requested_frame_format() == V4L2_PIX_FMT_H264)
+	/*release the builtin mjpg video encoder*/
+	if(jpeg_ctx)
+		v4l2core_jpeg_encoder_destroy(jpeg_ctx);
+
+	if(v4l2core_get_requested_frame_format(my_vd) == V4L2_PIX_FMT_H264)
 	{
 		/* restore framerate */
-		v4l2core_set_h264_frame_rate_config(current_framerate);
+		v4l2core_set_h264_frame_rate_config(my_vd, current_framerate);
 	}
 
 	/*clean string*/
@@ -909,10 +1145,72 @@ static void *encoder_loop(void *data)
 	return ((void *) 0);
 }
 
+/*
+ * releases a frame referenced by the encoder ring buffer
+ *  (called from the encoder thread once the frame is encoded)
+ * args:
+ *    data - pointer to the v4l2 frame buffer
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void encoder_frame_release(void *data)
+{
+	v4l2core_release_frame(my_vd, (v4l2_frame_buff_t *) data);
+}
+
+/*
+ * describe the current capture setup in the pipeline stats
+ * args:
+ *    options - pointer to options data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void stats_set_capture_info(options_t *options)
+{
+	if(!pipeline_stats_enabled())
+		return;
+
+	char value[32];
+	uint32_t format = v4l2core_get_requested_frame_format(my_vd);
+
+	pipeline_stats_set_info("version", VERSION);
+	pipeline_stats_set_info("device", options->device);
+	snprintf(value, 31, "%c%c%c%c",
+		format & 0xFF, (format >> 8) & 0xFF,
+		(format >> 16) & 0xFF, (format >> 24) & 0xFF);
+	pipeline_stats_set_info("format", value);
+	snprintf(value, 31, "%ix%i",
+		v4l2core_get_frame_width(my_vd),
+		v4l2core_get_frame_height(my_vd));
+	pipeline_stats_set_info("resolution", value);
+	snprintf(value, 31, "%i", options->decoder_threads);
+	pipeline_stats_set_info("decoder_threads", value);
+	const char *codec = encoder_get_video_codec_4cc(get_video_codec_ind());
+	pipeline_stats_set_info("video_codec", codec ? codec : "");
+	switch(get_video_muxer())
+	{
+		case ENCODER_MUX_AVI:
+			pipeline_stats_set_info("muxer", "avi");
+			break;
+		case ENCODER_MUX_WEBM:
+			pipeline_stats_set_info("muxer", "webm");
+			break;
+		default:
+			pipeline_stats_set_info("muxer", "mkv");
+			break;
+	}
+}
+
 /*
  * capture loop (should run in a separate thread)
  * args:
- *    data - pointer to user data (options data)
+ *    data - pointer to user data (capture_loop_data_t)
  *
  * asserts:
  *    none
@@ -925,6 +1223,8 @@ void *capture_loop(void *data)
     int v = 0;
 	capture_loop_data_t *cl_data = (capture_loop_data_t *) data;
 	options_t *my_options = (options_t *) cl_data->options;
+	/*device driven by this loop (the gui callbacks use the device handler)*/
+	v4l2_dev_t *vd = (v4l2_dev_t *) cl_data->device;
 	//config_t *my_config = (config_t *) cl_data->config;
 
 	uint64_t my_last_photo_time = 0; /*timer count*/
@@ -949,7 +1249,7 @@ void *capture_loop(void *data)
 	
 	render_set_verbosity(debug_level);
 	
-	if(render_init(render, v4l2core_get_frame_width(), v4l2core_get_frame_height(), render_flags) < 0)
+	if(render_init(render, v4l2core_get_frame_width(vd), v4l2core_get_frame_height(vd), render_flags) < 0)
 		render = RENDER_NONE;
 	else
 	{
@@ -982,7 +1282,45 @@ void *capture_loop(void *data)
 	if(my_options->photo_npics > 0)
 		my_photo_npics = my_options->photo_npics;
 
-	v4l2core_start_stream();
+	/*pipeline latency and throughput statistics*/
+	if(my_options->stats_file != NULL)
+	{
+		pipeline_stats_start(my_options->stats_file, my_options->stats_interval);
+		stats_set_capture_info(my_options);
+	}
+
+	/*exit when the timed captures are done (--exit_on_term)*/
+	int exit_on_term = my_options->exit_on_term &&
+		(my_options->video_timer > 0 || my_options->photo_timer > 0);
+
+	uint64_t last_frame_ts = 0; /*for the frame interval stats*/
+	uint64_t frames_dropped = 0; /*driver dropped frames (all streams)*/
+
+	/*save images in the background (0 workers - in this thread)*/
+	if(my_options->image_workers > 0)
+	{
+		int policy = SNAPSHOT_BLOCK;
+		if(strcasecmp(my_options->image_queue_policy, "drop") == 0)
+			policy = SNAPSHOT_DROP_OLDEST;
+		else if(strcasecmp(my_options->image_queue_policy, "skip") == 0)
+			policy = SNAPSHOT_SKIP;
+
+		v4l2core_snapshot_start(vd, my_options->image_workers,
+			my_options->image_queue, policy, &snapshot_done, NULL);
+
+		/*bursts go to a preallocated ring at the full frame rate*/
+		if(my_options->photo_burst > 1)
+			v4l2core_snapshot_reserve(vd, my_options->photo_burst);
+	}
+
+	int burst_left = 0; /*frames left to save in the current photo burst*/
+
+	/*time-lapse: one frame every timelapse seconds, played at the capture frame rate*/
+	uint64_t timelapse_interval = (uint64_t) (my_options->timelapse * NSEC_PER_SEC);
+	uint64_t timelapse_last = 0; /*capture time of the last frame added (0 - none)*/
+	uint64_t timelapse_ts = 0; /*video timestamp of the last frame added*/
+
+	v4l2core_start_stream(vd);
 	
 	v4l2_frame_buff_t *frame = NULL; //pointer to frame buffer
 
@@ -991,24 +1329,25 @@ void *capture_loop(void *data)
 		if(restart)
 		{
 			restart = 0; /*reset*/
-			v4l2core_stop_stream();
+			v4l2core_stop_stream(vd);
 
 			/*close render*/
 			render_close();
 
-			v4l2core_clean_buffers();
+			/*waits for the frames still referenced by the encoder ring buffer*/
+			v4l2core_clean_buffers(vd);
 
 			/*try new format (values prepared by the request callback)*/
-			ret = v4l2core_update_current_format();
+			ret = v4l2core_update_current_format(vd);
 			/*try to set the video stream format on the device*/
 			if(ret != E_OK)
 			{
 				fprintf(stderr, "GUCVIEW: could not set the defined stream format\n");
 				fprintf(stderr, "GUCVIEW: trying first listed stream format\n");
 
-				v4l2core_prepare_valid_format();
-				v4l2core_prepare_valid_resolution();
-				ret = v4l2core_update_current_format();
+				v4l2core_prepare_valid_format(vd);
+				v4l2core_prepare_valid_resolution(vd);
+				ret = v4l2core_update_current_format(vd);
 
 				if(ret != E_OK)
 				{
@@ -1021,7 +1360,7 @@ void *capture_loop(void *data)
 			}
 
 			/*restart the render with new format*/
-			if(render_init(render, v4l2core_get_frame_width(), v4l2core_get_frame_height(), render_flags) < 0)
+			if(render_init(render, v4l2core_get_frame_width(vd), v4l2core_get_frame_height(vd), render_flags) < 0)
 				render = RENDER_NONE;
 			else
 			{
@@ -1036,32 +1375,101 @@ void *capture_loop(void *data)
 
 
 			if(debug_level > 0)
-				printf("GUVCVIEW: reset to pixelformat=%x width=%i and height=%i\n", v4l2core_get_requested_frame_format(), v4l2core_get_frame_width(), v4l2core_get_frame_height());
+				printf("GUVCVIEW: reset to pixelformat=%x width=%i and height=%i\n", v4l2core_get_requested_frame_format(vd), v4l2core_get_frame_width(vd), v4l2core_get_frame_height(vd));
+
+			stats_set_capture_info(my_options);
+
+			/*the frame size may have changed*/
+			if(my_options->photo_burst > 1)
+				v4l2core_snapshot_reserve(vd, my_options->photo_burst);
+			burst_left = 0;
 
-			v4l2core_start_stream();
+			v4l2core_start_stream(vd);
 
 		}
 
-		frame = v4l2core_get_decoded_frame();
+		/*
+		 * h264 frames are only decoded if something uses the pixels
+		 * (recording the h264 stream as is doesn't need them)
+		 */
+		v4l2core_set_h264_decode(vd,
+			render != RENDER_NONE ||
+			save_image || burst_left > 0 || check_photo_timer() ||
+			do_soft_autofocus || do_soft_focus ||
+			(video_capture_get_save_video() && get_video_codec_ind() != 0));
+
+		frame = v4l2core_get_decoded_frame(vd);
+
+		/*handle device events collected while waiting for the frame*/
+		uint32_t dev_events = v4l2core_get_events(vd);
+		if(dev_events & DEV_EVENT_HANGUP)
+		{
+			fprintf(stderr, "GUVCVIEW: video device was disconnected\n");
+			quit_callback(NULL);
+		}
+		else if(dev_events & DEV_EVENT_SOURCE_CHANGE)
+		{
+			if(debug_level > 0)
+				printf("GUVCVIEW: video source changed - restarting stream\n");
+			restart = 1;
+		}
+		if(dev_events & DEV_EVENT_CONTROL)
+		{
+			if(debug_level > 1)
+				printf("GUVCVIEW: device control values changed\n");
+			gui_update_control_values();
+		}
+		if(debug_level > 1 && (dev_events & DEV_EVENT_DEVICE_LIST))
+			printf("GUVCVIEW: device list changed\n");
+
 		if( frame != NULL)
 		{
+			if(pipeline_stats_enabled())
+			{
+				pipeline_stats_count(STATS_FRAMES_CAPTURED);
+				pipeline_stats_record(STATS_FRAME_INTERVAL, last_frame_ts, frame->dequeue_ts);
+				if(frame->dropped > 0)
+				{
+					frames_dropped += frame->dropped;
+					pipeline_stats_set_count(STATS_CAPTURE_DROPPED, frames_dropped);
+				}
+				pipeline_stats_record(STATS_DQBUF_TO_DECODE, frame->dequeue_ts, frame->decode_start_ts);
+				pipeline_stats_record(STATS_DECODE, frame->decode_start_ts, frame->decode_end_ts);
+			}
+			last_frame_ts = frame->dequeue_ts;
+
 			/*run software autofocus (must be called after frame was grabbed and decoded)*/
 			if(do_soft_autofocus || do_soft_focus)
-				do_soft_focus = v4l2core_soft_autofocus_run(frame);
+				do_soft_focus = v4l2core_soft_autofocus_run(vd, frame);
 
 			/*render the decoded frame*/
-            cur_fps = v4l2core_get_realfps();
+            cur_fps = v4l2core_get_realfps(vd);
             if (last_fps != cur_fps) {
                 last_fps = cur_fps;
                 if (my_options->cmos_camera)
-                    snprintf(render_caption, 63, "Guvcview ver:%s - %s - CMOS %dx%d (%2.2f fps) - seq: %d",  VERSION, my_options->format, v4l2core_get_frame_width(), v4l2core_get_frame_height(), cur_fps, v);
+                    snprintf(render_caption, 63, "Guvcview ver:%s - %s - CMOS %dx%d (%2.2f fps) - seq: %d",  VERSION, my_options->format, v4l2core_get_frame_width(vd), v4l2core_get_frame_height(vd), cur_fps, v);
                 else
-                    snprintf(render_caption, 63, "Guvcview ver:%s - %s - %dx%d (%2.2f fps) - seq: %d",  VERSION, my_options->format, v4l2core_get_frame_width(), v4l2core_get_frame_height(), cur_fps, v);
+                    snprintf(render_caption, 63, "Guvcview ver:%s - %s - %dx%d (%2.2f fps) - seq: %d",  VERSION, my_options->format, v4l2core_get_frame_width(vd), v4l2core_get_frame_height(vd), cur_fps, v);
                 render_set_caption(render_caption);
                 v++;
             }
+			uint64_t render_start = pipeline_stats_enabled() ? v4l2core_time_get_timestamp() : 0;
+
+			/*fx must not leak into the raw frame (zero copy)*/
+			if(my_render_mask != REND_FX_YUV_NOFILT)
+				v4l2core_frame_detach_raw(vd, frame);
+
 			render_frame(frame->yuv_frame, my_render_mask);
 
+			if(render_start > 0)
+			{
+				uint64_t render_end = v4l2core_time_get_timestamp();
+				pipeline_stats_count(STATS_FRAMES_RENDERED);
+				pipeline_stats_record(STATS_DECODE_TO_RENDER, frame->decode_end_ts, render_start);
+				pipeline_stats_record(STATS_RENDER, render_start, render_end);
+				pipeline_stats_record(STATS_CAPTURE_TO_RENDER, frame->dequeue_ts, render_end);
+			}
+
 			if(check_photo_timer())
 			{
 				if((frame->timestamp - my_last_photo_time) > my_photo_timer)
@@ -1085,25 +1493,21 @@ void *capture_loop(void *data)
 					stop_video_timer();
 			}
 
+			/*a photo request saves photo_burst consecutive frames*/
 			if(save_image)
 			{
-				char *img_filename = NULL;
-
-				/*get_photo_[name|path] always return a non NULL value*/
-				char *name = strdup(get_photo_name());
-				char *path = strdup(get_photo_path());
+				burst_left = (my_options->photo_burst > 1) ? my_options->photo_burst : 1;
+				save_image = 0; /*reset*/
+			}
 
-				if(get_photo_sufix_flag())
-				{
-					char *new_name = add_file_suffix(path, name);
-					free(name); /*free old name*/
-					name = new_name; /*replace with suffixed name*/
-				}
-				int pathsize = strlen(path);
-				if(path[pathsize] != '/')
-					img_filename = smart_cat(path, '/', name);
-				else
-					img_filename = smart_cat(path, 0, name);
+			/*
+			 * wait for a decoded frame (h264 resumes decoding on the
+			 * next IDR frame after a pause, a decode error leaves
+			 * no valid pixels either)
+			 */
+			if(burst_left > 0 && frame->decode_end_ts > 0)
+			{
+				char *img_filename = get_next_photo_filename(my_options->photo_burst > 1);
 
 				//if(debug_level > 1)
 				//	printf("GUVCVIEW: saving image to %s\n", img_filename);
@@ -1111,21 +1515,73 @@ void *capture_loop(void *data)
 				snprintf(status_message, 79, _("saving image to %s"), img_filename);
 				gui_status_message(status_message);
 
-				v4l2core_save_image(frame, img_filename, get_photo_format());
+				uint64_t save_start = pipeline_stats_enabled() ? v4l2core_time_get_timestamp() : 0;
+
+				/*copies the frame for the snapshot workers (or saves it)*/
+				if(v4l2core_snapshot_queue(vd, frame, img_filename, get_photo_format()) == E_NO_DATA)
+				{
+					snprintf(status_message, 79, _("image %s dropped (save queue full)"), img_filename);
+					gui_status_message(status_message);
+					pipeline_stats_count(STATS_IMAGES_DROPPED);
+				}
+
+				if(save_start > 0)
+					pipeline_stats_record(STATS_SAVE_IMAGE, save_start, v4l2core_time_get_timestamp());
 
-				free(path);
-				free(name);
 				free(img_filename);
 
-				save_image = 0; /*reset*/
+				burst_left--;
 			}
 
-			if(video_capture_get_save_video())
+			/*video timestamp (time-lapse frames are spaced by the nominal frame interval)*/
+			uint64_t video_ts = frame->timestamp;
+			int add_video_frame = video_capture_get_save_video();
+
+			if(!add_video_frame)
+				timelapse_last = 0; /*restart the time-lapse with the next video*/
+			else if(timelapse_interval > 0)
+			{
+				uint64_t frame_interval = (uint64_t) v4l2core_get_fps_num(vd) * NSEC_PER_SEC /
+					(uint64_t) v4l2core_get_fps_denom(vd);
+
+				if(timelapse_last == 0)
+				{
+					/*first frame (must be a keyframe for h264 passthrough)*/
+					add_video_frame = frame->isKeyframe || get_video_codec_ind() != 0 ||
+						v4l2core_get_requested_frame_format(vd) != V4L2_PIX_FMT_H264;
+					if(!add_video_frame)
+						v4l2core_h264_request_idr(vd);
+					timelapse_ts = frame->timestamp;
+				}
+				else if(frame->timestamp - timelapse_last < timelapse_interval)
+					add_video_frame = 0;
+				else
+				{
+					/*h264 passthrough can only skip to keyframes*/
+					if(get_video_codec_ind() == 0 &&
+					   v4l2core_get_requested_frame_format(vd) == V4L2_PIX_FMT_H264 &&
+					   !frame->isKeyframe)
+					{
+						add_video_frame = 0;
+						v4l2core_h264_request_idr(vd);
+					}
+					else
+						timelapse_ts += frame_interval;
+				}
+
+				if(add_video_frame)
+				{
+					timelapse_last = frame->timestamp;
+					video_ts = timelapse_ts;
+				}
+			}
+
+			if(add_video_frame)
 			{
 #ifdef USE_PLANAR_YUV
-				int size = (v4l2core_get_frame_width() * v4l2core_get_frame_height() * 3) / 2;
+				int size = (v4l2core_get_frame_width(vd) * v4l2core_get_frame_height(vd) * 3) / 2;
 #else
-				int size = v4l2core_get_frame_width() * v4l2core_get_frame_height() * 2;
+				int size = v4l2core_get_frame_width(vd) * v4l2core_get_frame_height(vd) * 2;
 #endif
 				uint8_t *input_frame = frame->yuv_frame;
 				/*
@@ -1134,7 +1590,7 @@ void *capture_loop(void *data)
 				 */
 				if(get_video_codec_ind() == 0) //raw frame
 				{
-					switch(v4l2core_get_requested_frame_format())
+					switch(v4l2core_get_requested_frame_format(vd))
 					{
 						case  V4L2_PIX_FMT_H264:
 							input_frame = frame->h264_frame;
@@ -1147,7 +1603,31 @@ void *capture_loop(void *data)
 					}
 
 				}
-				encoder_add_video_frame(input_frame, size, frame->timestamp, frame->isKeyframe);
+				/*
+				 * hand over a reference to the frame if the core can spare it
+				 * (needs a frame queue > 1), otherwise copy it
+				 */
+				int add_ret = 0;
+				if(v4l2core_frame_ref(vd, frame) == E_OK)
+				{
+					add_ret = encoder_add_video_frame_ref(input_frame, size,
+						video_ts, frame->isKeyframe,
+						encoder_frame_release, (void *) frame);
+					if(add_ret != 0)
+						v4l2core_release_frame(vd, frame); /*drop the reference*/
+				}
+				else
+					add_ret = encoder_add_video_frame(input_frame, size, video_ts, frame->isKeyframe);
+
+				if(add_ret != 0)
+					pipeline_stats_count(STATS_ENCODER_DROPPED);
+				else if(pipeline_stats_enabled())
+				{
+					pipeline_stats_count(STATS_FRAMES_ENQUEUED);
+					pipeline_stats_record(STATS_CAPTURE_TO_ENQUEUE, frame->dequeue_ts, v4l2core_time_get_timestamp());
+					/*the encoder timing only has the video timestamp*/
+					pipeline_stats_map_frame(video_ts, frame->dequeue_ts);
+				}
 
 				/*
 				 * exponencial scheduler
@@ -1157,12 +1637,12 @@ void *capture_loop(void *data)
 				int time_sched = encoder_buff_scheduler(ENCODER_SCHED_EXP, 0.5, 250);
 				if(time_sched > 0)
 				{
-					switch(v4l2core_get_requested_frame_format())
+					switch(v4l2core_get_requested_frame_format(vd))
 					{
 						case  V4L2_PIX_FMT_H264:
 						{
 							uint32_t framerate = time_sched; /*nanosec*/
-							v4l2core_set_h264_frame_rate_config(framerate);
+							v4l2core_set_h264_frame_rate_config(vd, framerate);
 							break;
 						}
 						default:
@@ -1177,16 +1657,46 @@ void *capture_loop(void *data)
 				}
 			}
 			/*we are done with the frame buffer release it*/
-			v4l2core_release_frame(frame);
+			v4l2core_release_frame(vd, frame);
+
+			if(pipeline_stats_enabled())
+			{
+				if(my_audio_ctx != NULL)
+					audio_stats_update(my_audio_ctx);
+				pipeline_stats_update();
+			}
+
+			if(exit_on_term &&
+				burst_left == 0 &&
+				!check_photo_timer() &&
+				!check_video_timer() &&
+				!video_capture_get_save_video() &&
+				!get_encoder_status())
+			{
+				if(debug_level > 0)
+					printf("GUVCVIEW: timed capture done - exiting\n");
+				quit_callback(NULL);
+			}
 		}
 	}
 
-	v4l2core_stop_stream();
+	v4l2core_stop_stream(vd);
+
+	/*wait for the pending snapshots*/
+	v4l2core_snapshot_stop(vd);
 	
 	/*if we are still saving video then stop it*/
 	if(video_capture_get_save_video())
 		stop_encoder_thread();
 
+	/*final stats dump*/
+	if(pipeline_stats_enabled())
+	{
+		if(my_audio_ctx != NULL)
+			audio_stats_update(my_audio_ctx);
+		pipeline_stats_stop();
+	}
+
 	render_close();
 
 	return ((void *) 0);
@@ -24,6 +24,7 @@
 #include <inttypes.h>
 #include <sys/types.h>
 
+#include "gviewv4l2core.h"
 #include "gviewaudio.h"
 
 typedef struct _capture_loop_data_t
@@ -250,6 +251,42 @@ void close_audio_context();
  */
 audio_context_t *get_audio_context();
 
+/*
+ * create a v4l2 device handler
+ * args:
+ *    device - device name
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to v4l2 device handler (or NULL on error)
+ */
+v4l2_dev_t *create_v4l2_device_handler(const char *device);
+
+/*
+ * get the v4l2 device handler
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to v4l2 device handler (or NULL if none)
+ */
+v4l2_dev_t *get_v4l2_device_handler();
+
+/*
+ * close the v4l2 device handler
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void close_v4l2_device_handler();
+
 /*
  * start the encoder thread
  * args:
@@ -45,20 +45,35 @@
 #include "../config.h"
 #include "gviewaudio.h"
 #include "gview.h"
+#include "audio_simd.h"
 #include "audio_portaudio.h"
 #if HAS_PULSEAUDIO
   #include "audio_pulseaudio.h"
 #endif
 
-/*audio device data mutex*/
-static __MUTEX_TYPE mutex = __STATIC_MUTEX_INIT;
-#define __PMUTEX &mutex
-
 #define AUDBUFF_NUM     80    /*number of audio buffers*/
 #define AUDBUFF_FRAMES  1152  /*number of audio frames per buffer*/
+
+/*
+ * single producer (device callback) single consumer (encoder thread)
+ *  lock free fifo: the callback writes the samples straight into the
+ *  buffer at buffer_write_count and publishes it with a release store,
+ *  the consumer frees it the same way through buffer_read_count.
+ *  The buffer index is (count % AUDBUFF_NUM)
+ */
 static audio_buff_t *audio_buffers = NULL; /*pointer to buffers list*/
-static int buffer_read_index = 0; /*current read index of buffer list*/
-static int buffer_write_index = 0;/*current write index of buffer list*/
+static int buffer_read_count = 0;  /*buffers consumed (written by the consumer only)*/
+static int buffer_write_count = 0; /*buffers published (written by the producer only)*/
+static int buffer_fill_index = 0;      /*samples already in the write buffer (producer only)*/
+static int buffer_fill_drop = 0;       /*fifo was full, discard the buffer being filled*/
+
+/*
+ * counters wrap at twice the number of buffers so that
+ *  a full fifo can be told apart from an empty one
+ */
+#define AUDBUFF_WRAP          (2 * AUDBUFF_NUM)
+#define AUDBUFF_NEXT(c)       (((c) + 1) % AUDBUFF_WRAP)
+#define AUDBUFF_USED(w, r)    (((w) - (r) + AUDBUFF_WRAP) % AUDBUFF_WRAP)
 
 int verbosity = 0;
 static int audio_api = AUDIO_PORTAUDIO;
@@ -78,36 +93,6 @@ void audio_set_verbosity(int value)
 	verbosity = value;
 }
 
-/*
- * Lock the mutex
- * args:
- *   none
- *
- * asserts:
- *   none
- *
- * returns: none
- */
-void audio_lock_mutex()
-{
-	__LOCK_MUTEX( __PMUTEX );
-}
-
-/*
- * Unlock the mutex
- * args:
- *   none
- *
- * asserts:
- *   none
- *
- * returns: none
- */
-void audio_unlock_mutex()
-{
-	__UNLOCK_MUTEX( __PMUTEX );
-}
-
 /*
  * free audio buffers
  * args:
@@ -120,8 +105,10 @@ void audio_unlock_mutex()
  */
 static int audio_free_buffers()
 {
-	buffer_read_index = 0;
-	buffer_write_index = 0;
+	buffer_read_count = 0;
+	buffer_write_count = 0;
+	buffer_fill_index = 0;
+	buffer_fill_drop = 0;
 	
 	/*return if no buffers set*/
 	if(!audio_buffers)
@@ -241,7 +228,14 @@ static int audio_init_buffers(audio_context_t *audio_ctx)
 	}
 	
 	/*free audio_buffers (if any)*/
-	audio_free_buffers;
+	if(audio_buffers)
+		audio_free_buffers();
+
+	/*reset the fifo*/
+	buffer_read_count = 0;
+	buffer_write_count = 0;
+	buffer_fill_index = 0;
+	buffer_fill_drop = 0;
 
 	audio_buffers = calloc(AUDBUFF_NUM, sizeof(audio_buff_t));
 	if(audio_buffers == NULL)
@@ -259,74 +253,106 @@ static int audio_init_buffers(audio_context_t *audio_ctx)
 			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_init_buffers): %s\n", strerror(errno));
 			exit(-1);
 		}
-		audio_buffers[i].flag = AUDIO_BUFF_FREE;
 	}
 
 	return 0;
 }
 
 /*
- * fill a audio buffer data and move write index to next one
+ * write captured samples to the fifo (called from the device callback)
+ *  never locks, allocates or prints, so it is safe for realtime threads
+ *  if the fifo is full the buffer is still timestamped but its samples
+ *  are discarded (counted in audio_ctx->dropped_buffers)
  * args:
  *   audio_ctx - pointer to audio context data
- *   ts - timestamp for end of data
+ *   samples - pointer to interleaved samples (NULL for silence)
+ *   nsamples - number of samples (frames * channels)
+ *   ts - real timestamp of the first sample (in nanosec)
  *
  * asserts:
  *   audio_ctx is not null
  *
  * returns: none
  */
-void audio_fill_buffer(audio_context_t *audio_ctx, int64_t ts)
+void audio_fifo_write(audio_context_t *audio_ctx, const sample_t *samples, int nsamples, int64_t ts)
 {
 	/*assertions*/
 	assert(audio_ctx != NULL);
 
-	if(verbosity > 3)
-		printf("AUDIO: filling buffer ts:%" PRId64 "\n", ts);
 	/*in nanosec*/
 	uint64_t frame_length = NSEC_PER_SEC / audio_ctx->samprate;
 	uint64_t buffer_length = frame_length * (audio_ctx->capture_buff_size / audio_ctx->channels);
 
-	audio_ctx->current_ts += buffer_length; /*buffer end time*/
+	int done = 0;
 
-	audio_ctx->ts_drift = audio_ctx->current_ts - ts;
+	while(done < nsamples)
+	{
+		if(buffer_fill_index == 0)
+		{
+			/*starting a new buffer: check for a free one*/
+			int read_count = __atomic_load_n(&buffer_read_count, __ATOMIC_ACQUIRE);
+			buffer_fill_drop = (AUDBUFF_USED(buffer_write_count, read_count) >= AUDBUFF_NUM);
 
-	/*get the current write indexed buffer flag*/
-	audio_lock_mutex();
-	int flag = audio_buffers[buffer_write_index].flag;
-	audio_unlock_mutex();
+			audio_ctx->capture_buff_level[0] = 0;
+			audio_ctx->capture_buff_level[1] = 0;
+		}
 
-	if(flag == AUDIO_BUFF_USED)
-	{
-		fprintf(stderr, "AUDIO: write buffer(%i) is still in use - dropping data\n", buffer_write_index);
-		return;
-	}
+		/*with a full fifo use the capture buffer as scratch*/
+		sample_t *buff = buffer_fill_drop ?
+			audio_ctx->capture_buff :
+			(sample_t *) audio_buffers[buffer_write_count % AUDBUFF_NUM].data;
+		sample_t *out = buff + buffer_fill_index;
+
+		int n = audio_ctx->capture_buff_size - buffer_fill_index;
+		if(n > nsamples - done)
+			n = nsamples - done;
+
+		if(samples)
+			memcpy(out, samples + done, n * sizeof(sample_t));
+		else
+			memset(out, 0, n * sizeof(sample_t));
+
+		/*store peak values (buffer size is a multiple of channels)*/
+		int i = 0;
+		int chan = buffer_fill_index % audio_ctx->channels;
+		for(i = 0; i < n; ++i)
+		{
+			if(chan < 2 && audio_ctx->capture_buff_level[chan] < out[i])
+				audio_ctx->capture_buff_level[chan] = out[i];
+			chan++;
+			if(chan >= audio_ctx->channels)
+				chan = 0;
+		}
 
-	/*write max_frames and fill a buffer*/
-	memcpy(audio_buffers[buffer_write_index].data,
-		audio_ctx->capture_buff,
-		audio_ctx->capture_buff_size * sizeof(sample_t));
-	/*buffer begin time*/
-	audio_buffers[buffer_write_index].timestamp = audio_ctx->current_ts - buffer_length;
+		buffer_fill_index += n;
+		done += n;
 
-	audio_buffers[buffer_write_index].level_meter[0] = audio_ctx->capture_buff_level[0];
-	audio_buffers[buffer_write_index].level_meter[1] = audio_ctx->capture_buff_level[1];
+		if(buffer_fill_index < audio_ctx->capture_buff_size)
+			break; /*wait for more samples*/
 
-	audio_lock_mutex();
-	audio_buffers[buffer_write_index].flag = AUDIO_BUFF_USED;
-	NEXT_IND(buffer_write_index, AUDBUFF_NUM);
-	audio_unlock_mutex();
+		buffer_fill_index = 0;
 
-}
+		audio_ctx->current_ts += buffer_length; /*buffer end time*/
+		/*real timestamp for the end of data*/
+		int64_t buff_ts = ts + ((done - 1) / audio_ctx->channels) * frame_length;
+		audio_ctx->ts_drift = audio_ctx->current_ts - buff_ts;
 
-/* saturate float samples to int16 limits*/
-static int16_t clip_int16 (float in)
-{
-	//int16_t out = (int16_t) (in < -32768) ? -32768 : (in > 32767) ? 32767 : in;
+		if(buffer_fill_drop)
+		{
+			__atomic_add_fetch(&audio_ctx->dropped_buffers, 1, __ATOMIC_RELAXED);
+			continue;
+		}
 
-	long lout =  lroundf(in);
-	int16_t out = (lout < INT16_MIN) ? INT16_MIN : (lout > INT16_MAX) ? INT16_MAX: (int16_t) lout;
-	return (out);
+		audio_buff_t *audio_buff = &audio_buffers[buffer_write_count % AUDBUFF_NUM];
+		/*buffer begin time*/
+		audio_buff->timestamp = audio_ctx->current_ts - buffer_length;
+		audio_buff->level_meter[0] = audio_ctx->capture_buff_level[0];
+		audio_buff->level_meter[1] = audio_ctx->capture_buff_level[1];
+
+		/*publish the buffer to the consumer*/
+		__atomic_store_n(&buffer_write_count,
+			AUDBUFF_NEXT(buffer_write_count), __ATOMIC_RELEASE);
+	}
 }
 
 /*
@@ -344,84 +370,53 @@ static int16_t clip_int16 (float in)
  */
 int audio_get_next_buffer(audio_context_t *audio_ctx, audio_buff_t *buff, int type, uint32_t mask)
 {
-	audio_lock_mutex();
-	int flag = audio_buffers[buffer_read_index].flag;
-	audio_unlock_mutex();
+	if(!audio_buffers)
+		return 1;
 
-	if(flag == AUDIO_BUFF_FREE)
+	/*only this thread writes buffer_read_count*/
+	if(buffer_read_count == __atomic_load_n(&buffer_write_count, __ATOMIC_ACQUIRE))
 		return 1; /*all done*/
 
+	audio_buff_t *audio_buff = &audio_buffers[buffer_read_count % AUDBUFF_NUM];
+
 	/*aplly fx*/
-	audio_fx_apply(audio_ctx, (sample_t *) audio_buffers[buffer_read_index].data, mask);
+	audio_fx_apply(audio_ctx, (sample_t *) audio_buff->data, mask);
 
 	/*copy data into requested format type*/
-	int i = 0;
+	sample_t *buff_p = (sample_t *) audio_buff->data;
+	int frames = audio_ctx->capture_buff_size / audio_ctx->channels;
+
 	switch(type)
 	{
 		case GV_SAMPLE_TYPE_FLOAT:
-		{
-			sample_t *my_data = (sample_t *) buff->data;
-			memcpy( my_data, audio_buffers[buffer_read_index].data,
+			memcpy(buff->data, buff_p,
 				audio_ctx->capture_buff_size * sizeof(sample_t));
 			break;
-		}
+
 		case GV_SAMPLE_TYPE_INT16:
-		{
-			int16_t *my_data = (int16_t *) buff->data;
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
-			for(i = 0; i < audio_ctx->capture_buff_size; ++i)
-			{
-				my_data[i] = clip_int16( (buff_p[i]) * INT16_MAX);
-			}
+			audio_samples_to_s16((int16_t *) buff->data, buff_p,
+				audio_ctx->capture_buff_size);
 			break;
-		}
-		case GV_SAMPLE_TYPE_FLOATP:
-		{
-			int j=0;
-
-			float *my_data[audio_ctx->channels];
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
 
-			for(j = 0; j < audio_ctx->channels; ++j)
-				my_data[j] = (float *) (((float *) buff->data) +
-					(j * audio_ctx->capture_buff_size/audio_ctx->channels));
-
-			for(i = 0; i < audio_ctx->capture_buff_size/audio_ctx->channels; ++i)
-				for(j = 0; j < audio_ctx->channels; ++j)
-				{
-					my_data[j][i] = *buff_p++;
-				}
+		case GV_SAMPLE_TYPE_FLOATP:
+			audio_samples_to_float_planes((float *) buff->data, buff_p,
+				audio_ctx->channels, frames);
 			break;
-		}
-		case GV_SAMPLE_TYPE_INT16P:
-		{
-			int j=0;
-
-			int16_t *my_data[audio_ctx->channels];
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
 
-			for(j = 0; j < audio_ctx->channels; ++j)
-				my_data[j] = (int16_t *) (((int16_t *) buff->data) +
-					(j * audio_ctx->capture_buff_size/audio_ctx->channels));
-
-			for(i = 0; i < audio_ctx->capture_buff_size/audio_ctx->channels; ++i)
-				for(j = 0; j < audio_ctx->channels; ++j)
-				{
-					my_data[j][i] = clip_int16((*buff_p++) * INT16_MAX);
-				}
+		case GV_SAMPLE_TYPE_INT16P:
+			audio_samples_to_s16_planes((int16_t *) buff->data, buff_p,
+				audio_ctx->channels, frames);
 			break;
-		}
 	}
 
-	buff->timestamp = audio_buffers[buffer_read_index].timestamp;
+	buff->timestamp = audio_buff->timestamp;
 
-	buff->level_meter[0] = audio_buffers[buffer_read_index].level_meter[0];
-	buff->level_meter[1] = audio_buffers[buffer_read_index].level_meter[1];
+	buff->level_meter[0] = audio_buff->level_meter[0];
+	buff->level_meter[1] = audio_buff->level_meter[1];
 
-	audio_lock_mutex();
-	audio_buffers[buffer_read_index].flag = AUDIO_BUFF_FREE;
-	NEXT_IND(buffer_read_index, AUDBUFF_NUM);
-	audio_unlock_mutex();
+	/*give the buffer back to the producer*/
+	__atomic_store_n(&buffer_read_count,
+		AUDBUFF_NEXT(buffer_read_count), __ATOMIC_RELEASE);
 
 	return 0;
 }
@@ -517,6 +512,9 @@ int audio_start(audio_context_t *audio_ctx)
 	/*assertions*/
 	assert(audio_ctx != NULL);
 
+	if(verbosity > 0)
+		printf("AUDIO: sample conversion kernels: %s\n", audio_get_simd()->name);
+
 	/*alloc the ring buffer*/
 	audio_init_buffers(audio_ctx);
 	
@@ -526,6 +524,11 @@ int audio_start(audio_context_t *audio_ctx)
 	audio_ctx->snd_begintime = 0;
 	audio_ctx->ts_drift = 0;  
 
+	/*reset the fifo counters*/
+	__atomic_store_n(&audio_ctx->dropped_buffers, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&audio_ctx->overflows, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&audio_ctx->underflows, 0, __ATOMIC_RELAXED);
+
 	int err = 0;
 
 	switch(audio_api)
@@ -577,6 +580,13 @@ int audio_stop(audio_context_t *audio_ctx)
 			break;
 	}
 
+	if(verbosity > 0 && audio_ctx)
+		printf("AUDIO: capture stopped (dropped buffers: %" PRIu64
+			" device overflows: %" PRIu64 " underflows: %" PRIu64 ")\n",
+			__atomic_load_n(&audio_ctx->dropped_buffers, __ATOMIC_RELAXED),
+			__atomic_load_n(&audio_ctx->overflows, __ATOMIC_RELAXED),
+			__atomic_load_n(&audio_ctx->underflows, __ATOMIC_RELAXED));
+
 	/*free the ring buffer (if any)*/
 	audio_free_buffers();
 		
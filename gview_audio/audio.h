@@ -32,16 +32,19 @@
 #include "gviewaudio.h"
 
 /*
- * fill a audio buffer data and move write index to next one
+ * write captured samples to the fifo (called from the device callback)
+ *  never locks, allocates or prints, so it is safe for realtime threads
  * args:
  *   audio_ctx - pointer to audio context data
- *   ts - timestamp for end of data
+ *   samples - pointer to interleaved samples (NULL for silence)
+ *   nsamples - number of samples (frames * channels)
+ *   ts - real timestamp of the first sample (in nanosec)
  *
  * asserts:
  *   audio_ctx is not null
  *
  * returns: none
  */
-void audio_fill_buffer(audio_context_t *audio_ctx, int64_t ts);
+void audio_fifo_write(audio_context_t *audio_ctx, const sample_t *samples, int nsamples, int64_t ts);
 
 #endif
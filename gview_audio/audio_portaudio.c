@@ -43,8 +43,6 @@
 
 extern int verbosity;
 
-static int sample_index = 0;
-
 #define DEFAULT_LATENCY_DURATION 100.0
 
 /*
@@ -75,29 +73,18 @@ static int recordCallback (
 	/*asserts*/
 	assert(audio_ctx != NULL);
 	
-	if(audio_ctx->channels == 0)
-	{
-		fprintf(stderr, "AUDIO: (portaudio) recordCallback failed: channels = 0\n");
-		return (paContinue);
-	}
-	
-	if(audio_ctx->samprate == 0)
-	{
-		fprintf(stderr, "AUDIO: (portaudio) recordCallback failed: samprate = 0\n");
-		return (paContinue);
-	}
-
-	uint32_t i = 0;
-
-	sample_t *rptr = (sample_t*) inputBuffer;
-	sample_t *capture_buff = (sample_t *) audio_ctx->capture_buff;
+	/*
+	 * this runs on the portaudio realtime thread:
+	 *  no locks, allocations or stdio from here on
+	 */
+	if(audio_ctx->channels == 0 || audio_ctx->samprate == 0)
+		return (paContinue); /*not configured*/
 
 	unsigned long numSamples = framesPerBuffer * audio_ctx->channels;
 	uint64_t frame_length = NSEC_PER_SEC / audio_ctx->samprate; /*in nanosec (is never 0)*/
 
 	PaTime ts_sec = timeInfo->inputBufferAdcTime; /*in seconds (double)*/
 	int64_t ts = ts_sec * NSEC_PER_SEC; /*in nanosec (monotonic time)*/
-	int64_t buff_ts = 0;
 
 	/*determine the number of samples dropped*/
 	if(audio_ctx->last_ts <= 0)
@@ -107,60 +94,19 @@ static int recordCallback (
 
 	if(statusFlags & paInputOverflow)
 	{
-		fprintf( stderr, "AUDIO: portaudio buffer overflow\n" );
+		__atomic_add_fetch(&audio_ctx->overflows, 1, __ATOMIC_RELAXED);
 
+		/*compensate the lost samples with silence*/
 		int64_t d_ts = ts - audio_ctx->last_ts;
-		uint32_t n_samples = (d_ts / frame_length) * audio_ctx->channels;
-		for( i = 0; i < n_samples; ++i )
-		{
-			capture_buff[sample_index] = 0;
-			sample_index++;
-
-			if(sample_index >= audio_ctx->capture_buff_size)
-			{
-				audio_fill_buffer(audio_ctx, audio_ctx->last_ts);
-				sample_index = 0;
-			}
-		}
-
-		if(verbosity > 1)
-			printf("AUDIO: compensate overflow with %i silence samples\n", n_samples);
+		if(d_ts > 0)
+			audio_fifo_write(audio_ctx, NULL,
+				(int) (d_ts / frame_length) * audio_ctx->channels, audio_ctx->last_ts);
 	}
 	if(statusFlags & paInputUnderflow)
-		fprintf( stderr, "AUDIO: portaudio buffer underflow\n" );
-
-	if(sample_index == 0)
-	{
-		audio_ctx->capture_buff_level[0] = 0;
-		audio_ctx->capture_buff_level[1] = 0;
-	}
+		__atomic_add_fetch(&audio_ctx->underflows, 1, __ATOMIC_RELAXED);
 
-	int chan = 0;
-	/*store capture samples*/
-	for( i = 0; i < numSamples; ++i )
-    {
-        capture_buff[sample_index] = inputBuffer ? *rptr++ : 0;
-        sample_index++;
-
-		/*store peak value*/
-		if(audio_ctx->capture_buff_level[chan] < capture_buff[sample_index])
-			audio_ctx->capture_buff_level[chan] = capture_buff[sample_index];
-		chan++;
-		if(chan >= audio_ctx->channels)
-			chan = 0;
-
-        if(sample_index >= audio_ctx->capture_buff_size)
-		{
-			buff_ts = ts + ( i / audio_ctx->channels ) * frame_length;
-
-			audio_fill_buffer(audio_ctx, buff_ts);
-
-			/*reset*/
-			audio_ctx->capture_buff_level[0] = 0;
-			audio_ctx->capture_buff_level[1] = 0;
-			sample_index = 0;
-		}
-	}
+	/*store capture samples (silence if no input)*/
+	audio_fifo_write(audio_ctx, (const sample_t *) inputBuffer, numSamples, ts);
 
 	audio_ctx->last_ts = ts + (framesPerBuffer * frame_length);
 
@@ -43,8 +43,6 @@
 
 extern int verbosity;
 
-static int sample_index = 0;
-
 
 // From pulsecore/macro.h
 #define pa_memzero(x,l) (memset((x), 0, (l)))
@@ -398,11 +396,9 @@ static void get_latency(pa_stream *s)
 
 	pa_stream_get_timing_info(s);
 
+	/*called from the read path: on failure just keep the last value*/
 	if (pa_stream_get_latency(s, &l, &negative) != 0)
-	{
-		fprintf(stderr, "AUDIO: Pulseaudio pa_stream_get_latency() failed\n");
 		return;
-	}
 
 	//latency = l * (negative?-1:1);
 	latency = l; /*can only be negative in monitoring streams*/
@@ -427,22 +423,14 @@ static void stream_request_cb(pa_stream *s, size_t length, void *data)
 
     audio_context_t *audio_ctx = (audio_context_t *) data;
 
-	if(audio_ctx->channels == 0)
-	{
-		fprintf(stderr, "AUDIO: (pulseaudio) stream_request_cb failed: channels = 0\n");
-		return;
-	}
-	
-	if(audio_ctx->samprate == 0)
-	{
-		fprintf(stderr, "AUDIO: (pulseaudio) stream_request_cb failed: samprate = 0\n");
-		return;
-	}
-	
-	uint64_t frame_length = NSEC_PER_SEC / audio_ctx->samprate; /*in nanosec*/
+	/*
+	 * read path: no locks, allocations or stdio,
+	 *  errors are only reflected in the context counters
+	 */
+	if(audio_ctx->channels == 0 || audio_ctx->samprate == 0)
+		return; /*not configured*/
+
 	int64_t ts = 0;
-	int64_t buff_ts = 0;
-	uint32_t i = 0;
 
 	while (pa_stream_readable_size(s) > 0)
 	{
@@ -451,16 +439,10 @@ static void stream_request_cb(pa_stream *s, size_t length, void *data)
 
 		/*read from stream*/
 		if (pa_stream_peek(s, &inputBuffer, &length) < 0)
-		{
-			fprintf(stderr, "AUDIO: (pulseaudio) pa_stream_peek() failed\n");
-			return;
-		}
+			return; /*try again on the next request*/
 
 		if(length == 0)
-		{
-			fprintf(stderr, "AUDIO: (pulseaudio) empty buffer!\n");
 			return; /*buffer is empty*/
-		}
 
 		get_latency(s);
 
@@ -469,38 +451,13 @@ static void stream_request_cb(pa_stream *s, size_t length, void *data)
 		if(audio_ctx->last_ts <= 0)
 			audio_ctx->last_ts = ts;
 
+		/*a hole (no data) is stored as silence*/
+		if(!inputBuffer)
+			__atomic_add_fetch(&audio_ctx->underflows, 1, __ATOMIC_RELAXED);
 
-		uint32_t numSamples = (uint32_t) length / sizeof(sample_t);
-
-		const sample_t *rptr = (const sample_t*) inputBuffer;
-		sample_t *capture_buff = (sample_t *) audio_ctx->capture_buff;
-
-		int chan = 0;
-		/*store capture samples or silence if inputBuffer == NULL (hole)*/
-		for( i = 0; i < numSamples; ++i )
-		{
-			capture_buff[sample_index] = inputBuffer ? *rptr++ : 0;
-			sample_index++;
-
-			/*store peak value*/
-			if(audio_ctx->capture_buff_level[chan] < capture_buff[sample_index])
-				audio_ctx->capture_buff_level[chan] = capture_buff[sample_index];
-			chan++;
-			if(chan >= audio_ctx->channels)
-				chan = 0;
-
-			if(sample_index >= audio_ctx->capture_buff_size)
-			{
-				buff_ts = ts + ( i / audio_ctx->channels ) * frame_length;
-
-				audio_fill_buffer(audio_ctx, buff_ts);
-
-				/*reset*/
-				audio_ctx->capture_buff_level[0] = 0;
-				audio_ctx->capture_buff_level[1] = 0;
-				sample_index = 0;
-			}
-		}
+		/*store capture samples*/
+		audio_fifo_write(audio_ctx, (const sample_t *) inputBuffer,
+			(int) (length / sizeof(sample_t)), ts);
 
 		pa_stream_drop(s); /*clean the samples*/
 	}
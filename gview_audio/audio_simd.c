@@ -0,0 +1,451 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "gview.h"
+#include "audio_simd.h"
+#include "../config.h"
+
+#if defined(ENABLE_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AUDIO_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(ENABLE_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define AUDIO_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+static audio_simd_t audio_simd =
+{
+	.name = "scalar",
+	.float_to_s16 = NULL,
+	.deinterleave2_float = NULL,
+	.deinterleave2_s16 = NULL,
+};
+
+static pthread_once_t audio_simd_once = PTHREAD_ONCE_INIT;
+
+#ifdef AUDIO_SIMD_X86
+
+/*------------------------------- SSE2 ---------------------------------------*/
+
+/*
+ * 4 float samples to int32 (scaled, saturated to int16 range)
+ *  the float clamp is needed: cvtps returns INT32_MIN on overflow
+ */
+__attribute__((target("sse2")))
+static inline __m128i cvt_s32_sse2(__m128 a)
+{
+	a = _mm_mul_ps(a, _mm_set1_ps(INT16_MAX));
+	a = _mm_min_ps(_mm_max_ps(a, _mm_set1_ps(INT16_MIN)), _mm_set1_ps(INT16_MAX));
+	return _mm_cvtps_epi32(a);
+}
+
+__attribute__((target("sse2")))
+static int float_to_s16_sse2(int16_t *out, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		__m128i a = cvt_s32_sse2(_mm_loadu_ps(in + i));
+		__m128i b = cvt_s32_sse2(_mm_loadu_ps(in + i + 4));
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(a, b));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static int deinterleave2_float_sse2(float *out0, float *out1, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		__m128 a = _mm_loadu_ps(in + 2 * i);
+		__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+		_mm_storeu_ps(out0 + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(out1 + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static int deinterleave2_s16_sse2(int16_t *out0, int16_t *out1, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		__m128 a = _mm_loadu_ps(in + 2 * i);
+		__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+		__m128 c = _mm_loadu_ps(in + 2 * i + 8);
+		__m128 d = _mm_loadu_ps(in + 2 * i + 12);
+
+		__m128i l0 = cvt_s32_sse2(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i l1 = cvt_s32_sse2(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i r0 = cvt_s32_sse2(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		__m128i r1 = cvt_s32_sse2(_mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		_mm_storeu_si128((__m128i *) (out0 + i), _mm_packs_epi32(l0, l1));
+		_mm_storeu_si128((__m128i *) (out1 + i), _mm_packs_epi32(r0, r1));
+	}
+
+	return i;
+}
+
+/*------------------------------- AVX2 ---------------------------------------*/
+
+__attribute__((target("avx2")))
+static inline __m256i cvt_s32_avx2(__m256 a)
+{
+	a = _mm256_mul_ps(a, _mm256_set1_ps(INT16_MAX));
+	a = _mm256_min_ps(_mm256_max_ps(a, _mm256_set1_ps(INT16_MIN)), _mm256_set1_ps(INT16_MAX));
+	return _mm256_cvtps_epi32(a);
+}
+
+/*
+ * saturated pack of 2x8 int32 to 16 int16 (in order)
+ *  packs works per 128 bit lane, so fix the qword order
+ */
+__attribute__((target("avx2")))
+static inline __m256i pack_s16_avx2(__m256i a, __m256i b)
+{
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+}
+
+/*
+ * 8 interleaved stereo frames (a holds 0-3, b 4-7) to one channel
+ *  sel picks the channel from each pair (in lane order)
+ */
+#define DEINTERLEAVE2_AVX2(a, b, sel) \
+	_mm256_castpd_ps(_mm256_permute4x64_pd( \
+		_mm256_castps_pd(_mm256_shuffle_ps(a, b, sel)), 0xD8))
+
+__attribute__((target("avx2")))
+static int float_to_s16_avx2(int16_t *out, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		__m256i a = cvt_s32_avx2(_mm256_loadu_ps(in + i));
+		__m256i b = cvt_s32_avx2(_mm256_loadu_ps(in + i + 8));
+		_mm256_storeu_si256((__m256i *) (out + i), pack_s16_avx2(a, b));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static int deinterleave2_float_avx2(float *out0, float *out1, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		__m256 a = _mm256_loadu_ps(in + 2 * i);
+		__m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+		_mm256_storeu_ps(out0 + i, DEINTERLEAVE2_AVX2(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm256_storeu_ps(out1 + i, DEINTERLEAVE2_AVX2(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static int deinterleave2_s16_avx2(int16_t *out0, int16_t *out1, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		__m256 a = _mm256_loadu_ps(in + 2 * i);
+		__m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+		__m256 c = _mm256_loadu_ps(in + 2 * i + 16);
+		__m256 d = _mm256_loadu_ps(in + 2 * i + 24);
+
+		__m256i l0 = cvt_s32_avx2(DEINTERLEAVE2_AVX2(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m256i l1 = cvt_s32_avx2(DEINTERLEAVE2_AVX2(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m256i r0 = cvt_s32_avx2(DEINTERLEAVE2_AVX2(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		__m256i r1 = cvt_s32_avx2(DEINTERLEAVE2_AVX2(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		_mm256_storeu_si256((__m256i *) (out0 + i), pack_s16_avx2(l0, l1));
+		_mm256_storeu_si256((__m256i *) (out1 + i), pack_s16_avx2(r0, r1));
+	}
+
+	return i;
+}
+
+#endif /*AUDIO_SIMD_X86*/
+
+#ifdef AUDIO_SIMD_NEON
+
+/*
+ * 4 float samples to int16 (scaled, rounded and saturated)
+ *  the neon converts saturate, so no clamp is needed
+ */
+static inline int16x4_t cvt_s16_neon(float32x4_t a)
+{
+	a = vmulq_n_f32(a, INT16_MAX);
+#if defined(__aarch64__)
+	return vqmovn_s32(vcvtnq_s32_f32(a));
+#else
+	/*armv7 only truncates: round half away from zero*/
+	uint32x4_t neg = vcltq_f32(a, vdupq_n_f32(0));
+	a = vaddq_f32(a, vbslq_f32(neg, vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f)));
+	return vqmovn_s32(vcvtq_s32_f32(a));
+#endif
+}
+
+static int float_to_s16_neon(int16_t *out, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 8 <= n; i += 8)
+		vst1q_s16(out + i, vcombine_s16(cvt_s16_neon(vld1q_f32(in + i)),
+			cvt_s16_neon(vld1q_f32(in + i + 4))));
+
+	return i;
+}
+
+static int deinterleave2_float_neon(float *out0, float *out1, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		float32x4x2_t v = vld2q_f32(in + 2 * i);
+		vst1q_f32(out0 + i, v.val[0]);
+		vst1q_f32(out1 + i, v.val[1]);
+	}
+
+	return i;
+}
+
+static int deinterleave2_s16_neon(int16_t *out0, int16_t *out1, const float *in, int n)
+{
+	int i = 0;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		float32x4x2_t a = vld2q_f32(in + 2 * i);
+		float32x4x2_t b = vld2q_f32(in + 2 * i + 8);
+		vst1q_s16(out0 + i, vcombine_s16(cvt_s16_neon(a.val[0]), cvt_s16_neon(b.val[0])));
+		vst1q_s16(out1 + i, vcombine_s16(cvt_s16_neon(a.val[1]), cvt_s16_neon(b.val[1])));
+	}
+
+	return i;
+}
+
+#endif /*AUDIO_SIMD_NEON*/
+
+/*
+ * select the kernels for the running cpu
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void audio_init_simd()
+{
+	/*GUVCVIEW_NO_SIMD forces the scalar (reference) code*/
+	char *env = getenv("GUVCVIEW_NO_SIMD");
+	if(env != NULL && strcmp(env, "0") != 0)
+		return;
+
+#ifdef AUDIO_SIMD_X86
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2"))
+	{
+		audio_simd.name = "avx2";
+		audio_simd.float_to_s16 = float_to_s16_avx2;
+		audio_simd.deinterleave2_float = deinterleave2_float_avx2;
+		audio_simd.deinterleave2_s16 = deinterleave2_s16_avx2;
+	}
+	else if(__builtin_cpu_supports("sse2"))
+	{
+		audio_simd.name = "sse2";
+		audio_simd.float_to_s16 = float_to_s16_sse2;
+		audio_simd.deinterleave2_float = deinterleave2_float_sse2;
+		audio_simd.deinterleave2_s16 = deinterleave2_s16_sse2;
+	}
+#endif
+
+#ifdef AUDIO_SIMD_NEON
+	audio_simd.name = "neon";
+	audio_simd.float_to_s16 = float_to_s16_neon;
+	audio_simd.deinterleave2_float = deinterleave2_float_neon;
+	audio_simd.deinterleave2_s16 = deinterleave2_s16_neon;
+#endif
+}
+
+/*
+ * get the sample kernels for the running cpu
+ *  (resolved once, on first use)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to kernel table (never NULL)
+ */
+const audio_simd_t *audio_get_simd()
+{
+	pthread_once(&audio_simd_once, audio_init_simd);
+	return &audio_simd;
+}
+
+/*
+ * saturate float samples to int16 limits
+ *  (rounds to nearest, like the vector kernels)
+ */
+static inline int16_t clip_int16 (float in)
+{
+	if(!(in > INT16_MIN))
+		return INT16_MIN; /*also catches nan*/
+	if(in > INT16_MAX)
+		return INT16_MAX;
+
+	return (int16_t) lrintf(in);
+}
+
+/*
+ * convert float samples to int16
+ * args:
+ *   out - pointer to int16 samples
+ *   in - pointer to float samples
+ *   n - number of samples
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_samples_to_s16(int16_t *out, const float *in, int n)
+{
+	const audio_simd_t *simd = audio_get_simd();
+
+	int i = simd->float_to_s16 ? simd->float_to_s16(out, in, n) : 0;
+
+	for(; i < n; ++i)
+		out[i] = clip_int16(in[i] * INT16_MAX);
+}
+
+/*
+ * deinterleave float samples into float planes
+ * args:
+ *   out - pointer to planes (plane j starts at out + j * frames)
+ *   in - pointer to interleaved samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_samples_to_float_planes(float *out, const float *in, int channels, int frames)
+{
+	if(channels == 1)
+	{
+		memcpy(out, in, frames * sizeof(float));
+		return;
+	}
+
+	const audio_simd_t *simd = audio_get_simd();
+
+	int i = 0;
+	if(channels == 2 && simd->deinterleave2_float)
+		i = simd->deinterleave2_float(out, out + frames, in, frames);
+
+	/*one plane at a time (the source buffer stays in cache)*/
+	int j = 0;
+	for(j = 0; j < channels; ++j)
+	{
+		float *po = out + j * frames;
+		const float *pi = in + j;
+		int k = 0;
+		for(k = i; k < frames; ++k)
+			po[k] = pi[k * channels];
+	}
+}
+
+/*
+ * deinterleave float samples into int16 planes
+ *  (conversion is done in the same pass)
+ * args:
+ *   out - pointer to planes (plane j starts at out + j * frames)
+ *   in - pointer to interleaved samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_samples_to_s16_planes(int16_t *out, const float *in, int channels, int frames)
+{
+	if(channels == 1)
+	{
+		audio_samples_to_s16(out, in, frames);
+		return;
+	}
+
+	const audio_simd_t *simd = audio_get_simd();
+
+	int i = 0;
+	if(channels == 2 && simd->deinterleave2_s16)
+		i = simd->deinterleave2_s16(out, out + frames, in, frames);
+
+	/*
+	 * one plane at a time (the source buffer stays in cache),
+	 *  gathered in small chunks so the conversion is still vectorized
+	 */
+	float chunk[256];
+	int j = 0;
+	for(j = 0; j < channels; ++j)
+	{
+		int16_t *po = out + j * frames;
+		const float *pi = in + j;
+		int k = 0;
+		for(k = i; k < frames; k += 256)
+		{
+			int n = frames - k < 256 ? frames - k : 256;
+			int m = 0;
+			for(m = 0; m < n; ++m)
+				chunk[m] = pi[(k + m) * channels];
+			audio_samples_to_s16(po + k, chunk, n);
+		}
+	}
+}
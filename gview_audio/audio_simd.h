@@ -0,0 +1,108 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef AUDIO_SIMD_H
+#define AUDIO_SIMD_H
+
+#include <inttypes.h>
+
+/*
+ * vectorized sample kernels used by audio_get_next_buffer
+ *  each kernel processes the largest multiple of its vector width
+ *  and returns the number of samples (or frames) done, the caller
+ *  finishes the buffer with the scalar code.
+ *  int16 conversion scales by INT16_MAX, rounds to nearest and saturates.
+ *  A NULL kernel means no vector version is available for this cpu.
+ */
+typedef struct _audio_simd_t
+{
+	const char *name; /*selected instruction set (scalar, sse2, avx2, neon)*/
+
+	/*n float samples to int16*/
+	int (*float_to_s16)(int16_t *out, const float *in, int n);
+
+	/*n interleaved stereo float frames to planar float*/
+	int (*deinterleave2_float)(float *out0, float *out1, const float *in, int n);
+
+	/*n interleaved stereo float frames to planar int16 (fused conversion)*/
+	int (*deinterleave2_s16)(int16_t *out0, int16_t *out1, const float *in, int n);
+} audio_simd_t;
+
+/*
+ * get the sample kernels for the running cpu
+ *  (resolved once, on first use)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to kernel table (never NULL)
+ */
+const audio_simd_t *audio_get_simd();
+
+/*
+ * convert float samples to int16
+ *  (vector kernel and scalar code for the tail)
+ * args:
+ *   out - pointer to int16 samples
+ *   in - pointer to float samples
+ *   n - number of samples
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_samples_to_s16(int16_t *out, const float *in, int n);
+
+/*
+ * deinterleave float samples into float planes
+ * args:
+ *   out - pointer to planes (plane j starts at out + j * frames)
+ *   in - pointer to interleaved samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_samples_to_float_planes(float *out, const float *in, int channels, int frames);
+
+/*
+ * deinterleave float samples into int16 planes
+ *  (conversion is done in the same pass)
+ * args:
+ *   out - pointer to planes (plane j starts at out + j * frames)
+ *   in - pointer to interleaved samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_samples_to_s16_planes(int16_t *out, const float *in, int channels, int frames);
+
+#endif
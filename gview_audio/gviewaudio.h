@@ -115,6 +115,11 @@ typedef struct _audio_context_t
 
 	int stream_flag;             /*stream flag*/
 
+	/*capture fifo counters (atomic - updated by the capture callback)*/
+	uint64_t dropped_buffers;     /*buffers dropped with a full ring*/
+	uint64_t overflows;           /*device input overflows (lost samples)*/
+	uint64_t underflows;          /*device input underflows (holes)*/
+
 } audio_context_t;
 
 /*
@@ -626,6 +626,9 @@ avi_context_t *avi_create_context(const char *filename)
 		return NULL;
 	}
 
+	/*write to disk in the background (double buffered)*/
+	io_set_async(avi_ctx->writer);
+
 	avi_ctx->flags = 0; /*recordind*/
 
 	avi_ctx->riff_list = NULL;
@@ -40,6 +40,7 @@
 #include <linux/videodev2.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 /* support for internationalization - i18n */
 #include <locale.h>
 #include <libintl.h>
@@ -56,9 +57,23 @@
 
 int verbosity = 0;
 
-/*video buffer data mutex*/
+/*
+ * the video ring buffer is a single producer (capture thread)
+ * single consumer (encoder thread) queue:
+ *   each slot flag is stored with release and loaded with acquire
+ *   semantics, so the frame data is visible before the flag flips;
+ *   video_write_index is only touched by the producer and
+ *   video_read_index by the consumer.
+ * The mutex and condition are only used to park the consumer
+ * while the ring is empty.
+ */
 static __MUTEX_TYPE mutex = __STATIC_MUTEX_INIT;
 #define __PMUTEX &mutex
+static __COND_TYPE video_cond = PTHREAD_COND_INITIALIZER;
+static int video_consumer_waiting = 0;
+
+#define __VFLAG_LOAD(ind) (__atomic_load_n(&video_ring_buffer[(ind)].flag, __ATOMIC_ACQUIRE))
+#define __VFLAG_STORE(ind, f) (__atomic_store_n(&video_ring_buffer[(ind)].flag, (f), __ATOMIC_RELEASE))
 
 static int valid_video_codecs = 0;
 static int valid_audio_codecs = 0;
@@ -75,6 +90,67 @@ static int video_read_index = 0;
 static int video_write_index = 0;
 static int video_scheduler = 0;
 
+/*
+ * ring buffer memory budget (bytes):
+ *   copied frames are only accepted while their queued bytes fit the
+ *   budget (referenced frames are not copied, they are bounded by the
+ *   ring slots and the device buffers and don't count);
+ *   copied frames are stored in a circular arena of budget size (allocated
+ *   with the first copied frame): the ring is consumed in order, so the
+ *   queued frames always use a single region (that may wrap around);
+ *   frames go back to the start of the arena whenever the encoder has
+ *   caught up (no queued copies), so only the memory needed by the
+ *   backlog is ever touched
+ */
+#define VIDEO_ARENA_ALIGN (64)
+#define VIDEO_BUDGET_AUTO_MAX (256 * 1024 * 1024) /*auto budget limit*/
+static size_t video_buffer_budget_req = 0; /*requested budget (0 - auto)*/
+static size_t video_buffer_budget = 0;     /*effective budget*/
+static size_t video_bytes_queued = 0;      /*producer adds, consumer subtracts (atomic)*/
+static size_t video_bytes_allocated = 0;   /*arena high-water mark (producer only)*/
+
+static uint8_t *video_arena = NULL;  /*copied frames (producer only)*/
+static size_t video_arena_head = 0;  /*next free offset (producer only)*/
+
+/*producer side statistics (capture thread)*/
+static uint64_t video_frames_added = 0;
+static uint64_t video_frames_dropped = 0;
+static uint64_t video_add_time_total = 0; /*nanosec*/
+static uint64_t video_add_time_max = 0;   /*nanosec*/
+static size_t video_bytes_queued_max = 0; /*high-water mark*/
+static int video_frames_queued_max = 0;   /*high-water mark*/
+
+/*consumer side statistics (encoder thread)*/
+static uint64_t video_frames_encoded = 0;
+static uint64_t video_encode_time_total = 0; /*nanosec*/
+
+/*stage times of the last processed frame (encoder thread)*/
+static encoder_video_timing_t video_timing;
+
+/*video codec threading overrides (see encoder_set_video_threading)*/
+static int video_threads = 0;
+static int video_thread_type = ENCODER_THREAD_AUTO;
+static int video_lookahead = -1;
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t encoder_time_ns()
+{
+	struct timespec now;
+	if(clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+		return 0;
+
+	return ((uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec);
+}
+
 /*
  * set verbosity
  * args:
@@ -90,6 +166,64 @@ void encoder_set_verbosity(int value)
 	verbosity = value;
 }
 
+/*
+ * set the video ring buffer memory budget (copied frames)
+ *  (must be set before encoder_get_context)
+ * args:
+ *   size - budget in bytes (0 - auto: 1.5 sec of frames up to 256 MB)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void encoder_set_video_buffer_budget(size_t size)
+{
+	video_buffer_budget_req = size;
+}
+
+/*
+ * override the video codec threading defaults
+ *  (must be set before encoder_get_context)
+ * args:
+ *   threads - number of encoder threads (0 - use codec defaults)
+ *   thread_type - ENCODER_THREAD_[AUTO|FRAME|SLICE] (AUTO - use codec defaults)
+ *   lookahead - rc lookahead in frames (-1 - use codec defaults)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void encoder_set_video_threading(int threads, int thread_type, int lookahead)
+{
+	video_threads = threads > ENCODER_MAX_THREADS ? ENCODER_MAX_THREADS : threads;
+	video_thread_type = thread_type;
+	video_lookahead = lookahead;
+}
+
+/*
+ * get the default number of encoder threads (number of online cores)
+ * args:
+ *   none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of threads [1 - ENCODER_MAX_THREADS]
+ */
+static int encoder_get_default_threads()
+{
+	long ncores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(ncores < 1)
+		ncores = 1;
+	if(ncores > ENCODER_MAX_THREADS)
+		ncores = ENCODER_MAX_THREADS;
+
+	return (int) ncores;
+}
+
 /*
  * convert yuyv to yuv420p
  * args:
@@ -212,17 +346,54 @@ static void encoder_alloc_video_ring_buffer(
 	else
 		video_frame_max_size = video_width * video_height * 3; //RGB formats
 		
+	/*
+	 * copied frames get their memory from the arena,
+	 * referenced frames (encoder_add_video_frame_ref) don't need any
+	 */
 	int i = 0;
 	for(i = 0; i < video_ring_buffer_size; ++i)
 	{
-		video_ring_buffer[i].frame = calloc(video_frame_max_size, sizeof(uint8_t));
-		if(video_ring_buffer[i].frame == NULL)
-		{
-			fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_alloc_video_ring_buffer): %s\n", strerror(errno));
-			exit(-1);
-		}
+		video_ring_buffer[i].frame = NULL;
+		video_ring_buffer[i].ref_frame = NULL;
+		video_ring_buffer[i].release = NULL;
+		video_ring_buffer[i].release_data = NULL;
 		video_ring_buffer[i].flag = VIDEO_BUFF_FREE;
 	}
+
+	video_read_index = 0;
+	video_write_index = 0;
+
+	/*memory budget*/
+	video_buffer_budget = video_buffer_budget_req;
+	if(video_buffer_budget == 0)
+	{
+		video_buffer_budget = (size_t) video_ring_buffer_size * video_frame_max_size;
+		if(video_buffer_budget > VIDEO_BUDGET_AUTO_MAX)
+			video_buffer_budget = VIDEO_BUDGET_AUTO_MAX;
+	}
+	/*always fit a few full frames*/
+	if(video_buffer_budget < (size_t) video_frame_max_size * 4)
+		video_buffer_budget = (size_t) video_frame_max_size * 4;
+
+	video_arena = NULL;
+	video_arena_head = 0;
+
+	if(verbosity > 0)
+		printf("ENCODER: video ring buffer with %i slots and a %zu kB budget\n",
+			video_ring_buffer_size, video_buffer_budget / 1024);
+
+	video_bytes_queued = 0;
+	video_bytes_allocated = 0;
+
+	video_frames_added = 0;
+	video_frames_dropped = 0;
+	video_add_time_total = 0;
+	video_add_time_max = 0;
+	video_bytes_queued_max = 0;
+	video_frames_queued_max = 0;
+	video_frames_encoded = 0;
+	video_encode_time_total = 0;
+	memset(&video_timing, 0, sizeof(encoder_video_timing_t));
 }
 
 /*
@@ -240,14 +411,38 @@ static void encoder_clean_video_ring_buffer()
 	if(!video_ring_buffer)
 		return;
 
+	if(verbosity > 0 && video_frames_added > 0)
+		printf("ENCODER: video ring buffer: %" PRIu64 " frames added (%" PRIu64 " dropped) - add time avg %" PRIu64 " ns max %" PRIu64 " ns\n",
+			video_frames_added,
+			video_frames_dropped,
+			video_add_time_total / video_frames_added,
+			video_add_time_max);
+	if(verbosity > 0 && video_frames_encoded > 0)
+		printf("ENCODER: video encoder: %" PRIu64 " frames - encode time avg %" PRIu64 " us (%.1f fps)\n",
+			video_frames_encoded,
+			video_encode_time_total / (video_frames_encoded * 1000),
+			(double) video_frames_encoded * 1E9 / (double) (video_encode_time_total ? video_encode_time_total : 1));
+	if(verbosity > 0)
+		printf("ENCODER: video ring buffer high-water: %i frames, %zu kB queued, %zu kB of arena used (budget %zu kB)\n",
+			video_frames_queued_max,
+			video_bytes_queued_max / 1024,
+			video_bytes_allocated / 1024,
+			video_buffer_budget / 1024);
+
 	int i = 0;
 	for(i = 0; i < video_ring_buffer_size; ++i)
 	{
-		/*Max: (yuyv) 2 bytes per pixel*/
-		free(video_ring_buffer[i].frame);
+		/*drop any frame references still in the ring*/
+		if(video_ring_buffer[i].release != NULL)
+			video_ring_buffer[i].release(video_ring_buffer[i].release_data);
+		video_ring_buffer[i].release = NULL;
 	}
 	free(video_ring_buffer);
 	video_ring_buffer = NULL;
+
+	free(video_arena);
+	video_arena = NULL;
+	video_arena_head = 0;
 }
 
 /*
@@ -383,6 +578,31 @@ static encoder_video_context_t *encoder_video_init(encoder_context_t *encoder_ct
 		return (enc_video_ctx);
 	}
 
+	/*
+	 * external mjpg encoder: frames are coded in encoder_encode_video
+	 * and from there on handled as raw mjpg input
+	 */
+	if(video_defaults->codec_id == AV_CODEC_ID_MJPEG && encoder_ctx->mjpg_frame_encoder != NULL)
+	{
+		if(verbosity > 0)
+			printf("ENCODER: video codec MJPG using the external frame encoder\n");
+
+		encoder_ctx->input_format = V4L2_PIX_FMT_MJPEG;
+		encoder_set_raw_video_input(encoder_ctx, encoder_get_video_codec_defaults(0));
+
+		/*coded frames can be larger than the ones from the camera*/
+		free(enc_video_ctx->outbuf);
+		enc_video_ctx->outbuf_size = encoder_ctx->video_width * encoder_ctx->video_height * 2;
+		enc_video_ctx->outbuf = calloc(enc_video_ctx->outbuf_size, sizeof(uint8_t));
+		if(enc_video_ctx->outbuf == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_video_init): %s\n", strerror(errno));
+			exit(-1);
+		}
+
+		return (enc_video_ctx);
+	}
+
 	/*
 	 * alloc the video codec data 
 	 */
@@ -434,8 +654,31 @@ static encoder_video_context_t *encoder_video_init(encoder_context_t *encoder_ct
 	video_codec_data->codec_context->height = encoder_ctx->video_height;
 
 	video_codec_data->codec_context->flags |= video_defaults->flags;
-	if (video_defaults->num_threads > 0)
-		video_codec_data->codec_context->thread_count = video_defaults->num_threads;
+
+	/*threading: command line overrides, then codec defaults, then core count*/
+	int threads = video_threads;
+	if(threads <= 0)
+		threads = video_defaults->num_threads;
+	if(threads <= 0)
+		threads = encoder_get_default_threads();
+	video_codec_data->codec_context->thread_count = threads;
+
+	int thread_type = video_thread_type;
+	if(thread_type == ENCODER_THREAD_AUTO)
+		thread_type = video_defaults->thread_type;
+#ifdef FF_THREAD_FRAME
+	if(thread_type == ENCODER_THREAD_FRAME)
+		video_codec_data->codec_context->thread_type = FF_THREAD_FRAME;
+	else if(thread_type == ENCODER_THREAD_SLICE)
+		video_codec_data->codec_context->thread_type = FF_THREAD_SLICE;
+#endif
+
+	if(verbosity > 0)
+		printf("ENCODER: video codec %s using %i thread(s) (type %s)\n",
+			video_defaults->codec_name,
+			threads,
+			thread_type == ENCODER_THREAD_FRAME ? "frame" :
+			(thread_type == ENCODER_THREAD_SLICE ? "slice" : "auto"));
 	/*
 	 * mb_decision:
 	 * 0 (FF_MB_DECISION_SIMPLE) Use mbcmp (default).
@@ -488,15 +731,52 @@ static encoder_video_context_t *encoder_video_init(encoder_context_t *encoder_ct
     else
         video_codec_data->codec_context->gop_size = video_codec_data->codec_context->time_base.den;
 
+	int lookahead = video_lookahead >= 0 ? video_lookahead : video_defaults->lookahead;
+	if(lookahead >= 0)
+	{
+		/*
+		 * lookahead and frame threads both delay the output,
+		 * keep them within the delayed frames pts buffer
+		 */
+		int max_lookahead = MAX_DELAYED_FRAMES - video_defaults->max_b_frames - 2;
+		if(thread_type != ENCODER_THREAD_SLICE)
+			max_lookahead -= threads;
+		if(lookahead > max_lookahead)
+			lookahead = max_lookahead > 0 ? max_lookahead : 0;
+	}
+
+	/*
+	 * rc_lookahead is a libx264 private option (the avcodec_find_encoder
+	 * fallback may pick another H264 encoder) - ignored for other codecs
+	 */
+	int is_x264 = (video_codec_data->codec->name != NULL &&
+		strcmp(video_codec_data->codec->name, "libx264") == 0);
+
 	if(video_defaults->codec_id == AV_CODEC_ID_H264)
 	{
 	   video_codec_data->codec_context->me_range = 16;
 	    //the first compressed frame will be empty (1 frame out of sync)
-	    //but avoids x264 warning on lookaheadless mb-tree
+	    //a lookahead of at least 1 avoids x264 warning on lookaheadless mb-tree
+	    if(is_x264 && lookahead < 1)
+	    	lookahead = 1;
+	}
+
+	if(lookahead >= 0 && !is_x264)
+	{
+		if(verbosity > 0 && video_lookahead >= 0)
+			printf("ENCODER: rc lookahead not supported by %s - ignored\n",
+				video_codec_data->codec->name);
+		lookahead = -1;
+	}
+
+	if(lookahead >= 0)
+	{
 #if LIBAVCODEC_VER_AT_LEAST(53,6)
-	    av_dict_set(&video_codec_data->private_options, "rc_lookahead", "1", 0);
+		char lookahead_str[12];
+		snprintf(lookahead_str, 11, "%i", lookahead);
+		av_dict_set(&video_codec_data->private_options, "rc_lookahead", lookahead_str, 0);
 #else
-	    video_codec_data->codec_context->rc_lookahead=1;
+		video_codec_data->codec_context->rc_lookahead = lookahead;
 #endif
 	}
 
@@ -954,13 +1234,24 @@ uint32_t encoder_buff_scheduler(int mode, double thresh, int max_time)
 	int diff_ind = 0;
 	uint32_t sched_time = 0; /*in milisec*/
 
-	__LOCK_MUTEX( __PMUTEX );
+	if(!video_ring_buffer || video_buffer_budget == 0)
+		return 0;
+
 	/* try to balance buffer overrun in read/write operations */
-	if(video_write_index >= video_read_index)
-		diff_ind = video_write_index - video_read_index;
+	int read_index = __atomic_load_n(&video_read_index, __ATOMIC_ACQUIRE);
+	if(video_write_index >= read_index)
+		diff_ind = video_write_index - read_index;
 	else
-		diff_ind = (video_ring_buffer_size - video_read_index) + video_write_index;
-	__UNLOCK_MUTEX( __PMUTEX );
+		diff_ind = (video_ring_buffer_size - read_index) + video_write_index;
+
+	/*
+	 * throttle on queued bytes (scaled to ring slots) - use the
+	 * slot delta only if the ring runs out of slots first
+	 */
+	size_t queued = __atomic_load_n(&video_bytes_queued, __ATOMIC_ACQUIRE);
+	int bytes_ind = (int) (((double) queued / (double) video_buffer_budget) * video_ring_buffer_size);
+	if(bytes_ind > diff_ind)
+		diff_ind = bytes_ind;
 
 	/*clip ring buffer threshold*/
 	if(thresh < 0.2)
@@ -1058,6 +1349,102 @@ int encoder_get_valid_audio_codecs()
 	return valid_audio_codecs;
 }
 
+/*
+ * close the video codec and free the video context
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+static void encoder_video_close(encoder_context_t *encoder_ctx)
+{
+	//assertions
+	assert(encoder_ctx != NULL);
+
+	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
+	encoder_codec_data_t *video_codec_data = NULL;
+
+	if(enc_video_ctx)
+	{
+		video_codec_data = (encoder_codec_data_t *) enc_video_ctx->codec_data;
+		if(video_codec_data)
+		{
+			if(!(enc_video_ctx->flushed_buffers))
+			{
+				avcodec_flush_buffers(video_codec_data->codec_context);
+				enc_video_ctx->flushed_buffers = 1;
+			}
+			avcodec_close(video_codec_data->codec_context);
+			free(video_codec_data->codec_context);
+
+#if LIBAVCODEC_VER_AT_LEAST(53,6)
+			av_dict_free(&(video_codec_data->private_options));
+#endif
+
+			if(video_codec_data->frame)
+#if LIBAVCODEC_VER_AT_LEAST(55,28)
+				av_frame_free(&video_codec_data->frame);
+#else
+	#if LIBAVCODEC_VER_AT_LEAST(54,28)
+				avcodec_free_frame(&video_codec_data->frame);
+	#else
+				av_freep(&video_codec_data->frame);
+	#endif
+#endif
+			free(video_codec_data);		
+		}
+
+		if(enc_video_ctx->priv_data)
+			free(enc_video_ctx->priv_data);
+		if(enc_video_ctx->tmpbuf)
+			free(enc_video_ctx->tmpbuf);
+		if(enc_video_ctx->outbuf)
+			free(enc_video_ctx->outbuf);
+
+		free(enc_video_ctx);
+	}
+
+	encoder_ctx->enc_video_ctx = NULL;
+}
+
+/*
+ * set an external mjpg frame encoder used instead of libavcodec
+ *  for the MJPG video codec (must be set before adding any frames,
+ *  it's ignored for other codecs)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   encode - frame encoder callback
+ *   data - callback user data
+ *
+ * asserts:
+ *    encoder_ctx is not null
+ *
+ * returns: none
+ */
+void encoder_set_mjpg_frame_encoder(encoder_context_t *encoder_ctx, encoder_mjpg_frame_cb_t encode, void *data)
+{
+	//assertions
+	assert(encoder_ctx != NULL);
+
+	/*raw input (also set if the libav codec wasn't found)*/
+	if(encode == NULL || encoder_ctx->video_codec_ind == 0)
+		return;
+
+	video_codec_t *video_defaults = encoder_get_video_codec_defaults(encoder_ctx->video_codec_ind);
+	if(!video_defaults || video_defaults->codec_id != AV_CODEC_ID_MJPEG)
+		return;
+
+	encoder_ctx->mjpg_frame_encoder = encode;
+	encoder_ctx->mjpg_frame_encoder_data = data;
+
+	/*replace the libav video encoder*/
+	encoder_video_close(encoder_ctx);
+	encoder_video_init(encoder_ctx);
+}
+
 /*
  * initialize and get the encoder context
  * args:
@@ -1135,19 +1522,109 @@ encoder_context_t *encoder_get_context(
 }
 
 /*
- * store unprocessed input video frame in video ring buffer
+ * get memory for a copied frame from the arena
+ *  (producer side: the queued frames are found from the ring slots)
+ * args:
+ *   size - frame size (in bytes)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to the frame memory or NULL if the arena
+ *   is held by queued frames
+ */
+static uint8_t *encoder_arena_alloc(int size)
+{
+	/*aligned and never empty (a used region always has head != tail)*/
+	size_t need = ((size_t) size + VIDEO_ARENA_ALIGN) & ~((size_t) VIDEO_ARENA_ALIGN - 1);
+
+	if(video_arena == NULL)
+	{
+		/*pages are only backed by memory once touched*/
+		video_arena = calloc(video_buffer_budget, sizeof(uint8_t));
+		if(video_arena == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (encoder_arena_alloc): %s\n", strerror(errno));
+			exit(-1);
+		}
+		video_arena_head = 0;
+	}
+
+	/*
+	 * the oldest queued copied frame marks the tail of the used region:
+	 * free slots were released by the consumer (acquire) so it is done
+	 * with their memory, frame is only set by the producer
+	 */
+	int queued = 0;
+	size_t tail = 0;
+	int ind = __atomic_load_n(&video_read_index, __ATOMIC_ACQUIRE);
+	while(ind != video_write_index)
+	{
+		if(__VFLAG_LOAD(ind) != VIDEO_BUFF_FREE && video_ring_buffer[ind].frame != NULL)
+		{
+			tail = (size_t) (video_ring_buffer[ind].frame - video_arena);
+			queued = 1;
+			break;
+		}
+		NEXT_IND(ind, video_ring_buffer_size);
+	}
+
+	size_t offset = 0;
+	if(!queued)
+		offset = 0; /*empty: start over*/
+	else if(video_arena_head > tail)
+	{
+		/*used region [tail, head): wrap around at the end*/
+		if(video_arena_head + need <= video_buffer_budget)
+			offset = video_arena_head;
+		else if(need <= tail)
+			offset = 0;
+		else
+			return NULL;
+	}
+	else
+	{
+		/*used region wraps around: [tail, end) and [0, head)*/
+		if(video_arena_head + need <= tail)
+			offset = video_arena_head;
+		else
+			return NULL;
+	}
+
+	if(offset + need > video_buffer_budget)
+		return NULL;
+
+	video_arena_head = offset + need;
+	if(video_arena_head > video_bytes_allocated)
+		video_bytes_allocated = video_arena_head;
+
+	return video_arena + offset;
+}
+
+/*
+ * store input video frame in video ring buffer
+ *  (producer side of the ring buffer)
  * args:
  *   frame - pointer to unprocessed frame data
  *   size - frame size (in bytes)
  *   timestamp - frame timestamp (in nanosec)
  *   isKeyframe - flag if it's a key(IDR) frame
+ *   release - if not null the frame is referenced (not copied) and
+ *      release(release_data) is called once it's been encoded
+ *   release_data - release callback data
  *
  * asserts:
  *   none
  *
  * returns: error code
  */
-int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp, int isKeyframe)
+static int encoder_push_video_frame(
+	uint8_t *frame,
+	int size,
+	int64_t timestamp,
+	int isKeyframe,
+	void (*release)(void *data),
+	void *release_data)
 {
 	if(!video_ring_buffer)
 		return -1;
@@ -1161,12 +1638,11 @@ int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp, int isK
 
 	int64_t pts = timestamp - reference_pts;
 
-	__LOCK_MUTEX( __PMUTEX );
-	int flag = video_ring_buffer[video_write_index].flag;
-	__UNLOCK_MUTEX( __PMUTEX );
+	uint64_t t_start = encoder_time_ns();
 
-	if(flag != VIDEO_BUFF_FREE)
+	if(__VFLAG_LOAD(video_write_index) != VIDEO_BUFF_FREE)
 	{
+		video_frames_dropped++;
 		fprintf(stderr, "ENCODER: video ring buffer full - dropping frame\n");
 		return -1;
 	}
@@ -1179,71 +1655,285 @@ int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp, int isK
 
 		size = video_frame_max_size;
 	}
-	memcpy(video_ring_buffer[video_write_index].frame, frame, size);
+	size_t queued = __atomic_load_n(&video_bytes_queued, __ATOMIC_ACQUIRE);
+
+	if(release != NULL)
+	{
+		/*not copied: outside the memory budget*/
+		video_ring_buffer[video_write_index].frame = NULL;
+		video_ring_buffer[video_write_index].ref_frame = frame;
+		video_ring_buffer[video_write_index].release = release;
+		video_ring_buffer[video_write_index].release_data = release_data;
+	}
+	else
+	{
+		/*memory budget*/
+		if(queued + size > video_buffer_budget)
+		{
+			video_frames_dropped++;
+			fprintf(stderr, "ENCODER: video ring buffer budget reached (%zu kB queued) - dropping frame\n",
+				queued / 1024);
+			return -1;
+		}
+
+		uint8_t *buff = encoder_arena_alloc(size);
+		if(buff == NULL)
+		{
+			video_frames_dropped++;
+			fprintf(stderr, "ENCODER: video ring buffer arena full (%zu kB queued) - dropping frame\n",
+				queued / 1024);
+			return -1;
+		}
+		video_ring_buffer[video_write_index].frame = buff;
+		memcpy(video_ring_buffer[video_write_index].frame, frame, size);
+		video_ring_buffer[video_write_index].ref_frame = NULL;
+	}
 	video_ring_buffer[video_write_index].frame_size = size;
 	video_ring_buffer[video_write_index].timestamp = pts;
 	video_ring_buffer[video_write_index].keyframe = isKeyframe;
+	video_ring_buffer[video_write_index].enqueue_ts = encoder_time_ns();
 
-	__LOCK_MUTEX( __PMUTEX );
-	video_ring_buffer[video_write_index].flag = VIDEO_BUFF_USED;
+	/*publish the frame*/
+	if(release == NULL)
+		queued = __atomic_add_fetch(&video_bytes_queued, (size_t) size, __ATOMIC_ACQ_REL);
+	__VFLAG_STORE(video_write_index, VIDEO_BUFF_USED);
 	NEXT_IND(video_write_index, video_ring_buffer_size);
-	__UNLOCK_MUTEX( __PMUTEX );
+
+	/*high-water marks*/
+	if(queued > video_bytes_queued_max)
+		video_bytes_queued_max = queued;
+	int read_index = __atomic_load_n(&video_read_index, __ATOMIC_ACQUIRE);
+	int frames_queued = (video_write_index >= read_index) ?
+		video_write_index - read_index :
+		(video_ring_buffer_size - read_index) + video_write_index;
+	if(frames_queued == 0 && __VFLAG_LOAD(video_write_index) != VIDEO_BUFF_FREE)
+		frames_queued = video_ring_buffer_size; /*ring is full*/
+	if(frames_queued > video_frames_queued_max)
+		video_frames_queued_max = frames_queued;
+
+	/*
+	 * order the flag store before the waiting flag load
+	 * (the consumer sets the waiting flag before checking the ring)
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&video_consumer_waiting, __ATOMIC_RELAXED))
+	{
+		__LOCK_MUTEX( __PMUTEX );
+		__COND_SIGNAL(&video_cond);
+		__UNLOCK_MUTEX( __PMUTEX );
+	}
+
+	uint64_t t_add = encoder_time_ns() - t_start;
+	video_frames_added++;
+	video_add_time_total += t_add;
+	if(t_add > video_add_time_max)
+		video_add_time_max = t_add;
 
 	return 0;
 }
 
 /*
- * process next video frame on the ring buffer (encode and mux to file)
+ * store (copy) unprocessed input video frame in video ring buffer
  * args:
- *   encoder_ctx - pointer to encoder context
+ *   frame - pointer to unprocessed frame data
+ *   size - frame size (in bytes)
+ *   timestamp - frame timestamp (in nanosec)
+ *   isKeyframe - flag if it's a key(IDR) frame
  *
  * asserts:
- *   encoder_ctx is not null
+ *   none
  *
  * returns: error code
  */
-int encoder_process_next_video_buffer(encoder_context_t *encoder_ctx)
+int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp, int isKeyframe)
 {
-	/*assertions*/
-	assert(encoder_ctx != NULL);
-
-	__LOCK_MUTEX( __PMUTEX );
+	return encoder_push_video_frame(frame, size, timestamp, isKeyframe, NULL, NULL);
+}
 
-	int flag = video_ring_buffer[video_read_index].flag;
+/*
+ * store a reference to the unprocessed input video frame in the
+ *  video ring buffer (no copy): the frame data must stay valid until
+ *  release(release_data) is called from the encoder thread
+ * args:
+ *   frame - pointer to unprocessed frame data
+ *   size - frame size (in bytes)
+ *   timestamp - frame timestamp (in nanosec)
+ *   isKeyframe - flag if it's a key(IDR) frame
+ *   release - callback for releasing the frame (not null)
+ *   release_data - release callback data
+ *
+ * asserts:
+ *   release is not null
+ *
+ * returns: error code (on error the frame is not referenced and
+ *   release is not called)
+ */
+int encoder_add_video_frame_ref(
+	uint8_t *frame,
+	int size,
+	int64_t timestamp,
+	int isKeyframe,
+	void (*release)(void *data),
+	void *release_data)
+{
+	/*assertions*/
+	assert(release != NULL);
 
-	__UNLOCK_MUTEX ( __PMUTEX );
+	return encoder_push_video_frame(frame, size, timestamp, isKeyframe, release, release_data);
+}
 
-	if(flag == VIDEO_BUFF_FREE)
-		return 1; /*all done*/
+/*
+ * encode the video frame at the ring buffer read index and free the slot
+ *  (consumer side of the ring buffer)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+static void encoder_encode_next_video_slot(encoder_context_t *encoder_ctx)
+{
+	video_buffer_t *slot = &video_ring_buffer[video_read_index];
 
 	/*timestamp is zero indexed*/
-	encoder_ctx->enc_video_ctx->pts = video_ring_buffer[video_read_index].timestamp;
+	encoder_ctx->enc_video_ctx->pts = slot->timestamp;
 
 	/*raw (direct input)*/
 	if(encoder_ctx->video_codec_ind == 0)
 	{
 		/*outbuf_coded_size must already be set*/
-		encoder_ctx->enc_video_ctx->outbuf_coded_size = video_ring_buffer[video_read_index].frame_size;
-		if(video_ring_buffer[video_read_index].keyframe)
+		encoder_ctx->enc_video_ctx->outbuf_coded_size = slot->frame_size;
+		if(slot->keyframe)
 			encoder_ctx->enc_video_ctx->flags |= AV_PKT_FLAG_KEY;
 	}
 
-	encoder_encode_video(encoder_ctx, video_ring_buffer[video_read_index].frame);
+	uint64_t t_start = encoder_time_ns();
+
+	encoder_encode_video(encoder_ctx, slot->ref_frame != NULL ? slot->ref_frame : slot->frame);
+
+	uint64_t t_end = encoder_time_ns();
+	video_encode_time_total += t_end - t_start;
+	video_frames_encoded++;
+
+	video_timing.frame_ts = (uint64_t) (slot->timestamp + reference_pts);
+	video_timing.enqueue_ts = slot->enqueue_ts;
+	video_timing.encode_start = t_start;
+	video_timing.encode_end = t_end;
+	/*pts now belongs to the encoded packet (delayed frames)*/
+	video_timing.packet_ts = (encoder_ctx->enc_video_ctx->outbuf_coded_size > 0) ?
+		(uint64_t) (encoder_ctx->enc_video_ctx->pts + reference_pts) : 0;
+	video_timing.mux_end = 0;
+
+	/*drop the frame reference*/
+	if(slot->release != NULL)
+		slot->release(slot->release_data);
+	slot->release = NULL;
+	slot->release_data = NULL;
+	slot->ref_frame = NULL;
+
+	/*free the slot (the frame data was already consumed)*/
+	if(slot->frame != NULL)
+		__atomic_sub_fetch(&video_bytes_queued, (size_t) slot->frame_size, __ATOMIC_ACQ_REL);
+	__VFLAG_STORE(video_read_index, VIDEO_BUFF_FREE);
+	int read_index = video_read_index;
+	NEXT_IND(read_index, video_ring_buffer_size);
+	__atomic_store_n(&video_read_index, read_index, __ATOMIC_RELEASE);
+}
 
+/*
+ * wait for a video frame in the ring buffer
+ * args:
+ *   timeout_ms - maximum wait time (in ms)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 0 if a frame is available, 1 on timeout
+ */
+int encoder_wait_video_buffer(uint32_t timeout_ms)
+{
+	if(!video_ring_buffer)
+		return 1;
+
+	if(__VFLAG_LOAD(video_read_index) != VIDEO_BUFF_FREE)
+		return 0;
+
+	struct timespec abstime;
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_sec += timeout_ms / 1000;
+	abstime.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+	if(abstime.tv_nsec >= 1000000000L)
+	{
+		abstime.tv_sec++;
+		abstime.tv_nsec -= 1000000000L;
+	}
+
+	int ret = 0;
 
-	/*mux the frame*/
 	__LOCK_MUTEX( __PMUTEX );
+	__atomic_store_n(&video_consumer_waiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	while(__VFLAG_LOAD(video_read_index) == VIDEO_BUFF_FREE && ret == 0)
+		ret = __COND_TIMED_WAIT(&video_cond, __PMUTEX, &abstime);
+	__atomic_store_n(&video_consumer_waiting, 0, __ATOMIC_RELAXED);
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	return (__VFLAG_LOAD(video_read_index) != VIDEO_BUFF_FREE) ? 0 : 1;
+}
+
+/*
+ * process next video frame on the ring buffer (encode and mux to file)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: error code
+ */
+int encoder_process_next_video_buffer(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	int flag = __VFLAG_LOAD(video_read_index);
+
+	if(flag == VIDEO_BUFF_FREE)
+		return 1; /*all done*/
 
-	video_ring_buffer[video_read_index].flag = VIDEO_BUFF_FREE;
-	NEXT_IND(video_read_index, video_ring_buffer_size);
+	encoder_encode_next_video_slot(encoder_ctx);
 
-	__UNLOCK_MUTEX ( __PMUTEX );
+	/*mux the frame*/
 
-	encoder_write_video_data(encoder_ctx);
+	if(encoder_write_video_data(encoder_ctx) >= 0 && video_timing.packet_ts > 0)
+		video_timing.mux_end = encoder_time_ns();
 
 	return 0;
 }
 
+/*
+ * get the stage times of the last video frame processed by
+ *  encoder_process_next_video_buffer (call it from the encoder thread)
+ *  with delayed frames the muxed packet belongs to an older frame
+ *  (see packet_ts)
+ * args:
+ *   timing - pointer to timing data to fill
+ *
+ * asserts:
+ *   timing is not null
+ *
+ * returns: none
+ */
+void encoder_get_video_timing(encoder_video_timing_t *timing)
+{
+	/*assertions*/
+	assert(timing != NULL);
+
+	*timing = video_timing;
+}
+
 /*
  * process all used video frames from buffer
   * args:
@@ -1259,9 +1949,7 @@ int encoder_flush_video_buffer(encoder_context_t *encoder_ctx)
 	/*assertions*/
 	assert(encoder_ctx != NULL);
 
-	__LOCK_MUTEX( __PMUTEX );
-	int flag = video_ring_buffer[video_read_index].flag;
-	__UNLOCK_MUTEX ( __PMUTEX );
+	int flag = __VFLAG_LOAD(video_read_index);
 
 	int buffer_count = video_ring_buffer_size;
 
@@ -1269,34 +1957,13 @@ int encoder_flush_video_buffer(encoder_context_t *encoder_ctx)
 	{
 		buffer_count--;
 
-		/*timestamp is zero indexed*/
-		encoder_ctx->enc_video_ctx->pts = video_ring_buffer[video_read_index].timestamp;
-
-		/*raw (direct input)*/
-		if(encoder_ctx->video_codec_ind == 0)
-		{
-			/*outbuf_coded_size must already be set*/
-			encoder_ctx->enc_video_ctx->outbuf_coded_size = video_ring_buffer[video_read_index].frame_size;
-			if(video_ring_buffer[video_read_index].keyframe)
-				encoder_ctx->enc_video_ctx->flags |= AV_PKT_FLAG_KEY;
-		}
-
-		encoder_encode_video(encoder_ctx, video_ring_buffer[video_read_index].frame);
+		encoder_encode_next_video_slot(encoder_ctx);
 
 		/*mux the frame*/
-		__LOCK_MUTEX( __PMUTEX );
-
-		video_ring_buffer[video_read_index].flag = VIDEO_BUFF_FREE;
-		NEXT_IND(video_read_index, video_ring_buffer_size);
-
-		__UNLOCK_MUTEX ( __PMUTEX );
-
 		encoder_write_video_data(encoder_ctx);
 
 		/*get next buffer flag*/
-		__LOCK_MUTEX( __PMUTEX );
-		flag = video_ring_buffer[video_read_index].flag;
-		__UNLOCK_MUTEX ( __PMUTEX );
+		flag = __VFLAG_LOAD(video_read_index);
 	}
 
 	/*flush libav*/
@@ -1411,9 +2078,23 @@ int encoder_encode_video(encoder_context_t *encoder_ctx, void *input_frame)
 			encoder_ctx->enc_video_ctx->outbuf_coded_size = outsize;
 			return outsize;
 		}
-		/*outbuf_coded_size must already be set*/
-		outsize = enc_video_ctx->outbuf_coded_size;
-		memcpy(enc_video_ctx->outbuf, input_frame, outsize);
+		if(encoder_ctx->mjpg_frame_encoder != NULL)
+		{
+			outsize = encoder_ctx->mjpg_frame_encoder(enc_video_ctx->outbuf, enc_video_ctx->outbuf_size,
+				input_frame, encoder_ctx->mjpg_frame_encoder_data);
+			if(outsize < 0)
+			{
+				fprintf(stderr, "ENCODER: external mjpg encoder failed (%i) - dropping frame\n", outsize);
+				outsize = 0;
+			}
+			enc_video_ctx->outbuf_coded_size = outsize;
+		}
+		else
+		{
+			/*outbuf_coded_size must already be set*/
+			outsize = enc_video_ctx->outbuf_coded_size;
+			memcpy(enc_video_ctx->outbuf, input_frame, outsize);
+		}
 		enc_video_ctx->flags = 0;
 		/*enc_video_ctx->flags must be set*/
 		enc_video_ctx->dts = AV_NOPTS_VALUE;
@@ -1787,9 +2468,7 @@ void encoder_close(encoder_context_t *encoder_ctx)
 	if(!encoder_ctx)
 		return;
 
-	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
 	encoder_audio_context_t *enc_audio_ctx = encoder_ctx->enc_audio_ctx;
-	encoder_codec_data_t *video_codec_data = NULL;
 	encoder_codec_data_t *audio_codec_data = NULL;
 
 	if(encoder_ctx->h264_pps)
@@ -1799,45 +2478,7 @@ void encoder_close(encoder_context_t *encoder_ctx)
 		free(encoder_ctx->h264_sps);
 
 	/*close video codec*/
-	if(enc_video_ctx)
-	{
-		video_codec_data = (encoder_codec_data_t *) enc_video_ctx->codec_data;
-		if(video_codec_data)
-		{
-			if(!(enc_video_ctx->flushed_buffers))
-			{
-				avcodec_flush_buffers(video_codec_data->codec_context);
-				enc_video_ctx->flushed_buffers = 1;
-			}
-			avcodec_close(video_codec_data->codec_context);
-			free(video_codec_data->codec_context);
-
-#if LIBAVCODEC_VER_AT_LEAST(53,6)
-			av_dict_free(&(video_codec_data->private_options));
-#endif
-
-			if(video_codec_data->frame)
-#if LIBAVCODEC_VER_AT_LEAST(55,28)
-				av_frame_free(&video_codec_data->frame);
-#else
-	#if LIBAVCODEC_VER_AT_LEAST(54,28)
-				avcodec_free_frame(&video_codec_data->frame);
-	#else
-				av_freep(&video_codec_data->frame);
-	#endif
-#endif
-			free(video_codec_data);		
-		}
-
-		if(enc_video_ctx->priv_data)
-			free(enc_video_ctx->priv_data);
-		if(enc_video_ctx->tmpbuf)
-			free(enc_video_ctx->tmpbuf);
-		if(enc_video_ctx->outbuf)
-			free(enc_video_ctx->outbuf);
-
-		free(enc_video_ctx);
-	}
+	encoder_video_close(encoder_ctx);
 
 	/*close audio codec*/
 	if(enc_audio_ctx)
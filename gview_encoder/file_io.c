@@ -27,6 +27,7 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 /* support for internationalization - i18n */
 #include <locale.h>
 #include <libintl.h>
@@ -35,34 +36,104 @@
 #include "file_io.h"
 #include "gview.h"
 
+extern int verbosity;
 
 /*
- * get the file position pointer
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t io_time_ns()
+{
+	struct timespec now;
+	if(clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+		return 0;
+
+	return ((uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec);
+}
+
+/*
+ * writer thread (async mode): writes the back buffer to file
+ * args:
+ *   data - pointer to io_writer
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to return code
+ */
+static void *io_writer_loop(void *data)
+{
+	io_writer_t *writer = (io_writer_t *) data;
+
+	__LOCK_MUTEX(&writer->mutex);
+	while(1)
+	{
+		while(!writer->pending && !writer->quit)
+			__COND_WAIT(&writer->cond, &writer->mutex);
+
+		if(!writer->pending && writer->quit)
+			break;
+
+		size_t nitems = writer->back_size;
+		__UNLOCK_MUTEX(&writer->mutex);
+
+		/*the back buffer is owned by this thread while pending is set*/
+		int err = 0;
+		if(fwrite(writer->back_buffer, 1, nitems, writer->fp) < nitems)
+			err = errno;
+
+		__LOCK_MUTEX(&writer->mutex);
+		if(err)
+			writer->write_error = err;
+		writer->pending = 0;
+		__COND_BCAST(&writer->cond);
+	}
+	__UNLOCK_MUTEX(&writer->mutex);
+
+	return ((void *) 0);
+}
+
+/*
+ * wait for the pending background write to finish (async mode)
  * args:
  *   writer - pointer to io_writer
  *
  * asserts:
  *   writer is not null
  *
- * returns: the file position pointer
+ * returns: error code (0 - no write error)
  */
-static int64_t io_tell(io_writer_t *writer)
+static int io_sync(io_writer_t *writer)
 {
 	/*assertions*/
 	assert(writer != NULL);
 
-	if(writer->fp == NULL)
+	if(!writer->async)
+		return 0;
+
+	__LOCK_MUTEX(&writer->mutex);
+	while(writer->pending)
+		__COND_WAIT(&writer->cond, &writer->mutex);
+	int err = writer->write_error;
+	writer->write_error = 0;
+	__UNLOCK_MUTEX(&writer->mutex);
+
+	if(err)
 	{
-		fprintf(stderr, "ENCODER: (io_tell) no file pointer associated with io_writer (mem only ?)\n");
+		fprintf(stderr, "ENCODER: (io_sync) file write error: %s\n", strerror(err));
 		return -1;
 	}
-	/*flush the file buffer*/
-	fflush(writer->fp);
 
-	/*return the file pointer position*/
-	return ((int64_t) ftello64(writer->fp));
+	return 0;
 }
 
+
 /* flush a mem only writer(buf_writer) into a file writer
  * args:
  *   file_writer - pointer to a file io_writer
@@ -134,6 +205,77 @@ io_writer_t *io_create_writer(const char *filename, int max_size)
 	return writer;
 }
 
+/*
+ * enable the asynchronous mode: buffer flushes are handed to a
+ *  writer thread (double buffering) and only io_seek/io_skip wait
+ *  for the pending write to finish
+ * args:
+ *   writer - pointer to io_writer (file writer)
+ *
+ * asserts:
+ *   writer is not null
+ *
+ * returns: error code (0 - E_OK)
+ */
+int io_set_async(io_writer_t *writer)
+{
+	/*assertions*/
+	assert(writer != NULL);
+
+	if(writer->async)
+		return 0;
+
+	if(writer->fp == NULL)
+	{
+		fprintf(stderr, "ENCODER: (io_set_async) no file pointer associated with writer (mem only ?)\n");
+		return -1;
+	}
+
+	/*use bigger buffers (if nothing was buffered yet)*/
+	if(writer->buf_ptr == writer->buffer && writer->buffer_size < IO_ASYNC_BUFFER_SIZE)
+	{
+		uint8_t *new_buffer = realloc(writer->buffer, IO_ASYNC_BUFFER_SIZE);
+		if(new_buffer == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (io_set_async): %s\n", strerror(errno));
+			exit(-1);
+		}
+		writer->buffer = new_buffer;
+		writer->buffer_size = IO_ASYNC_BUFFER_SIZE;
+		writer->buf_ptr = writer->buffer;
+		writer->buf_end = writer->buffer + writer->buffer_size;
+	}
+
+	writer->back_buffer = calloc(writer->buffer_size, sizeof(uint8_t));
+	if(writer->back_buffer == NULL)
+	{
+		fprintf(stderr, "ENCODER: FATAL memory allocation failure (io_set_async): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	writer->back_size = 0;
+	writer->pending = 0;
+	writer->quit = 0;
+	writer->write_error = 0;
+
+	__INIT_MUTEX(&writer->mutex);
+	__INIT_COND(&writer->cond);
+
+	if(__THREAD_CREATE(&writer->thread, io_writer_loop, (void *) writer))
+	{
+		fprintf(stderr, "ENCODER: (io_set_async) writer thread creation failed - using sync mode\n");
+		__CLOSE_COND(&writer->cond);
+		__CLOSE_MUTEX(&writer->mutex);
+		free(writer->back_buffer);
+		writer->back_buffer = NULL;
+		return -1;
+	}
+
+	writer->async = 1;
+
+	return 0;
+}
+
 /*
  * destroy the writer (clean up)
  * args:
@@ -153,6 +295,32 @@ void io_destroy_writer(io_writer_t *writer)
 	{
 		/* flush the buffer to file*/
 		io_flush_buffer(writer);
+		io_sync(writer);
+
+		if(writer->async)
+		{
+			/*stop the writer thread*/
+			__LOCK_MUTEX(&writer->mutex);
+			writer->quit = 1;
+			__COND_BCAST(&writer->cond);
+			__UNLOCK_MUTEX(&writer->mutex);
+
+			__THREAD_JOIN(writer->thread);
+
+			__CLOSE_COND(&writer->cond);
+			__CLOSE_MUTEX(&writer->mutex);
+
+			free(writer->back_buffer);
+			writer->back_buffer = NULL;
+			writer->async = 0;
+		}
+
+		if(verbosity > 0 && writer->flush_count > 0)
+			printf("ENCODER: (io) %" PRIu64 " buffer flushes - stall time avg %" PRIu64 " us max %" PRIu64 " us\n",
+				writer->flush_count,
+				writer->stall_time / (writer->flush_count * 1000),
+				writer->stall_time_max / 1000);
+
 		/* flush the file buffer*/
 		fflush(writer->fp);
 		/* close the file pointer */
@@ -189,11 +357,38 @@ int64_t io_flush_buffer(io_writer_t *writer)
 	if (writer->buf_ptr > writer->buffer)
 	{
 		nitems= writer->buf_ptr - writer->buffer;
-		if(fwrite(writer->buffer, 1, nitems, writer->fp) < nitems)
+
+		uint64_t t_start = io_time_ns();
+
+		if(writer->async)
+		{
+			/*wait for the writer thread to release the back buffer*/
+			if(io_sync(writer) < 0)
+				return -1;
+
+			/*swap buffers and hand the filled one to the writer thread*/
+			uint8_t *tmp = writer->back_buffer;
+			writer->back_buffer = writer->buffer;
+			writer->buffer = tmp;
+			writer->buf_end = writer->buffer + writer->buffer_size;
+
+			__LOCK_MUTEX(&writer->mutex);
+			writer->back_size = nitems;
+			writer->pending = 1;
+			__COND_BCAST(&writer->cond);
+			__UNLOCK_MUTEX(&writer->mutex);
+		}
+		else if(fwrite(writer->buffer, 1, nitems, writer->fp) < nitems)
 		{
 			fprintf(stderr, "ENCODER: (io_flush) file write error: %s\n", strerror(errno));
 			return -1;
 		}
+
+		uint64_t stall = io_time_ns() - t_start;
+		writer->flush_count++;
+		writer->stall_time += stall;
+		if(stall > writer->stall_time_max)
+			writer->stall_time_max = stall;
 	}
 	else if (writer->buf_ptr < writer->buffer)
 	{
@@ -206,7 +401,8 @@ int64_t io_flush_buffer(io_writer_t *writer)
 	if(size_inc > 0)
 		writer->size += size_inc;
 
-	writer->position = io_tell(writer); /*update current file pointer position*/
+	/*update current file pointer position (the write moves it by nitems)*/
+	writer->position += nitems;
 
 	writer->buf_ptr = writer->buffer;
 
@@ -247,12 +443,14 @@ int io_seek(io_writer_t *writer, int64_t position)
 		}
 		/*flush the memory buffer (we need an empty buffer)*/
 		io_flush_buffer(writer);
+		/*wait for any pending write before moving the file pointer*/
+		io_sync(writer);
 		/*try to move the file pointer to position*/
-		int ret = fseeko(writer->fp, position, SEEK_SET);
+		ret = fseeko(writer->fp, position, SEEK_SET);
 		if(ret != 0)
 			fprintf(stderr, "ENCODER: (io_seek) seek to file position %" PRIu64 "failed\n", position);
 		else
-			writer->position = io_tell(writer); /*update current file pointer position*/
+			writer->position = position; /*update current file pointer position*/
 
 		/*we are now on position with an empty memory buffer*/
 	}
@@ -261,6 +459,7 @@ int io_seek(io_writer_t *writer, int64_t position)
 		/*move file pointer to EOF*/
 		if(writer->position != writer->size)
 		{
+			io_sync(writer);
 			fseeko(writer->fp, writer->size, SEEK_SET);
 			writer->position = writer->size;
 		}
@@ -294,12 +493,14 @@ int io_skip(io_writer_t *writer, int offset)
 	}
 	/*flush the memory buffer (clean buffer)*/
 	io_flush_buffer(writer);
+	/*wait for any pending write before moving the file pointer*/
+	io_sync(writer);
 	/*try to move the file pointer to position*/
 	int ret = fseeko(writer->fp, offset, SEEK_CUR);
 	if(ret != 0)
 		fprintf(stderr, "ENCODER: (io_skip) skip file pointer by 0x%x failed\n", offset);
-
-	writer->position = io_tell(writer); //update current file pointer position
+	else
+		writer->position += offset; //update current file pointer position
 
 	/*we are on position with an empty memory buffer*/
 	return ret;
@@ -27,9 +27,11 @@
 #include <stdio.h>
 
 #include "../config.h"
+#include "gview.h"
 
 
 #define IO_BUFFER_SIZE 32768
+#define IO_ASYNC_BUFFER_SIZE (1024 * 1024) /*size of each buffer in async mode*/
 
 typedef struct _io_writer_t
 {
@@ -42,6 +44,22 @@ typedef struct _io_writer_t
 
 	int64_t size; //file size (end of file position)
 	int64_t position; //file pointer position (updates on buffer flush)
+
+	/*async mode: buffer is filled while the writer thread drains back_buffer*/
+	int async;              //flag async mode
+	uint8_t *back_buffer;   //buffer being written by the writer thread
+	size_t back_size;       //bytes to write from back_buffer
+	int pending;            //back_buffer has data to write
+	int quit;               //flag the writer thread to exit
+	int write_error;        //errno of the last failed background write (0 - none)
+	__THREAD_TYPE thread;   //writer thread
+	__MUTEX_TYPE mutex;     //protects pending, back_size, quit and write_error
+	__COND_TYPE cond;       //signals pending changes
+
+	/*flush statistics*/
+	uint64_t flush_count;   //number of buffer flushes
+	uint64_t stall_time;    //total time blocked on flush (ns)
+	uint64_t stall_time_max;//maximum time blocked on a single flush (ns)
 } io_writer_t;
 
 /*
@@ -57,6 +75,20 @@ typedef struct _io_writer_t
  */
 io_writer_t *io_create_writer(const char *filename, int max_size);
 
+/*
+ * enable the asynchronous mode: buffer flushes are handed to a
+ *  writer thread (double buffering) and only io_seek/io_skip wait
+ *  for the pending write to finish
+ * args:
+ *   writer - pointer to io_writer (file writer)
+ *
+ * asserts:
+ *   writer is not null
+ *
+ * returns: error code (0 - E_OK)
+ */
+int io_set_async(io_writer_t *writer);
+
 /*
  * destroy the writer (clean up)
  * args:
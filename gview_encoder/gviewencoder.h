@@ -63,16 +63,51 @@ __BEGIN_DECLS
 
 #define MAX_DELAYED_FRAMES 50  /*Maximum supported delayed frames*/
 
+/*video encoder threading (thread_type)*/
+#define ENCODER_THREAD_AUTO  (0) /*let libav choose*/
+#define ENCODER_THREAD_FRAME (1) /*frame threading (adds one frame delay per thread)*/
+#define ENCODER_THREAD_SLICE (2) /*slice threading (no added delay)*/
+#define ENCODER_MAX_THREADS  (16)
+
 /*video buffer*/
 typedef struct _video_buffer_t
 {
-	uint8_t *frame;  /*uncompressed*/
+	uint8_t *frame;  /*uncompressed (copied frames - in the arena, NULL if referenced)*/
+	uint8_t *ref_frame; /*referenced frame data (not owned) or NULL*/
+	void (*release)(void *data); /*releases the referenced frame*/
+	void *release_data; /*release callback data*/
 	int frame_size;
 	int64_t timestamp;
+	uint64_t enqueue_ts; /*monotonic time the frame was queued (nanosec)*/
 	int keyframe;  /* 1-keyframe; 0-non keyframe (only for direct input)*/
 	int flag;      /*VIDEO_BUFF_FREE | VIDEO_BUFF_USED*/
 } video_buffer_t;
 
+/*
+ * stage times for the last processed video frame
+ *  (monotonic nanosec - same clock as the capture timestamps)
+ */
+typedef struct _encoder_video_timing_t
+{
+	uint64_t frame_ts;     /*capture timestamp of the encoded frame*/
+	uint64_t enqueue_ts;   /*frame added to the ring buffer*/
+	uint64_t encode_start; /*encoder called*/
+	uint64_t encode_end;   /*encoder returned*/
+	uint64_t packet_ts;    /*capture timestamp of the muxed packet (0 - none: delayed)*/
+	uint64_t mux_end;      /*packet written to the muxer (0 - none)*/
+} encoder_video_timing_t;
+
+/*
+ * muxer file writer flush statistics
+ *  (time the muxer spent blocked on buffer flushes)
+ */
+typedef struct _encoder_io_stats_t
+{
+	uint64_t flush_count;    /*number of buffer flushes*/
+	uint64_t stall_time;     /*total time blocked on flush (ns)*/
+	uint64_t stall_time_max; /*maximum time blocked on a single flush (ns)*/
+} encoder_io_stats_t;
+
 /*video codec properties*/
 typedef struct _video_codec_t
 {
@@ -107,7 +142,9 @@ typedef struct _video_codec_t
 	int me_method;            //lavc motion estimation method
 	int mpeg_quant;           //lavc mpeg quantization
 	int max_b_frames;         //lavc max b frames
-	int num_threads;          //lavc num threads
+	int num_threads;          //lavc num threads (0 - auto: number of cores)
+	int thread_type;          //lavc thread type (ENCODER_THREAD_[AUTO|FRAME|SLICE])
+	int lookahead;            //lavc rc lookahead in frames (-1 - codec default)
 	int flags;                //lavc flags
 	int monotonic_pts;		  //use monotonic pts instead of timestamp based
 } video_codec_t;
@@ -195,6 +232,14 @@ typedef struct _encoder_audio_context_t
 } encoder_audio_context_t;
 
 
+/*
+ * external mjpg frame encoder
+ *  called from the encoder thread with the uncompressed frame
+ *  (as added with encoder_add_video_frame), it must store the
+ *  jpeg in out and return its size (negative on error)
+ */
+typedef int (*encoder_mjpg_frame_cb_t)(uint8_t *out, int out_size, uint8_t *in, void *data);
+
 typedef struct _encoder_context_t
 {
 	int muxer_id;
@@ -221,6 +266,10 @@ typedef struct _encoder_context_t
 	int h264_sps_size;
 	uint8_t *h264_sps;
 
+	/*external mjpg frame encoder (NULL - not in use)*/
+	encoder_mjpg_frame_cb_t mjpg_frame_encoder;
+	void *mjpg_frame_encoder_data;
+
 } encoder_context_t;
 
 /*
@@ -235,6 +284,50 @@ typedef struct _encoder_context_t
  */
 void encoder_set_verbosity(int value);
 
+/*
+ * set the video ring buffer memory budget (copied frames)
+ *  (must be set before encoder_get_context)
+ * args:
+ *   size - budget in bytes (0 - auto: 1.5 sec of frames up to 256 MB)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void encoder_set_video_buffer_budget(size_t size);
+
+/*
+ * override the video codec threading defaults
+ *  (must be set before encoder_get_context)
+ * args:
+ *   threads - number of encoder threads (0 - use codec defaults)
+ *   thread_type - ENCODER_THREAD_[AUTO|FRAME|SLICE] (AUTO - use codec defaults)
+ *   lookahead - rc lookahead in frames (-1 - use codec defaults)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void encoder_set_video_threading(int threads, int thread_type, int lookahead);
+
+/*
+ * set an external mjpg frame encoder used instead of libavcodec
+ *  for the MJPG video codec (must be set before adding any frames,
+ *  it's ignored for other codecs)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   encode - frame encoder callback
+ *   data - callback user data
+ *
+ * asserts:
+ *    encoder_ctx is not null
+ *
+ * returns: none
+ */
+void encoder_set_mjpg_frame_encoder(encoder_context_t *encoder_ctx, encoder_mjpg_frame_cb_t encode, void *data);
+
 /*
  * encoder initaliztion (first function to get called)
  * args:
@@ -376,6 +469,19 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename);
  */
 void encoder_muxer_close(encoder_context_t *encoder_ctx);
 
+/*
+ * get the muxer file writer flush statistics
+ *  (of the open muxer or, after encoder_muxer_close, of the last one)
+ * args:
+ *   stats - pointer to io stats (filled in)
+ *
+ * asserts:
+ *   stats is not null
+ *
+ * returns: none
+ */
+void encoder_get_io_stats(encoder_io_stats_t *stats);
+
 /*
  * get video list codec entry for codec index
  * args:
@@ -608,6 +714,44 @@ uint32_t encoder_buff_scheduler(int mode, double thresh, int max_time);
  */
 int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp, int isKeyframe);
 
+/*
+ * store a reference to the unprocessed input video frame in the
+ *  video ring buffer (no copy): the frame data must stay valid until
+ *  release(release_data) is called from the encoder thread
+ * args:
+ *   frame - pointer to unprocessed frame data
+ *   size - frame size (in bytes)
+ *   timestamp - frame timestamp (in nanosec)
+ *   isKeyframe - flag if it's a key(IDR) frame
+ *   release - callback for releasing the frame (not null)
+ *   release_data - release callback data
+ *
+ * asserts:
+ *   release is not null
+ *
+ * returns: error code (on error the frame is not referenced and
+ *   release is not called)
+ */
+int encoder_add_video_frame_ref(
+	uint8_t *frame,
+	int size,
+	int64_t timestamp,
+	int isKeyframe,
+	void (*release)(void *data),
+	void *release_data);
+
+/*
+ * wait for a video frame in the ring buffer
+ * args:
+ *   timeout_ms - maximum wait time (in ms)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 0 if a frame is available, 1 on timeout
+ */
+int encoder_wait_video_buffer(uint32_t timeout_ms);
+
 /*
  * process next video frame on the ring buffer (encode and mux to file)
  * args:
@@ -620,6 +764,21 @@ int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp, int isK
  */
 int encoder_process_next_video_buffer(encoder_context_t *encoder_ctx);
 
+/*
+ * get the stage times of the last video frame processed by
+ *  encoder_process_next_video_buffer (call it from the encoder thread)
+ *  with delayed frames the muxed packet belongs to an older frame
+ *  (see packet_ts)
+ * args:
+ *   timing - pointer to timing data to fill
+ *
+ * asserts:
+ *   timing is not null
+ *
+ * returns: none
+ */
+void encoder_get_video_timing(encoder_video_timing_t *timing);
+
 /*
  * process all used video frames from buffer
   * args:
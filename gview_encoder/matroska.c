@@ -1028,6 +1028,9 @@ mkv_context_t *mkv_create_context(const char* filename, int mode)
 	}
 
 	mkv_ctx->writer = io_create_writer(filename, 0);
+	/*write to disk in the background (double buffered)*/
+	if(mkv_ctx->writer != NULL)
+		io_set_async(mkv_ctx->writer);
 	mkv_ctx->mode = mode;
 	mkv_ctx->main_seekhead = NULL;
 	mkv_ctx->cues = NULL;
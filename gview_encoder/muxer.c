@@ -59,10 +59,39 @@ static avi_context_t *avi_ctx = NULL;
 static stream_io_t *video_stream = NULL;
 static stream_io_t *audio_stream = NULL;
 
+/*flush statistics of the last closed muxer writer*/
+static encoder_io_stats_t last_io_stats;
+
 /*file mutex*/
 static __MUTEX_TYPE mutex = __STATIC_MUTEX_INIT;
 #define __PMUTEX &mutex
 
+/*
+ * copy the flush statistics of a file writer
+ * args:
+ *   writer - pointer to io_writer (if NULL stats are zeroed)
+ *   stats - pointer to io stats
+ *
+ * asserts:
+ *   stats is not null
+ *
+ * returns: none
+ */
+static void copy_io_stats(io_writer_t *writer, encoder_io_stats_t *stats)
+{
+	/*assertions*/
+	assert(stats != NULL);
+
+	memset(stats, 0, sizeof(encoder_io_stats_t));
+
+	if(writer == NULL)
+		return;
+
+	stats->flush_count = writer->flush_count;
+	stats->stall_time = writer->stall_time;
+	stats->stall_time_max = writer->stall_time_max;
+}
+
 /*
  * mux a video frame
  * args:
@@ -236,6 +265,8 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 	if(verbosity > 1)
 		printf("ENCODER: initializing muxer(%i)\n", encoder_ctx->muxer_id);
 
+	copy_io_stats(NULL, &last_io_stats);
+
 	switch (encoder_ctx->muxer_id)
 	{
 		case ENCODER_MUX_AVI:
@@ -398,6 +429,7 @@ void encoder_muxer_close(encoder_context_t *encoder_ctx)
 				//close sound ??
 
 				avi_close(avi_ctx);
+				copy_io_stats(avi_ctx->writer, &last_io_stats);
 
 				avi_destroy_context(avi_ctx);
 				avi_ctx = NULL;
@@ -410,6 +442,7 @@ void encoder_muxer_close(encoder_context_t *encoder_ctx)
 			if(mkv_ctx != NULL)
 			{
 				mkv_close(mkv_ctx);
+				copy_io_stats(mkv_ctx->writer, &last_io_stats);
 
 				mkv_destroy_context(mkv_ctx);
 				mkv_ctx = NULL;
@@ -418,6 +451,33 @@ void encoder_muxer_close(encoder_context_t *encoder_ctx)
 	}
 }
 
+/*
+ * get the muxer file writer flush statistics
+ *  (of the open muxer or, after encoder_muxer_close, of the last one)
+ * args:
+ *   stats - pointer to io stats (filled in)
+ *
+ * asserts:
+ *   stats is not null
+ *
+ * returns: none
+ */
+void encoder_get_io_stats(encoder_io_stats_t *stats)
+{
+	/*assertions*/
+	assert(stats != NULL);
+
+	/*the audio thread also writes to the muxer*/
+	__LOCK_MUTEX( __PMUTEX );
+	if(avi_ctx != NULL)
+		copy_io_stats(avi_ctx->writer, stats);
+	else if(mkv_ctx != NULL)
+		copy_io_stats(mkv_ctx->writer, stats);
+	else
+		*stats = last_io_stats;
+	__UNLOCK_MUTEX( __PMUTEX );
+}
+
 /*
  * function to determine if enought free space is available
  * args:
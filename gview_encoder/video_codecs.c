@@ -100,6 +100,8 @@ static video_codec_t listSupCodecs[] =
 		.mpeg_quant   = 0,
 		.max_b_frames = 0,
 		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_AUTO,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -136,6 +138,8 @@ static video_codec_t listSupCodecs[] =
 		.mpeg_quant   = 0,
 		.max_b_frames = 0,
 		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_SLICE,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -171,7 +175,9 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = ME_EPZS,
 		.mpeg_quant   = 0,
 		.max_b_frames = 0,
-		.num_threads  = 1,
+		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_SLICE,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -208,6 +214,8 @@ static video_codec_t listSupCodecs[] =
 		.mpeg_quant   = 0,
 		.max_b_frames = 0,
 		.num_threads  = 1,
+		.thread_type  = ENCODER_THREAD_AUTO,
+		.lookahead    = -1,
 		.flags        = CODEC_FLAG_4MV
 	},
 	{
@@ -244,6 +252,8 @@ static video_codec_t listSupCodecs[] =
 		.mpeg_quant   = 0,
 		.max_b_frames = 0,
 		.num_threads  = 1,
+		.thread_type  = ENCODER_THREAD_AUTO,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -279,7 +289,9 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = ME_EPZS,
 		.mpeg_quant   = 0,
 		.max_b_frames = 0,
-		.num_threads  = 1,
+		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_SLICE,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -316,6 +328,8 @@ static video_codec_t listSupCodecs[] =
 		.mpeg_quant   = 0,
 		.max_b_frames = 0,
 		.num_threads  = 1,
+		.thread_type  = ENCODER_THREAD_AUTO,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -351,7 +365,9 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = ME_EPZS,
 		.mpeg_quant   = 1,
 		.max_b_frames = 0,
-		.num_threads  = 1,
+		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_SLICE,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -387,7 +403,9 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = ME_HEX,
 		.mpeg_quant   = 1,
 		.max_b_frames = 0,
-		.num_threads  = 1,
+		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_FRAME,
+		.lookahead    = 8,
 #if LIBAVCODEC_VER_AT_LEAST(54,01)
 		.flags        = CODEC_FLAG2_INTRA_REFRESH
 #else
@@ -427,7 +445,9 @@ static video_codec_t listSupCodecs[] =
 		.me_method    = ME_HEX,
 		.mpeg_quant   = 1,
 		.max_b_frames = 0,
-		.num_threads  = 4,
+		.num_threads  = 0,
+		.thread_type  = ENCODER_THREAD_AUTO,
+		.lookahead    = -1,
 		.flags        = 0
 	},
 	{
@@ -464,6 +484,8 @@ static video_codec_t listSupCodecs[] =
 		.mpeg_quant   = 1,
 		.max_b_frames = 0,
 		.num_threads  = 1,
+		.thread_type  = ENCODER_THREAD_AUTO,
+		.lookahead    = -1,
 		.flags        = 0
 	}
 };
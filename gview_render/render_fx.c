@@ -20,12 +20,14 @@
 ********************************************************************************/
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
 #include <inttypes.h>
 #include <unistd.h>
 #include <assert.h>
 #include <math.h>
+#include <errno.h>
 
 #include "gviewrender.h"
 #include "gview.h"
@@ -36,6 +38,26 @@
 	#include <gsl/gsl_rng.h>
 #endif
 
+#define FX_TRAIL_SIZE     (20) /*particles trail size (in frames)*/
+#define FX_PARTICLE_SIZE  (4)  /*maximum particle size (in pixels)*/
+#define FX_PIECE_SIZE     (16) /*pieces size (multiple of 2)*/
+
+/*fx done in a single pass over the frame*/
+#define FX_SINGLE_PASS_MASK (REND_FX_YUV_MIRROR | REND_FX_YUV_UPTURN | \
+	REND_FX_YUV_NEGATE | REND_FX_YUV_MONOCR)
+
+/*piece rotations*/
+#define FX_ROT_MIRROR     (1<<0)
+#define FX_ROT_UPTURN     (1<<1)
+
+#if defined(ENABLE_SIMD) && defined(__GNUC__)
+/*
+ * generic 16 byte vector (sse2 or neon registers)
+ *  only bitwise operations are used, so no cpu dispatch is needed
+ */
+typedef uint32_t fx_vec_t __attribute__((vector_size(16)));
+#define FX_VEC 1
+#endif
 
 typedef struct _particle_t
 {
@@ -48,283 +70,484 @@ typedef struct _particle_t
 	float decay;
 } particle_t;
 
-static particle_t *particles = NULL;
+/*
+ * bytewise pixel operation: out = ((in ^ x) & a) | o
+ *  the pattern repeats every 4 bytes (one yuyv macropixel)
+ */
+typedef struct _fx_pixel_op_t
+{
+	int active;   /*operation changes the data*/
+	uint8_t x[4]; /*xor pattern (negate)*/
+	uint8_t a[4]; /*and pattern (monochrome)*/
+	uint8_t o[4]; /*or pattern (monochrome)*/
+} fx_pixel_op_t;
+
+/*
+ * mirror (reverse) a line
+ *  out and in must not overlap
+ */
+typedef void (*fx_mirror_line_t)(uint8_t *out, const uint8_t *in, int linesize);
 
 /*
- * Flip YUYV frame - horizontal
+ * fx state: allocated on first use and kept while the frame
+ *  resolution doesn't change (freed by render_clean_fx)
+ */
+typedef struct _fx_state_t
+{
+	int width;                 /*resolution of the allocated buffers*/
+	int height;
+	uint8_t *line;             /*line scratch buffer*/
+#ifdef HAS_GSL
+	gsl_rng *rng;              /*random generator (kept across frames)*/
+	particle_t *particles;     /*particles trail*/
+	uint8_t *piece_rot;        /*rotation (FX_ROT_*) of each piece*/
+#endif
+} fx_state_t;
+
+static fx_state_t fx_state;
+
+/*
+ * free the resolution dependent fx buffers
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: void
+ */
+static void fx_free_buffers()
+{
+	free(fx_state.line);
+	fx_state.line = NULL;
+#ifdef HAS_GSL
+	free(fx_state.particles);
+	fx_state.particles = NULL;
+	free(fx_state.piece_rot);
+	fx_state.piece_rot = NULL;
+#endif
+	fx_state.width = 0;
+	fx_state.height = 0;
+}
+
+/*
+ * set the fx state for the frame resolution
+ *  (buffers are only reallocated if the resolution changes)
  * args:
- *    frame - pointer to frame buffer (yuyv format)
  *    width - frame width
- *    height- frame height
+ *    height - frame height
  *
  * asserts:
- *    frame is not null
+ *    none
  *
  * returns: void
  */
-static void fx_yuyv_mirror (uint8_t *frame, int width, int height)
+static void fx_state_setup(int width, int height)
 {
-	/*asserts*/
-	assert(frame != NULL);
+	if(fx_state.line != NULL &&
+		fx_state.width == width &&
+		fx_state.height == height)
+		return;
 
-	int h=0;
-	int w=0;
-	int sizeline = width*2;    /* 2 bytes per pixel*/
-	uint8_t *pframe;
-	pframe=frame;
-	uint8_t line[sizeline-1];  /*line buffer*/
-	for (h=0; h < height; h++)
-	{	/*line iterator*/
-		for(w=sizeline-1; w > 0; w = w - 4)
-		{	/* pixel iterator */
-			line[w-1]=*pframe++;
-			line[w-2]=*pframe++;
-			line[w-3]=*pframe++;
-			line[w]=*pframe++;
-		}
-		memcpy(frame+(h*sizeline), line, sizeline); /*copy reversed line to frame buffer*/
+	fx_free_buffers();
+
+	/*big enough for a yuyv line*/
+	fx_state.line = calloc(width * 2, sizeof(uint8_t));
+	if(fx_state.line == NULL)
+	{
+		fprintf(stderr,"RENDER: FATAL memory allocation failure (fx_state_setup): %s\n", strerror(errno));
+		exit(-1);
 	}
+
+	fx_state.width = width;
+	fx_state.height = height;
 }
 
 /*
- * Flip yu12 frame - horizontal
+ * set a pixel operation from the fx mask
  * args:
- *    frame - pointer to frame buffer (yu12=iyuv format)
- *    width - frame width
- *    height- frame height
+ *    op - pointer to pixel operation
+ *    mask - or'ed filter mask
+ *    chroma - chroma bytes in the 4 byte pattern (for monochrome)
  *
  * asserts:
- *    frame is not null
+ *    op is not null
  *
  * returns: void
  */
-static void fx_yu12_mirror (uint8_t *frame, int width, int height)
+static void fx_pixel_op_init(fx_pixel_op_t *op, uint32_t mask, const uint8_t chroma[4])
 {
 	/*asserts*/
-	assert(frame != NULL);
+	assert(op != NULL);
 
-	int h=0;
-	int w=0;
-	int y_sizeline = width;
-	int c_sizeline = width/2;
+	int i = 0;
 
-	uint8_t *end = NULL;
-	uint8_t *end2 = NULL;
+	op->active = 0;
 
-	uint8_t *py = frame;
-	uint8_t *pu = frame + (width * height);
-	uint8_t *pv = pu + ((width * height) / 4);
+	for(i = 0; i < 4; ++i)
+	{
+		int mono = (mask & REND_FX_YUV_MONOCR) && chroma[i];
+
+		op->x[i] = (mask & REND_FX_YUV_NEGATE) ? 0xff : 0x00;
+		/*monochrome keeps Y and sets U V to the median (half the max value)=128*/
+		op->a[i] = mono ? 0x00 : 0xff;
+		op->o[i] = mono ? 0x80 : 0x00;
 
-	uint8_t pixel =0;
-	uint8_t pixel2=0;
+		if(op->x[i] || mono)
+			op->active = 1;
+	}
+}
+
+/*
+ * apply a pixel operation to a line
+ * args:
+ *    p - pointer to line (4 byte aligned to the pattern)
+ *    linesize - line size in bytes
+ *    op - pointer to pixel operation
+ *
+ * asserts:
+ *    none
+ *
+ * returns: void
+ */
+static void fx_pixel_op_line(uint8_t *p, int linesize, const fx_pixel_op_t *op)
+{
+	uint32_t x = 0;
+	uint32_t a = 0;
+	uint32_t o = 0;
+	memcpy(&x, op->x, 4);
+	memcpy(&a, op->a, 4);
+	memcpy(&o, op->o, 4);
+
+	int i = 0;
 
-	/*mirror y*/
-	for(h = 0; h < height; h++)
+	/*constant result (monochrome chroma plane): only store*/
+	if(a == 0 && o == (o & 0xff) * 0x01010101U)
 	{
-		py = frame + (h * width);
-		end = py + width - 1;
-		for(w = 0; w < width/2; w++)
-		{
-			pixel = *py;
-			*py++ = *end;
-			*end-- = pixel;
-		}
-	}	
+		memset(p, o & 0xff, linesize);
+		return;
+	}
 
-	/*mirror u v*/
-	for(h = 0; h < height; h+=2)
+#ifdef FX_VEC
+	fx_vec_t vx = {x, x, x, x};
+	fx_vec_t va = {a, a, a, a};
+	fx_vec_t vo = {o, o, o, o};
+
+	for(; i + 16 <= linesize; i += 16)
 	{
-		pu = frame + (width * height) + ((h * width) / 4);
-		pv = pu + ((width * height) / 4);
-		end  = pu + (width / 2) - 1;
-		end2 = pv + (width / 2) -1;
-		for(w = 0; w < width/2; w+=2)
-		{
-			pixel  = *pu;
-			pixel2 = *pv;
-			*pu++ = *end;
-			*pv++ = *end2;
-			*end-- = pixel;
-			*end2-- = pixel2;
-		}
-	}	
+		fx_vec_t v;
+		memcpy(&v, p + i, 16);
+		v = ((v ^ vx) & va) | vo;
+		memcpy(p + i, &v, 16);
+	}
+#endif
+
+	for(; i + 4 <= linesize; i += 4)
+	{
+		uint32_t v;
+		memcpy(&v, p + i, 4);
+		v = ((v ^ x) & a) | o;
+		memcpy(p + i, &v, 4);
+	}
+
+	for(; i < linesize; ++i)
+		p[i] = ((p[i] ^ op->x[i & 3]) & op->a[i & 3]) | op->o[i & 3];
 }
 
 /*
- * Invert YUV frame
+ * mirror a yuyv line (the chroma of each macropixel is kept)
  * args:
- *    frame - pointer to frame buffer (any yuv format)
- *    width - frame width
- *    height- frame height
+ *    out - pointer to output line
+ *    in - pointer to input line
+ *    linesize - line size in bytes (multiple of 4)
  *
  * asserts:
- *    frame is not null
+ *    none
+ *
+ * returns: void
+ */
+static void fx_yuyv_mirror_line(uint8_t *out, const uint8_t *in, int linesize)
+{
+	uint8_t *pout = out + linesize - 4;
+
+	for(; pout >= out; pout -= 4, in += 4)
+	{
+		pout[0] = in[2]; /*Y1*/
+		pout[1] = in[1]; /*U*/
+		pout[2] = in[0]; /*Y0*/
+		pout[3] = in[3]; /*V*/
+	}
+}
+
+/*
+ * mirror a plane line (yu12)
+ * args:
+ *    out - pointer to output line
+ *    in - pointer to input line
+ *    linesize - line size in bytes
+ *
+ * asserts:
+ *    none
+ *
+ * returns: void
+ */
+static void fx_plane_mirror_line(uint8_t *out, const uint8_t *in, int linesize)
+{
+	int i = 0;
+
+	/*8 bytes at a time*/
+	for(; i + 8 <= linesize; i += 8)
+	{
+		uint64_t v;
+		memcpy(&v, in + i, 8);
+		v = __builtin_bswap64(v);
+		memcpy(out + linesize - 8 - i, &v, 8);
+	}
+
+	for(; i < linesize; ++i)
+		out[linesize - 1 - i] = in[i];
+}
+
+/*
+ * process one line: out = op(mirror(in))
+ * args:
+ *    out - pointer to output line
+ *    in - pointer to input line (must not overlap out if mirror is set)
+ *    linesize - line size in bytes
+ *    mirror - line mirror function (NULL - no mirror)
+ *    op - pointer to pixel operation
+ *
+ * asserts:
+ *    none
+ *
+ * returns: void
+ */
+static void fx_line(uint8_t *out, const uint8_t *in, int linesize,
+	fx_mirror_line_t mirror, const fx_pixel_op_t *op)
+{
+	if(mirror)
+		mirror(out, in, linesize);
+	else if(out != in)
+		memcpy(out, in, linesize);
+
+	/*the line is still in cache*/
+	if(op->active)
+		fx_pixel_op_line(out, linesize, op);
+}
+
+/*
+ * apply mirror, upturn and a pixel operation to a
+ *  rectangle (frame, plane or piece) in a single pass
+ * args:
+ *    buf - pointer to the first line of the rectangle
+ *    linesize - rectangle line size in bytes
+ *    lines - number of lines
+ *    stride - distance between lines in bytes
+ *    mirror - line mirror function (NULL - no mirror)
+ *    upturn - flip vertically
+ *    op - pointer to pixel operation
+ *
+ * asserts:
+ *    buf is not null
  *
  * returns: void
  */
-static void fx_yuv_negative(uint8_t *frame, int width, int height)
+static void fx_rect(uint8_t *buf, int linesize, int lines, int stride,
+	fx_mirror_line_t mirror, int upturn, const fx_pixel_op_t *op)
 {
 	/*asserts*/
-	assert(frame != NULL);
+	assert(buf != NULL);
 
-#ifdef USE_PLANAR_YUV
-	int size = (width * height * 5) / 4;
-#else
-	int size= width * height * 2;
-#endif
-	int i=0;
-	for(i=0; i < size; i++)
-		frame[i] = ~frame[i];
+	if(!mirror && !upturn && !op->active)
+		return; /*nothing to do*/
+
+	uint8_t *tmp = fx_state.line;
+	int h = 0;
+
+	if(upturn)
+	{
+		for(h = 0; h < lines / 2; ++h)
+		{
+			uint8_t *top = buf + h * stride;
+			uint8_t *bottom = buf + (lines - 1 - h) * stride;
+
+			memcpy(tmp, top, linesize);
+			fx_line(top, bottom, linesize, mirror, op);
+			fx_line(bottom, tmp, linesize, mirror, op);
+		}
+
+		if(lines % 2 == 0)
+			return;
+
+		/*the middle line stays in place*/
+		buf += h * stride;
+		lines = 1;
+	}
+
+	for(h = 0; h < lines; ++h)
+	{
+		uint8_t *line = buf + h * stride;
+
+		if(mirror)
+		{
+			memcpy(tmp, line, linesize);
+			fx_line(line, tmp, linesize, mirror, op);
+		}
+		else
+			fx_line(line, line, linesize, NULL, op);
+	}
 }
 
 /*
- * Flip YUV frame - vertical
+ * mirror, upturn, negate and monochrome for a YUYV frame (single pass)
  * args:
  *    frame - pointer to frame buffer (yuyv format)
  *    width - frame width
  *    height- frame height
+ *    mask  - or'ed filter mask
  *
  * asserts:
  *    frame is not null
  *
  * returns: void
  */
-static void fx_yuyv_upturn(uint8_t *frame, int width, int height)
+static void fx_yuyv_single_pass(uint8_t *frame, int width, int height, uint32_t mask)
 {
 	/*asserts*/
 	assert(frame != NULL);
 
-	int h = 0;
-	int sizeline = width * 2;  /* 2 bytes per pixel*/
-	uint8_t line1[sizeline-1]; /*line1 buffer*/
-	uint8_t line2[sizeline-1]; /*line2 buffer*/
-	for ( h = 0; h < height/2; ++h)
-	{	/*line iterator*/
-		memcpy(line1, frame + h * sizeline, sizeline);
-		memcpy(line2, frame + (height - 1 - h) * sizeline, sizeline);
-
-		memcpy(frame + h * sizeline, line2, sizeline);
-		memcpy(frame + (height - 1 - h) * sizeline, line1, sizeline);
-	}
+	static const uint8_t chroma[4] = {0, 1, 0, 1}; /*Y U Y V*/
+
+	fx_pixel_op_t op;
+	fx_pixel_op_init(&op, mask, chroma);
+
+	fx_rect(frame, width * 2, height, width * 2,
+		(mask & REND_FX_YUV_MIRROR) ? fx_yuyv_mirror_line : NULL,
+		mask & REND_FX_YUV_UPTURN, &op);
 }
 
 /*
- * Flip yu12 frame - vertical
+ * mirror, upturn, negate and monochrome for a yu12 frame (single pass)
  * args:
- *    frame - pointer to frame buffer (yu12 format)
+ *    frame - pointer to frame buffer (yu12=iyuv format)
  *    width - frame width
  *    height- frame height
+ *    mask  - or'ed filter mask
  *
  * asserts:
  *    frame is not null
  *
  * returns: void
  */
-static void fx_yu12_upturn(uint8_t *frame, int width, int height)
+static void fx_yu12_single_pass(uint8_t *frame, int width, int height, uint32_t mask)
 {
 	/*asserts*/
 	assert(frame != NULL);
 
-	int h = 0;
+	static const uint8_t luma[4] = {0, 0, 0, 0};
+	static const uint8_t chroma[4] = {1, 1, 1, 1};
 
-	uint8_t line[width]; /*line1 buffer*/
-	
-	uint8_t *pi = frame; //begin of first y line
-	uint8_t *pf = pi + (width * (height - 1)); //begin of last y line
-	
-	/*upturn y*/
-	for ( h = 0; h < height / 2; ++h)
-	{	/*line iterator*/
-		memcpy(line, pi, width);
-		memcpy(pi, pf, width);
-		memcpy(pf, line, width);
-		
-		pi+=width;
-		pf-=width;
-		
-	}
-	
-	/*upturn u*/
-	pi = frame + (width * height); //begin of first u line
-	pf = pi + ((width * height) / 4) - (width / 2); //begin of last u line
-	for ( h = 0; h < height / 2; h += 2) //every two lines = height / 4
-	{	/*line iterator*/
-		memcpy(line, pi, width / 2);
-		memcpy(pi, pf, width / 2);
-		memcpy(pf, line, width / 2);
-		
-		pi+=width/2;
-		pf-=width/2;
-	}
-	
-	/*upturn v*/
-	pi = frame + ((width * height * 5) / 4); //begin of first v line
-	pf = pi + ((width * height) / 4) - (width / 2); //begin of last v line
-	for ( h = 0; h < height / 2; h += 2) //every two lines = height / 4
-	{	/*line iterator*/
-		memcpy(line, pi, width / 2);
-		memcpy(pi, pf, width / 2);
-		memcpy(pf, line, width / 2);
-		
-		pi+=width/2;
-		pf-=width/2;
-	}
-	
+	fx_pixel_op_t op_y;
+	fx_pixel_op_t op_uv;
+	fx_pixel_op_init(&op_y, mask, luma);
+	fx_pixel_op_init(&op_uv, mask, chroma);
+
+	fx_mirror_line_t mirror = (mask & REND_FX_YUV_MIRROR) ? fx_plane_mirror_line : NULL;
+	int upturn = mask & REND_FX_YUV_UPTURN;
+
+	uint8_t *py = frame;
+	uint8_t *pu = py + (width * height);
+	uint8_t *pv = pu + ((width * height) / 4);
+
+	fx_rect(py, width, height, width, mirror, upturn, &op_y);
+	fx_rect(pu, width / 2, height / 2, width / 2, mirror, upturn, &op_uv);
+	fx_rect(pv, width / 2, height / 2, width / 2, mirror, upturn, &op_uv);
 }
 
+#ifdef HAS_GSL
 /*
- * Monochromatic effect for YUYV frame
+ * get the random generator (allocated once)
  * args:
- *     frame - pointer to frame buffer (yuyv format)
- *     width - frame width
- *     height- frame height
+ *    none
  *
  * asserts:
- *     frame is not null
+ *    none
  *
- * returns: void
+ * returns: pointer to random generator
  */
-static void fx_yuyv_monochrome(uint8_t* frame, int width, int height)
+static gsl_rng *fx_get_rng()
 {
-	int size = width * height * 2;
-	int i = 0;
-
-	for(i=0; i < size; i = i + 4)
-	{	/* keep Y - luma */
-		frame[i+1]=0x80;/*U - median (half the max value)=128*/
-		frame[i+3]=0x80;/*V - median (half the max value)=128*/
+	if(fx_state.rng == NULL)
+	{
+		gsl_rng_env_setup();
+		fx_state.rng = gsl_rng_alloc(gsl_rng_default);
+		if(fx_state.rng == NULL)
+		{
+			fprintf(stderr,"RENDER: FATAL memory allocation failure (fx_get_rng): %s\n", strerror(errno));
+			exit(-1);
+		}
 	}
+
+	return fx_state.rng;
 }
 
 /*
- * Monochromatic effect for yu12 frame
+ * get the rotation of each piece
+ *  (drawn for every frame, the table is allocated once per resolution)
  * args:
- *     frame - pointer to frame buffer (yu12 format)
- *     width - frame width
- *     height- frame height
+ *    num - number of pieces
  *
  * asserts:
- *     frame is not null
+ *    none
  *
- * returns: void
+ * returns: pointer to rotation table (FX_ROT_* flags)
  */
-static void fx_yu12_monochrome(uint8_t* frame, int width, int height)
+static uint8_t *fx_get_pieces_rotation(int num)
 {
-	
-	uint8_t *puv = frame + (width * height); //skip luma
-	
+	if(fx_state.piece_rot == NULL)
+	{
+		fx_state.piece_rot = calloc(num > 0 ? num : 1, sizeof(uint8_t));
+		if(fx_state.piece_rot == NULL)
+		{
+			fprintf(stderr,"RENDER: FATAL memory allocation failure (fx_pieces): %s\n", strerror(errno));
+			exit(-1);
+		}
+	}
+
+	gsl_rng *r = fx_get_rng();
 	int i = 0;
-	
-	for(i=0; i < (width * height) / 2; ++i)
-	{	/* keep Y - luma */
-		*puv++=0x80;/*median (half the max value)=128*/
+
+	for(i = 0; i < num; ++i)
+	{
+		//rotation is random
+		int rot = (int) lround(8 * gsl_rng_uniform (r)); /*0 to 8*/
+
+		switch(rot)
+		{
+			case 5:
+			case 1: //mirror
+				fx_state.piece_rot[i] = FX_ROT_MIRROR;
+				break;
+			case 6:
+			case 2: //upturn
+				fx_state.piece_rot[i] = FX_ROT_UPTURN;
+				break;
+			case 4:
+			case 3://mirror upturn
+				fx_state.piece_rot[i] = FX_ROT_MIRROR | FX_ROT_UPTURN;
+				break;
+			default: //do nothing
+				fx_state.piece_rot[i] = 0;
+				break;
+		}
 	}
-}
 
+	return fx_state.piece_rot;
+}
 
-#ifdef HAS_GSL
 /*
  * Break yuyv image in little square pieces
+ *  (each piece is rotated in place)
  * args:
  *    frame  - pointer to frame buffer (yuyv format)
  *    width  - frame width
@@ -336,84 +559,37 @@ static void fx_yu12_monochrome(uint8_t* frame, int width, int height)
  */
 static void fx_yuyv_pieces(uint8_t* frame, int width, int height, int piece_size )
 {
+	/*asserts*/
+	assert(frame != NULL);
+
 	int numx = width / piece_size; //number of pieces in x axis
 	int numy = height / piece_size; //number of pieces in y axis
-	uint8_t *piece = calloc (piece_size * piece_size * 2, sizeof(uint8_t));
-	if(piece == NULL)
-	{
-		fprintf(stderr,"RENDER: FATAL memory allocation failure (fx_pieces): %s\n", strerror(errno));
-		exit(-1);
-	}
-	int i = 0, j = 0, line = 0, column = 0, linep = 0, px = 0, py = 0;
 
-	/*random generator setup*/
-	gsl_rng_env_setup();
-	const gsl_rng_type *T = gsl_rng_default;
-	gsl_rng *r = gsl_rng_alloc (T);
+	uint8_t *rot = fx_get_pieces_rotation(numx * numy);
 
-	int rot = 0;
+	fx_pixel_op_t op;
+	memset(&op, 0, sizeof(fx_pixel_op_t)); /*no pixel operation*/
+
+	int i = 0, j = 0;
 
 	for(j = 0; j < numy; j++)
 	{
-		int row = j * piece_size;
-		for(i = 0; i < numx; i++)
+		uint8_t *row = frame + (j * piece_size * width * 2);
+		for(i = 0; i < numx; i++, rot++)
 		{
-			column = i * piece_size * 2;
-			//get piece
-			for(py = 0; py < piece_size; py++)
-			{
-				linep = py * piece_size * 2;
-				line = (py + row) * width * 2;
-				for(px=0 ; px < piece_size * 2; px++)
-				{
-					piece[px + linep] = frame[(px + column) + line];
-				}
-			}
-			/*rotate piece and copy it to frame*/
-			//rotation is random
-			rot = (int) lround(8 * gsl_rng_uniform (r)); /*0 to 8*/
+			if(*rot == 0)
+				continue;
 
-			switch(rot)
-			{
-				case 0: // do nothing
-					break;
-				case 5:
-				case 1: //mirror
-					fx_yuyv_mirror(piece, piece_size, piece_size);
-					break;
-				case 6:
-				case 2: //upturn
-					fx_yuyv_upturn(piece, piece_size, piece_size);
-					break;
-				case 4:
-				case 3://mirror upturn
-					fx_yuyv_upturn(piece, piece_size, piece_size);
-					fx_yuyv_mirror(piece, piece_size, piece_size);
-					break;
-				default: //do nothing
-					break;
-			}
-			//write piece
-			for(py = 0; py < piece_size; py++)
-			{
-				linep = py * piece_size * 2;
-				line = (py + row) * width * 2;
-				for(px=0 ; px < piece_size * 2; px++)
-				{
-					frame[(px + column) + line] = piece[px + linep];
-				}
-			}
+			fx_rect(row + (i * piece_size * 2), piece_size * 2, piece_size, width * 2,
+				(*rot & FX_ROT_MIRROR) ? fx_yuyv_mirror_line : NULL,
+				*rot & FX_ROT_UPTURN, &op);
 		}
 	}
-
-	/*free the random seed generator*/
-	gsl_rng_free (r);
-	/*free the piece buffer*/
-	free(piece);
 }
 
 /*
  * Break yu12 image in little square pieces
+ *  (each piece is rotated in place)
  * args:
  *    frame  - pointer to frame buffer (yu12 format)
  *    width  - frame width
@@ -425,112 +601,44 @@ static void fx_yuyv_pieces(uint8_t* frame, int width, int height, int piece_size
  */
 static void fx_yu12_pieces(uint8_t* frame, int width, int height, int piece_size )
 {
+	/*asserts*/
+	assert(frame != NULL);
+
 	int numx = width / piece_size; //number of pieces in x axis
 	int numy = height / piece_size; //number of pieces in y axis
-	
-	uint8_t piece[(piece_size * piece_size * 3) / 2];
-	uint8_t *ppiece = piece;
-	
-	int i = 0, j = 0, w = 0, h = 0;
 
-	/*random generator setup*/
-	gsl_rng_env_setup();
-	const gsl_rng_type *T = gsl_rng_default;
-	gsl_rng *r = gsl_rng_alloc (T);
+	uint8_t *rot = fx_get_pieces_rotation(numx * numy);
 
-	int rot = 0;
-	
-	uint8_t *py = NULL;
-	uint8_t *pu = NULL;
-	uint8_t *pv = NULL;
-	
-	for(h = 0; h < height; h += piece_size)
-	{	
-		for(w = 0; w < width; w += piece_size)
-		{	
-			uint8_t *ppy = piece;
-			uint8_t *ppu = piece + (piece_size * piece_size);
-			uint8_t *ppv = ppu + ((piece_size * piece_size) / 4);
-	
-			for(i = 0; i < piece_size; ++i)
-			{		
-				py = frame + ((h + i) * width) + w;
-				for (j=0; j < piece_size; ++j)
-				{
-					*ppy++ = *py++; 
-				}	
-			}
-			
-			for(i = 0; i < piece_size; i += 2)
-			{	
-				uint8_t *pu = frame + (width * height) + (((h + i) * width) / 4) + (w / 2);
-				uint8_t *pv = pu + ((width * height) / 4);
-				
-				for(j = 0; j < piece_size; j += 2)
-				{
-					*ppu++ = *pu++;
-					*ppv++ = *pv++;
-				}
-			}
-			
-			ppy = piece;
-			ppu = piece + (piece_size * piece_size);
-			ppv = ppu + ((piece_size * piece_size) / 4);
-			
-			/*rotate piece and copy it to frame*/
-			//rotation is random
-			rot = (int) lround(8 * gsl_rng_uniform (r)); /*0 to 8*/
+	fx_pixel_op_t op;
+	memset(&op, 0, sizeof(fx_pixel_op_t)); /*no pixel operation*/
 
-			switch(rot)
-			{
-				case 0: // do nothing
-					break;
-				case 5:
-				case 1: //mirror
-					fx_yu12_mirror(piece, piece_size, piece_size);
-					break;
-				case 6:
-				case 2: //upturn
-					fx_yu12_upturn(piece, piece_size, piece_size);
-					break;
-				case 4:
-				case 3://mirror upturn
-					fx_yu12_upturn(piece, piece_size, piece_size);
-					fx_yu12_mirror(piece, piece_size, piece_size);
-					break;
-				default: //do nothing
-					break;
-			}
-			
-			ppy = piece;
-			ppu = piece + (piece_size * piece_size);
-			ppv = ppu + ((piece_size * piece_size) / 4);
-		
-			for(i = 0; i < piece_size; ++i)
-			{
-				py = frame + ((h + i) * width) + w;
-				for (j=0; j < piece_size; ++j)
-				{
-					*py++ = *ppy++; 
-				}	
-			}
-			
-			for(i = 0; i < piece_size; i += 2)
-			{
-				uint8_t *pu = frame + (width * height) + (((h + i) * width) / 4) + (w / 2);
-				uint8_t *pv = pu + ((width * height) / 4);
-				
-				for(j = 0; j < piece_size; j += 2)
-				{
-					*pu++ = *ppu++;
-					*pv++ = *ppv++;
-				}
-			}
+	uint8_t *py = frame;
+	uint8_t *pu = py + (width * height);
+	uint8_t *pv = pu + ((width * height) / 4);
+
+	int c_size = piece_size / 2;
+	int c_width = width / 2;
+
+	int i = 0, j = 0;
+
+	for(j = 0; j < numy; j++)
+	{
+		for(i = 0; i < numx; i++, rot++)
+		{
+			if(*rot == 0)
+				continue;
+
+			fx_mirror_line_t mirror = (*rot & FX_ROT_MIRROR) ? fx_plane_mirror_line : NULL;
+			int upturn = *rot & FX_ROT_UPTURN;
+
+			int y_offset = (j * piece_size * width) + (i * piece_size);
+			int c_offset = (j * c_size * c_width) + (i * c_size);
+
+			fx_rect(py + y_offset, piece_size, piece_size, width, mirror, upturn, &op);
+			fx_rect(pu + c_offset, c_size, c_size, c_width, mirror, upturn, &op);
+			fx_rect(pv + c_offset, c_size, c_size, c_width, mirror, upturn, &op);
 		}
 	}
-
-	/*free the random seed generator*/
-	gsl_rng_free (r);
 }
 
 /*
@@ -556,22 +664,21 @@ static void fx_particles(uint8_t* frame, int width, int height, int trail_size,
 	int part_w = width>>7;
 	int part_h = height>>6;
 
-	/*random generator setup*/
-	gsl_rng_env_setup();
-	const gsl_rng_type *T = gsl_rng_default;
-	gsl_rng *r = gsl_rng_alloc (T);
+	/*random generator (kept across frames)*/
+	gsl_rng *r = fx_get_rng();
 
-	/*allocation*/
-	if (particles == NULL)
+	/*allocation (once per resolution)*/
+	if (fx_state.particles == NULL)
 	{
-		particles = calloc(trail_size * part_w * part_h, sizeof(particle_t));
-		if(particles == NULL)
+		fx_state.particles = calloc(trail_size * part_w * part_h, sizeof(particle_t));
+		if(fx_state.particles == NULL)
 		{
 			fprintf(stderr,"RENDER: FATAL memory allocation failure (fx_particles): %s\n", strerror(errno));
 			exit(-1);
 		}
 	}
 
+	particle_t *particles = fx_state.particles;
 	particle_t *part = particles;
 	particle_t *part1 = part;
 
@@ -709,9 +816,6 @@ static void fx_particles(uint8_t* frame, int width, int height, int trail_size,
 		}
 		part++;
 	}
-
-	/*free the random seed generator*/
-	gsl_rng_free (r);
 }
 
 #endif
@@ -732,41 +836,29 @@ static void fx_particles(uint8_t* frame, int width, int height, int trail_size,
 void render_fx_apply(uint8_t *frame, int width, int height, uint32_t mask)
 {
 	if(mask != REND_FX_YUV_NOFILT)
-    {
+	{
+		/*keep the fx buffers while the resolution doesn't change*/
+		fx_state_setup(width, height);
+
 		#ifdef HAS_GSL
 		if(mask & REND_FX_YUV_PARTICLES)
-			fx_particles (frame, width, height, 20, 4);
+			fx_particles (frame, width, height, FX_TRAIL_SIZE, FX_PARTICLE_SIZE);
 		#endif
 
-		if(mask & REND_FX_YUV_MIRROR)
-#ifdef USE_PLANAR_YUV
-			fx_yu12_mirror(frame, width, height);
-#else
-			fx_yuyv_mirror(frame, width, height);
-#endif
-		if(mask & REND_FX_YUV_UPTURN)
+		/*mirror, upturn, negate and monochrome in a single pass*/
+		if(mask & FX_SINGLE_PASS_MASK)
 #ifdef USE_PLANAR_YUV
-			fx_yu12_upturn(frame, width, height);
+			fx_yu12_single_pass(frame, width, height, mask);
 #else
-			fx_yuyv_upturn(frame, width, height);
-#endif
-
-		if(mask & REND_FX_YUV_NEGATE)
-			fx_yuv_negative (frame, width, height);
-
-		if(mask & REND_FX_YUV_MONOCR)
-#ifdef USE_PLANAR_YUV
-			fx_yu12_monochrome (frame, width, height);
-#else
-			fx_yuyv_monochrome (frame, width, height);
+			fx_yuyv_single_pass(frame, width, height, mask);
 #endif
 
 #ifdef HAS_GSL
 		if(mask & REND_FX_YUV_PIECES)
   #ifdef USE_PLANAR_YUV
-			fx_yu12_pieces(frame, width, height, 16 );
+			fx_yu12_pieces(frame, width, height, FX_PIECE_SIZE);
   #else
-			fx_yuyv_pieces(frame, width, height, 16 );
+			fx_yuyv_pieces(frame, width, height, FX_PIECE_SIZE);
   #endif
 #endif
 	}
@@ -786,9 +878,13 @@ void render_fx_apply(uint8_t *frame, int width, int height, uint32_t mask)
  */
 void render_clean_fx()
 {
-	if(particles != NULL)
+	fx_free_buffers();
+
+#ifdef HAS_GSL
+	if(fx_state.rng != NULL)
 	{
-		free(particles);
-		particles = NULL;
+		gsl_rng_free(fx_state.rng);
+		fx_state.rng = NULL;
 	}
+#endif
 }
@@ -27,6 +27,7 @@
 #include <assert.h>
 
 #include "gview.h"
+#include "colorspaces_simd.h"
 #include "../config.h"
 
 extern int verbosity;
@@ -438,23 +439,35 @@ void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	assert(in);
 	assert(out);
 
+	const cs_simd_t *simd = colorspaces_get_simd();
+
 	int w = 0, h = 0;
-	int y_sizeline = width;
-	int c_sizeline = width/2;
-	
-	uint8_t *in1 = in; //first line
-	uint8_t *in2 = in1 + (width * 2); //second line in yuyv buffer
 
-	uint8_t *py1 = out; // first line
-	uint8_t *py2 = py1 + y_sizeline; //second line
-	uint8_t *pu = py1 + (width * height);
+	uint8_t *pu = out + (width * height);
 	uint8_t *pv = pu + ((width * height) / 4);
 
 	for(h = 0; h < height; h+=2)
 	{
-		for(w = 0; w < width; w+=2) //yuyv 2 bytes per sample
+		uint8_t *in1 = in + (h * width * 2); //first line
+		uint8_t *in2 = in1 + (width * 2); //second line in yuyv buffer
+
+		uint8_t *py1 = out + (h * width); // first line
+		uint8_t *py2 = py1 + width; //second line
+
+		w = 0;
+		if(simd->yuyv_to_yu12_rows != NULL)
+		{
+			w = simd->yuyv_to_yu12_rows(py1, py2, pu, pv, in1, in2, width);
+			in1 += w * 2;
+			in2 += w * 2;
+			py1 += w;
+			py2 += w;
+			pu += w / 2;
+			pv += w / 2;
+		}
+
+		for(; w < width; w+=2) //yuyv 2 bytes per sample
 		{
-			//printf("decoding: h:%i w:%i\n", h, w);
 			*py1++ = *in1++;
 			*py2++ = *in2++;
 			*pu++ = ((*in1++) + (*in2++)) /2; //average u samples
@@ -462,12 +475,7 @@ void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 			*py2++ = *in2++;
 			*pv++ = ((*in1++) + (*in2++)) /2; //average v samples
 		}
-		in1 = in + (h * width * 2);
-		in2 = in + ((h+1) * width * 2);
-		py1 = out + (h * width);
-		py2 = out + ((h+1) * width); 
 	}
-
 }
 
 /*
@@ -490,21 +498,34 @@ void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	assert(in);
 	assert(out);
 
+	const cs_simd_t *simd = colorspaces_get_simd();
+
 	int w = 0, h = 0;
-	int y_sizeline = width;
-	int c_sizeline = width/2;
-	
-	uint8_t *in1 = in; //first line
-	uint8_t *in2 = in1 + (width * 2); //second line in yuyv buffer
 
-	uint8_t *py1 = out; // first line
-	uint8_t *py2 = py1 + y_sizeline; //second line
-	uint8_t *pu = py1 + (width * height);
+	uint8_t *pu = out + (width * height);
 	uint8_t *pv = pu + ((width * height) / 4);
 
 	for(h = 0; h < height; h+=2)
 	{
-		for(w = 0; w < width*2; w++) //yuyv 2 bytes per sample
+		uint8_t *in1 = in + (h * width * 2); //first line
+		uint8_t *in2 = in1 + (width * 2); //second line in yvyu buffer
+
+		uint8_t *py1 = out + (h * width); // first line
+		uint8_t *py2 = py1 + width; //second line
+
+		w = 0;
+		if(simd->yuyv_to_yu12_rows != NULL)
+		{
+			w = simd->yuyv_to_yu12_rows(py1, py2, pv, pu, in1, in2, width);
+			in1 += w * 2;
+			in2 += w * 2;
+			py1 += w;
+			py2 += w;
+			pu += w / 2;
+			pv += w / 2;
+		}
+
+		for(; w < width; w+=2) //yvyu 2 bytes per sample
 		{
 			*py1++ = *in1++;
 			*py2++ = *in2++;
@@ -513,12 +534,7 @@ void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 			*py2++ = *in2++;
 			*pu++ = ((*in1++) + (*in2++)) /2; //average u samples
 		}
-		in1 = in + (h * width * 2);
-		in2 = in + ((h+1) * width * 2);
-		py1 = out + (h * width);
-		py2 = out + ((h+1) * width); 
 	}
-
 }
 
 /*
@@ -541,21 +557,34 @@ void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	assert(in);
 	assert(out);
 
+	const cs_simd_t *simd = colorspaces_get_simd();
+
 	int w = 0, h = 0;
-	int y_sizeline = width;
-	int c_sizeline = width/2;
-	
-	uint8_t *in1 = in; //first line
-	uint8_t *in2 = in1 + (width * 2); //second line in yuyv buffer
 
-	uint8_t *py1 = out; // first line
-	uint8_t *py2 = py1 + y_sizeline; //second line
-	uint8_t *pu = py1 + (width * height);
+	uint8_t *pu = out + (width * height);
 	uint8_t *pv = pu + ((width * height) / 4);
 
 	for(h = 0; h < height; h+=2)
 	{
-		for(w = 0; w < width; w+=2) //yuyv 2 bytes per sample
+		uint8_t *in1 = in + (h * width * 2); //first line
+		uint8_t *in2 = in1 + (width * 2); //second line in uyvy buffer
+
+		uint8_t *py1 = out + (h * width); // first line
+		uint8_t *py2 = py1 + width; //second line
+
+		w = 0;
+		if(simd->uyvy_to_yu12_rows != NULL)
+		{
+			w = simd->uyvy_to_yu12_rows(py1, py2, pu, pv, in1, in2, width);
+			in1 += w * 2;
+			in2 += w * 2;
+			py1 += w;
+			py2 += w;
+			pu += w / 2;
+			pv += w / 2;
+		}
+
+		for(; w < width; w+=2) //uyvy 2 bytes per sample
 		{
 			*pu++ = ((*in1++) + (*in2++)) /2; //average u samples
 			*py1++ = *in1++;
@@ -564,12 +593,7 @@ void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 			*py1++ = *in1++;
 			*py2++ = *in2++;
 		}
-		in1 = in + (h * width * 2);
-		in2 = in + ((h+1) * width * 2);
-		py1 = out + (h * width);
-		py2 = out + ((h+1) * width); 
 	}
-
 }
 
 /*
@@ -720,16 +744,26 @@ void nv12_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	assert(in);
 	assert(out);
 
+	const cs_simd_t *simd = colorspaces_get_simd();
+
 	/*copy y data*/
-    memcpy(out, in, width*height);
-	
+	memcpy(out, in, width*height);
+
 	uint8_t *puv = in + (width * height);
 	uint8_t *pu = out + (width * height);
 	uint8_t *pv = pu + ((width * height) / 4);
 
 	/*uv plane*/
 	int i = 0;
-	for(i=0; i< width * height /2; i+=2)
+	if(simd->split_uv != NULL)
+	{
+		i = simd->split_uv(pu, pv, puv, width * height / 4) * 2;
+		puv += i;
+		pu += i / 2;
+		pv += i / 2;
+	}
+
+	for(; i< width * height /2; i+=2)
 	{
 		*pu++ = *puv++;
 		*pv++ = *puv++;
@@ -756,21 +790,30 @@ void nv21_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	assert(in);
 	assert(out);
 
+	const cs_simd_t *simd = colorspaces_get_simd();
+
 	/*copy y data*/
-    memcpy(out, in, width*height);
-	
+	memcpy(out, in, width*height);
+
 	uint8_t *puv = in + (width * height);
 	uint8_t *pu = out + (width * height);
 	uint8_t *pv = pu + ((width * height) / 4);
 
 	/*uv plane*/
 	int i = 0;
-	for(i=0; i< width * height /2; i+=2)
+	if(simd->split_uv != NULL)
+	{
+		i = simd->split_uv(pv, pu, puv, width * height / 4) * 2;
+		puv += i;
+		pu += i / 2;
+		pv += i / 2;
+	}
+
+	for(; i< width * height /2; i+=2)
 	{
 		*pv++ = *puv++;
 		*pu++ = *puv++;
 	}
-
 }
 
 /*
@@ -1562,31 +1605,36 @@ void yu12_to_dib24 (uint8_t *out, uint8_t *in, int width, int height)
 }
 
 /*
- * convert yuv 420 planar (yu12) to yuv 422
+ * convert separate yuv 420 planes (with line padding) to yuv 422
+ *  (e.g. libav decoded frames)
  * args:
  *    out- pointer to output buffer (yuyv)
- *    in- pointer to input buffer (yuv420 planar data frame (yu12))
+ *    py- pointer to luma plane
+ *    pu- pointer to u plane
+ *    pv- pointer to v plane
+ *    ylinesize- luma line size in bytes
+ *    uvlinesize- chroma line size in bytes
  *    width- picture width
  *    height- picture height
  *
  * asserts:
  *    out is not null
- *    in is not null
+ *    py, pu and pv are not null
  *
  * returns: none
  */
-void yu12_to_yuyv (uint8_t *out, uint8_t *in, int width, int height)
+void yu12_planes_to_yuyv (uint8_t *out, uint8_t *py, uint8_t *pu, uint8_t *pv,
+	int ylinesize, int uvlinesize, int width, int height)
 {
-	uint8_t *py;
-	uint8_t *pu;
-	uint8_t *pv;
+	/*assertions*/
+	assert(out);
+	assert(py);
+	assert(pu);
+	assert(pv);
 
-	int linesize = width * 2;
-	int uvlinesize = width / 2;
+	const cs_simd_t *simd = colorspaces_get_simd();
 
-	py=in;
-	pu=py+(width*height);
-	pv=pu+(width*height/4);
+	int linesize = width * 2;
 
 	int h=0;
 	int huv=0;
@@ -1597,12 +1645,23 @@ void yu12_to_yuyv (uint8_t *out, uint8_t *in, int width, int height)
 		int wuv = 0;
 		int offset = h * linesize;
 		int offset1 = (h + 1) * linesize;
-		int offsety = h * width;
-		int offsety1 = (h + 1) * width;
+		int offsety = h * ylinesize;
+		int offsety1 = (h + 1) * ylinesize;
 		int offsetuv = huv * uvlinesize;
 		int w = 0;
 
-		for(w=0;w<linesize;w+=4)
+		if(simd->yu12_to_yuyv_row != NULL)
+		{
+			/*both lines share the same chroma line*/
+			wy = simd->yu12_to_yuyv_row(out + offset, py + offsety,
+				pu + offsetuv, pv + offsetuv, width);
+			simd->yu12_to_yuyv_row(out + offset1, py + offsety1,
+				pu + offsetuv, pv + offsetuv, width);
+			wuv = wy / 2;
+			w = wy * 2;
+		}
+
+		for(;w<linesize;w+=4)
 		{
 			/*y00*/
 			out[w + offset] = py[wy + offsety];
@@ -1629,6 +1688,33 @@ void yu12_to_yuyv (uint8_t *out, uint8_t *in, int width, int height)
 	}
 }
 
+/*
+ * convert yuv 420 planar (yu12) to yuv 422
+ * args:
+ *    out- pointer to output buffer (yuyv)
+ *    in- pointer to input buffer (yuv420 planar data frame (yu12))
+ *    width- picture width
+ *    height- picture height
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_to_yuyv (uint8_t *out, uint8_t *in, int width, int height)
+{
+	/*assertions*/
+	assert(out);
+	assert(in);
+
+	uint8_t *py = in;
+	uint8_t *pu = py + (width * height);
+	uint8_t *pv = pu + (width * height / 4);
+
+	yu12_planes_to_yuyv(out, py, pu, pv, width, width / 2, width, height);
+}
+
 /*------------------- YUYV --------------------*/
 
 /*
@@ -2608,6 +2694,60 @@ void bgr2yuyv(uint8_t *pbgr, uint8_t *pyuv, int width, int height)
 }
 
 #if MJPG_BUILTIN //use internal jpeg decoder
+/*
+ * 16 pixels of an mcu line to yuyv (scalar)
+ * args:
+ *   out: pointer to picture line (yuyv)
+ *   py0: pointer to luma samples 0-7 (idct output)
+ *   py1: pointer to luma samples 8-15 (idct output)
+ *   pu: pointer to 8 u samples (idct output)
+ *   pv: pointer to 8 v samples (idct output)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void mcu_row_to_yuyv(uint8_t *out, const int *py0, const int *py1,
+	const int *pu, const int *pv)
+{
+	int k = 0;
+	for (k = 0; k < 8; k++)
+	{
+		const int *py = (k < 4) ? py0 + k * 2 : py1 + (k - 4) * 2;
+		*out++ = CLIP(py[0]);        //y1
+		*out++ = CLIP(128 + pu[k]);  //u
+		*out++ = CLIP(py[1]);        //y2
+		*out++ = CLIP(128 + pv[k]);  //v
+	}
+}
+
+/*
+ * 8 idct samples to bytes (scalar)
+ * args:
+ *   out: pointer to output samples
+ *   in0: pointer to idct samples
+ *   in1: pointer to idct samples to average with (or NULL)
+ *        the average is done on the saturated samples
+ *   bias: value added to the samples (128 for chroma)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void pack_row8(uint8_t *out, const int *in0, const int *in1, int bias)
+{
+	int k = 0;
+	for (k = 0; k < 8; k++)
+	{
+		uint8_t val = CLIP(in0[k] + bias);
+		if (in1 != NULL)
+			val = (val + CLIP(in1[k] + bias)) >> 1;
+		out[k] = val;
+	}
+}
+
 /*
  * used for internal jpeg decoding  420 planar to 422
  * args:
@@ -2622,48 +2762,22 @@ void bgr2yuyv(uint8_t *pbgr, uint8_t *pyuv, int width, int height)
  */
 void yuv420pto422(int *out, uint8_t *pic, int width)
 {
-	int j = 0;
-	int outy1 = 0;
-	int outy2 = 8;
-	//yyyyuv
-	uint8_t *pic0 = pic;
-	uint8_t *pic1 = pic + width;
-	int *outy = out;
-	int *outu = out + 64 * 4;
-	int *outv = out + 64 * 5;
+	const cs_simd_t *simd = colorspaces_get_simd();
 
-	for (j = 0; j < 8; j++)
+	int l = 0;
+	//yyyyuv
+	for (l = 0; l < 16; l++)
 	{
-		int k = 0;
-		for (k = 0; k < 8; k++)
-		{
-			if( k == 4)
-			{
-				outy1 += 56;
-				outy2 += 56;
-			}
-			*pic0++ = CLIP(outy[outy1]);   //y1 line 1
-			*pic0++ = CLIP(128 + *outu);   //u  line 1-2
-			*pic0++ = CLIP(outy[outy1+1]); //y2 line 1
-			*pic0++ = CLIP(128 + *outv);   //v  line 1-2
-			*pic1++ = CLIP(outy[outy2]);   //y1 line 2
-			*pic1++ = CLIP(128 + *outu);   //u  line 1-2
-			*pic1++ = CLIP(outy[outy2+1]); //y2 line 2
-			*pic1++ = CLIP(128 + *outv);   //v  line 1-2
-			outy1 +=2; outy2 += 2; outu++; outv++;
-		}
-		if(j==3)
-		{
-			outy = out + 128;
-		}
+		/*luma blocks 0 1 (lines 0-7) and 2 3 (lines 8-15)*/
+		int *outy = out + ((l < 8) ? 0 : 128) + (l & 7) * 8;
+		/*chroma line is shared by two lines*/
+		int *outu = out + 64 * 4 + (l >> 1) * 8;
+		int *outv = out + 64 * 5 + (l >> 1) * 8;
+
+		if (simd->mcu_row_to_yuyv != NULL)
+			simd->mcu_row_to_yuyv(pic + l * width, outy, outy + 64, outu, outv);
 		else
-		{
-			outy += 16;
-		}
-		outy1 = 0;
-		outy2 = 8;
-		pic0 += 2 * (width -16);
-		pic1 += 2 * (width -16);
+			mcu_row_to_yuyv(pic + l * width, outy, outy + 64, outu, outv);
 	}
 }
 
@@ -2681,45 +2795,20 @@ void yuv420pto422(int *out, uint8_t *pic, int width)
  */
 void yuv422pto422(int *out, uint8_t *pic, int width)
 {
-	int j = 0;
-	int outy1 = 0;
-	int outy2 = 8;
-	int outu1 = 0;
-	int outv1 = 0;
-	//yyyyuv
-	uint8_t *pic0 = pic;
-	uint8_t *pic1 = pic + width;
-	int *outy = out;
-	int *outu = out + 64 * 4;
-	int *outv = out + 64 * 5;
+	const cs_simd_t *simd = colorspaces_get_simd();
 
-	for (j = 0; j < 4; j++)
+	int l = 0;
+	//yyuv
+	for (l = 0; l < 8; l++)
 	{
-		int k = 0;
-		for (k = 0; k < 8; k++)
-		{
-			if( k == 4)
-			{
-				outy1 += 56;
-				outy2 += 56;
-			}
-			*pic0++ = CLIP(outy[outy1]);        //y1 line 1
-			*pic0++ = CLIP(128 + outu[outu1]);  //u  line 1
-			*pic0++ = CLIP(outy[outy1+1]);      //y2 line 1
-			*pic0++ = CLIP(128 + outv[outv1]);  //v  line 1
-			*pic1++ = CLIP(outy[outy2]);        //y1 line 2
-			*pic1++ = CLIP(128 + outu[outu1+8]);//u  line 2
-			*pic1++ = CLIP(outy[outy2+1]);      //y2 line 2
-			*pic1++ = CLIP(128 + outv[outv1+8]);//v  line 2
-			outv1 += 1; outu1 += 1;
-			outy1 +=2; outy2 +=2;
-		}
-		outy += 16;outu +=8; outv +=8;
-		outv1 = 0; outu1=0;
-		outy1 = 0;
-		outy2 = 8;
-		pic0 += 2 * (width -16);
-		pic1 += 2 * (width -16);
+		int *outy = out + l * 8;
+		int *outu = out + 64 * 4 + l * 8;
+		int *outv = out + 64 * 5 + l * 8;
+
+		if (simd->mcu_row_to_yuyv != NULL)
+			simd->mcu_row_to_yuyv(pic + l * width, outy, outy + 64, outu, outv);
+		else
+			mcu_row_to_yuyv(pic + l * width, outy, outy + 64, outu, outv);
 	}
 }
 
@@ -2819,4 +2908,148 @@ void yuv400pto422(int *out, uint8_t *pic, int width)
 	}
 }
 
+/*
+ * used for internal jpeg decoding 420 planar to yu12
+ * args:
+ *   out: pointer to data output of idct (macroblocks yyyy u v)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv420p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width)
+{
+	const cs_simd_t *simd = colorspaces_get_simd();
+	void (*pack)(uint8_t *, const int *, const int *, int) =
+		simd->pack_row8 != NULL ? simd->pack_row8 : pack_row8;
+
+	int l = 0;
+	for (l = 0; l < 16; l++)
+	{
+		int *outy = out + ((l < 8) ? 0 : 128) + (l & 7) * 8;
+		pack(py + l * width, outy, NULL, 0);
+		pack(py + l * width + 8, outy + 64, NULL, 0);
+	}
+	for (l = 0; l < 8; l++)
+	{
+		pack(pu + l * (width / 2), out + 64 * 4 + l * 8, NULL, 128);
+		pack(pv + l * (width / 2), out + 64 * 5 + l * 8, NULL, 128);
+	}
+}
+
+/*
+ * used for internal jpeg decoding 422 planar to yu12
+ *  (chroma lines are averaged)
+ * args:
+ *   out: pointer to data output of idct (macroblocks yy u v)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv422p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width)
+{
+	const cs_simd_t *simd = colorspaces_get_simd();
+	void (*pack)(uint8_t *, const int *, const int *, int) =
+		simd->pack_row8 != NULL ? simd->pack_row8 : pack_row8;
+
+	int l = 0;
+	for (l = 0; l < 8; l++)
+	{
+		pack(py + l * width, out + l * 8, NULL, 0);
+		pack(py + l * width + 8, out + 64 + l * 8, NULL, 0);
+	}
+	for (l = 0; l < 4; l++)
+	{
+		int *outu = out + 64 * 4 + l * 16;
+		int *outv = out + 64 * 5 + l * 16;
+		pack(pu + l * (width / 2), outu, outu + 8, 128);
+		pack(pv + l * (width / 2), outv, outv + 8, 128);
+	}
+}
+
+/*
+ * used for internal jpeg decoding 444 planar to yu12
+ *  (chroma is averaged over 2x2 samples)
+ * args:
+ *   out: pointer to data output of idct (macroblocks y u v)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv444p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width)
+{
+	const cs_simd_t *simd = colorspaces_get_simd();
+	void (*pack)(uint8_t *, const int *, const int *, int) =
+		simd->pack_row8 != NULL ? simd->pack_row8 : pack_row8;
+
+	int l = 0;
+	for (l = 0; l < 8; l++)
+		pack(py + l * width, out + l * 8, NULL, 0);
+
+	int *outu = out + 64 * 4;
+	int *outv = out + 64 * 5;
+	for (l = 0; l < 4; l++)
+	{
+		int k = 0;
+		for (k = 0; k < 4; k++)
+		{
+			int i = l * 16 + k * 2;
+			pu[k] = (CLIP(128 + outu[i]) + CLIP(128 + outu[i + 1]) +
+				CLIP(128 + outu[i + 8]) + CLIP(128 + outu[i + 9])) >> 2;
+			pv[k] = (CLIP(128 + outv[i]) + CLIP(128 + outv[i + 1]) +
+				CLIP(128 + outv[i + 8]) + CLIP(128 + outv[i + 9])) >> 2;
+		}
+		pu += width / 2;
+		pv += width / 2;
+	}
+}
+
+/*
+ * used for internal jpeg decoding 400 planar to yu12
+ * args:
+ *   out: pointer to data output of idct (macroblocks y)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv400p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width)
+{
+	const cs_simd_t *simd = colorspaces_get_simd();
+	void (*pack)(uint8_t *, const int *, const int *, int) =
+		simd->pack_row8 != NULL ? simd->pack_row8 : pack_row8;
+
+	int l = 0;
+	for (l = 0; l < 8; l++)
+		pack(py + l * width, out + l * 8, NULL, 0);
+
+	for (l = 0; l < 4; l++)
+	{
+		memset(pu + l * (width / 2), 128, 4);
+		memset(pv + l * (width / 2), 128, 4);
+	}
+}
+
 #endif
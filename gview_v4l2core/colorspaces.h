@@ -380,6 +380,28 @@ void yu12_to_dib24 (uint8_t *out, uint8_t *in, int width, int height);
  */
 void yu12_to_yuyv (uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ * convert separate yuv 420 planes (with line padding) to yuv 422
+ *  (e.g. libav decoded frames)
+ * args:
+ *    out- pointer to output buffer (yuyv)
+ *    py- pointer to luma plane
+ *    pu- pointer to u plane
+ *    pv- pointer to v plane
+ *    ylinesize- luma line size in bytes
+ *    uvlinesize- chroma line size in bytes
+ *    width- picture width
+ *    height- picture height
+ *
+ * asserts:
+ *    out is not null
+ *    py, pu and pv are not null
+ *
+ * returns: none
+ */
+void yu12_planes_to_yuyv (uint8_t *out, uint8_t *py, uint8_t *pu, uint8_t *pv,
+	int ylinesize, int uvlinesize, int width, int height);
+
 /*
  * regular yuv (YUYV) to rgb24
  * args:
@@ -760,5 +782,71 @@ void yuv444pto422(int *out, uint8_t *pic, int width);
  */
 void yuv400pto422(int *out, uint8_t *pic, int width);
 
+/*
+ * used for internal jpeg decoding 420 planar to yu12
+ * args:
+ *   out: pointer to data output of idct (macroblocks yyyy u v)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv420p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width);
+
+/*
+ * used for internal jpeg decoding 422 planar to yu12
+ *  (chroma lines are averaged)
+ * args:
+ *   out: pointer to data output of idct (macroblocks yy u v)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv422p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width);
+
+/*
+ * used for internal jpeg decoding 444 planar to yu12
+ *  (chroma is averaged over 2x2 samples)
+ * args:
+ *   out: pointer to data output of idct (macroblocks y u v)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv444p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width);
+
+/*
+ * used for internal jpeg decoding 400 planar to yu12
+ * args:
+ *   out: pointer to data output of idct (macroblocks y)
+ *   py: pointer to mcu position in the luma plane
+ *   pu: pointer to mcu position in the u plane
+ *   pv: pointer to mcu position in the v plane
+ *   width: picture width
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void yuv400p_to_yu12_mcu(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width);
+
 #endif
 
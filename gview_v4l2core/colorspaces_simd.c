@@ -0,0 +1,1036 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "gview.h"
+#include "colorspaces_simd.h"
+#include "../config.h"
+
+#if defined(ENABLE_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CS_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(ENABLE_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define CS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+static cs_simd_t cs_simd =
+{
+	.name = "scalar",
+	.yuyv_to_yu12_rows = NULL,
+	.uyvy_to_yu12_rows = NULL,
+	.split_uv = NULL,
+	.yu12_to_yuyv_row = NULL,
+	.idct_8x8 = NULL,
+	.mcu_row_to_yuyv = NULL,
+	.pack_row8 = NULL,
+	.fdct_quant_8x8 = NULL,
+	.find_zero_pair = NULL,
+};
+
+static pthread_once_t cs_simd_once = PTHREAD_ONCE_INIT;
+
+/*
+ * one dimensional 8 point AAN inverse dct (float)
+ *  v[0..7] are vectors with one sample of each of the
+ *  transformed lines per lane (done in place)
+ */
+#define CS_IDCT_1D(type, v, ADD, SUB, MULK) do { \
+	type tmp0 = v[0], tmp1 = v[2], tmp2 = v[4], tmp3 = v[6]; \
+	type tmp10 = ADD(tmp0, tmp2); \
+	type tmp11 = SUB(tmp0, tmp2); \
+	type tmp13 = ADD(tmp1, tmp3); \
+	type tmp12 = SUB(MULK(SUB(tmp1, tmp3), 1.414213562f), tmp13); \
+	tmp0 = ADD(tmp10, tmp13); \
+	tmp3 = SUB(tmp10, tmp13); \
+	tmp1 = ADD(tmp11, tmp12); \
+	tmp2 = SUB(tmp11, tmp12); \
+	type z13 = ADD(v[5], v[3]); \
+	type z10 = SUB(v[5], v[3]); \
+	type z11 = ADD(v[1], v[7]); \
+	type z12 = SUB(v[1], v[7]); \
+	type tmp7 = ADD(z11, z13); \
+	tmp11 = MULK(SUB(z11, z13), 1.414213562f); \
+	type z5 = MULK(ADD(z10, z12), 1.847759065f); \
+	tmp10 = SUB(MULK(z12, 1.082392200f), z5); \
+	tmp12 = SUB(z5, MULK(z10, 2.613125930f)); \
+	type tmp6 = SUB(tmp12, tmp7); \
+	type tmp5 = SUB(tmp11, tmp6); \
+	type tmp4 = ADD(tmp10, tmp5); \
+	v[0] = ADD(tmp0, tmp7); \
+	v[7] = SUB(tmp0, tmp7); \
+	v[1] = ADD(tmp1, tmp6); \
+	v[6] = SUB(tmp1, tmp6); \
+	v[2] = ADD(tmp2, tmp5); \
+	v[5] = SUB(tmp2, tmp5); \
+	v[4] = ADD(tmp3, tmp4); \
+	v[3] = SUB(tmp3, tmp4); \
+} while(0)
+
+/*
+ * one dimensional 8 point AAN forward dct (float)
+ *  v[0..7] are vectors with one sample of each of the
+ *  transformed lines per lane (done in place, output
+ *  is scaled by the AAN factors)
+ */
+#define CS_FDCT_1D(type, v, ADD, SUB, MULK) do { \
+	type tmp0 = ADD(v[0], v[7]); \
+	type tmp7 = SUB(v[0], v[7]); \
+	type tmp1 = ADD(v[1], v[6]); \
+	type tmp6 = SUB(v[1], v[6]); \
+	type tmp2 = ADD(v[2], v[5]); \
+	type tmp5 = SUB(v[2], v[5]); \
+	type tmp3 = ADD(v[3], v[4]); \
+	type tmp4 = SUB(v[3], v[4]); \
+	type tmp10 = ADD(tmp0, tmp3); \
+	type tmp13 = SUB(tmp0, tmp3); \
+	type tmp11 = ADD(tmp1, tmp2); \
+	type tmp12 = SUB(tmp1, tmp2); \
+	v[0] = ADD(tmp10, tmp11); \
+	v[4] = SUB(tmp10, tmp11); \
+	type z1 = MULK(ADD(tmp12, tmp13), 0.707106781f); \
+	v[2] = ADD(tmp13, z1); \
+	v[6] = SUB(tmp13, z1); \
+	tmp10 = ADD(tmp4, tmp5); \
+	tmp11 = ADD(tmp5, tmp6); \
+	tmp12 = ADD(tmp6, tmp7); \
+	type z5 = MULK(SUB(tmp10, tmp12), 0.382683433f); \
+	type z2 = ADD(MULK(tmp10, 0.541196100f), z5); \
+	type z4 = ADD(MULK(tmp12, 1.306562965f), z5); \
+	type z3 = MULK(tmp11, 0.707106781f); \
+	type z11 = ADD(tmp7, z3); \
+	type z13 = SUB(tmp7, z3); \
+	v[5] = ADD(z13, z2); \
+	v[3] = SUB(z13, z2); \
+	v[1] = ADD(z11, z4); \
+	v[7] = SUB(z11, z4); \
+} while(0)
+
+#ifdef CS_SIMD_X86
+
+/*------------------------------- SSE2 ---------------------------------------*/
+
+/*
+ * truncated average of unsigned bytes ((a + b) / 2)
+ *  pavgb rounds up, so remove the carry of odd sums
+ */
+__attribute__((target("sse2")))
+static inline __m128i avg_trunc_sse2(__m128i a, __m128i b)
+{
+	__m128i odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+	return _mm_sub_epi8(_mm_avg_epu8(a, b), odd);
+}
+
+/*
+ * two packed 422 lines to yu12 (16 pixels per iteration)
+ *  yshift - 0 if luma is on even bytes (yuyv), 8 if on odd bytes (uyvy)
+ */
+__attribute__((target("sse2")))
+static inline int packed422_to_yu12_rows_sse2(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width, int yshift)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i shift = _mm_cvtsi32_si128(yshift);
+	__m128i cshift = _mm_cvtsi32_si128(8 - yshift);
+
+	int w = 0;
+	for(w = 0; w + 16 <= width; w += 16)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i *) (in1 + w * 2));
+		__m128i a1 = _mm_loadu_si128((const __m128i *) (in1 + w * 2 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i *) (in2 + w * 2));
+		__m128i b1 = _mm_loadu_si128((const __m128i *) (in2 + w * 2 + 16));
+
+		/*luma*/
+		__m128i y1 = _mm_packus_epi16(
+			_mm_and_si128(_mm_srl_epi16(a0, shift), mask),
+			_mm_and_si128(_mm_srl_epi16(a1, shift), mask));
+		__m128i y2 = _mm_packus_epi16(
+			_mm_and_si128(_mm_srl_epi16(b0, shift), mask),
+			_mm_and_si128(_mm_srl_epi16(b1, shift), mask));
+		_mm_storeu_si128((__m128i *) (py1 + w), y1);
+		_mm_storeu_si128((__m128i *) (py2 + w), y2);
+
+		/*chroma (u0 v0 u1 v1 ...)*/
+		__m128i c1 = _mm_packus_epi16(
+			_mm_and_si128(_mm_srl_epi16(a0, cshift), mask),
+			_mm_and_si128(_mm_srl_epi16(a1, cshift), mask));
+		__m128i c2 = _mm_packus_epi16(
+			_mm_and_si128(_mm_srl_epi16(b0, cshift), mask),
+			_mm_and_si128(_mm_srl_epi16(b1, cshift), mask));
+		__m128i c = avg_trunc_sse2(c1, c2);
+
+		_mm_storel_epi64((__m128i *) (pu + w / 2),
+			_mm_packus_epi16(_mm_and_si128(c, mask), zero));
+		_mm_storel_epi64((__m128i *) (pv + w / 2),
+			_mm_packus_epi16(_mm_srli_epi16(c, 8), zero));
+	}
+
+	return w;
+}
+
+__attribute__((target("sse2")))
+static int yuyv_to_yu12_rows_sse2(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width)
+{
+	return packed422_to_yu12_rows_sse2(py1, py2, pu, pv, in1, in2, width, 0);
+}
+
+__attribute__((target("sse2")))
+static int uyvy_to_yu12_rows_sse2(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width)
+{
+	return packed422_to_yu12_rows_sse2(py1, py2, pu, pv, in1, in2, width, 8);
+}
+
+__attribute__((target("sse2")))
+static int split_uv_sse2(uint8_t *pu, uint8_t *pv, const uint8_t *puv, int n)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+
+	int i = 0;
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i *) (puv + i * 2));
+		__m128i a1 = _mm_loadu_si128((const __m128i *) (puv + i * 2 + 16));
+
+		_mm_storeu_si128((__m128i *) (pu + i),
+			_mm_packus_epi16(_mm_and_si128(a0, mask), _mm_and_si128(a1, mask)));
+		_mm_storeu_si128((__m128i *) (pv + i),
+			_mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8)));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static int yu12_to_yuyv_row_sse2(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv, int width)
+{
+	int w = 0;
+	for(w = 0; w + 16 <= width; w += 16)
+	{
+		__m128i y = _mm_loadu_si128((const __m128i *) (py + w));
+		__m128i u = _mm_loadl_epi64((const __m128i *) (pu + w / 2));
+		__m128i v = _mm_loadl_epi64((const __m128i *) (pv + w / 2));
+		__m128i uv = _mm_unpacklo_epi8(u, v);
+
+		_mm_storeu_si128((__m128i *) (out + w * 2), _mm_unpacklo_epi8(y, uv));
+		_mm_storeu_si128((__m128i *) (out + w * 2 + 16), _mm_unpackhi_epi8(y, uv));
+	}
+
+	return w;
+}
+
+#define SSE_ADD(a, b) _mm_add_ps(a, b)
+#define SSE_SUB(a, b) _mm_sub_ps(a, b)
+#define SSE_MULK(a, k) _mm_mul_ps(a, _mm_set1_ps(k))
+
+/*
+ * 8x8 inverse dct with fused dequantization
+ *  the block is done as two 4 column halves
+ */
+__attribute__((target("sse2")))
+static void idct_8x8_sse2(int *out, const int *in, const uint8_t *zz,
+	const float *fquant, float off)
+{
+	float blk[64] __attribute__((aligned(16)));
+	__m128 l[8], r[8];
+	__m128i *pout = (__m128i *) out;
+	int i = 0;
+
+	for(i = 0; i < 64; i++)
+		blk[i] = (float) in[zz[i]];
+
+	for(i = 0; i < 8; i++)
+	{
+		l[i] = _mm_mul_ps(_mm_load_ps(blk + i * 8), _mm_loadu_ps(fquant + i * 8));
+		r[i] = _mm_mul_ps(_mm_load_ps(blk + i * 8 + 4), _mm_loadu_ps(fquant + i * 8 + 4));
+	}
+
+	/*columns*/
+	CS_IDCT_1D(__m128, l, SSE_ADD, SSE_SUB, SSE_MULK);
+	CS_IDCT_1D(__m128, r, SSE_ADD, SSE_SUB, SSE_MULK);
+
+	/*transpose (tl - rows 0-3, tr - rows 4-7)*/
+	__m128 tl[8], tr[8];
+	for(i = 0; i < 4; i++)
+	{
+		tl[i] = l[i];
+		tl[i + 4] = r[i];
+		tr[i] = l[i + 4];
+		tr[i + 4] = r[i + 4];
+	}
+	_MM_TRANSPOSE4_PS(tl[0], tl[1], tl[2], tl[3]);
+	_MM_TRANSPOSE4_PS(tl[4], tl[5], tl[6], tl[7]);
+	_MM_TRANSPOSE4_PS(tr[0], tr[1], tr[2], tr[3]);
+	_MM_TRANSPOSE4_PS(tr[4], tr[5], tr[6], tr[7]);
+
+	/*rows*/
+	CS_IDCT_1D(__m128, tl, SSE_ADD, SSE_SUB, SSE_MULK);
+	CS_IDCT_1D(__m128, tr, SSE_ADD, SSE_SUB, SSE_MULK);
+
+	/*transpose back and store*/
+	_MM_TRANSPOSE4_PS(tl[0], tl[1], tl[2], tl[3]);
+	_MM_TRANSPOSE4_PS(tl[4], tl[5], tl[6], tl[7]);
+	_MM_TRANSPOSE4_PS(tr[0], tr[1], tr[2], tr[3]);
+	_MM_TRANSPOSE4_PS(tr[4], tr[5], tr[6], tr[7]);
+
+	__m128 voff = _mm_set1_ps(off);
+	for(i = 0; i < 4; i++)
+	{
+		_mm_storeu_si128(pout + i * 2, _mm_cvtps_epi32(_mm_add_ps(tl[i], voff)));
+		_mm_storeu_si128(pout + i * 2 + 1, _mm_cvtps_epi32(_mm_add_ps(tl[i + 4], voff)));
+		_mm_storeu_si128(pout + i * 2 + 8, _mm_cvtps_epi32(_mm_add_ps(tr[i], voff)));
+		_mm_storeu_si128(pout + i * 2 + 9, _mm_cvtps_epi32(_mm_add_ps(tr[i + 4], voff)));
+	}
+}
+
+/*
+ * 4 int16 samples to float
+ */
+__attribute__((target("sse2")))
+static inline __m128 load4_ps_sse2(const int16_t *in)
+{
+	__m128i a = _mm_loadl_epi64((const __m128i *) in);
+	return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16));
+}
+
+/*
+ * quantize and store one row (8 coefficients)
+ */
+__attribute__((target("sse2")))
+static inline void quant_row8_sse2(int16_t *out, __m128 a, __m128 b, const float *fdiv)
+{
+	__m128i qa = _mm_cvtps_epi32(_mm_mul_ps(a, _mm_loadu_ps(fdiv)));
+	__m128i qb = _mm_cvtps_epi32(_mm_mul_ps(b, _mm_loadu_ps(fdiv + 4)));
+	_mm_storeu_si128((__m128i *) out, _mm_packs_epi32(qa, qb));
+}
+
+/*
+ * 8x8 forward dct with fused quantization
+ *  the block is done as two 4 column halves
+ */
+__attribute__((target("sse2")))
+static void fdct_quant_8x8_sse2(int16_t *out, const int16_t *in, const float *fdiv)
+{
+	__m128 l[8], r[8], tl[8], tr[8];
+	int i = 0;
+
+	for(i = 0; i < 8; i++)
+	{
+		l[i] = load4_ps_sse2(in + i * 8);
+		r[i] = load4_ps_sse2(in + i * 8 + 4);
+	}
+
+	/*columns*/
+	CS_FDCT_1D(__m128, l, SSE_ADD, SSE_SUB, SSE_MULK);
+	CS_FDCT_1D(__m128, r, SSE_ADD, SSE_SUB, SSE_MULK);
+
+	/*transpose (tl - rows 0-3, tr - rows 4-7)*/
+	for(i = 0; i < 4; i++)
+	{
+		tl[i] = l[i];
+		tl[i + 4] = r[i];
+		tr[i] = l[i + 4];
+		tr[i + 4] = r[i + 4];
+	}
+	_MM_TRANSPOSE4_PS(tl[0], tl[1], tl[2], tl[3]);
+	_MM_TRANSPOSE4_PS(tl[4], tl[5], tl[6], tl[7]);
+	_MM_TRANSPOSE4_PS(tr[0], tr[1], tr[2], tr[3]);
+	_MM_TRANSPOSE4_PS(tr[4], tr[5], tr[6], tr[7]);
+
+	/*rows*/
+	CS_FDCT_1D(__m128, tl, SSE_ADD, SSE_SUB, SSE_MULK);
+	CS_FDCT_1D(__m128, tr, SSE_ADD, SSE_SUB, SSE_MULK);
+
+	/*transpose back and quantize*/
+	_MM_TRANSPOSE4_PS(tl[0], tl[1], tl[2], tl[3]);
+	_MM_TRANSPOSE4_PS(tl[4], tl[5], tl[6], tl[7]);
+	_MM_TRANSPOSE4_PS(tr[0], tr[1], tr[2], tr[3]);
+	_MM_TRANSPOSE4_PS(tr[4], tr[5], tr[6], tr[7]);
+
+	for(i = 0; i < 4; i++)
+	{
+		quant_row8_sse2(out + i * 8, tl[i], tl[i + 4], fdiv + i * 8);
+		quant_row8_sse2(out + i * 8 + 32, tr[i], tr[i + 4], fdiv + i * 8 + 32);
+	}
+}
+
+/*
+ * 8 ints to 8 saturated bytes (in the low half)
+ */
+__attribute__((target("sse2")))
+static inline __m128i pack8_sse2(const int *in, __m128i bias)
+{
+	__m128i a = _mm_add_epi32(_mm_loadu_si128((const __m128i *) in), bias);
+	__m128i b = _mm_add_epi32(_mm_loadu_si128((const __m128i *) (in + 4)), bias);
+	return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_setzero_si128());
+}
+
+__attribute__((target("sse2")))
+static void mcu_row_to_yuyv_sse2(uint8_t *out, const int *py0, const int *py1,
+	const int *pu, const int *pv)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i bias = _mm_set1_epi32(128);
+
+	__m128i y = _mm_unpacklo_epi64(pack8_sse2(py0, zero), pack8_sse2(py1, zero));
+	__m128i uv = _mm_unpacklo_epi8(pack8_sse2(pu, bias), pack8_sse2(pv, bias));
+
+	_mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi8(y, uv));
+	_mm_storeu_si128((__m128i *) (out + 16), _mm_unpackhi_epi8(y, uv));
+}
+
+__attribute__((target("sse2")))
+static void pack_row8_sse2(uint8_t *out, const int *in0, const int *in1, int bias)
+{
+	__m128i vbias = _mm_set1_epi32(bias);
+	__m128i a = pack8_sse2(in0, vbias);
+
+	if(in1 != NULL)
+		a = avg_trunc_sse2(a, pack8_sse2(in1, vbias));
+
+	_mm_storel_epi64((__m128i *) out, a);
+}
+
+/*
+ * skip the 16 byte blocks without a 00 00 pair
+ */
+__attribute__((target("sse2")))
+static int find_zero_pair_sse2(const uint8_t *in, int size)
+{
+	__m128i zero = _mm_setzero_si128();
+	int i = 0;
+
+	for(i = 0; i + 16 <= size; i += 16)
+	{
+		__m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (in + i)), zero);
+		__m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (in + i + 1)), zero);
+
+		if(_mm_movemask_epi8(_mm_and_si128(a, b)))
+			break;
+	}
+
+	return i;
+}
+
+/*------------------------------- AVX2 ---------------------------------------*/
+
+__attribute__((target("avx2")))
+static inline __m256i avg_trunc_avx2(__m256i a, __m256i b)
+{
+	__m256i odd = _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1));
+	return _mm256_sub_epi8(_mm256_avg_epu8(a, b), odd);
+}
+
+/*
+ * pack the low bytes of the 16 bit lanes of a and b in order
+ *  (packus works per 128 bit lane so fix the qword order)
+ */
+__attribute__((target("avx2")))
+static inline __m256i pack_lo_avx2(__m256i a, __m256i b)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	return _mm256_permute4x64_epi64(
+		_mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask)), 0xD8);
+}
+
+/*
+ * two packed 422 lines to yu12 (32 pixels per iteration)
+ *  yshift - 0 if luma is on even bytes (yuyv), 8 if on odd bytes (uyvy)
+ */
+__attribute__((target("avx2")))
+static inline int packed422_to_yu12_rows_avx2(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width, int yshift)
+{
+	__m128i shift = _mm_cvtsi32_si128(yshift);
+	__m128i cshift = _mm_cvtsi32_si128(8 - yshift);
+
+	int w = 0;
+	for(w = 0; w + 32 <= width; w += 32)
+	{
+		__m256i a0 = _mm256_loadu_si256((const __m256i *) (in1 + w * 2));
+		__m256i a1 = _mm256_loadu_si256((const __m256i *) (in1 + w * 2 + 32));
+		__m256i b0 = _mm256_loadu_si256((const __m256i *) (in2 + w * 2));
+		__m256i b1 = _mm256_loadu_si256((const __m256i *) (in2 + w * 2 + 32));
+
+		/*luma*/
+		_mm256_storeu_si256((__m256i *) (py1 + w),
+			pack_lo_avx2(_mm256_srl_epi16(a0, shift), _mm256_srl_epi16(a1, shift)));
+		_mm256_storeu_si256((__m256i *) (py2 + w),
+			pack_lo_avx2(_mm256_srl_epi16(b0, shift), _mm256_srl_epi16(b1, shift)));
+
+		/*chroma (u0 v0 u1 v1 ...)*/
+		__m256i c = avg_trunc_avx2(
+			pack_lo_avx2(_mm256_srl_epi16(a0, cshift), _mm256_srl_epi16(a1, cshift)),
+			pack_lo_avx2(_mm256_srl_epi16(b0, cshift), _mm256_srl_epi16(b1, cshift)));
+
+		/*low 128 bits: u, high 128 bits: v*/
+		__m256i uv = pack_lo_avx2(c, _mm256_srli_epi16(c, 8));
+		_mm_storeu_si128((__m128i *) (pu + w / 2), _mm256_castsi256_si128(uv));
+		_mm_storeu_si128((__m128i *) (pv + w / 2), _mm256_extracti128_si256(uv, 1));
+	}
+
+	return w;
+}
+
+__attribute__((target("avx2")))
+static int yuyv_to_yu12_rows_avx2(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width)
+{
+	return packed422_to_yu12_rows_avx2(py1, py2, pu, pv, in1, in2, width, 0);
+}
+
+__attribute__((target("avx2")))
+static int uyvy_to_yu12_rows_avx2(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width)
+{
+	return packed422_to_yu12_rows_avx2(py1, py2, pu, pv, in1, in2, width, 8);
+}
+
+__attribute__((target("avx2")))
+static int split_uv_avx2(uint8_t *pu, uint8_t *pv, const uint8_t *puv, int n)
+{
+	int i = 0;
+	for(i = 0; i + 32 <= n; i += 32)
+	{
+		__m256i a0 = _mm256_loadu_si256((const __m256i *) (puv + i * 2));
+		__m256i a1 = _mm256_loadu_si256((const __m256i *) (puv + i * 2 + 32));
+
+		_mm256_storeu_si256((__m256i *) (pu + i), pack_lo_avx2(a0, a1));
+		_mm256_storeu_si256((__m256i *) (pv + i),
+			pack_lo_avx2(_mm256_srli_epi16(a0, 8), _mm256_srli_epi16(a1, 8)));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static int yu12_to_yuyv_row_avx2(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv, int width)
+{
+	int w = 0;
+	for(w = 0; w + 32 <= width; w += 32)
+	{
+		__m256i y = _mm256_loadu_si256((const __m256i *) (py + w));
+		__m128i u = _mm_loadu_si128((const __m128i *) (pu + w / 2));
+		__m128i v = _mm_loadu_si128((const __m128i *) (pv + w / 2));
+		__m256i uv = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_unpacklo_epi8(u, v)),
+			_mm_unpackhi_epi8(u, v), 1);
+
+		/*unpack works per 128 bit lane: lo = pixels 0-7,16-23 hi = 8-15,24-31*/
+		__m256i lo = _mm256_unpacklo_epi8(y, uv);
+		__m256i hi = _mm256_unpackhi_epi8(y, uv);
+
+		_mm256_storeu_si256((__m256i *) (out + w * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *) (out + w * 2 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	return w;
+}
+
+#define AVX_ADD(a, b) _mm256_add_ps(a, b)
+#define AVX_SUB(a, b) _mm256_sub_ps(a, b)
+#define AVX_MULK(a, k) _mm256_mul_ps(a, _mm256_set1_ps(k))
+
+__attribute__((target("avx2")))
+static inline void transpose8_ps_avx2(__m256 *r)
+{
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+/*
+ * 8x8 inverse dct with fused dequantization
+ *  (coefficients gathered in natural order, one row per vector)
+ */
+__attribute__((target("avx2")))
+static void idct_8x8_avx2(int *out, const int *in, const uint8_t *zz,
+	const float *fquant, float off)
+{
+	__m256 v[8];
+	int i = 0;
+
+	for(i = 0; i < 8; i++)
+	{
+		__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (zz + i * 8)));
+		__m256 c = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(in, idx, 4));
+		v[i] = _mm256_mul_ps(c, _mm256_loadu_ps(fquant + i * 8));
+	}
+
+	/*columns*/
+	CS_IDCT_1D(__m256, v, AVX_ADD, AVX_SUB, AVX_MULK);
+	transpose8_ps_avx2(v);
+	/*rows*/
+	CS_IDCT_1D(__m256, v, AVX_ADD, AVX_SUB, AVX_MULK);
+	transpose8_ps_avx2(v);
+
+	__m256 voff = _mm256_set1_ps(off);
+	for(i = 0; i < 8; i++)
+		_mm256_storeu_si256((__m256i *) (out + i * 8),
+			_mm256_cvtps_epi32(_mm256_add_ps(v[i], voff)));
+}
+
+/*
+ * 8x8 forward dct with fused quantization
+ *  (one row per vector)
+ */
+__attribute__((target("avx2")))
+static void fdct_quant_8x8_avx2(int16_t *out, const int16_t *in, const float *fdiv)
+{
+	__m256 v[8];
+	int i = 0;
+
+	for(i = 0; i < 8; i++)
+		v[i] = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			_mm_loadu_si128((const __m128i *) (in + i * 8))));
+
+	/*columns*/
+	CS_FDCT_1D(__m256, v, AVX_ADD, AVX_SUB, AVX_MULK);
+	transpose8_ps_avx2(v);
+	/*rows*/
+	CS_FDCT_1D(__m256, v, AVX_ADD, AVX_SUB, AVX_MULK);
+	transpose8_ps_avx2(v);
+
+	/*two rows per store (packs works per 128 bit lane so fix the qword order)*/
+	for(i = 0; i < 8; i += 2)
+	{
+		__m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(v[i], _mm256_loadu_ps(fdiv + i * 8)));
+		__m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(v[i + 1], _mm256_loadu_ps(fdiv + i * 8 + 8)));
+		_mm256_storeu_si256((__m256i *) (out + i * 8),
+			_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+	}
+}
+
+/*
+ * skip the 32 byte blocks without a 00 00 pair
+ */
+__attribute__((target("avx2")))
+static int find_zero_pair_avx2(const uint8_t *in, int size)
+{
+	__m256i zero = _mm256_setzero_si256();
+	int i = 0;
+
+	for(i = 0; i + 32 <= size; i += 32)
+	{
+		__m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (in + i)), zero);
+		__m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (in + i + 1)), zero);
+
+		if(!_mm256_testz_si256(a, b))
+			break;
+	}
+
+	return i;
+}
+
+#endif /*CS_SIMD_X86*/
+
+#ifdef CS_SIMD_NEON
+
+/*------------------------------- NEON ---------------------------------------*/
+
+/*
+ * two packed 422 lines to yu12 (32 pixels per iteration)
+ *  vld4 splits y0 u y1 v (yuyv) or u y0 v y1 (uyvy)
+ *  vhadd is the truncated average
+ */
+static int yuyv_to_yu12_rows_neon(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width)
+{
+	int w = 0;
+	for(w = 0; w + 32 <= width; w += 32)
+	{
+		uint8x16x4_t a = vld4q_u8(in1 + w * 2);
+		uint8x16x4_t b = vld4q_u8(in2 + w * 2);
+
+		uint8x16x2_t y1 = {{a.val[0], a.val[2]}};
+		uint8x16x2_t y2 = {{b.val[0], b.val[2]}};
+		vst2q_u8(py1 + w, y1);
+		vst2q_u8(py2 + w, y2);
+
+		vst1q_u8(pu + w / 2, vhaddq_u8(a.val[1], b.val[1]));
+		vst1q_u8(pv + w / 2, vhaddq_u8(a.val[3], b.val[3]));
+	}
+
+	return w;
+}
+
+static int uyvy_to_yu12_rows_neon(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2, int width)
+{
+	int w = 0;
+	for(w = 0; w + 32 <= width; w += 32)
+	{
+		uint8x16x4_t a = vld4q_u8(in1 + w * 2);
+		uint8x16x4_t b = vld4q_u8(in2 + w * 2);
+
+		uint8x16x2_t y1 = {{a.val[1], a.val[3]}};
+		uint8x16x2_t y2 = {{b.val[1], b.val[3]}};
+		vst2q_u8(py1 + w, y1);
+		vst2q_u8(py2 + w, y2);
+
+		vst1q_u8(pu + w / 2, vhaddq_u8(a.val[0], b.val[0]));
+		vst1q_u8(pv + w / 2, vhaddq_u8(a.val[2], b.val[2]));
+	}
+
+	return w;
+}
+
+static int split_uv_neon(uint8_t *pu, uint8_t *pv, const uint8_t *puv, int n)
+{
+	int i = 0;
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		uint8x16x2_t uv = vld2q_u8(puv + i * 2);
+		vst1q_u8(pu + i, uv.val[0]);
+		vst1q_u8(pv + i, uv.val[1]);
+	}
+
+	return i;
+}
+
+static int yu12_to_yuyv_row_neon(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv, int width)
+{
+	int w = 0;
+	for(w = 0; w + 16 <= width; w += 16)
+	{
+		uint8x8x2_t y = vld2_u8(py + w);
+		uint8x8x4_t yuyv = {{y.val[0], vld1_u8(pu + w / 2), y.val[1], vld1_u8(pv + w / 2)}};
+		vst4_u8(out + w * 2, yuyv);
+	}
+
+	return w;
+}
+
+#define NEON_ADD(a, b) vaddq_f32(a, b)
+#define NEON_SUB(a, b) vsubq_f32(a, b)
+#define NEON_MULK(a, k) vmulq_n_f32(a, k)
+
+static inline void transpose4_neon(float32x4_t *a, float32x4_t *b, float32x4_t *c, float32x4_t *d)
+{
+	float32x4x2_t t0 = vtrnq_f32(*a, *b);
+	float32x4x2_t t1 = vtrnq_f32(*c, *d);
+
+	*a = vcombine_f32(vget_low_f32(t0.val[0]), vget_low_f32(t1.val[0]));
+	*b = vcombine_f32(vget_low_f32(t0.val[1]), vget_low_f32(t1.val[1]));
+	*c = vcombine_f32(vget_high_f32(t0.val[0]), vget_high_f32(t1.val[0]));
+	*d = vcombine_f32(vget_high_f32(t0.val[1]), vget_high_f32(t1.val[1]));
+}
+
+/*
+ * float to int rounding to nearest
+ *  (vcvtq truncates towards zero, bias to keep the values positive)
+ */
+static inline int32x4_t round_neon(float32x4_t a, float off)
+{
+	return vsubq_s32(vcvtq_s32_f32(vaddq_f32(a, vdupq_n_f32(off + 4096.5f))), vdupq_n_s32(4096));
+}
+
+/*
+ * 8x8 inverse dct with fused dequantization
+ *  the block is done as two 4 column halves
+ */
+static void idct_8x8_neon(int *out, const int *in, const uint8_t *zz,
+	const float *fquant, float off)
+{
+	float blk[64] __attribute__((aligned(16)));
+	float32x4_t l[8], r[8], tl[8], tr[8];
+	int i = 0;
+
+	for(i = 0; i < 64; i++)
+		blk[i] = (float) in[zz[i]];
+
+	for(i = 0; i < 8; i++)
+	{
+		l[i] = vmulq_f32(vld1q_f32(blk + i * 8), vld1q_f32(fquant + i * 8));
+		r[i] = vmulq_f32(vld1q_f32(blk + i * 8 + 4), vld1q_f32(fquant + i * 8 + 4));
+	}
+
+	/*columns*/
+	CS_IDCT_1D(float32x4_t, l, NEON_ADD, NEON_SUB, NEON_MULK);
+	CS_IDCT_1D(float32x4_t, r, NEON_ADD, NEON_SUB, NEON_MULK);
+
+	/*transpose (tl - rows 0-3, tr - rows 4-7)*/
+	for(i = 0; i < 4; i++)
+	{
+		tl[i] = l[i];
+		tl[i + 4] = r[i];
+		tr[i] = l[i + 4];
+		tr[i + 4] = r[i + 4];
+	}
+	transpose4_neon(&tl[0], &tl[1], &tl[2], &tl[3]);
+	transpose4_neon(&tl[4], &tl[5], &tl[6], &tl[7]);
+	transpose4_neon(&tr[0], &tr[1], &tr[2], &tr[3]);
+	transpose4_neon(&tr[4], &tr[5], &tr[6], &tr[7]);
+
+	/*rows*/
+	CS_IDCT_1D(float32x4_t, tl, NEON_ADD, NEON_SUB, NEON_MULK);
+	CS_IDCT_1D(float32x4_t, tr, NEON_ADD, NEON_SUB, NEON_MULK);
+
+	/*transpose back and store*/
+	transpose4_neon(&tl[0], &tl[1], &tl[2], &tl[3]);
+	transpose4_neon(&tl[4], &tl[5], &tl[6], &tl[7]);
+	transpose4_neon(&tr[0], &tr[1], &tr[2], &tr[3]);
+	transpose4_neon(&tr[4], &tr[5], &tr[6], &tr[7]);
+
+	for(i = 0; i < 4; i++)
+	{
+		vst1q_s32(out + i * 8, round_neon(tl[i], off));
+		vst1q_s32(out + i * 8 + 4, round_neon(tl[i + 4], off));
+		vst1q_s32(out + i * 8 + 32, round_neon(tr[i], off));
+		vst1q_s32(out + i * 8 + 36, round_neon(tr[i + 4], off));
+	}
+}
+
+/*
+ * 4 int16 samples to float
+ */
+static inline float32x4_t load4_ps_neon(const int16_t *in)
+{
+	return vcvtq_f32_s32(vmovl_s16(vld1_s16(in)));
+}
+
+/*
+ * quantize and store one row (8 coefficients)
+ */
+static inline void quant_row8_neon(int16_t *out, float32x4_t a, float32x4_t b, const float *fdiv)
+{
+	int32x4_t qa = round_neon(vmulq_f32(a, vld1q_f32(fdiv)), 0.0f);
+	int32x4_t qb = round_neon(vmulq_f32(b, vld1q_f32(fdiv + 4)), 0.0f);
+	vst1q_s16(out, vcombine_s16(vqmovn_s32(qa), vqmovn_s32(qb)));
+}
+
+/*
+ * 8x8 forward dct with fused quantization
+ *  the block is done as two 4 column halves
+ */
+static void fdct_quant_8x8_neon(int16_t *out, const int16_t *in, const float *fdiv)
+{
+	float32x4_t l[8], r[8], tl[8], tr[8];
+	int i = 0;
+
+	for(i = 0; i < 8; i++)
+	{
+		l[i] = load4_ps_neon(in + i * 8);
+		r[i] = load4_ps_neon(in + i * 8 + 4);
+	}
+
+	/*columns*/
+	CS_FDCT_1D(float32x4_t, l, NEON_ADD, NEON_SUB, NEON_MULK);
+	CS_FDCT_1D(float32x4_t, r, NEON_ADD, NEON_SUB, NEON_MULK);
+
+	/*transpose (tl - rows 0-3, tr - rows 4-7)*/
+	for(i = 0; i < 4; i++)
+	{
+		tl[i] = l[i];
+		tl[i + 4] = r[i];
+		tr[i] = l[i + 4];
+		tr[i + 4] = r[i + 4];
+	}
+	transpose4_neon(&tl[0], &tl[1], &tl[2], &tl[3]);
+	transpose4_neon(&tl[4], &tl[5], &tl[6], &tl[7]);
+	transpose4_neon(&tr[0], &tr[1], &tr[2], &tr[3]);
+	transpose4_neon(&tr[4], &tr[5], &tr[6], &tr[7]);
+
+	/*rows*/
+	CS_FDCT_1D(float32x4_t, tl, NEON_ADD, NEON_SUB, NEON_MULK);
+	CS_FDCT_1D(float32x4_t, tr, NEON_ADD, NEON_SUB, NEON_MULK);
+
+	/*transpose back and quantize*/
+	transpose4_neon(&tl[0], &tl[1], &tl[2], &tl[3]);
+	transpose4_neon(&tl[4], &tl[5], &tl[6], &tl[7]);
+	transpose4_neon(&tr[0], &tr[1], &tr[2], &tr[3]);
+	transpose4_neon(&tr[4], &tr[5], &tr[6], &tr[7]);
+
+	for(i = 0; i < 4; i++)
+	{
+		quant_row8_neon(out + i * 8, tl[i], tl[i + 4], fdiv + i * 8);
+		quant_row8_neon(out + i * 8 + 32, tr[i], tr[i + 4], fdiv + i * 8 + 32);
+	}
+}
+
+/*
+ * 8 ints to 8 saturated bytes
+ */
+static inline uint8x8_t pack8_neon(const int *in, int32x4_t bias)
+{
+	int32x4_t a = vaddq_s32(vld1q_s32(in), bias);
+	int32x4_t b = vaddq_s32(vld1q_s32(in + 4), bias);
+	return vqmovun_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+}
+
+static void mcu_row_to_yuyv_neon(uint8_t *out, const int *py0, const int *py1,
+	const int *pu, const int *pv)
+{
+	int32x4_t zero = vdupq_n_s32(0);
+	int32x4_t bias = vdupq_n_s32(128);
+
+	uint8x16_t y = vcombine_u8(pack8_neon(py0, zero), pack8_neon(py1, zero));
+	uint8x8x2_t uv = vzip_u8(pack8_neon(pu, bias), pack8_neon(pv, bias));
+	uint8x16x2_t yuyv = {{y, vcombine_u8(uv.val[0], uv.val[1])}};
+
+	vst2q_u8(out, yuyv);
+}
+
+static void pack_row8_neon(uint8_t *out, const int *in0, const int *in1, int bias)
+{
+	int32x4_t vbias = vdupq_n_s32(bias);
+	uint8x8_t a = pack8_neon(in0, vbias);
+
+	if(in1 != NULL)
+		a = vhadd_u8(a, pack8_neon(in1, vbias));
+
+	vst1_u8(out, a);
+}
+
+/*
+ * skip the 16 byte blocks without a 00 00 pair
+ */
+static int find_zero_pair_neon(const uint8_t *in, int size)
+{
+	int i = 0;
+
+	for(i = 0; i + 16 <= size; i += 16)
+	{
+		uint8x16_t m = vandq_u8(vceqq_u8(vld1q_u8(in + i), vdupq_n_u8(0)),
+			vceqq_u8(vld1q_u8(in + i + 1), vdupq_n_u8(0)));
+		uint8x8_t m8 = vorr_u8(vget_low_u8(m), vget_high_u8(m));
+
+		if(vget_lane_u64(vreinterpret_u64_u8(m8), 0))
+			break;
+	}
+
+	return i;
+}
+
+#endif /*CS_SIMD_NEON*/
+
+/*
+ * select the kernels for the running cpu
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void colorspaces_init_simd()
+{
+	/*GUVCVIEW_NO_SIMD forces the scalar (reference) code*/
+	char *env = getenv("GUVCVIEW_NO_SIMD");
+	if(env != NULL && strcmp(env, "0") != 0)
+		return;
+
+#ifdef CS_SIMD_X86
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2"))
+	{
+		cs_simd.name = "avx2";
+		cs_simd.yuyv_to_yu12_rows = yuyv_to_yu12_rows_avx2;
+		cs_simd.uyvy_to_yu12_rows = uyvy_to_yu12_rows_avx2;
+		cs_simd.split_uv = split_uv_avx2;
+		cs_simd.yu12_to_yuyv_row = yu12_to_yuyv_row_avx2;
+		cs_simd.idct_8x8 = idct_8x8_avx2;
+		/*mcu rows are 16 pixels wide, sse2 is enough*/
+		cs_simd.mcu_row_to_yuyv = mcu_row_to_yuyv_sse2;
+		cs_simd.pack_row8 = pack_row8_sse2;
+		cs_simd.fdct_quant_8x8 = fdct_quant_8x8_avx2;
+		cs_simd.find_zero_pair = find_zero_pair_avx2;
+	}
+	else if(__builtin_cpu_supports("sse2"))
+	{
+		cs_simd.name = "sse2";
+		cs_simd.yuyv_to_yu12_rows = yuyv_to_yu12_rows_sse2;
+		cs_simd.uyvy_to_yu12_rows = uyvy_to_yu12_rows_sse2;
+		cs_simd.split_uv = split_uv_sse2;
+		cs_simd.yu12_to_yuyv_row = yu12_to_yuyv_row_sse2;
+		cs_simd.idct_8x8 = idct_8x8_sse2;
+		cs_simd.mcu_row_to_yuyv = mcu_row_to_yuyv_sse2;
+		cs_simd.pack_row8 = pack_row8_sse2;
+		cs_simd.fdct_quant_8x8 = fdct_quant_8x8_sse2;
+		cs_simd.find_zero_pair = find_zero_pair_sse2;
+	}
+#endif
+
+#ifdef CS_SIMD_NEON
+	cs_simd.name = "neon";
+	cs_simd.yuyv_to_yu12_rows = yuyv_to_yu12_rows_neon;
+	cs_simd.uyvy_to_yu12_rows = uyvy_to_yu12_rows_neon;
+	cs_simd.split_uv = split_uv_neon;
+	cs_simd.yu12_to_yuyv_row = yu12_to_yuyv_row_neon;
+	cs_simd.idct_8x8 = idct_8x8_neon;
+	cs_simd.mcu_row_to_yuyv = mcu_row_to_yuyv_neon;
+	cs_simd.pack_row8 = pack_row8_neon;
+	cs_simd.fdct_quant_8x8 = fdct_quant_8x8_neon;
+	cs_simd.find_zero_pair = find_zero_pair_neon;
+#endif
+}
+
+/*
+ * get the colorspace kernels for the running cpu
+ *  (resolved once, on first use)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to kernel table (never NULL)
+ */
+const cs_simd_t *colorspaces_get_simd()
+{
+	pthread_once(&cs_simd_once, colorspaces_init_simd);
+	return &cs_simd;
+}
@@ -0,0 +1,113 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef COLORSPACES_SIMD_H
+#define COLORSPACES_SIMD_H
+
+#include <inttypes.h>
+
+/*
+ * vectorized row kernels used by the colorspace converters
+ *  each kernel processes the largest multiple of its vector width
+ *  and returns the number of pixels (or samples) done, the caller
+ *  finishes the row with the scalar code.
+ *  A NULL kernel means no vector version is available for this cpu.
+ */
+typedef struct _cs_simd_t
+{
+	const char *name; /*selected instruction set (scalar, sse2, avx2, neon)*/
+
+	/*
+	 * two packed 422 lines (yuyv or uyvy) to yu12
+	 *  chroma is the truncated average of both lines
+	 */
+	int (*yuyv_to_yu12_rows)(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+		const uint8_t *in1, const uint8_t *in2, int width);
+	int (*uyvy_to_yu12_rows)(uint8_t *py1, uint8_t *py2, uint8_t *pu, uint8_t *pv,
+		const uint8_t *in1, const uint8_t *in2, int width);
+
+	/*interleaved chroma (uvuv...) to separate planes, n is the number of uv pairs*/
+	int (*split_uv)(uint8_t *pu, uint8_t *pv, const uint8_t *puv, int n);
+
+	/*one yu12 line (and its chroma line) to packed yuyv*/
+	int (*yu12_to_yuyv_row)(uint8_t *out, const uint8_t *py,
+		const uint8_t *pu, const uint8_t *pv, int width);
+
+	/*
+	 * fixed size kernels used by the builtin jpeg decoder
+	 *  (these always process the whole block or row)
+	 */
+
+	/*
+	 * 8x8 inverse dct (AAN) with fused dequantization
+	 *  in[zz[n]] is the coefficient for natural position n,
+	 *  fquant is the dequantization table in natural order
+	 *  prescaled by the AAN factors (and 1/8), off is added
+	 *  to every output sample (128 for luma)
+	 */
+	void (*idct_8x8)(int *out, const int *in, const uint8_t *zz,
+		const float *fquant, float off);
+
+	/*16 pixels of an mcu line (two 8 sample luma rows, 8 u and 8 v) to yuyv*/
+	void (*mcu_row_to_yuyv)(uint8_t *out, const int *py0, const int *py1,
+		const int *pu, const int *pv);
+
+	/*
+	 * 8 samples to bytes (saturated), adding bias
+	 *  if in1 is not NULL the truncated average of both (saturated) rows is used
+	 */
+	void (*pack_row8)(uint8_t *out, const int *in0, const int *in1, int bias);
+
+	/*
+	 * fixed size kernel used by the jpeg encoder
+	 */
+
+	/*
+	 * 8x8 forward dct (AAN) with fused quantization
+	 *  in holds the level shifted samples and out gets the rounded
+	 *  coefficients, both in natural order, fdiv is the reciprocal
+	 *  quantization table prescaled by the AAN factors (and 1/8)
+	 */
+	void (*fdct_quant_8x8)(int16_t *out, const int16_t *in, const float *fdiv);
+
+	/*
+	 * h264 start code search (used by the h264 demuxer)
+	 *  returns the number of leading positions that don't start
+	 *  a 00 00 byte pair (a multiple of the vector width),
+	 *  reads in[0..size]
+	 */
+	int (*find_zero_pair)(const uint8_t *in, int size);
+} cs_simd_t;
+
+/*
+ * get the colorspace kernels for the running cpu
+ *  (resolved once, on first use)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to kernel table (never NULL)
+ */
+const cs_simd_t *colorspaces_get_simd();
+
+#endif
@@ -30,12 +30,18 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <libv4l2.h>
 
 #include "gviewv4l2core.h"
 #include "uvc_h264.h"
 #include "frame_decoder.h"
+#include "frame_pipeline.h"
 #include "jpeg_decoder.h"
 #include "colorspaces.h"
+#include "colorspaces_simd.h"
+#include "core_time.h"
 #include "../config.h"
 
 extern int verbosity;
@@ -79,7 +85,7 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 	{
 		case V4L2_PIX_FMT_H264:
 			/*init h264 context*/
-			ret = h264_init_decoder(width, height);
+			ret = h264_init_decoder(vd, width, height);
 
 			if(ret)
 			{
@@ -99,6 +105,8 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
 					exit(-1);
 				}
+				/*h264_frame may later point to the raw frame (zero copy)*/
+				vd->frame_queue[i].h264_frame_buffer = vd->frame_queue[i].h264_frame;
 				
 				vd->frame_queue[i].yuv_frame = calloc(framesizeIn, sizeof(uint8_t));
 				if(vd->frame_queue[i].yuv_frame == NULL)
@@ -106,19 +114,8 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
 					exit(-1);
 				}
-				
-#ifdef USE_PLANAR_YUV
-				/*no need for a temp buffer*/
-#else
-				/* alloc a temp buffer for colorspace conversion*/
-				vd->frame_queue[i].tmp_buffer_max_size = width * height * 2;
-				vd->frame_queue[i].tmp_buffer = calloc(vd->frame_queue[i].tmp_buffer_max_size, sizeof(uint8_t));
-				if(vd->frame_queue[i].tmp_buffer == NULL)
-				{
-					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-					exit(-1);
-				}
-#endif
+
+				/*the decoder writes the yuv frame directly (no temp buffer)*/
 			}
 			
 			vd->h264_last_IDR = calloc(width * height, sizeof(uint8_t));
@@ -134,7 +131,7 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 		case V4L2_PIX_FMT_JPEG:
 		case V4L2_PIX_FMT_MJPEG:
 			/*init jpeg decoder*/
-			ret = jpeg_init_decoder(width, height);
+			ret = jpeg_init_decoder(vd, width, height);
 
 			if(ret)
 			{
@@ -167,65 +164,14 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 		case V4L2_PIX_FMT_SPCA501:
 		case V4L2_PIX_FMT_SPCA505:
 		case V4L2_PIX_FMT_SPCA508:
-			framebuf_size = framesizeIn;
-			/*frame queue*/
-			for(i=0; i<vd->frame_queue_size; ++i)
-			{
-				/*FIXME: do we need the temp buffer ?*/
-				/* alloc a temp buffer for colorspace conversion*/
-				vd->frame_queue[i].tmp_buffer_max_size = width * height * 2;
-				vd->frame_queue[i].tmp_buffer = calloc(vd->frame_queue[i].tmp_buffer_max_size, sizeof(uint8_t));
-				if(vd->frame_queue[i].tmp_buffer == NULL)
-				{
-					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-					exit(-1);
-				}
-			
-				vd->frame_queue[i].yuv_frame = calloc(framebuf_size, sizeof(uint8_t));
-				if(vd->frame_queue[i].yuv_frame == NULL)
-				{
-					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-					exit(-1);
-				}
-			}
-			break;
-
 		case V4L2_PIX_FMT_GREY:
+		case V4L2_PIX_FMT_Y10BPACK:
+		case V4L2_PIX_FMT_Y16:
+			/*convert directly from raw_frame (no temp buffer)*/
 			framebuf_size = framesizeIn;
 			/*frame queue*/
 			for(i=0; i<vd->frame_queue_size; ++i)
 			{
-				/* alloc a temp buffer for colorspace conversion*/
-				vd->frame_queue[i].tmp_buffer_max_size = width * height; /* 1 byte per pixel*/
-				vd->frame_queue[i].tmp_buffer = calloc(vd->frame_queue[i].tmp_buffer_max_size, sizeof(uint8_t));
-				if(vd->frame_queue[i].tmp_buffer == NULL)
-				{
-					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-					exit(-1);
-				}
-				vd->frame_queue[i].yuv_frame = calloc(framebuf_size, sizeof(uint8_t));
-				if(vd->frame_queue[i].yuv_frame == NULL)
-				{
-					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-					exit(-1);
-				}
-			}
-			break;
-
-	    case V4L2_PIX_FMT_Y10BPACK:
-	    case V4L2_PIX_FMT_Y16:
-			framebuf_size = framesizeIn;
-			/*frame queue*/
-			for(i=0; i<vd->frame_queue_size; ++i)
-			{
-				/* alloc a temp buffer for colorspace conversion*/
-				vd->frame_queue[i].tmp_buffer_max_size = framesizeIn; /* 2 byte per pixel*/
-				vd->frame_queue[i].tmp_buffer = calloc(vd->frame_queue[i].tmp_buffer_max_size, sizeof(uint8_t));
-				if(vd->frame_queue[i].tmp_buffer == NULL)
-				{
-					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-					exit(-1);
-				}
 				vd->frame_queue[i].yuv_frame = calloc(framebuf_size, sizeof(uint8_t));
 				if(vd->frame_queue[i].yuv_frame == NULL)
 				{
@@ -322,8 +268,9 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 				if(vd->frame_queue[i].tmp_buffer)
 					free(vd->frame_queue[i].tmp_buffer);
 				vd->frame_queue[i].tmp_buffer = NULL;
-				if(vd->frame_queue[i].h264_frame)
-					free(vd->frame_queue[i].h264_frame);
+				if(vd->frame_queue[i].h264_frame_buffer)
+					free(vd->frame_queue[i].h264_frame_buffer);
+				vd->frame_queue[i].h264_frame_buffer = NULL;
 				vd->frame_queue[i].h264_frame = NULL;
 			}
 			return (ret);
@@ -331,6 +278,9 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 
 	for(i=0; i<vd->frame_queue_size; ++i)
 	{
+		/*yuv_frame may later point to the raw frame (zero copy)*/
+		vd->frame_queue[i].yuv_frame_buffer = vd->frame_queue[i].yuv_frame;
+
 		int j = 0;
 		/* set framebuffer to black (y=0x00 u=0x80 v=0x80) by default*/
 #ifdef USE_PLANAR_YUV
@@ -351,9 +301,354 @@ int alloc_v4l2_frames(v4l2_dev_t *vd)
 		}
 #endif
 	}
+
+	/*start the decoder workers (if enabled)*/
+	if(ret == E_OK)
+		ret = frame_pipeline_create(vd);
+
 	return (ret);
 }
 
+/*
+ * buffers of a frame still held (refcount > 0) when the
+ *  frame buffers were torn down: freed by its last release
+ */
+typedef struct _frame_orphan_t
+{
+	void *mem;          //driver (or frame source) buffer (NULL - none)
+	size_t mem_length;  //mmaped length (0 - heap buffer)
+	uint8_t *raw_copy;  //pipeline raw frame copy (NULL - none)
+} frame_orphan_t;
+
+/*
+ * frame queue detached from the device with frames still held
+ */
+typedef struct _frame_queue_orphan_t
+{
+	v4l2_frame_buff_t *queue;  //detached frame queue (only the held frames are set)
+	frame_orphan_t *orphan;    //detached buffers of the held frames
+	int size;                  //frame queue size
+	int held;                  //frames still held
+	struct _frame_queue_orphan_t *next;
+} frame_queue_orphan_t;
+
+/*
+ * frees the buffers detached from a frame
+ * args:
+ *   orphan - pointer to the detached buffers
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void free_frame_orphan(frame_orphan_t *orphan)
+{
+	if(orphan->mem != NULL)
+	{
+		if(orphan->mem_length > 0)
+			v4l2_munmap(orphan->mem, orphan->mem_length);
+		else
+			free(orphan->mem);
+	}
+	free(orphan->raw_copy);
+
+	orphan->mem = NULL;
+	orphan->mem_length = 0;
+	orphan->raw_copy = NULL;
+}
+
+/*
+ * counts the frames handed out (refcount > 0)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of held frames
+ */
+static int count_v4l2_held_frames(v4l2_dev_t *vd)
+{
+	int held = 0;
+	int i = 0;
+	for(i = 0; i < vd->frame_queue_size; ++i)
+		if(__atomic_load_n(&vd->frame_queue[i].refcount, __ATOMIC_ACQUIRE) > 0)
+			held++;
+
+	return held;
+}
+
+/*
+ * wait for the frames handed out to be released (refcount 0)
+ *  e.g. frames referenced by the encoder ring buffer: their data
+ *  (raw driver buffer or yuv buffer) must not be freed before that
+ * args:
+ *   vd - pointer to video device data
+ *   timeout_ms - maximum wait time in ms
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of frames still held
+ */
+int wait_v4l2_frames_released(v4l2_dev_t *vd, int timeout_ms)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	struct timespec abstime;
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_sec += timeout_ms / 1000;
+	abstime.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+	if(abstime.tv_nsec >= 1000000000L)
+	{
+		abstime.tv_sec++;
+		abstime.tv_nsec -= 1000000000L;
+	}
+
+	int held = 0;
+	int ret = 0;
+
+	__LOCK_MUTEX(&vd->release_mutex);
+	while((held = count_v4l2_held_frames(vd)) > 0 && ret == 0)
+		ret = __COND_TIMED_WAIT(&vd->release_cond, &vd->release_mutex, &abstime);
+	__UNLOCK_MUTEX(&vd->release_mutex);
+
+	if(held > 0)
+		fprintf(stderr, "V4L2_CORE: %i referenced frames not released after %i ms\n", held, timeout_ms);
+
+	return held;
+}
+
+/*
+ * detaches the driver buffers of the frames still held, so that
+ *  the buffers can be unmapped and requeued (e.g. on a fps change)
+ *  the detached buffers are freed when the frames are released
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of detached buffers
+ */
+int detach_v4l2_buffers(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	/*read io reuses a single buffer and frames can't be held*/
+	if(vd->cap_meth == IO_READ)
+		return 0;
+
+	int detached = 0;
+
+	__LOCK_MUTEX(&vd->release_mutex);
+
+	int i = 0;
+	for(i = 0; i < vd->frame_queue_size; ++i)
+	{
+		v4l2_frame_buff_t *frame = &vd->frame_queue[i];
+		if(__atomic_load_n(&frame->refcount, __ATOMIC_ACQUIRE) <= 0)
+			continue;
+
+		/*without the pipeline the frame holds its buffer until released*/
+		if(vd->pipeline != NULL && !frame_pipeline_detach_frame(vd, frame, NULL))
+			continue;
+
+		int index = frame->index;
+		if(index < 0 || index >= NB_BUFFER ||
+		   vd->mem[index] == MAP_FAILED || vd->mem[index] == NULL)
+			continue;
+
+		if(vd->frame_orphan == NULL)
+		{
+			vd->frame_orphan = calloc(vd->frame_queue_size, sizeof(frame_orphan_t));
+			if(vd->frame_orphan == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (detach_v4l2_buffers): %s\n", strerror(errno));
+				exit(-1);
+			}
+		}
+
+		vd->frame_orphan[i].mem = vd->mem[index];
+		/*frame source and userptr buffers are heap allocated*/
+		if(vd->source == NULL && vd->cap_meth != IO_USERPTR)
+			vd->frame_orphan[i].mem_length = vd->buff_length[index];
+
+		/*the buffer is no longer ours to unmap or requeue*/
+		vd->mem[index] = MAP_FAILED;
+		vd->buff_length[index] = 0;
+		detached++;
+	}
+
+	__UNLOCK_MUTEX(&vd->release_mutex);
+
+	if(detached > 0 && verbosity > 0)
+		printf("V4L2_CORE: detached %i buffers from held frames\n", detached);
+
+	return detached;
+}
+
+/*
+ * detaches the frames still held from the frame queue, so that the
+ *  frame buffers can be freed: the device gets a new frame queue
+ *  and the held frames keep their buffers until released
+ *  (must be called after detach_v4l2_buffers)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+static void detach_v4l2_frame_queue(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	frame_queue_orphan_t *detached = calloc(1, sizeof(frame_queue_orphan_t));
+	v4l2_frame_buff_t *queue = calloc(vd->frame_queue_size, sizeof(v4l2_frame_buff_t));
+	if(detached == NULL || queue == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (detach_v4l2_frame_queue): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	__LOCK_MUTEX(&vd->release_mutex);
+
+	detached->orphan = vd->frame_orphan;
+	if(detached->orphan == NULL)
+		detached->orphan = calloc(vd->frame_queue_size, sizeof(frame_orphan_t));
+	if(detached->orphan == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (detach_v4l2_frame_queue): %s\n", strerror(errno));
+		exit(-1);
+	}
+	vd->frame_orphan = NULL;
+
+	/*the new queue gets the buffers of the released frames*/
+	int i = 0;
+	for(i = 0; i < vd->frame_queue_size; ++i)
+	{
+		v4l2_frame_buff_t *frame = &vd->frame_queue[i];
+		if(__atomic_load_n(&frame->refcount, __ATOMIC_ACQUIRE) <= 0)
+		{
+			queue[i] = *frame;
+			memset(frame, 0, sizeof(v4l2_frame_buff_t));
+			continue;
+		}
+
+		if(vd->pipeline != NULL)
+			frame_pipeline_detach_frame(vd, frame, &detached->orphan[i].raw_copy);
+
+		detached->held++;
+	}
+
+	detached->queue = vd->frame_queue;
+	detached->size = vd->frame_queue_size;
+	detached->next = vd->detached_queues;
+	vd->detached_queues = detached;
+
+	vd->frame_queue = queue;
+
+	__UNLOCK_MUTEX(&vd->release_mutex);
+
+	fprintf(stderr, "V4L2_CORE: detached %i held frames from the frame queue\n", detached->held);
+}
+
+/*
+ * releases the buffers detached from a frame (last reference)
+ *  must be called with vd->release_mutex locked
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: FRAME_ORPHAN_NONE - nothing detached,
+ *   FRAME_ORPHAN_BUFFER - the driver buffer was detached (don't requeue it)
+ *   FRAME_ORPHAN_QUEUE - the frame was detached from the frame queue (nothing else to release)
+ */
+int release_v4l2_frame_orphan(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*assertions*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	int i = frame - vd->frame_queue;
+	if(i >= 0 && i < vd->frame_queue_size)
+	{
+		if(vd->frame_orphan == NULL ||
+		   (vd->frame_orphan[i].mem == NULL && vd->frame_orphan[i].raw_copy == NULL))
+			return FRAME_ORPHAN_NONE;
+
+		free_frame_orphan(&vd->frame_orphan[i]);
+		return FRAME_ORPHAN_BUFFER;
+	}
+
+	frame_queue_orphan_t **pdetached = &vd->detached_queues;
+	while(*pdetached != NULL)
+	{
+		frame_queue_orphan_t *detached = *pdetached;
+		i = frame - detached->queue;
+		if(i < 0 || i >= detached->size)
+		{
+			pdetached = &detached->next;
+			continue;
+		}
+
+		free_frame_orphan(&detached->orphan[i]);
+		free(frame->tmp_buffer);
+		free(frame->h264_frame_buffer);
+		free(frame->yuv_frame_buffer);
+		memset(frame, 0, sizeof(v4l2_frame_buff_t));
+
+		detached->held--;
+		if(detached->held <= 0)
+		{
+			*pdetached = detached->next;
+			free(detached->orphan);
+			free(detached->queue);
+			free(detached);
+		}
+
+		return FRAME_ORPHAN_QUEUE;
+	}
+
+	return FRAME_ORPHAN_NONE;
+}
+
+/*
+ * frees the detached buffers and frame queues left at close
+ *  (frames still held at this point are leaked: their holder
+ *   must not release them after the device is closed)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void free_v4l2_frame_orphans(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(vd->detached_queues != NULL)
+		fprintf(stderr, "V4L2_CORE: closing the device with frames still held\n");
+
+	vd->detached_queues = NULL;
+
+	free(vd->frame_orphan);
+	vd->frame_orphan = NULL;
+}
+
 /*
  * free image buffers for decoding video stream
  * args:
@@ -369,6 +664,19 @@ void clean_v4l2_frames(v4l2_dev_t *vd)
 	/*assertions*/
 	assert(vd != NULL);
 
+	/*
+	 * frames may still be referenced by other threads:
+	 * detach the ones not released in time (they keep their buffers)
+	 */
+	if(wait_v4l2_frames_released(vd, FRAME_RELEASE_TIMEOUT_MS) > 0)
+	{
+		detach_v4l2_buffers(vd);
+		detach_v4l2_frame_queue(vd);
+	}
+
+	/*stop the decoder workers*/
+	frame_pipeline_destroy(vd);
+
 	int i = 0;
 	
 	for(i=0; i<vd->frame_queue_size; ++i)
@@ -381,17 +689,22 @@ void clean_v4l2_frames(v4l2_dev_t *vd)
 			vd->frame_queue[i].tmp_buffer = NULL;
 		}
 
-		if(vd->frame_queue[i].h264_frame)
+		/*h264_frame may be pointing to the raw frame, free the allocated buffer*/
+		if(vd->frame_queue[i].h264_frame_buffer)
 		{
-			free(vd->frame_queue[i].h264_frame);
-			vd->frame_queue[i].h264_frame = NULL;
+			free(vd->frame_queue[i].h264_frame_buffer);
+			vd->frame_queue[i].h264_frame_buffer = NULL;
 		}
+		vd->frame_queue[i].h264_frame = NULL;
+		vd->frame_queue[i].h264_nal_count = 0;
 
-		if(vd->frame_queue[i].yuv_frame)
+		/*yuv_frame may be pointing to the raw frame, free the allocated buffer*/
+		if(vd->frame_queue[i].yuv_frame_buffer)
 		{
-			free(vd->frame_queue[i].yuv_frame);
-			vd->frame_queue[i].yuv_frame = NULL;
+			free(vd->frame_queue[i].yuv_frame_buffer);
+			vd->frame_queue[i].yuv_frame_buffer = NULL;
 		}
+		vd->frame_queue[i].yuv_frame = NULL;
 	}
 
 	if(vd->h264_last_IDR)
@@ -413,161 +726,272 @@ void clean_v4l2_frames(v4l2_dev_t *vd)
 	}
 
 	if(vd->requested_fmt == V4L2_PIX_FMT_H264)
-		h264_close_decoder();
+		h264_close_decoder(vd);
 
 	if(vd->requested_fmt == V4L2_PIX_FMT_JPEG ||
 	   vd->requested_fmt == V4L2_PIX_FMT_MJPEG)
-		jpeg_close_decoder();
+		jpeg_close_decoder(vd);
 }
 
 /*
- * check buff (*buff) of size (size) for NALU type (type)
+ * find the next h264 start code (00 00 01)
+ *  00 00 pairs are rare in h264 data (emulation prevention) so the
+ *  vector kernel skips most of it, without one the last start code
+ *  byte is searched with memchr (vectorized in libc)
  * args:
- *    type - NALU type
- *    buff - buffer with MJPG uvc frame containing h264 data
- *    size - buffer size
+ *    sp - first position where the start code may begin
+ *    end - end of data
  *
  * asserts:
- *    buff is not null
+ *    none
  *
- * returns: buffer pointer to NALU type data if found
- *          NULL if not found
+ * returns: pointer to the last start code byte (01) or NULL if not found
  */
-static uint8_t* check_NALU(uint8_t type, uint8_t *buff, int size)
+static uint8_t *find_h264_start_code(uint8_t *sp, uint8_t *end)
 {
-	/*asserts*/
-	assert(buff != NULL);
+	const cs_simd_t *simd = colorspaces_get_simd();
 
-	uint8_t *sp = buff;
-	uint8_t *nal = NULL;
-	//search for NALU of type
-	for(sp = buff; sp < buff + size - 5; ++sp)
+	if(simd->find_zero_pair == NULL)
 	{
-		if(sp[0] == 0x00 &&
-		   sp[1] == 0x00 &&
-		   sp[2] == 0x00 &&
-		   sp[3] == 0x01 &&
-		   (sp[4] & 0x1F) == type)
+		uint8_t *p = sp + 2;
+		while(p < end && (p = memchr(p, 0x01, end - p)) != NULL)
 		{
-			/*found it*/
-			nal = sp + 4;
-			break;
+			if(p[-1] == 0x00 && p[-2] == 0x00)
+				return p;
+			p++;
 		}
+		return NULL;
 	}
 
-	return nal;
+	while(end - sp >= 3)
+	{
+		sp += simd->find_zero_pair(sp, (end - sp) - 2);
+
+		/*check the block with the 00 00 pair (or the tail)*/
+		uint8_t *block_end = (end - sp) > 34 ? sp + 32 : end - 2;
+		for(; sp < block_end; ++sp)
+			if(sp[0] == 0x00 && sp[1] == 0x00 && sp[2] == 0x01)
+				return sp + 2;
+	}
+
+	return NULL;
 }
 
 /*
- * parses a buff (*buff) of size (size) for NALU type (type)
+ * index the h264 NAL units (can be called as data is added)
+ *  finds the start codes (00 00 01 or 00 00 00 01)
+ * args:
+ *    frame - pointer to frame buffer (h264_frame data and NAL index)
+ *    scanned - pointer to the number of bytes already searched (updated)
+ *    size - h264 data size (bytes)
+ *
+ * asserts:
+ *    frame is not null
+ *    scanned is not null
+ *
+ * returns: none
+ */
+static void index_h264_nalus(v4l2_frame_buff_t *frame, size_t *scanned, size_t size)
+{
+	/*asserts*/
+	assert(frame != NULL);
+	assert(scanned != NULL);
+
+	uint8_t *data = frame->h264_frame;
+	uint8_t *end = data + size;
+	/*the start code may begin in the previous block*/
+	uint8_t *sp = data + (*scanned > 2 ? *scanned - 2 : 0);
+
+	for(;;)
+	{
+		uint8_t *p = find_h264_start_code(sp, end);
+		if(p == NULL)
+			break;
+
+		sp = p + 1;
+
+		size_t sc_start = (p - 2) - data;
+		if(sc_start > 0 && p[-3] == 0x00)
+			sc_start--; /*4 byte start code*/
+
+		int n = frame->h264_nal_count;
+		if(n >= H264_MAX_NALS)
+			continue; /*the last entry takes the rest*/
+
+		if(n > 0)
+			frame->h264_nal[n - 1].size = sc_start - frame->h264_nal[n - 1].offset;
+
+		frame->h264_nal[n].offset = (p + 1) - data;
+		frame->h264_nal[n].size = 0;
+		frame->h264_nal[n].type = 0;
+		frame->h264_nal_count++;
+	}
+
+	*scanned = size;
+}
+
+/*
+ * finish the h264 NAL units index (sets the types and last size)
+ * args:
+ *    frame - pointer to frame buffer (h264_frame data and NAL index)
+ *    size - h264 data size (bytes)
+ *
+ * asserts:
+ *    frame is not null
+ *
+ * returns: none
+ */
+static void index_h264_done(v4l2_frame_buff_t *frame, size_t size)
+{
+	/*asserts*/
+	assert(frame != NULL);
+
+	int n = frame->h264_nal_count;
+
+	/*
+	 * start code at the end of data (no NAL unit):
+	 * the previous entry size was set when it was found
+	 */
+	if(n > 0 && frame->h264_nal[n - 1].offset >= size)
+		n--;
+	else if(n > 0)
+		frame->h264_nal[n - 1].size = size - frame->h264_nal[n - 1].offset;
+
+	int i = 0;
+	for(i = 0; i < n; ++i)
+		frame->h264_nal[i].type = frame->h264_frame[frame->h264_nal[i].offset] & 0x1F;
+
+	frame->h264_nal_count = n;
+}
+
+/*
+ * get the first NAL unit of type (type) from the frame index
+ * args:
+ *    frame - pointer to frame buffer
+ *    type - NALU type
+ *
+ * asserts:
+ *    frame is not null
+ *
+ * returns: pointer to NAL index entry or NULL if not found
+ */
+static h264_nal_t *get_NALU(v4l2_frame_buff_t *frame, uint8_t type)
+{
+	/*asserts*/
+	assert(frame != NULL);
+
+	int i = 0;
+	for(i = 0; i < frame->h264_nal_count; ++i)
+		if(frame->h264_nal[i].type == type && frame->h264_nal[i].size > 0)
+			return &frame->h264_nal[i];
+
+	return NULL;
+}
+
+/*
+ * copies the NALU of type (type) from the frame
  * args:
  *    type - NALU type
  *    NALU - pointer to pointer to NALU data
- *    buff - pointer to buffer containing h264 data muxed in MJPG container
- *    size - buff size
+ *    frame - pointer to frame buffer
  *
  * asserts:
- *    buff is not null
+ *    frame is not null
  *
  * returns: NALU size and sets pointer (NALU) to NALU data
  *          -1 if no NALU found
  */
-static int parse_NALU(uint8_t type, uint8_t **NALU, uint8_t *buff, int size)
+static int parse_NALU(uint8_t type, uint8_t **NALU, v4l2_frame_buff_t *frame)
 {
 	/*asserts*/
-	assert(buff != NULL);
+	assert(frame != NULL);
 
-	int nal_size = 0;
-	uint8_t *sp = NULL;
-
-	//search for NALU of type
-	uint8_t *nal = check_NALU(type, buff, size);
+	h264_nal_t *nal = get_NALU(frame, type);
 	if(nal == NULL)
 	{
 		fprintf(stderr, "V4L2_CORE: (uvc H264) could not find NALU of type %i in buffer\n", type);
 		return -1;
 	}
 
-	//search for end of NALU
-	for(sp = nal; sp < buff + size - 4; ++sp)
-	{
-		if(sp[0] == 0x00 &&
-		   sp[1] == 0x00 &&
-		   sp[2] == 0x00 &&
-		   sp[3] == 0x01)
-		{
-			nal_size = sp - nal;
-			break;
-		}
-	}
-
-	if(!nal_size)
-		nal_size = buff + size - nal;
-
-	*NALU = calloc(nal_size, sizeof(uint8_t));
+	*NALU = calloc(nal->size, sizeof(uint8_t));
 	if(*NALU == NULL)
 	{
 		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (parse_NALU): %s\n", strerror(errno));
 		exit(-1);
 	}
-	memcpy(*NALU, nal, nal_size);
-
-	//char test_filename2[20];
-	//snprintf(test_filename2, 20, "frame_nalu-%i.raw", type);
-	//SaveBuff (test_filename2, nal_size, *NALU);
+	memcpy(*NALU, frame->h264_frame + nal->offset, nal->size);
 
-	return nal_size;
+	return (int) nal->size;
 }
 
 /*
  * demux a H264 frame from a MJPG container
+ *  the APP4 segments are gathered in a single pass and
+ *  the NAL units are indexed as each segment is copied
+ *  (the muxers need the frame in a single buffer)
  * args:
- *    h264_data - pointer to h264 data
+ *    frame - pointer to frame buffer (h264_frame gets the h264 data)
  *    buff pointer to buffer with h264 muxed in MJPG container
  *    size - buff size
- *    h264_max_size - maximum size allowed by h264_data buffer
  *
  * asserts:
- *    h264_data is not null
+ *    frame is not null
  *    buff is not null
  *
  * returns: data size and copies NALU data to h264 buffer
  */
-static int demux_uvcH264(uint8_t *h264_data, uint8_t *buff, int size, int h264_max_size)
+static int demux_uvcH264(v4l2_frame_buff_t *frame, uint8_t *buff, int size)
 {
 	/*asserts*/
-	assert(h264_data != NULL);
+	assert(frame != NULL);
 	assert(buff != NULL);
-	
-	uint8_t *sp = NULL;
+
+	uint8_t *end = buff + size;
+	uint8_t *sp = buff;
 	uint8_t *spl= NULL;
-	uint8_t *epl= NULL;
 	uint8_t *header = NULL;
-	uint8_t *ph264 = h264_data;
-	
+	uint8_t *ph264 = frame->h264_frame;
+	uint8_t *h264_end = frame->h264_frame + frame->h264_frame_max_size;
+	size_t scanned = 0;
+
 	//search for first APP4 marker
-	for(sp = buff; sp < buff + size - 2; ++sp)
+	while(sp < end - 1)
 	{
-		if(sp[0] == 0xFF &&
-		   sp[1] == 0xE4)
+		sp = memchr(sp, 0xFF, (end - 1) - sp);
+		if(sp == NULL)
+			break;
+		if(sp[1] == 0xE4)
 		{
 			spl = sp + 2; //exclude APP4 marker
 			break;
 		}
+		sp++;
 	}
-	
+
+	if(spl == NULL || end - spl < 8)
+	{
+		fprintf(stderr, "V4L2_CORE: no APP4 marker found (demux_uvcH264)\n");
+		return 0;
+	}
+
 	/*(in big endian) 
 	 *includes payload size + header + 6 bytes(2 length + 4 payload size)
 	 */
-	uint16_t length = 0;
-	length  = (uint16_t) spl[0] << 8;
-	length |= (uint16_t) spl[1];
+	int length = 0;
+	length  = (int) spl[0] << 8;
+	length |= (int) spl[1];
 	
 	header = spl + 2;
 	/*in litle endian*/
-	uint16_t header_length = header[2];
+	int header_length = header[2];
 	header_length |= header[3] << 8;
 	
+	if(end - header < header_length + 4)
+	{
+		fprintf(stderr, "V4L2_CORE: APP4 header bigger than buffer (demux_uvcH264)\n");
+		return 0;
+	}
+
 	spl = header + header_length;
 	/*in litle endian*/
 	uint32_t payload_size = 0;
@@ -577,74 +1001,74 @@ static int demux_uvcH264(uint8_t *h264_data, uint8_t *buff, int size, int h264_m
 	payload_size |= ((uint32_t) spl[3]) << 24;
 	
 	spl += 4; /*start of payload*/
-	epl = spl + payload_size; /*end of payload*/
-	
-	if(epl > buff + size)
-	{
-		fprintf(stderr, "V4L2_CORE: payload size bigger than buffer, clipped to buffer size (demux_uvcH264)\n");
-		epl = buff + size;
-	}
-	
+
 	sp = spl;
-	
-	uint32_t max_seg_size = 64*1024;
-	
-	/*copy first segment*/
+
+	/*first segment*/
 	length -= header_length + 6;
-	
-	if(length <= max_seg_size)
-	{
-		/*copy the segment to h264 buffer*/
-		memcpy(ph264, sp, length);
-		ph264 += length;
-		sp += length;
-	}
-	
-	/*copy other segments*/
-	while( epl > sp)
+
+	/*payload size doesn't include the APP4 headers of the next segments*/
+	uint32_t remaining = payload_size;
+
+	for(;;)
 	{
-		if(sp[0] != 0xFF ||
-		   sp[1] != 0xE4)
-		{
-			fprintf(stderr, "V4L2_CORE: expected APP4 marker but none found (demux_uvcH264)\n");
-			return (ph264 - h264_data);	
-		}
-		else
+		/*a damaged payload size may not fit in an int*/
+		size_t seg_size = (length < 0 || (uint32_t) length > remaining) ?
+			remaining : (size_t) length;
+
+		if(seg_size > (size_t) (end - sp))
 		{
-			length  = (uint16_t) sp[2] << 8;
-			length |= (uint16_t) sp[3];
-			
-			length -= 2; /*remove the 2 bytes from length*/
+			fprintf(stderr, "V4L2_CORE: payload size bigger than buffer, clipped to buffer size (demux_uvcH264)\n");
+			seg_size = end - sp;
+			remaining = seg_size;
 		}
-		
-		sp += 4; /*APP4 marker + length*/
-	
-		if((length != max_seg_size) && (verbosity > 1))
+
+		if(seg_size > (size_t) (h264_end - ph264))
 		{
-			printf("V4L2_CORE: segment length is %i (demux_uvcH264)\n", length);
+			fprintf(stderr, "V4L2_CORE: (uvc H264) h264 data exceeds max of %i cliping (demux_uvcH264)\n",
+				(int) frame->h264_frame_max_size);
+			seg_size = h264_end - ph264;
+			remaining = seg_size;
 		}
-		
+
 		/*copy the segment to h264 buffer*/
-		memcpy(ph264, sp, length);
-		ph264 += length;
-		sp += length;
-		
-		if((epl-sp) > 0 && (epl-sp < 4))
+		memcpy(ph264, sp, seg_size);
+		ph264 += seg_size;
+		sp += seg_size;
+		remaining -= seg_size;
+
+		/*index the NAL units while the data is still hot*/
+		index_h264_nalus(frame, &scanned, ph264 - frame->h264_frame);
+
+		if(remaining == 0)
+			break;
+
+		if(end - sp < 4)
 		{
 			fprintf(stderr, "V4L2_CORE: payload ended unexpectedly (demux_uvcH264)\n");
-			return (ph264 - h264_data);
+			break;
 		}
+
+		if(sp[0] != 0xFF ||
+		   sp[1] != 0xE4)
+		{
+			fprintf(stderr, "V4L2_CORE: expected APP4 marker but none found (demux_uvcH264)\n");
+			break;
+		}
+
+		length  = (int) sp[2] << 8;
+		length |= (int) sp[3];
+		length -= 2; /*remove the 2 bytes from length*/
+
+		sp += 4; /*APP4 marker + length*/
+
+		if(verbosity > 2)
+			printf("V4L2_CORE: segment length is %i (demux_uvcH264)\n", length);
 	}
-	
-	if(epl-sp > 0)
-	{
-		fprintf(stderr, "V4L2_CORE: copy segment with %i bytes (demux_uvcH264)\n", (int) (epl-sp));
-		/*copy the remaining data*/
-		memcpy(ph264, sp, epl-sp);
-		ph264 += epl-sp;
-	}
-	
-	return (ph264 - h264_data); 
+
+	index_h264_done(frame, ph264 - frame->h264_frame);
+
+	return (ph264 - frame->h264_frame);
 }
 
 /*
@@ -665,9 +1089,7 @@ static int store_extra_data(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 
 	if(vd->h264_SPS == NULL)
 	{
-		vd->h264_SPS_size = parse_NALU( 7, &vd->h264_SPS,
-			frame->h264_frame,
-			(int) frame->h264_frame_size);
+		vd->h264_SPS_size = parse_NALU( 7, &vd->h264_SPS, frame);
 
 		if(vd->h264_SPS_size <= 0 || vd->h264_SPS == NULL)
 		{
@@ -681,9 +1103,7 @@ static int store_extra_data(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 
 	if(vd->h264_PPS == NULL)
 	{
-		vd->h264_PPS_size = parse_NALU( 8, &vd->h264_PPS,
-			frame->h264_frame,
-			(int) frame->h264_frame_size);
+		vd->h264_PPS_size = parse_NALU( 8, &vd->h264_PPS, frame);
 
 		if(vd->h264_PPS_size <= 0 || vd->h264_PPS == NULL)
 		{
@@ -713,10 +1133,18 @@ static int store_extra_data(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 static uint8_t is_h264_keyframe (v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 {
 	//check for a IDR frame type
-	if(check_NALU(5, frame->h264_frame, frame->h264_frame_size) != NULL)
+	if(get_NALU(frame, 5) != NULL)
 	{
-		memcpy(vd->h264_last_IDR, frame->h264_frame, frame->h264_frame_size);
-		vd->h264_last_IDR_size = frame->h264_frame_size;
+		/*a zero copy frame may be bigger than the IDR buffer*/
+		if(frame->h264_frame_size <= frame->h264_frame_max_size)
+		{
+			memcpy(vd->h264_last_IDR, frame->h264_frame, frame->h264_frame_size);
+			vd->h264_last_IDR_size = frame->h264_frame_size;
+		}
+		else
+			fprintf(stderr, "V4L2_CORE: (uvc H264) IDR frame too big (%i bytes) - not stored\n",
+				(int) frame->h264_frame_size);
+
 		if(verbosity > 1)
 			printf("V4L2_CORE: (uvc H264) IDR frame found in frame %" PRIu64 "\n",
 				vd->frame_index);
@@ -729,49 +1157,47 @@ static uint8_t is_h264_keyframe (v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 /*
  * demux h264 data from muxed frame
  * args:
- *    h264_data - pointer to demuxed h264 data
- *    buffer - pointer to muxed h264 data
- *    size - buffer size
- *    h264_max_size - maximum size allowed by h264_data buffer
+ *    vd - pointer to video device data
+ *    frame - pointer to frame buffer (raw_frame to h264_frame)
  *
  * asserts:
- *    h264_data is not null
- *    buffer is not null
+ *    vd is not null
+ *    frame is not null
  *
  * return: demuxed h264 frame data size
  */
-static int demux_h264(uint8_t* h264_data, uint8_t* buffer, int size, int h264_max_size)
+static int demux_h264(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 {
 	/*asserts*/
-	assert(h264_data != NULL);
-	assert(buffer != NULL);
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	frame->h264_nal_count = 0;
 
 	/*
 	 * if h264 is not supported return 0 (empty frame)
 	 */
-	if(h264_get_support() == H264_NONE)
+	if(h264_get_support(vd) == H264_NONE)
 		return 0;
 
 	/*
 	 * if it's a muxed stream we must demux it first
 	 */
-	if(h264_get_support() == H264_MUXED)
+	if(h264_get_support(vd) == H264_MUXED)
 	{
-		return demux_uvcH264(h264_data, buffer, size, h264_max_size);
+		return demux_uvcH264(frame, frame->raw_frame, (int) frame->raw_frame_size);
 	}
 
 	/*
-	 * (H264_FRAME) store the raw frame in h264 frame buffer
+	 * (H264_FRAME) zero copy: use the raw frame as h264 frame
+	 * (h264_frame is restored when the frame is released)
 	 */
-	if(size > h264_max_size)
-	{
-		fprintf(stderr, "V4L2_CORE: (uvc H264) h264 data exceeds max of %i cliping\n",
-			h264_max_size);
-		size = h264_max_size;
-	}
-	memcpy(h264_data, buffer, size);
-	return size;
+	size_t scanned = 0;
+	frame->h264_frame = frame->raw_frame;
+	index_h264_nalus(frame, &scanned, frame->raw_frame_size);
+	index_h264_done(frame, frame->raw_frame_size);
 
+	return (int) frame->raw_frame_size;
 }
 
 /*
@@ -779,13 +1205,15 @@ static int demux_h264(uint8_t* h264_data, uint8_t* buffer, int size, int h264_ma
  * args:
  *    vd - pointer to device data
  *    frame - pointer to frame buffer
+ *    jpeg_ctx - (m)jpeg decoder context to use (NULL - use the device context)
  *
  * asserts:
  *    vd is not null
  *
  * returns: error code ( 0 - E_OK)
 */
-int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame,
+	jpeg_decoder_context_t *jpeg_ctx)
 {
 	/*asserts*/
 	assert(vd != NULL);
@@ -807,6 +1235,10 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 
 	frame->isKeyframe = 0; /*reset*/
 
+	/*stage timestamps (decode_end_ts stays 0 if we bail out)*/
+	frame->decode_start_ts = ns_time_monotonic();
+	frame->decode_end_ts = 0;
+
 	/*
 	 * use the requested format since it may differ
 	 * from format.fmt.pix.pixelformat (muxed H264)
@@ -818,13 +1250,9 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 	{
 		case V4L2_PIX_FMT_H264:
 			/*
-			 * get the h264 frame in the tmp_buffer
+			 * get the h264 frame (and its NAL units index)
 			 */
-			frame->h264_frame_size = demux_h264(
-				frame->h264_frame,
-				frame->raw_frame,
-				frame->raw_frame_size,
-				frame->h264_frame_max_size);
+			frame->h264_frame_size = demux_h264(vd, frame);
 
 			/*
 			 * store SPS and PPS info (usually the first two NALU)
@@ -837,19 +1265,25 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 			 */
 			frame->isKeyframe = is_h264_keyframe(vd, frame);
 
-			//decode if we already have a IDR frame
-			if(vd->h264_last_IDR_size > 0)
+			/*
+			 * nothing uses the decoded frame (e.g. recording only)
+			 * leave yuv_frame untouched (decode_end_ts = 0)
+			 */
+			if(!vd->h264_decode)
 			{
-#ifdef USE_PLANAR_YUV
-				/*no need to convert output*/
-				h264_decode(frame->yuv_frame, frame->h264_frame, frame->h264_frame_size);
-#else
-				/* decode (h264) to frame->tmp_buffer (yuv420p)*/
-				h264_decode(frame->tmp_buffer, frame->h264_frame, frame->h264_frame_size);
-				/* convert to yuyv*/
-				yu12_to_yuyv (frame->yuv_frame, frame->tmp_buffer, width, height);
-#endif
+				h264_pause_decoder(vd);
+				return ret;
 			}
+
+			/*
+			 * decode if we already have a IDR frame
+			 * no picture (e.g. waiting for an IDR after a pause):
+			 * yuv_frame holds no valid pixels (decode_end_ts = 0)
+			 */
+			if(vd->h264_last_IDR_size <= 0 ||
+				h264_decode(vd, frame->yuv_frame, frame->h264_frame,
+					frame->h264_frame_size, frame->isKeyframe) <= 0)
+				return ret;
 			break;
 
 		case V4L2_PIX_FMT_JPEG:
@@ -863,7 +1297,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 			}
 			
 			
-			ret = jpeg_decode(frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);						
+			ret = jpeg_decode(jpeg_ctx ? jpeg_ctx : vd->jpeg_ctx,
+				frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);						
 			
 			//memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
 			//ret = jpeg_decode(&frame->yuv_frame, frame->tmp_buffer, width, height);
@@ -881,17 +1316,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			uyvy_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (uyvy decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			uyvy_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			uyvy_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -899,17 +1325,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			yvyu_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (yvyu decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			yvyu_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			yvyu_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -917,17 +1334,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			yyuv_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (yyuv decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			yyuv_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			yyuv_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -935,19 +1343,17 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			if(frame->raw_frame_size > (width * height * 3/2))
 				frame->raw_frame_size = width * height * 3/2;
-			memcpy(frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);
-#else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (yuv420 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
+			/*
+			 * zero copy: the raw frame is already in the internal format
+			 * (yuv_frame is restored when the frame is released)
+			 */
+			if(frame->raw_frame_size == (width * height * 3/2))
+				frame->yuv_frame = frame->raw_frame;
 			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			yu12_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+				memcpy(frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);
+#else
+			/*convert directly from the raw frame*/
+			yu12_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -955,17 +1361,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			yv12_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (yvu420 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			yvu420_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			yvu420_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -973,17 +1370,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			nv12_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (nv12 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			nv12_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			nv12_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -991,17 +1379,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			nv21_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (nv21 decoder) cliping unexpected large buffer (%i bytes).\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			nv21_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			nv21_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1009,17 +1388,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			nv16_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (nv16 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			nv16_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			nv16_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1027,17 +1397,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			nv61_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (nv61 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			nv61_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			nv61_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1045,17 +1406,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			y41p_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (y41p decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			y41p_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			y41p_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1063,17 +1415,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			grey_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (grey decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			grey_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			grey_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1081,17 +1424,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			y10b_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (y10b decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			y10b_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			y10b_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1099,17 +1433,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			y16_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (y16 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			y16_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			y16_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1117,17 +1442,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			s501_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (spca501 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			s501_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			s501_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1135,17 +1451,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			s505_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (spca505 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			s505_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			s505_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1153,17 +1460,8 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 #ifdef USE_PLANAR_YUV
 			s508_to_yu12(frame->yuv_frame, frame->raw_frame, width, height);
 #else
-			/*FIXME: do we need the tmp_buffer or can we just use the raw_frame?*/
-			if(frame->raw_frame_size > frame->tmp_buffer_max_size)
-			{
-				// Prevent crash on very large image
-				fprintf(stderr, "V4L2_CORE: (spca508 decoder) cliping unexpected large buffer (%i bytes)\n",
-					(int) frame->raw_frame_size);
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->tmp_buffer_max_size);
-			}
-			else
-				memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
-			s508_to_yuyv(frame->yuv_frame, frame->tmp_buffer, width, height);
+			/*convert directly from the raw frame*/
+			s508_to_yuyv(frame->yuv_frame, frame->raw_frame, width, height);
 #endif
 			break;
 
@@ -1208,9 +1506,12 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 			}
 			else
 			{
-				if (frame->raw_frame_size > framesizeIn)
-					memcpy(frame->yuv_frame, frame->raw_frame,
-						(size_t) framesizeIn);
+				/*
+				 * zero copy: the raw frame is already in the internal format
+				 * (yuv_frame is restored when the frame is released)
+				 */
+				if (frame->raw_frame_size >= framesizeIn)
+					frame->yuv_frame = frame->raw_frame;
 				else
 					memcpy(frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);
 			}
@@ -1273,5 +1574,7 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 			break;
 	}
 
+	frame->decode_end_ts = ns_time_monotonic();
+
 	return ret;
 }
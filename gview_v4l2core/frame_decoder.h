@@ -43,13 +43,84 @@ int alloc_v4l2_frames(v4l2_dev_t *vd);
  * decode video stream ( from raw_frame to frame buffer (yuyv format))
  * args:
  *    vd - pointer to device data
+ *    frame - pointer to frame buffer
+ *    jpeg_ctx - (m)jpeg decoder context to use (NULL - use the device context)
  *
  * asserts:
  *    vd is not null
  *
  * returns: error code (E_OK)
  */
-int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame,
+	struct _jpeg_decoder_context_t *jpeg_ctx);
+
+/*frames still held after this are detached from the buffers being freed*/
+#define FRAME_RELEASE_TIMEOUT_MS (2000)
+
+/*release_v4l2_frame_orphan return values*/
+#define FRAME_ORPHAN_NONE   (0)
+#define FRAME_ORPHAN_BUFFER (1)
+#define FRAME_ORPHAN_QUEUE  (2)
+
+/*
+ * wait for the frames handed out to be released (refcount 0)
+ *  e.g. frames referenced by the encoder ring buffer: their data
+ *  (raw driver buffer or yuv buffer) must not be freed before that
+ * args:
+ *   vd - pointer to video device data
+ *   timeout_ms - maximum wait time in ms
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of frames still held
+ */
+int wait_v4l2_frames_released(v4l2_dev_t *vd, int timeout_ms);
+
+/*
+ * detaches the driver buffers of the frames still held, so that
+ *  the buffers can be unmapped and requeued (e.g. on a fps change)
+ *  the detached buffers are freed when the frames are released
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of detached buffers
+ */
+int detach_v4l2_buffers(v4l2_dev_t *vd);
+
+/*
+ * releases the buffers detached from a frame (last reference)
+ *  must be called with vd->release_mutex locked
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: FRAME_ORPHAN_NONE - nothing detached,
+ *   FRAME_ORPHAN_BUFFER - the driver buffer was detached (don't requeue it)
+ *   FRAME_ORPHAN_QUEUE - the frame was detached from the frame queue (nothing else to release)
+ */
+int release_v4l2_frame_orphan(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+/*
+ * frees the detached buffers and frame queues left at close
+ *  (frames still held at this point are leaked: their holder
+ *   must not release them after the device is closed)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void free_v4l2_frame_orphans(v4l2_dev_t *vd);
 
 /*
  * free image buffers for decoding video stream
@@ -0,0 +1,667 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/eventfd.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "frame_pipeline.h"
+#include "frame_decoder.h"
+#include "jpeg_decoder.h"
+#include "v4l2_events.h"
+#include "../config.h"
+
+/*pipeline slot state (one per frame queue entry)*/
+#define SLOT_FREE     (0) /*available for capture*/
+#define SLOT_QUEUED   (1) /*captured, waiting for a decoder*/
+#define SLOT_DECODING (2) /*being decoded by a worker*/
+#define SLOT_DECODED  (3) /*decoded, waiting for delivery*/
+#define SLOT_OUT      (4) /*delivered to the client*/
+
+extern int verbosity;
+
+struct _frame_pipeline_t;
+
+typedef struct _pipeline_worker_t
+{
+	__THREAD_TYPE thread;
+	struct _frame_pipeline_t *pipeline;
+	jpeg_decoder_context_t *jpeg_ctx; //private (m)jpeg decoder context
+} pipeline_worker_t;
+
+typedef struct _frame_pipeline_t
+{
+	v4l2_dev_t *vd;
+
+	int nworkers;
+	pipeline_worker_t *workers;
+
+	__MUTEX_TYPE mutex;
+	__COND_TYPE cond_job;   //signaled when a frame is queued (or on quit)
+	__COND_TYPE cond_done;  //signaled when a frame is decoded
+
+	int quit;
+
+	uint64_t next_in;       //sequence number for the next captured frame
+	uint64_t next_out;      //sequence number of the next frame to deliver
+
+	int *state;             //slot state (per frame queue entry)
+	uint64_t *seq;          //slot sequence number
+	int *holds_buffer;      //slot still holds its driver buffer (zero copy, requeued on release)
+	uint8_t **raw_copy;     //raw frame copy (only if the driver buffer must be requeued after decoding)
+	size_t *raw_copy_size;  //raw frame copy buffer size
+
+	int in_flight;          //frames holding a driver buffer (queued or decoding)
+	int held;               //decoded frames still holding a driver buffer
+	int max_in_flight;      //max driver buffers held by the pipeline (in flight + held)
+
+	int done_fd;            //eventfd: wakes the capture thread on decoded frames
+} frame_pipeline_t;
+
+#define __PPMUTEX &(pipeline->mutex)
+
+/*
+ * decoder worker thread
+ * args:
+ *   data - pointer to worker data
+ *
+ * asserts:
+ *   data is not null
+ *
+ * returns: NULL
+ */
+static void *decoder_worker(void *data)
+{
+	pipeline_worker_t *worker = (pipeline_worker_t *) data;
+	assert(worker != NULL);
+
+	frame_pipeline_t *pipeline = worker->pipeline;
+	v4l2_dev_t *vd = pipeline->vd;
+
+	__LOCK_MUTEX(__PPMUTEX);
+	while(!pipeline->quit)
+	{
+		/*get the oldest queued frame*/
+		int qind = -1;
+		int i = 0;
+		for(i = 0; i < vd->frame_queue_size; ++i)
+		{
+			if(pipeline->state[i] == SLOT_QUEUED &&
+			   (qind < 0 || pipeline->seq[i] < pipeline->seq[qind]))
+				qind = i;
+		}
+
+		if(qind < 0)
+		{
+			__COND_WAIT(&pipeline->cond_job, __PPMUTEX);
+			continue;
+		}
+
+		pipeline->state[qind] = SLOT_DECODING;
+		__UNLOCK_MUTEX(__PPMUTEX);
+
+		v4l2_frame_buff_t *frame = &vd->frame_queue[qind];
+
+		if(decode_v4l2_frame(vd, frame, worker->jpeg_ctx) != E_OK)
+			fprintf(stderr, "V4L2_CORE: Error - Couldn't decode frame\n");
+
+		/*
+		 * hold on to the driver buffer until the frame is released
+		 * as long as that leaves room for capturing the next frame
+		 */
+		__LOCK_MUTEX(__PPMUTEX);
+		int keep = (pipeline->in_flight + pipeline->held < pipeline->max_in_flight);
+		if(keep)
+		{
+			pipeline->holds_buffer[qind] = 1;
+			pipeline->held++;
+		}
+		__UNLOCK_MUTEX(__PPMUTEX);
+
+		/*
+		 * otherwise keep a private copy of the raw data
+		 * so that the driver buffer can be requeued right away
+		 */
+		if(!keep && pipeline->raw_copy_size[qind] < frame->raw_frame_size)
+		{
+			pipeline->raw_copy[qind] = realloc(pipeline->raw_copy[qind], frame->raw_frame_size);
+			if(pipeline->raw_copy[qind] == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (decoder_worker): %s\n", strerror(errno));
+				exit(-1);
+			}
+			pipeline->raw_copy_size[qind] = frame->raw_frame_size;
+		}
+		if(!keep)
+		{
+			if(frame->raw_frame_size > 0)
+				memcpy(pipeline->raw_copy[qind], frame->raw_frame, frame->raw_frame_size);
+			/*a zero copy frame must follow the raw data*/
+			if(frame->yuv_frame == frame->raw_frame)
+				frame->yuv_frame = pipeline->raw_copy[qind];
+			frame->raw_frame = pipeline->raw_copy[qind];
+
+			/*requeue the driver buffer (doesn't use the shared vd->buf)*/
+			requeue_v4l2_buffer(vd, frame->index);
+		}
+
+		__LOCK_MUTEX(__PPMUTEX);
+		pipeline->state[qind] = SLOT_DECODED;
+		frame->status = FRAME_DONE;
+		pipeline->in_flight--;
+		__COND_BCAST(&pipeline->cond_done);
+		__UNLOCK_MUTEX(__PPMUTEX);
+
+		/*wake the capture thread*/
+		uint64_t one = 1;
+		if(write(pipeline->done_fd, &one, sizeof(uint64_t)) < 0 && verbosity > 2)
+			fprintf(stderr, "V4L2_CORE: (decoder_worker) eventfd write failed: %s\n", strerror(errno));
+
+		__LOCK_MUTEX(__PPMUTEX);
+	}
+	__UNLOCK_MUTEX(__PPMUTEX);
+
+	return NULL;
+}
+
+/*
+ * create the frame decoding pipeline (decoder worker pool)
+ *  the pipeline is only used for mmap capture of stateless formats
+ *  with a frame queue of more than one frame and decoder_threads > 0
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK - pipeline created or not needed)
+ */
+int frame_pipeline_create(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	frame_pipeline_destroy(vd);
+
+	/*
+	 * h264 decoding depends on the previous frames
+	 * and read io reuses a single buffer, so keep these sequential
+	 * (dma-buf consumers need the driver buffer held until release)
+	 */
+	if(vd->decoder_threads <= 0 ||
+	   vd->frame_queue_size < 2 ||
+	   (vd->cap_meth != IO_MMAP && vd->cap_meth != IO_USERPTR) ||
+	   vd->requested_fmt == V4L2_PIX_FMT_H264)
+		return E_OK;
+
+	frame_pipeline_t *pipeline = calloc(1, sizeof(frame_pipeline_t));
+	if(pipeline == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (frame_pipeline_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	pipeline->vd = vd;
+
+	pipeline->done_fd = eventfd(0, EFD_NONBLOCK);
+	if(pipeline->done_fd < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame pipeline) couldn't create eventfd: %s\n", strerror(errno));
+		free(pipeline);
+		return E_ALLOC_ERR;
+	}
+
+	pipeline->state = calloc(vd->frame_queue_size, sizeof(int));
+	pipeline->seq = calloc(vd->frame_queue_size, sizeof(uint64_t));
+	pipeline->holds_buffer = calloc(vd->frame_queue_size, sizeof(int));
+	pipeline->raw_copy = calloc(vd->frame_queue_size, sizeof(uint8_t *));
+	pipeline->raw_copy_size = calloc(vd->frame_queue_size, sizeof(size_t));
+	pipeline->workers = calloc(vd->decoder_threads, sizeof(pipeline_worker_t));
+	if(pipeline->state == NULL ||
+	   pipeline->seq == NULL ||
+	   pipeline->holds_buffer == NULL ||
+	   pipeline->raw_copy == NULL ||
+	   pipeline->raw_copy_size == NULL ||
+	   pipeline->workers == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (frame_pipeline_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	/*leave at least two buffers with the driver*/
+	int nbuffers = vd->rb.count > 0 ? (int) vd->rb.count : NB_BUFFER;
+	pipeline->max_in_flight = nbuffers - 2;
+	if(pipeline->max_in_flight > vd->frame_queue_size)
+		pipeline->max_in_flight = vd->frame_queue_size;
+	if(pipeline->max_in_flight < 1)
+		pipeline->max_in_flight = 1;
+
+	__INIT_MUTEX(__PPMUTEX);
+	__INIT_COND(&pipeline->cond_job);
+	__INIT_COND(&pipeline->cond_done);
+
+	int i = 0;
+	for(i = 0; i < vd->frame_queue_size; ++i)
+		vd->frame_queue[i].status = FRAME_READY;
+
+	vd->pipeline = pipeline;
+
+	for(i = 0; i < vd->decoder_threads; ++i)
+	{
+		pipeline_worker_t *worker = &pipeline->workers[i];
+		worker->pipeline = pipeline;
+
+		if(vd->requested_fmt == V4L2_PIX_FMT_JPEG ||
+		   vd->requested_fmt == V4L2_PIX_FMT_MJPEG)
+		{
+			worker->jpeg_ctx = jpeg_create_decoder(
+				vd->format.fmt.pix.width,
+				vd->format.fmt.pix.height);
+
+			if(worker->jpeg_ctx == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: (frame pipeline) couldn't create jpeg decoder for worker %i\n", i);
+				break;
+			}
+
+			/*share the cores with the other workers (restart interval decoding)*/
+			jpeg_set_decoder_threads(worker->jpeg_ctx,
+				worker->jpeg_ctx->threads / vd->decoder_threads);
+		}
+
+		if(__THREAD_CREATE(&worker->thread, decoder_worker, (void *) worker))
+		{
+			fprintf(stderr, "V4L2_CORE: (frame pipeline) couldn't create decoder worker %i\n", i);
+			jpeg_destroy_decoder(worker->jpeg_ctx);
+			worker->jpeg_ctx = NULL;
+			break;
+		}
+
+		pipeline->nworkers++;
+	}
+
+	if(pipeline->nworkers == 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame pipeline) no decoder workers - decoding in the capture thread\n");
+		frame_pipeline_destroy(vd);
+		return E_OK;
+	}
+
+	/*decoded frames wake up the device event loop*/
+	v4l2_events_set_user_fd(vd, pipeline->done_fd);
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: (frame pipeline) %i decoder workers, %i frames in flight (queue size %i)\n",
+			pipeline->nworkers, pipeline->max_in_flight, vd->frame_queue_size);
+
+	return E_OK;
+}
+
+/*
+ * gets the next decoded frame from the pipeline (in capture order)
+ *  the frame must be released with frame_pipeline_release_frame
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->pipeline is not null
+ *
+ * returns: pointer to decoded frame buffer (NULL on error)
+ */
+v4l2_frame_buff_t *frame_pipeline_get_frame(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->pipeline != NULL);
+
+	frame_pipeline_t *pipeline = vd->pipeline;
+
+	while(1)
+	{
+		int i = 0;
+		int can_submit = 0;
+
+		__LOCK_MUTEX(__PPMUTEX);
+		/*deliver the next frame in capture order, if already decoded*/
+		for(i = 0; i < vd->frame_queue_size; ++i)
+		{
+			if(pipeline->state[i] == SLOT_DECODED &&
+			   pipeline->seq[i] == pipeline->next_out)
+			{
+				pipeline->state[i] = SLOT_OUT;
+				pipeline->next_out++;
+				__atomic_store_n(&vd->frame_queue[i].refcount, 1, __ATOMIC_RELEASE);
+				__UNLOCK_MUTEX(__PPMUTEX);
+				return &vd->frame_queue[i];
+			}
+		}
+
+		if(pipeline->in_flight + pipeline->held < pipeline->max_in_flight)
+		{
+			for(i = 0; i < vd->frame_queue_size; ++i)
+			{
+				if(pipeline->state[i] == SLOT_FREE)
+				{
+					can_submit = 1;
+					break;
+				}
+			}
+		}
+		int in_flight = pipeline->in_flight;
+		__UNLOCK_MUTEX(__PPMUTEX);
+
+		/*lock the mutex*/
+		__LOCK_MUTEX( &(vd->mutex) );
+		int stream_state = vd->streaming;
+		/*unlock the mutex*/
+		__UNLOCK_MUTEX( &(vd->mutex) );
+
+		v4l2_frame_buff_t *frame = NULL;
+
+		/*
+		 * let v4l2core_get_frame handle stop requests and fps changes
+		 * (frame sources have no fd to wait on: they pace themselves)
+		 */
+		if(stream_state != STRM_OK ||
+		   (can_submit && (vd->flag_fps_change > 0 || vd->source != NULL)))
+		{
+			frame = v4l2core_get_frame(vd);
+			if(frame == NULL)
+				return NULL;
+		}
+		else
+		{
+			if(!can_submit && in_flight == 0)
+			{
+				if(verbosity > 2)
+					fprintf(stderr, "V4L2_CORE: (frame pipeline) no free frames in queue\n");
+				return NULL;
+			}
+
+			/*only wake up on new frames if we can take them*/
+			v4l2_events_watch_frames(vd, can_submit);
+
+			int ret = v4l2_events_wait(vd, vd->frame_timeout);
+			if(ret < 0)
+			{
+				fprintf(stderr, "V4L2_CORE: Could not grab image (%s)\n",
+					ret == E_DEVICE_ERR ? "device disconnected" : "wait error");
+				return NULL;
+			}
+
+			if(ret == 0)
+			{
+				fprintf(stderr, "V4L2_CORE: Could not grab image (timeout)\n");
+				return NULL;
+			}
+
+			if(ret & EV_WAIT_USER)
+			{
+				uint64_t count = 0;
+				if(read(pipeline->done_fd, &count, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+					fprintf(stderr, "V4L2_CORE: (frame pipeline) eventfd read failed: %s\n", strerror(errno));
+			}
+
+			/*decoded frames or a wake up (stop and fps change requests)*/
+			if(!(ret & EV_WAIT_FRAME))
+				continue;
+
+			/*a frame is ready in the driver (get_frame reports any error)*/
+			frame = v4l2core_get_frame(vd);
+			if(frame == NULL)
+				return NULL;
+		}
+
+		/*submit the frame to the decoder workers*/
+		i = frame - vd->frame_queue;
+
+		__LOCK_MUTEX(__PPMUTEX);
+		pipeline->seq[i] = pipeline->next_in++;
+		pipeline->state[i] = SLOT_QUEUED;
+		pipeline->in_flight++;
+		__COND_SIGNAL(&pipeline->cond_job);
+		__UNLOCK_MUTEX(__PPMUTEX);
+	}
+
+	return NULL;
+}
+
+/*
+ * releases a frame obtained from the pipeline
+ *  (requeues the driver buffer if the frame still holds it,
+ *   otherwise the decoder worker already requeued it)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->pipeline is not null
+ *   frame is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_pipeline_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->pipeline != NULL);
+	assert(frame != NULL);
+
+	frame_pipeline_t *pipeline = vd->pipeline;
+
+	int i = frame - vd->frame_queue;
+	if(i < 0 || i >= vd->frame_queue_size)
+		return E_UNKNOWN_ERR;
+
+	int ret = E_OK;
+
+	__LOCK_MUTEX(__PPMUTEX);
+	if(pipeline->holds_buffer[i])
+	{
+		ret = requeue_v4l2_buffer(vd, frame->index);
+		pipeline->holds_buffer[i] = 0;
+		pipeline->held--;
+	}
+	pipeline->state[i] = SLOT_FREE;
+	frame->raw_frame = NULL;
+	frame->raw_frame_size = 0;
+	frame->yuv_frame = frame->yuv_frame_buffer; /*in case of zero copy*/
+	frame->status = FRAME_READY;
+	__UNLOCK_MUTEX(__PPMUTEX);
+
+	return ret;
+}
+
+/*
+ * detaches a frame still held by its consumer from the pipeline
+ *  buffers (see detach_v4l2_buffers): its driver buffer is no
+ *  longer requeued on release
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer
+ *   raw_copy - pointer to store the raw frame copy (ownership moves
+ *     to the caller) or NULL to leave it with the pipeline
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->pipeline is not null
+ *   frame is not null
+ *
+ * returns: 1 if the frame was still holding its driver buffer, 0 otherwise
+ */
+int frame_pipeline_detach_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, uint8_t **raw_copy)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->pipeline != NULL);
+	assert(frame != NULL);
+
+	frame_pipeline_t *pipeline = vd->pipeline;
+
+	int i = frame - vd->frame_queue;
+	if(i < 0 || i >= vd->frame_queue_size)
+		return 0;
+
+	int holds_buffer = 0;
+
+	__LOCK_MUTEX(__PPMUTEX);
+	if(pipeline->holds_buffer[i])
+	{
+		holds_buffer = 1;
+		pipeline->holds_buffer[i] = 0;
+		pipeline->held--;
+	}
+	if(raw_copy != NULL)
+	{
+		*raw_copy = pipeline->raw_copy[i];
+		pipeline->raw_copy[i] = NULL;
+		pipeline->raw_copy_size[i] = 0;
+	}
+	__UNLOCK_MUTEX(__PPMUTEX);
+
+	return holds_buffer;
+}
+
+/*
+ * waits for all frames in the pipeline to be decoded and discards
+ *  the ones not yet delivered (must be called before stream off)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_pipeline_drain(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	frame_pipeline_t *pipeline = vd->pipeline;
+
+	if(pipeline == NULL)
+		return;
+
+	/*
+	 * don't lock vd->mutex here:
+	 * this may be called with it held (stream format change)
+	 */
+	__LOCK_MUTEX(__PPMUTEX);
+	while(pipeline->in_flight > 0)
+		__COND_WAIT(&pipeline->cond_done, __PPMUTEX);
+
+	int i = 0;
+	for(i = 0; i < vd->frame_queue_size; ++i)
+	{
+		if(pipeline->state[i] == SLOT_DECODED)
+		{
+			if(pipeline->holds_buffer[i])
+			{
+				requeue_v4l2_buffer(vd, vd->frame_queue[i].index);
+				pipeline->holds_buffer[i] = 0;
+				pipeline->held--;
+			}
+			pipeline->state[i] = SLOT_FREE;
+			vd->frame_queue[i].raw_frame = NULL;
+			vd->frame_queue[i].raw_frame_size = 0;
+			vd->frame_queue[i].yuv_frame = vd->frame_queue[i].yuv_frame_buffer;
+			vd->frame_queue[i].status = FRAME_READY;
+			/*never handed out*/
+			__atomic_store_n(&vd->frame_queue[i].refcount, 0, __ATOMIC_RELEASE);
+		}
+	}
+	pipeline->next_out = pipeline->next_in;
+	__UNLOCK_MUTEX(__PPMUTEX);
+}
+
+/*
+ * stops the decoder workers and frees the pipeline
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_pipeline_destroy(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	frame_pipeline_t *pipeline = vd->pipeline;
+
+	if(pipeline == NULL)
+		return;
+
+	__LOCK_MUTEX(__PPMUTEX);
+	pipeline->quit = 1;
+	__COND_BCAST(&pipeline->cond_job);
+	__UNLOCK_MUTEX(__PPMUTEX);
+
+	int i = 0;
+	for(i = 0; i < pipeline->nworkers; ++i)
+	{
+		__THREAD_JOIN(pipeline->workers[i].thread);
+		jpeg_destroy_decoder(pipeline->workers[i].jpeg_ctx);
+	}
+
+	for(i = 0; i < vd->frame_queue_size; ++i)
+	{
+		/*don't leave dangling pointers to the raw frame copies*/
+		if(vd->frame_queue[i].raw_frame == pipeline->raw_copy[i])
+			vd->frame_queue[i].raw_frame = NULL;
+		if(vd->frame_queue[i].yuv_frame == pipeline->raw_copy[i])
+			vd->frame_queue[i].yuv_frame = vd->frame_queue[i].yuv_frame_buffer;
+		free(pipeline->raw_copy[i]);
+	}
+
+	__CLOSE_COND(&pipeline->cond_done);
+	__CLOSE_COND(&pipeline->cond_job);
+	__CLOSE_MUTEX(__PPMUTEX);
+
+	/*back to plain frame waits*/
+	v4l2_events_set_user_fd(vd, -1);
+	v4l2_events_watch_frames(vd, 1);
+
+	close(pipeline->done_fd);
+
+	free(pipeline->raw_copy_size);
+	free(pipeline->raw_copy);
+	free(pipeline->holds_buffer);
+	free(pipeline->seq);
+	free(pipeline->state);
+	free(pipeline->workers);
+	free(pipeline);
+
+	vd->pipeline = NULL;
+}
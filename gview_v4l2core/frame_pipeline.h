@@ -0,0 +1,116 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+
+/*
+ * create the frame decoding pipeline (decoder worker pool)
+ *  the pipeline is only used for mmap capture of stateless formats
+ *  with a frame queue of more than one frame and decoder_threads > 0
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK - pipeline created or not needed)
+ */
+int frame_pipeline_create(v4l2_dev_t *vd);
+
+/*
+ * gets the next decoded frame from the pipeline (in capture order)
+ *  the frame must be released with frame_pipeline_release_frame
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->pipeline is not null
+ *
+ * returns: pointer to decoded frame buffer (NULL on error)
+ */
+v4l2_frame_buff_t *frame_pipeline_get_frame(v4l2_dev_t *vd);
+
+/*
+ * releases a frame obtained from the pipeline
+ *  (the driver buffer was already requeued by the decoder worker)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->pipeline is not null
+ *   frame is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_pipeline_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+/*
+ * detaches a frame still held by its consumer from the pipeline
+ *  buffers (see detach_v4l2_buffers): its driver buffer is no
+ *  longer requeued on release
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer
+ *   raw_copy - pointer to store the raw frame copy (ownership moves
+ *     to the caller) or NULL to leave it with the pipeline
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->pipeline is not null
+ *   frame is not null
+ *
+ * returns: 1 if the frame was still holding its driver buffer, 0 otherwise
+ */
+int frame_pipeline_detach_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, uint8_t **raw_copy);
+
+/*
+ * waits for all frames in the pipeline to be decoded and discards
+ *  the ones not yet delivered (must be called before stream off)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_pipeline_drain(v4l2_dev_t *vd);
+
+/*
+ * stops the decoder workers and frees the pipeline
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_pipeline_destroy(v4l2_dev_t *vd);
+
+#endif
@@ -0,0 +1,1401 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "v4l2_formats.h"
+#include "frame_source.h"
+#include "uvc_h264.h"
+#include "core_time.h"
+#include "../config.h"
+
+#define SOURCE_REPLAY  (0)
+#define SOURCE_PATTERN (1)
+
+/*longest interval between two frames (same as the select timeout)*/
+#define SOURCE_MAX_INTERVAL (NSEC_PER_SEC)
+
+extern int verbosity;
+
+typedef struct _frame_source_t
+{
+	int type;                //SOURCE_REPLAY or SOURCE_PATTERN
+	int fixed_fps;           //fixed frame rate (-1 - none; 0 - as fast as possible)
+
+	uint32_t pixelformat;    //delivered pixel format
+	int width;               //delivered width
+	int height;              //delivered height
+	int fps_num;             //recorded frame rate numerator (dumps)
+	int fps_denom;           //recorded frame rate denominator (dumps)
+
+	/*replay*/
+	uint8_t *data;           //frame data (mapped dump file or loaded jpeg files)
+	size_t data_size;        //data size (bytes)
+	int mapped;              //data is a mapped dump file
+	int nframes;             //number of frames
+	int max_frames;          //allocated size of the frame index
+	size_t *offset;          //frame offsets in data
+	uint32_t *size;          //frame sizes
+	uint64_t *ts;            //recorded timestamps (NULL - not recorded)
+	uint32_t max_frame_size; //largest frame (bytes)
+	int next_frame;          //next frame to deliver
+
+	/*pattern*/
+	int pattern_width;       //requested in the device name (0 - none)
+	int pattern_height;
+	uint8_t *pattern;        //color bars for the current format
+
+	/*buffers*/
+	int nbuffers;            //allocated buffers
+	int queued[NB_BUFFER];   //1 - buffer is queued (owned by the source)
+	int next_buffer;         //next buffer to fill
+
+	/*pacing*/
+	uint64_t next_ts;        //due time of the next frame (0 - first frame)
+	uint64_t frame_count;    //frames delivered
+} frame_source_t;
+
+/*
+ * raw dump writer
+ */
+typedef struct _frame_dump_t
+{
+	FILE *fp;
+	int header_written;
+	frame_dump_header_t header;
+	uint64_t frames;
+} frame_dump_t;
+
+/*
+ * check if device is a frame source name
+ * args:
+ *   device - device name
+ *
+ * asserts:
+ *   device is not null
+ *
+ * returns: 1 if device names a frame source, 0 otherwise
+ */
+int frame_source_is_source(const char *device)
+{
+	/*asserts*/
+	assert(device != NULL);
+
+	if(strncmp(device, FRAME_SOURCE_REPLAY_PREFIX, strlen(FRAME_SOURCE_REPLAY_PREFIX)) == 0)
+		return 1;
+
+	size_t len = strlen(FRAME_SOURCE_PATTERN_PREFIX);
+	if(strncmp(device, FRAME_SOURCE_PATTERN_PREFIX, len) == 0 &&
+	   (device[len] == '\0' || device[len] == ':' || device[len] == '@'))
+		return 1;
+
+	return 0;
+}
+
+/*
+ * strip a trailing @FPS from the source spec
+ * args:
+ *   spec - source spec (modified)
+ *
+ * asserts:
+ *   spec is not null
+ *
+ * returns: fixed frame rate or -1 if none
+ */
+static int parse_fixed_fps(char *spec)
+{
+	/*asserts*/
+	assert(spec != NULL);
+
+	char *at = strrchr(spec, '@');
+	if(at == NULL || at[1] == '\0')
+		return -1;
+
+	char *p = at + 1;
+	while(*p >= '0' && *p <= '9')
+		p++;
+	if(*p != '\0')
+		return -1; /*part of the file name*/
+
+	*at = '\0';
+	return atoi(at + 1);
+}
+
+/*
+ * add a frame to the replay index
+ * args:
+ *   source - pointer to frame source
+ *   offset - frame offset in source data
+ *   size - frame size
+ *   ts - recorded timestamp
+ *
+ * asserts:
+ *   source is not null
+ *
+ * returns: none
+ */
+static void replay_add_frame(frame_source_t *source, size_t offset, uint32_t size, uint64_t ts)
+{
+	/*asserts*/
+	assert(source != NULL);
+
+	if(source->nframes >= source->max_frames)
+	{
+		source->max_frames = source->max_frames > 0 ? source->max_frames * 2 : 256;
+		source->offset = realloc(source->offset, source->max_frames * sizeof(size_t));
+		source->size = realloc(source->size, source->max_frames * sizeof(uint32_t));
+		source->ts = realloc(source->ts, source->max_frames * sizeof(uint64_t));
+		if(source->offset == NULL || source->size == NULL || source->ts == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (replay_add_frame): %s\n", strerror(errno));
+			exit(-1);
+		}
+	}
+
+	source->offset[source->nframes] = offset;
+	source->size[source->nframes] = size;
+	source->ts[source->nframes] = ts;
+	source->nframes++;
+
+	if(size > source->max_frame_size)
+		source->max_frame_size = size;
+}
+
+/*
+ * map and index a raw dump file
+ * args:
+ *   source - pointer to frame source
+ *   filename - dump file name
+ *
+ * asserts:
+ *   source is not null
+ *   filename is not null
+ *
+ * returns: error code (E_OK)
+ */
+static int replay_open_dump(frame_source_t *source, const char *filename)
+{
+	/*asserts*/
+	assert(source != NULL);
+	assert(filename != NULL);
+
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) couldn't open %s: %s\n", filename, strerror(errno));
+		return E_FILE_IO_ERR;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(frame_dump_header_t))
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) %s is not a raw dump file\n", filename);
+		close(fd);
+		return E_FILE_IO_ERR;
+	}
+
+	source->data_size = st.st_size;
+	source->data = mmap(NULL, source->data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(source->data == MAP_FAILED)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) couldn't map %s: %s\n", filename, strerror(errno));
+		source->data = NULL;
+		return E_FILE_IO_ERR;
+	}
+	source->mapped = 1;
+
+	frame_dump_header_t header;
+	memcpy(&header, source->data, sizeof(frame_dump_header_t));
+	if(memcmp(header.magic, FRAME_DUMP_MAGIC, sizeof(header.magic)) != 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) %s is not a raw dump file\n", filename);
+		return E_FILE_IO_ERR;
+	}
+
+	source->pixelformat = header.pixelformat;
+	source->width = header.width;
+	source->height = header.height;
+	source->fps_num = header.fps_num;
+	source->fps_denom = header.fps_denom;
+
+	size_t pos = sizeof(frame_dump_header_t);
+	while(pos + sizeof(frame_dump_record_t) <= source->data_size)
+	{
+		frame_dump_record_t record;
+		memcpy(&record, source->data + pos, sizeof(frame_dump_record_t));
+		pos += sizeof(frame_dump_record_t);
+
+		if(record.size > source->data_size - pos)
+		{
+			fprintf(stderr, "V4L2_CORE: (frame source) dropping truncated frame %i\n", source->nframes);
+			break;
+		}
+
+		if(record.size > 0)
+			replay_add_frame(source, pos, record.size, record.timestamp);
+
+		pos += record.size;
+	}
+
+	return E_OK;
+}
+
+/*
+ * get the frame size from a jpeg frame header
+ * args:
+ *   jpg - pointer to jpeg data
+ *   size - jpeg data size
+ *   width - pointer to frame width (set on success)
+ *   height - pointer to frame height (set on success)
+ *
+ * asserts:
+ *   jpg is not null
+ *
+ * returns: error code (E_OK)
+ */
+static int jpeg_frame_size(const uint8_t *jpg, size_t size, int *width, int *height)
+{
+	/*asserts*/
+	assert(jpg != NULL);
+
+	if(size < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8)
+		return E_NO_SOI_ERR;
+
+	size_t pos = 2;
+	while(pos + 4 <= size)
+	{
+		if(jpg[pos] != 0xFF)
+			return E_WRONG_MARKER_ERR;
+
+		uint8_t marker = jpg[pos + 1];
+		if(marker == 0xFF) /*fill byte*/
+		{
+			pos++;
+			continue;
+		}
+
+		/*SOF0, SOF1 or SOF2*/
+		if(marker >= 0xC0 && marker <= 0xC2)
+		{
+			if(pos + 9 > size)
+				break;
+			*height = (jpg[pos + 5] << 8) | jpg[pos + 6];
+			*width = (jpg[pos + 7] << 8) | jpg[pos + 8];
+			return E_OK;
+		}
+
+		/*start of scan with no frame header*/
+		if(marker == 0xDA)
+			break;
+
+		pos += 2 + ((jpg[pos + 2] << 8) | jpg[pos + 3]);
+	}
+
+	return E_BAD_WIDTH_OR_HEIGHT_ERR;
+}
+
+/*
+ * load a directory of jpeg files (one frame per file, name order)
+ * args:
+ *   source - pointer to frame source
+ *   dirname - directory name
+ *
+ * asserts:
+ *   source is not null
+ *   dirname is not null
+ *
+ * returns: error code (E_OK)
+ */
+static int replay_open_dir(frame_source_t *source, const char *dirname)
+{
+	/*asserts*/
+	assert(source != NULL);
+	assert(dirname != NULL);
+
+	struct dirent **namelist = NULL;
+	int n = scandir(dirname, &namelist, NULL, alphasort);
+	if(n < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) couldn't read directory %s: %s\n", dirname, strerror(errno));
+		return E_FILE_IO_ERR;
+	}
+
+	size_t max_data_size = 0;
+	int i = 0;
+	for(i = 0; i < n; ++i)
+	{
+		char *filename = malloc(strlen(dirname) + strlen(namelist[i]->d_name) + 2);
+		if(filename == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (replay_open_dir): %s\n", strerror(errno));
+			exit(-1);
+		}
+		sprintf(filename, "%s/%s", dirname, namelist[i]->d_name);
+		free(namelist[i]);
+
+		struct stat st;
+		FILE *fp = NULL;
+		if(stat(filename, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 4 ||
+		   (fp = fopen(filename, "rb")) == NULL)
+		{
+			free(filename);
+			continue;
+		}
+
+		if(source->data_size + st.st_size > max_data_size)
+		{
+			max_data_size = 2 * (source->data_size + st.st_size);
+			source->data = realloc(source->data, max_data_size);
+			if(source->data == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (replay_open_dir): %s\n", strerror(errno));
+				exit(-1);
+			}
+		}
+
+		uint8_t *jpg = source->data + source->data_size;
+		size_t size = fread(jpg, 1, st.st_size, fp);
+		fclose(fp);
+
+		int width = 0;
+		int height = 0;
+		if(jpeg_frame_size(jpg, size, &width, &height) != E_OK)
+		{
+			if(verbosity > 1)
+				printf("V4L2_CORE: (frame source) skipping %s (not a jpeg file)\n", filename);
+		}
+		else if(source->nframes > 0 && (width != source->width || height != source->height))
+		{
+			fprintf(stderr, "V4L2_CORE: (frame source) skipping %s (%ix%i frame in a %ix%i stream)\n",
+				filename, width, height, source->width, source->height);
+		}
+		else
+		{
+			source->width = width;
+			source->height = height;
+			replay_add_frame(source, source->data_size, (uint32_t) size, 0);
+			source->data_size += size;
+		}
+
+		free(filename);
+	}
+	free(namelist);
+
+	/*no recorded timestamps*/
+	free(source->ts);
+	source->ts = NULL;
+
+	source->pixelformat = V4L2_PIX_FMT_MJPEG;
+
+	return E_OK;
+}
+
+/*
+ * open a replay source
+ * args:
+ *   source - pointer to frame source
+ *   path - dump file or directory name
+ *
+ * asserts:
+ *   source is not null
+ *   path is not null
+ *
+ * returns: error code (E_OK)
+ */
+static int replay_open(frame_source_t *source, const char *path)
+{
+	/*asserts*/
+	assert(source != NULL);
+	assert(path != NULL);
+
+	struct stat st;
+	if(stat(path, &st) != 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) couldn't open %s: %s\n", path, strerror(errno));
+		return E_FILE_IO_ERR;
+	}
+
+	int ret = S_ISDIR(st.st_mode) ? replay_open_dir(source, path) : replay_open_dump(source, path);
+	if(ret != E_OK)
+		return ret;
+
+	if(source->nframes < 1)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) no frames found in %s\n", path);
+		return E_NO_DATA;
+	}
+
+	if(source->width <= 0 || source->height <= 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) invalid frame size %ix%i\n", source->width, source->height);
+		return E_BAD_WIDTH_OR_HEIGHT_ERR;
+	}
+
+	return E_OK;
+}
+
+/*
+ * open a pattern source
+ * args:
+ *   source - pointer to frame source
+ *   spec - source spec after the prefix ("" or ":WIDTHxHEIGHT")
+ *
+ * asserts:
+ *   source is not null
+ *   spec is not null
+ *
+ * returns: error code (E_OK)
+ */
+static int pattern_open(frame_source_t *source, const char *spec)
+{
+	/*asserts*/
+	assert(source != NULL);
+	assert(spec != NULL);
+
+	source->pixelformat = V4L2_PIX_FMT_YUYV;
+
+	if(spec[0] == ':')
+	{
+		int width = 0;
+		int height = 0;
+		if(sscanf(spec + 1, "%ix%i", &width, &height) != 2 ||
+		   width < 16 || height < 16 || width > 8192 || height > 8192)
+		{
+			fprintf(stderr, "V4L2_CORE: (frame source) invalid pattern size %s (use WIDTHxHEIGHT)\n", spec + 1);
+			return E_BAD_WIDTH_OR_HEIGHT_ERR;
+		}
+		source->pattern_width = width & ~1;
+		source->pattern_height = height;
+	}
+
+	return E_OK;
+}
+
+/*
+ * build the (single format) stream format list
+ * args:
+ *   vd - pointer to video device data
+ *   sizes - list of width, height pairs
+ *   nsizes - number of sizes
+ *   fps_num - frame rate numerator (the same for all frame rates)
+ *   fps_denom - list of frame rate denominators
+ *   nfps - number of frame rates
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *   vd->list_stream_formats is null
+ *
+ * returns: none
+ */
+static void set_format_list(v4l2_dev_t *vd, int sizes[][2], int nsizes,
+	int fps_num, const int *fps_denom, int nfps)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+	assert(vd->list_stream_formats == NULL);
+
+	frame_source_t *source = vd->source;
+
+	vd->list_stream_formats = calloc(1, sizeof(v4l2_stream_formats_t));
+	if(vd->list_stream_formats == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (set_format_list): %s\n", strerror(errno));
+		exit(-1);
+	}
+	vd->numb_formats = 1;
+
+	v4l2_stream_formats_t *format = &vd->list_stream_formats[0];
+	format->dec_support = can_decode_format(source->pixelformat);
+	format->format = source->pixelformat;
+	snprintf(format->fourcc, 5, "%c%c%c%c",
+		source->pixelformat & 0xFF, (source->pixelformat >> 8) & 0xFF,
+		(source->pixelformat >> 16) & 0xFF, (source->pixelformat >> 24) & 0xFF);
+
+	format->numb_res = nsizes;
+	format->list_stream_cap = calloc(nsizes, sizeof(v4l2_stream_cap_t));
+	if(format->list_stream_cap == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (set_format_list): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	int i = 0;
+	for(i = 0; i < nsizes; ++i)
+	{
+		v4l2_stream_cap_t *cap = &format->list_stream_cap[i];
+		cap->width = sizes[i][0];
+		cap->height = sizes[i][1];
+		cap->numb_frates = nfps;
+		cap->framerate_num = calloc(nfps, sizeof(int));
+		cap->framerate_denom = calloc(nfps, sizeof(int));
+		if(cap->framerate_num == NULL || cap->framerate_denom == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (set_format_list): %s\n", strerror(errno));
+			exit(-1);
+		}
+
+		int j = 0;
+		for(j = 0; j < nfps; ++j)
+		{
+			cap->framerate_num[j] = fps_num;
+			cap->framerate_denom[j] = fps_denom[j];
+		}
+	}
+}
+
+/*
+ * open the frame source named by vd->videodevice
+ *   fills the device capabilities and the stream format list
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->videodevice is not null
+ *   vd->source is null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_open(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->videodevice != NULL);
+	assert(vd->source == NULL);
+
+	frame_source_t *source = calloc(1, sizeof(frame_source_t));
+	char *spec = strdup(vd->videodevice);
+	if(source == NULL || spec == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (frame_source_open): %s\n", strerror(errno));
+		exit(-1);
+	}
+	vd->source = source;
+
+	source->fixed_fps = parse_fixed_fps(spec);
+
+	int ret = E_OK;
+	if(strncmp(spec, FRAME_SOURCE_REPLAY_PREFIX, strlen(FRAME_SOURCE_REPLAY_PREFIX)) == 0)
+	{
+		source->type = SOURCE_REPLAY;
+		ret = replay_open(source, spec + strlen(FRAME_SOURCE_REPLAY_PREFIX));
+	}
+	else
+	{
+		source->type = SOURCE_PATTERN;
+		ret = pattern_open(source, spec + strlen(FRAME_SOURCE_PATTERN_PREFIX));
+	}
+	free(spec);
+
+	if(ret != E_OK)
+	{
+		frame_source_close(vd);
+		return ret;
+	}
+
+	/*capabilities*/
+	memset(&vd->cap, 0, sizeof(struct v4l2_capability));
+	snprintf((char *) vd->cap.driver, sizeof(vd->cap.driver), "guvcview");
+	snprintf((char *) vd->cap.card, sizeof(vd->cap.card), "%s",
+		source->type == SOURCE_REPLAY ? "Replay source" : "Pattern source");
+	snprintf((char *) vd->cap.bus_info, sizeof(vd->cap.bus_info), "%s", vd->videodevice);
+	vd->cap.capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+	vd->cap.device_caps = vd->cap.capabilities;
+
+	/*h264 dumps hold complete h264 frames*/
+	vd->h264_support = source->pixelformat == V4L2_PIX_FMT_H264 ? H264_FRAME : H264_NONE;
+
+	/*frame sizes*/
+	int sizes[6][2];
+	int nsizes = 0;
+	if(source->type == SOURCE_REPLAY)
+	{
+		sizes[0][0] = source->width;
+		sizes[0][1] = source->height;
+		nsizes = 1;
+	}
+	else
+	{
+		static const int pattern_sizes[5][2] =
+		{
+			{ 640, 480 },
+			{ 320, 240 },
+			{ 800, 600 },
+			{ 1280, 720 },
+			{ 1920, 1080 }
+		};
+
+		/*requested size first*/
+		if(source->pattern_width > 0)
+		{
+			sizes[0][0] = source->pattern_width;
+			sizes[0][1] = source->pattern_height;
+			nsizes = 1;
+		}
+
+		int i = 0;
+		for(i = 0; i < 5; ++i)
+		{
+			if(source->pattern_width == pattern_sizes[i][0] &&
+			   source->pattern_height == pattern_sizes[i][1])
+				continue;
+			sizes[nsizes][0] = pattern_sizes[i][0];
+			sizes[nsizes][1] = pattern_sizes[i][1];
+			nsizes++;
+		}
+	}
+
+	/*frame rates*/
+	if(source->fixed_fps > 0)
+		set_format_list(vd, sizes, nsizes, 1, &source->fixed_fps, 1);
+	else if(source->ts != NULL && source->fps_num > 0 && source->fps_denom > 0)
+		set_format_list(vd, sizes, nsizes, source->fps_num, &source->fps_denom, 1);
+	else
+	{
+		static const int default_fps[] = {60, 30, 25, 20, 15, 10, 5};
+		set_format_list(vd, sizes, nsizes, 1, default_fps, sizeof(default_fps) / sizeof(int));
+	}
+
+	if(!vd->list_stream_formats[0].dec_support)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) format not supported by the decoder\n");
+		frame_source_close(vd);
+		return E_FORMAT_ERR;
+	}
+
+	if(verbosity > 0)
+	{
+		printf("V4L2_CORE: (frame source) %s - %s %ix%i",
+			vd->videodevice, vd->list_stream_formats[0].fourcc,
+			vd->list_stream_formats[0].list_stream_cap[0].width,
+			vd->list_stream_formats[0].list_stream_cap[0].height);
+		if(source->type == SOURCE_REPLAY)
+			printf(" (%i frames%s)", source->nframes, source->ts ? " with timestamps" : "");
+		if(source->fixed_fps == 0)
+			printf(" - unpaced");
+		else if(source->fixed_fps > 0)
+			printf(" - %i fps", source->fixed_fps);
+		printf("\n");
+	}
+
+	return E_OK;
+}
+
+/*
+ * render the color bars for the current pattern size (yuyv)
+ * args:
+ *   source - pointer to frame source
+ *
+ * asserts:
+ *   source is not null
+ *
+ * returns: none
+ */
+static void pattern_create(frame_source_t *source)
+{
+	/*asserts*/
+	assert(source != NULL);
+
+	/*75% color bars (y, u, v)*/
+	static const uint8_t bars[8][3] =
+	{
+		{ 180, 128, 128 }, /*white*/
+		{ 162,  44, 142 }, /*yellow*/
+		{ 131, 156,  44 }, /*cyan*/
+		{ 112,  72,  58 }, /*green*/
+		{  84, 184, 198 }, /*magenta*/
+		{  65, 100, 212 }, /*red*/
+		{  35, 212, 114 }, /*blue*/
+		{  16, 128, 128 }  /*black*/
+	};
+
+	int width = source->width;
+	int height = source->height;
+
+	free(source->pattern);
+	source->pattern = malloc(width * height * 2);
+	if(source->pattern == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (pattern_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	uint8_t *p = source->pattern;
+	int x = 0;
+	for(x = 0; x < width; x += 2)
+	{
+		const uint8_t *bar = bars[(x * 8) / width];
+		*p++ = bar[0];
+		*p++ = bar[1];
+		*p++ = bar[0];
+		*p++ = bar[2];
+	}
+
+	int y = 0;
+	for(y = 1; y < height; ++y)
+		memcpy(source->pattern + y * width * 2, source->pattern, width * 2);
+}
+
+/*
+ * render a pattern frame: color bars with a moving block
+ * args:
+ *   source - pointer to frame source
+ *   buff - pointer to frame buffer
+ *
+ * asserts:
+ *   source is not null
+ *   buff is not null
+ *
+ * returns: frame size (bytes)
+ */
+static uint32_t pattern_render(frame_source_t *source, uint8_t *buff)
+{
+	/*asserts*/
+	assert(source != NULL);
+	assert(buff != NULL);
+
+	int width = source->width;
+	int height = source->height;
+
+	memcpy(buff, source->pattern, width * height * 2);
+
+	/*white block (1/8 of the frame) bouncing across the bars*/
+	int block_w = (width / 8) & ~1;
+	int block_h = height / 8;
+	int range_x = width - block_w;
+	int range_y = height - block_h;
+
+	int x = (int) ((source->frame_count * 4) % (2 * range_x));
+	if(x > range_x)
+		x = 2 * range_x - x;
+	x &= ~1;
+	int y = (int) ((source->frame_count * 2) % (2 * range_y));
+	if(y > range_y)
+		y = 2 * range_y - y;
+
+	int i = 0;
+	int j = 0;
+	for(j = 0; j < block_h; ++j)
+	{
+		uint8_t *p = buff + ((y + j) * width + x) * 2;
+		for(i = 0; i < block_w; i += 2)
+		{
+			*p++ = 235;
+			*p++ = 128;
+			*p++ = 235;
+			*p++ = 128;
+		}
+	}
+
+	return (uint32_t) (width * height * 2);
+}
+
+/*
+ * set the stream format (the S_FMT equivalent)
+ *   vd->format is set to the format the source will deliver
+ * args:
+ *   vd - pointer to video device data
+ *   width - requested width
+ *   height - requested height
+ *   pixelformat - requested v4l2 pixel format
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_set_format(v4l2_dev_t *vd, int width, int height, int pixelformat)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	if(source->type == SOURCE_PATTERN)
+	{
+		/*any size will do*/
+		if(width < 16 || height < 16 || width > 8192 || height > 8192)
+		{
+			width = vd->list_stream_formats[0].list_stream_cap[0].width;
+			height = vd->list_stream_formats[0].list_stream_cap[0].height;
+		}
+		source->width = width & ~1;
+		source->height = height;
+		pattern_create(source);
+	}
+
+	if(verbosity > 0 && (uint32_t) pixelformat != source->pixelformat)
+		printf("V4L2_CORE: (frame source) requested format %c%c%c%c not available: using %s\n",
+			pixelformat & 0xFF, (pixelformat >> 8) & 0xFF,
+			(pixelformat >> 16) & 0xFF, (pixelformat >> 24) & 0xFF,
+			vd->list_stream_formats[0].fourcc);
+
+	memset(&vd->format, 0, sizeof(struct v4l2_format));
+	vd->format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	vd->format.fmt.pix.pixelformat = source->pixelformat;
+	vd->format.fmt.pix.width = source->width;
+	vd->format.fmt.pix.height = source->height;
+	vd->format.fmt.pix.field = V4L2_FIELD_NONE;
+	if(source->type == SOURCE_PATTERN)
+	{
+		vd->format.fmt.pix.bytesperline = source->width * 2;
+		vd->format.fmt.pix.sizeimage = source->width * source->height * 2;
+	}
+	else
+		vd->format.fmt.pix.sizeimage = source->max_frame_size;
+
+	/*decode what the source delivers*/
+	vd->requested_fmt = source->pixelformat;
+
+	return E_OK;
+}
+
+/*
+ * free the frame source buffers
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: none
+ */
+void frame_source_free_buffers(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	int i = 0;
+	for(i = 0; i < NB_BUFFER; ++i)
+	{
+		if(vd->mem[i] != MAP_FAILED && vd->mem[i] != NULL)
+			free(vd->mem[i]);
+		vd->mem[i] = MAP_FAILED;
+		vd->buff_length[i] = 0;
+		source->queued[i] = 0;
+	}
+	source->nbuffers = 0;
+}
+
+/*
+ * allocate the frame source buffers (the REQBUFS equivalent)
+ *   all buffers start queued
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_request_buffers(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	frame_source_free_buffers(vd);
+
+	uint32_t length = vd->format.fmt.pix.sizeimage;
+	if(length == 0)
+		return E_REQBUFS_ERR;
+
+	int i = 0;
+	for(i = 0; i < NB_BUFFER; ++i)
+	{
+		vd->mem[i] = calloc(length, sizeof(uint8_t));
+		if(vd->mem[i] == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (frame_source_request_buffers): %s\n", strerror(errno));
+			exit(-1);
+		}
+		vd->buff_length[i] = length;
+		vd->buff_offset[i] = 0;
+		source->queued[i] = 1;
+	}
+	source->nbuffers = NB_BUFFER;
+	source->next_buffer = 0;
+
+	memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
+	vd->rb.count = NB_BUFFER;
+	vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	vd->rb.memory = V4L2_MEMORY_MMAP;
+
+	return E_OK;
+}
+
+/*
+ * apply the frame rate in vd->fps_num/fps_denom
+ *   (a fixed source frame rate takes precedence)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_set_framerate(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	if(source->fixed_fps > 0)
+	{
+		vd->fps_num = 1;
+		vd->fps_denom = source->fixed_fps;
+	}
+	else if(source->ts != NULL && source->fps_num > 0 && source->fps_denom > 0)
+	{
+		vd->fps_num = source->fps_num;
+		vd->fps_denom = source->fps_denom;
+	}
+
+	if(vd->fps_num <= 0)
+		vd->fps_num = 1;
+	if(vd->fps_denom <= 0)
+		vd->fps_denom = 25;
+
+	/*restart pacing*/
+	source->next_ts = 0;
+
+	return E_OK;
+}
+
+/*
+ * start or stop the frame source
+ * args:
+ *   vd - pointer to video device data
+ *   on - 1 to start, 0 to stop
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_stream(v4l2_dev_t *vd, int on)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	if(source->nbuffers <= 0)
+		return on ? E_STREAMON_ERR : E_OK;
+
+	/*restart pacing (buffers still held by the client stay dequeued)*/
+	source->next_ts = 0;
+
+	return E_OK;
+}
+
+/*
+ * get the time between a frame and the next one
+ * args:
+ *   vd - pointer to video device data
+ *   frame - replay frame index
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: frame interval (ns)
+ */
+static uint64_t frame_interval(v4l2_dev_t *vd, int frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	uint64_t interval = 0;
+	if(source->fixed_fps > 0)
+		interval = NSEC_PER_SEC / source->fixed_fps;
+	else if(source->ts != NULL && source->nframes > 1)
+	{
+		if(frame + 1 < source->nframes && source->ts[frame + 1] > source->ts[frame])
+			interval = source->ts[frame + 1] - source->ts[frame];
+		else /*looping (or bad timestamps): use the mean interval*/
+			interval = (source->ts[source->nframes - 1] - source->ts[0]) / (source->nframes - 1);
+	}
+	else if(vd->fps_num > 0 && vd->fps_denom > 0)
+		interval = (uint64_t) vd->fps_num * NSEC_PER_SEC / vd->fps_denom;
+	else
+		interval = NSEC_PER_SEC / 25;
+
+	if(interval > SOURCE_MAX_INTERVAL)
+		interval = SOURCE_MAX_INTERVAL;
+
+	return interval;
+}
+
+/*
+ * wait until the next frame is due (the select equivalent)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_wait(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	if(source->fixed_fps == 0)
+		return E_OK; /*as fast as possible*/
+
+	uint64_t now = ns_time_monotonic();
+
+	/*first frame or we fell too far behind: restart the clock*/
+	if(source->next_ts == 0 || now > source->next_ts + SOURCE_MAX_INTERVAL)
+		source->next_ts = now;
+
+	if(source->next_ts > now)
+	{
+		struct timespec due;
+		due.tv_sec = source->next_ts / NSEC_PER_SEC;
+		due.tv_nsec = source->next_ts % NSEC_PER_SEC;
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+			;
+	}
+
+	return E_OK;
+}
+
+/*
+ * fill the next queued buffer with a frame (the DQBUF equivalent)
+ *   sets vd->buf.index and vd->buf.bytesused
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK or E_DQBUF_ERR if no buffer is queued)
+ */
+int frame_source_dequeue(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	/*buffers are filled in queue order*/
+	int index = -1;
+	int i = 0;
+	for(i = 0; i < source->nbuffers; ++i)
+	{
+		int b = (source->next_buffer + i) % source->nbuffers;
+		if(__atomic_load_n(&source->queued[b], __ATOMIC_ACQUIRE))
+		{
+			index = b;
+			break;
+		}
+	}
+
+	if(index < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) no queued buffers\n");
+		return E_DQBUF_ERR;
+	}
+
+	source->next_buffer = (index + 1) % source->nbuffers;
+
+	uint32_t bytesused = 0;
+	uint64_t interval = 0;
+	if(source->type == SOURCE_REPLAY)
+	{
+		int frame = source->next_frame;
+		bytesused = source->size[frame];
+		memcpy(vd->mem[index], source->data + source->offset[frame], bytesused);
+		interval = frame_interval(vd, frame);
+
+		source->next_frame = frame + 1;
+		if(source->next_frame >= source->nframes)
+		{
+			source->next_frame = 0;
+			if(verbosity > 2)
+				printf("V4L2_CORE: (frame source) replay looped after %" PRIu64 " frames\n",
+					source->frame_count + 1);
+		}
+	}
+	else
+	{
+		bytesused = pattern_render(source, vd->mem[index]);
+		interval = frame_interval(vd, 0);
+	}
+
+	__atomic_store_n(&source->queued[index], 0, __ATOMIC_RELEASE);
+
+	memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
+	vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	vd->buf.memory = V4L2_MEMORY_MMAP;
+	vd->buf.index = index;
+	vd->buf.bytesused = bytesused;
+	vd->buf.length = vd->buff_length[index];
+	vd->buf.sequence = (uint32_t) source->frame_count;
+	/*
+	 * the due time is the "driver" timestamp
+	 * (unpaced sources have no due time: use the dequeue time)
+	 */
+	uint64_t ts = source->fixed_fps != 0 ? source->next_ts : ns_time_monotonic();
+	vd->buf.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+	vd->buf.timestamp.tv_sec = ts / NSEC_PER_SEC;
+	vd->buf.timestamp.tv_usec = (ts % NSEC_PER_SEC) / 1000;
+
+	source->next_ts += interval;
+
+	source->frame_count++;
+
+	return E_OK;
+}
+
+/*
+ * give a buffer back to the frame source (the QBUF equivalent)
+ *   safe to call from the decoder workers
+ * args:
+ *   vd - pointer to video device data
+ *   index - buffer index
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_queue(v4l2_dev_t *vd, int index)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->source != NULL);
+
+	frame_source_t *source = vd->source;
+
+	if(index < 0 || index >= source->nbuffers)
+	{
+		fprintf(stderr, "V4L2_CORE: (frame source) Unable to queue buffer %i\n", index);
+		return E_QBUF_ERR;
+	}
+
+	__atomic_store_n(&source->queued[index], 1, __ATOMIC_RELEASE);
+
+	return E_OK;
+}
+
+/*
+ * close the frame source and free its data
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_source_close(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	frame_source_t *source = vd->source;
+	if(source == NULL)
+		return;
+
+	frame_source_free_buffers(vd);
+
+	if(source->data != NULL)
+	{
+		if(source->mapped)
+			munmap(source->data, source->data_size);
+		else
+			free(source->data);
+	}
+
+	free(source->offset);
+	free(source->size);
+	free(source->ts);
+	free(source->pattern);
+	free(source);
+
+	vd->source = NULL;
+}
+
+/*
+ * start writing the raw captured frames to a dump file
+ *   (replay it with "replay:FILE")
+ * args:
+ *   vd - pointer to video device data
+ *   filename - dump file name (NULL - stop dumping)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_dump_open(v4l2_dev_t *vd, const char *filename)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	frame_dump_t *dump = vd->dump;
+	if(dump != NULL)
+	{
+		fclose(dump->fp);
+		if(verbosity > 0)
+			printf("V4L2_CORE: raw dump closed (%" PRIu64 " frames)\n", dump->frames);
+		free(dump);
+		vd->dump = NULL;
+	}
+
+	if(filename == NULL)
+		return E_OK;
+
+	dump = calloc(1, sizeof(frame_dump_t));
+	if(dump == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (frame_source_dump_open): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	dump->fp = fopen(filename, "wb");
+	if(dump->fp == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: couldn't open raw dump file %s: %s\n", filename, strerror(errno));
+		free(dump);
+		return E_FILE_IO_ERR;
+	}
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: dumping raw frames to %s\n", filename);
+
+	vd->dump = dump;
+
+	return E_OK;
+}
+
+/*
+ * append a captured frame to the dump file (if any)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to captured frame
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void frame_source_dump_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	frame_dump_t *dump = vd->dump;
+	if(dump == NULL || frame->raw_frame == NULL || frame->raw_frame_size == 0)
+		return;
+
+	/*
+	 * the raw format (muxed h264 is dumped as
+	 * its mjpeg container and replays as mjpeg)
+	 */
+	if(!dump->header_written)
+	{
+		memcpy(dump->header.magic, FRAME_DUMP_MAGIC, sizeof(dump->header.magic));
+		dump->header.pixelformat = vd->format.fmt.pix.pixelformat;
+		dump->header.width = vd->format.fmt.pix.width;
+		dump->header.height = vd->format.fmt.pix.height;
+		dump->header.fps_num = vd->fps_num;
+		dump->header.fps_denom = vd->fps_denom;
+
+		if(fwrite(&dump->header, sizeof(frame_dump_header_t), 1, dump->fp) != 1)
+		{
+			fprintf(stderr, "V4L2_CORE: raw dump write error: %s\n", strerror(errno));
+			frame_source_dump_open(vd, NULL);
+			return;
+		}
+		dump->header_written = 1;
+	}
+	else if(dump->header.pixelformat != vd->format.fmt.pix.pixelformat ||
+		dump->header.width != vd->format.fmt.pix.width ||
+		dump->header.height != vd->format.fmt.pix.height)
+	{
+		fprintf(stderr, "V4L2_CORE: stream format changed: raw dump stopped\n");
+		frame_source_dump_open(vd, NULL);
+		return;
+	}
+
+	frame_dump_record_t record;
+	record.timestamp = frame->timestamp;
+	record.size = (uint32_t) frame->raw_frame_size;
+
+	if(fwrite(&record, sizeof(frame_dump_record_t), 1, dump->fp) != 1 ||
+	   fwrite(frame->raw_frame, frame->raw_frame_size, 1, dump->fp) != 1)
+	{
+		fprintf(stderr, "V4L2_CORE: raw dump write error: %s\n", strerror(errno));
+		frame_source_dump_open(vd, NULL);
+		return;
+	}
+
+	dump->frames++;
+}
@@ -0,0 +1,249 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+
+/*
+ * hardware independent frame sources
+ *   the device name selects the source:
+ *     replay:FILE[@FPS]   - replay a raw dump (see below) or a directory
+ *                           of jpeg files (one frame per file, name order)
+ *     pattern[:WxH][@FPS] - generated yuyv color bars with a moving block
+ *   FPS sets a fixed frame rate, 0 delivers frames as fast as possible.
+ *   Without it dumps follow the recorded timestamps and the other
+ *   sources the selected frame rate. Replay loops at end of file.
+ *
+ *   frames go through the same buffer queue, decoding and frame
+ *   pipeline as mmap capture from a real device
+ */
+#define FRAME_SOURCE_REPLAY_PREFIX  "replay:"
+#define FRAME_SOURCE_PATTERN_PREFIX "pattern"
+
+/*
+ * raw dump file (host byte order):
+ *   frame_dump_header_t followed by a frame_dump_record_t and
+ *   the raw frame data (size bytes) for each captured frame
+ */
+#define FRAME_DUMP_MAGIC "GVRAW001"
+
+typedef struct _frame_dump_header_t
+{
+	char magic[8];        //FRAME_DUMP_MAGIC
+	uint32_t pixelformat; //v4l2 pixel format of the raw frames
+	uint32_t width;       //frame width
+	uint32_t height;      //frame height
+	uint32_t fps_num;     //frame rate numerator
+	uint32_t fps_denom;   //frame rate denominator
+	uint32_t reserved;
+} __attribute__((__packed__)) frame_dump_header_t;
+
+typedef struct _frame_dump_record_t
+{
+	uint64_t timestamp;   //capture timestamp (ns)
+	uint32_t size;        //raw frame size (bytes)
+} __attribute__((__packed__)) frame_dump_record_t;
+
+/*
+ * check if device is a frame source name
+ * args:
+ *   device - device name
+ *
+ * asserts:
+ *   device is not null
+ *
+ * returns: 1 if device names a frame source, 0 otherwise
+ */
+int frame_source_is_source(const char *device);
+
+/*
+ * open the frame source named by vd->videodevice
+ *   fills the device capabilities and the stream format list
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->videodevice is not null
+ *   vd->source is null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_open(v4l2_dev_t *vd);
+
+/*
+ * set the stream format (the S_FMT equivalent)
+ *   vd->format is set to the format the source will deliver
+ * args:
+ *   vd - pointer to video device data
+ *   width - requested width
+ *   height - requested height
+ *   pixelformat - requested v4l2 pixel format
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_set_format(v4l2_dev_t *vd, int width, int height, int pixelformat);
+
+/*
+ * allocate the frame source buffers (the REQBUFS equivalent)
+ *   all buffers start queued
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_request_buffers(v4l2_dev_t *vd);
+
+/*
+ * free the frame source buffers
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: none
+ */
+void frame_source_free_buffers(v4l2_dev_t *vd);
+
+/*
+ * apply the frame rate in vd->fps_num/fps_denom
+ *   (a fixed source frame rate takes precedence)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_set_framerate(v4l2_dev_t *vd);
+
+/*
+ * start or stop the frame source
+ * args:
+ *   vd - pointer to video device data
+ *   on - 1 to start, 0 to stop
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_stream(v4l2_dev_t *vd, int on);
+
+/*
+ * wait until the next frame is due (the select equivalent)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_wait(v4l2_dev_t *vd);
+
+/*
+ * fill the next queued buffer with a frame (the DQBUF equivalent)
+ *   sets vd->buf.index and vd->buf.bytesused
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK or E_DQBUF_ERR if no buffer is queued)
+ */
+int frame_source_dequeue(v4l2_dev_t *vd);
+
+/*
+ * give a buffer back to the frame source (the QBUF equivalent)
+ *   safe to call from the decoder workers
+ * args:
+ *   vd - pointer to video device data
+ *   index - buffer index
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->source is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_queue(v4l2_dev_t *vd, int index);
+
+/*
+ * close the frame source and free its data
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_source_close(v4l2_dev_t *vd);
+
+/*
+ * start writing the raw captured frames to a dump file
+ *   (replay it with "replay:FILE")
+ * args:
+ *   vd - pointer to video device data
+ *   filename - dump file name (NULL - stop dumping)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_source_dump_open(v4l2_dev_t *vd, const char *filename);
+
+/*
+ * append a captured frame to the dump file (if any)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to captured frame
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void frame_source_dump_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+#endif
@@ -0,0 +1,430 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "frame_timing.h"
+#include "core_time.h"
+#include "../config.h"
+
+/*older driver timestamps are not trusted (stale or wrong clock)*/
+#define TS_MAX_DRIVER_DELAY (NSEC_PER_SEC)
+/*clock model loop bandwidth (Hz)*/
+#define TS_PLL_BANDWIDTH    (0.5)
+/*larger sequence jumps are a driver reset, not dropped frames*/
+#define TS_MAX_SEQ_GAP      (1000)
+
+/*sequence number state*/
+#define SEQ_UNKNOWN (0)
+#define SEQ_VALID   (1)
+#define SEQ_NONE    (2) /*driver doesn't count frames*/
+
+extern int verbosity;
+
+typedef struct _frame_timing_t
+{
+	int mode;           //requested TS_MODE_* flags (atomic)
+	int active_mode;    //flags in use (the model is reset on change)
+	int driver_ts;      //last frame used the driver timestamp (-1 - no frames yet)
+
+	uint64_t nominal;   //nominal frame interval (ns) from the stream parameters
+	uint64_t last_raw;  //last raw timestamp (0 - none)
+	uint64_t last_ts;   //last frame timestamp
+	uint32_t last_seq;  //last driver sequence number
+	int seq_state;      //SEQ_UNKNOWN, SEQ_VALID or SEQ_NONE
+
+	/*clock model (times in ns relative to base)*/
+	int locked;         //model is running
+	uint64_t base;      //time origin (set on lock)
+	double last;        //last filtered timestamp
+	double next;        //predicted timestamp of the next frame
+	double period;      //estimated frame interval
+	double b;           //loop filter phase coefficient
+	double c;           //loop filter frequency coefficient
+
+	uint64_t dropped;   //frames lost since the stream started (atomic)
+	uint64_t resyncs;   //clock model relocks
+} frame_timing_t;
+
+/*
+ * allocate the frame timing data (timestamp source, clock model
+ *  and dropped frame detection)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_timing_init(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	frame_timing_t *timing = calloc(1, sizeof(frame_timing_t));
+	if(timing == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (frame_timing_init): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	timing->mode = TS_MODE_SYSTEM;
+	vd->timing = timing;
+
+	frame_timing_reset(vd);
+
+	return E_OK;
+}
+
+/*
+ * free the frame timing data
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_timing_close(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(vd->timing == NULL)
+		return;
+
+	if(verbosity > 0 && vd->timing->resyncs > 0)
+		printf("V4L2_CORE: (timing) clock model relocked %" PRIu64 " times\n",
+			vd->timing->resyncs);
+
+	free(vd->timing);
+	vd->timing = NULL;
+}
+
+/*
+ * reset the clock model and the sequence tracking (stream start)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_timing_reset(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	frame_timing_t *timing = vd->timing;
+	if(timing == NULL)
+		return;
+
+	timing->active_mode = __atomic_load_n(&timing->mode, __ATOMIC_ACQUIRE);
+	timing->driver_ts = -1;
+	timing->nominal = 0;
+	timing->last_raw = 0;
+	timing->last_ts = 0;
+	timing->last_seq = 0;
+	timing->seq_state = SEQ_UNKNOWN;
+	timing->locked = 0;
+
+	__atomic_store_n(&timing->dropped, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * (re)start the clock model at raw
+ * args:
+ *   timing - pointer to frame timing data
+ *   raw - raw timestamp (ns)
+ *   period - frame interval (ns)
+ *
+ * asserts:
+ *   timing is not null
+ *
+ * returns: none
+ */
+static void clock_model_lock(frame_timing_t *timing, uint64_t raw, double period)
+{
+	/*asserts*/
+	assert(timing != NULL);
+
+	/*
+	 * second order loop (delay locked loop) with a fixed
+	 * bandwidth in Hz, so the coefficients depend on the frame rate
+	 */
+	double omega = 2.0 * 3.14159265358979323846 * TS_PLL_BANDWIDTH * period / NSEC_PER_SEC;
+	if(omega > 0.5)
+		omega = 0.5; /*keep it stable at very low frame rates*/
+
+	timing->b = 1.41421356237309504880 * omega;
+	timing->c = omega * omega;
+
+	timing->base = raw;
+	timing->last = 0;
+	timing->period = period;
+	timing->next = period;
+	timing->locked = 1;
+}
+
+/*
+ * filter the raw timestamp with the clock model
+ * args:
+ *   timing - pointer to frame timing data
+ *   raw - raw timestamp (ns)
+ *   k - frames since the last one (0 - unknown)
+ *
+ * asserts:
+ *   timing is not null
+ *
+ * returns: filtered timestamp (ns)
+ */
+static uint64_t clock_model_update(frame_timing_t *timing, uint64_t raw, uint32_t k)
+{
+	/*asserts*/
+	assert(timing != NULL);
+
+	if(!timing->locked)
+	{
+		clock_model_lock(timing, raw, (double) timing->nominal);
+		return raw;
+	}
+
+	double period = timing->period;
+	double t = (double) ((int64_t) (raw - timing->base));
+
+	/*no sequence numbers: guess the frames elapsed from the interval*/
+	if(k == 0)
+	{
+		double n = (t - timing->last) / period + 0.5;
+		k = (n >= 1) ? (uint32_t) n : 1;
+	}
+
+	double predicted = timing->next + (double) (k - 1) * period;
+	double err = t - predicted;
+
+	/*
+	 * scheduling delays make frames late but never early, so allow
+	 * more slack on the late side before giving up on the model
+	 */
+	if(err < -period || err > 2 * period)
+	{
+		double measured = (double) (raw - timing->last_raw) / (double) k;
+
+		/*the frame rate changed (e.g. exposure): lock to the measured interval*/
+		if(raw <= timing->last_raw ||
+		   measured < (double) timing->nominal / 8 ||
+		   measured > (double) timing->nominal * 8)
+			measured = (double) timing->nominal;
+
+		if(verbosity > 1)
+			printf("V4L2_CORE: (timing) clock model relock (error %.3f ms, interval %.3f ms)\n",
+				err / 1000000.0, measured / 1000000.0);
+
+		timing->resyncs++;
+		clock_model_lock(timing, raw, measured);
+		return raw;
+	}
+
+	double out = predicted + timing->b * err;
+
+	timing->period = period + timing->c * err;
+	timing->last = out;
+	timing->next = out + timing->period;
+
+	return timing->base + (uint64_t) (out + 0.5);
+}
+
+/*
+ * set the frame timestamp, dequeue time, sequence and dropped count
+ *  from the dequeued buffer (vd->buf) - capture thread only
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to the frame buffer being filled
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void frame_timing_process(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	frame_timing_t *timing = vd->timing;
+	uint64_t now = ns_time_monotonic();
+
+	frame->dequeue_ts = now;
+	frame->raw_timestamp = now;
+	frame->timestamp = now;
+	frame->sequence = (uint32_t) vd->frame_index;
+	frame->dropped = 0;
+
+	if(timing == NULL)
+		return;
+
+	if(__atomic_load_n(&timing->mode, __ATOMIC_ACQUIRE) != timing->active_mode)
+		frame_timing_reset(vd);
+
+	int mode = timing->active_mode;
+
+	/*read() doesn't fill a v4l2_buffer*/
+	int has_buf = (vd->cap_meth != IO_READ || vd->source != NULL);
+
+	/*raw timestamp: driver (start of exposure or end of frame) or dequeue time*/
+	uint64_t raw = now;
+	int from_driver = 0;
+	if((mode & TS_MODE_DRIVER) && has_buf &&
+	   (vd->buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+	{
+		uint64_t ts = (uint64_t) vd->buf.timestamp.tv_sec * NSEC_PER_SEC +
+			(uint64_t) vd->buf.timestamp.tv_usec * 1000;
+
+		if(ts > 0 && ts <= now && now - ts < TS_MAX_DRIVER_DELAY)
+		{
+			raw = ts;
+			from_driver = 1;
+		}
+	}
+
+	if(from_driver != timing->driver_ts)
+	{
+		if(verbosity > 0)
+			printf("V4L2_CORE: (timing) using %s frame timestamps\n",
+				from_driver ? "driver" : "system");
+		/*don't filter across clock sources*/
+		if(timing->driver_ts >= 0)
+			timing->locked = 0;
+		timing->driver_ts = from_driver;
+	}
+
+	/*nominal interval (fps_num/fps_denom is the time per frame)*/
+	uint64_t nominal = 0;
+	if(vd->fps_num > 0 && vd->fps_denom > 0)
+		nominal = (uint64_t) vd->fps_num * NSEC_PER_SEC / (uint64_t) vd->fps_denom;
+	if(nominal != timing->nominal)
+	{
+		timing->nominal = nominal;
+		timing->locked = 0;
+	}
+
+	/*dropped frames from gaps in the driver sequence*/
+	uint32_t k = 0;
+	if(has_buf)
+	{
+		frame->sequence = vd->buf.sequence;
+
+		if(timing->last_raw > 0)
+		{
+			uint32_t gap = vd->buf.sequence - timing->last_seq;
+
+			if(timing->seq_state == SEQ_UNKNOWN)
+				timing->seq_state = (gap > 0) ? SEQ_VALID : SEQ_NONE;
+
+			if(timing->seq_state == SEQ_VALID && gap > 0 && gap <= TS_MAX_SEQ_GAP)
+			{
+				k = gap;
+				if(gap > 1)
+				{
+					frame->dropped = gap - 1;
+					__atomic_add_fetch(&timing->dropped, gap - 1, __ATOMIC_RELEASE);
+
+					if(verbosity > 1)
+						printf("V4L2_CORE: (timing) %" PRIu32 " frames dropped before sequence %" PRIu32 "\n",
+							gap - 1, vd->buf.sequence);
+				}
+			}
+		}
+
+		timing->last_seq = vd->buf.sequence;
+	}
+
+	uint64_t ts = raw;
+	if((mode & TS_MODE_SMOOTH) && timing->nominal > 0)
+		ts = clock_model_update(timing, raw, k);
+
+	/*timestamps must always move forward*/
+	if(timing->last_ts > 0 && ts <= timing->last_ts)
+		ts = timing->last_ts + 1;
+
+	timing->last_raw = raw;
+	timing->last_ts = ts;
+
+	frame->raw_timestamp = raw;
+	frame->timestamp = ts;
+}
+
+/*
+ * set the frame timestamp mode
+ * args:
+ *   vd - pointer to video device data
+ *   mode - TS_MODE_* flags (TS_MODE_SYSTEM - dequeue time)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_timestamp_mode(v4l2_dev_t *vd, int mode)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(vd->timing == NULL)
+		return;
+
+	__atomic_store_n(&vd->timing->mode, mode & (TS_MODE_DRIVER | TS_MODE_SMOOTH), __ATOMIC_RELEASE);
+}
+
+/*
+ * get the number of frames dropped by the driver since
+ *  the stream started (gaps in the buffer sequence numbers)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: dropped frames
+ */
+uint64_t v4l2core_get_dropped_frames(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(vd->timing == NULL)
+		return 0;
+
+	return __atomic_load_n(&vd->timing->dropped, __ATOMIC_ACQUIRE);
+}
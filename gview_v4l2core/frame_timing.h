@@ -0,0 +1,80 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+
+/*
+ * allocate the frame timing data (timestamp source, clock model
+ *  and dropped frame detection)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int frame_timing_init(v4l2_dev_t *vd);
+
+/*
+ * free the frame timing data
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_timing_close(v4l2_dev_t *vd);
+
+/*
+ * reset the clock model and the sequence tracking (stream start)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void frame_timing_reset(v4l2_dev_t *vd);
+
+/*
+ * set the frame timestamp, sequence and dropped count
+ *  from the dequeued buffer (vd->buf) - capture thread only
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to the frame buffer being filled
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void frame_timing_process(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+#endif
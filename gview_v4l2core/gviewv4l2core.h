@@ -100,8 +100,33 @@ __BEGIN_DECLS
 /*
  * IO methods
  */
-#define IO_MMAP 1
-#define IO_READ 2
+#define IO_MMAP    1
+#define IO_READ    2
+#define IO_USERPTR 3 /*user allocated (page aligned) capture buffers*/
+#define IO_DMABUF  4 /*mmap buffers also exported as dma-buf fds*/
+
+/*
+ * Frame timestamp modes (v4l2core_set_timestamp_mode)
+ */
+#define TS_MODE_SYSTEM (0)      /*dequeue time (default)*/
+#define TS_MODE_DRIVER (1 << 0) /*driver monotonic timestamps (if available)*/
+#define TS_MODE_SMOOTH (1 << 1) /*remove jitter with a clock model locked to the frame rate*/
+
+/*
+ * H264 decoder threading (v4l2core_set_h264_decoder_threading)
+ */
+#define H264_THREAD_AUTO  (0) /*let libav choose*/
+#define H264_THREAD_FRAME (1) /*frame threading (adds one frame delay per thread)*/
+#define H264_THREAD_SLICE (2) /*slice threading (no added delay, needs multi slice streams)*/
+#define H264_MAX_THREADS  (16)
+
+/*
+ * Device events (collected while waiting for frames - v4l2core_get_events)
+ */
+#define DEV_EVENT_CONTROL       (1 << 0) /*a control was changed by someone else (see v4l2core_update_control_values)*/
+#define DEV_EVENT_SOURCE_CHANGE (1 << 1) /*the video source changed (e.g. resolution): renegotiate the format*/
+#define DEV_EVENT_DEVICE_LIST   (1 << 2) /*devices were added or removed (see v4l2core_check_device_list_events)*/
+#define DEV_EVENT_HANGUP        (1 << 3) /*the device was disconnected*/
 
 /*
  * Frame status
@@ -130,6 +155,13 @@ __BEGIN_DECLS
 #define IMG_FMT_PNG     (2)
 #define IMG_FMT_BMP     (3)
 
+/*
+ * Snapshot queue policies (v4l2core_snapshot_start - when the queue is full)
+ */
+#define SNAPSHOT_DROP_OLDEST (0) /*drop the oldest queued snapshot*/
+#define SNAPSHOT_BLOCK       (1) /*wait for a free slot*/
+#define SNAPSHOT_SKIP        (2) /*drop the new snapshot*/
+
 
 /*
  * buffer number (for driver mmap ops)
@@ -253,6 +285,18 @@ typedef struct _v4l2_dev_sys_data_t
 	uint64_t devnum;
 } v4l2_dev_sys_data_t;
 
+/*
+ * h264 NAL unit index entry (see v4l2_frame_buff_t)
+ */
+#define H264_MAX_NALS (32) /*the last entry takes any extra NAL units*/
+
+typedef struct _h264_nal_t
+{
+	uint32_t offset; //NAL header offset in h264_frame (after the start code)
+	uint32_t size; //NAL unit size (bytes, without start code)
+	uint8_t type; //NAL unit type (5 - IDR, 7 - SPS, 8 - PPS, ...)
+} h264_nal_t;
+
 /*
  * frame buffer struct
  */
@@ -260,18 +304,29 @@ typedef struct _v4l2_frame_buff_t
 {
 	int index; //buffer index
 	int status; //frame status {FRAME_DECODING; FRAME_DONE; FRAME_READY}
+	int refcount; //frame references (1 when handed out, see v4l2core_frame_ref)
 	
 	uint8_t isKeyframe; // current buffer contains a keyframe (h264 IDR)
 	
 	uint8_t *raw_frame; // pointer to raw frame
 	size_t raw_frame_size; // raw frame size (bytes)
 	size_t raw_frame_max_size; //maximum size for raw frame (bytes)
-	uint8_t *yuv_frame; // pointer to decoded yuv frame
-	uint8_t *h264_frame; // pointer to regular or demultiplexed h264 frame
+	uint8_t *yuv_frame; // pointer to decoded yuv frame (may point to raw_frame - zero copy)
+	uint8_t *yuv_frame_buffer; // allocated yuv frame buffer
+	uint8_t *h264_frame; // pointer to regular or demultiplexed h264 frame (may point to raw_frame - zero copy)
+	uint8_t *h264_frame_buffer; // allocated h264 frame buffer
 	size_t h264_frame_size; // h264 frame size (bytes)
-	size_t h264_frame_max_size; //size limit for h264 frame (bytes)
+	size_t h264_frame_max_size; //size limit for h264 frame buffer (bytes)
+	h264_nal_t h264_nal[H264_MAX_NALS]; // NAL units found in h264_frame
+	int h264_nal_count; // number of entries in h264_nal
 	
-	uint64_t timestamp; // captured frame timestamp
+	uint64_t timestamp; // captured frame timestamp (monotonic ns - see v4l2core_set_timestamp_mode)
+	uint64_t raw_timestamp; // unfiltered timestamp (driver or dequeue time)
+	uint64_t dequeue_ts; // dequeue time (monotonic ns - whatever the timestamp mode)
+	uint32_t sequence; // driver frame sequence number
+	uint32_t dropped; // frames dropped by the driver just before this one
+	uint64_t decode_start_ts; // decode start (monotonic ns)
+	uint64_t decode_end_ts; // decode end (monotonic ns - 0 if not decoded)
 	
 	uint8_t *tmp_buffer; //temporary buffer used in decoding
 	size_t tmp_buffer_max_size; //maximum size for temp buffer (bytes)
@@ -289,6 +344,11 @@ typedef struct _v4l2_device_list_t
     int num_devices;                    // number of available v4l2 devices
 } v4l2_device_list;
 
+/*
+ * video device data (opaque - one per opened device)
+ */
+typedef struct _v4l2_dev_t v4l2_dev_t;
+
 
 /*
  * ioctl with a number of retries in the case of I/O failure
@@ -316,114 +376,158 @@ int xioctl(int fd, int IOCTL_X, void *arg);
  */
 void v4l2core_set_verbosity(int level);
 
+/*
+ * set frame queue size (set before v4l2core_init_dev)
+ * args:
+ *   size - size in frames of frame queue
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_frame_queue_size(int size);
+
+/*
+ * set the number of decoder worker threads (set before v4l2core_init_dev)
+ *   frames are decoded in parallel and delivered in capture order,
+ *   this requires a frame queue size of at least 2 frames
+ * args:
+ *   nthreads - number of decoder threads (0 - decode in the capture thread)
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_decoder_threads(int nthreads);
+
+/*
+ * set the h264 decoder threading (set before v4l2core_init_dev)
+ *   h264 frames are always decoded in sequence, these are
+ *   the libav decoder threads used for each frame
+ * args:
+ *   nthreads - number of h264 decoder threads (0 - codec default)
+ *   thread_type - H264_THREAD_[AUTO|FRAME|SLICE] (AUTO - let libav choose)
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_h264_decoder_threading(int nthreads, int thread_type);
+
 /*
  * define fps values
  * args:
+ *   vd - pointer to video device data
  *   num - fps numerator
  *   denom - fps denominator
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - void
  */
-void v4l2core_define_fps(int num, int denom);
+void v4l2core_define_fps(v4l2_dev_t *vd, int num, int denom);
 
 /*
  * get requested fps numerator
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - requested fps numerator
  */
-int v4l2core_get_fps_num();
+int v4l2core_get_fps_num(v4l2_dev_t *vd);
 
 /*
  * get requested fps denominator
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - requested fps denominator
  */
-int v4l2core_get_fps_denom();
+int v4l2core_get_fps_denom(v4l2_dev_t *vd);
 
 /*
  * get device available number of formats
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - number of formats for device
  */
-int v4l2core_get_number_formats();
+int v4l2core_get_number_formats(v4l2_dev_t *vd);
 
 /*
  * sets bayer pixel order
  * args:
+ *   vd - pointer to video device data
  *   order - pixel order
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - void
  */
-void v4l2core_set_bayer_pix_order(uint8_t order);
+void v4l2core_set_bayer_pix_order(v4l2_dev_t *vd, uint8_t order);
 
 /*
  * gets bayer pixel order
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - bayer pixel order
  */
-uint8_t v4l2core_get_bayer_pix_order();
+uint8_t v4l2core_get_bayer_pix_order(v4l2_dev_t *vd);
 
 /*
  * flags bayer mode
  * args:
+ *   vd - pointer to video device data
  *   flag - 1 if we are streaming bayer data (0 otherwise)
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - void
  */
-void v4l2core_set_isbayer(uint8_t flag);
+void v4l2core_set_isbayer(v4l2_dev_t *vd, uint8_t flag);
 
 /*
  * gets bayer pixel order
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - isbayer flag
  */
-uint8_t v4l2core_get_isbayer();
+uint8_t v4l2core_get_isbayer(v4l2_dev_t *vd);
 
 /*
  * gets current device index
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns - device index
  */
-int v4l2core_get_this_device_index();
+int v4l2core_get_this_device_index(v4l2_dev_t *vd);
 
 /*
  * disable libv4l2 calls
@@ -464,122 +568,236 @@ int v4l2core_fourcc_2_v4l2_pixelformat(const char *fourcc);
 /*
  * get real fps
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: double with real fps value
  */
-double v4l2core_get_realfps();
+double v4l2core_get_realfps(v4l2_dev_t *vd);
 
 /*
  * Set v4l2 capture method
  * args:
- *   method - capture method (IO_READ or IO_MMAP)
+ *   vd - pointer to video device data
+ *   method - capture method (IO_READ, IO_MMAP, IO_USERPTR or IO_DMABUF)
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: VIDIOC_STREAMON ioctl result (E_OK or E_STREAMON_ERR)
 */
-void v4l2core_set_capture_method(int method);
+void v4l2core_set_capture_method(v4l2_dev_t *vd, int method);
+
+/*
+ * get the dma-buf file descriptor exported for the frame buffer
+ *  (only available with the IO_DMABUF capture method)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer (as returned by v4l2core_get_frame)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: dma-buf fd (owned by the core, don't close it) or -1 if none
+ */
+int v4l2core_get_dmabuf_fd(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+/*
+ * dump the raw captured frames (with timestamps) to a file
+ *   the dump can be replayed with the "replay:FILE" device
+ * args:
+ *   vd - pointer to video device data
+ *   filename - dump file name (NULL - stop dumping)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_set_raw_dump(v4l2_dev_t *vd, const char *filename);
+
+/*
+ * set the frame wait timeout (def: 1000 ms)
+ * args:
+ *   vd - pointer to video device data
+ *   timeout_ms - timeout in ms (<= 0 - wait until a frame or a wake up)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_frame_timeout(v4l2_dev_t *vd, int timeout_ms);
+
+/*
+ * set the frame timestamp mode
+ * args:
+ *   vd - pointer to video device data
+ *   mode - TS_MODE_* flags (TS_MODE_SYSTEM - dequeue time)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_timestamp_mode(v4l2_dev_t *vd, int mode);
+
+/*
+ * get the number of frames dropped by the driver since
+ *  the stream started (gaps in the buffer sequence numbers)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: dropped frames
+ */
+uint64_t v4l2core_get_dropped_frames(v4l2_dev_t *vd);
+
+/*
+ * wake up the thread waiting for frames (e.g. to act on a request
+ *  made from another thread without waiting for the next frame)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_wake(v4l2_dev_t *vd);
+
+/*
+ * get (and clear) the device events collected while waiting for frames
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: DEV_EVENT_* flags (0 - none)
+ */
+uint32_t v4l2core_get_events(v4l2_dev_t *vd);
+
+/*
+ * apply the control values changed by someone else (DEV_EVENT_CONTROL)
+ *  to the control list: call it from the thread that sets the controls
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of updated controls
+ */
+int v4l2core_update_control_values(v4l2_dev_t *vd);
 
 /*
  * Initiate video device data with default values
  * args:
  *   device - device name (e.g: "/dev/video0")
+ *     or a hardware independent frame source:
+ *     "replay:FILE[@FPS]" - replay a raw dump or a directory of jpeg files
+ *     "pattern[:WxH][@FPS]" - generated color bars
+ *     (FPS sets a fixed frame rate, 0 - as fast as possible)
  *
  * asserts:
  *   none
  *
- * returns: error code  ( < 0) on error
+ * returns: pointer to newly allocated video device data (NULL on error)
+ *   the device data must be released with v4l2core_close_dev
  */
-int v4l2core_init_dev(const char *device);
+v4l2_dev_t *v4l2core_init_dev(const char *device);
 
 /*
  * get device control list
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: pointer to first control in the list
  */
-v4l2_ctrl_t *v4l2core_get_control_list();
+v4l2_ctrl_t *v4l2core_get_control_list(v4l2_dev_t *vd);
 
 /*
  * get stream frame format list for device
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * return: pointer to first format in the list
  */
-v4l2_stream_formats_t *v4l2core_get_formats_list();
+v4l2_stream_formats_t *v4l2core_get_formats_list(v4l2_dev_t *vd);
 
 /*
  * get videodevice string
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: videodevice string
  */
-const char *v4l2core_get_videodevice();
+const char *v4l2core_get_videodevice(v4l2_dev_t *vd);
 
 /*
  * get device pan step value
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: pan step value
  */
-int v4l2core_get_pan_step();
+int v4l2core_get_pan_step(v4l2_dev_t *vd);
 
 /*
  * get device tilt step value
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: tilt step value
  */
-int v4l2core_get_tilt_step();
+int v4l2core_get_tilt_step(v4l2_dev_t *vd);
 
 /*
  * set device pan step value
  * args:
+ *    vd - pointer to video device data
  *    step - pan step value
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: none
  */
-void v4l2core_set_pan_step(int step);
+void v4l2core_set_pan_step(v4l2_dev_t *vd, int step);
 
 /*
  * set device tilt step value
  * args:
+ *    vd - pointer to video device data
  *    step -tilt step value
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: none
  */
-void v4l2core_set_tilt_step(int step);
+void v4l2core_set_tilt_step(v4l2_dev_t *vd, int step);
 
 /*
  * Initiate the device list (with udev monitoring)
@@ -621,14 +839,14 @@ int v4l2core_get_device_index(const char *videodevice);
 /*
  * check for new devices
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: true(1) if device list was updated, false(0) otherwise
  */
-int v4l2core_check_device_list_events();
+int v4l2core_check_device_list_events(v4l2_dev_t *vd);
 
 /*
  * free v4l2 devices list
@@ -645,266 +863,312 @@ void v4l2core_close_v4l2_device_list();
 /*
  * get requested frame format
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: requested frame format
  */
-int v4l2core_get_requested_frame_format();
+int v4l2core_get_requested_frame_format(v4l2_dev_t *vd);
 
 /*
  * get has_pantilt_id flag
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: has_pantilt_id flag
  */
-int v4l2core_has_pantilt_id();
+int v4l2core_has_pantilt_id(v4l2_dev_t *vd);
 
 /*
  * get has_focus_control_id flag
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: has_focus_control_id flag
  */
-int v4l2core_has_focus_control_id();
+int v4l2core_has_focus_control_id(v4l2_dev_t *vd);
 
 /*
  * get frame width
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: frame width
  */
-int v4l2core_get_frame_width();
+int v4l2core_get_frame_width(v4l2_dev_t *vd);
 
 /*
  * get frame height
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: frame height
  */
-int v4l2core_get_frame_height();
+int v4l2core_get_frame_height(v4l2_dev_t *vd);
 
 /* get frame format index from format list
  * args:
+ *   vd - pointer to video device data
  *   format - v4l2 pixel format
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: format list index or -1 if not available
  */
-int v4l2core_get_frame_format_index(int format);
+int v4l2core_get_frame_format_index(v4l2_dev_t *vd, int format);
 
 /* get resolution index for format index from format list
  * args:
+ *   vd - pointer to video device data
  *   format - format index from format list
  *   width - requested width
  *   height - requested height
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: resolution list index for format index or -1 if not available
  */
-int v4l2core_get_format_resolution_index(int format, int width, int height);
+int v4l2core_get_format_resolution_index(v4l2_dev_t *vd, int format, int width, int height);
 
 /*
  * prepare a valid format (first in the format list)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: none
  */
-void v4l2core_prepare_valid_format();
+void v4l2core_prepare_valid_format(v4l2_dev_t *vd);
 
 /*
  * prepare new format
  * args:
+ *   vd - pointer to video device data
  *   new_format - new format
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: none
  */
-void v4l2core_prepare_new_format(int new_format);
+void v4l2core_prepare_new_format(v4l2_dev_t *vd, int new_format);
 
 /*
  * prepare valid resolution (first in the resolution list for the format)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: none
  */
-void v4l2core_prepare_valid_resolution();
+void v4l2core_prepare_valid_resolution(v4l2_dev_t *vd);
 
 /*
  * prepare new resolution
  * args:
+ *   vd - pointer to video device data
  *   new_width - new width
  *   new_height - new height
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: none
  */
-void v4l2core_prepare_new_resolution(int new_width, int new_height);
+void v4l2core_prepare_new_resolution(v4l2_dev_t *vd, int new_width, int new_height);
 
 /*
  * update the current format (pixelformat, width and height)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns:
  *    error code
  */
-int v4l2core_update_current_format();
+int v4l2core_update_current_format(v4l2_dev_t *vd);
 
 /*
  * gets the next video frame (must be released after processing)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: pointer frame buffer (NULL on error)
  */
-v4l2_frame_buff_t *v4l2core_get_frame();
+v4l2_frame_buff_t *v4l2core_get_frame(v4l2_dev_t *vd);
 
 /*
  * releases the video frame (so that it can be reused by the driver)
+ *  the frame is only recycled when the last reference is released
  * args:
+ *   vd - pointer to video device data
  *   frame - pointer to decoded frame buffer
  *
  * asserts:
- *   none
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+/*
+ * get an extra reference to the frame (e.g. to hand it over to
+ *  another thread without copying the frame data); each reference
+ *  must be dropped with v4l2core_release_frame
+ *  it fails if holding the frame would starve the capture
+ *  (at least one frame in queue and two driver buffers must stay free)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer (already owned by the caller)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: error code (E_OK or E_NO_DATA if the frame can't be held)
+ */
+int v4l2core_frame_ref(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+/*
+ * make the decoded frame writable without touching the raw frame
+ *  (e.g. before applying render fx): a zero copy frame (yuv_frame
+ *  pointing to raw_frame) gets its data copied to its own yuv buffer,
+ *  so raw recordings, raw snapshots and raw dumps stay unchanged
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to decoded frame buffer
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
  *
  * returns: error code (E_OK)
  */
-int v4l2core_release_frame(v4l2_frame_buff_t *frame);
+int v4l2core_frame_detach_raw(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
 
 /*
  * gets the next video frame and decodes it
  * args:
- *    none
+ *    vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
  *
  * returns: pointer to decoded frame buffer ( NULL on error)
  */
-v4l2_frame_buff_t *v4l2core_get_decoded_frame();
+v4l2_frame_buff_t *v4l2core_get_decoded_frame(v4l2_dev_t *vd);
 
 /*
  * clean v4l2 buffers
+ *  waits for the frames still referenced (v4l2core_frame_ref)
+ *  to be released, so the caller must not hold any frame
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: none
  */
-void v4l2core_clean_buffers();
+void v4l2core_clean_buffers(v4l2_dev_t *vd);
 
 /*
  * cleans video device data and allocations
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: void
  */
-void v4l2core_close_dev();
+void v4l2core_close_dev(v4l2_dev_t *vd);
 
 /*
  * request a fps update
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: none
  */
-void v4l2core_request_framerate_update();
+void v4l2core_request_framerate_update(v4l2_dev_t *vd);
 
 /*
  * gets video device defined frame rate (not real - consider it a maximum value)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: VIDIOC_G_PARM ioctl result value
  * (sets vd->fps_denom and vd->fps_num to device value)
  */
-int v4l2core_get_framerate ();
+int v4l2core_get_framerate (v4l2_dev_t *vd);
 
 /*
  * Starts the video stream
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: VIDIOC_STREAMON ioctl result (0- E_OK)
  */
-int v4l2core_start_stream();
+int v4l2core_start_stream(v4l2_dev_t *vd);
 
 /*
  * request video stream to stop
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code (0 -OK)
 */
-int v4l2core_request_stop_stream();
+int v4l2core_request_stop_stream(v4l2_dev_t *vd);
 
 /*
  * Stops the video stream
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: VIDIOC_STREAMOFF ioctl result (0- E_OK)
  */
-int v4l2core_stop_stream();
+int v4l2core_stop_stream(v4l2_dev_t *vd);
 
 /*
  *  ######### CONTROLS ##########
@@ -913,51 +1177,54 @@ int v4l2core_stop_stream();
 /*
  * return the control associated to id from device list
  * args:
+ *   vd - pointer to video device data
  *   id - control id
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: pointer to v4l2_control if succeded or null otherwise
  */
-v4l2_ctrl_t* v4l2core_get_control_by_id(int id);
+v4l2_ctrl_t* v4l2core_get_control_by_id(v4l2_dev_t *vd, int id);
 
 /*
  * sets the value of control id in device
  * args:
+ *  vd - pointer to video device data
  *  id - control id 
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: ioctl result
  */
-int v4l2core_set_control_value_by_id(int id);
+int v4l2core_set_control_value_by_id(v4l2_dev_t *vd, int id);
 
 /*
  * updates the value for control id from the device
  * also updates control flags
  * args:
+ *   vd - pointer to video device data
  *   id - control id
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: ioctl result
  */
-int v4l2core_get_control_value_by_id(int id);
+int v4l2core_get_control_value_by_id(v4l2_dev_t *vd, int id);
 
 /*
  * goes trough the control list and sets values in device to default
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: void
  */
-void v4l2core_set_control_defaults();
+void v4l2core_set_control_defaults(v4l2_dev_t *vd);
 
 /*
  * set autofocus sort method
@@ -974,75 +1241,79 @@ void v4l2core_soft_autofocus_set_sort(int method);
 /*
  * initiate software autofocus
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: error code (0 - E_OK)
  */
-int v4l2core_soft_autofocus_init ();
+int v4l2core_soft_autofocus_init (v4l2_dev_t *vd);
 
 /*
  * run the software autofocus
  * args:
+ *    vd - pointer to video device data
  *    frame - pointer to frame buffer
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: 1 - running  0- focused
  * 	(only matters for non-continue focus)
  */
-int v4l2core_soft_autofocus_run(v4l2_frame_buff_t *frame);
+int v4l2core_soft_autofocus_run(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
 
 /*
  * sets a focus loop while autofocus is on
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
+ *    vd is not null
  *    focus_ctx is not null
  *
  * returns: none
  */
-void v4l2core_soft_autofocus_set_focus();
+void v4l2core_soft_autofocus_set_focus(v4l2_dev_t *vd);
 
 /*
  * close and clean software autofocus
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: none
  */
-void v4l2core_soft_autofocus_close();
+void v4l2core_soft_autofocus_close(v4l2_dev_t *vd);
 
 /*
  * save the device control values into a profile file
  * args:
+ *   vd - pointer to video device data
  *   filename - profile filename
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code (0 -E_OK)
  */
-int v4l2core_save_control_profile(const char *filename);
+int v4l2core_save_control_profile(v4l2_dev_t *vd, const char *filename);
 
 /*
  * load the device control values from a profile file
  * args:
+ *   vd - pointer to video device data
  *   filename - profile filename
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code (0 -E_OK)
  */
-int v4l2core_load_control_profile(const char *filename);
+int v4l2core_load_control_profile(v4l2_dev_t *vd, const char *filename);
 
 /*
  * ########### H264 controls ###########
@@ -1051,136 +1322,142 @@ int v4l2core_load_control_profile(const char *filename);
 /*
  * resets the h264 encoder
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
+ *   vd is not null
  *   nonel
  *
  * returns: 0 on success or error code on fail
  */
-int v4l2core_reset_h264_encoder();
+int v4l2core_reset_h264_encoder(v4l2_dev_t *vd);
 
 /*
  * get h264 unit id
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
+ *   vd is not null
  *   nonel
  *
  * returns: unit id on success or error code ( < 0 ) on fail
  */
-int v4l2core_get_h264_unit_id();
+int v4l2core_get_h264_unit_id(v4l2_dev_t *vd);
 
 /*
  * get PPS NALU size
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: PPS size
  */
-int v4l2core_get_h264_pps_size();
+int v4l2core_get_h264_pps_size(v4l2_dev_t *vd);
 
 /*
  * get PPS data
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: pointer to PPS data
  */
-uint8_t *v4l2core_get_h264_pps();
+uint8_t *v4l2core_get_h264_pps(v4l2_dev_t *vd);
 
 /*
  * get SPS NALU size
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: SPS size
  */
-int v4l2core_get_h264_sps_size();
+int v4l2core_get_h264_sps_size(v4l2_dev_t *vd);
 
 /*
  * get SPS data
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: pointer to SPS data
  */
-uint8_t *v4l2core_get_h264_sps();
+uint8_t *v4l2core_get_h264_sps(v4l2_dev_t *vd);
 
 /*
  * request a IDR frame from the H264 encoder
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: none
  */
-void v4l2core_h264_request_idr();
+void v4l2core_h264_request_idr(v4l2_dev_t *vd);
 
 /*
  * query the frame rate config
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: frame rate config (FIXME: 0xffffffff on error)
  */
-uint32_t v4l2core_query_h264_frame_rate_config(uint8_t query);
+uint32_t v4l2core_query_h264_frame_rate_config(v4l2_dev_t *vd, uint8_t query);
 
 /*
  * get the frame rate config
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: frame rate config (FIXME: 0xffffffff on error)
  */
-uint32_t v4l2core_get_h264_frame_rate_config();
+uint32_t v4l2core_get_h264_frame_rate_config(v4l2_dev_t *vd);
 
 /*
  * set the frame rate config
  * args:
+ *   vd - pointer to video device data
  *   framerate - framerate
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_frame_rate_config(uint32_t framerate);
+int v4l2core_set_h264_frame_rate_config(v4l2_dev_t *vd, uint32_t framerate);
 
 /*
  * updates the h264_probe_commit_req field
  * args:
+ *   vd - pointer to video device data
  *   query - (UVC_GET_CUR; UVC_GET_MAX; UVC_GET_MIN)
  *   config_probe_req - pointer to uvcx_video_config_probe_commit_t:
  *     if null vd->h264_config_probe_req will be used
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
 int v4l2core_probe_h264_config_probe_req(
+			v4l2_dev_t *vd,
 			uint8_t query,
 			uvcx_video_config_probe_commit_t *config_probe_req);
 
@@ -1188,110 +1465,135 @@ int v4l2core_probe_h264_config_probe_req(
 /*
  * gets the current h264_config_probe_req data struct
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: pointer to current h264_config_probe_req data struct
  */
-uvcx_video_config_probe_commit_t *v4l2core_get_h264_config_probe_req();
+uvcx_video_config_probe_commit_t *v4l2core_get_h264_config_probe_req(v4l2_dev_t *vd);
 
 /*
  * flag core to use the preset h264_config_probe_req data (don't reset to default before commit)
  * args:
+ *   vd - pointer to video device data
  *   flag - value to set
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: none
  */
-void v4l2core_set_h264_no_probe_default(uint8_t flag);
+void v4l2core_set_h264_no_probe_default(v4l2_dev_t *vd, uint8_t flag);
 
 /*
  * get h264_no_probe_default flag
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: h264_no_probe_default flag
  */
-uint8_t v4l2core_get_h264_no_probe_default();
+uint8_t v4l2core_get_h264_no_probe_default(v4l2_dev_t *vd);
+
+/*
+ * flag core to decode (or not) the h264 frames
+ *   when nothing uses the decoded frame (no render, snapshot, autofocus
+ *   or video re-encoding) decoding can be skipped, frames are still
+ *   demuxed and their yuv_frame is left untouched (decode_end_ts = 0).
+ *   Decoding resumes on the next IDR frame (a new IDR is requested),
+ *   frames before it are not decoded either (decode_end_ts = 0)
+ * args:
+ *   vd - pointer to video device data
+ *   flag - 1 decode (default), 0 skip decoding
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_h264_decode(v4l2_dev_t *vd, uint8_t flag);
 
 /*
  * get the video rate control mode
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: video rate control mode (FIXME: 0xff on error)
  */
-uint8_t v4l2core_get_h264_video_rate_control_mode(uint8_t query);
+uint8_t v4l2core_get_h264_video_rate_control_mode(v4l2_dev_t *vd, uint8_t query);
 
 /*
  * set the video rate control mode
  * args:
+ *   vd - pointer to video device data
  *   mode - rate mode
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_video_rate_control_mode(uint8_t mode);
+int v4l2core_set_h264_video_rate_control_mode(v4l2_dev_t *vd, uint8_t mode);
 
 /*
  * get the temporal scale mode
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: temporal scale mode (FIXME: 0xff on error)
  */
-uint8_t v4l2core_get_h264_temporal_scale_mode(uint8_t query);
+uint8_t v4l2core_get_h264_temporal_scale_mode(v4l2_dev_t *vd, uint8_t query);
 
 /*
  * set the temporal scale mode
  * args:
+ *   vd - pointer to video device data
  *   mode - temporal scale mode
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_temporal_scale_mode(uint8_t mode);
+int v4l2core_set_h264_temporal_scale_mode(v4l2_dev_t *vd, uint8_t mode);
 
 /*
  * get the spatial scale mode
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: temporal scale mode (FIXME: 0xff on error)
  */
-uint8_t v4l2core_get_h264_spatial_scale_mode(uint8_t query);
+uint8_t v4l2core_get_h264_spatial_scale_mode(v4l2_dev_t *vd, uint8_t query);
 
 /*
  * set the spatial scale mode
  * args:
+ *   vd - pointer to video device data
  *   mode - spatial scale mode
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_spatial_scale_mode(uint8_t mode);
+int v4l2core_set_h264_spatial_scale_mode(v4l2_dev_t *vd, uint8_t mode);
 
 /*
  *  ######### XU CONTROLS ##########
@@ -1300,43 +1602,46 @@ int v4l2core_set_h264_spatial_scale_mode(uint8_t mode);
 /*
  * get lenght of xu control defined by unit id and selector
  * args:
+ *   vd - pointer to video device data
  *   unit - unit id of xu control
  *   selector - selector for control
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: length of xu control
  */
-uint16_t v4l2core_get_length_xu_control(uint8_t unit, uint8_t selector);
+uint16_t v4l2core_get_length_xu_control(v4l2_dev_t *vd, uint8_t unit, uint8_t selector);
 
 /*
  * get uvc info for xu control defined by unit id and selector
  * args:
+ *   vd - pointer to video device data
  *   unit - unit id of xu control
  *   selector - selector for control
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: info of xu control
  */
-uint8_t v4l2core_get_info_xu_control(uint8_t unit, uint8_t selector);
+uint8_t v4l2core_get_info_xu_control(v4l2_dev_t *vd, uint8_t unit, uint8_t selector);
 
 /*
  * runs a query on xu control defined by unit id and selector
  * args:
+ *   vd - pointer to video device data
  *   unit - unit id of xu control
  *   selector - selector for control
  *   query - query type
  *   data - pointer to query data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: 0 if query succeded or errno otherwise
  */
-int v4l2core_query_xu_control(uint8_t unit, uint8_t selector, uint8_t query, void *data);
+int v4l2core_query_xu_control(v4l2_dev_t *vd, uint8_t unit, uint8_t selector, uint8_t query, void *data);
 
 /*
  *  ########### FILE IO ###############
@@ -1358,17 +1663,173 @@ int v4l2core_save_data_to_file(const char *filename, uint8_t *data, int size);
 /*
  * save the current frame to file
  * args:
+ *    vd - pointer to video device data
  *    frame - pointer to frame buffer
  *    filename - output file name
  *    format - image type
  *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: error code
  */
-int v4l2core_save_image(v4l2_frame_buff_t *frame, const char *filename, int format);
+int v4l2core_save_image(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename, int format);
+
+/*
+ * snapshot done callback (error is E_NO_DATA if the snapshot was dropped)
+ */
+typedef void (*snapshot_done_cb_t)(const char *filename, int error, void *data);
+
+/*
+ * start the snapshot worker pool: images are copied into a bounded
+ *  queue by v4l2core_snapshot_queue and saved in the background
+ * args:
+ *   vd - pointer to video device data
+ *   workers - number of worker threads (<= 0 - one)
+ *   queue_size - max queued snapshots (<= 0 - 2 x workers)
+ *   policy - full queue policy: SNAPSHOT_DROP_OLDEST, SNAPSHOT_BLOCK or SNAPSHOT_SKIP
+ *   callback - called when a snapshot is saved or dropped (can be NULL)
+ *          saved - from a worker thread; dropped - from the queueing thread
+ *   data - callback user data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_snapshot_start(
+	v4l2_dev_t *vd,
+	int workers,
+	int queue_size,
+	int policy,
+	snapshot_done_cb_t callback,
+	void *data);
+
+/*
+ * queue a copy of the frame to be saved by the snapshot workers
+ *  (saves it right away if the worker pool is not running)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to (decoded) frame buffer
+ *   filename - output file name
+ *   format - image type (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *   filename is not null
+ *
+ * returns: error code (E_OK or E_NO_DATA if skipped - full queue)
+ */
+int v4l2core_snapshot_queue(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename, int format);
+
+/*
+ * grow the snapshot queue to hold nframes and preallocate the frame
+ *  buffers for the current format, so a burst of nframes consecutive
+ *  frames is queued without blocking or allocating
+ * args:
+ *   vd - pointer to video device data
+ *   nframes - number of frames to reserve
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK or E_NO_DATA if the worker pool is not running)
+ */
+int v4l2core_snapshot_reserve(v4l2_dev_t *vd, int nframes);
+
+/*
+ * get the number of snapshots queued or being saved
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pending snapshots
+ */
+int v4l2core_snapshot_pending(v4l2_dev_t *vd);
+
+/*
+ * stop the snapshot worker pool (pending snapshots are saved first)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_snapshot_stop(v4l2_dev_t *vd);
+
+/*
+ * ############### JPEG ENCODER ##############
+ */
+
+/*default jpeg encoder quality [1 - 100]*/
+#define JPEG_ENCODER_DEF_QUALITY (85)
+
+typedef struct _jpeg_encoder_context_t jpeg_encoder_context_t;
+
+/*
+ * create a jpeg encoder context (reentrant, one per encoding thread)
+ * args:
+ *    width - image width
+ *    height - image height
+ *    format - input format: V4L2_PIX_FMT_YUV420 (coded as 4:2:0)
+ *             or V4L2_PIX_FMT_YUYV (coded as 4:2:2)
+ *    quality - jpeg quality [1 - 100] (<= 0 - JPEG_ENCODER_DEF_QUALITY)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to encoder context (NULL on error)
+ */
+jpeg_encoder_context_t *v4l2core_jpeg_encoder_create(int width, int height, int format, int quality);
+
+/*
+ * set the number of threads coding slices (mcu rows)
+ *  (defaults to the number of cores, must not be called while encoding)
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *    nthreads - number of threads [1 - 8]
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+void v4l2core_jpeg_encoder_set_threads(jpeg_encoder_context_t *jpeg_ctx, int nthreads);
+
+/*
+ * encode a frame
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *    in_buf - pointer to input frame (context format)
+ *    out_buf - pointer to output buffer (jpeg)
+ *    out_size - output buffer size
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *    in_buf is not null
+ *    out_buf is not null
+ *
+ * returns: jpeg size or error code (E_NO_DATA - out_buf too small)
+ */
+int v4l2core_jpeg_encode(jpeg_encoder_context_t *jpeg_ctx, uint8_t *in_buf, uint8_t *out_buf, int out_size);
+
+/*
+ * destroy a jpeg encoder context
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void v4l2core_jpeg_encoder_destroy(jpeg_encoder_context_t *jpeg_ctx);
 
 /*
  * ############### TIME DATA ##############
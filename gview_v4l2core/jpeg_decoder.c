@@ -38,7 +38,10 @@
 #include <assert.h>
 
 #include "gviewv4l2core.h"
+#include "v4l2_core.h"
 #include "colorspaces.h"
+#include "colorspaces_simd.h"
+#include "core_time.h"
 #include "jpeg_decoder.h"
 #include "gview.h"
 #include "../config.h"
@@ -110,20 +113,6 @@ const uint8_t jpeg_huffman_table[JPG_HUFFMAN_TABLE_LENGTH] =
 	0xF9, 0xFA
 };
 
-typedef struct _jpeg_decoder_context_t
-{
-	void *codec_data;
-
-	int width;
-	int height;
-	int pic_size;
-	
-	uint8_t *tmp_frame; //temp frame buffer
-	
-} jpeg_decoder_context_t;
-
-static jpeg_decoder_context_t *jpeg_ctx = NULL;
-
 #if MJPG_BUILTIN //use internal jpeg decoder
 
 #define ISHIFT 11
@@ -186,6 +175,12 @@ static uint8_t zig[64] = {
     35, 36, 48, 49, 57, 58, 62, 63
 };
 
+/*AAN scale factors (cos(k*pi/16) * sqrt(2)) used by the float idct*/
+static const float aanscale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
 /*coef used in idct*/
 static PREC aaidct[8] = {
     IFIX(0.3535533906), IFIX(0.4903926402),
@@ -201,12 +196,13 @@ struct jpeg_decdata
 {
 	int dcts[6 * 64 + 16];
 	int out[64 * 6];
-	int dquant[3][64];
+	int max[6];
 };
 
 struct in
 {
 	uint8_t *p;
+	uint8_t *end;		/* end of the compressed data */
 	uint32_t bits;
 	int left;
 	int marker;
@@ -268,17 +264,8 @@ struct jpginfo
 	int rm;			/* next restart marker */
 };
 
-static struct jpginfo info;
-static struct comp comps[MAXCOMP];
-
-static struct scan dscans[MAXCOMP];
-
-static uint8_t quant[4][64];
-
-static struct dec_hufftbl dhuff[4];
-
-#define dec_huffdc (dhuff + 0)
-#define dec_huffac (dhuff + 2)
+#define dec_huffdc(dhuff) (dhuff + 0)
+#define dec_huffac(dhuff) (dhuff + 2)
 
 /*
  * build huffman data
@@ -352,17 +339,21 @@ static void dec_makehuff(struct dec_hufftbl *hu, int *hufflen, uint8_t *huffvals
 }
 
 /*
- * huffman decoder initialization
+ * huffman decoder initialization (default MJPG tables)
  * args:
- *    none
+ *    dhuff - pointer to the 4 huffman tables to build
  *
  * asserts:
- *    none
+ *    dhuff not null
  *
  * returns: error code (0 - OK)
  */
-static int huffman_init(void)
+static int huffman_init(struct dec_hufftbl *dhuff)
 {
+	/*asserts*/
+	assert(dhuff != NULL);
+
+
 	uint8_t *ptr= (uint8_t *) jpeg_huffman_table ;
 	int i, j, l;
 	l = JPG_HUFFMAN_TABLE_LENGTH ;
@@ -417,8 +408,26 @@ static int fillbits(struct in *inp, int le, unsigned int bi)
 	}
 	while (le <= 24)
 	{
+		if (inp->p >= inp->end)
+		{
+			/*out of data: pad with zeros as if a marker was found*/
+			inp->marker = M_EOF;
+			if (le <= 16)
+				bi = bi << 16, le += 16;
+			break;
+		}
+
 		int b = *inp->p++;
 		int m = 0;
+
+		/*a trailing 0xff has no marker byte: out of data*/
+		if (b == 0xff && inp->p >= inp->end)
+		{
+			inp->marker = M_EOF;
+			if (le <= 16)
+				bi = bi << 16, le += 16;
+			break;
+		}
 		
 		if (b == 0xff && (m = *inp->p++) != 0)
 		{
@@ -549,18 +558,20 @@ static int dec_readmarker(struct in *inp)
  * args:
  *    inp - pointer to struct in
  *    p - pointer to pixel data
+ *    end - pointer to the end of the pixel data
  *
  * asserts:
  *    inp not null
  *
  * returns: error code (0 - OK)
  */
-static void setinput(struct in *inp, uint8_t *p)
+static void setinput(struct in *inp, uint8_t *p, uint8_t *end)
 {
 	/*asserts*/
 	assert(inp != NULL);
 
 	inp->p = p;
+	inp->end = end;
 	inp->left = 0;
 	inp->bits = 0;
 	inp->marker = 0;
@@ -579,6 +590,19 @@ static void idctqtab(uint8_t *qin, PREC *qout)
 				IMULT(aaidct[i], aaidct[j]);
 }
 
+/*
+ * float IDCT quantization table (natural order, AAN prescaled)
+ */
+static void idctqtab_float(uint8_t *qin, float *qout)
+{
+	int i, j;
+
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < 8; j++)
+			qout[i * 8 + j] = qin[zig[i * 8 + j]] *
+				aanscale[i] * aanscale[j] / 8;
+}
+
 /****************************************************************/
 /**************             idct                  ***************/
 /****************************************************************/
@@ -748,62 +772,151 @@ inline static void idct(int *inp, int *out, int *quant, long off, int max)
 /*********************************/
 //static void col221111 __P((int *, unsigned char *, int));
 
+#ifdef USE_PLANAR_YUV
+typedef void (*ftopict) (int * out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width) ;
+#define CONVERT_420 yuv420p_to_yu12_mcu
+#define CONVERT_422 yuv422p_to_yu12_mcu
+#define CONVERT_444 yuv444p_to_yu12_mcu
+#define CONVERT_400 yuv400p_to_yu12_mcu
+#else
 typedef void (*ftopict) (int * out, uint8_t *pic, int width) ;
+#define CONVERT_420 yuv420pto422
+#define CONVERT_422 yuv422pto422
+#define CONVERT_444 yuv444pto422
+#define CONVERT_400 yuv400pto422
+#endif
+
+typedef void (*fidct) (int *out, const int *in, const uint8_t *zz, const float *fquant, float off) ;
+
+struct _builtin_data_t;
 
-/*********************************/
 /*
- * pointer to pixel data
+ * restart interval worker
  */
-static uint8_t *datap;
+typedef struct _jpeg_worker_t
+{
+	__THREAD_TYPE thread;
+	struct _builtin_data_t *data;
+
+	struct in inp;                /* private bitstream reader */
+	struct scan dscans[MAXCOMP];  /* private scans (dc predictors) */
+	struct jpeg_decdata decdata;  /* private mcu scratch */
+
+	int first;                    /* first restart interval to decode */
+	int last;                     /* last restart interval (not included) */
+	uint32_t job;                 /* last job handled */
+	int status;                   /* error code of the last job (0 - OK) */
+
+	/*stage times (only if profiling)*/
+	uint64_t entropy_ns;
+	uint64_t idct_ns;
+	uint64_t output_ns;
+} jpeg_worker_t;
 
 /*
- * input structure (in)
+ * builtin decoder data (one per decoder context)
  */
-static struct in inp;
+typedef struct _builtin_data_t
+{
+	struct jpginfo info;
+	struct comp comps[MAXCOMP];
+	struct scan dscans[MAXCOMP];
+
+	uint8_t quant[4][64];
+	int dquant[3][64];
+	float fquant[3][64];              /* dequantization for the simd idct */
+	fidct simd_idct;                  /* simd idct (NULL if not available) */
+
+	struct dec_hufftbl dhuff[4];      /* tables from DHT */
+	struct dec_hufftbl def_dhuff[4];  /* default tables (MJPG frames without DHT) */
 
+	uint8_t *datap;                   /* pointer to compressed data */
+	uint8_t *data_end;                /* end of compressed data */
+
+	/*frame geometry*/
+	int width;
+	int height;
+	int mb;
+	int mcu_w;
+	int mcu_h;
+	int mcusx;
+	int mcusy;
+	int pitch;
+	int xpitch;
+	int ypitch;
+	ftopict convert;
+	uint8_t *out_buf;
+
+	/*restart intervals*/
+	int max_intervals;
+	uint8_t **rst_start;
+	uint8_t **rst_end;
+
+	/*worker pool - workers[0] is the calling thread*/
+	jpeg_worker_t *workers;
+	int nrunning;                     /* running worker threads */
+	__MUTEX_TYPE mutex;
+	__COND_TYPE cond_job;
+	__COND_TYPE cond_done;
+	uint32_t job;
+	int pending;
+	int quit;
+
+	/*stats*/
+	int profile;                      /* time the decoding stages */
+	uint32_t frames_serial;
+	uint32_t frames_parallel;
+	uint64_t decode_ns;
+} builtin_data_t;
 
 /*
  * get byte (8 bit) from datap
  */
-static int getbyte(void)
+static int getbyte(builtin_data_t *data)
 {
-	return *datap++;
+	if (data->datap >= data->data_end)
+		return 0;
+	return *data->datap++;
 }
 
 /*
  * get word (16 bit) from datap
  */
-static int getword(void)
+static int getword(builtin_data_t *data)
 {
 	int c1, c2;
-	c1 = *datap++;
-	c2 = *datap++;
+	c1 = getbyte(data);
+	c2 = getbyte(data);
 	return c1 << 8 | c2;
 }
 
 /*
  * read jpeg tables (huffman and quantization)
  * args:
+ *    data - pointer to builtin decoder data
  *    till - Marker (frame - SOF0   scan - SOS)
  *    isDHT - flag indicating the presence of huffman tables (if 0 must use default ones - MJPG frame)
  * asserts:
- *    none
+ *    data not null
  *
  * returns: error code (0 - OK)
  */
-static int readtables(int till, int *isDHT)
+static int readtables(builtin_data_t *data, int till, int *isDHT)
 {
+	/*asserts*/
+	assert(data != NULL);
+
 	int l, i, j, lq, pq, tq;
 	int tc, th, tt;
 
 	for (;;)
 	{
-		if (getbyte() != 0xff)
+		if (getbyte(data) != 0xff)
 			return -1;
-		
+
 		int m = 0;
 
-		if ((m = getbyte()) == till)
+		if ((m = getbyte(data)) == till)
 			break;
 
 		switch (m)
@@ -812,10 +925,10 @@ static int readtables(int till, int *isDHT)
 				return 0;
 			/*read quantization tables (Lqt and Cqt)*/
 			case M_DQT:
-				lq = getword();
+				lq = getword(data);
 				while (lq > 2)
 				{
-					pq = getbyte();
+					pq = getbyte(data);
 					/*Lqt=0x00   Cqt=0x01*/
 					tq = pq & 15;
 					if (tq > 3)
@@ -824,50 +937,62 @@ static int readtables(int till, int *isDHT)
 					if (pq != 0)
 					return -1;
 					for (i = 0; i < 64; i++)
-						quant[tq][i] = getbyte();
+						data->quant[tq][i] = getbyte(data);
 					lq -= 64 + 1;
 				}
 				break;
 			/*read huffman table*/
 			case M_DHT:
-				l = getword();
+				l = getword(data);
 				while (l > 2)
 				{
 					int hufflen[16], k;
 					uint8_t huffvals[256];
 
-					tc = getbyte();
+					tc = getbyte(data);
 					th = tc & 15;
 					tc >>= 4;
 					tt = tc * 2 + th;
 					if (tc > 1 || th > 1)
 					return -1;
 
-					for (i = 0; i < 16; i++)
-						hufflen[i] = getbyte();
+					/*
+					 * there are at most 256 symbols (huffvals size) and
+					 * no more codes of each length than the length allows
+					 */
+					int code = 0;
+					k = 0;
+					for (i = 0; i < 16; i++, code <<= 1)
+					{
+						hufflen[i] = getbyte(data);
+						k += hufflen[i];
+						code += hufflen[i];
+						if (k > 256 || code > (2 << i))
+							return -1;
+					}
 					l -= 1 + 16;
 					k = 0;
 					for (i = 0; i < 16; i++)
 					{
 						for (j = 0; j < hufflen[i]; j++)
-							huffvals[k++] = getbyte();
+							huffvals[k++] = getbyte(data);
 						l -= hufflen[i];
 					}
-					dec_makehuff(dhuff + tt, hufflen, huffvals);
+					dec_makehuff(data->dhuff + tt, hufflen, huffvals);
 				}
 				/* has huffman tables defined (JPEG)*/
 				*isDHT= 1;
 				break;
 			/*restart interval*/
 			case M_DRI:
-				l = getword();
-				info.dri = getword();
+				l = getword(data);
+				data->info.dri = getword(data);
 				break;
 
 			default:
-				l = getword();
+				l = getword(data);
 				while (l-- > 2)
-					getbyte();
+					getbyte(data);
 				break;
 		}
 	}
@@ -877,43 +1002,50 @@ static int readtables(int till, int *isDHT)
 /*
  * init dscans
  * args:
- *    none
+ *    data - pointer to builtin decoder data
  *
  * asserts:
- *    none
+ *    data not null
  *
  * returns: none
  */
-static void dec_initscans(void)
+static void dec_initscans(builtin_data_t *data)
 {
+	/*asserts*/
+	assert(data != NULL);
+
 	int i;
 
-	info.nm = info.dri + 1;
-	info.rm = M_RST0;
-	for (i = 0; i < info.ns; i++)
-		dscans[i].dc = 0;
+	data->info.nm = data->info.dri + 1;
+	data->info.rm = M_RST0;
+	for (i = 0; i < data->info.ns; i++)
+		data->dscans[i].dc = 0;
 }
 
 /*
  * check markers
  * args:
- *    none
+ *    data - pointer to builtin decoder data
+ *    inp - pointer to struct in
  *
  * asserts:
- *    none
+ *    data not null
  *
  * returns: error code (0 - OK)
  */
-static int dec_checkmarker(void)
+static int dec_checkmarker(builtin_data_t *data, struct in *inp)
 {
+	/*asserts*/
+	assert(data != NULL);
+
 	int i;
 
-	if (dec_readmarker(&inp) != info.rm)
+	if (dec_readmarker(inp) != data->info.rm)
 		return -1;
-	info.nm = info.dri;
-	info.rm = (info.rm + 1) & ~0x08;
-	for (i = 0; i < info.ns; i++)
-		dscans[i].dc = 0;
+	data->info.nm = data->info.dri;
+	data->info.rm = (data->info.rm + 1) & ~0x08;
+	for (i = 0; i < data->info.ns; i++)
+		data->dscans[i].dc = 0;
 	return 0;
 }
 
@@ -965,384 +1097,768 @@ static int dec_rec2(struct in *inp, struct dec_hufftbl *hu, int *runp, int c, in
 }
 
 /*
- * init (m)jpeg decoder context
+ * idct a single block (simd if available)
  * args:
- *    width - image width
- *    height - image height
+ *    data - pointer to builtin decoder data
+ *    in - pointer to block coefficients (zigzag order)
+ *    out - pointer to idct output
+ *    tbl - quantization table (0 - luma, 1 - u, 2 - v)
+ *    max - maximum input mcu index (1 - only DC)
  *
  * asserts:
  *    none
  *
- * returns: error code (0 - E_OK)
+ * returns: none
  */
-int jpeg_init_decoder(int width, int height)
+static inline void idct_block(builtin_data_t *data, int *in, int *out, int tbl, int max)
 {
-	if(jpeg_ctx != NULL)
-		jpeg_close_decoder();
+	if (max != 1 && data->simd_idct != NULL)
+		data->simd_idct(out, in, zig, data->fquant[tbl], tbl ? 0.0f : 128.0f);
+	else
+		idct(in, out, data->dquant[tbl], tbl ? IFIX(0.5) : IFIX(128.5), max);
+}
 
-	jpeg_ctx = calloc(1, sizeof(jpeg_decoder_context_t));
-	if(jpeg_ctx == NULL)
+/*
+ * decode a single mcu and convert it to the output format
+ * args:
+ *    data - pointer to builtin decoder data
+ *    worker - pointer to worker data (mcu scratch and stats)
+ *    inp - pointer to struct in
+ *    sc - pointer to scans (with dc predictors)
+ *    mx - mcu column
+ *    my - mcu row
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void decode_mcu(builtin_data_t *data, jpeg_worker_t *worker,
+	struct in *inp, struct scan *sc, int mx, int my)
+{
+	struct jpeg_decdata *decdata = &worker->decdata;
+	int *max = decdata->max;
+	uint64_t t0 = 0, t1 = 0, t2 = 0;
+
+	if (data->profile)
+		t0 = ns_time_monotonic();
+
+	decode_mcus(inp, decdata->dcts, data->mb, sc, max);
+
+	if (data->profile)
+		t1 = ns_time_monotonic();
+
+	switch (data->mb)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
-		exit(-1);
+		case 6:
+			idct_block(data, decdata->dcts, decdata->out, 0, max[0]);
+			idct_block(data, decdata->dcts + 64, decdata->out + 64, 0, max[1]);
+			idct_block(data, decdata->dcts + 128, decdata->out + 128, 0, max[2]);
+			idct_block(data, decdata->dcts + 192, decdata->out + 192, 0, max[3]);
+			idct_block(data, decdata->dcts + 256, decdata->out + 256, 1, max[4]);
+			idct_block(data, decdata->dcts + 320, decdata->out + 320, 2, max[5]);
+			break;
+
+		case 4:
+			idct_block(data, decdata->dcts, decdata->out, 0, max[0]);
+			idct_block(data, decdata->dcts + 64, decdata->out + 64, 0, max[1]);
+			idct_block(data, decdata->dcts + 128, decdata->out + 256, 1, max[2]);
+			idct_block(data, decdata->dcts + 192, decdata->out + 320, 2, max[3]);
+			break;
+
+		case 3:
+			idct_block(data, decdata->dcts, decdata->out, 0, max[0]);
+			idct_block(data, decdata->dcts + 64, decdata->out + 256, 1, max[1]);
+			idct_block(data, decdata->dcts + 128, decdata->out + 320, 2, max[2]);
+			break;
+
+		case 1:
+			idct_block(data, decdata->dcts, decdata->out, 0, max[0]);
+			break;
+	} // switch enc411
+
+	if (data->profile)
+		t2 = ns_time_monotonic();
+
+#ifdef USE_PLANAR_YUV
+	int width = data->width;
+	uint8_t *py = data->out_buf + my * data->mcu_h * width + mx * data->mcu_w;
+	uint8_t *pu = data->out_buf + width * data->height +
+		(my * data->mcu_h / 2) * (width / 2) + mx * data->mcu_w / 2;
+	uint8_t *pv = pu + (width * data->height) / 4;
+	data->convert(decdata->out, py, pu, pv, width); //convert to yu12
+#else
+	data->convert(decdata->out,
+		data->out_buf + my * data->ypitch + mx * data->xpitch, data->pitch); //convert to 422
+#endif
+
+	if (data->profile)
+	{
+		worker->entropy_ns += t1 - t0;
+		worker->idct_ns += t2 - t1;
+		worker->output_ns += ns_time_monotonic() - t2;
 	}
-	
-	jpeg_ctx->width = width;
-	jpeg_ctx->height = height;
-	jpeg_ctx->pic_size = width * height * 2; //yuyv
-	jpeg_ctx->codec_data = NULL;
-	
-	jpeg_ctx->tmp_frame = calloc(jpeg_ctx->pic_size, sizeof(uint8_t));
-	if(jpeg_ctx->tmp_frame == NULL)
+}
+
+/*
+ * find the restart intervals in the entropy coded data
+ * args:
+ *    data - pointer to builtin decoder data
+ *    nintervals - expected number of restart intervals
+ *
+ * asserts:
+ *    data not null
+ *
+ * returns: 0 if all the intervals (and EOI) were found, -1 otherwise
+ */
+static int find_restart_intervals(builtin_data_t *data, int nintervals)
+{
+	/*asserts*/
+	assert(data != NULL);
+
+	uint8_t *p = data->datap;
+	uint8_t *end = data->data_end;
+	int n = 1;
+
+	data->rst_start[0] = p;
+
+	while (p < end)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
-		exit(-1);
+		uint8_t *q = memchr(p, 0xff, end - p);
+		if (q == NULL || q + 1 >= end)
+			return -1;
+
+		int m = q[1];
+		if (m >= M_RST0 && m <= M_RST0 + 7)
+		{
+			/*markers must come in sequence (RST0 .. RST7)*/
+			if (n >= nintervals || m != M_RST0 + ((n - 1) & 7))
+				return -1;
+			data->rst_end[n - 1] = q;
+			data->rst_start[n++] = q + 2;
+			p = q + 2;
+		}
+		else if (m == M_EOI)
+		{
+			if (n != nintervals)
+				return -1;
+			data->rst_end[n - 1] = q;
+			return 0;
+		}
+		else
+			p = q + 1; /*stuffed 0xff00 or fill byte*/
 	}
-	
-	return E_OK;
+
+	return -1;
 }
 
 /*
- * jpeg decode
+ * decode the restart intervals assigned to a worker
  * args:
- *   out_buf -  pointer to picture data ( decoded image - yuyv format)
- *   in_buf -  pointer to input data ( compressed jpeg )
- *   size - picture size
+ *    data - pointer to builtin decoder data
+ *    worker - pointer to worker data
  *
  * asserts:
- *   out_buf not null
- *   in_buf not null
+ *    data not null
+ *    worker not null
  *
- * returns: error code (0 - OK)
+ * returns: none
  */
-//int jpeg_decode(uint8_t **pic, uint8_t *buf, int width, int height)
-int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
+static void decode_intervals(builtin_data_t *data, jpeg_worker_t *worker)
 {
 	/*asserts*/
-	assert(in_buf != NULL);
-	assert(out_buf != NULL);
-	
-	memcpy(jpeg_ctx->tmp_frame, in_buf, size);
+	assert(data != NULL);
+	assert(worker != NULL);
 
-	struct jpeg_decdata *decdata;
-	int i=0, j=0, m=0, tac=0, tdc=0;
-	int intwidth=0, intheight=0;
-	int mcusx=0, mcusy=0, mx=0, my=0;
-	int ypitch=0 ,xpitch=0,bpp=0,pitch=0,x=0,y=0;
-	int mb=0;
-	int max[6];
-	ftopict convert;
-	int err = 0;
-	int isInitHuffman = 0;
-	decdata = calloc(1, sizeof(struct jpeg_decdata));
-	if(decdata == NULL)
+	int nmcus = data->mcusx * data->mcusy;
+	int i = 0;
+
+	memcpy(worker->dscans, data->dscans, sizeof(worker->dscans));
+	worker->status = 0;
+
+	for (i = worker->first; i < worker->last; i++)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_decode): %s\n", strerror(errno));
-		exit(-1);
+		int k = 0;
+		for (k = 0; k < data->info.ns; k++)
+			worker->dscans[k].dc = 0;
+
+		setinput(&worker->inp, data->rst_start[i], data->rst_end[i]);
+
+		int mcu = i * data->info.dri;
+		int last = mcu + data->info.dri;
+		if (last > nmcus)
+			last = nmcus;
+
+		for (; mcu < last; mcu++)
+			decode_mcu(data, worker, &worker->inp, worker->dscans,
+				mcu % data->mcusx, mcu / data->mcusx);
+
+		/*
+		 * like dec_checkmarker in the serial decoder: the interval
+		 * data must end at the marker (no bad huffman code, marker
+		 * inside the interval or data left over)
+		 */
+		if (dec_readmarker(&worker->inp) != M_EOF && worker->status == 0)
+			worker->status = E_WRONG_MARKER_ERR;
 	}
+}
+
+/*
+ * restart interval worker thread
+ * args:
+ *    arg - pointer to worker data
+ *
+ * asserts:
+ *    arg not null
+ *
+ * returns: NULL
+ */
+static void *restart_worker(void *arg)
+{
+	jpeg_worker_t *worker = (jpeg_worker_t *) arg;
+	/*asserts*/
+	assert(worker != NULL);
 
-	for(i=0;i<6;i++)
-		max[i]=0;
+	builtin_data_t *data = worker->data;
 
-	if (!decdata)
+	__LOCK_MUTEX(&data->mutex);
+	while (!data->quit)
 	{
-		err = E_ALLOC_ERR;
-		goto error;
+		if (data->job == worker->job)
+		{
+			__COND_WAIT(&data->cond_job, &data->mutex);
+			continue;
+		}
+		worker->job = data->job;
+		__UNLOCK_MUTEX(&data->mutex);
+
+		decode_intervals(data, worker);
+
+		__LOCK_MUTEX(&data->mutex);
+		data->pending--;
+		if (data->pending == 0)
+			__COND_SIGNAL(&data->cond_done);
 	}
+	__UNLOCK_MUTEX(&data->mutex);
 
-	datap = jpeg_ctx->tmp_frame;
-	/*check SOI (0xFFD8)*/
-	if (getbyte() != 0xff)
+	return NULL;
+}
+
+/*
+ * decode the restart intervals across the worker pool
+ * args:
+ *    jpeg_ctx - pointer to decoder context
+ *    data - pointer to builtin decoder data
+ *    nintervals - number of restart intervals
+ *
+ * asserts:
+ *    data not null
+ *
+ * returns: error code (0 - OK)
+ */
+static int decode_parallel(jpeg_decoder_context_t *jpeg_ctx, builtin_data_t *data, int nintervals)
+{
+	/*asserts*/
+	assert(data != NULL);
+
+	int nthreads = jpeg_ctx->threads;
+	if (nthreads > nintervals)
+		nthreads = nintervals;
+
+	/*start the worker threads on first use*/
+	while (data->nrunning < nthreads - 1)
 	{
-		err = E_NO_SOI_ERR;
-		goto error;
+		jpeg_worker_t *worker = &data->workers[data->nrunning + 1];
+		worker->data = data;
+		worker->job = data->job; /*no job pending yet*/
+		worker->first = 0;
+		worker->last = 0;
+
+		if (__THREAD_CREATE(&worker->thread, restart_worker, (void *) worker))
+		{
+			fprintf(stderr, "V4L2_CORE: (jpeg decoder) couldn't create restart interval worker\n");
+			break;
+		}
+		data->nrunning++;
 	}
-	if (getbyte() != M_SOI)
+
+	if (nthreads > data->nrunning + 1)
+		nthreads = data->nrunning + 1;
+
+	/*split the intervals in contiguous ranges (idle workers get none)*/
+	int i = 0;
+	for (i = 0; i <= data->nrunning; i++)
 	{
-		err = E_NO_SOI_ERR;
-		goto error;
+		jpeg_worker_t *worker = &data->workers[i];
+		if (i < nthreads)
+		{
+			worker->first = i * nintervals / nthreads;
+			worker->last = (i + 1) * nintervals / nthreads;
+		}
+		else
+		{
+			worker->first = 0;
+			worker->last = 0;
+		}
 	}
-	/*read tables - if exist, up to start frame marker (0xFFC0)*/
-	if (readtables(M_SOF0, &isInitHuffman))
+
+	if (data->nrunning > 0)
 	{
-		err = E_BAD_TABLES_ERR;
-		goto error;
+		__LOCK_MUTEX(&data->mutex);
+		data->pending = data->nrunning;
+		data->job++;
+		__COND_BCAST(&data->cond_job);
+		__UNLOCK_MUTEX(&data->mutex);
 	}
-	getword();     /*header lenght*/
-	i = getbyte(); /*precision (8 bit)*/
-	if (i != 8)
+
+	decode_intervals(data, &data->workers[0]);
+
+	if (data->nrunning > 0)
 	{
-		err = E_NOT_8BIT_ERR;
-		goto error;
+		__LOCK_MUTEX(&data->mutex);
+		while (data->pending > 0)
+			__COND_WAIT(&data->cond_done, &data->mutex);
+		__UNLOCK_MUTEX(&data->mutex);
 	}
-	intheight = getword(); /*height*/
-	intwidth = getword();  /*width */
 
-	if ((intheight & 7) || (intwidth & 7)) /*must be even*/
+	/*first error (in frame order)*/
+	for (i = 0; i < nthreads; i++)
+		if (data->workers[i].status != 0)
+			return data->workers[i].status;
+
+	return 0;
+}
+
+/*
+ * create a (m)jpeg decoder context
+ * args:
+ *    width - image width
+ *    height - image height
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to decoder context (NULL on error)
+ */
+jpeg_decoder_context_t *jpeg_create_decoder(int width, int height)
+{
+	jpeg_decoder_context_t *jpeg_ctx = calloc(1, sizeof(jpeg_decoder_context_t));
+	if(jpeg_ctx == NULL)
 	{
-		err = E_BAD_WIDTH_OR_HEIGHT_ERR;
-		goto error;
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_create_decoder): %s\n", strerror(errno));
+		exit(-1);
 	}
-	info.nc = getbyte(); /*number of components*/
-	if (info.nc > MAXCOMP)
+
+	jpeg_ctx->width = width;
+	jpeg_ctx->height = height;
+#ifdef USE_PLANAR_YUV
+	jpeg_ctx->pic_size = (width * height * 3) / 2; //yu12
+#else
+	jpeg_ctx->pic_size = width * height * 2; //yuyv
+#endif
+	jpeg_ctx->tmp_frame = NULL; //compressed data is read in place
+
+	long ncores = sysconf(_SC_NPROCESSORS_ONLN);
+	jpeg_set_decoder_threads(jpeg_ctx, (int) ncores);
+
+	builtin_data_t *data = calloc(1, sizeof(builtin_data_t));
+	if(data == NULL)
 	{
-		err = E_TOO_MANY_COMPPS_ERR;
-		goto error;
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_create_decoder): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	/*worst case: one restart interval per 8x8 mcu*/
+	data->max_intervals = ((width + 7) >> 3) * ((height + 7) >> 3);
+	data->rst_start = calloc(data->max_intervals, sizeof(uint8_t *));
+	data->rst_end = calloc(data->max_intervals, sizeof(uint8_t *));
+	data->workers = calloc(JPEG_MAX_THREADS, sizeof(jpeg_worker_t));
+	if(data->rst_start == NULL ||
+	   data->rst_end == NULL ||
+	   data->workers == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_create_decoder): %s\n", strerror(errno));
+		exit(-1);
 	}
+
+	/*build the default huffman tables once*/
+	huffman_init(data->def_dhuff);
+
+	data->width = width;
+	data->height = height;
+	data->simd_idct = colorspaces_get_simd()->idct_8x8;
+	data->profile = (verbosity > 1) ? 1 : 0;
+
+	__INIT_MUTEX(&data->mutex);
+	__INIT_COND(&data->cond_job);
+	__INIT_COND(&data->cond_done);
+
+	jpeg_ctx->codec_data = data;
+
+	return jpeg_ctx;
+}
+
+/*
+ * jpeg decode (a single frame)
+ * args:
+ *   jpeg_ctx - pointer to decoder context
+ *   data - pointer to builtin decoder data
+ *   out_buf -  pointer to picture data ( decoded image - yuyv or yu12 format)
+ *   in_buf -  pointer to input data ( compressed jpeg )
+ *   size - picture size
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - OK)
+ */
+static int decode_jpeg(jpeg_decoder_context_t *jpeg_ctx, builtin_data_t *data,
+	uint8_t *out_buf, uint8_t *in_buf, int size)
+{
+	int i=0, j=0, m=0, tac=0, tdc=0;
+	int intwidth=0, intheight=0;
+	int mx=0, my=0;
+	int isInitHuffman = 0;
+
+	data->datap = in_buf;
+	data->data_end = in_buf + size;
+	data->info.dri = 0;
+
+	/*check SOI (0xFFD8)*/
+	if (getbyte(data) != 0xff)
+		return E_NO_SOI_ERR;
+	if (getbyte(data) != M_SOI)
+		return E_NO_SOI_ERR;
+	/*read tables - if exist, up to start frame marker (0xFFC0)*/
+	if (readtables(data, M_SOF0, &isInitHuffman))
+		return E_BAD_TABLES_ERR;
+	getword(data);     /*header lenght*/
+	i = getbyte(data); /*precision (8 bit)*/
+	if (i != 8)
+		return E_NOT_8BIT_ERR;
+	intheight = getword(data); /*height*/
+	intwidth = getword(data);  /*width */
+
+	if ((intheight & 7) || (intwidth & 7)) /*must be even*/
+		return E_BAD_WIDTH_OR_HEIGHT_ERR;
+	data->info.nc = getbyte(data); /*number of components*/
+	if (data->info.nc > MAXCOMP)
+		return E_TOO_MANY_COMPPS_ERR;
 	/*for each component*/
-	for (i = 0; i < info.nc; i++)
+	for (i = 0; i < data->info.nc; i++)
 	{
 		int h, v;
-		comps[i].cid = getbyte(); /*component id*/
-		comps[i].hv = getbyte();
-		v = comps[i].hv & 15; /*vertical sampling   */
-		h = comps[i].hv >> 4; /*horizontal sampling */
-		comps[i].tq = getbyte(); /*quantization table used*/
+		data->comps[i].cid = getbyte(data); /*component id*/
+		data->comps[i].hv = getbyte(data);
+		v = data->comps[i].hv & 15; /*vertical sampling   */
+		h = data->comps[i].hv >> 4; /*horizontal sampling */
+		data->comps[i].tq = getbyte(data); /*quantization table used*/
 		if (h > 3 || v > 3)
-		{
-			err = E_ILLEGAL_HV_ERR;
-			goto error;
-		}
-		if (comps[i].tq > 3)
-		{
-			err = E_QUANT_TBL_SEL_ERR;
-			goto error;
-		}
+			return E_ILLEGAL_HV_ERR;
+		if (data->comps[i].tq > 3)
+			return E_QUANT_TBL_SEL_ERR;
 	}
 	/*read tables - if exist, up to start of scan marker (0xFFDA)*/
-	if (readtables(M_SOS,&isInitHuffman))
+	if (readtables(data, M_SOS, &isInitHuffman))
+		return E_BAD_TABLES_ERR;
+	getword(data); /* header lenght */
+	data->info.ns = getbyte(data); /* number of scans */
+	if (!data->info.ns)
 	{
-		err = E_BAD_TABLES_ERR;
-		goto error;
-	}
-	getword(); /* header lenght */
-	info.ns = getbyte(); /* number of scans */
-	if (!info.ns)
-	{
-		printf("V4L2_CORE: (jpeg decoder) info ns %d/n",info.ns);
-		err = E_NOT_YCBCR_ERR;
-		goto error;
+		printf("V4L2_CORE: (jpeg decoder) info ns %d/n", data->info.ns);
+		return E_NOT_YCBCR_ERR;
 	}
+
+	/*MJPG frames have no huffman tables - use the default ones*/
+	struct dec_hufftbl *dhuff = isInitHuffman ? data->dhuff : data->def_dhuff;
+
 	/*for each scan*/
-	for (i = 0; i < info.ns; i++)
+	for (i = 0; i < data->info.ns; i++)
 	{
-		dscans[i].cid = getbyte(); /*component id*/
-		tdc = getbyte();
+		data->dscans[i].cid = getbyte(data); /*component id*/
+		tdc = getbyte(data);
 		tac = tdc & 15; /*ac table*/
 		tdc >>= 4;      /*dc table*/
 		if (tdc > 1 || tac > 1)
-		{
-			err = E_QUANT_TBL_SEL_ERR;
-			goto error;
-		}
-		for (j = 0; j < info.nc; j++)
-			if (comps[j].cid == dscans[i].cid)
+			return E_QUANT_TBL_SEL_ERR;
+		for (j = 0; j < data->info.nc; j++)
+			if (data->comps[j].cid == data->dscans[i].cid)
 				break;
-		if (j == info.nc)
-		{
-			err = E_UNKNOWN_CID_ERR;
-			goto error;
-		}
-		dscans[i].hv = comps[j].hv;
-		dscans[i].tq = comps[j].tq;
-		dscans[i].hudc.dhuff = dec_huffdc + tdc;
-		dscans[i].huac.dhuff = dec_huffac + tac;
+		if (j == data->info.nc)
+			return E_UNKNOWN_CID_ERR;
+		data->dscans[i].hv = data->comps[j].hv;
+		data->dscans[i].tq = data->comps[j].tq;
+		data->dscans[i].hudc.dhuff = dec_huffdc(dhuff) + tdc;
+		data->dscans[i].huac.dhuff = dec_huffac(dhuff) + tac;
 	}
 
-	i = getbyte(); /*0 */
-	j = getbyte(); /*63*/
-	m = getbyte(); /*0 */
+	i = getbyte(data); /*0 */
+	j = getbyte(data); /*63*/
+	m = getbyte(data); /*0 */
 
 	if (i != 0 || j != 63 || m != 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (jpeg decoder) FW error,not seq DCT ??\n");
 	}
 
-	/*build huffman tables*/
-	if(!isInitHuffman)
-	{
-		if(huffman_init() < 0)
-			return E_BAD_TABLES_ERR;
-	}
-	/*
-	if (dscans[0].cid != 1 || dscans[1].cid != 2 || dscans[2].cid != 3)
-	{
-		err = ERR_NOT_YCBCR_221111;
-		goto error;
-	}
-
-	if (dscans[1].hv != 0x11 || dscans[2].hv != 0x11)
-	{
-		err = ERR_NOT_YCBCR_221111;
-		goto error;
-	}
-	*/
-
-	/*
-	 * if internal width and external are not the same or heigth too
-	 * and pic not allocated realloc the good size and mark the change
-	 * need 1 macroblock line more ??
-	 */
-	//if (intwidth != width || intheight != height || pic == NULL)
-	//{
-	//	width = intwidth;
-	//	height = intheight;
-	//	// BytesperPixel 2 yuyv , 3 rgb24
-	//	*pic = calloc( intwidth * (intheight + 8) * 2, sizeof(uint8_t));
-	//	if(*pic == NULL)
-	//	{
-	//		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_v4l2_frames): %s\n", strerror(errno));
-	//		exit(-1);
-	//	}
-	//}
-
-	switch (dscans[0].hv)
+	switch (data->dscans[0].hv)
 	{
 		case 0x22: // 411
-			mb=6;
-			mcusx = jpeg_ctx->width >> 4;
-			mcusy = jpeg_ctx->height >> 4;
-			bpp=2;
-			xpitch = 16 * bpp;
-			pitch = jpeg_ctx->width * bpp; // YUYV out
-			ypitch = 16 * pitch;
-			convert = yuv420pto422; //choose the right conversion function
+			data->mb=6;
+			data->mcusx = jpeg_ctx->width >> 4;
+			data->mcusy = jpeg_ctx->height >> 4;
+			data->mcu_w = 16;
+			data->mcu_h = 16;
+			data->xpitch = 16 * 2;
+			data->pitch = jpeg_ctx->width * 2; // YUYV out
+			data->ypitch = 16 * data->pitch;
+			data->convert = CONVERT_420; //choose the right conversion function
 			break;
 		case 0x21: //422
-			mb=4;
-			mcusx = jpeg_ctx->width >> 4;
-			mcusy = jpeg_ctx->height >> 3;
-			bpp=2;
-			xpitch = 16 * bpp;
-			pitch = jpeg_ctx->width * bpp; // YUYV out
-			ypitch = 8 * pitch;
-			convert = yuv422pto422; //choose the right conversion function
+			data->mb=4;
+			data->mcusx = jpeg_ctx->width >> 4;
+			data->mcusy = jpeg_ctx->height >> 3;
+			data->mcu_w = 16;
+			data->mcu_h = 8;
+			data->xpitch = 16 * 2;
+			data->pitch = jpeg_ctx->width * 2; // YUYV out
+			data->ypitch = 8 * data->pitch;
+			data->convert = CONVERT_422; //choose the right conversion function
 			break;
 		case 0x11: //444
-			mcusx = jpeg_ctx->width >> 3;
-			mcusy = jpeg_ctx->height >> 3;
-			bpp=2;
-			xpitch = 8 * bpp;
-			pitch = jpeg_ctx->width * bpp; // YUYV out
-			ypitch = 8 * pitch;
-			if (info.ns==1)
+			data->mcusx = jpeg_ctx->width >> 3;
+			data->mcusy = jpeg_ctx->height >> 3;
+			data->mcu_w = 8;
+			data->mcu_h = 8;
+			data->xpitch = 8 * 2;
+			data->pitch = jpeg_ctx->width * 2; // YUYV out
+			data->ypitch = 8 * data->pitch;
+			if (data->info.ns==1)
 			{
-				mb = 1;
-				convert = yuv400pto422; //choose the right conversion function
+				data->mb = 1;
+				data->convert = CONVERT_400; //choose the right conversion function
 			}
 			else
 			{
-				mb=3;
-				convert = yuv444pto422; //choose the right conversion function
+				data->mb=3;
+				data->convert = CONVERT_444; //choose the right conversion function
 			}
 			break;
 		default:
-			err = E_NOT_YCBCR_ERR;
-			goto error;
-			break;
+			return E_NOT_YCBCR_ERR;
+	}
+
+	idctqtab(data->quant[data->dscans[0].tq], data->dquant[0]);
+	idctqtab(data->quant[data->dscans[1].tq], data->dquant[1]);
+	idctqtab(data->quant[data->dscans[2].tq], data->dquant[2]);
+	if (data->simd_idct != NULL)
+	{
+		idctqtab_float(data->quant[data->dscans[0].tq], data->fquant[0]);
+		idctqtab_float(data->quant[data->dscans[1].tq], data->fquant[1]);
+		idctqtab_float(data->quant[data->dscans[2].tq], data->fquant[2]);
 	}
 
-	idctqtab(quant[dscans[0].tq], decdata->dquant[0]);
-	idctqtab(quant[dscans[1].tq], decdata->dquant[1]);
-	idctqtab(quant[dscans[2].tq], decdata->dquant[2]);
-	setinput(&inp, datap);
-	dec_initscans();
+	data->dscans[0].next = 2;
+	data->dscans[1].next = 1;
+	data->dscans[2].next = 0;	/* 4xx encoding */
 
-	dscans[0].next = 2;
-	dscans[1].next = 1;
-	dscans[2].next = 0;	/* 4xx encoding */
-	for (my = 0,y=0; my < mcusy; my++,y+=ypitch)
+	data->out_buf = out_buf;
+
+	/*
+	 * restart intervals are independent (dc predictors are reset
+	 * at each marker) so they can be decoded in parallel
+	 */
+	if (data->info.dri && jpeg_ctx->threads > 1)
 	{
-		for (mx = 0,x=0; mx < mcusx; mx++,x+=xpitch)
+		int nmcus = data->mcusx * data->mcusy;
+		int nintervals = (nmcus + data->info.dri - 1) / data->info.dri;
+
+		if (nintervals > 1 &&
+		    nintervals <= data->max_intervals &&
+		    find_restart_intervals(data, nintervals) == 0)
 		{
-			if (info.dri && !--info.nm)
-				if (dec_checkmarker())
-				{
-					err = E_WRONG_MARKER_ERR;
-					goto error;
-				}
-			switch (mb)
-			{
-				case 6:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					idct(decdata->dcts + 64, decdata->out + 64,
-						decdata->dquant[0], IFIX(128.5), max[1]);
-					idct(decdata->dcts + 128, decdata->out + 128,
-						decdata->dquant[0], IFIX(128.5), max[2]);
-					idct(decdata->dcts + 192, decdata->out + 192,
-						decdata->dquant[0], IFIX(128.5), max[3]);
-					idct(decdata->dcts + 256, decdata->out + 256,
-						decdata->dquant[1], IFIX(0.5), max[4]);
-					idct(decdata->dcts + 320, decdata->out + 320,
-						decdata->dquant[2], IFIX(0.5), max[5]);
-					break;
-
-				case 4:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					idct(decdata->dcts + 64, decdata->out + 64,
-						decdata->dquant[0], IFIX(128.5), max[1]);
-					idct(decdata->dcts + 128, decdata->out + 256,
-							decdata->dquant[1], IFIX(0.5), max[4]);
-					idct(decdata->dcts + 192, decdata->out + 320,
-						decdata->dquant[2], IFIX(0.5), max[5]);
-					break;
-
-				case 3:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					idct(decdata->dcts + 64, decdata->out + 256,
-						decdata->dquant[1], IFIX(0.5), max[4]);
-					idct(decdata->dcts + 128, decdata->out + 320,
-						decdata->dquant[2], IFIX(0.5), max[5]);
-					break;
-
-				case 1:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					break;
-			} // switch enc411
-			convert(decdata->out, out_buf+y+x, pitch); //convert to 422
+			data->frames_parallel++;
+			return decode_parallel(jpeg_ctx, data, nintervals);
 		}
 	}
 
-	m = dec_readmarker(&inp);
-	if (m != M_EOI)
+	data->frames_serial++;
+
+	struct in *inp = &data->workers[0].inp;
+	setinput(inp, data->datap, data->data_end);
+	dec_initscans(data);
+
+	for (my = 0; my < data->mcusy; my++)
 	{
-		err = E_NO_EOI_ERR;
-		goto error;
+		for (mx = 0; mx < data->mcusx; mx++)
+		{
+			if (data->info.dri && !--data->info.nm)
+				if (dec_checkmarker(data, inp))
+					return E_WRONG_MARKER_ERR;
+
+			decode_mcu(data, &data->workers[0], inp, data->dscans, mx, my);
+		}
 	}
-	free(decdata);
+
+	m = dec_readmarker(inp);
+	if (m != M_EOI)
+		return E_NO_EOI_ERR;
+
 	return 0;
-error:
-	free(decdata);
-	return err;
 }
 
 /*
- * close (m)jpeg decoder context
+ * jpeg decode
  * args:
- *    none
+ *   jpeg_ctx - pointer to decoder context
+ *   out_buf -  pointer to picture data ( decoded image - yuyv or yu12 format)
+ *   in_buf -  pointer to input data ( compressed jpeg )
+ *   size - picture size
+ *
+ * asserts:
+ *   jpeg_ctx is not null
+ *   out_buf not null
+ *   in_buf not null
+ *
+ * returns: error code (0 - OK)
+ */
+int jpeg_decode(jpeg_decoder_context_t *jpeg_ctx, uint8_t *out_buf, uint8_t *in_buf, int size)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+	assert(in_buf != NULL);
+	assert(out_buf != NULL);
+
+	builtin_data_t *data = (builtin_data_t *) jpeg_ctx->codec_data;
+
+	uint64_t t0 = ns_time_monotonic();
+	int ret = decode_jpeg(jpeg_ctx, data, out_buf, in_buf, size);
+	data->decode_ns += ns_time_monotonic() - t0;
+
+	return ret;
+}
+
+/*
+ * time the decoding stages (entropy, idct, output) of the builtin decoder
+ * args:
+ *    jpeg_ctx - pointer to decoder context
+ *    profile - 1 on; 0 off
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+void jpeg_set_decoder_profile(jpeg_decoder_context_t *jpeg_ctx, int profile)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	builtin_data_t *data = (builtin_data_t *) jpeg_ctx->codec_data;
+
+	data->profile = profile ? 1 : 0;
+}
+
+/*
+ * get the decoder stats
+ * args:
+ *    jpeg_ctx - pointer to decoder context
+ *    stats - pointer to stats (filled)
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *    stats is not null
+ *
+ * returns: error code (0 - E_OK)
+ */
+int jpeg_get_decoder_stats(jpeg_decoder_context_t *jpeg_ctx, jpeg_decoder_stats_t *stats)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+	assert(stats != NULL);
+
+	builtin_data_t *data = (builtin_data_t *) jpeg_ctx->codec_data;
+
+	memset(stats, 0, sizeof(jpeg_decoder_stats_t));
+
+	stats->frames = data->frames_parallel + data->frames_serial;
+	stats->frames_parallel = data->frames_parallel;
+	stats->threads = data->nrunning + 1;
+	stats->idct = data->simd_idct != NULL ? colorspaces_get_simd()->name : "scalar";
+	stats->decode_ns = data->decode_ns;
+
+	/*the workers are idle between frames*/
+	int i = 0;
+	for(i = 0; i <= data->nrunning; i++)
+	{
+		stats->entropy_ns += data->workers[i].entropy_ns;
+		stats->idct_ns += data->workers[i].idct_ns;
+		stats->output_ns += data->workers[i].output_ns;
+	}
+
+	return E_OK;
+}
+
+/*
+ * destroy a (m)jpeg decoder context
+ * args:
+ *    jpeg_ctx - pointer to decoder context
  *
  * asserts:
  *    none
  *
  * returns: none
  */
-void jpeg_close_decoder()
+void jpeg_destroy_decoder(jpeg_decoder_context_t *jpeg_ctx)
 {
 	if(jpeg_ctx == NULL)
 		return;
-	
-	free(jpeg_ctx->tmp_frame);
-	free(jpeg_ctx);
 
-	jpeg_ctx = NULL;
+	builtin_data_t *data = (builtin_data_t *) jpeg_ctx->codec_data;
+
+	if(data != NULL)
+	{
+		/*stop the restart interval workers*/
+		__LOCK_MUTEX(&data->mutex);
+		data->quit = 1;
+		__COND_BCAST(&data->cond_job);
+		__UNLOCK_MUTEX(&data->mutex);
+
+		int i = 0;
+		for(i = 1; i <= data->nrunning; i++)
+			__THREAD_JOIN(data->workers[i].thread);
+
+		jpeg_decoder_stats_t stats;
+		jpeg_get_decoder_stats(jpeg_ctx, &stats);
+		if(verbosity > 0 && stats.frames > 0)
+		{
+			printf("V4L2_CORE: (jpeg decoder) %u frames decoded by restart interval (%i threads), %u serially\n",
+				stats.frames_parallel, stats.threads, stats.frames - stats.frames_parallel);
+			printf("V4L2_CORE: (jpeg decoder) %.1f frames/s (%.3f ms/frame) idct: %s\n",
+				stats.decode_ns > 0 ? (double) stats.frames * 1E9 / stats.decode_ns : 0.0,
+				(double) stats.decode_ns / (stats.frames * 1E6),
+				stats.idct);
+		}
+		if(data->profile && stats.frames > 0)
+		{
+			/*stage times are cpu time summed over all the workers*/
+			printf("V4L2_CORE: (jpeg decoder) ms/frame - entropy: %.3f idct: %.3f output: %.3f\n",
+				(double) stats.entropy_ns / (stats.frames * 1E6),
+				(double) stats.idct_ns / (stats.frames * 1E6),
+				(double) stats.output_ns / (stats.frames * 1E6));
+		}
+
+		__CLOSE_COND(&data->cond_job);
+		__CLOSE_COND(&data->cond_done);
+		__CLOSE_MUTEX(&data->mutex);
+
+		free(data->rst_start);
+		free(data->rst_end);
+		free(data->workers);
+		free(data);
+	}
+
+	free(jpeg_ctx);
 }
 
 #else  //use libavcodec to decode mjpeg data
@@ -1374,7 +1890,7 @@ typedef struct _codec_data_t
 } codec_data_t;
 
 /*
- * init (m)jpeg decoder context
+ * create a (m)jpeg decoder context
  * args:
  *    width - image width
  *    height - image height
@@ -1382,9 +1898,9 @@ typedef struct _codec_data_t
  * asserts:
  *    none
  *
- * returns: error code (0 - E_OK)
+ * returns: pointer to decoder context (NULL on error)
  */
-int jpeg_init_decoder(int width, int height)
+jpeg_decoder_context_t *jpeg_create_decoder(int width, int height)
 {
 #if !LIBAVCODEC_VER_AT_LEAST(53,34)
 	avcodec_init();
@@ -1396,20 +1912,17 @@ int jpeg_init_decoder(int width, int height)
 	avcodec_register_all();
 	av_log_set_level(AV_LOG_PANIC);
 
-	if(jpeg_ctx != NULL)
-		jpeg_close_decoder();
-
-	jpeg_ctx = calloc(1, sizeof(jpeg_decoder_context_t));
+	jpeg_decoder_context_t *jpeg_ctx = calloc(1, sizeof(jpeg_decoder_context_t));
 	if(jpeg_ctx == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_create_decoder): %s\n", strerror(errno));
 		exit(-1);
 	}
 	
 	codec_data_t *codec_data = calloc(1, sizeof(codec_data_t));
 	if(codec_data == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_create_decoder): %s\n", strerror(errno));
 		exit(-1);
 	}
 	
@@ -1419,8 +1932,7 @@ int jpeg_init_decoder(int width, int height)
 		fprintf(stderr, "V4L2_CORE: (mjpeg decoder) codec not found\n");
 		free(jpeg_ctx);
 		free(codec_data);
-		jpeg_ctx = NULL;
-		return E_NO_CODEC;
+		return NULL;
 	}
 
 #if LIBAVCODEC_VER_AT_LEAST(53,6)
@@ -1452,8 +1964,7 @@ int jpeg_init_decoder(int width, int height)
 		free(codec_data->context);
 		free(codec_data);
 		free(jpeg_ctx);
-		jpeg_ctx = NULL;
-		return E_NO_CODEC;
+		return NULL;
 	}
 
 #if LIBAVCODEC_VER_AT_LEAST(55,28)
@@ -1468,21 +1979,23 @@ int jpeg_init_decoder(int width, int height)
 	jpeg_ctx->tmp_frame = calloc(width*height*2, sizeof(uint8_t));
 	if(jpeg_ctx->tmp_frame == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_create_decoder): %s\n", strerror(errno));
 		exit(-1);
 	}
 	
 	jpeg_ctx->pic_size = avpicture_get_size(codec_data->context->pix_fmt, width, height);
 	jpeg_ctx->width = width;
 	jpeg_ctx->height = height;
+	jpeg_ctx->threads = 1;
 	jpeg_ctx->codec_data = codec_data;
 
-	return E_OK;
+	return jpeg_ctx;
 }
 
 /*
  * decode (m)jpeg frame
  * args:
+ *    jpeg_ctx - pointer to decoder context
  *    out_buf - pointer to decoded data
  *    in_buf - pointer to h264 data
  *    size - in_buf size
@@ -1494,7 +2007,7 @@ int jpeg_init_decoder(int width, int height)
  *
  * returns: decoded data size
  */
-int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
+int jpeg_decode(jpeg_decoder_context_t *jpeg_ctx, uint8_t *out_buf, uint8_t *in_buf, int size)
 {
 	/*asserts*/
 	assert(jpeg_ctx != NULL);
@@ -1537,16 +2050,58 @@ int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 }
 
 /*
- * close (m)jpeg decoder context
+ * time the decoding stages (builtin decoder only)
  * args:
- *    none
+ *    jpeg_ctx - pointer to decoder context
+ *    profile - 1 on; 0 off
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+void jpeg_set_decoder_profile(jpeg_decoder_context_t *jpeg_ctx, int profile)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	(void) profile;
+}
+
+/*
+ * get the decoder stats (builtin decoder only)
+ * args:
+ *    jpeg_ctx - pointer to decoder context
+ *    stats - pointer to stats (zeroed)
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *    stats is not null
+ *
+ * returns: error code (E_NO_DATA)
+ */
+int jpeg_get_decoder_stats(jpeg_decoder_context_t *jpeg_ctx, jpeg_decoder_stats_t *stats)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+	assert(stats != NULL);
+
+	memset(stats, 0, sizeof(jpeg_decoder_stats_t));
+
+	return E_NO_DATA;
+}
+
+/*
+ * destroy a (m)jpeg decoder context
+ * args:
+ *    jpeg_ctx - pointer to decoder context
  *
  * asserts:
  *    none
  *
  * returns: none
  */
-void jpeg_close_decoder()
+void jpeg_destroy_decoder(jpeg_decoder_context_t *jpeg_ctx)
 {
 	if(jpeg_ctx == NULL)
 		return;
@@ -1572,10 +2127,81 @@ void jpeg_close_decoder()
 		
 	free(codec_data);
 	free(jpeg_ctx);
-
-	jpeg_ctx = NULL;
 }
 
 #endif
 
+/*
+ * set the number of threads used for decoding restart intervals
+ *  (only used by the builtin decoder on frames with DRI markers)
+ * args:
+ *    jpeg_ctx - pointer to decoder context
+ *    nthreads - number of threads [1 - JPEG_MAX_THREADS]
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+void jpeg_set_decoder_threads(jpeg_decoder_context_t *jpeg_ctx, int nthreads)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	if(nthreads < 1)
+		nthreads = 1;
+	if(nthreads > JPEG_MAX_THREADS)
+		nthreads = JPEG_MAX_THREADS;
+
+	jpeg_ctx->threads = nthreads;
+}
+
+/*
+ * init the device (m)jpeg decoder context
+ * args:
+ *    vd - pointer to video device data
+ *    width - image width
+ *    height - image height
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: error code (0 - E_OK)
+ */
+int jpeg_init_decoder(v4l2_dev_t *vd, int width, int height)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(vd->jpeg_ctx != NULL)
+		jpeg_close_decoder(vd);
+
+	vd->jpeg_ctx = jpeg_create_decoder(width, height);
+
+	if(vd->jpeg_ctx == NULL)
+		return E_NO_CODEC;
+
+	return E_OK;
+}
+
+/*
+ * close the device (m)jpeg decoder context
+ * args:
+ *    vd - pointer to video device data
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: none
+ */
+void jpeg_close_decoder(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	jpeg_destroy_decoder(vd->jpeg_ctx);
+
+	vd->jpeg_ctx = NULL;
+}
+
 
@@ -28,6 +28,8 @@
 #ifndef JPEG_DECODER_H
 #define JPEG_DECODER_H
 
+#include "v4l2_core.h"
+
 #define HEADERFRAME1 0xaf
 
 /*******Error codes *******/
@@ -47,8 +49,40 @@
 #define ERR_BAD_TABLES 14
 #define ERR_DEPTH_MISMATCH 15
 
+/*max threads decoding restart intervals (builtin decoder)*/
+#define JPEG_MAX_THREADS 8
+
+typedef struct _jpeg_decoder_context_t
+{
+	void *codec_data;
+
+	int width;
+	int height;
+	int pic_size;
+
+	int threads; //restart interval decoding threads (builtin decoder)
+
+	uint8_t *tmp_frame; //temp frame buffer (libavcodec)
+
+} jpeg_decoder_context_t;
+
+/*decoder stats (stage times are only set with profiling on)*/
+typedef struct _jpeg_decoder_stats_t
+{
+	uint32_t frames;          //decoded frames
+	uint32_t frames_parallel; //frames decoded by restart interval
+	int threads;              //restart interval decoding threads
+	const char *idct;         //idct implementation (simd name or "scalar")
+
+	uint64_t decode_ns;       //wall time in jpeg_decode
+	/*cpu time summed over all the restart interval threads*/
+	uint64_t entropy_ns;
+	uint64_t idct_ns;
+	uint64_t output_ns;
+} jpeg_decoder_stats_t;
+
 /*
- * init (m)jpeg decoder context
+ * create a (m)jpeg decoder context
  * args:
  *    width - image width
  *    height - image height
@@ -56,36 +90,105 @@
  * asserts:
  *    none
  *
- * returns: error code (0 - E_OK)
+ * returns: pointer to decoder context (NULL on error)
  */
-int jpeg_init_decoder(int width, int height);
+jpeg_decoder_context_t *jpeg_create_decoder(int width, int height);
 
 /*
  * jpeg decode
  * args:
+ *   jpeg_ctx - pointer to decoder context
  *   out_buf -  pointer to picture data ( decoded image - yuyv format)
  *   in_buf -  pointer to input data ( compressed jpeg )
  *   size - picture size
  *
  * asserts:
+ *   jpeg_ctx is not null
  *   out_buf not null
  *   in_buf not null
  *
  * returns: error code (0 - OK)
  */
-int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size);
+int jpeg_decode(jpeg_decoder_context_t *jpeg_ctx, uint8_t *out_buf, uint8_t *in_buf, int size);
 
 /*
- * close (m)jpeg decoder context
+ * set the number of threads used for decoding restart intervals
+ *  (only used by the builtin decoder on frames with DRI markers)
  * args:
- *    none
+ *    jpeg_ctx - pointer to decoder context
+ *    nthreads - number of threads [1 - JPEG_MAX_THREADS]
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+void jpeg_set_decoder_threads(jpeg_decoder_context_t *jpeg_ctx, int nthreads);
+
+/*
+ * time the decoding stages (entropy, idct, output) of the builtin decoder
+ *  (defaults to on with verbosity > 1, must not be called while decoding)
+ * args:
+ *    jpeg_ctx - pointer to decoder context
+ *    profile - 1 on; 0 off
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+void jpeg_set_decoder_profile(jpeg_decoder_context_t *jpeg_ctx, int profile);
+
+/*
+ * get the decoder stats (must not be called while decoding)
+ * args:
+ *    jpeg_ctx - pointer to decoder context
+ *    stats - pointer to stats (filled)
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *    stats is not null
+ *
+ * returns: error code (E_NO_DATA - no stats from libavcodec)
+ */
+int jpeg_get_decoder_stats(jpeg_decoder_context_t *jpeg_ctx, jpeg_decoder_stats_t *stats);
+
+/*
+ * destroy a (m)jpeg decoder context
+ * args:
+ *    jpeg_ctx - pointer to decoder context
  *
  * asserts:
  *    none
  *
  * returns: none
  */
-void jpeg_close_decoder();
+void jpeg_destroy_decoder(jpeg_decoder_context_t *jpeg_ctx);
 
-#endif
+/*
+ * init the device (m)jpeg decoder context
+ * args:
+ *    vd - pointer to video device data
+ *    width - image width
+ *    height - image height
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: error code (0 - E_OK)
+ */
+int jpeg_init_decoder(v4l2_dev_t *vd, int width, int height);
 
+/*
+ * close the device (m)jpeg decoder context
+ * args:
+ *    vd - pointer to video device data
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: none
+ */
+void jpeg_close_decoder(v4l2_dev_t *vd);
+
+#endif
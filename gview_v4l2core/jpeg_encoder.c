@@ -0,0 +1,1120 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  baseline (m)jpeg encoder                                                     #
+#                                                                               #
+#  AAN float forward dct with fused quantization (simd kernels in               #
+#  colorspaces_simd.c), table driven huffman coding and one restart             #
+#  interval per mcu row, so slices of rows are coded in parallel                #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gviewv4l2core.h"
+#include "colorspaces_simd.h"
+#include "core_time.h"
+#include "jpeg_decoder.h"
+#include "gview.h"
+#include "../config.h"
+
+extern int verbosity;
+
+/*standard huffman tables (DHT segment data) from the jpeg decoder*/
+#define JPG_HUFFMAN_TABLE_LENGTH 0x01A0
+extern const uint8_t jpeg_huffman_table[JPG_HUFFMAN_TABLE_LENGTH];
+
+/*worst case coded size of an 8x8 block (26 bits per coefficient and byte stuffing)*/
+#define JPEG_BLOCK_MAX_BYTES 512
+
+/*max header size (SOI, APP0, DQT, SOF0, DHT, DRI and SOS)*/
+#define JPEG_HEADER_MAX_SIZE 1024
+
+/*zigzag index to natural order*/
+static const uint8_t jpeg_natural_order[64] =
+{
+	0,  1,  8,  16, 9,  2,  3,  10,
+	17, 24, 32, 25, 18, 11, 4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13, 6,  7,  14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/*annex K quantization tables (natural order, quality 50)*/
+static const uint8_t std_luminance_quant[64] =
+{
+	16, 11, 10, 16, 24,  40,  51,  61,
+	12, 12, 14, 19, 26,  58,  60,  55,
+	14, 13, 16, 24, 40,  57,  69,  56,
+	14, 17, 22, 29, 51,  87,  80,  62,
+	18, 22, 37, 56, 68,  109, 103, 77,
+	24, 35, 55, 64, 81,  104, 113, 92,
+	49, 64, 78, 87, 103, 121, 120, 101,
+	72, 92, 95, 98, 112, 100, 103, 99
+};
+
+static const uint8_t std_chrominance_quant[64] =
+{
+	17, 18, 24, 47, 99, 99, 99, 99,
+	18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99,
+	47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/*AAN scale factors: cos(k*PI/16) * sqrt(2) (k > 0)*/
+static const double aan_scale[8] =
+{
+	1.0, 1.387039845, 1.306562965, 1.175875602,
+	1.0, 0.785694958, 0.541196100, 0.275899379
+};
+
+/*
+ * image component layout in the input frame
+ *  sample(x,y) = in[offset + y * stride + x * step]
+ */
+typedef struct _jpeg_plane_t
+{
+	int offset;
+	int stride;
+	int step;
+	int width;
+	int height;
+} jpeg_plane_t;
+
+/*
+ * huffman code table (indexed by symbol)
+ */
+typedef struct _jpeg_huff_code_t
+{
+	uint16_t code[256];
+	uint8_t size[256];
+} jpeg_huff_code_t;
+
+/*
+ * bit writer (64 bit accumulator, flushed 32 bits at a time)
+ */
+typedef struct _jpeg_bitstream_t
+{
+	uint64_t acc;
+	int nbits;
+	uint8_t *out;
+} jpeg_bitstream_t;
+
+typedef void (*ffdct) (int16_t *out, const int16_t *in, const float *fdiv);
+
+struct _jpeg_encoder_context_t;
+
+/*
+ * slice worker (codes a range of mcu rows)
+ */
+typedef struct _jpeg_slice_t
+{
+	__THREAD_TYPE thread;
+	struct _jpeg_encoder_context_t *ctx;
+
+	int first;                    /* first mcu row to code */
+	int last;                     /* last mcu row (not included) */
+	uint32_t job;                 /* last job handled */
+
+	uint8_t *buf;                 /* coded data */
+	size_t buf_size;
+	size_t size;
+
+	int16_t blk[64];              /* level shifted samples */
+	int16_t coef[64];             /* quantized coefficients */
+} jpeg_slice_t;
+
+/*
+ * encoder context
+ */
+struct _jpeg_encoder_context_t
+{
+	int width;
+	int height;
+	int format;
+	int quality;
+
+	/*frame geometry*/
+	int mcu_h;                    /* 8 (422) or 16 (420), mcus are always 16 wide */
+	int mcusx;
+	int mcusy;
+	int nblocks;                  /* blocks per mcu */
+	jpeg_plane_t planes[3];
+
+	uint8_t dqt[2][64];           /* quantization tables (zigzag order) */
+	float fdiv[2][64];            /* reciprocal tables for the AAN fdct (natural order) */
+	jpeg_huff_code_t huff[4];     /* dc luma, dc chroma, ac luma, ac chroma */
+	ffdct fdct_quant;
+
+	uint8_t header[JPEG_HEADER_MAX_SIZE];
+	int header_size;
+
+	uint8_t *in_buf;              /* frame being coded */
+
+	/*worker pool - slices[0] is the calling thread*/
+	int threads;
+	jpeg_slice_t *slices;
+	int nrunning;                 /* running worker threads */
+	__MUTEX_TYPE mutex;
+	__COND_TYPE cond_job;
+	__COND_TYPE cond_done;
+	uint32_t job;
+	int pending;
+	int quit;
+
+	/*stats*/
+	uint32_t frames;
+	uint64_t encode_ns;
+	uint64_t encode_bytes;
+};
+
+/*
+ * one dimensional 8 point AAN forward dct (scalar)
+ * args:
+ *    d - pointer to first sample
+ *    stride - distance between samples
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fdct_1d(float *d, int stride)
+{
+	float tmp0 = d[0] + d[7 * stride];
+	float tmp7 = d[0] - d[7 * stride];
+	float tmp1 = d[stride] + d[6 * stride];
+	float tmp6 = d[stride] - d[6 * stride];
+	float tmp2 = d[2 * stride] + d[5 * stride];
+	float tmp5 = d[2 * stride] - d[5 * stride];
+	float tmp3 = d[3 * stride] + d[4 * stride];
+	float tmp4 = d[3 * stride] - d[4 * stride];
+
+	/*even part*/
+	float tmp10 = tmp0 + tmp3;
+	float tmp13 = tmp0 - tmp3;
+	float tmp11 = tmp1 + tmp2;
+	float tmp12 = tmp1 - tmp2;
+
+	d[0] = tmp10 + tmp11;
+	d[4 * stride] = tmp10 - tmp11;
+
+	float z1 = (tmp12 + tmp13) * 0.707106781f;
+	d[2 * stride] = tmp13 + z1;
+	d[6 * stride] = tmp13 - z1;
+
+	/*odd part*/
+	tmp10 = tmp4 + tmp5;
+	tmp11 = tmp5 + tmp6;
+	tmp12 = tmp6 + tmp7;
+
+	float z5 = (tmp10 - tmp12) * 0.382683433f;
+	float z2 = tmp10 * 0.541196100f + z5;
+	float z4 = tmp12 * 1.306562965f + z5;
+	float z3 = tmp11 * 0.707106781f;
+
+	float z11 = tmp7 + z3;
+	float z13 = tmp7 - z3;
+
+	d[5 * stride] = z13 + z2;
+	d[3 * stride] = z13 - z2;
+	d[stride] = z11 + z4;
+	d[7 * stride] = z11 - z4;
+}
+
+/*
+ * 8x8 forward dct with fused quantization (scalar)
+ * args:
+ *    out - pointer to quantized coefficients (natural order)
+ *    in - pointer to level shifted samples
+ *    fdiv - reciprocal quantization table (prescaled)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fdct_quant_8x8(int16_t *out, const int16_t *in, const float *fdiv)
+{
+	float blk[64];
+	int i = 0;
+
+	for(i = 0; i < 64; i++)
+		blk[i] = (float) in[i];
+
+	for(i = 0; i < 8; i++) /*columns*/
+		fdct_1d(blk + i, 8);
+	for(i = 0; i < 8; i++) /*rows*/
+		fdct_1d(blk + i * 8, 1);
+
+	for(i = 0; i < 64; i++)
+		out[i] = (int16_t) lrintf(blk[i] * fdiv[i]);
+}
+
+/*
+ * set the quantization tables for the encoder quality
+ *  (annex K tables scaled as in the IJG library)
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+static void init_quantization(jpeg_encoder_context_t *jpeg_ctx)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	int scale = (jpeg_ctx->quality < 50) ?
+		5000 / jpeg_ctx->quality : 200 - jpeg_ctx->quality * 2;
+
+	int t = 0;
+	for(t = 0; t < 2; t++)
+	{
+		const uint8_t *base = (t == 0) ? std_luminance_quant : std_chrominance_quant;
+		uint8_t quant[64];
+
+		int n = 0;
+		for(n = 0; n < 64; n++)
+		{
+			int value = (base[n] * scale + 50) / 100;
+			if(value < 1)
+				value = 1;
+			if(value > 255)
+				value = 255;
+			quant[n] = (uint8_t) value;
+
+			jpeg_ctx->fdiv[t][n] = (float) (1.0 /
+				(value * aan_scale[n >> 3] * aan_scale[n & 7] * 8.0));
+		}
+
+		for(n = 0; n < 64; n++)
+			jpeg_ctx->dqt[t][n] = quant[jpeg_natural_order[n]];
+	}
+}
+
+/*
+ * build the huffman code tables from the standard DHT data
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+static void init_huffman(jpeg_encoder_context_t *jpeg_ctx)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	const uint8_t *ptr = jpeg_huffman_table;
+	const uint8_t *end = jpeg_huffman_table + JPG_HUFFMAN_TABLE_LENGTH;
+
+	while(ptr < end)
+	{
+		int tc = *ptr++;
+		int th = tc & 15;
+		tc >>= 4;
+		/*same indexing as the decoder (dc luma, dc chroma, ac luma, ac chroma)*/
+		jpeg_huff_code_t *huff = &jpeg_ctx->huff[tc * 2 + th];
+
+		const uint8_t *bits = ptr;
+		const uint8_t *vals = ptr + 16;
+
+		/*canonical codes: consecutive within a length, shifted between lengths*/
+		uint16_t code = 0;
+		int k = 0;
+		int len = 0;
+		for(len = 1; len <= 16; len++)
+		{
+			int j = 0;
+			for(j = 0; j < bits[len - 1]; j++)
+			{
+				huff->code[vals[k]] = code++;
+				huff->size[vals[k]] = (uint8_t) len;
+				k++;
+			}
+			code <<= 1;
+		}
+
+		ptr = vals + k;
+	}
+}
+
+/*
+ * write the jpeg headers (constant for the context)
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+static void write_header(jpeg_encoder_context_t *jpeg_ctx)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	uint8_t *out = jpeg_ctx->header;
+	int i = 0;
+
+	/*start of image*/
+	*out++ = 0xFF;
+	*out++ = 0xD8;
+
+	/*APP0 - JFIF 1.2 (120 pixels per inch)*/
+	static const uint8_t app0[] =
+	{
+		0xFF, 0xE0, 0x00, 0x10,
+		0x4A, 0x46, 0x49, 0x46, 0x00,
+		0x01, 0x02, 0x01, 0x00, 0x78, 0x00, 0x78, 0x00, 0x00
+	};
+	memcpy(out, app0, sizeof(app0));
+	out += sizeof(app0);
+
+	/*quantization tables (luma - 0, chroma - 1)*/
+	*out++ = 0xFF;
+	*out++ = 0xDB;
+	*out++ = 0x00;
+	*out++ = 0x84; /*2 + 2 * 65*/
+	for(i = 0; i < 2; i++)
+	{
+		*out++ = (uint8_t) i; /*Pq - 8 bit, Tq*/
+		memcpy(out, jpeg_ctx->dqt[i], 64);
+		out += 64;
+	}
+
+	/*start of frame (baseline)*/
+	*out++ = 0xFF;
+	*out++ = 0xC0;
+	*out++ = 0x00;
+	*out++ = 0x11; /*8 + 3 * 3*/
+	*out++ = 0x08; /*precision*/
+	*out++ = (uint8_t) (jpeg_ctx->height >> 8);
+	*out++ = (uint8_t) jpeg_ctx->height;
+	*out++ = (uint8_t) (jpeg_ctx->width >> 8);
+	*out++ = (uint8_t) jpeg_ctx->width;
+	*out++ = 0x03; /*components*/
+	*out++ = 0x01; /*y*/
+	*out++ = (jpeg_ctx->mcu_h == 16) ? 0x22 : 0x21; /*horiz|vertical*/
+	*out++ = 0x00; /*quantization table*/
+	*out++ = 0x02; /*u*/
+	*out++ = 0x11;
+	*out++ = 0x01;
+	*out++ = 0x03; /*v*/
+	*out++ = 0x11;
+	*out++ = 0x01;
+
+	/*huffman tables*/
+	*out++ = 0xFF;
+	*out++ = 0xC4;
+	*out++ = (uint8_t) ((JPG_HUFFMAN_TABLE_LENGTH + 2) >> 8);
+	*out++ = (uint8_t) (JPG_HUFFMAN_TABLE_LENGTH + 2);
+	memcpy(out, jpeg_huffman_table, JPG_HUFFMAN_TABLE_LENGTH);
+	out += JPG_HUFFMAN_TABLE_LENGTH;
+
+	/*restart interval (one mcu row)*/
+	*out++ = 0xFF;
+	*out++ = 0xDD;
+	*out++ = 0x00;
+	*out++ = 0x04;
+	*out++ = (uint8_t) (jpeg_ctx->mcusx >> 8);
+	*out++ = (uint8_t) jpeg_ctx->mcusx;
+
+	/*start of scan*/
+	static const uint8_t sos[] =
+	{
+		0xFF, 0xDA, 0x00, 0x0C, 0x03,
+		0x01, 0x00, /*y - dc|ac tables*/
+		0x02, 0x11, /*u*/
+		0x03, 0x11, /*v*/
+		0x00, 0x3F, 0x00
+	};
+	memcpy(out, sos, sizeof(sos));
+	out += sizeof(sos);
+
+	jpeg_ctx->header_size = out - jpeg_ctx->header;
+}
+
+/*
+ * add bits to the bitstream
+ * args:
+ *    bs - pointer to bitstream
+ *    bits - value (right aligned)
+ *    size - number of bits (<= 32)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static inline void put_bits(jpeg_bitstream_t *bs, uint32_t bits, int size)
+{
+	bs->acc = (bs->acc << size) | bits;
+	bs->nbits += size;
+
+	if(bs->nbits >= 32)
+	{
+		bs->nbits -= 32;
+		uint32_t w = (uint32_t) (bs->acc >> bs->nbits);
+
+		/*no 0xFF bytes - no stuffing*/
+		if(((~w - 0x01010101u) & w & 0x80808080u) == 0)
+		{
+			bs->out[0] = (uint8_t) (w >> 24);
+			bs->out[1] = (uint8_t) (w >> 16);
+			bs->out[2] = (uint8_t) (w >> 8);
+			bs->out[3] = (uint8_t) w;
+			bs->out += 4;
+		}
+		else
+		{
+			int i = 0;
+			for(i = 24; i >= 0; i -= 8)
+			{
+				uint8_t b = (uint8_t) (w >> i);
+				*bs->out++ = b;
+				if(b == 0xFF)
+					*bs->out++ = 0x00;
+			}
+		}
+	}
+}
+
+/*
+ * pad the bitstream to a byte boundary (with ones) and flush it
+ * args:
+ *    bs - pointer to bitstream
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void flush_bits(jpeg_bitstream_t *bs)
+{
+	int pad = (8 - (bs->nbits & 7)) & 7;
+	if(pad > 0)
+		put_bits(bs, (1u << pad) - 1, pad);
+
+	while(bs->nbits > 0)
+	{
+		bs->nbits -= 8;
+		uint8_t b = (uint8_t) (bs->acc >> bs->nbits);
+		*bs->out++ = b;
+		if(b == 0xFF)
+			*bs->out++ = 0x00;
+	}
+}
+
+/*
+ * code a (run, value) pair: huffman code for (run << 4 | size)
+ *  followed by the value bits
+ * args:
+ *    bs - pointer to bitstream
+ *    huff - pointer to huffman table
+ *    run - zero run (shifted left by 4, always 0 for dc)
+ *    value - coefficient (or dc difference)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static inline void put_value(jpeg_bitstream_t *bs, const jpeg_huff_code_t *huff, int run, int value)
+{
+	int abs_value = (value < 0) ? -value : value;
+	int nbits = (abs_value != 0) ? 32 - __builtin_clz(abs_value) : 0;
+
+	/*negative values are coded as (value - 1) in nbits*/
+	if(value < 0)
+		value--;
+
+	int symbol = run | nbits;
+	put_bits(bs,
+		((uint32_t) huff->code[symbol] << nbits) | ((uint32_t) value & ((1u << nbits) - 1)),
+		huff->size[symbol] + nbits);
+}
+
+/*
+ * huffman code a quantized block
+ * args:
+ *    bs - pointer to bitstream
+ *    coef - pointer to quantized coefficients (natural order)
+ *    last_dc - pointer to dc predictor of the component
+ *    dc_huff - pointer to dc huffman table
+ *    ac_huff - pointer to ac huffman table
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static inline void encode_block(jpeg_bitstream_t *bs, const int16_t *coef, int *last_dc,
+	const jpeg_huff_code_t *dc_huff, const jpeg_huff_code_t *ac_huff)
+{
+	int16_t zz[64];
+	uint64_t nonzero = 0;
+	int k = 0;
+
+	/*zigzag reorder and build the non zero coefficient mask*/
+	for(k = 1; k < 64; k++)
+	{
+		zz[k] = coef[jpeg_natural_order[k]];
+		nonzero |= (uint64_t) (zz[k] != 0) << k;
+	}
+
+	int diff = coef[0] - *last_dc;
+	*last_dc = coef[0];
+	if(diff > 2047)
+		diff = 2047;
+	else if(diff < -2047)
+		diff = -2047;
+	put_value(bs, dc_huff, 0, diff);
+
+	/*walk the non zero coefficients only*/
+	int prev = 0;
+	while(nonzero != 0)
+	{
+		k = __builtin_ctzll(nonzero);
+		nonzero &= nonzero - 1;
+
+		int run = k - prev - 1;
+		while(run > 15)
+		{
+			put_bits(bs, ac_huff->code[0xF0], ac_huff->size[0xF0]); /*ZRL*/
+			run -= 16;
+		}
+
+		int value = zz[k];
+		if(value > 1023)
+			value = 1023;
+		else if(value < -1023)
+			value = -1023;
+		put_value(bs, ac_huff, run << 4, value);
+
+		prev = k;
+	}
+
+	if(prev < 63)
+		put_bits(bs, ac_huff->code[0x00], ac_huff->size[0x00]); /*EOB*/
+}
+
+/*
+ * load a level shifted 8x8 block (edges are replicated)
+ * args:
+ *    blk - pointer to block samples
+ *    in - pointer to input frame
+ *    plane - pointer to component layout
+ *    x0 - block left (component samples)
+ *    y0 - block top (component samples)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static inline void load_block(int16_t *blk, const uint8_t *in, const jpeg_plane_t *plane, int x0, int y0)
+{
+	const uint8_t *base = in + plane->offset;
+	int x = 0, y = 0;
+
+	if(x0 + 8 <= plane->width && y0 + 8 <= plane->height)
+	{
+		const uint8_t *p = base + y0 * plane->stride + x0 * plane->step;
+
+		if(plane->step == 1)
+		{
+			for(y = 0; y < 8; y++, p += plane->stride, blk += 8)
+				for(x = 0; x < 8; x++)
+					blk[x] = (int16_t) p[x] - 128;
+		}
+		else
+		{
+			int step = plane->step;
+			for(y = 0; y < 8; y++, p += plane->stride, blk += 8)
+				for(x = 0; x < 8; x++)
+					blk[x] = (int16_t) p[x * step] - 128;
+		}
+		return;
+	}
+
+	for(y = 0; y < 8; y++, blk += 8)
+	{
+		int yy = (y0 + y < plane->height) ? y0 + y : plane->height - 1;
+		const uint8_t *p = base + yy * plane->stride;
+
+		for(x = 0; x < 8; x++)
+		{
+			int xx = (x0 + x < plane->width) ? x0 + x : plane->width - 1;
+			blk[x] = (int16_t) p[xx * plane->step] - 128;
+		}
+	}
+}
+
+/*
+ * code the mcu rows of a slice (each row is a restart interval)
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *    slice - pointer to slice
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *    slice is not null
+ *
+ * returns: none
+ */
+static void encode_rows(jpeg_encoder_context_t *jpeg_ctx, jpeg_slice_t *slice)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+	assert(slice != NULL);
+
+	const uint8_t *in = jpeg_ctx->in_buf;
+	size_t row_max = (size_t) jpeg_ctx->mcusx * jpeg_ctx->nblocks * JPEG_BLOCK_MAX_BYTES + 2;
+	int luma_rows = jpeg_ctx->mcu_h >> 3;
+
+	slice->size = 0;
+
+	int my = 0;
+	for(my = slice->first; my < slice->last; my++)
+	{
+		if(slice->buf_size - slice->size < row_max)
+		{
+			slice->buf_size = slice->size + row_max + ((slice->size + row_max) >> 1);
+			slice->buf = realloc(slice->buf, slice->buf_size);
+			if(slice->buf == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg encoder): %s\n", strerror(errno));
+				exit(-1);
+			}
+		}
+
+		jpeg_bitstream_t bs;
+		bs.acc = 0;
+		bs.nbits = 0;
+		bs.out = slice->buf + slice->size;
+
+		/*restart marker before every row but the first*/
+		if(my > 0)
+		{
+			*bs.out++ = 0xFF;
+			*bs.out++ = (uint8_t) (0xD0 + ((my - 1) & 7));
+		}
+
+		/*dc predictors are reset on every restart interval*/
+		int last_dc[3] = {0, 0, 0};
+
+		int mx = 0;
+		for(mx = 0; mx < jpeg_ctx->mcusx; mx++)
+		{
+			int by = 0, bx = 0, c = 0;
+
+			for(by = 0; by < luma_rows; by++)
+			{
+				for(bx = 0; bx < 2; bx++)
+				{
+					load_block(slice->blk, in, &jpeg_ctx->planes[0],
+						mx * 16 + bx * 8, my * jpeg_ctx->mcu_h + by * 8);
+					jpeg_ctx->fdct_quant(slice->coef, slice->blk, jpeg_ctx->fdiv[0]);
+					encode_block(&bs, slice->coef, &last_dc[0],
+						&jpeg_ctx->huff[0], &jpeg_ctx->huff[2]);
+				}
+			}
+
+			for(c = 1; c < 3; c++)
+			{
+				load_block(slice->blk, in, &jpeg_ctx->planes[c], mx * 8, my * 8);
+				jpeg_ctx->fdct_quant(slice->coef, slice->blk, jpeg_ctx->fdiv[1]);
+				encode_block(&bs, slice->coef, &last_dc[c],
+					&jpeg_ctx->huff[1], &jpeg_ctx->huff[3]);
+			}
+		}
+
+		flush_bits(&bs);
+		slice->size = bs.out - slice->buf;
+	}
+}
+
+/*
+ * slice worker thread
+ * args:
+ *    arg - pointer to slice data
+ *
+ * asserts:
+ *    arg not null
+ *
+ * returns: NULL
+ */
+static void *slice_worker(void *arg)
+{
+	jpeg_slice_t *slice = (jpeg_slice_t *) arg;
+	/*asserts*/
+	assert(slice != NULL);
+
+	jpeg_encoder_context_t *jpeg_ctx = slice->ctx;
+
+	__LOCK_MUTEX(&jpeg_ctx->mutex);
+	while (!jpeg_ctx->quit)
+	{
+		if (jpeg_ctx->job == slice->job)
+		{
+			__COND_WAIT(&jpeg_ctx->cond_job, &jpeg_ctx->mutex);
+			continue;
+		}
+		slice->job = jpeg_ctx->job;
+		__UNLOCK_MUTEX(&jpeg_ctx->mutex);
+
+		encode_rows(jpeg_ctx, slice);
+
+		__LOCK_MUTEX(&jpeg_ctx->mutex);
+		jpeg_ctx->pending--;
+		if (jpeg_ctx->pending == 0)
+			__COND_SIGNAL(&jpeg_ctx->cond_done);
+	}
+	__UNLOCK_MUTEX(&jpeg_ctx->mutex);
+
+	return NULL;
+}
+
+/*
+ * code the mcu rows across the worker pool
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: number of slices coded
+ */
+static int encode_slices(jpeg_encoder_context_t *jpeg_ctx)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	int nthreads = jpeg_ctx->threads;
+	if (nthreads > jpeg_ctx->mcusy)
+		nthreads = jpeg_ctx->mcusy;
+
+	/*start the worker threads on first use*/
+	while (jpeg_ctx->nrunning < nthreads - 1)
+	{
+		jpeg_slice_t *slice = &jpeg_ctx->slices[jpeg_ctx->nrunning + 1];
+		slice->ctx = jpeg_ctx;
+		slice->job = jpeg_ctx->job; /*no job pending yet*/
+		slice->first = 0;
+		slice->last = 0;
+
+		if (__THREAD_CREATE(&slice->thread, slice_worker, (void *) slice))
+		{
+			fprintf(stderr, "V4L2_CORE: (jpeg encoder) couldn't create slice worker\n");
+			break;
+		}
+		jpeg_ctx->nrunning++;
+	}
+
+	if (nthreads > jpeg_ctx->nrunning + 1)
+		nthreads = jpeg_ctx->nrunning + 1;
+
+	/*split the rows in contiguous ranges (idle workers get none)*/
+	int i = 0;
+	for (i = 0; i <= jpeg_ctx->nrunning; i++)
+	{
+		jpeg_slice_t *slice = &jpeg_ctx->slices[i];
+		if (i < nthreads)
+		{
+			slice->first = i * jpeg_ctx->mcusy / nthreads;
+			slice->last = (i + 1) * jpeg_ctx->mcusy / nthreads;
+		}
+		else
+		{
+			slice->first = 0;
+			slice->last = 0;
+		}
+	}
+
+	if (jpeg_ctx->nrunning > 0)
+	{
+		__LOCK_MUTEX(&jpeg_ctx->mutex);
+		jpeg_ctx->pending = jpeg_ctx->nrunning;
+		jpeg_ctx->job++;
+		__COND_BCAST(&jpeg_ctx->cond_job);
+		__UNLOCK_MUTEX(&jpeg_ctx->mutex);
+	}
+
+	encode_rows(jpeg_ctx, &jpeg_ctx->slices[0]);
+
+	if (jpeg_ctx->nrunning > 0)
+	{
+		__LOCK_MUTEX(&jpeg_ctx->mutex);
+		while (jpeg_ctx->pending > 0)
+			__COND_WAIT(&jpeg_ctx->cond_done, &jpeg_ctx->mutex);
+		__UNLOCK_MUTEX(&jpeg_ctx->mutex);
+	}
+
+	return nthreads;
+}
+
+/*
+ * create a jpeg encoder context
+ * args:
+ *    width - image width
+ *    height - image height
+ *    format - input format: V4L2_PIX_FMT_YUV420 (coded as 4:2:0)
+ *             or V4L2_PIX_FMT_YUYV (coded as 4:2:2)
+ *    quality - jpeg quality [1 - 100] (<= 0 - JPEG_ENCODER_DEF_QUALITY)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to encoder context (NULL on error)
+ */
+jpeg_encoder_context_t *v4l2core_jpeg_encoder_create(int width, int height, int format, int quality)
+{
+	if(width < 2 || height < 2 || width > 0xFFFF || height > 0xFFFF)
+	{
+		fprintf(stderr, "V4L2_CORE: (jpeg encoder) bad image size %ix%i\n", width, height);
+		return NULL;
+	}
+
+	if(format != V4L2_PIX_FMT_YUV420 && format != V4L2_PIX_FMT_YUYV)
+	{
+		fprintf(stderr, "V4L2_CORE: (jpeg encoder) input format %x not supported\n", format);
+		return NULL;
+	}
+
+	jpeg_encoder_context_t *jpeg_ctx = calloc(1, sizeof(jpeg_encoder_context_t));
+	if(jpeg_ctx == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_jpeg_encoder_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	if(quality <= 0)
+		quality = JPEG_ENCODER_DEF_QUALITY;
+	if(quality > 100)
+		quality = 100;
+
+	jpeg_ctx->width = width;
+	jpeg_ctx->height = height;
+	jpeg_ctx->format = format;
+	jpeg_ctx->quality = quality;
+
+	int cw = width / 2; /*chroma width*/
+
+	if(format == V4L2_PIX_FMT_YUV420)
+	{
+		int ch = height / 2;
+
+		jpeg_ctx->mcu_h = 16;
+		jpeg_ctx->nblocks = 6;
+
+		jpeg_ctx->planes[0] = (jpeg_plane_t) {0, width, 1, width, height};
+		jpeg_ctx->planes[1] = (jpeg_plane_t) {width * height, cw, 1, cw, ch};
+		jpeg_ctx->planes[2] = (jpeg_plane_t) {width * height + cw * ch, cw, 1, cw, ch};
+	}
+	else
+	{
+		jpeg_ctx->mcu_h = 8;
+		jpeg_ctx->nblocks = 4;
+
+		jpeg_ctx->planes[0] = (jpeg_plane_t) {0, width * 2, 2, width, height};
+		jpeg_ctx->planes[1] = (jpeg_plane_t) {1, width * 2, 4, cw, height};
+		jpeg_ctx->planes[2] = (jpeg_plane_t) {3, width * 2, 4, cw, height};
+	}
+
+	jpeg_ctx->mcusx = (width + 15) >> 4;
+	jpeg_ctx->mcusy = (height + jpeg_ctx->mcu_h - 1) / jpeg_ctx->mcu_h;
+
+	init_quantization(jpeg_ctx);
+	init_huffman(jpeg_ctx);
+	write_header(jpeg_ctx);
+
+	jpeg_ctx->fdct_quant = colorspaces_get_simd()->fdct_quant_8x8;
+	if(jpeg_ctx->fdct_quant == NULL)
+		jpeg_ctx->fdct_quant = fdct_quant_8x8;
+
+	long ncores = sysconf(_SC_NPROCESSORS_ONLN);
+	v4l2core_jpeg_encoder_set_threads(jpeg_ctx, (int) ncores);
+
+	jpeg_ctx->slices = calloc(JPEG_MAX_THREADS, sizeof(jpeg_slice_t));
+	if(jpeg_ctx->slices == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_jpeg_encoder_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	__INIT_MUTEX(&jpeg_ctx->mutex);
+	__INIT_COND(&jpeg_ctx->cond_job);
+	__INIT_COND(&jpeg_ctx->cond_done);
+
+	return jpeg_ctx;
+}
+
+/*
+ * set the number of threads coding slices (mcu rows)
+ *  (must not be called while encoding)
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *    nthreads - number of threads [1 - 8]
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+void v4l2core_jpeg_encoder_set_threads(jpeg_encoder_context_t *jpeg_ctx, int nthreads)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	if(nthreads < 1)
+		nthreads = 1;
+	if(nthreads > JPEG_MAX_THREADS)
+		nthreads = JPEG_MAX_THREADS;
+
+	jpeg_ctx->threads = nthreads;
+}
+
+/*
+ * encode a frame
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *    in_buf - pointer to input frame (context format)
+ *    out_buf - pointer to output buffer (jpeg)
+ *    out_size - output buffer size
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *    in_buf is not null
+ *    out_buf is not null
+ *
+ * returns: jpeg size or error code (E_NO_DATA - out_buf too small)
+ */
+int v4l2core_jpeg_encode(jpeg_encoder_context_t *jpeg_ctx, uint8_t *in_buf, uint8_t *out_buf, int out_size)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+	assert(in_buf != NULL);
+	assert(out_buf != NULL);
+
+	uint64_t t0 = ns_time_monotonic();
+
+	jpeg_ctx->in_buf = in_buf;
+	int nslices = encode_slices(jpeg_ctx);
+	jpeg_ctx->in_buf = NULL;
+
+	size_t size = jpeg_ctx->header_size + 2; /*headers and EOI*/
+	int i = 0;
+	for(i = 0; i < nslices; i++)
+		size += jpeg_ctx->slices[i].size;
+
+	if(size > (size_t) out_size)
+	{
+		fprintf(stderr, "V4L2_CORE: (jpeg encoder) output buffer too small (%zu > %i bytes)\n",
+			size, out_size);
+		return E_NO_DATA;
+	}
+
+	uint8_t *out = out_buf;
+	memcpy(out, jpeg_ctx->header, jpeg_ctx->header_size);
+	out += jpeg_ctx->header_size;
+
+	for(i = 0; i < nslices; i++)
+	{
+		memcpy(out, jpeg_ctx->slices[i].buf, jpeg_ctx->slices[i].size);
+		out += jpeg_ctx->slices[i].size;
+	}
+
+	/*end of image*/
+	*out++ = 0xFF;
+	*out++ = 0xD9;
+
+	jpeg_ctx->frames++;
+	jpeg_ctx->encode_ns += ns_time_monotonic() - t0;
+	jpeg_ctx->encode_bytes += size;
+
+	return (int) size;
+}
+
+/*
+ * destroy a jpeg encoder context
+ * args:
+ *    jpeg_ctx - pointer to encoder context
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void v4l2core_jpeg_encoder_destroy(jpeg_encoder_context_t *jpeg_ctx)
+{
+	if(jpeg_ctx == NULL)
+		return;
+
+	/*stop the slice workers*/
+	__LOCK_MUTEX(&jpeg_ctx->mutex);
+	jpeg_ctx->quit = 1;
+	__COND_BCAST(&jpeg_ctx->cond_job);
+	__UNLOCK_MUTEX(&jpeg_ctx->mutex);
+
+	int i = 0;
+	for(i = 1; i <= jpeg_ctx->nrunning; i++)
+		__THREAD_JOIN(jpeg_ctx->slices[i].thread);
+
+	if(verbosity > 0 && jpeg_ctx->frames > 1)
+		printf("V4L2_CORE: (jpeg encoder) %u frames (q=%i, %i threads) %.1f frames/s (%.3f ms/frame) %" PRIu64 " bytes/frame fdct: %s\n",
+			jpeg_ctx->frames, jpeg_ctx->quality, jpeg_ctx->nrunning + 1,
+			jpeg_ctx->encode_ns > 0 ? (double) jpeg_ctx->frames * 1E9 / jpeg_ctx->encode_ns : 0.0,
+			(double) jpeg_ctx->encode_ns / (jpeg_ctx->frames * 1E6),
+			jpeg_ctx->encode_bytes / jpeg_ctx->frames,
+			jpeg_ctx->fdct_quant != fdct_quant_8x8 ? colorspaces_get_simd()->name : "scalar");
+
+	__CLOSE_COND(&jpeg_ctx->cond_job);
+	__CLOSE_COND(&jpeg_ctx->cond_done);
+	__CLOSE_MUTEX(&jpeg_ctx->mutex);
+
+	for(i = 0; i < JPEG_MAX_THREADS; i++)
+		free(jpeg_ctx->slices[i].buf);
+	free(jpeg_ctx->slices);
+	free(jpeg_ctx);
+}
@@ -43,46 +43,66 @@
  */
 int save_frame_image(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename, int format);
 
+/*
+ * save the frame to file
+ * args:
+ *    frame - pointer to frame buffer
+ *    width - frame width
+ *    height - frame height
+ *    filename - output file name
+ *    format - image type
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *
+ * asserts:
+ *    frame is not null
+ *
+ * returns: error code
+ */
+int save_image_frame(v4l2_frame_buff_t *frame, int width, int height, const char *filename, int format);
+
 /*
  * save frame data to a jpeg file
  * args:
- *    vd - pointer to device data
  *    frame - pointer to frame buffer
+ *    width - frame width
+ *    height - frame height
  *    filename - filename string
  *
  * asserts:
- *    vd is not null
+ *    frame is not null
  *
  * returns: error code
  */
-int save_image_jpeg(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename);
+int save_image_jpeg(v4l2_frame_buff_t *frame, int width, int height, const char *filename);
 
 /*
  * save frame data to a bmp file
  * args:
- *    vd - pointer to device data
  *    frame - pointer to frame buffer
+ *    width - frame width
+ *    height - frame height
  *    filename - filename string
  *
  * asserts:
- *    vd is not null
+ *    frame is not null
  *
  * returns: error code
  */
-int save_image_bmp(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename);
+int save_image_bmp(v4l2_frame_buff_t *frame, int width, int height, const char *filename);
 
 /*
  * save frame data into a png file
  * args:
- *    vd - pointer to device data
  *    frame - pointer to frame buffer
+ *    width - frame width
+ *    height - frame height
  *    filename - string with png filename name
  *
  * asserts:
- *   vd is not null
+ *   frame is not null
  *
  * returns: error code
  */
-int save_image_png(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename);
+int save_image_png(v4l2_frame_buff_t *frame, int width, int height, const char *filename);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,530 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "save_image.h"
+#include "../config.h"
+
+#define SNAPSHOT_MAX_WORKERS (8)
+
+#define __SMUTEX &(pool->mutex)
+
+extern int verbosity;
+
+/*
+ * snapshot job: a private copy of the frame data
+ *  (the frame buffer goes back to the capture right away)
+ */
+typedef struct _snapshot_job_t
+{
+	uint8_t *data;        //frame data copy (yuv or raw for IMG_FMT_RAW) - kept for reuse
+	size_t data_max_size; //allocated size for data
+	size_t size;          //frame data size
+	int width;
+	int height;
+	int format;           //IMG_FMT_*
+	char *filename;
+} snapshot_job_t;
+
+struct _snapshot_pool_t;
+
+typedef struct _snapshot_worker_t
+{
+	__THREAD_TYPE thread;
+	struct _snapshot_pool_t *pool;
+	snapshot_job_t job;       //worker owned job (swapped with the ring slot, so buffers are reused)
+	int busy;                 //saving job (don't touch job.data)
+} snapshot_worker_t;
+
+typedef struct _snapshot_pool_t
+{
+	snapshot_worker_t *workers;
+	int nthreads;
+
+	snapshot_job_t *jobs;     //job ring
+	int queue_size;           //ring size
+	int head;                 //oldest queued job
+	int count;                //queued jobs
+	int busy;                 //jobs being saved
+
+	int policy;               //SNAPSHOT_DROP_OLDEST, SNAPSHOT_BLOCK or SNAPSHOT_SKIP
+	snapshot_done_cb_t callback;
+	void *data;               //callback user data
+
+	__MUTEX_TYPE mutex;
+	__COND_TYPE cond_job;     //signaled when a job is queued (or on quit)
+	__COND_TYPE cond_space;   //signaled when a job is taken or done
+
+	int quit;
+
+	uint64_t saved;
+	uint64_t dropped;
+} snapshot_pool_t;
+
+/*
+ * snapshot worker thread: takes the oldest job and saves it
+ * args:
+ *   data - pointer to worker data
+ *
+ * asserts:
+ *   data is not null
+ *
+ * returns: NULL
+ */
+static void *snapshot_worker(void *data)
+{
+	snapshot_worker_t *worker = (snapshot_worker_t *) data;
+	assert(worker != NULL);
+
+	snapshot_pool_t *pool = worker->pool;
+	snapshot_job_t *job = &worker->job;
+
+	__LOCK_MUTEX(__SMUTEX);
+	while(1)
+	{
+		if(pool->count == 0)
+		{
+			/*only quit with an empty queue (pending snapshots are saved)*/
+			if(pool->quit)
+				break;
+
+			__COND_WAIT(&pool->cond_job, __SMUTEX);
+			continue;
+		}
+
+		snapshot_job_t *slot = &pool->jobs[pool->head];
+
+		snapshot_job_t tmp = *job;
+		*job = *slot;
+		*slot = tmp;
+		slot->filename = NULL;
+
+		pool->head = (pool->head + 1) % pool->queue_size;
+		pool->count--;
+		pool->busy++;
+		worker->busy = 1;
+		__COND_BCAST(&pool->cond_space);
+		__UNLOCK_MUTEX(__SMUTEX);
+
+		v4l2_frame_buff_t frame;
+		memset(&frame, 0, sizeof(v4l2_frame_buff_t));
+		frame.raw_frame = job->data;
+		frame.raw_frame_size = job->size;
+		frame.yuv_frame = job->data;
+
+		int ret = save_image_frame(&frame, job->width, job->height, job->filename, job->format);
+		if(ret != E_OK)
+			fprintf(stderr, "V4L2_CORE: (snapshot) couldn't save %s (error %i)\n", job->filename, ret);
+
+		if(pool->callback != NULL)
+			pool->callback(job->filename, ret, pool->data);
+
+		free(job->filename);
+		job->filename = NULL;
+
+		__LOCK_MUTEX(__SMUTEX);
+		worker->busy = 0;
+		pool->busy--;
+		if(ret == E_OK)
+			pool->saved++;
+		__COND_BCAST(&pool->cond_space);
+	}
+	__UNLOCK_MUTEX(__SMUTEX);
+
+	return NULL;
+}
+
+/*
+ * start the snapshot worker pool: images are copied into a bounded
+ *  queue by v4l2core_snapshot_queue and saved in the background
+ * args:
+ *   vd - pointer to video device data
+ *   workers - number of worker threads (<= 0 - one)
+ *   queue_size - max queued snapshots (<= 0 - 2 x workers)
+ *   policy - full queue policy: SNAPSHOT_DROP_OLDEST, SNAPSHOT_BLOCK or SNAPSHOT_SKIP
+ *   callback - called (from a worker thread) when a snapshot is done or dropped (can be NULL)
+ *   data - callback user data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_snapshot_start(
+	v4l2_dev_t *vd,
+	int workers,
+	int queue_size,
+	int policy,
+	snapshot_done_cb_t callback,
+	void *data)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(vd->snapshot != NULL)
+		v4l2core_snapshot_stop(vd);
+
+	if(workers <= 0)
+		workers = 1;
+	if(workers > SNAPSHOT_MAX_WORKERS)
+		workers = SNAPSHOT_MAX_WORKERS;
+	if(queue_size <= 0)
+		queue_size = 2 * workers;
+
+	snapshot_pool_t *pool = calloc(1, sizeof(snapshot_pool_t));
+	if(pool == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_snapshot_start): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	pool->jobs = calloc(queue_size, sizeof(snapshot_job_t));
+	pool->workers = calloc(workers, sizeof(snapshot_worker_t));
+	if(pool->jobs == NULL || pool->workers == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_snapshot_start): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	pool->queue_size = queue_size;
+	pool->policy = policy;
+	pool->callback = callback;
+	pool->data = data;
+
+	__INIT_MUTEX(__SMUTEX);
+	__INIT_COND(&pool->cond_job);
+	__INIT_COND(&pool->cond_space);
+
+	int i = 0;
+	for(i = 0; i < workers; ++i)
+	{
+		snapshot_worker_t *worker = &pool->workers[i];
+		worker->pool = pool;
+
+		if(__THREAD_CREATE(&worker->thread, snapshot_worker, (void *) worker))
+		{
+			fprintf(stderr, "V4L2_CORE: (snapshot) couldn't create worker %i\n", i);
+			break;
+		}
+		pool->nthreads++;
+	}
+
+	vd->snapshot = pool;
+
+	if(pool->nthreads == 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (snapshot) no workers - saving images in the capture thread\n");
+		v4l2core_snapshot_stop(vd);
+		return E_OK;
+	}
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: (snapshot) %i workers, queue size %i\n", pool->nthreads, pool->queue_size);
+
+	return E_OK;
+}
+
+/*
+ * queue a copy of the frame to be saved by the snapshot workers
+ *  (saves it right away if the worker pool is not running)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to (decoded) frame buffer
+ *   filename - output file name
+ *   format - image type (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *   filename is not null
+ *
+ * returns: error code (E_OK or E_NO_DATA if skipped - full queue)
+ */
+int v4l2core_snapshot_queue(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename, int format)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+	assert(filename != NULL);
+
+	snapshot_pool_t *pool = vd->snapshot;
+
+	if(pool == NULL)
+	{
+		int ret = save_frame_image(vd, frame, filename, format);
+		return ret;
+	}
+
+	int width = vd->format.fmt.pix.width;
+	int height = vd->format.fmt.pix.height;
+
+	uint8_t *src = frame->yuv_frame;
+#ifdef USE_PLANAR_YUV
+	size_t size = (size_t) width * height * 3 / 2;
+#else
+	size_t size = (size_t) width * height * 2;
+#endif
+	if(format == IMG_FMT_RAW)
+	{
+		src = frame->raw_frame;
+		size = frame->raw_frame_size;
+	}
+
+	char *dropped_filename = NULL;
+
+	__LOCK_MUTEX(__SMUTEX);
+
+	if(pool->count >= pool->queue_size)
+	{
+		switch(pool->policy)
+		{
+			case SNAPSHOT_SKIP:
+				pool->dropped++;
+				__UNLOCK_MUTEX(__SMUTEX);
+				if(verbosity > 0)
+					printf("V4L2_CORE: (snapshot) queue full - skipping %s\n", filename);
+				return E_NO_DATA;
+
+			case SNAPSHOT_BLOCK:
+				while(pool->count >= pool->queue_size)
+					__COND_WAIT(&pool->cond_space, __SMUTEX);
+				break;
+
+			case SNAPSHOT_DROP_OLDEST:
+			default:
+			{
+				/*reuse the oldest slot (its buffer stays in the ring)*/
+				snapshot_job_t *oldest = &pool->jobs[pool->head];
+				dropped_filename = oldest->filename;
+				oldest->filename = NULL;
+				pool->head = (pool->head + 1) % pool->queue_size;
+				pool->count--;
+				pool->dropped++;
+				break;
+			}
+		}
+	}
+
+	snapshot_job_t *job = &pool->jobs[(pool->head + pool->count) % pool->queue_size];
+
+	if(job->data_max_size < size)
+	{
+		free(job->data);
+		job->data = malloc(size);
+		if(job->data == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_snapshot_queue): %s\n", strerror(errno));
+			exit(-1);
+		}
+		job->data_max_size = size;
+	}
+
+	/*copy with the lock held (safe to queue from more than one thread)*/
+	memcpy(job->data, src, size);
+	job->size = size;
+	job->width = width;
+	job->height = height;
+	job->format = format;
+	job->filename = strdup(filename);
+
+	pool->count++;
+	__COND_SIGNAL(&pool->cond_job);
+	__UNLOCK_MUTEX(__SMUTEX);
+
+	if(dropped_filename != NULL)
+	{
+		if(verbosity > 0)
+			printf("V4L2_CORE: (snapshot) queue full - dropping %s\n", dropped_filename);
+		if(pool->callback != NULL)
+			pool->callback(dropped_filename, E_NO_DATA, pool->data);
+		free(dropped_filename);
+	}
+
+	return E_OK;
+}
+
+/*
+ * grow the snapshot queue to hold nframes and preallocate the frame
+ *  buffers for the current format, so a burst of nframes consecutive
+ *  frames is queued without blocking or allocating
+ * args:
+ *   vd - pointer to video device data
+ *   nframes - number of frames to reserve
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK or E_NO_DATA if the worker pool is not running)
+ */
+int v4l2core_snapshot_reserve(v4l2_dev_t *vd, int nframes)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	snapshot_pool_t *pool = vd->snapshot;
+	if(pool == NULL)
+		return E_NO_DATA;
+
+	/*raw frames may be bigger than the yuv frame: size for the largest*/
+	size_t size = (size_t) vd->format.fmt.pix.width * vd->format.fmt.pix.height * 2;
+	if(size < vd->format.fmt.pix.sizeimage)
+		size = vd->format.fmt.pix.sizeimage;
+
+	int i = 0;
+
+	__LOCK_MUTEX(__SMUTEX);
+
+	if(nframes > pool->queue_size)
+	{
+		snapshot_job_t *jobs = calloc(nframes, sizeof(snapshot_job_t));
+		if(jobs == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_snapshot_reserve): %s\n", strerror(errno));
+			exit(-1);
+		}
+
+		/*queued jobs first (in order) then the free slots*/
+		for(i = 0; i < pool->queue_size; ++i)
+			jobs[i] = pool->jobs[(pool->head + i) % pool->queue_size];
+
+		free(pool->jobs);
+		pool->jobs = jobs;
+		pool->head = 0;
+		pool->queue_size = nframes;
+	}
+
+	/*free ring slots and idle worker jobs (they are swapped into the ring)*/
+	int njobs = pool->queue_size + pool->nthreads;
+	for(i = pool->count; i < njobs; ++i)
+	{
+		snapshot_job_t *job = NULL;
+		if(i < pool->queue_size)
+			job = &pool->jobs[(pool->head + i) % pool->queue_size];
+		else if(!pool->workers[i - pool->queue_size].busy)
+			job = &pool->workers[i - pool->queue_size].job;
+
+		if(job == NULL || job->data_max_size >= size)
+			continue;
+
+		free(job->data);
+		job->data = malloc(size);
+		if(job->data == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_snapshot_reserve): %s\n", strerror(errno));
+			exit(-1);
+		}
+		job->data_max_size = size;
+	}
+
+	__UNLOCK_MUTEX(__SMUTEX);
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: (snapshot) reserved %i frames of %zu bytes\n", pool->queue_size, size);
+
+	return E_OK;
+}
+
+/*
+ * get the number of snapshots queued or being saved
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: pending snapshots
+ */
+int v4l2core_snapshot_pending(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	snapshot_pool_t *pool = vd->snapshot;
+	if(pool == NULL)
+		return 0;
+
+	__LOCK_MUTEX(__SMUTEX);
+	int pending = pool->count + pool->busy;
+	__UNLOCK_MUTEX(__SMUTEX);
+
+	return pending;
+}
+
+/*
+ * stop the snapshot worker pool (pending snapshots are saved first)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_snapshot_stop(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	snapshot_pool_t *pool = vd->snapshot;
+	if(pool == NULL)
+		return;
+
+	__LOCK_MUTEX(__SMUTEX);
+	pool->quit = 1;
+	__COND_BCAST(&pool->cond_job);
+	__UNLOCK_MUTEX(__SMUTEX);
+
+	int i = 0;
+	for(i = 0; i < pool->nthreads; ++i)
+		__THREAD_JOIN(pool->workers[i].thread);
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: (snapshot) %" PRIu64 " images saved, %" PRIu64 " dropped\n",
+			pool->saved, pool->dropped);
+
+	/*free the ring buffers*/
+	for(i = 0; i < pool->queue_size; ++i)
+	{
+		free(pool->jobs[i].data);
+		free(pool->jobs[i].filename);
+	}
+	for(i = 0; i < pool->nthreads; ++i)
+		free(pool->workers[i].job.data);
+
+	__CLOSE_COND(&pool->cond_space);
+	__CLOSE_COND(&pool->cond_job);
+	__CLOSE_MUTEX(__SMUTEX);
+
+	free(pool->jobs);
+	free(pool->workers);
+	free(pool);
+
+	vd->snapshot = NULL;
+}
@@ -79,11 +79,9 @@ typedef struct _focus_ctx_t
 	int setFocus;
 	int focus_wait;
 	int last_focus;
+	double sumAC[64];
 } focus_ctx_t;
 
-static focus_ctx_t *focus_ctx = NULL;
-
-static double sumAC[64];
 static int ACweight[64] = {
 	0,1,2,3,4,5,6,7,
 	1,1,2,3,4,5,6,7,
@@ -100,17 +98,21 @@ static int sort_method = AUTOF_SORT_INSERT; /* 1 - Quick sort   2 - Shell sort
 /*
  * sets a focus loop while autofocus is on
  * args:
- *    none
+ *    vd - pointer to device data
  *
  * asserts:
- *    focus_ctx is not null
+ *    vd is not null
+ *    vd->focus_ctx is not null
  *
  * returns: none
  */
-void v4l2core_soft_autofocus_set_focus()
+void v4l2core_soft_autofocus_set_focus(v4l2_dev_t *vd)
 {
 	/*asserts*/
-	assert(focus_ctx != NULL);
+	assert(vd != NULL);
+	assert(vd->focus_ctx != NULL);
+
+	focus_ctx_t *focus_ctx = vd->focus_ctx;
 
 	focus_ctx->setFocus = 1;
 
@@ -157,23 +159,25 @@ int soft_autofocus_init (v4l2_dev_t *vd)
 		return (E_UNKNOWN_CID_ERR);
 	}
 
-	if(focus_ctx != NULL)
-		free(focus_ctx);
+	if(vd->focus_ctx != NULL)
+		free(vd->focus_ctx);
 
-	focus_ctx = calloc(1, sizeof(focus_ctx_t));
+	focus_ctx_t *focus_ctx = calloc(1, sizeof(focus_ctx_t));
 	if(focus_ctx == NULL)
 	{
 		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_soft_autofocus_init): %s\n", strerror(errno));
 		exit(-1);
 	}
 
-    focus_ctx->focus_control = v4l2core_get_control_by_id(vd->has_focus_control_id);
+	vd->focus_ctx = focus_ctx;
+
+    focus_ctx->focus_control = v4l2core_get_control_by_id(vd, vd->has_focus_control_id);
 
     if(focus_ctx->focus_control == NULL)
 	{
 		fprintf(stderr, "V4L2_CORE: couldn't load focus control for id %x\n", vd->has_focus_control_id);
 		free(focus_ctx);
-		focus_ctx = NULL;
+		vd->focus_ctx = NULL;
 		return(E_UNKNOWN_CID_ERR);
 	}
 
@@ -195,8 +199,6 @@ int soft_autofocus_init (v4l2_dev_t *vd)
 	if (focus_ctx->last_focus < 0)
 		focus_ctx->last_focus = focus_ctx->f_max;
 
-	memset(sumAC, 0, 64*sizeof(*sumAC)); /*reset array to 0*/
-
 	return (E_OK);
 }
 
@@ -204,6 +206,7 @@ int soft_autofocus_init (v4l2_dev_t *vd)
  * quick sort
  * (the fastest and more complex - recursive, doesn't do well on almost sorted data)
  * args:
+ *   focus_ctx - pointer to autofocus context
  *   left -
  *   right -
  *
@@ -212,7 +215,7 @@ int soft_autofocus_init (v4l2_dev_t *vd)
  *
  * returns: none
  */
-static void q_sort(int left, int right)
+static void q_sort(focus_ctx_t *focus_ctx, int left, int right)
 {
 	/*asserts*/
 	assert(focus_ctx != NULL);
@@ -245,8 +248,8 @@ static void q_sort(int left, int right)
 	focus_ctx->arr_foc[left] = temp;
 	pivot = left;
 
-	if (l_hold < pivot) q_sort(l_hold, pivot-1);
-	if (r_hold > pivot) q_sort(pivot+1, r_hold);
+	if (l_hold < pivot) q_sort(focus_ctx, l_hold, pivot-1);
+	if (r_hold > pivot) q_sort(focus_ctx, pivot+1, r_hold);
 }
 
 /*
@@ -254,6 +257,7 @@ static void q_sort(int left, int right)
  * (based on insert sort, but with some optimization)
  * for small arrays insert sort is still faster
  * args:
+ *    focus_ctx - pointer to autofocus context
  *    size -
  *
  * asserts:
@@ -261,7 +265,7 @@ static void q_sort(int left, int right)
  *
  * returns: none
  */
-static void s_sort(int size)
+static void s_sort(focus_ctx_t *focus_ctx, int size)
 {
 	/*asserts*/
 	assert(focus_ctx != NULL);
@@ -285,6 +289,7 @@ static void s_sort(int size)
  * insert sort
  * (fastest for small arrays, around 15 elements)
  * args:
+ *    focus_ctx - pointer to autofocus context
  *    size -
  *
  * asserts:
@@ -292,7 +297,7 @@ static void s_sort(int size)
  *
  * returns: none
  */
-static void i_sort (int size)
+static void i_sort (focus_ctx_t *focus_ctx, int size)
 {
 	/*asserts*/
 	assert(focus_ctx != NULL);
@@ -315,6 +320,7 @@ static void i_sort (int size)
  * it did better than shell or quick sort since focus data is almost
  * sorted)
  * args:
+ *    focus_ctx - pointer to autofocus context
  *    size -
  *
  * asserts:
@@ -322,7 +328,7 @@ static void i_sort (int size)
  *
  * returns: none
  */
-static void b_sort (int size)
+static void b_sort (focus_ctx_t *focus_ctx, int size)
 {
 	int i, temp, swapped;
 
@@ -345,11 +351,12 @@ static void b_sort (int size)
 /*
  * sort focus values
  * args:
+ *    focus_ctx - pointer to autofocus context
  *    size - focus array size
  *
  * returns: best focus value
  */
-static int focus_sort(int size)
+static int focus_sort(focus_ctx_t *focus_ctx, int size)
 {
 	if (size>=20)
 	{
@@ -360,20 +367,20 @@ static int focus_sort(int size)
 	switch(sort_method)
 	{
 		case AUTOF_SORT_QUICK:
-			q_sort(0, size);
+			q_sort(focus_ctx, 0, size);
 			break;
 
 		case AUTOF_SORT_SHELL:
-			s_sort(size);
+			s_sort(focus_ctx, size);
 			break;
 
 		case AUTOF_SORT_BUBBLE:
-			b_sort(size);
+			b_sort(focus_ctx, size);
 			break;
 
 		default:
 		case AUTOF_SORT_INSERT:
-			i_sort(size);
+			i_sort(focus_ctx, size);
 			break;
 	}
 
@@ -414,14 +421,14 @@ static int16_t *focus_extract_Y (uint8_t *frame, int16_t *dataY, int width, int
 /*
  * check focus
  * args:
- *    none
+ *    focus_ctx - pointer to autofocus context
  *
  * asserts:
  *    focus_ctx is not null
  *
  * returns: focus code
  */
-static int checkFocus()
+static int checkFocus(focus_ctx_t *focus_ctx)
 {
 	/*asserts*/
 	assert(focus_ctx != NULL);
@@ -483,6 +490,7 @@ static int checkFocus()
 /*
  * measure sharpness in MCU
  * args:
+ *    focus_ctx - pointer to autofocus context
  *    data - MCU data [8x8]
  *    weight - MCU weight for sharpness measure.
  *
@@ -491,7 +499,7 @@ static int checkFocus()
  *
  * returns: none
  */
-static void getSharpnessMCU (int16_t *data, double weight)
+static void getSharpnessMCU (focus_ctx_t *focus_ctx, int16_t *data, double weight)
 {
 
 	int i=0;
@@ -504,7 +512,7 @@ static void getSharpnessMCU (int16_t *data, double weight)
 	{
 		for(j=0;j<8;j++)
 		{
-			sumAC[i*8+j]+=data[i*8+j]*data[i*8+j]*weight;
+			focus_ctx->sumAC[i*8+j]+=data[i*8+j]*data[i*8+j]*weight;
 		}
 	}
 }
@@ -512,6 +520,7 @@ static void getSharpnessMCU (int16_t *data, double weight)
 /*
  * sharpness in focus window
  * args:
+ *    vd - pointer to device data
  *    frame - pointer to image frame
  *    width - frame width
  *    height - frame height
@@ -522,8 +531,13 @@ static void getSharpnessMCU (int16_t *data, double weight)
  *
  * returns: sharpness value
  */
-int soft_autofocus_get_sharpness (uint8_t *frame, int width, int height, int t)
+int soft_autofocus_get_sharpness (v4l2_dev_t *vd, uint8_t *frame, int width, int height, int t)
 {
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->focus_ctx != NULL);
+
+	focus_ctx_t *focus_ctx = vd->focus_ctx;
 	float res=0;
 	int numMCUx = width/(8*2); /*covers 1/2 of width - width should be even*/
 	int numMCUy = height/(8*2); /*covers 1/2 of height- height should be even*/
@@ -571,7 +585,7 @@ int soft_autofocus_get_sharpness (uint8_t *frame, int width, int height, int t)
 						+(((width-(numMCUx-(xp*2))*8)>>1)+j)];
 				}
 			}
-			getSharpnessMCU(data,weight);
+			getSharpnessMCU(focus_ctx, data, weight);
 			cnt2++;
 		}
 	}
@@ -582,8 +596,8 @@ int soft_autofocus_get_sharpness (uint8_t *frame, int width, int height, int t)
 	{
 		for(j=0;j<t;j++)
 		{
-			sumAC[i*8+j]/=(double) (cnt2); /*average = mean*/
-			res+=sumAC[i*8+j]*ACweight[i*8+j];
+			focus_ctx->sumAC[i*8+j]/=(double) (cnt2); /*average = mean*/
+			res+=focus_ctx->sumAC[i*8+j]*ACweight[i*8+j];
 		}
 	}
 	return (roundf(res*10)); /*round to int (4 digit precision)*/
@@ -592,15 +606,21 @@ int soft_autofocus_get_sharpness (uint8_t *frame, int width, int height, int t)
 /*
  * get focus value
  * args:
- *    none
+ *    vd - pointer to device data
  *
  * asserts:
- *    focus_ctx is not null
+ *    vd is not null
+ *    vd->focus_ctx is not null
  *
  * returns: focus code
  */
-int soft_autofocus_get_focus_value()
+int soft_autofocus_get_focus_value(v4l2_dev_t *vd)
 {
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->focus_ctx != NULL);
+
+	focus_ctx_t *focus_ctx = vd->focus_ctx;
 	int step = focus_ctx->i_step * 2;
 	int step2 = focus_ctx->i_step / 2;
 	if (step2 <= 0 ) step2 = 1;
@@ -621,7 +641,7 @@ int soft_autofocus_get_focus_value()
 			/*reached max focus value*/
 			if (focus_ctx->focus >= focus_ctx->right )
 			{	/*get left and right from arr_sharp*/
-				focus = focus_sort(focus_ctx->ind);
+				focus = focus_sort(focus_ctx, focus_ctx->ind);
 				/*get a window around the best value*/
 				focus_ctx->left = (focus- step/2);
 				focus_ctx->right = (focus + step/2);
@@ -645,7 +665,7 @@ int soft_autofocus_get_focus_value()
 			/*reached window max focus*/
 			if (focus_ctx->focus >= focus_ctx->right )
 			{	/*get left and right from arr_sharp*/
-				focus = focus_sort(focus_ctx->ind);
+				focus = focus_sort(focus_ctx, focus_ctx->ind);
 				/*get the best value*/
 				focus_ctx->focus = focus;
 				focus_ctx->focus_sharpness = focus_ctx->arr_sharp[focus_ctx->ind];
@@ -693,7 +713,7 @@ int soft_autofocus_get_focus_value()
 			/*track focus*/
 			focus_ctx->sharpLeft=focus_ctx->sharpness;
 			int ret=0;
-			ret = checkFocus();
+			ret = checkFocus(focus_ctx);
 
 			switch (ret)
 			{
@@ -774,6 +794,9 @@ int soft_autofocus_run(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 {
 	/*asserts*/
 	assert(vd != NULL);
+	assert(vd->focus_ctx != NULL);
+
+	focus_ctx_t *focus_ctx = vd->focus_ctx;
 
 	if (focus_ctx->focus < 0)
 	{
@@ -781,7 +804,7 @@ int soft_autofocus_run(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 		focus_ctx->focus = focus_ctx->left; /*start left*/
 
 		focus_ctx->focus_control->value = focus_ctx->focus;
-		if (v4l2core_set_control_value_by_id(focus_ctx->focus_control->control.id) != 0)
+		if (v4l2core_set_control_value_by_id(vd, focus_ctx->focus_control->control.id) != 0)
 			fprintf(stderr, "V4L2_CORE: (sof_autofocus) couldn't set focus to %d\n", focus_ctx->focus);
 
 		/*number of frames until focus is stable*/
@@ -794,6 +817,7 @@ int soft_autofocus_run(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 		if (focus_ctx->focus_wait == 0)
 		{
 			focus_ctx->sharpness = soft_autofocus_get_sharpness (
+				vd,
 				frame->yuv_frame,
 				vd->format.fmt.pix.width,
 				vd->format.fmt.pix.height,
@@ -809,12 +833,12 @@ int soft_autofocus_run(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 					focus_ctx->ind,
 					focus_ctx->flag);
 
-			focus_ctx->focus = soft_autofocus_get_focus_value();
+			focus_ctx->focus = soft_autofocus_get_focus_value(vd);
 
 			if ((focus_ctx->focus != focus_ctx->last_focus))
 			{
 				focus_ctx->focus_control->value = focus_ctx->focus;
-				if (v4l2core_set_control_value_by_id(focus_ctx->focus_control->control.id) != 0)
+				if (v4l2core_set_control_value_by_id(vd, focus_ctx->focus_control->control.id) != 0)
 					fprintf(stderr, "V4L2_CORE: (sof_autofocus) couldn't set focus to %d\n",
 						focus_ctx->focus);
 
@@ -839,16 +863,19 @@ int soft_autofocus_run(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 /*
  * close and clean software autofocus
  * args:
- *   none
+ *   vd - pointer to device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: none
  */
-void v4l2core_soft_autofocus_close()
+void v4l2core_soft_autofocus_close(v4l2_dev_t *vd)
 {
-	if(focus_ctx != NULL)
-		free(focus_ctx);
-	focus_ctx = NULL;
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(vd->focus_ctx != NULL)
+		free(vd->focus_ctx);
+	vd->focus_ctx = NULL;
 }
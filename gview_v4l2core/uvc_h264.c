@@ -60,6 +60,7 @@
 
 #include "uvc_h264.h"
 #include "v4l2_formats.h"
+#include "colorspaces.h"
 
 // GUID of the UVC H.264 extension unit: {A29E7641-DE04-47E3-8B2B-F4341AFF003B}
 #define GUID_UVCX_H264_XU {0x41, 0x76, 0x9E, 0xA2, 0x04, 0xDE, 0xE3, 0x47, 0x8B, 0x2B, 0xF4, 0x34, 0x1A, 0xFF, 0x00, 0x3B}
@@ -74,14 +75,12 @@ typedef struct _h264_decoder_context_t
 
 	int width;
 	int height;
-	int pic_size;
 
-} h264_decoder_context_t;
-
-static h264_decoder_context_t *h264_ctx = NULL;
+	int resync;   /*decoding was paused: flush and wait for a new IDR*/
+	int wait_idr; /*no output until an IDR frame is decoded (references are gone)*/
+	int bad_fmt;  /*unsupported decoder output was already reported*/
 
-/*h264 support type*/
-static int h264_support = H264_NONE; /*none by default*/
+} h264_decoder_context_t;
 
 /*
  * request a IDR frame from the H264 encoder
@@ -101,16 +100,19 @@ void h264_request_idr(v4l2_dev_t *vd)
 /*
  * get h264 support type
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: support type (H264_NONE; H264_MUXED; H264_FRAME)
  */
-int h264_get_support()
+int h264_get_support(v4l2_dev_t *vd)
 {
-	return h264_support;
+	/*asserts*/
+	assert(vd != NULL);
+
+	return vd->h264_support;
 }
 
 /*
@@ -179,7 +181,7 @@ static int uvcx_video_encoder_reset(v4l2_dev_t *vd)
 
 	int err = 0;
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_ENCODER_RESET, UVC_SET_CUR, &encoder_reset_req)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_ENCODER_RESET, UVC_SET_CUR, &encoder_reset_req)) < 0)
 		fprintf(stderr, "V4L2_CORE: (UVCX_ENCODER_RESET) error: %s\n", strerror(errno));
 
 	return err;
@@ -205,7 +207,7 @@ static int uvcx_video_probe(v4l2_dev_t *vd, uint8_t query, uvcx_video_config_pro
 	int err = 0;
 
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_VIDEO_CONFIG_PROBE, query, uvcx_video_config)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_VIDEO_CONFIG_PROBE, query, uvcx_video_config)) < 0)
 		fprintf(stderr, "V4L2_CORE: (UVCX_VIDEO_CONFIG_PROBE) error: %s\n", strerror(errno));
 
 	return err;
@@ -229,7 +231,7 @@ static int uvcx_video_commit(v4l2_dev_t *vd, uvcx_video_config_probe_commit_t *u
 
 	int err = 0;
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_VIDEO_CONFIG_COMMIT, UVC_SET_CUR, uvcx_video_config)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_VIDEO_CONFIG_COMMIT, UVC_SET_CUR, uvcx_video_config)) < 0)
 		fprintf(stderr, "V4L2_CORE: (UVCX_VIDEO_CONFIG_COMMIT) error: %s\n", strerror(errno));
 
 	return err;
@@ -287,7 +289,7 @@ int check_h264_support(v4l2_dev_t *vd)
 
 	uvcx_version_t uvcx_version;
 
-	if(v4l2core_query_xu_control(vd->h264_unit_id, UVCX_VERSION, UVC_GET_CUR, &uvcx_version) < 0)
+	if(v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_VERSION, UVC_GET_CUR, &uvcx_version) < 0)
 	{
 		if(verbosity > 0)
 			printf("V4L2_CORE: device doesn't seem to support uvc H264 in unit_id %d\n", vd->h264_unit_id);
@@ -320,12 +322,12 @@ void add_h264_format(v4l2_dev_t *vd)
 	if(verbosity > 0)
 		printf("V4L2_CORE: checking muxed H264 format support\n");
 
-	if(v4l2core_get_frame_format_index(V4L2_PIX_FMT_H264) >= 0)
+	if(v4l2core_get_frame_format_index(vd, V4L2_PIX_FMT_H264) >= 0)
 	{
 		if(verbosity > 0)
 			printf("V4L2_CORE: H264 format already in list\n");
 
-		h264_support = H264_FRAME;
+		vd->h264_support = H264_FRAME;
 		/*check the h264 unit id (if any) */
 		get_uvc_h624_unit_id(vd);
 
@@ -334,17 +336,17 @@ void add_h264_format(v4l2_dev_t *vd)
 
 	if(get_uvc_h624_unit_id(vd) <= 0)
 	{
-		h264_support = H264_NONE;
+		vd->h264_support = H264_NONE;
 		return; /*no unit id found for h264*/
 	}
 
 	if(!check_h264_support(vd))
 	{
-		h264_support = H264_NONE;
+		vd->h264_support = H264_NONE;
 		return; /*no XU support for h264*/
 	}
 
-	int mjpg_index = v4l2core_get_frame_format_index(V4L2_PIX_FMT_MJPEG);
+	int mjpg_index = v4l2core_get_frame_format_index(vd, V4L2_PIX_FMT_MJPEG);
 	if(mjpg_index < 0) /*MJPG must be available for muxed uvc H264 streams*/
 		return;
 
@@ -353,7 +355,7 @@ void add_h264_format(v4l2_dev_t *vd)
 		printf("V4L2_CORE: adding muxed H264 format\n");
 
 	/*if we got here then muxed h264 is supported*/
-	h264_support = H264_MUXED;
+	vd->h264_support = H264_MUXED;
 
 	vd->numb_formats++; /*increment number of formats*/
 	int fmtind = vd->numb_formats;
@@ -528,7 +530,7 @@ int request_h264_frame_type(v4l2_dev_t *vd, uint16_t type)
 
 	int err = E_OK;
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_PICTURE_TYPE_CONTROL, UVC_SET_CUR, &picture_type_req)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_PICTURE_TYPE_CONTROL, UVC_SET_CUR, &picture_type_req)) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_PICTURE_TYPE_CONTROL) SET_CUR error: %s\n", strerror(errno));
 	}
@@ -581,7 +583,7 @@ uint8_t  h264_get_video_rate_control_mode(v4l2_dev_t *vd, uint8_t query)
 	uvcx_rate_control_mode_t rate_control_mode_req;
 	rate_control_mode_req.wLayerID = 0;
 
-	if((v4l2core_query_xu_control(vd->h264_unit_id, UVCX_RATE_CONTROL_MODE, query, &rate_control_mode_req)) < 0)
+	if((v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_RATE_CONTROL_MODE, query, &rate_control_mode_req)) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_RATE_CONTROL_MODE) query (%u) error: %s\n", query, strerror(errno));
 		return 0xff;
@@ -619,7 +621,7 @@ int h264_set_video_rate_control_mode(v4l2_dev_t *vd, uint8_t mode)
 
 	int err = E_OK;
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_RATE_CONTROL_MODE, UVC_SET_CUR, &rate_control_mode_req)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_RATE_CONTROL_MODE, UVC_SET_CUR, &rate_control_mode_req)) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_RATE_CONTROL_MODE) SET_CUR error: %s\n", strerror(errno));
 	}
@@ -653,7 +655,7 @@ uint8_t h264_get_temporal_scale_mode(v4l2_dev_t *vd, uint8_t query)
 	uvcx_temporal_scale_mode_t temporal_scale_mode_req;
 	temporal_scale_mode_req.wLayerID = 0;
 
-	if(v4l2core_query_xu_control(vd->h264_unit_id, UVCX_TEMPORAL_SCALE_MODE, query, &temporal_scale_mode_req) < 0)
+	if(v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_TEMPORAL_SCALE_MODE, query, &temporal_scale_mode_req) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_TEMPORAL_SCALE_MODE) query (%u) error: %s\n", query, strerror(errno));
 		return 0xff;
@@ -691,7 +693,7 @@ int h264_set_temporal_scale_mode(v4l2_dev_t *vd, uint8_t mode)
 
 	int err = 0;
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_TEMPORAL_SCALE_MODE, UVC_SET_CUR, &temporal_scale_mode_req)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_TEMPORAL_SCALE_MODE, UVC_SET_CUR, &temporal_scale_mode_req)) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_TEMPORAL_SCALE_MODE) SET_CUR error: %s\n", strerror(errno));
 	}
@@ -725,7 +727,7 @@ uint8_t h264_get_spatial_scale_mode(v4l2_dev_t *vd, uint8_t query)
 	uvcx_spatial_scale_mode_t spatial_scale_mode_req;
 	spatial_scale_mode_req.wLayerID = 0;
 
-	if(v4l2core_query_xu_control(vd->h264_unit_id, UVCX_SPATIAL_SCALE_MODE, query, &spatial_scale_mode_req) < 0)
+	if(v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_SPATIAL_SCALE_MODE, query, &spatial_scale_mode_req) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_SPATIAL_SCALE_MODE) query (%u) error: %s\n", query, strerror(errno));
 		return 0xff;
@@ -763,7 +765,7 @@ int h264_set_spatial_scale_mode(v4l2_dev_t *vd, uint8_t mode)
 
 	int err = 0;
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_SPATIAL_SCALE_MODE, UVC_SET_CUR, &spatial_scale_mode_req)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_SPATIAL_SCALE_MODE, UVC_SET_CUR, &spatial_scale_mode_req)) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_SPATIAL_SCALE_MODE) SET_CUR error: %s\n", strerror(errno));
 	}
@@ -797,7 +799,7 @@ uint32_t h264_query_frame_rate_config(v4l2_dev_t *vd, uint8_t query)
 	uvcx_framerate_config_t framerate_req;
 	framerate_req.wLayerID = 0;
 
-	if(v4l2core_query_xu_control(vd->h264_unit_id, UVCX_FRAMERATE_CONFIG, query, &framerate_req) < 0)
+	if(v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_FRAMERATE_CONFIG, query, &framerate_req) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_FRAMERATE_CONFIG) query (%u) error: %s\n", query, strerror(errno));
 		return 0xffffffff;
@@ -850,7 +852,7 @@ int h264_set_frame_rate_config(v4l2_dev_t *vd, uint32_t framerate)
 
 	int err = 0;
 
-	if((err = v4l2core_query_xu_control(vd->h264_unit_id, UVCX_FRAMERATE_CONFIG, UVC_SET_CUR, &framerate_req)) < 0)
+	if((err = v4l2core_query_xu_control(vd, vd->h264_unit_id, UVCX_FRAMERATE_CONFIG, UVC_SET_CUR, &framerate_req)) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: (UVCX_FRAMERATE_CONFIG) SET_CUR error: %s\n", strerror(errno));
 	}
@@ -918,16 +920,20 @@ int h264_probe_config_probe_req(
 /*
  * init h264 decoder context
  * args:
+ *    vd - pointer to video device data
  *    width - image width
  *    height - image height
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: error code (0 - E_OK)
  */
-int h264_init_decoder(int width, int height)
+int h264_init_decoder(v4l2_dev_t *vd, int width, int height)
 {
+	/*asserts*/
+	assert(vd != NULL);
+
 #if !LIBAVCODEC_VER_AT_LEAST(53,34)
 	avcodec_init();
 #endif
@@ -937,10 +943,10 @@ int h264_init_decoder(int width, int height)
 	 */
 	avcodec_register_all();
 	
-	if(h264_ctx != NULL)
-		h264_close_decoder();
-	
-	h264_ctx = calloc(1, sizeof(h264_decoder_context_t));
+	if(vd->h264_ctx != NULL)
+		h264_close_decoder(vd);
+
+	h264_decoder_context_t *h264_ctx = calloc(1, sizeof(h264_decoder_context_t));
 	if(h264_ctx == NULL)
 	{
 		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (h264_init_decoder): %s\n", strerror(errno));
@@ -952,7 +958,6 @@ int h264_init_decoder(int width, int height)
 	{
 		fprintf(stderr, "V4L2_CORE: (H264 decoder) codec not found (please install libavcodec-extra for H264 support)\n");
 		free(h264_ctx);
-		h264_ctx = NULL;
 		return E_NO_CODEC;
 	}
 	
@@ -975,6 +980,23 @@ int h264_init_decoder(int width, int height)
 	h264_ctx->context->height = height;
 	//h264_ctx->context->dsp_mask = (FF_MM_MMX | FF_MM_MMXEXT | FF_MM_SSE);
 
+	/*decoder threads (0 - codec default)*/
+	if(vd->h264_decoder_threads > 0)
+	{
+		h264_ctx->context->thread_count = vd->h264_decoder_threads;
+#ifdef FF_THREAD_FRAME
+		if(vd->h264_thread_type == H264_THREAD_FRAME)
+			h264_ctx->context->thread_type = FF_THREAD_FRAME;
+		else if(vd->h264_thread_type == H264_THREAD_SLICE)
+			h264_ctx->context->thread_type = FF_THREAD_SLICE;
+#endif
+		if(verbosity > 0)
+			printf("V4L2_CORE: (H264 decoder) using %i threads (%s)\n",
+				vd->h264_decoder_threads,
+				vd->h264_thread_type == H264_THREAD_FRAME ? "frame" :
+				(vd->h264_thread_type == H264_THREAD_SLICE ? "slice" : "auto"));
+	}
+
 #if LIBAVCODEC_VER_AT_LEAST(53,6)
 	if (avcodec_open2(h264_ctx->context, h264_ctx->codec, NULL) < 0)
 #else
@@ -985,7 +1007,6 @@ int h264_init_decoder(int width, int height)
 		avcodec_close(h264_ctx->context);
 		free(h264_ctx->context);
 		free(h264_ctx);
-		h264_ctx = NULL;
 		return E_NO_CODEC;
 	}
 	
@@ -996,43 +1017,170 @@ int h264_init_decoder(int width, int height)
 	h264_ctx->picture = avcodec_alloc_frame();
 	avcodec_get_frame_defaults(h264_ctx->picture);
 #endif
-	
-	h264_ctx->pic_size = avpicture_get_size(h264_ctx->context->pix_fmt, width, height);
+
 	h264_ctx->width = width;
 	h264_ctx->height = height;
 
+	vd->h264_ctx = h264_ctx;
+
 	return E_OK;
 }
 
+/*
+ * copy a decoded plane (skipping the line padding)
+ * args:
+ *    out - pointer to output plane
+ *    in - pointer to decoded plane
+ *    linesize - decoded plane line size
+ *    width - plane width
+ *    height - plane height
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void h264_copy_plane(uint8_t *out, uint8_t *in, int linesize, int width, int height)
+{
+	if(linesize == width)
+	{
+		memcpy(out, in, width * height);
+		return;
+	}
+
+	int h = 0;
+	for(h = 0; h < height; ++h)
+	{
+		memcpy(out, in, width);
+		out += width;
+		in += linesize;
+	}
+}
+
+/*
+ * store the decoded picture in the frame layout
+ *  (reads the AVFrame planes directly)
+ * args:
+ *    h264_ctx - pointer to h264 decoder context
+ *    out_buf - pointer to decoded data (yu12 or yuyv)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: error code (0 - E_OK)
+ */
+static int h264_store_picture(h264_decoder_context_t *h264_ctx, uint8_t *out_buf)
+{
+	AVFrame *picture = h264_ctx->picture;
+	int width = h264_ctx->width;
+	int height = h264_ctx->height;
+
+	if((h264_ctx->context->pix_fmt != PIX_FMT_YUV420P &&
+		h264_ctx->context->pix_fmt != PIX_FMT_YUVJ420P) ||
+		h264_ctx->context->width != width ||
+		h264_ctx->context->height != height)
+	{
+		if(!h264_ctx->bad_fmt)
+			fprintf(stderr, "V4L2_CORE: (H264 decoder) unsupported output (fmt %i - %ix%i)\n",
+				h264_ctx->context->pix_fmt, h264_ctx->context->width, h264_ctx->context->height);
+		h264_ctx->bad_fmt = 1;
+		return E_FORMAT_ERR;
+	}
+
+#ifdef USE_PLANAR_YUV
+	h264_copy_plane(out_buf, picture->data[0], picture->linesize[0], width, height);
+	out_buf += width * height;
+	h264_copy_plane(out_buf, picture->data[1], picture->linesize[1], width / 2, height / 2);
+	out_buf += width * height / 4;
+	h264_copy_plane(out_buf, picture->data[2], picture->linesize[2], width / 2, height / 2);
+#else
+	/*convert directly from the decoder planes*/
+	yu12_planes_to_yuyv(out_buf, picture->data[0], picture->data[1], picture->data[2],
+		picture->linesize[0], picture->linesize[1], width, height);
+#endif
+
+	return E_OK;
+}
+
+/*
+ * pause h264 decoding (no consumer for the decoded frames)
+ *  h264_decode resumes on the next IDR frame (a new one is requested)
+ * args:
+ *    vd - pointer to video device data
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: none
+ */
+void h264_pause_decoder(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(vd->h264_ctx != NULL)
+		vd->h264_ctx->resync = 1;
+}
+
 /*
  * decode h264 frame
  * args:
+ *    vd - pointer to video device data
  *    out_buf - pointer to decoded data
  *    in_buf - pointer to h264 data
  *    size - in_buf size
+ *    keyframe - in_buf holds an IDR frame
  *
  * asserts:
- *    h264_ctx is not null
+ *    vd is not null
+ *    vd->h264_ctx is not null
  *    in_buf is not null
  *    out_buf is not null
  *
- * returns: decoded data size
+ * returns: decoded data size (0 - no picture in out_buf)
  */
-int h264_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
+int h264_decode(v4l2_dev_t *vd, uint8_t *out_buf, uint8_t *in_buf, int size, int keyframe)
 {
 	/*asserts*/
-	assert(h264_ctx != NULL);
+	assert(vd != NULL);
+	assert(vd->h264_ctx != NULL);
 	assert(in_buf != NULL);
 	assert(out_buf != NULL);
 
+	h264_decoder_context_t *h264_ctx = vd->h264_ctx;
+
 	AVPacket avpkt;
 
+	int got_picture = 0;
+
+	/*
+	 * decoding was paused: the references for the frames in between
+	 * are gone, the last IDR would only hide that (a P frame decoded
+	 * on top of it is corrupted), so request a new IDR and wait for it
+	 */
+	if(h264_ctx->resync)
+	{
+		h264_ctx->resync = 0;
+		avcodec_flush_buffers(h264_ctx->context);
+		h264_ctx->wait_idr = 1;
+
+		h264_request_idr(vd);
+	}
+
+	if(h264_ctx->wait_idr)
+	{
+		if(!keyframe)
+			return 0;
+
+		h264_ctx->wait_idr = 0;
+	}
+
 	av_init_packet(&avpkt);
 	
 	avpkt.size = size;
 	avpkt.data = in_buf;
 
-	int got_picture = 0;
+	got_picture = 0;
 	int len = avcodec_decode_video2(h264_ctx->context, h264_ctx->picture, &got_picture, &avpkt);
 
 	if(len < 0)
@@ -1043,8 +1191,8 @@ int h264_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 
 	if(got_picture)
 	{
-		avpicture_layout((AVPicture *) h264_ctx->picture, h264_ctx->context->pix_fmt, 
-			h264_ctx->width, h264_ctx->height, out_buf, h264_ctx->pic_size);
+		if(h264_store_picture(h264_ctx, out_buf) != E_OK)
+			return 0;
 		return len;
 	}
 	else
@@ -1055,15 +1203,20 @@ int h264_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 /*
  * close h264 decoder context
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: none
  */
-void h264_close_decoder()
+void h264_close_decoder(v4l2_dev_t *vd)
 {
+	/*asserts*/
+	assert(vd != NULL);
+
+	h264_decoder_context_t *h264_ctx = vd->h264_ctx;
+
 	if(h264_ctx == NULL)
 		return;
 
@@ -1083,5 +1236,5 @@ void h264_close_decoder()
 
 	free(h264_ctx);
 
-	h264_ctx = NULL;
+	vd->h264_ctx = NULL;
 }
@@ -246,14 +246,14 @@ typedef struct _uvcx_qp_steps_layers_t
 /*
  * get h264 support type
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: support type (H264_NONE; H264_MUXED; H264_FRAME)
  */
-int h264_get_support();
+int h264_get_support(v4l2_dev_t *vd);
 
 /*
  * gets the uvc h264 xu control unit id, if any
@@ -496,42 +496,59 @@ int h264_probe_config_probe_req(
 /*
  * init h264 decoder context
  * args:
+ *    vd - pointer to video device data
  *    width - image width
  *    height - image height
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: error code (0 - E_OK)
  */
-int h264_init_decoder(int width, int height);
+int h264_init_decoder(v4l2_dev_t *vd, int width, int height);
+
+/*
+ * pause h264 decoding (no consumer for the decoded frames)
+ *  h264_decode resumes on the next IDR frame (a new one is requested)
+ * args:
+ *    vd - pointer to video device data
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: none
+ */
+void h264_pause_decoder(v4l2_dev_t *vd);
 
 /*
  * decode h264 frame
  * args:
+ *    vd - pointer to video device data
  *    out_buf - pointer to decoded data
  *    in_buf - pointer to h264 data
  *    size - in_buf size
+ *    keyframe - in_buf holds an IDR frame
  *
  * asserts:
- *    h264_ctx is not null
+ *    vd is not null
+ *    vd->h264_ctx is not null
  *    in_buf is not null
  *    out_buf is not null
  *
- * returns: decoded data size
+ * returns: decoded data size (0 - no picture in out_buf)
  */
-int h264_decode(uint8_t *out_buf, uint8_t *in_buf, int size);
+int h264_decode(v4l2_dev_t *vd, uint8_t *out_buf, uint8_t *in_buf, int size, int keyframe);
 
 /*
  * close h264 decoder context
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: none
  */
-void h264_close_decoder();
+void h264_close_decoder(v4l2_dev_t *vd);
 
 #endif /*UVC_H264_H*/
@@ -574,7 +574,7 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
     {
         case V4L2_CID_EXPOSURE_AUTO:
             {
-                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id(id);
+                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id(vd, id);
                 if(ctrl_this == NULL)
                     break;
 
@@ -582,16 +582,16 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
                 {
                     case V4L2_EXPOSURE_AUTO:
                         {
-                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
 
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_RELATIVE );
                             if (ctrl_that)
                                 ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_EXPOSURE_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
@@ -600,15 +600,15 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
 
                     case V4L2_EXPOSURE_APERTURE_PRIORITY:
                         {
-                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_EXPOSURE_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_RELATIVE );
                             if (ctrl_that)
                                 ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
@@ -617,16 +617,16 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
 
                     case V4L2_EXPOSURE_SHUTTER_PRIORITY:
                         {
-                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
 
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_RELATIVE );
                             if (ctrl_that)
                                 ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_EXPOSURE_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
@@ -635,15 +635,15 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
 
                     default:
                         {
-                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                            v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_EXPOSURE_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_ABSOLUTE );
                             if (ctrl_that)
                                 ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
-                            ctrl_that = v4l2core_get_control_by_id(
+                            ctrl_that = v4l2core_get_control_by_id(vd, 
                                 V4L2_CID_IRIS_RELATIVE );
                             if (ctrl_that)
                                 ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
@@ -655,29 +655,29 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
 
         case V4L2_CID_FOCUS_AUTO:
             {
-                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id( id );
+                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id(vd,  id );
                 if(ctrl_this == NULL)
                     break;
                 if(ctrl_this->value > 0)
                 {
-                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_FOCUS_ABSOLUTE);
                     if (ctrl_that)
                         ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
 
-                    ctrl_that = v4l2core_get_control_by_id(
+                    ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_FOCUS_RELATIVE);
                     if (ctrl_that)
                         ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
                 }
                 else
                 {
-                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_FOCUS_ABSOLUTE);
                     if (ctrl_that)
                         ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
 
-                    ctrl_that = v4l2core_get_control_by_id(
+                    ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_FOCUS_RELATIVE);
                     if (ctrl_that)
                         ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
@@ -687,19 +687,19 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
 
         case V4L2_CID_HUE_AUTO:
             {
-                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id( id );
+                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id(vd,  id );
                 if(ctrl_this == NULL)
                     break;
                 if(ctrl_this->value > 0)
                 {
-                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_HUE);
                     if (ctrl_that)
                         ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
                 }
                 else
                 {
-                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_HUE);
                     if (ctrl_that)
                         ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
@@ -709,36 +709,36 @@ static void update_ctrl_flags(v4l2_dev_t *vd, int id)
 
         case V4L2_CID_AUTO_WHITE_BALANCE:
             {
-                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id( id );
+                v4l2_ctrl_t *ctrl_this = v4l2core_get_control_by_id(vd,  id );
                 if(ctrl_this == NULL)
                     break;
 
                 if(ctrl_this->value > 0)
                 {
-                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_WHITE_BALANCE_TEMPERATURE);
                     if (ctrl_that)
                         ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
-                    ctrl_that = v4l2core_get_control_by_id(
+                    ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_BLUE_BALANCE);
                     if (ctrl_that)
                         ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
-                    ctrl_that = v4l2core_get_control_by_id(
+                    ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_RED_BALANCE);
                     if (ctrl_that)
                         ctrl_that->control.flags |= V4L2_CTRL_FLAG_GRABBED;
                 }
                 else
                 {
-                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(
+                    v4l2_ctrl_t *ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_WHITE_BALANCE_TEMPERATURE);
                     if (ctrl_that)
                         ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
-                    ctrl_that = v4l2core_get_control_by_id(
+                    ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_BLUE_BALANCE);
                     if (ctrl_that)
                         ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
-                    ctrl_that = v4l2core_get_control_by_id(
+                    ctrl_that = v4l2core_get_control_by_id(vd, 
                         V4L2_CID_RED_BALANCE);
                     if (ctrl_that)
                         ctrl_that->control.flags &= !(V4L2_CTRL_FLAG_GRABBED);
@@ -788,11 +788,11 @@ void disable_special_auto (v4l2_dev_t *vd, int id)
 	/*asserts*/
 	assert(vd != NULL);
 
-    v4l2_ctrl_t *current = v4l2core_get_control_by_id( id);
+    v4l2_ctrl_t *current = v4l2core_get_control_by_id(vd,  id);
     if(current && ((id == V4L2_CID_FOCUS_AUTO) || (id == V4L2_CID_HUE_AUTO)))
     {
         current->value = 0;
-        v4l2core_set_control_value_by_id( id);
+        v4l2core_set_control_value_by_id(vd,  id);
     }
 }
 
@@ -803,7 +803,7 @@ void disable_special_auto (v4l2_dev_t *vd, int id)
  *
  * asserts:
  *   vd is not null
- *   vd->fd is valid
+ *   vd->fd is valid (v4l2 devices)
  *
  * returns: void
  */
@@ -811,6 +811,11 @@ void get_v4l2_control_values (v4l2_dev_t *vd)
 {
     /*asserts*/
     assert(vd != NULL);
+
+	/*frame sources have no device controls*/
+	if(vd->source != NULL)
+		return;
+
     assert(vd->fd > 0);
 
     if(vd->list_device_controls == NULL)
@@ -898,7 +903,7 @@ void get_v4l2_control_values (v4l2_dev_t *vd)
             //fill in the values on the control list
             for(i=0; i<count; i++)
             {
-                v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(clist[i].id);
+                v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(vd, clist[i].id);
                 if(!ctrl)
                 {
                     fprintf(stderr, "V4L2_CORE: couldn't get control for id: %i\n", clist[i].id);
@@ -986,7 +991,7 @@ v4l2_ctrl_t *get_control_by_id(v4l2_dev_t *vd, int id)
  *
  * asserts:
  *   vd is not null
- *   vd->fd is valid
+ *   vd->fd is valid (v4l2 devices)
  *
  * returns: ioctl result
  */
@@ -994,9 +999,14 @@ int get_control_value_by_id (v4l2_dev_t *vd, int id)
 {
 	/*asserts*/
 	assert(vd != NULL);
+
+	/*frame sources have no device controls*/
+	if(vd->source != NULL)
+		return (-1);
+
 	assert(vd->fd > 0);
 
-    v4l2_ctrl_t *control = v4l2core_get_control_by_id(id );
+    v4l2_ctrl_t *control = v4l2core_get_control_by_id(vd, id );
     int ret = 0;
 
     if(!control)
@@ -1102,7 +1112,7 @@ int get_control_value_by_id (v4l2_dev_t *vd, int id)
  *
  * asserts:
  *   vd is not null
- *   vd->fd is valid
+ *   vd->fd is valid (v4l2 devices)
  *
  * returns: void
  */
@@ -1110,6 +1120,11 @@ void set_v4l2_control_values (v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
+
+	/*frame sources have no device controls*/
+	if(vd->source != NULL)
+		return;
+
 	assert(vd->fd > 0);
 	
 	if(vd->list_device_controls == NULL)
@@ -1204,7 +1219,7 @@ void set_v4l2_control_values (v4l2_dev_t *vd)
                         ret = xioctl(vd->fd, VIDIOC_S_CTRL, &ctrl);
                         if(ret)
                         {
-                            v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(clist[i].id);
+                            v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(vd, clist[i].id);
                             if(ctrl)
                                 fprintf(stderr, "V4L2_CORE: control(0x%08x) \"%s\" failed to set (error %i)\n",
                                     clist[i].id, ctrl->control.name, ret);
@@ -1224,7 +1239,7 @@ void set_v4l2_control_values (v4l2_dev_t *vd)
                         ctrls.controls = &clist[i];
                         ret = xioctl(vd->fd, VIDIOC_S_EXT_CTRLS, &ctrls);
 
-                        v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(clist[i].id);
+                        v4l2_ctrl_t *ctrl = v4l2core_get_control_by_id(vd, clist[i].id);
 
                         if(ret)
                         {
@@ -1265,6 +1280,10 @@ void set_control_defaults(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
+
+	/*frame sources have no device controls*/
+	if(vd->source != NULL)
+		return;
 	
 	if(vd->list_device_controls == NULL)
 	{
@@ -1273,7 +1292,6 @@ void set_control_defaults(v4l2_dev_t *vd)
 	}
 
     v4l2_ctrl_t *current = vd->list_device_controls;
-    v4l2_ctrl_t *next = current->next;
 
 	if(verbosity > 0)
 		printf("V4L2_CORE: loading defaults\n");
@@ -1318,7 +1336,7 @@ void set_control_defaults(v4l2_dev_t *vd)
  *
  * asserts:
  *   vd is not null
- *   vd->fd is valid
+ *   vd->fd is valid (v4l2 devices)
  *
  * returns: ioctl result
  */
@@ -1326,9 +1344,14 @@ int set_control_value_by_id(v4l2_dev_t *vd, int id)
 {
 	/*asserts*/
 	assert(vd != NULL);
+
+	/*frame sources have no device controls*/
+	if(vd->source != NULL)
+		return (-1);
+
 	assert(vd->fd > 0);
 
-    v4l2_ctrl_t *control = v4l2core_get_control_by_id(id);
+    v4l2_ctrl_t *control = v4l2core_get_control_by_id(vd, id);
     int ret = 0;
 
     if(!control)
@@ -35,7 +35,6 @@
 #include <sys/ioctl.h>
 #include <libv4l2.h>
 #include <sys/mman.h>
-#include <sys/select.h>
 #include <errno.h>
 #include <assert.h>
 /* support for internationalization - i18n */
@@ -48,12 +47,16 @@
 #include "save_image.h"
 #include "soft_autofocus.h"
 #include "core_time.h"
+#include "frame_source.h"
 #include "uvc_h264.h"
 #include "frame_decoder.h"
+#include "frame_pipeline.h"
 #include "control_profile.h"
 #include "v4l2_formats.h"
 #include "v4l2_controls.h"
 #include "v4l2_devices.h"
+#include "v4l2_events.h"
+#include "frame_timing.h"
 #include "../config.h"
 #include "../guvcview/config.h"
 
@@ -64,29 +67,20 @@
 #ifndef GETTEXT_PACKAGE_V4L2CORE
 #define GETTEXT_PACKAGE_V4L2CORE "gview_v4l2core"
 #endif
-/*video device data mutex*/
-static __MUTEX_TYPE mutex = __STATIC_MUTEX_INIT;
-#define __PMUTEX &mutex
+/*video device data mutex (one per device)*/
+#define __PMUTEX &(vd->mutex)
 
 /*verbosity (global scope)*/
 int verbosity = 0;
 
-/*requested format data*/
-static int my_pixelformat = 0;
-static int my_width = 0;
-static int my_height = 0;
-
-static double real_fps = 0.0;
-static uint64_t fps_ref_ts = 0;
-static uint32_t fps_frame_count = 0;
-
-static uint8_t flag_fps_change = 0; /*set to 1 to request a fps change*/
-
 static uint8_t disable_libv4l2 = 0; /*set to 1 to disable libv4l2 calls*/
 
 static int frame_queue_size = 1; /*just one frame in queue (enough for a single thread)*/
 
-v4l2_dev_t* vd = NULL; /*pointer to device data*/
+static int decoder_threads = 0; /*decode in the capture thread*/
+
+static int h264_decoder_threads = 0; /*h264 codec default*/
+static int h264_thread_type = H264_THREAD_AUTO;
 
 /*
  * ioctl with a number of retries in the case of I/O failure
@@ -122,7 +116,7 @@ int xioctl(int fd, int IOCTL_X, void *arg)
 /*
  * Query video device capabilities and supported formats
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
@@ -130,7 +124,7 @@ int xioctl(int fd, int IOCTL_X, void *arg)
  *
  * returns: error code  (E_OK)
  */
-static int check_v4l2_dev()
+static int check_v4l2_dev(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -201,17 +195,61 @@ if(verbosity > 0)
 	return E_OK;
 }
 
+/*
+ * get the v4l2 memory type for the current capture method
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: V4L2_MEMORY_USERPTR for IO_USERPTR, V4L2_MEMORY_MMAP otherwise
+ *  (dma-buf buffers are exported from mmap buffers)
+ */
+static enum v4l2_memory get_v4l2_memory_type(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(vd->cap_meth == IO_USERPTR)
+		return V4L2_MEMORY_USERPTR;
+
+	return V4L2_MEMORY_MMAP;
+}
+
+/*
+ * get the number of driver buffers in use
+ *  (as granted by VIDIOC_REQBUFS, limited to NB_BUFFER)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of buffers
+ */
+static int get_buff_count(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(vd->rb.count > NB_BUFFER)
+		return NB_BUFFER;
+
+	return (int) vd->rb.count;
+}
+
 /*
  * unmaps v4l2 buffers
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: error code  (0- E_OK)
  */
-static int unmap_buff()
+static int unmap_buff(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -221,11 +259,30 @@ static int unmap_buff()
 	int i=0;
 	int ret=E_OK;
 
+	/*release every slot: the last buffer set may have been bigger*/
 	switch(vd->cap_meth)
 	{
 		case IO_READ:
 			break;
 
+		case IO_USERPTR:
+			for (i = 0; i < NB_BUFFER; i++)
+			{
+				if(vd->mem[i] != MAP_FAILED && vd->mem[i] != NULL)
+					free(vd->mem[i]);
+				vd->mem[i] = MAP_FAILED; /*not allocated*/
+				vd->buff_length[i] = 0;
+			}
+			break;
+
+		case IO_DMABUF:
+			for (i = 0; i < NB_BUFFER; i++)
+			{
+				if(vd->dmabuf_fd[i] >= 0)
+					close(vd->dmabuf_fd[i]);
+				vd->dmabuf_fd[i] = -1;
+			}
+			/*fall through - dma-buf buffers are also mmaped*/
 		case IO_MMAP:
 			for (i = 0; i < NB_BUFFER; i++)
 			{
@@ -235,6 +292,8 @@ static int unmap_buff()
 					{
 						fprintf(stderr, "V4L2_CORE: couldn't unmap buff: %s\n", strerror(errno));
 					}
+				vd->mem[i] = MAP_FAILED; /*not mmaped*/
+				vd->buff_length[i] = 0;
 			}
 	}
 	return ret;
@@ -243,14 +302,14 @@ static int unmap_buff()
 /*
  * maps v4l2 buffers
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: error code  (0- E_OK)
  */
-static int map_buff()
+static int map_buff(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -260,7 +319,7 @@ static int map_buff()
 
 	int i = 0;
 	// map new buffer
-	for (i = 0; i < NB_BUFFER; i++)
+	for (i = 0; i < get_buff_count(vd); i++)
 	{
 		vd->mem[i] = v4l2_mmap( NULL, // start anywhere
 			vd->buff_length[i],
@@ -283,17 +342,118 @@ static int map_buff()
 	return (E_OK);
 }
 
+/*
+ * allocates user pointer buffers (page aligned)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int alloc_userptr_buff(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(verbosity > 2)
+		printf("V4L2_CORE: allocating v4l2 user pointer buffers\n");
+
+	size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	size_t length = vd->format.fmt.pix.sizeimage;
+	if(length == 0)
+		length = vd->format.fmt.pix.width * vd->format.fmt.pix.height * 3; //worst case (rgb)
+	/*round up to a page boundary*/
+	length = (length + page_size - 1) & ~(page_size - 1);
+
+	int i = 0;
+	for (i = 0; i < NB_BUFFER; i++)
+	{
+		if(vd->mem[i] != MAP_FAILED && vd->mem[i] != NULL)
+			free(vd->mem[i]);
+		vd->mem[i] = MAP_FAILED; /*not allocated*/
+		vd->buff_length[i] = 0;
+
+		/*only the buffers granted by the driver*/
+		if(i >= get_buff_count(vd))
+			continue;
+
+		int err = posix_memalign(&vd->mem[i], page_size, length);
+		if(err != 0)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (alloc_userptr_buff): %s\n", strerror(err));
+			exit(-1);
+		}
+		vd->buff_length[i] = length;
+		vd->buff_offset[i] = 0;
+
+		if(verbosity > 1)
+			printf("V4L2_CORE: allocated user buffer[%i] with length %i at pos %p\n",
+				i,
+				vd->buff_length[i],
+				vd->mem[i]);
+	}
+
+	return (E_OK);
+}
+
+/*
+ * exports mmaped v4l2 buffers as dma-buf file descriptors
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int export_buff(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(verbosity > 2)
+		printf("V4L2_CORE: exporting v4l2 buffers as dma-buf\n");
+
+	int i = 0;
+	for (i = 0; i < get_buff_count(vd); i++)
+	{
+		struct v4l2_exportbuffer expbuf;
+		memset(&expbuf, 0, sizeof(struct v4l2_exportbuffer));
+		expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		expbuf.index = i;
+		expbuf.flags = O_RDONLY | O_CLOEXEC;
+
+		if(vd->dmabuf_fd[i] >= 0)
+			close(vd->dmabuf_fd[i]);
+		vd->dmabuf_fd[i] = -1;
+
+		if(xioctl(vd->fd, VIDIOC_EXPBUF, &expbuf) < 0)
+		{
+			fprintf(stderr, "V4L2_CORE: (VIDIOC_EXPBUF) Unable to export buffer[%i]: %s\n", i, strerror(errno));
+			return E_MMAP_ERR;
+		}
+		vd->dmabuf_fd[i] = expbuf.fd;
+
+		if(verbosity > 1)
+			printf("V4L2_CORE: exported buffer[%i] as dma-buf fd %i\n", i, vd->dmabuf_fd[i]);
+	}
+
+	return (E_OK);
+}
+
 /*
  * Query and map buffers
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: error code  (0- E_OK)
  */
-static int query_buff()
+static int query_buff(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -309,8 +469,16 @@ static int query_buff()
 		case IO_READ:
 			break;
 
+		case IO_USERPTR:
+			/*buffers are allocated by us, nothing to query*/
+			ret = alloc_userptr_buff(vd);
+			memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
+			vd->buf.length = vd->buff_length[0];
+			break;
+
 		case IO_MMAP:
-			for (i = 0; i < NB_BUFFER; i++)
+		case IO_DMABUF:
+			for (i = 0; i < get_buff_count(vd); i++)
 			{
 				memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
 				vd->buf.index = i;
@@ -339,7 +507,10 @@ static int query_buff()
 				vd->buff_offset[i] = vd->buf.m.offset;
 			}
 			// map the new buffers
-			if(map_buff() != 0)
+			if(map_buff(vd) != 0)
+				ret = E_MMAP_ERR;
+			// and export them (frames are still available from the mmaped pointer)
+			else if(vd->cap_meth == IO_DMABUF && export_buff(vd) != E_OK)
 				ret = E_MMAP_ERR;
 			break;
 	}
@@ -352,14 +523,14 @@ static int query_buff()
 /*
  * Queue Buffers
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: error code  (0- E_OK)
  */
-static int queue_buff()
+static int queue_buff(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -377,39 +548,72 @@ static int queue_buff()
 
 		case IO_MMAP:
 		default:
-			for (i = 0; i < NB_BUFFER; ++i)
+			for (i = 0; i < get_buff_count(vd); ++i)
 			{
-				memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
-				vd->buf.index = i;
-				vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				//vd->buf.flags = V4L2_BUF_FLAG_TIMECODE;
-				//vd->buf.timecode = vd->timecode;
-				//vd->buf.timestamp.tv_sec = 0;
-				//vd->buf.timestamp.tv_usec = 0;
-				vd->buf.memory = V4L2_MEMORY_MMAP;
-				ret = xioctl(vd->fd, VIDIOC_QBUF, &vd->buf);
-				if (ret < 0)
-				{
-					fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer: %s\n", strerror(errno));
-					return E_QBUF_ERR;
-				}
+				ret = requeue_v4l2_buffer(vd, i);
+				if (ret != E_OK)
+					return ret;
 			}
 			vd->buf.index = 0; /*reset index*/
 	}
 	return ret;
 }
 
+/*
+ * (re)queue a single driver buffer
+ *  uses a local v4l2_buffer so it's safe to call from
+ *  the decoder workers without holding the device mutex
+ * args:
+ *   vd - pointer to video device data
+ *   index - driver buffer index
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code  (0- E_OK)
+ */
+int requeue_v4l2_buffer(v4l2_dev_t *vd, int index)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(vd->cap_meth == IO_READ)
+		return E_OK;
+
+	if(vd->source != NULL)
+		return frame_source_queue(vd, index);
+
+	struct v4l2_buffer buf;
+	memset(&buf, 0, sizeof(struct v4l2_buffer));
+	buf.index = index;
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = get_v4l2_memory_type(vd);
+	if(buf.memory == V4L2_MEMORY_USERPTR)
+	{
+		buf.m.userptr = (unsigned long) vd->mem[index];
+		buf.length = vd->buff_length[index];
+	}
+
+	if(xioctl(vd->fd, VIDIOC_QBUF, &buf) < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer %i: %s\n", index, strerror(errno));
+		return E_QBUF_ERR;
+	}
+
+	return E_OK;
+}
+
 /*
  * do a VIDIOC_S_PARM ioctl for setting frame rate
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * returns: error code
  */
-static int do_v4l2_framerate_update()
+static int do_v4l2_framerate_update(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
@@ -450,7 +654,7 @@ static int do_v4l2_framerate_update()
 /*
  * sets video device frame rate
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
@@ -458,7 +662,7 @@ static int do_v4l2_framerate_update()
  * returns: VIDIOC_S_PARM ioctl result value
  * (sets vd->fps_denom and vd->fps_num to device value)
  */
-static int set_v4l2_framerate ()
+static int set_v4l2_framerate (v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -466,8 +670,21 @@ static int set_v4l2_framerate ()
 	if(verbosity > 2)
 		printf("V4L2_CORE: trying to change fps to %i/%i\n", vd->fps_num, vd->fps_denom);
 
+	/*frame sources just pace to the new rate*/
+	if(vd->source != NULL)
+		return frame_source_set_framerate(vd);
+
 	int ret = 0;
 
+	/*
+	 * the buffers are unmapped and requeued below: frames still
+	 * held by other threads (e.g. the encoder ring) keep their
+	 * driver buffer until released (don't lock vd->mutex for this,
+	 * the release of a frame needs it)
+	 */
+	if(vd->streaming == STRM_OK)
+		detach_v4l2_buffers(vd);
+
 	/*lock the mutex*/
 	__LOCK_MUTEX( __PMUTEX );
 
@@ -476,28 +693,30 @@ static int set_v4l2_framerate ()
 
 	/*try to stop the video stream*/
 	if(stream_status == STRM_OK)
-		v4l2core_stop_stream();
+		v4l2core_stop_stream(vd);
 
 	switch(vd->cap_meth)
 	{
 		case IO_READ:
-			ret = do_v4l2_framerate_update();
+			ret = do_v4l2_framerate_update(vd);
 			break;
 
 		case IO_MMAP:
+		case IO_USERPTR:
+		case IO_DMABUF:
 			if(stream_status == STRM_OK)
 			{
 				/*unmap the buffers*/
 				unmap_buff(vd);
 			}
 
-			ret = do_v4l2_framerate_update();
+			ret = do_v4l2_framerate_update(vd);
 			/*
 			 * For uvc muxed H264 stream
 			 * since we are restarting the video stream and codec values will be reset
 			 * commit the codec data again
 			 */
-			if(vd->requested_fmt == V4L2_PIX_FMT_H264 && h264_get_support() == H264_MUXED)
+			if(vd->requested_fmt == V4L2_PIX_FMT_H264 && h264_get_support(vd) == H264_MUXED)
 			{
 				if(verbosity > 0)
 					printf("V4L2_CORE: setting muxed H264 stream in MJPG container\n");
@@ -508,13 +727,13 @@ static int set_v4l2_framerate ()
 	
 	if(stream_status == STRM_OK)
 	{
-		query_buff(); /*also mmaps the buffers*/
-		queue_buff();
+		query_buff(vd); /*also mmaps the buffers*/
+		queue_buff(vd);
 	}
 
 	/*try to start the video stream*/
 	if(stream_status == STRM_OK)
-		v4l2core_start_stream();
+		v4l2core_start_stream(vd);
 
 	/*unlock the mutex*/
 	__UNLOCK_MUTEX( __PMUTEX );
@@ -525,69 +744,75 @@ static int set_v4l2_framerate ()
 /*
  * checks if frame data is available
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: error code  (0- E_OK)
  */
-static int check_frame_available()
+static int check_frame_available(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
-	int ret = E_OK;
-	fd_set rdset;
-	struct timeval timeout;
+	while(1)
+	{
+		/*lock the mutex*/
+		__LOCK_MUTEX( __PMUTEX );
+		int stream_state = vd->streaming;
+		/*unlock the mutex*/
+		__UNLOCK_MUTEX( __PMUTEX );
+
+		/*make sure streaming is on*/
+		if(stream_state != STRM_OK)
+		{
+			if(stream_state == STRM_REQ_STOP)
+				v4l2core_stop_stream(vd);
 
-	/*lock the mutex*/
-	__LOCK_MUTEX( __PMUTEX );
-	int stream_state = vd->streaming;
-	/*unlock the mutex*/
-	__UNLOCK_MUTEX( __PMUTEX );
+			fprintf(stderr, "V4L2_CORE: (get_v4l2_frame) video stream must be started first\n");
+			return E_NO_STREAM_ERR;
+		}
 
-	/*make sure streaming is on*/
-	if(stream_state != STRM_OK)
-	{
-		if(stream_state == STRM_REQ_STOP)
-			v4l2core_stop_stream();
+		/*a fps change was requested while streaming*/
+		if(vd->flag_fps_change > 0)
+		{
+			if(verbosity > 2)
+				printf("V4L2_CORE: fps change request detected\n");
+			set_v4l2_framerate(vd);
+			vd->flag_fps_change = 0;
+		}
 
-		fprintf(stderr, "V4L2_CORE: (get_v4l2_frame) video stream must be started first\n");
-		return E_NO_STREAM_ERR;
-	}
+		/*frame sources deliver at their own pace*/
+		if(vd->source != NULL)
+			return frame_source_wait(vd);
 
-	/*a fps change was requested while streaming*/
-	if(flag_fps_change > 0)
-	{
-		if(verbosity > 2)
-			printf("V4L2_CORE: fps change request detected\n");
-		set_v4l2_framerate();
-		flag_fps_change = 0;
-	}
+		/*wait for a frame (also collects control, source and hot plug events)*/
+		int ret = v4l2_events_wait(vd, vd->frame_timeout);
 
-	FD_ZERO(&rdset);
-	FD_SET(vd->fd, &rdset);
-	timeout.tv_sec = 1; /* 1 sec timeout*/
-	timeout.tv_usec = 0;
-	/* select - wait for data or timeout*/
-	ret = select(vd->fd + 1, &rdset, NULL, NULL, &timeout);
-	if (ret < 0)
-	{
-		fprintf(stderr, "V4L2_CORE: Could not grab image (select error): %s\n", strerror(errno));
-		return E_SELECT_ERR;
-	}
+		if(ret == E_DEVICE_ERR)
+		{
+			fprintf(stderr, "V4L2_CORE: Could not grab image (device disconnected)\n");
+			return E_DEVICE_ERR;
+		}
 
-	if (ret == 0)
-	{
-		fprintf(stderr, "V4L2_CORE: Could not grab image (select timeout): %s\n", strerror(errno));
-		return E_SELECT_TIMEOUT_ERR;
-	}
+		if(ret < 0)
+		{
+			fprintf(stderr, "V4L2_CORE: Could not grab image (wait error)\n");
+			return E_SELECT_ERR;
+		}
 
-	if ((ret > 0) && (FD_ISSET(vd->fd, &rdset)))
-		return E_OK;
+		if(ret == 0)
+		{
+			fprintf(stderr, "V4L2_CORE: Could not grab image (timeout)\n");
+			return E_SELECT_TIMEOUT_ERR;
+		}
+
+		if(ret & EV_WAIT_FRAME)
+			return E_OK;
 
-	return E_UNKNOWN_ERR;
+		/*woken up: check for stream stop and fps change requests*/
+	}
 }
 
 /*
@@ -620,6 +845,49 @@ void v4l2core_set_frame_queue_size(int size)
 	frame_queue_size = size;
 }
 
+/*
+ * set the number of decoder worker threads (set before v4l2core_init_dev)
+ *   frames are decoded in parallel and delivered in capture order,
+ *   this requires a frame queue size of at least 2 frames
+ * args:
+ *   nthreads - number of decoder threads (0 - decode in the capture thread)
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_decoder_threads(int nthreads)
+{
+	decoder_threads = nthreads < 0 ? 0 : nthreads;
+}
+
+/*
+ * set the h264 decoder threading (set before v4l2core_init_dev)
+ *   h264 frames are always decoded in sequence, these are
+ *   the libav decoder threads used for each frame
+ * args:
+ *   nthreads - number of h264 decoder threads (0 - codec default)
+ *   thread_type - H264_THREAD_[AUTO|FRAME|SLICE] (AUTO - let libav choose)
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_h264_decoder_threading(int nthreads, int thread_type)
+{
+	if(nthreads < 0)
+		nthreads = 0;
+	if(nthreads > H264_MAX_THREADS)
+		nthreads = H264_MAX_THREADS;
+	h264_decoder_threads = nthreads;
+
+	if(thread_type != H264_THREAD_FRAME && thread_type != H264_THREAD_SLICE)
+		thread_type = H264_THREAD_AUTO;
+	h264_thread_type = thread_type;
+}
+
 /*
  * disable libv4l2 calls
  * args:
@@ -653,24 +921,104 @@ void v4l2core_enable_libv4l2()
 /*
  * Set v4l2 capture method
  * args:
- *   method - capture method (IO_READ or IO_MMAP)
+ *   vd - pointer to video device data
+ *   method - capture method (IO_READ, IO_MMAP, IO_USERPTR or IO_DMABUF)
  *
  * asserts:
  *   vd is not null
  *
  * returns: VIDIOC_STREAMON ioctl result (E_OK or E_STREAMON_ERR)
 */
-void v4l2core_set_capture_method(int method)
+void v4l2core_set_capture_method(v4l2_dev_t *vd, int method)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
+	/*frame sources emulate mmap capture*/
+	if(vd->source != NULL)
+	{
+		if(method != IO_MMAP && verbosity > 0)
+			printf("V4L2_CORE: (frame source) capture method not supported: using mmap\n");
+		return;
+	}
+
 	vd->cap_meth = method;
 }
 
+/*
+ * get the dma-buf file descriptor exported for the frame buffer
+ *  (only available with the IO_DMABUF capture method)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer (as returned by v4l2core_get_frame)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: dma-buf fd (owned by the core, don't close it) or -1 if none
+ */
+int v4l2core_get_dmabuf_fd(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	if(vd->cap_meth != IO_DMABUF ||
+	   frame->index < 0 || frame->index >= NB_BUFFER)
+		return -1;
+
+	return vd->dmabuf_fd[frame->index];
+}
+
+/*
+ * set the frame wait timeout (def: 1000 ms)
+ * args:
+ *   vd - pointer to video device data
+ *   timeout_ms - timeout in ms (<= 0 - wait until a frame or a wake up)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_frame_timeout(v4l2_dev_t *vd, int timeout_ms)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	vd->frame_timeout = (timeout_ms > 0) ? timeout_ms : -1;
+}
+
+/*
+ * dump the raw captured frames (with timestamps) to a file
+ *   the dump can be replayed with the "replay:FILE" device
+ * args:
+ *   vd - pointer to video device data
+ *   filename - dump file name (NULL - stop dumping)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_set_raw_dump(v4l2_dev_t *vd, const char *filename)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	/*frames are dumped by the capture thread with the mutex held*/
+	__LOCK_MUTEX( __PMUTEX );
+	int ret = frame_source_dump_open(vd, filename);
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	return ret;
+}
+
 /*
  * define fps values
  * args:
+ *   vd - pointer to video device data
  *   num - fps numerator
  *   denom - fps denominator
  *
@@ -679,7 +1027,7 @@ void v4l2core_set_capture_method(int method)
  *
  * returns - void
  */
-void v4l2core_define_fps(int num, int denom)
+void v4l2core_define_fps(v4l2_dev_t *vd, int num, int denom)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -696,14 +1044,14 @@ void v4l2core_define_fps(int num, int denom)
 /*
  * get requested fps numerator
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns - requested fps numerator
  */
-int v4l2core_get_fps_num()
+int v4l2core_get_fps_num(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -714,14 +1062,14 @@ int v4l2core_get_fps_num()
 /*
  * get requested fps denominator
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns - requested fps denominator
  */
-int v4l2core_get_fps_denom()
+int v4l2core_get_fps_denom(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -732,29 +1080,29 @@ int v4l2core_get_fps_denom()
 /*
  * get real fps
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: double with real fps value
  */
-double v4l2core_get_realfps()
+double v4l2core_get_realfps(v4l2_dev_t *vd)
 {
-	return(real_fps);
+	return(vd->real_fps);
 }
 
 /*
  * get videodevice string
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * return: videodevice string
  */
-const char *v4l2core_get_videodevice()
+const char *v4l2core_get_videodevice(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -765,14 +1113,14 @@ const char *v4l2core_get_videodevice()
 /*
  * get device available number of formats
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns - number of formats for device
  */
-int v4l2core_get_number_formats()
+int v4l2core_get_number_formats(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -783,14 +1131,14 @@ int v4l2core_get_number_formats()
 /*
  * get has_pantilt_id flag
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: has_pantilt_id flag
  */
-int v4l2core_has_pantilt_id()
+int v4l2core_has_pantilt_id(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -801,14 +1149,14 @@ int v4l2core_has_pantilt_id()
 /*
  * get has_focus_control_id flag
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: has_focus_control_id flag
  */
-int v4l2core_has_focus_control_id()
+int v4l2core_has_focus_control_id(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -819,6 +1167,7 @@ int v4l2core_has_focus_control_id()
 /*
  * sets bayer pixel order
  * args:
+ *   vd - pointer to video device data
  *   order - pixel order
  *
  * asserts:
@@ -826,7 +1175,7 @@ int v4l2core_has_focus_control_id()
  *
  * returns - void
  */
-void v4l2core_set_bayer_pix_order(uint8_t order)
+void v4l2core_set_bayer_pix_order(v4l2_dev_t *vd, uint8_t order)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -837,14 +1186,14 @@ void v4l2core_set_bayer_pix_order(uint8_t order)
 /*
  * gets bayer pixel order
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns - bayer pixel order
  */
-uint8_t v4l2core_get_bayer_pix_order()
+uint8_t v4l2core_get_bayer_pix_order(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -855,6 +1204,7 @@ uint8_t v4l2core_get_bayer_pix_order()
 /*
  * flags bayer mode
  * args:
+ *   vd - pointer to video device data
  *   flag - 1 if we are streaming bayer data (0 otherwise)
  *
  * asserts:
@@ -862,7 +1212,7 @@ uint8_t v4l2core_get_bayer_pix_order()
  *
  * returns - void
  */
-void v4l2core_set_isbayer(uint8_t flag)
+void v4l2core_set_isbayer(v4l2_dev_t *vd, uint8_t flag)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -873,14 +1223,14 @@ void v4l2core_set_isbayer(uint8_t flag)
 /*
  * gets bayer pixel order
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns - isbayer flag
  */
-uint8_t v4l2core_get_isbayer()
+uint8_t v4l2core_get_isbayer(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -891,14 +1241,14 @@ uint8_t v4l2core_get_isbayer()
 /*
  * gets current device index
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns - device index
  */
-int v4l2core_get_this_device_index()
+int v4l2core_get_this_device_index(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -909,14 +1259,14 @@ int v4l2core_get_this_device_index()
 /*
  * Start video stream
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: VIDIOC_STREAMON ioctl result (E_OK or E_STREAMON_ERR)
 */
-int v4l2core_start_stream()
+int v4l2core_start_stream(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -937,6 +1287,11 @@ int v4l2core_start_stream()
 
 		case IO_MMAP:
 		default:
+			if(vd->source != NULL)
+			{
+				ret = frame_source_stream(vd, 1);
+				break;
+			}
 			ret = xioctl(vd->fd, VIDIOC_STREAMON, &type);
 			if (ret < 0)
 			{
@@ -946,6 +1301,9 @@ int v4l2core_start_stream()
 			break;
 	}
 
+	/*new stream: restart the clock model and the sequence count*/
+	frame_timing_reset(vd);
+
 	vd->streaming = STRM_OK;
 	
 	if(verbosity > 2)
@@ -957,14 +1315,14 @@ int v4l2core_start_stream()
 /*
  * request video stream to stop
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: error code (0 -OK)
 */
-int v4l2core_request_stop_stream()
+int v4l2core_request_stop_stream(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -977,31 +1335,43 @@ int v4l2core_request_stop_stream()
 	if(verbosity > 2)
 		printf("V4L2_CORE: (request stream stop) stream_status = STRM_REQ_STOP\n");
 
+	/*don't wait for the next frame*/
+	v4l2_events_wake(vd);
+
 	return 0;
 }
 
 /*
  * Stops the video stream
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: VIDIOC_STREAMON ioctl result (E_OK)
 */
-int v4l2core_stop_stream()
+int v4l2core_stop_stream(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
 
 	int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	int ret=E_OK;
+
+	/*finish decoding any frames still holding driver buffers*/
+	frame_pipeline_drain(vd);
+
 	switch(vd->cap_meth)
 	{
 		case IO_READ:
 		case IO_MMAP:
 		default:
+			if(vd->source != NULL)
+			{
+				ret = frame_source_stream(vd, 0);
+				break;
+			}
 			ret = xioctl(vd->fd, VIDIOC_STREAMOFF, &type);
 			if (ret < 0)
 			{
@@ -1024,11 +1394,14 @@ int v4l2core_stop_stream()
 /*
  * get next ready flaged frame from queue
  * args:
- *    none
+ *    vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
  *
  * returns: index of frame queue or -1 if none
  */
-static int get_next_ready_frame()
+static int get_next_ready_frame(v4l2_dev_t *vd)
 {
 	int i = 0;
 	for(i=0; i<vd->frame_queue_size; ++i)
@@ -1043,11 +1416,14 @@ static int get_next_ready_frame()
 /*
  * process input buffer
  * args:
- *   none
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
  *
  * returns: frame_queue index
  */
-static int process_input_buffer()
+static int process_input_buffer(v4l2_dev_t *vd)
 {
 	/*get next available frame in queue*/
 	int qind = get_next_ready_frame(vd);
@@ -1063,12 +1439,12 @@ static int process_input_buffer()
 	}
 	
 	vd->frame_queue[qind].status = FRAME_DECODING;
+	__atomic_store_n(&vd->frame_queue[qind].refcount, 1, __ATOMIC_RELEASE);
 	
-	/*
-     * driver timestamp is unreliable
-	 * use monotonic system time
-	 */
-	vd->frame_queue[qind].timestamp = ns_time_monotonic();
+	/*timestamp (dequeue time or driver), sequence and dropped frames*/
+	frame_timing_process(vd, &vd->frame_queue[qind]);
+	vd->frame_queue[qind].decode_start_ts = 0;
+	vd->frame_queue[qind].decode_end_ts = 0;
 	
 	vd->frame_queue[qind].index = vd->buf.index;
 	 
@@ -1085,17 +1461,21 @@ static int process_input_buffer()
 	vd->frame_queue[qind].raw_frame = vd->mem[vd->buf.index];
 	
 	/*determine real fps every 3 sec aprox.*/
-	fps_frame_count++;
+	vd->fps_frame_count++;
 
-	if(vd->frame_queue[qind].timestamp - fps_ref_ts >= (3 * NSEC_PER_SEC))
+	if(vd->frame_queue[qind].timestamp - vd->fps_ref_ts >= (3 * NSEC_PER_SEC))
 	{
 		if(verbosity > 2)
 			printf("V4L2CORE: (fps) ref:%"PRId64" ts:%"PRId64" frames:%i\n",
-				fps_ref_ts, vd->frame_queue[qind].timestamp, fps_frame_count);
-		real_fps = (double) (fps_frame_count * NSEC_PER_SEC) / (double) (vd->frame_queue[qind].timestamp - fps_ref_ts);
-		fps_frame_count = 0;
-		fps_ref_ts = vd->frame_queue[qind].timestamp;
+				vd->fps_ref_ts, vd->frame_queue[qind].timestamp, vd->fps_frame_count);
+		vd->real_fps = (double) (vd->fps_frame_count * NSEC_PER_SEC) / (double) (vd->frame_queue[qind].timestamp - vd->fps_ref_ts);
+		vd->fps_frame_count = 0;
+		vd->fps_ref_ts = vd->frame_queue[qind].timestamp;
 	}
+
+	/*raw frame dump (for replay)*/
+	if(vd->dump != NULL)
+		frame_source_dump_frame(vd, &vd->frame_queue[qind]);
 	
 	return qind;
 } 
@@ -1103,14 +1483,14 @@ static int process_input_buffer()
 /*
  * gets the next video frame (must be released after processing)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: pointer frame buffer (NULL on error)
  */
-v4l2_frame_buff_t *v4l2core_get_frame()
+v4l2_frame_buff_t *v4l2core_get_frame(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
@@ -1141,7 +1521,7 @@ v4l2_frame_buff_t *v4l2core_get_frame()
 				bytes_used = vd->buf.bytesused;
 				
 				if(bytes_used > 0)
-					qind = process_input_buffer();
+					qind = process_input_buffer(vd);
 			}
 			else res = -1;
 			/*unlock the mutex*/
@@ -1200,17 +1580,24 @@ v4l2_frame_buff_t *v4l2core_get_frame()
 			/*lock the mutex*/
 			__LOCK_MUTEX( __PMUTEX );
 
-			if(vd->streaming == STRM_OK)
+			if(vd->streaming == STRM_OK && vd->source != NULL)
+			{
+				ret = frame_source_dequeue(vd);
+
+				if(!ret)
+					qind = process_input_buffer(vd);
+			}
+			else if(vd->streaming == STRM_OK)
 			{
 				memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
 
 				vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				vd->buf.memory = V4L2_MEMORY_MMAP;
+				vd->buf.memory = get_v4l2_memory_type(vd);
 
 				ret = xioctl(vd->fd, VIDIOC_DQBUF, &vd->buf);
 
 				if(!ret)
-					qind = process_input_buffer();
+					qind = process_input_buffer(vd);
 				else
 					fprintf(stderr, "V4L2_CORE: (VIDIOC_DQBUF) Unable to dequeue buffer: %s\n", strerror(errno));
 			}
@@ -1232,6 +1619,7 @@ v4l2_frame_buff_t *v4l2core_get_frame()
 /*
  * releases the video frame (so that it can be reused by the driver)
  * args:
+ *   vd - pointer to video device data
  *   frame - pointer to decoded frame buffer
  *
  * asserts:
@@ -1239,13 +1627,47 @@ v4l2_frame_buff_t *v4l2core_get_frame()
  *
  * returns: error code (E_OK)
  */
-int v4l2core_release_frame(v4l2_frame_buff_t *frame)
+int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 {
 	int ret = 0;
+
+	/*still referenced (e.g. queued in the encoder)*/
+	int refs = __atomic_load_n(&frame->refcount, __ATOMIC_ACQUIRE);
+	while(refs > 1)
+	{
+		if(__atomic_compare_exchange_n(&frame->refcount, &refs, refs - 1,
+			0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return E_OK;
+	}
+
+	/*
+	 * last reference: the refcount only drops to 0 once the frame
+	 * is back in the queue (buffers can be freed after that)
+	 */
+	__LOCK_MUTEX( &vd->release_mutex );
+
+	/*the frame buffers may have been torn down while the frame was held*/
+	int orphan = release_v4l2_frame_orphan(vd, frame);
+	if(orphan == FRAME_ORPHAN_QUEUE)
+	{
+		__COND_BCAST( &vd->release_cond );
+		__UNLOCK_MUTEX( &vd->release_mutex );
+		return E_OK;
+	}
+
+	if(vd->pipeline != NULL)
+	{
+		ret = frame_pipeline_release_frame(vd, frame);
+		__atomic_store_n(&frame->refcount, 0, __ATOMIC_RELEASE);
+		__COND_BCAST( &vd->release_cond );
+		__UNLOCK_MUTEX( &vd->release_mutex );
+		return ret;
+	}
 	
-	//match the v4l2_buffer with the correspondig frame
-	vd->buf.index = frame->index;
-	
+	/*
+	 * this may run in the encoder thread: don't touch the shared
+	 * vd->buf (requeue_v4l2_buffer uses its own v4l2_buffer)
+	 */
 	switch(vd->cap_meth)
 	{
 		case IO_READ:
@@ -1253,11 +1675,9 @@ int v4l2core_release_frame(v4l2_frame_buff_t *frame)
 		
 		case IO_MMAP:
 		default:
-			/* queue the buffer */
-			ret = xioctl(vd->fd, VIDIOC_QBUF, &vd->buf);
-
-			if(ret)
-				fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer %i: %s\n", frame->index, strerror(errno));
+			/* queue the buffer (unless it was detached from the frame) */
+			if(orphan == FRAME_ORPHAN_NONE)
+				ret = requeue_v4l2_buffer(vd, frame->index);
 			break;	
 	}
 	
@@ -1265,30 +1685,130 @@ int v4l2core_release_frame(v4l2_frame_buff_t *frame)
 	__LOCK_MUTEX( __PMUTEX );
 	frame->raw_frame = NULL;
 	frame->raw_frame_size = 0;
+	frame->yuv_frame = frame->yuv_frame_buffer; /*in case of zero copy*/
+	frame->h264_frame = frame->h264_frame_buffer;
 	frame->status = FRAME_READY;
 	/*unlock the mutex*/
 	__UNLOCK_MUTEX( __PMUTEX );
+
+	__atomic_store_n(&frame->refcount, 0, __ATOMIC_RELEASE);
+	__COND_BCAST( &vd->release_cond );
+	__UNLOCK_MUTEX( &vd->release_mutex );
 	
-	if (ret < 0)
+	if (ret != E_OK)
 		return E_QBUF_ERR;
 	
 	return E_OK;		
 }
 
+/*
+ * get an extra reference to the frame (e.g. to hand it over to
+ *  another thread without copying the frame data); each reference
+ *  must be dropped with v4l2core_release_frame
+ *  it fails if holding the frame would starve the capture
+ *  (at least one frame in queue and two driver buffers must stay free)
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to frame buffer (already owned by the caller)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: error code (E_OK or E_NO_DATA if the frame can't be held)
+ */
+int v4l2core_frame_ref(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	/*read io reuses a single buffer for every frame*/
+	if(vd->cap_meth == IO_READ)
+		return E_NO_DATA;
+
+	if(__atomic_load_n(&frame->refcount, __ATOMIC_ACQUIRE) <= 0)
+		return E_NO_DATA; /*not handed out*/
+
+	/*frames currently held (including this one)*/
+	int held = 0;
+	int i = 0;
+	for(i = 0; i < vd->frame_queue_size; ++i)
+		if(__atomic_load_n(&vd->frame_queue[i].refcount, __ATOMIC_ACQUIRE) > 0)
+			held++;
+
+	int max_held = vd->frame_queue_size - 1;
+	/*without the pipeline each held frame also holds a driver buffer*/
+	if(vd->pipeline == NULL && get_buff_count(vd) - 2 < max_held)
+		max_held = get_buff_count(vd) - 2;
+
+	if(held > max_held)
+		return E_NO_DATA;
+
+	__atomic_add_fetch(&frame->refcount, 1, __ATOMIC_ACQ_REL);
+
+	return E_OK;
+}
+
+/*
+ * make the decoded frame writable without touching the raw frame
+ *  (e.g. before applying render fx): a zero copy frame (yuv_frame
+ *  pointing to raw_frame) gets its data copied to its own yuv buffer,
+ *  so raw recordings, raw snapshots and raw dumps stay unchanged
+ * args:
+ *   vd - pointer to video device data
+ *   frame - pointer to decoded frame buffer
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_frame_detach_raw(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	if(frame->yuv_frame != frame->raw_frame || frame->yuv_frame_buffer == NULL)
+		return E_OK;
+
+	int width = vd->format.fmt.pix.width;
+	int height = vd->format.fmt.pix.height;
+#ifdef USE_PLANAR_YUV
+	size_t framesize = (size_t) width * height * 3/2;
+#else
+	size_t framesize = (size_t) width * height * 2;
+#endif
+
+	memcpy(frame->yuv_frame_buffer, frame->raw_frame, framesize);
+	frame->yuv_frame = frame->yuv_frame_buffer;
+
+	return E_OK;
+}
+
 /*
  * gets the next video frame and decodes it
  * args:
- *    none
+ *    vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
  *
  * returns: pointer to decoded frame buffer ( NULL on error)
  */
-v4l2_frame_buff_t *v4l2core_get_decoded_frame()
+v4l2_frame_buff_t *v4l2core_get_decoded_frame(v4l2_dev_t *vd)
 {
-	v4l2_frame_buff_t *frame = v4l2core_get_frame();
+	/*frames are decoded by the worker pool*/
+	if(vd->pipeline != NULL)
+		return frame_pipeline_get_frame(vd);
+
+	v4l2_frame_buff_t *frame = v4l2core_get_frame(vd);
 	if(frame != NULL)
 	{
 		/*decode the raw frame*/
-		if(decode_v4l2_frame(vd, frame) != E_OK)
+		if(decode_v4l2_frame(vd, frame, NULL) != E_OK)
 		{
 			fprintf(stderr, "V4L2_CORE: Error - Couldn't decode frame\n");
 		}
@@ -1300,6 +1820,7 @@ v4l2_frame_buff_t *v4l2core_get_decoded_frame()
 /*
  * Try/Set device video stream format
  * args:
+ *   vd - pointer to video device data
  *   width - requested video frame width
  *   height - requested video frame height
  *   pixelformat - requested v4l2 pixelformat
@@ -1309,7 +1830,7 @@ v4l2_frame_buff_t *v4l2core_get_decoded_frame()
  *
  * returns: error code ( E_OK)
  */
-static int try_video_stream_format(int width, int height, int pixelformat)
+static int try_video_stream_format(v4l2_dev_t *vd, int width, int height, int pixelformat)
 {
 #ifdef _SUB_CHANNEL_BSP_            
     struct v4l2_pix_format subch_fmt;
@@ -1332,9 +1853,9 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 	uint8_t stream_status = vd->streaming;
 
 	if(stream_status == STRM_OK)
-		v4l2core_stop_stream();
+		v4l2core_stop_stream(vd);
 
-	if(vd->requested_fmt == V4L2_PIX_FMT_H264 && h264_get_support() == H264_MUXED)
+	if(vd->requested_fmt == V4L2_PIX_FMT_H264 && h264_get_support(vd) == H264_MUXED)
 	{
 		if(verbosity > 0)
 			printf("V4L2_CORE: requested H264 stream is supported through muxed MJPG\n");
@@ -1342,11 +1863,11 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 	}
 
     inp.index = vd->this_device;
-    if (-1 == xioctl(vd->fd, VIDIOC_S_INPUT, &inp)) {
+    if (vd->source == NULL && -1 == xioctl(vd->fd, VIDIOC_S_INPUT, &inp)) {
         printf("V4L2_CORE: VIDIOC_S_INPUT error, could not set input: %d!\n", vd->this_device);
     }
 
-    if (my_config->cmos_camera) {
+    if (my_config->cmos_camera && vd->source == NULL) {
         CLEAR(parms);
         parms.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         parms.parm.capture.timeperframe.numerator = 1;
@@ -1383,9 +1904,12 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 	vd->format.fmt.pix.field = V4L2_FIELD_NONE; // V4L2_FIELD_ANY;
 	vd->format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-	ret = xioctl(vd->fd, VIDIOC_S_FMT, &vd->format);
+	if(vd->source != NULL)
+		ret = frame_source_set_format(vd, width, height, pixelformat);
+	else
+		ret = xioctl(vd->fd, VIDIOC_S_FMT, &vd->format);
 
-	if(!ret && (vd->requested_fmt == V4L2_PIX_FMT_H264) && (h264_get_support() == H264_MUXED))
+	if(!ret && (vd->requested_fmt == V4L2_PIX_FMT_H264) && (h264_get_support(vd) == H264_MUXED))
 	{
 		if(verbosity > 0)
 			printf("V4L2_CORE: setting muxed H264 stream in MJPG container\n");
@@ -1439,19 +1963,51 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 
 		case IO_MMAP:
 		default:
+			/*frame sources allocate their own buffers*/
+			if(vd->source != NULL)
+			{
+				ret = frame_source_request_buffers(vd);
+				if(ret != E_OK)
+				{
+					fprintf(stderr, "V4L2_CORE: (frame source) Unable to allocate buffers\n");
+					return ret;
+				}
+				break;
+			}
+
 			/* request buffers */
 			memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
 			vd->rb.count = NB_BUFFER;
 			vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-			vd->rb.memory = V4L2_MEMORY_MMAP;
+			vd->rb.memory = get_v4l2_memory_type(vd);
 
 			ret = xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb);
 
+			if (ret < 0 && vd->cap_meth == IO_USERPTR)
+			{
+				/*user pointer io is optional for drivers: fall back to mmap*/
+				fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) user pointer io not supported (%s): using mmap\n", strerror(errno));
+				vd->cap_meth = IO_MMAP;
+				vd->rb.count = NB_BUFFER;
+				vd->rb.memory = V4L2_MEMORY_MMAP;
+				ret = xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb);
+			}
+
 			if (ret < 0)
 			{
 				fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Unable to allocate buffers: %s\n", strerror(errno));
 				return E_REQBUFS_ERR;
 			}
+
+			/*the driver may grant a different number of buffers*/
+			if (vd->rb.count < 1)
+			{
+				fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) no buffers granted by the driver\n");
+				return E_REQBUFS_ERR;
+			}
+			if (verbosity > 0 && vd->rb.count != NB_BUFFER)
+				printf("V4L2_CORE: driver granted %i buffers (requested %i - using %i)\n",
+					vd->rb.count, NB_BUFFER, get_buff_count(vd));
 			/* map the buffers */
 			if (query_buff(vd))
 			{
@@ -1465,7 +2021,7 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 				memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
 				vd->rb.count = 0;
 				vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				vd->rb.memory = V4L2_MEMORY_MMAP;
+				vd->rb.memory = get_v4l2_memory_type(vd);
 				if(xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb)<0)
 					fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Unable to delete buffers: %s\n", strerror(errno));
 
@@ -1483,7 +2039,7 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 				memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
 				vd->rb.count = 0;
 				vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				vd->rb.memory = V4L2_MEMORY_MMAP;
+				vd->rb.memory = get_v4l2_memory_type(vd);
 				if(xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb)<0)
 					fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Unable to delete buffers: %s\n", strerror(errno));
 				return E_QBUF_ERR;
@@ -1491,13 +2047,13 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 	}
 
 	/*this locks the mutex (can't be called while the mutex is being locked)*/
-	v4l2core_request_framerate_update();
+	v4l2core_request_framerate_update(vd);
 
 	if(stream_status == STRM_OK)
-		v4l2core_start_stream();
+		v4l2core_start_stream(vd);
 
 	/*update the current framerate for the device*/
-	v4l2core_get_framerate();
+	v4l2core_get_framerate(vd);
 
 	return E_OK;
 }
@@ -1505,14 +2061,14 @@ static int try_video_stream_format(int width, int height, int pixelformat)
 /*
  * get frame width
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: frame width
  */
-int v4l2core_get_frame_width()
+int v4l2core_get_frame_width(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1523,14 +2079,14 @@ int v4l2core_get_frame_width()
 /*
  * get frame height
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: frame height
  */
-int v4l2core_get_frame_height()
+int v4l2core_get_frame_height(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1541,14 +2097,14 @@ int v4l2core_get_frame_height()
 /*
  * get requested frame format
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: requested frame format
  */
-int v4l2core_get_requested_frame_format()
+int v4l2core_get_requested_frame_format(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
@@ -1559,6 +2115,7 @@ int v4l2core_get_requested_frame_format()
 /*
  * prepare new format
  * args:
+ *   vd - pointer to video device data
  *   new_format - new format
  *
  * asserts:
@@ -1566,42 +2123,43 @@ int v4l2core_get_requested_frame_format()
  *
  * returns: none
  */
-void v4l2core_prepare_new_format(int new_format)
+void v4l2core_prepare_new_format(v4l2_dev_t *vd, int new_format)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
-	int format_index = v4l2core_get_frame_format_index(new_format);
+	int format_index = v4l2core_get_frame_format_index(vd, new_format);
 
 	if(format_index < 0)
 		format_index = 0;
 
-	my_pixelformat = vd->list_stream_formats[format_index].format;
+	vd->my_pixelformat = vd->list_stream_formats[format_index].format;
 }
 
 /*
  * prepare a valid format (first in the format list)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * returns: none
  */
-void v4l2core_prepare_valid_format()
+void v4l2core_prepare_valid_format(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
 	int format_index = 0;
 
-	my_pixelformat = vd->list_stream_formats[format_index].format;
+	vd->my_pixelformat = vd->list_stream_formats[format_index].format;
 }
 
 /*
  * prepare new resolution
  * args:
+ *   vd - pointer to video device data
  *   new_width - new width
  *   new_height - new height
  *
@@ -1610,55 +2168,55 @@ void v4l2core_prepare_valid_format()
  *
  * returns: none
  */
-void v4l2core_prepare_new_resolution(int new_width, int new_height)
+void v4l2core_prepare_new_resolution(v4l2_dev_t *vd, int new_width, int new_height)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
-	int format_index = v4l2core_get_frame_format_index(my_pixelformat);
+	int format_index = v4l2core_get_frame_format_index(vd, vd->my_pixelformat);
 
 	if(format_index < 0)
 		format_index = 0;
 
-	int resolution_index = v4l2core_get_format_resolution_index(format_index, new_width, new_height);
+	int resolution_index = v4l2core_get_format_resolution_index(vd, format_index, new_width, new_height);
 
 	if(resolution_index < 0)
 		resolution_index = 0;
 
-	my_width  = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].width;
-	my_height = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].height;
+	vd->my_width  = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].width;
+	vd->my_height = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].height;
 }
 
 /*
  * prepare valid resolution (first in the resolution list for the format)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * returns: none
  */
-void v4l2core_prepare_valid_resolution()
+void v4l2core_prepare_valid_resolution(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
-	int format_index = v4l2core_get_frame_format_index(my_pixelformat);
+	int format_index = v4l2core_get_frame_format_index(vd, vd->my_pixelformat);
 
 	if(format_index < 0)
 		format_index = 0;
 
 	int resolution_index = 0;
 
-	my_width  = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].width;
-	my_height = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].height;
+	vd->my_width  = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].width;
+	vd->my_height = vd->list_stream_formats[format_index].list_stream_cap[resolution_index].height;
 }
 
 /*
  * update the current format (pixelformat, width and height)
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
@@ -1666,25 +2224,25 @@ void v4l2core_prepare_valid_resolution()
  * returns:
  *    error code
  */
-int v4l2core_update_current_format()
+int v4l2core_update_current_format(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
-	return(try_video_stream_format(my_width, my_height, my_pixelformat));
+	return(try_video_stream_format(vd, vd->my_width, vd->my_height, vd->my_pixelformat));
 }
 
 /*
  * clean video device data allocation
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: void
  */
-static void clean_v4l2_dev()
+static void clean_v4l2_dev(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1707,6 +2265,20 @@ static void clean_v4l2_dev()
 	
 	if(vd->frame_queue)
 		free(vd->frame_queue);
+
+	free_v4l2_frame_orphans(vd);
+
+	/*save the pending snapshots*/
+	v4l2core_snapshot_stop(vd);
+
+	/*stop the raw dump and close the frame source (if any)*/
+	frame_source_dump_open(vd, NULL);
+	frame_source_close(vd);
+
+	/*unsubscribe the device events (needs the fd)*/
+	v4l2_events_close(vd);
+
+	frame_timing_close(vd);
 	
 	/*close descriptor*/
 	if(vd->fd > 0)
@@ -1714,6 +2286,10 @@ static void clean_v4l2_dev()
 
 	vd->fd = 0;
 
+	__CLOSE_COND( &vd->release_cond );
+	__CLOSE_MUTEX( &vd->release_mutex );
+	__CLOSE_MUTEX( __PMUTEX );
+
 	free(vd);
 }
 
@@ -1721,17 +2297,18 @@ static void clean_v4l2_dev()
  * Initiate video device data with default values
  * args:
  *   device - device name (e.g: "/dev/video0")
+ *     or a frame source name (see frame_source.h)
  *
  * asserts:
  *   device is not null
  *
- * returns: error code  (< 0) on error
+ * returns: pointer to newly allocated video device data (NULL on error)
  */
-int v4l2core_init_dev(const char *device)
+v4l2_dev_t *v4l2core_init_dev(const char *device)
 {
     struct v4l2_input inp;
     v4l2_device_list *device_list;
-    
+
 	assert(device != NULL);
 
 	/*localization*/
@@ -1742,9 +2319,19 @@ int v4l2core_init_dev(const char *device)
 		lc_dir, lc_all, GETTEXT_PACKAGE_V4L2CORE);
 
 	/*alloc the device data*/
-	vd = calloc(1, sizeof(v4l2_dev_t));
+	v4l2_dev_t *vd = calloc(1, sizeof(v4l2_dev_t));
 
-	assert(vd != NULL);
+	if(vd == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_init_dev): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	/*init the device mutex*/
+	__INIT_MUTEX( __PMUTEX );
+	/*init the frame release mutex and condition*/
+	__INIT_MUTEX( &vd->release_mutex );
+	__INIT_COND( &vd->release_cond );
 
 	/*MMAP by default*/
 	vd->cap_meth = IO_MMAP;
@@ -1758,9 +2345,18 @@ int v4l2core_init_dev(const char *device)
 	}
 
 	vd->frame_queue_size = frame_queue_size;
+	vd->decoder_threads = decoder_threads;
+	vd->h264_decoder_threads = h264_decoder_threads;
+	vd->h264_thread_type = h264_thread_type;
+	vd->h264_decode = 1;
 	/*alloc frame buffer queue*/
 	vd->frame_queue = calloc(vd->frame_queue_size, sizeof(v4l2_frame_buff_t));
-	
+	if(vd->frame_queue == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_init_dev): %s\n", strerror(errno));
+		exit(-1);
+	}
+
 	vd->h264_no_probe_default = 0;
 	vd->h264_SPS = NULL;
 	vd->h264_SPS_size = 0;
@@ -1772,16 +2368,38 @@ int v4l2core_init_dev(const char *device)
 	/*set some defaults*/
 	vd->fps_num = 1;
 	vd->fps_denom = 25;
+	vd->frame_timeout = 1000; /*1 sec*/
+
+	frame_timing_init(vd);
 
 	vd->pan_step = 128;
 	vd->tilt_step = 128;
 
+	int i = 0;
+	for (i = 0; i < NB_BUFFER; i++)
+	{
+		vd->mem[i] = MAP_FAILED; /*not mmaped yet*/
+		vd->dmabuf_fd[i] = -1; /*not exported yet*/
+	}
+
+	/*replay or pattern source instead of a v4l2 device*/
+	if(frame_source_is_source(vd->videodevice))
+	{
+		if(frame_source_open(vd) != E_OK ||
+		   v4l2_events_init(vd) != E_OK)
+		{
+			clean_v4l2_dev(vd);
+			return (NULL);
+		}
+		return (vd);
+	}
+
 	/*open device*/
 	if ((vd->fd = open(vd->videodevice, O_RDWR | O_NONBLOCK)) < 0)
 	{
 		fprintf(stderr, "V4L2_CORE: ERROR opening V4L interface: %s\n", strerror(errno));
 		clean_v4l2_dev(vd);
-		return (-1);
+		return (NULL);
 	}
 
 	vd->this_device = v4l2core_get_device_index(vd->videodevice);
@@ -1813,29 +2431,30 @@ int v4l2core_init_dev(const char *device)
 	if(check_v4l2_dev(vd) != E_OK)
 	{
 		clean_v4l2_dev(vd);
-		return (-2);
+		return (NULL);
 	}
 
-	int i = 0;
-	for (i = 0; i < NB_BUFFER; i++)
+	/*event loop: frames, control/source change events and hot plug*/
+	if(v4l2_events_init(vd) != E_OK)
 	{
-		vd->mem[i] = MAP_FAILED; /*not mmaped yet*/
+		clean_v4l2_dev(vd);
+		return (NULL);
 	}
 
-	return (0);
+	return (vd);
 }
 
 /*
  * get stream frame format list for device
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * return: pointer to first format in the list
  */
-v4l2_stream_formats_t *v4l2core_get_formats_list()
+v4l2_stream_formats_t *v4l2core_get_formats_list(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1846,14 +2465,14 @@ v4l2_stream_formats_t *v4l2core_get_formats_list()
 /*
  * get device control list
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * return: pointer to first control in the list
  */
-v4l2_ctrl_t *v4l2core_get_control_list()
+v4l2_ctrl_t *v4l2core_get_control_list(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1864,14 +2483,14 @@ v4l2_ctrl_t *v4l2core_get_control_list()
 /*
  * get device pan step value
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * return: pan step value
  */
-int v4l2core_get_pan_step()
+int v4l2core_get_pan_step(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1882,14 +2501,14 @@ int v4l2core_get_pan_step()
 /*
  * get device tilt step value
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * return: tilt step value
  */
-int v4l2core_get_tilt_step()
+int v4l2core_get_tilt_step(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1900,6 +2519,7 @@ int v4l2core_get_tilt_step()
 /*
  * set device pan step value
  * args:
+ *    vd - pointer to video device data
  *    step - pan step value
  *
  * asserts:
@@ -1907,7 +2527,7 @@ int v4l2core_get_tilt_step()
  *
  * return: none
  */
-void v4l2core_set_pan_step(int step)
+void v4l2core_set_pan_step(v4l2_dev_t *vd, int step)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1918,6 +2538,7 @@ void v4l2core_set_pan_step(int step)
 /*
  * set device tilt step value
  * args:
+ *    vd - pointer to video device data
  *    step -tilt step value
  *
  * asserts:
@@ -1925,7 +2546,7 @@ void v4l2core_set_pan_step(int step)
  *
  * return: none
  */
-void v4l2core_set_tilt_step(int step)
+void v4l2core_set_tilt_step(v4l2_dev_t *vd, int step)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -1936,14 +2557,14 @@ void v4l2core_set_tilt_step(int step)
 /*
  * initiate software autofocus
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
- *    none
+ *    vd is not null
  *
  * returns: error code (0 - E_OK)
  */
-int v4l2core_soft_autofocus_init ()
+int v4l2core_soft_autofocus_init (v4l2_dev_t *vd)
 {
 	return soft_autofocus_init(vd);
 }
@@ -1951,6 +2572,7 @@ int v4l2core_soft_autofocus_init ()
 /*
  * run the software autofocus
  * args:
+ *    vd - pointer to video device data
  *    frame - pointer to frame buffer
  *
  * asserts:
@@ -1959,22 +2581,24 @@ int v4l2core_soft_autofocus_init ()
  * returns: 1 - running  0- focused
  * 	(only matters for non-continue focus)
  */
-int v4l2core_soft_autofocus_run(v4l2_frame_buff_t *frame)
+int v4l2core_soft_autofocus_run(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 {
 	return soft_autofocus_run(vd, frame);
 }
 
 /*
  * clean v4l2 buffers
+ *  waits for the frames still referenced (v4l2core_frame_ref)
+ *  to be released, so the caller must not hold any frame
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * return: none
  */
-void v4l2core_clean_buffers()
+void v4l2core_clean_buffers(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2000,12 +2624,18 @@ void v4l2core_clean_buffers()
 
 		case IO_MMAP:
 		default:
+			if(vd->source != NULL)
+			{
+				frame_source_free_buffers(vd);
+				break;
+			}
+
 			//delete requested buffers
 			unmap_buff(vd);
 			memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
 			vd->rb.count = 0;
 			vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-			vd->rb.memory = V4L2_MEMORY_MMAP;
+			vd->rb.memory = get_v4l2_memory_type(vd);
 			if(xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb)<0)
 			{
 				fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Failed to delete buffers: %s (errno %d)\n", strerror(errno), errno);
@@ -2016,49 +2646,52 @@ void v4l2core_clean_buffers()
 /*
  * cleans video device data and allocations
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: void
  */
-void v4l2core_close_dev()
+void v4l2core_close_dev(v4l2_dev_t *vd)
 {
 	/*asserts*/
 	assert(vd != NULL);
 
-	v4l2core_clean_buffers();
-	clean_v4l2_dev();
+	v4l2core_clean_buffers(vd);
+	clean_v4l2_dev(vd);
 }
 
 /*
  * request a fps update - this locks the mutex
  *   (can't be called while the mutex is being locked)
  * args:
- *    none
+ *    vd - pointer to video device data
  *
  * asserts:
  *    vd is not null
  *
  * returns: none
  */
-void v4l2core_request_framerate_update()
+void v4l2core_request_framerate_update(v4l2_dev_t *vd)
 {
 	/*
 	 * if we are streaming flag a fps change when retrieving frame
 	 * else change fps immediatly
 	 */
 	if(vd->streaming == STRM_OK)
-		flag_fps_change = 1;
+	{
+		vd->flag_fps_change = 1;
+		v4l2_events_wake(vd);
+	}
 	else
-		set_v4l2_framerate();
+		set_v4l2_framerate(vd);
 }
 
 /*
  * gets video device defined frame rate (not real - consider it a maximum value)
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
@@ -2066,13 +2699,17 @@ void v4l2core_request_framerate_update()
  * returns: VIDIOC_G_PARM ioctl result value
  * (sets vd->fps_denom and vd->fps_num to device value)
  */
-int v4l2core_get_framerate ()
+int v4l2core_get_framerate (v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
 
 	int ret=0;
 
+	/*frame sources keep the requested (or fixed) frame rate*/
+	if(vd->source != NULL)
+		return ret;
+
 	vd->streamparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	ret = xioctl(vd->fd, VIDIOC_G_PARM, &vd->streamparm);
 	if (ret < 0)
@@ -2100,6 +2737,7 @@ int v4l2core_get_framerate ()
 /*
  * return the control associated to id from device list
  * args:
+ *   vd - pointer to video device data
  *   id - control id
  *
  * asserts:
@@ -2108,7 +2746,7 @@ int v4l2core_get_framerate ()
  *
  * returns: pointer to v4l2_control if succeded or null otherwise
  */
-v4l2_ctrl_t *v4l2core_get_control_by_id(int id)
+v4l2_ctrl_t *v4l2core_get_control_by_id(v4l2_dev_t *vd, int id)
 {
 	return get_control_by_id(vd, id);
 }
@@ -2117,14 +2755,15 @@ v4l2_ctrl_t *v4l2core_get_control_by_id(int id)
  * updates the value for control id from the device
  * also updates control flags
  * args:
+ *   vd - pointer to video device data
  *   id -control id
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: ioctl result
  */
-int v4l2core_get_control_value_by_id (int id)
+int v4l2core_get_control_value_by_id (v4l2_dev_t *vd, int id)
 {
 	return get_control_value_by_id (vd, id);
 }
@@ -2132,14 +2771,14 @@ int v4l2core_get_control_value_by_id (int id)
 /*
  * goes trough the control list and sets values in device to default
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: void
  */
-void v4l2core_set_control_defaults()
+void v4l2core_set_control_defaults(v4l2_dev_t *vd)
 {
 	set_control_defaults(vd);
 }
@@ -2147,14 +2786,15 @@ void v4l2core_set_control_defaults()
 /*
  * sets the value of control id in device
  * args:
+ *   vd - pointer to video device data
  *   id - control id
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: ioctl result
  */
-int v4l2core_set_control_value_by_id(int id)
+int v4l2core_set_control_value_by_id(v4l2_dev_t *vd, int id)
 {
 	return set_control_value_by_id(vd, id);
 }
@@ -2162,6 +2802,7 @@ int v4l2core_set_control_value_by_id(int id)
 /*
  * save the current frame to file
  * args:
+ *    vd - pointer to video device data
  *    frame - pointer to frame buffer
  *    filename - output file name
  *    format - image type
@@ -2172,22 +2813,22 @@ int v4l2core_set_control_value_by_id(int id)
  *
  * returns: error code
  */
-int v4l2core_save_image(v4l2_frame_buff_t *frame, const char *filename, int format)
+int v4l2core_save_image(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, const char *filename, int format)
 {
-	save_frame_image(vd, frame, filename, format);
+	return save_frame_image(vd, frame, filename, format);
 }
 
 /*
  * get h264 unit id
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: unit id on success or error code ( < 0 ) on fail
  */
-int v4l2core_get_h264_unit_id()
+int v4l2core_get_h264_unit_id(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2198,14 +2839,14 @@ int v4l2core_get_h264_unit_id()
 /*
  * gets the current h264_config_probe_req data struct
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: pointer to current h264_config_probe_req data struct
  */
-uvcx_video_config_probe_commit_t *v4l2core_get_h264_config_probe_req()
+uvcx_video_config_probe_commit_t *v4l2core_get_h264_config_probe_req(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2216,6 +2857,7 @@ uvcx_video_config_probe_commit_t *v4l2core_get_h264_config_probe_req()
 /*
  * flag core to use the preset h264_config_probe_req data (don't reset to default before commit)
  * args:
+ *   vd - pointer to video device data
  *   flag - value to set
  *
  * asserts:
@@ -2223,7 +2865,7 @@ uvcx_video_config_probe_commit_t *v4l2core_get_h264_config_probe_req()
  *
  * returns: none
  */
-void v4l2core_set_h264_no_probe_default(uint8_t flag)
+void v4l2core_set_h264_no_probe_default(v4l2_dev_t *vd, uint8_t flag)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2234,14 +2876,14 @@ void v4l2core_set_h264_no_probe_default(uint8_t flag)
 /*
  * get h264_no_probe_default flag
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: h264_no_probe_default flag
  */
-uint8_t v4l2core_get_h264_no_probe_default()
+uint8_t v4l2core_get_h264_no_probe_default(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2249,17 +2891,45 @@ uint8_t v4l2core_get_h264_no_probe_default()
 	return vd->h264_no_probe_default;
 }
 
+/*
+ * flag core to decode (or not) the h264 frames
+ *   when nothing uses the decoded frame (no render, snapshot, autofocus
+ *   or video re-encoding) decoding can be skipped, frames are still
+ *   demuxed and their yuv_frame is left untouched (decode_end_ts = 0).
+ *   Decoding resumes on the next IDR frame (a new IDR is requested),
+ *   frames before it are not decoded either (decode_end_ts = 0)
+ * args:
+ *   vd - pointer to video device data
+ *   flag - 1 decode (default), 0 skip decoding
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_h264_decode(v4l2_dev_t *vd, uint8_t flag)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(verbosity > 0 && vd->h264_decode != (flag ? 1 : 0) &&
+		vd->requested_fmt == V4L2_PIX_FMT_H264)
+		printf("V4L2_CORE: h264 decoding %s\n", flag ? "resumed" : "paused (no consumer)");
+
+	vd->h264_decode = flag ? 1 : 0;
+}
+
 /*
  * get PPS NALU size
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: PPS size
  */
-int v4l2core_get_h264_pps_size()
+int v4l2core_get_h264_pps_size(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2270,14 +2940,14 @@ int v4l2core_get_h264_pps_size()
 /*
  * get PPS data
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: pointer to PPS data
  */
-uint8_t *v4l2core_get_h264_pps()
+uint8_t *v4l2core_get_h264_pps(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2288,14 +2958,14 @@ uint8_t *v4l2core_get_h264_pps()
 /*
  * get SPS NALU size
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: SPS size
  */
-int v4l2core_get_h264_sps_size()
+int v4l2core_get_h264_sps_size(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2306,14 +2976,14 @@ int v4l2core_get_h264_sps_size()
 /*
  * get SPS data
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
  *   vd is not null
  *
  * returns: pointer to SPS data
  */
-uint8_t *v4l2core_get_h264_sps()
+uint8_t *v4l2core_get_h264_sps(v4l2_dev_t *vd)
 {
 	/*assertions*/
 	assert(vd != NULL);
@@ -2324,14 +2994,14 @@ uint8_t *v4l2core_get_h264_sps()
 /*
  * request a IDR frame from the H264 encoder
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: none
  */
-void v4l2core_h264_request_idr()
+void v4l2core_h264_request_idr(v4l2_dev_t *vd)
 {
 	h264_request_idr(vd);
 }
@@ -2339,14 +3009,14 @@ void v4l2core_h264_request_idr()
 /*
  * resets the h264 encoder
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: 0 on success or error code on fail
  */
-int v4l2core_reset_h264_encoder()
+int v4l2core_reset_h264_encoder(v4l2_dev_t *vd)
 {
 	return h264_reset_encoder(vd);
 }
@@ -2354,14 +3024,15 @@ int v4l2core_reset_h264_encoder()
 /*
  * get the video rate control mode
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: video rate control mode (FIXME: 0xff on error)
  */
-uint8_t v4l2core_get_h264_video_rate_control_mode(uint8_t query)
+uint8_t v4l2core_get_h264_video_rate_control_mode(v4l2_dev_t *vd, uint8_t query)
 {
 	return h264_get_video_rate_control_mode(vd, query);
 }
@@ -2369,14 +3040,15 @@ uint8_t v4l2core_get_h264_video_rate_control_mode(uint8_t query)
 /*
  * set the video rate control mode
  * args:
+ *   vd - pointer to video device data
  *   mode - rate mode
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_video_rate_control_mode(uint8_t mode)
+int v4l2core_set_h264_video_rate_control_mode(v4l2_dev_t *vd, uint8_t mode)
 {
 	return h264_set_video_rate_control_mode(vd, mode);
 }
@@ -2384,14 +3056,15 @@ int v4l2core_set_h264_video_rate_control_mode(uint8_t mode)
 /*
  * get the temporal scale mode
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: temporal scale mode (FIXME: 0xff on error)
  */
-uint8_t v4l2core_get_h264_temporal_scale_mode(uint8_t query)
+uint8_t v4l2core_get_h264_temporal_scale_mode(v4l2_dev_t *vd, uint8_t query)
 {
 	return h264_get_temporal_scale_mode(vd, query);
 }
@@ -2399,14 +3072,15 @@ uint8_t v4l2core_get_h264_temporal_scale_mode(uint8_t query)
 /*
  * set the temporal scale mode
  * args:
+ *   vd - pointer to video device data
  *   mode - temporal scale mode
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_temporal_scale_mode(uint8_t mode)
+int v4l2core_set_h264_temporal_scale_mode(v4l2_dev_t *vd, uint8_t mode)
 {
 	return h264_set_temporal_scale_mode(vd, mode);
 }
@@ -2414,14 +3088,15 @@ int v4l2core_set_h264_temporal_scale_mode(uint8_t mode)
 /*
  * get the spatial scale mode
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: temporal scale mode (FIXME: 0xff on error)
  */
-uint8_t v4l2core_get_h264_spatial_scale_mode(uint8_t query)
+uint8_t v4l2core_get_h264_spatial_scale_mode(v4l2_dev_t *vd, uint8_t query)
 {
 	return h264_get_spatial_scale_mode(vd, query);
 }
@@ -2429,14 +3104,15 @@ uint8_t v4l2core_get_h264_spatial_scale_mode(uint8_t query)
 /*
  * set the spatial scale mode
  * args:
+ *   vd - pointer to video device data
  *   mode - spatial scale mode
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_spatial_scale_mode(uint8_t mode)
+int v4l2core_set_h264_spatial_scale_mode(v4l2_dev_t *vd, uint8_t mode)
 {
 	return h264_set_spatial_scale_mode(vd, mode);
 }
@@ -2444,14 +3120,15 @@ int v4l2core_set_h264_spatial_scale_mode(uint8_t mode)
 /*
  * query the frame rate config
  * args:
+ *   vd - pointer to video device data
  *   query - query type
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: frame rate config (FIXME: 0xffffffff on error)
  */
-uint32_t v4l2core_query_h264_frame_rate_config(uint8_t query)
+uint32_t v4l2core_query_h264_frame_rate_config(v4l2_dev_t *vd, uint8_t query)
 {
 	return h264_query_frame_rate_config(vd, query);
 }
@@ -2459,14 +3136,14 @@ uint32_t v4l2core_query_h264_frame_rate_config(uint8_t query)
 /*
  * get the frame rate config
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: frame rate config (FIXME: 0xffffffff on error)
  */
-uint32_t v4l2core_get_h264_frame_rate_config()
+uint32_t v4l2core_get_h264_frame_rate_config(v4l2_dev_t *vd)
 {
 	return h264_get_frame_rate_config(vd);
 }
@@ -2474,14 +3151,15 @@ uint32_t v4l2core_get_h264_frame_rate_config()
 /*
  * set the frame rate config
  * args:
+ *   vd - pointer to video device data
  *   framerate - framerate
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
-int v4l2core_set_h264_frame_rate_config(uint32_t framerate)
+int v4l2core_set_h264_frame_rate_config(v4l2_dev_t *vd, uint32_t framerate)
 {
 	return h264_set_frame_rate_config(vd, framerate);
 }
@@ -2489,16 +3167,18 @@ int v4l2core_set_h264_frame_rate_config(uint32_t framerate)
 /*
  * updates the h264_probe_commit_req field
  * args:
+ *   vd - pointer to video device data
  *   query - (UVC_GET_CUR; UVC_GET_MAX; UVC_GET_MIN)
  *   config_probe_cur - pointer to uvcx_video_config_probe_commit_t:
  *     if null vd->h264_config_probe_req will be used
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code ( 0 -OK)
  */
 int v4l2core_probe_h264_config_probe_req(
+			v4l2_dev_t *vd,
 			uint8_t query,
 			uvcx_video_config_probe_commit_t *config_probe_req)
 {
@@ -2508,22 +3188,24 @@ int v4l2core_probe_h264_config_probe_req(
 /*
  * check for new devices
  * args:
- *   none
+ *   vd - pointer to video device data
  *
  * asserts:
+ *   vd is not null
  *   my_device_list.udev is not null
  *   my_device_list.udev_fd is valid (> 0)
  *   my_device_list.udev_mon is not null
  *
  * returns: true(1) if device list was updated, false(0) otherwise
  */
-int v4l2core_check_device_list_events()
+int v4l2core_check_device_list_events(v4l2_dev_t *vd)
 {
 	return check_device_list_events(vd);
 }
 
 /* get frame format index from format list
  * args:
+ *   vd - pointer to video device data
  *   format - v4l2 pixel format
  *
  * asserts:
@@ -2532,13 +3214,14 @@ int v4l2core_check_device_list_events()
  *
  * returns: format list index or -1 if not available
  */
-int v4l2core_get_frame_format_index(int format)
+int v4l2core_get_frame_format_index(v4l2_dev_t *vd, int format)
 {
 	return get_frame_format_index(vd, format);
 }
 
 /* get resolution index for format index from format list
  * args:
+ *   vd - pointer to video device data
  *   format - format index from format list
  *   width - requested width
  *   height - requested height
@@ -2549,7 +3232,7 @@ int v4l2core_get_frame_format_index(int format)
  *
  * returns: resolution list index for format index or -1 if not available
  */
-int v4l2core_get_format_resolution_index(int format, int width, int height)
+int v4l2core_get_format_resolution_index(v4l2_dev_t *vd, int format, int width, int height)
 {
 	return get_format_resolution_index(vd, format, width, height);
 }
@@ -2557,14 +3240,15 @@ int v4l2core_get_format_resolution_index(int format, int width, int height)
 /*
  * save the device control values into a profile file
  * args:
+ *   vd - pointer to video device data
  *   filename - profile filename
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: error code (0 -E_OK)
  */
-int v4l2core_save_control_profile(const char *filename)
+int v4l2core_save_control_profile(v4l2_dev_t *vd, const char *filename)
 {
 	return save_control_profile(vd, filename);
 }
@@ -2572,6 +3256,7 @@ int v4l2core_save_control_profile(const char *filename)
 /*
  * load the device control values from a profile file
  * args:
+ *   vd - pointer to video device data
  *   filename - profile filename
  *
  * asserts:
@@ -2579,7 +3264,7 @@ int v4l2core_save_control_profile(const char *filename)
  *
  * returns: error code (0 -E_OK)
  */
-int v4l2core_load_control_profile(const char *filename)
+int v4l2core_load_control_profile(v4l2_dev_t *vd, const char *filename)
 {
 	return load_control_profile(vd, filename);
 }
@@ -2587,15 +3272,16 @@ int v4l2core_load_control_profile(const char *filename)
 /*
  * get lenght of xu control defined by unit id and selector
  * args:
+ *   vd - pointer to video device data
  *   unit - unit id of xu control
  *   selector - selector for control
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: length of xu control
  */
-uint16_t v4l2core_get_length_xu_control(uint8_t unit, uint8_t selector)
+uint16_t v4l2core_get_length_xu_control(v4l2_dev_t *vd, uint8_t unit, uint8_t selector)
 {
 	return get_length_xu_control(vd, unit, selector);
 }
@@ -2603,15 +3289,16 @@ uint16_t v4l2core_get_length_xu_control(uint8_t unit, uint8_t selector)
 /*
  * get uvc info for xu control defined by unit id and selector
  * args:
+ *   vd - pointer to video device data
  *   unit - unit id of xu control
  *   selector - selector for control
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: info of xu control
  */
-uint8_t v4l2core_get_info_xu_control(uint8_t unit, uint8_t selector)
+uint8_t v4l2core_get_info_xu_control(v4l2_dev_t *vd, uint8_t unit, uint8_t selector)
 {
 	return get_info_xu_control(vd, unit, selector);
 }
@@ -2619,17 +3306,18 @@ uint8_t v4l2core_get_info_xu_control(uint8_t unit, uint8_t selector)
 /*
  * runs a query on xu control defined by unit id and selector
  * args:
+ *   vd - pointer to video device data
  *   unit - unit id of xu control
  *   selector - selector for control
  *   query - query type
  *   data - pointer to query data
  *
  * asserts:
- *   none
+ *   vd is not null
  *
  * returns: 0 if query succeded or errno otherwise
  */
-int v4l2core_query_xu_control(uint8_t unit, uint8_t selector, uint8_t query, void *data)
+int v4l2core_query_xu_control(v4l2_dev_t *vd, uint8_t unit, uint8_t selector, uint8_t query, void *data)
 {
 	return query_xu_control(vd, unit, selector, query, data);
 }
@@ -23,16 +23,32 @@
 #define V4L2CORE_H
 
 #include "gviewv4l2core.h"
+#include "gview.h"
 
 /*
- * video device data
+ * per device decoder and autofocus contexts
+ * (defined in their own modules)
  */
-typedef struct _v4l2_dev_t
+struct _h264_decoder_context_t;
+struct _jpeg_decoder_context_t;
+struct _focus_ctx_t;
+struct _frame_pipeline_t;
+struct _frame_source_t;
+struct _frame_dump_t;
+struct _frame_orphan_t;
+struct _frame_queue_orphan_t;
+
+/*
+ * video device data (v4l2_dev_t is typedefed in gviewv4l2core.h)
+ */
+struct _v4l2_dev_t
 {
+	__MUTEX_TYPE mutex;                 // device mutex (buffer queue and stream state)
+
 	int fd;                             // device file descriptor
 	char *videodevice;                  // video device string (default "/dev/video0)"
 
-	int cap_meth;                       // capture method: IO_READ or IO_MMAP
+	int cap_meth;                       // capture method: IO_READ, IO_MMAP, IO_USERPTR or IO_DMABUF
 	v4l2_stream_formats_t* list_stream_formats; //list of available stream formats
 	int numb_formats;                   //list size
 	//int current_format_index;           //index of current stream format
@@ -48,15 +64,36 @@ typedef struct _v4l2_dev_t
 
 	int fps_num;                        //fps numerator
 	int fps_denom;                      //fps denominator
+	uint8_t flag_fps_change;            //set to 1 to request a fps change
+	double real_fps;                    //measured fps
+	uint64_t fps_ref_ts;                //fps reference timestamp (ns)
+	uint32_t fps_frame_count;           //frames counted since fps_ref_ts
+
+	uint32_t my_pixelformat;            //requested pixelformat (prepare_new_format)
+	int my_width;                       //requested width (prepare_new_resolution)
+	int my_height;                      //requested height (prepare_new_resolution)
 
 	uint8_t streaming;                  // flag device stream : STRM_STOP ; STRM_REQ_STOP; STRM_OK
 	uint64_t frame_index;               // captured frame index from 0 to max(uint64_t)
 	void *mem[NB_BUFFER];               // memory buffers for mmap driver frames
 	uint32_t buff_length[NB_BUFFER];    // memory buffers length as set by VIDIOC_QUERYBUF
 	uint32_t buff_offset[NB_BUFFER];    // memory buffers offset as set by VIDIOC_QUERYBUF
+	int dmabuf_fd[NB_BUFFER];           // dma-buf fds exported with VIDIOC_EXPBUF (IO_DMABUF) or -1
 
 	v4l2_frame_buff_t *frame_queue;     //frame queue
 	int frame_queue_size;               //size of frame queue (in frames)
+	__MUTEX_TYPE release_mutex;         //frame release mutex (last reference of handed out frames)
+	__COND_TYPE release_cond;           //signaled every time a handed out frame is released
+	struct _frame_orphan_t *frame_orphan; //per frame queue slot: buffers detached from a held frame (NULL if none yet)
+	struct _frame_queue_orphan_t *detached_queues; //frame queues detached with frames still held
+	int decoder_threads;                //number of decoder worker threads (0 - decode in the capture thread)
+	struct _frame_pipeline_t *pipeline; //frame decoding pipeline (NULL if not in use)
+	struct _frame_source_t *source;     //replay/pattern frame source (NULL for v4l2 devices)
+	struct _frame_dump_t *dump;         //raw frame dump (NULL if not in use)
+	struct _v4l2_events_t *events;      //device event loop (epoll)
+	int frame_timeout;                  //frame wait timeout in ms (-1 - none)
+	struct _frame_timing_t *timing;     //frame timestamps and dropped frames
+	struct _snapshot_pool_t *snapshot;  //background image save workers (NULL if not in use)
 
 	uint8_t h264_unit_id;  				// uvc h264 unit id, if <= 0 then uvc h264 is not supported
 	uint8_t h264_no_probe_default;      // flag core to use the preset h264_config_probe_req data (don't reset to default before commit)
@@ -67,6 +104,14 @@ typedef struct _v4l2_dev_t
 	uint16_t h264_SPS_size;             // SPS size
 	uint8_t *h264_PPS;                  // h264 PPS info
 	uint16_t h264_PPS_size;             // PPS size
+	int h264_support;                   // uvc h264 support type (H264_NONE; H264_MUXED; H264_FRAME)
+	int h264_decoder_threads;           // libav h264 decoder threads (0 - codec default)
+	int h264_thread_type;               // libav h264 decoder threading (H264_THREAD_[AUTO|FRAME|SLICE])
+	uint8_t h264_decode;                // flag core to decode h264 frames (0 - no consumer for the decoded frames)
+
+	struct _h264_decoder_context_t *h264_ctx; // h264 decoder context
+	struct _jpeg_decoder_context_t *jpeg_ctx; // jpeg decoder context
+	struct _focus_ctx_t *focus_ctx;     // software autofocus context
 
     int this_device;                    // index of this device in device list
 
@@ -82,6 +127,21 @@ typedef struct _v4l2_dev_t
 	int has_focus_control_id;           //it's set to control id if a focus control is available (enables software autofocus)
 	int has_pantilt_control_id;         //it's set to 1 if a pan/tilt control is available
 	uint8_t pantilt_unit_id;            //logitech peripheral V3 unit id (if any)
-} v4l2_dev_t;
+};
+
+/*
+ * (re)queue a single driver buffer
+ *  uses a local v4l2_buffer so it's safe to call from
+ *  the decoder workers without holding the device mutex
+ * args:
+ *   vd - pointer to video device data
+ *   index - driver buffer index
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code  (0- E_OK)
+ */
+int requeue_v4l2_buffer(v4l2_dev_t *vd, int index);
 
 #endif
@@ -24,6 +24,7 @@
 #include <linux/videodev2.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
@@ -314,23 +315,25 @@ int check_device_list_events(v4l2_dev_t *vd)
 	assert(my_device_list.udev_fd > 0);
 	assert(my_device_list.udev_mon != NULL);
 
-    fd_set fds;
-    struct timeval tv;
+    struct pollfd pfd;
     int ret = 0;
 
-    FD_ZERO(&fds);
-    FD_SET(my_device_list.udev_fd, &fds);
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
+    pfd.fd = my_device_list.udev_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
 
-    ret = select(my_device_list.udev_fd+1, &fds, NULL, NULL, &tv);
+    /*
+     * don't block (the device event loop also watches
+     * this fd and flags DEV_EVENT_DEVICE_LIST)
+     */
+    ret = poll(&pfd, 1, 0);
 
     /* Check if our file descriptor has received data. */
-    if (ret > 0 && FD_ISSET(my_device_list.udev_fd, &fds))
+    if (ret > 0 && (pfd.revents & POLLIN))
     {
         /*
          * Make the call to receive the device.
-         *   select() ensured that this will not block.
+         *   poll() ensured that this will not block.
          */
         struct udev_device *dev = udev_monitor_receive_device(my_device_list.udev_mon);
         if (dev)
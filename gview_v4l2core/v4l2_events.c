@@ -0,0 +1,631 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "v4l2_controls.h"
+#include "v4l2_events.h"
+#include "core_time.h"
+#include "../config.h"
+
+/*epoll data tags*/
+#define TAG_VIDEO (1)
+#define TAG_WAKE  (2)
+#define TAG_USER  (3)
+#define TAG_UDEV  (4)
+
+/*max v4l2 events dequeued in one go*/
+#define MAX_DQ_EVENTS (64)
+
+extern int verbosity;
+
+/*control value changed by someone else (not yet applied to the control list)*/
+typedef struct _ctrl_event_t
+{
+	uint32_t id;        //control id
+	int32_t value;      //new value
+	int64_t value64;    //new value (64 bit controls)
+} ctrl_event_t;
+
+typedef struct _v4l2_events_t
+{
+	int epoll_fd;       //epoll instance
+	int wake_fd;        //eventfd: wakes up v4l2_events_wait
+	int user_fd;        //extra fd (frame pipeline) or -1
+	int video_fd;       //video fd to watch or -1 (frame sources)
+	int watch_frames;   //video fd is in the epoll set
+	int subscribed;     //number of subscribed v4l2 events
+	uint32_t pending;   //DEV_EVENT_* flags not yet collected (atomic)
+
+	__MUTEX_TYPE ctrl_mutex;   //protects the control events
+	ctrl_event_t *ctrl_events; //control values to apply (v4l2core_update_control_values)
+	int nctrl_events;          //number of control events
+	int max_ctrl_events;       //control events array size (one per control)
+} v4l2_events_t;
+
+/*
+ * add a fd to the epoll set
+ * args:
+ *   events - pointer to events data
+ *   fd - file descriptor
+ *   flags - epoll event flags
+ *   tag - TAG_* value
+ *
+ * asserts:
+ *   events is not null
+ *
+ * returns: error code (E_OK)
+ */
+static int epoll_add(v4l2_events_t *events, int fd, uint32_t flags, uint32_t tag)
+{
+	/*asserts*/
+	assert(events != NULL);
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = flags;
+	ev.data.u32 = tag;
+
+	if(epoll_ctl(events->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (events) couldn't add fd %i to epoll: %s\n", fd, strerror(errno));
+		return E_DEVICE_ERR;
+	}
+
+	return E_OK;
+}
+
+/*
+ * subscribe a v4l2 event
+ * args:
+ *   vd - pointer to video device data
+ *   type - event type
+ *   id - event id (control id)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+static int subscribe_event(v4l2_dev_t *vd, uint32_t type, uint32_t id)
+{
+	struct v4l2_event_subscription sub;
+	memset(&sub, 0, sizeof(struct v4l2_event_subscription));
+	sub.type = type;
+	sub.id = id;
+
+	if(xioctl(vd->fd, VIDIOC_SUBSCRIBE_EVENT, &sub) != 0)
+		return E_DEVICE_ERR;
+
+	return E_OK;
+}
+
+/*
+ * stores a control value change (V4L2_EVENT_CTRL), replacing
+ *  any value still pending for the same control
+ * args:
+ *   events - pointer to events data
+ *   ev - pointer to v4l2 control event
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void store_ctrl_event(v4l2_events_t *events, struct v4l2_event *ev)
+{
+	__LOCK_MUTEX(&events->ctrl_mutex);
+
+	int i = 0;
+	for(i = 0; i < events->nctrl_events; ++i)
+		if(events->ctrl_events[i].id == ev->id)
+			break;
+
+	if(i == events->nctrl_events && events->nctrl_events < events->max_ctrl_events)
+		events->nctrl_events++;
+
+	if(i < events->nctrl_events)
+	{
+		events->ctrl_events[i].id = ev->id;
+		events->ctrl_events[i].value = ev->u.ctrl.value;
+		events->ctrl_events[i].value64 = ev->u.ctrl.value64;
+	}
+
+	__UNLOCK_MUTEX(&events->ctrl_mutex);
+}
+
+/*
+ * dequeue all pending v4l2 events
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *   vd->events is not null
+ *
+ * returns: none
+ */
+static void dequeue_events(v4l2_dev_t *vd)
+{
+	v4l2_events_t *events = vd->events;
+	struct v4l2_event ev;
+	uint32_t flags = 0;
+	int count = 0;
+
+	do
+	{
+		memset(&ev, 0, sizeof(struct v4l2_event));
+		if(xioctl(vd->fd, VIDIOC_DQEVENT, &ev) != 0)
+			break;
+
+		switch(ev.type)
+		{
+			case V4L2_EVENT_CTRL:
+			{
+				if(!(ev.u.ctrl.changes & V4L2_EVENT_CTRL_CH_VALUE))
+					break;
+
+				/*
+				 * the control list belongs to the thread setting the
+				 * controls (e.g. the GUI): store the new value for it
+				 */
+				store_ctrl_event(events, &ev);
+				flags |= DEV_EVENT_CONTROL;
+
+				if(verbosity > 1)
+					printf("V4L2_CORE: (events) control 0x%08x changed to %i\n",
+						ev.id, ev.u.ctrl.value);
+				break;
+			}
+			case V4L2_EVENT_SOURCE_CHANGE:
+				if(ev.u.src_change.changes & V4L2_EVENT_SRC_CH_RESOLUTION)
+				{
+					flags |= DEV_EVENT_SOURCE_CHANGE;
+					if(verbosity > 0)
+						printf("V4L2_CORE: (events) source resolution changed\n");
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	while(ev.pending > 0 && ++count < MAX_DQ_EVENTS);
+
+	if(flags)
+		__atomic_or_fetch(&events->pending, flags, __ATOMIC_RELEASE);
+}
+
+/*
+ * create the device event loop (epoll) with the video fd,
+ *  a wake up eventfd and the udev monitor fd, and subscribe
+ *  control and source change events (call after the control list is set)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2_events_init(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_close(vd);
+
+	v4l2_events_t *events = calloc(1, sizeof(v4l2_events_t));
+	if(events == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2_events_init): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	events->user_fd = -1;
+	events->video_fd = (vd->source == NULL && vd->fd > 0) ? vd->fd : -1;
+
+	events->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(events->epoll_fd < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (events) couldn't create epoll instance: %s\n", strerror(errno));
+		free(events);
+		return E_DEVICE_ERR;
+	}
+
+	events->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(events->wake_fd < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (events) couldn't create eventfd: %s\n", strerror(errno));
+		close(events->epoll_fd);
+		free(events);
+		return E_DEVICE_ERR;
+	}
+
+	/*one pending value per control (at most)*/
+	events->max_ctrl_events = vd->num_controls > 0 ? vd->num_controls : 1;
+	events->ctrl_events = calloc(events->max_ctrl_events, sizeof(ctrl_event_t));
+	if(events->ctrl_events == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2_events_init): %s\n", strerror(errno));
+		exit(-1);
+	}
+	__INIT_MUTEX(&events->ctrl_mutex);
+
+	vd->events = events;
+
+	if(epoll_add(events, events->wake_fd, EPOLLIN, TAG_WAKE) != E_OK)
+	{
+		v4l2_events_close(vd);
+		return E_DEVICE_ERR;
+	}
+
+	/*hot plug: edge triggered, the device list owner reads the monitor*/
+	v4l2_device_list *device_list = v4l2core_get_device_list();
+	if(device_list != NULL && device_list->udev_mon != NULL && device_list->udev_fd > 0)
+		epoll_add(events, device_list->udev_fd, EPOLLIN | EPOLLET, TAG_UDEV);
+
+	if(events->video_fd < 0)
+		return E_OK;
+
+	if(v4l2_events_watch_frames(vd, 1) != E_OK)
+	{
+		v4l2_events_close(vd);
+		return E_DEVICE_ERR;
+	}
+
+	/*control changes (made by others) and source changes*/
+	v4l2_ctrl_t *ctrl = vd->list_device_controls;
+	for(; ctrl != NULL; ctrl = ctrl->next)
+	{
+		if(subscribe_event(vd, V4L2_EVENT_CTRL, ctrl->control.id) == E_OK)
+			events->subscribed++;
+	}
+	if(subscribe_event(vd, V4L2_EVENT_SOURCE_CHANGE, 0) == E_OK)
+		events->subscribed++;
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: (events) subscribed %i device events\n", events->subscribed);
+
+	return E_OK;
+}
+
+/*
+ * unsubscribe the v4l2 events and close the device event loop
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2_events_close(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_t *events = vd->events;
+	if(events == NULL)
+		return;
+
+	if(events->subscribed > 0)
+	{
+		struct v4l2_event_subscription sub;
+		memset(&sub, 0, sizeof(struct v4l2_event_subscription));
+		sub.type = V4L2_EVENT_ALL;
+		xioctl(vd->fd, VIDIOC_UNSUBSCRIBE_EVENT, &sub);
+	}
+
+	close(events->wake_fd);
+	close(events->epoll_fd);
+
+	__CLOSE_MUTEX(&events->ctrl_mutex);
+	free(events->ctrl_events);
+
+	free(events);
+	vd->events = NULL;
+}
+
+/*
+ * add (or remove) an extra fd to the event loop (e.g. the frame pipeline
+ *  eventfd), the caller must consume the data when EV_WAIT_USER is set
+ * args:
+ *   vd - pointer to video device data
+ *   fd - file descriptor (< 0 - remove the current one)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2_events_set_user_fd(v4l2_dev_t *vd, int fd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_t *events = vd->events;
+	if(events == NULL)
+		return E_DEVICE_ERR;
+
+	if(events->user_fd >= 0)
+		epoll_ctl(events->epoll_fd, EPOLL_CTL_DEL, events->user_fd, NULL);
+	events->user_fd = -1;
+
+	if(fd < 0)
+		return E_OK;
+
+	int ret = epoll_add(events, fd, EPOLLIN, TAG_USER);
+	if(ret == E_OK)
+		events->user_fd = fd;
+
+	return ret;
+}
+
+/*
+ * watch (or stop watching) the video fd for frames
+ *  (v4l2 events are only collected while watching)
+ * args:
+ *   vd - pointer to video device data
+ *   watch - 1 to watch; 0 to stop watching
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2_events_watch_frames(v4l2_dev_t *vd, int watch)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_t *events = vd->events;
+	if(events == NULL || events->video_fd < 0)
+		return E_DEVICE_ERR;
+
+	watch = watch ? 1 : 0;
+	if(events->watch_frames == watch)
+		return E_OK;
+
+	/*
+	 * remove the fd instead of masking EPOLLIN:
+	 * EPOLLERR is always reported and would keep waking us up
+	 */
+	if(watch)
+	{
+		if(epoll_add(events, events->video_fd, EPOLLIN | EPOLLPRI, TAG_VIDEO) != E_OK)
+			return E_DEVICE_ERR;
+	}
+	else if(epoll_ctl(events->epoll_fd, EPOLL_CTL_DEL, events->video_fd, NULL) != 0)
+	{
+		fprintf(stderr, "V4L2_CORE: (events) couldn't remove the video fd from epoll: %s\n", strerror(errno));
+		return E_DEVICE_ERR;
+	}
+
+	events->watch_frames = watch;
+	return E_OK;
+}
+
+/*
+ * wait for a frame, user fd data or a wake up, collecting any
+ *  device events (see v4l2core_get_events) in the meantime
+ * args:
+ *   vd - pointer to video device data
+ *   timeout_ms - timeout in ms (< 0 - no timeout)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: EV_WAIT_* flags, 0 on timeout or error code (< 0)
+ */
+int v4l2_events_wait(v4l2_dev_t *vd, int timeout_ms)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_t *events = vd->events;
+	if(events == NULL)
+		return E_DEVICE_ERR;
+
+	uint64_t deadline = (timeout_ms >= 0) ?
+		ns_time_monotonic() + (uint64_t) timeout_ms * 1000000ULL : 0;
+
+	int ready = 0;
+	while(ready == 0)
+	{
+		int wait_ms = -1;
+		if(timeout_ms >= 0)
+		{
+			uint64_t now = ns_time_monotonic();
+			wait_ms = (now < deadline) ? (int) ((deadline - now + 999999) / 1000000) : 0;
+		}
+
+		struct epoll_event ev[4];
+		int n = epoll_wait(events->epoll_fd, ev, 4, wait_ms);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			fprintf(stderr, "V4L2_CORE: (events) epoll_wait error: %s\n", strerror(errno));
+			return E_SELECT_ERR;
+		}
+
+		if(n == 0)
+			return 0; /*timeout*/
+
+		int i = 0;
+		for(i = 0; i < n; ++i)
+		{
+			switch(ev[i].data.u32)
+			{
+				case TAG_VIDEO:
+					if(ev[i].events & EPOLLHUP)
+					{
+						/*the device is gone*/
+						__atomic_or_fetch(&events->pending, DEV_EVENT_HANGUP, __ATOMIC_RELEASE);
+						return E_DEVICE_ERR;
+					}
+					if(ev[i].events & EPOLLPRI)
+						dequeue_events(vd);
+					/*DQBUF reports any error*/
+					if(ev[i].events & (EPOLLIN | EPOLLERR))
+						ready |= EV_WAIT_FRAME;
+					break;
+
+				case TAG_WAKE:
+				{
+					uint64_t count = 0;
+					if(read(events->wake_fd, &count, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+						fprintf(stderr, "V4L2_CORE: (events) eventfd read failed: %s\n", strerror(errno));
+					ready |= EV_WAIT_WAKE;
+					break;
+				}
+
+				case TAG_USER:
+					ready |= EV_WAIT_USER;
+					break;
+
+				case TAG_UDEV:
+					__atomic_or_fetch(&events->pending, DEV_EVENT_DEVICE_LIST, __ATOMIC_RELEASE);
+					break;
+
+				default:
+					break;
+			}
+		}
+	}
+
+	return ready;
+}
+
+/*
+ * wake up a thread waiting in v4l2_events_wait
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2_events_wake(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_t *events = vd->events;
+	if(events == NULL)
+		return;
+
+	uint64_t one = 1;
+	if(write(events->wake_fd, &one, sizeof(uint64_t)) < 0 && verbosity > 2)
+		fprintf(stderr, "V4L2_CORE: (events) eventfd write failed: %s\n", strerror(errno));
+}
+
+/*
+ * wake up the thread waiting for frames (e.g. to act on a request
+ *  made from another thread without waiting for the next frame)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_wake(v4l2_dev_t *vd)
+{
+	v4l2_events_wake(vd);
+}
+
+/*
+ * get (and clear) the device events collected while waiting for frames
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: DEV_EVENT_* flags (0 - none)
+ */
+uint32_t v4l2core_get_events(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_t *events = vd->events;
+	if(events == NULL)
+		return 0;
+
+	return __atomic_exchange_n(&events->pending, 0, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * apply the control values changed by someone else (DEV_EVENT_CONTROL)
+ *  to the control list: call it from the thread that sets the controls
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of updated controls
+ */
+int v4l2core_update_control_values(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	v4l2_events_t *events = vd->events;
+	if(events == NULL)
+		return 0;
+
+	int updated = 0;
+
+	__LOCK_MUTEX(&events->ctrl_mutex);
+	int i = 0;
+	for(i = 0; i < events->nctrl_events; ++i)
+	{
+		v4l2_ctrl_t *ctrl = get_control_by_id(vd, events->ctrl_events[i].id);
+		if(ctrl == NULL)
+			continue;
+
+		if(ctrl->control.type == V4L2_CTRL_TYPE_INTEGER64)
+			ctrl->value64 = events->ctrl_events[i].value64;
+		else
+			ctrl->value = events->ctrl_events[i].value;
+		updated++;
+	}
+	events->nctrl_events = 0;
+	__UNLOCK_MUTEX(&events->ctrl_mutex);
+
+	return updated;
+}
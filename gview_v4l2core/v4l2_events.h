@@ -0,0 +1,113 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef V4L2_EVENTS_H
+#define V4L2_EVENTS_H
+
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+
+/*v4l2_events_wait ready flags*/
+#define EV_WAIT_FRAME  (1 << 0) /*video fd is ready (frame or error)*/
+#define EV_WAIT_USER   (1 << 1) /*user fd is ready (see v4l2_events_set_user_fd)*/
+#define EV_WAIT_WAKE   (1 << 2) /*woken up by v4l2_events_wake*/
+
+/*
+ * create the device event loop (epoll) with the video fd,
+ *  a wake up eventfd and the udev monitor fd, and subscribe
+ *  control and source change events (call after the control list is set)
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2_events_init(v4l2_dev_t *vd);
+
+/*
+ * unsubscribe the v4l2 events and close the device event loop
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2_events_close(v4l2_dev_t *vd);
+
+/*
+ * add (or remove) an extra fd to the event loop (e.g. the frame pipeline
+ *  eventfd), the caller must consume the data when EV_WAIT_USER is set
+ * args:
+ *   vd - pointer to video device data
+ *   fd - file descriptor (< 0 - remove the current one)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2_events_set_user_fd(v4l2_dev_t *vd, int fd);
+
+/*
+ * watch (or stop watching) the video fd for frames
+ *  (v4l2 events are only collected while watching)
+ * args:
+ *   vd - pointer to video device data
+ *   watch - 1 to watch; 0 to stop watching
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2_events_watch_frames(v4l2_dev_t *vd, int watch);
+
+/*
+ * wait for a frame, user fd data or a wake up, collecting any
+ *  device events (see v4l2core_get_events) in the meantime
+ * args:
+ *   vd - pointer to video device data
+ *   timeout_ms - timeout in ms (< 0 - no timeout)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: EV_WAIT_* flags, 0 on timeout or error code (< 0)
+ */
+int v4l2_events_wait(v4l2_dev_t *vd, int timeout_ms);
+
+/*
+ * wake up a thread waiting in v4l2_events_wait
+ * args:
+ *   vd - pointer to video device data
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2_events_wake(v4l2_dev_t *vd);
+
+#endif
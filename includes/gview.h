@@ -84,6 +84,8 @@
 #define __INIT_COND(c)  ( pthread_cond_init (c, NULL) )
 #define __CLOSE_COND(c) ( pthread_cond_destroy(c) )
 #define __COND_BCAST(c) ( pthread_cond_broadcast(c) )
+#define __COND_SIGNAL(c) ( pthread_cond_signal(c) )
+#define __COND_WAIT(c,m) ( pthread_cond_wait(c,m) )
 #define __COND_TIMED_WAIT(c,m,t) ( pthread_cond_timedwait(c,m,t) )
 
 /*next index of ring buffer with size elements*/
@@ -0,0 +1,51 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * application config for the programs linked against gview_v4l2core
+ *  (the library reads the guvcview cmos_camera option through config_get)
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../guvcview/config.h"
+
+/*defaults: usb (uvc) camera*/
+static config_t my_config =
+{
+	.cmos_camera = 0,
+};
+
+/*
+ * get the internal config data
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to internal config_t struct
+ */
+config_t *config_get()
+{
+	return &my_config;
+}
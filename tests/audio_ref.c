@@ -0,0 +1,151 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * sample conversions for check_audio_convert and bench_audio_convert:
+ *  the scalar loops audio_get_next_buffer used before the vector kernels
+ *  (reference - lroundf, rounds half away from zero) and the current
+ *  library functions
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gviewaudio.h"
+#include "audio_simd.h"
+#include "audio_ref.h"
+
+/* saturate float samples to int16 limits*/
+static int16_t clip_int16 (float in)
+{
+	long lout =  lroundf(in);
+	int16_t out = (lout < INT16_MIN) ? INT16_MIN : (lout > INT16_MAX) ? INT16_MAX: (int16_t) lout;
+	return (out);
+}
+
+/*
+ * convert interleaved float samples (reference code)
+ * args:
+ *   type - output type (GV_SAMPLE_TYPE_[INT16|FLOAT|INT16P|FLOATP])
+ *   out - pointer to output samples
+ *   in - pointer to interleaved float samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_ref_convert(int type, void *out, const float *in, int channels, int frames)
+{
+	int size = channels * frames;
+	int i = 0;
+	switch(type)
+	{
+		case GV_SAMPLE_TYPE_FLOAT:
+		{
+			float *my_data = (float *) out;
+			memcpy( my_data, in, size * sizeof(float));
+			break;
+		}
+		case GV_SAMPLE_TYPE_INT16:
+		{
+			int16_t *my_data = (int16_t *) out;
+			for(i = 0; i < size; ++i)
+			{
+				my_data[i] = clip_int16( (in[i]) * INT16_MAX);
+			}
+			break;
+		}
+		case GV_SAMPLE_TYPE_FLOATP:
+		{
+			int j=0;
+
+			float *my_data[channels];
+			const float *buff_p = in;
+
+			for(j = 0; j < channels; ++j)
+				my_data[j] = (float *) (((float *) out) + (j * frames));
+
+			for(i = 0; i < frames; ++i)
+				for(j = 0; j < channels; ++j)
+				{
+					my_data[j][i] = *buff_p++;
+				}
+			break;
+		}
+		case GV_SAMPLE_TYPE_INT16P:
+		{
+			int j=0;
+
+			int16_t *my_data[channels];
+			const float *buff_p = in;
+
+			for(j = 0; j < channels; ++j)
+				my_data[j] = (int16_t *) (((int16_t *) out) + (j * frames));
+
+			for(i = 0; i < frames; ++i)
+				for(j = 0; j < channels; ++j)
+				{
+					my_data[j][i] = clip_int16((*buff_p++) * INT16_MAX);
+				}
+			break;
+		}
+	}
+}
+
+/*
+ * convert interleaved float samples (library code - audio_get_next_buffer)
+ * args:
+ *   type - output type (GV_SAMPLE_TYPE_[INT16|FLOAT|INT16P|FLOATP])
+ *   out - pointer to output samples
+ *   in - pointer to interleaved float samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_lib_convert(int type, void *out, const float *in, int channels, int frames)
+{
+	switch(type)
+	{
+		case GV_SAMPLE_TYPE_FLOAT:
+			memcpy(out, in, channels * frames * sizeof(float));
+			break;
+
+		case GV_SAMPLE_TYPE_INT16:
+			audio_samples_to_s16((int16_t *) out, in, channels * frames);
+			break;
+
+		case GV_SAMPLE_TYPE_FLOATP:
+			audio_samples_to_float_planes((float *) out, in, channels, frames);
+			break;
+
+		case GV_SAMPLE_TYPE_INT16P:
+			audio_samples_to_s16_planes((int16_t *) out, in, channels, frames);
+			break;
+	}
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef AUDIO_REF_H
+#define AUDIO_REF_H
+
+#include <inttypes.h>
+
+/*
+ * convert interleaved float samples (reference code)
+ * args:
+ *   type - output type (GV_SAMPLE_TYPE_[INT16|FLOAT|INT16P|FLOATP])
+ *   out - pointer to output samples
+ *   in - pointer to interleaved float samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_ref_convert(int type, void *out, const float *in, int channels, int frames);
+
+/*
+ * convert interleaved float samples (library code - audio_get_next_buffer)
+ * args:
+ *   type - output type (GV_SAMPLE_TYPE_[INT16|FLOAT|INT16P|FLOATP])
+ *   out - pointer to output samples
+ *   in - pointer to interleaved float samples
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void audio_lib_convert(int type, void *out, const float *in, int channels, int frames);
+
+#endif
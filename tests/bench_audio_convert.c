@@ -0,0 +1,178 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * audio sample conversion benchmark (audio_get_next_buffer)
+ *  times the conversion of interleaved float buffers to int16,
+ *  planar int16 and planar float, with 1, 2 and 6 channels, for the
+ *  library code and for the scalar loops it replaced (reference).
+ *  Results are printed as one json object per line.
+ *
+ *  bench_audio_convert [-f FRAMES] [-n BUFFERS]
+ *    FRAMES per buffer (default 1152 - an mp2/mp3 audio frame)
+ *    the video options of BENCH_ARGS (-s -c -d -t) are ignored
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#include "gviewaudio.h"
+#include "audio_simd.h"
+#include "audio_ref.h"
+
+static const int bench_channels[] = {1, 2, 6};
+static const int bench_types[] = {GV_SAMPLE_TYPE_INT16, GV_SAMPLE_TYPE_INT16P, GV_SAMPLE_TYPE_FLOATP};
+static const char *type_names[] = {"s16", "float", "s16p", "floatp"};
+
+#define NUM_CHANNELS (int)(sizeof(bench_channels) / sizeof(bench_channels[0]))
+#define NUM_TYPES (int)(sizeof(bench_types) / sizeof(bench_types[0]))
+
+typedef void (*convert_t)(int type, void *out, const float *in, int channels, int frames);
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * time a conversion
+ * args:
+ *   convert - conversion function
+ *   type - sample type
+ *   out - output buffer
+ *   in - interleaved float samples
+ *   channels - number of channels
+ *   frames - frames per buffer
+ *   nbuffers - number of buffers to convert
+ *
+ * asserts:
+ *   none
+ *
+ * returns: elapsed time (nanosec)
+ */
+static uint64_t bench_convert(convert_t convert, int type, void *out, const float *in,
+	int channels, int frames, int nbuffers)
+{
+	int i = 0;
+
+	/*warm up (caches and kernel selection)*/
+	for(i = 0; i < 16; ++i)
+		convert(type, out, in, channels, frames);
+
+	uint64_t start = bench_time_ns();
+	for(i = 0; i < nbuffers; ++i)
+		convert(type, out, in, channels, frames);
+	return bench_time_ns() - start;
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 1152;
+	int nbuffers = 20000;
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "f:n:s:c:d:t:m:i:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'f':
+				frames = atoi(optarg);
+				break;
+			case 'n':
+				nbuffers = atoi(optarg);
+				break;
+			case 's':
+			case 'c':
+			case 'd':
+			case 't':
+			case 'm':
+			case 'i':
+				break; /*other benchmarks options (BENCH_ARGS)*/
+			default:
+				fprintf(stderr, "usage: %s [-f FRAMES] [-n BUFFERS]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(frames <= 0 || nbuffers <= 0)
+	{
+		fprintf(stderr, "bench_audio_convert: invalid arguments\n");
+		return 1;
+	}
+
+	int max_channels = bench_channels[NUM_CHANNELS - 1];
+	float *in = calloc((size_t) frames * max_channels, sizeof(float));
+	float *out = calloc((size_t) frames * max_channels, sizeof(float));
+	if(in == NULL || out == NULL)
+	{
+		fprintf(stderr, "bench_audio_convert: memory allocation failure\n");
+		return 1;
+	}
+
+	/*a 440 Hz tone (48 kHz) with some clipping*/
+	int i = 0;
+	for(i = 0; i < frames * max_channels; ++i)
+		in[i] = 1.1f * sinf((float) (i / max_channels) * 2.0f * 3.14159265f * 440.0f / 48000.0f);
+
+	const char *kernels = audio_get_simd()->name;
+
+	int t = 0;
+	int c = 0;
+	for(t = 0; t < NUM_TYPES; ++t)
+		for(c = 0; c < NUM_CHANNELS; ++c)
+		{
+			int type = bench_types[t];
+			int channels = bench_channels[c];
+
+			uint64_t ref_ns = bench_convert(audio_ref_convert, type, out, in,
+				channels, frames, nbuffers);
+			uint64_t lib_ns = bench_convert(audio_lib_convert, type, out, in,
+				channels, frames, nbuffers);
+
+			printf("{\"bench\": \"audio_convert\", \"type\": \"%s\", \"channels\": %i, "
+				"\"frames\": %i, \"buffers\": %i, \"kernels\": \"%s\", "
+				"\"reference_ns\": %.1f, \"library_ns\": %.1f, \"speedup\": %.2f}\n",
+				type_names[type], channels, frames, nbuffers, kernels,
+				(double) ref_ns / nbuffers, (double) lib_ns / nbuffers,
+				(double) ref_ns / (double) (lib_ns ? lib_ns : 1));
+		}
+
+	free(out);
+	free(in);
+	return 0;
+}
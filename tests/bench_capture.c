@@ -0,0 +1,431 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * headless capture to disk benchmark
+ *  drives a frame source (pattern or replay, see frame_source.h)
+ *  through the same path as a guvcview recording: buffer queue and
+ *  decoding (v4l2core_get_decoded_frame), the encoder ring buffer,
+ *  encoding and muxing (encoder_process_next_video_buffer on an
+ *  encoder thread), and prints one json object with the frame rate,
+ *  drops and the time spent in each stage.
+ *
+ *  bench_capture [-d DEVICE] [-s WIDTHxHEIGHT] [-n FRAMES] [-c CODEC_4CC]
+ *                [-m MUXER] [-t DECODER_THREADS]
+ *    -d  frame source (default: unpaced pattern), e.g. replay:FILE@0,
+ *        a directory is replayed unpaced (replay:DIR@0)
+ *    -s  pattern size (default 1280x720)
+ *    -n  number of captured frames (default 300)
+ *    -c  video codec 4cc or raw (default MJPG - builtin jpeg encoder)
+ *    -m  mkv, webm or avi (default mkv)
+ *    -t  decoder threads (default 1)
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <linux/videodev2.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "gviewencoder.h"
+#include "../config.h"
+
+typedef struct _bench_capture_t
+{
+	encoder_context_t *encoder_ctx;
+	int done;                 /*capture finished (atomic)*/
+
+	/*encoder thread stats*/
+	int encoded;
+	int muxed;
+	uint64_t encode_ns;
+	uint64_t capture_to_mux_ns;
+	uint64_t capture_to_mux_max_ns;
+} bench_capture_t;
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * builtin mjpg frame encoder (see encoder_set_mjpg_frame_encoder)
+ * args:
+ *   out - pointer to output buffer
+ *   out_size - output buffer size
+ *   in - pointer to input frame
+ *   data - pointer to jpeg encoder context
+ *
+ * asserts:
+ *   none
+ *
+ * returns: jpeg size or error code (< 0)
+ */
+static int bench_mjpg_frame(uint8_t *out, int out_size, uint8_t *in, void *data)
+{
+	return v4l2core_jpeg_encode((jpeg_encoder_context_t *) data, in, out, out_size);
+}
+
+/*
+ * encoder thread: encodes and muxes the ring buffer frames
+ * args:
+ *   data - pointer to benchmark data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: NULL
+ */
+static void *bench_encoder_loop(void *data)
+{
+	bench_capture_t *bench = (bench_capture_t *) data;
+
+	while(1)
+	{
+		/*read before checking the ring buffer: all frames are in by then*/
+		int done = __atomic_load_n(&bench->done, __ATOMIC_ACQUIRE);
+
+		if(encoder_process_next_video_buffer(bench->encoder_ctx) > 0)
+		{
+			/*capture finished and the ring buffer is empty*/
+			if(done)
+				break;
+
+			encoder_wait_video_buffer(20);
+			continue;
+		}
+
+		encoder_video_timing_t timing;
+		encoder_get_video_timing(&timing);
+
+		bench->encoded++;
+		bench->encode_ns += timing.encode_end - timing.encode_start;
+		if(timing.mux_end > 0 && timing.mux_end >= timing.packet_ts)
+		{
+			uint64_t latency = timing.mux_end - timing.packet_ts;
+			bench->muxed++;
+			bench->capture_to_mux_ns += latency;
+			if(latency > bench->capture_to_mux_max_ns)
+				bench->capture_to_mux_max_ns = latency;
+		}
+	}
+
+	/*delayed frames*/
+	encoder_flush_video_buffer(bench->encoder_ctx);
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *device = NULL;
+	const char *codec_4cc = "MJPG";
+	const char *muxer_name = "mkv";
+	int width = 1280;
+	int height = 720;
+	int nframes = 300;
+	int decoder_threads = 1;
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "d:s:n:c:m:t:i:f:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'd':
+				device = optarg;
+				break;
+			case 's':
+				if(sscanf(optarg, "%ix%i", &width, &height) != 2)
+					width = 0;
+				break;
+			case 'n':
+				nframes = atoi(optarg);
+				break;
+			case 'c':
+				codec_4cc = optarg;
+				break;
+			case 'm':
+				muxer_name = optarg;
+				break;
+			case 't':
+				decoder_threads = atoi(optarg);
+				break;
+			case 'i':
+			case 'f':
+				break; /*other benchmarks options (BENCH_ARGS)*/
+			default:
+				fprintf(stderr, "usage: %s [-d DEVICE] [-s WIDTHxHEIGHT] [-n FRAMES] "
+					"[-c CODEC_4CC] [-m MUXER] [-t DECODER_THREADS]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	int muxer = ENCODER_MUX_MKV;
+	if(strcasecmp(muxer_name, "webm") == 0)
+		muxer = ENCODER_MUX_WEBM;
+	else if(strcasecmp(muxer_name, "avi") == 0)
+		muxer = ENCODER_MUX_AVI;
+	else if(strcasecmp(muxer_name, "mkv") != 0)
+		width = 0;
+
+	if(width <= 0 || height <= 0 || nframes <= 0 || decoder_threads <= 0)
+	{
+		fprintf(stderr, "bench_capture: invalid arguments\n");
+		return 1;
+	}
+
+	/*unpaced sources: frames as fast as the pipeline takes them*/
+	char source[PATH_MAX + 16];
+	struct stat st;
+	if(device == NULL)
+	{
+		snprintf(source, sizeof(source), "pattern:%ix%i@0", width, height);
+		device = source;
+	}
+	else if(stat(device, &st) == 0 && S_ISDIR(st.st_mode))
+	{
+		/*directory of jpeg files (same -d as bench_jpeg_decoder)*/
+		snprintf(source, sizeof(source), "replay:%s@0", device);
+		device = source;
+	}
+
+	v4l2core_set_verbosity(0);
+	v4l2core_set_decoder_threads(decoder_threads);
+	encoder_set_verbosity(0);
+	encoder_init();
+
+	int codec_ind = encoder_get_video_codec_ind_4cc(codec_4cc);
+	/*an unavailable codec may map to another index*/
+	if(codec_ind < 0 || (strcasecmp(codec_4cc, "raw") != 0 &&
+		strcasecmp(encoder_get_video_codec_4cc(codec_ind), codec_4cc) != 0))
+	{
+		fprintf(stderr, "bench_capture: video codec %s not available\n", codec_4cc);
+		return 1;
+	}
+
+	/*frame source (same setup as guvcview)*/
+	v4l2_dev_t *vd = v4l2core_init_dev(device);
+	if(vd == NULL)
+	{
+		fprintf(stderr, "bench_capture: couldn't open %s\n", device);
+		return 1;
+	}
+	v4l2core_set_timestamp_mode(vd, TS_MODE_SYSTEM);
+	v4l2core_prepare_valid_format(vd);
+	v4l2core_prepare_valid_resolution(vd);
+	if(v4l2core_update_current_format(vd) != E_OK)
+	{
+		fprintf(stderr, "bench_capture: couldn't set the format for %s\n", device);
+		v4l2core_close_dev(vd);
+		return 1;
+	}
+
+	width = v4l2core_get_frame_width(vd);
+	height = v4l2core_get_frame_height(vd);
+	int format = v4l2core_get_requested_frame_format(vd);
+
+	/*builtin mjpg video encoder*/
+	jpeg_encoder_context_t *jpeg_ctx = NULL;
+	if(strcasecmp(encoder_get_video_codec_4cc(codec_ind), "MJPG") == 0)
+	{
+#ifdef USE_PLANAR_YUV
+		jpeg_ctx = v4l2core_jpeg_encoder_create(width, height, V4L2_PIX_FMT_YUV420, 0);
+#else
+		jpeg_ctx = v4l2core_jpeg_encoder_create(width, height, V4L2_PIX_FMT_YUYV, 0);
+#endif
+	}
+
+	bench_capture_t bench;
+	memset(&bench, 0, sizeof(bench_capture_t));
+	bench.encoder_ctx = encoder_get_context(
+		format,
+		codec_ind,
+		0, /*no audio*/
+		muxer,
+		width,
+		height,
+		v4l2core_get_fps_num(vd),
+		v4l2core_get_fps_denom(vd),
+		0,
+		0);
+
+	if(bench.encoder_ctx == NULL)
+	{
+		fprintf(stderr, "bench_capture: couldn't create the encoder context\n");
+		v4l2core_close_dev(vd);
+		return 1;
+	}
+
+	if(jpeg_ctx)
+		encoder_set_mjpg_frame_encoder(bench.encoder_ctx, bench_mjpg_frame, jpeg_ctx);
+
+	char filename[64];
+	snprintf(filename, sizeof(filename), "bench_capture_%i.%s", (int) getpid(),
+		muxer == ENCODER_MUX_AVI ? "avi" : (muxer == ENCODER_MUX_WEBM ? "webm" : "mkv"));
+	encoder_muxer_init(bench.encoder_ctx, filename);
+
+	__THREAD_TYPE encoder_thread;
+	if(__THREAD_CREATE(&encoder_thread, bench_encoder_loop, (void *) &bench))
+	{
+		fprintf(stderr, "bench_capture: couldn't create the encoder thread\n");
+		return 1;
+	}
+
+#ifdef USE_PLANAR_YUV
+	int frame_size = (width * height * 3) / 2;
+#else
+	int frame_size = width * height * 2;
+#endif
+
+	int ret = 0;
+	int captured = 0;
+	int dropped = 0;
+	uint64_t decode_ns = 0;
+	uint64_t enqueue_ns = 0;
+
+	v4l2core_start_stream(vd);
+
+	uint64_t start = bench_time_ns();
+	while(captured < nframes)
+	{
+		uint64_t t0 = bench_time_ns();
+		v4l2_frame_buff_t *frame = v4l2core_get_decoded_frame(vd);
+		uint64_t t1 = bench_time_ns();
+
+		if(frame == NULL)
+		{
+			/*a stalled source would never finish*/
+			if(t1 - start > 60 * NSEC_PER_SEC)
+			{
+				fprintf(stderr, "bench_capture: no frames from %s\n", device);
+				ret = 1;
+				break;
+			}
+			continue;
+		}
+
+		decode_ns += t1 - t0;
+		captured++;
+
+		/*raw recordings keep the captured (maybe compressed) frame*/
+		uint8_t *input_frame = frame->yuv_frame;
+		int size = frame_size;
+		if(codec_ind == 0)
+		{
+			if(format == V4L2_PIX_FMT_H264)
+			{
+				input_frame = frame->h264_frame;
+				size = (int) frame->h264_frame_size;
+			}
+			else
+			{
+				input_frame = frame->raw_frame;
+				size = (int) frame->raw_frame_size;
+			}
+		}
+
+		/*copy the frame (guvcview default: frame queue of 1)*/
+		if(encoder_add_video_frame(input_frame, size, frame->timestamp, frame->isKeyframe) != 0)
+			dropped++;
+		enqueue_ns += bench_time_ns() - t1;
+
+		v4l2core_release_frame(vd, frame);
+
+		/*back off as guvcview does when the ring buffer fills up*/
+		uint32_t time_sched = encoder_buff_scheduler(ENCODER_SCHED_EXP, 0.5, 250);
+		if(time_sched > 0)
+		{
+			struct timespec req = {
+				.tv_sec = 0,
+				.tv_nsec = time_sched};/*nanosec*/
+			nanosleep(&req, NULL);
+		}
+	}
+	uint64_t capture_end = bench_time_ns();
+
+	v4l2core_stop_stream(vd);
+
+	__atomic_store_n(&bench.done, 1, __ATOMIC_RELEASE);
+	__THREAD_JOIN(encoder_thread);
+	uint64_t elapsed = bench_time_ns() - start;
+
+	encoder_muxer_close(bench.encoder_ctx);
+	encoder_close(bench.encoder_ctx);
+
+	encoder_io_stats_t io_stats;
+	encoder_get_io_stats(&io_stats);
+
+	if(jpeg_ctx)
+		v4l2core_jpeg_encoder_destroy(jpeg_ctx);
+
+	uint64_t bytes = stat(filename, &st) == 0 ? (uint64_t) st.st_size : 0;
+	unlink(filename);
+
+	int encoded = bench.encoded > 0 ? bench.encoded : 1;
+	int muxed = bench.muxed > 0 ? bench.muxed : 1;
+	printf("{\"bench\": \"capture\", \"device\": \"%s\", \"format\": \"%c%c%c%c\", "
+		"\"codec\": \"%s\", \"muxer\": \"%s\", \"width\": %i, \"height\": %i, "
+		"\"decoder_threads\": %i, \"frames\": %i, \"dropped\": %i, \"encoded\": %i, "
+		"\"muxed\": %i, \"bytes\": %" PRIu64 ", \"elapsed_ms\": %.1f, \"fps\": %.1f, "
+		"\"capture_fps\": %.1f, \"decode_ms\": %.3f, \"enqueue_ms\": %.3f, "
+		"\"encode_ms\": %.3f, \"capture_to_mux_ms\": %.3f, \"capture_to_mux_max_ms\": %.3f, "
+		"\"io_flushes\": %" PRIu64 ", \"io_stall_ms\": %.3f, \"io_stall_max_ms\": %.3f}\n",
+		device, format & 0xFF, (format >> 8) & 0xFF, (format >> 16) & 0xFF, (format >> 24) & 0xFF,
+		encoder_get_video_codec_4cc(codec_ind), muxer_name, width, height,
+		decoder_threads, captured, dropped, bench.encoded, bench.muxed, bytes,
+		(double) elapsed / 1E6,
+		(double) bench.encoded * 1E9 / (double) (elapsed ? elapsed : 1),
+		(double) captured * 1E9 / (double) (capture_end > start ? capture_end - start : 1),
+		(double) decode_ns / ((captured > 0 ? captured : 1) * 1E6),
+		(double) enqueue_ns / ((captured > 0 ? captured : 1) * 1E6),
+		(double) bench.encode_ns / (encoded * 1E6),
+		(double) bench.capture_to_mux_ns / (muxed * 1E6),
+		(double) bench.capture_to_mux_max_ns / 1E6,
+		io_stats.flush_count, (double) io_stats.stall_time / 1E6,
+		(double) io_stats.stall_time_max / 1E6);
+	fflush(stdout);
+
+	v4l2core_close_dev(vd);
+
+	if(bench.encoded == 0)
+		ret = 1;
+
+	return ret;
+}
@@ -0,0 +1,332 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+
+/*
+ * colorspace converter benchmark
+ *  runs every converter in colorspaces.c (raw formats to yu12 and
+ *  yuyv, yu12/yuyv to rgb/bgr, rgb/bgr and bayer to yuv and the jpeg
+ *  decoder mcu writers) over random frames and prints one json object
+ *  per converter with the frame rate and the kernels in use
+ *  (run it with GUVCVIEW_NO_SIMD=1 for the scalar code).
+ *
+ *  bench_colorspaces [-s WIDTHxHEIGHT] [-n FRAMES]
+ *    -s  frame size (default 1280x720)
+ *    -n  number of converted frames per converter (default 30)
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "colorspaces.h"
+#include "colorspaces_simd.h"
+#include "../config.h"
+
+typedef struct _bench_cs_t
+{
+	const char *name;
+	void (*convert)(uint8_t *out, uint8_t *in, int width, int height);
+} bench_cs_t;
+
+/*
+ * converters with the (in, out) argument order
+ */
+static void bench_yuyv2rgb(uint8_t *out, uint8_t *in, int width, int height)
+{
+	yuyv2rgb(in, out, width, height);
+}
+
+static void bench_yuyv2bgr(uint8_t *out, uint8_t *in, int width, int height)
+{
+	yuyv2bgr(in, out, width, height);
+}
+
+static void bench_rgb2yuyv(uint8_t *out, uint8_t *in, int width, int height)
+{
+	rgb2yuyv(in, out, width, height);
+}
+
+static void bench_bgr2yuyv(uint8_t *out, uint8_t *in, int width, int height)
+{
+	bgr2yuyv(in, out, width, height);
+}
+
+static void bench_bayer_to_rgb24(uint8_t *out, uint8_t *in, int width, int height)
+{
+	bayer_to_rgb24(in, out, width, height, 0);
+}
+
+static void bench_yu12_planes_to_yuyv(uint8_t *out, uint8_t *in, int width, int height)
+{
+	uint8_t *pu = in + width * height;
+	uint8_t *pv = pu + width * height / 4;
+	yu12_planes_to_yuyv(out, in, pu, pv, width, width / 2, width, height);
+}
+
+static bench_cs_t bench_cs[] =
+{
+	{"yuyv_to_yu12", yuyv_to_yu12},
+	{"yvyu_to_yu12", yvyu_to_yu12},
+	{"uyvy_to_yu12", uyvy_to_yu12},
+	{"yuv422p_to_yu12", yuv422p_to_yu12},
+	{"yyuv_to_yu12", yyuv_to_yu12},
+	{"yv12_to_yu12", yv12_to_yu12},
+	{"nv12_to_yu12", nv12_to_yu12},
+	{"nv21_to_yu12", nv21_to_yu12},
+	{"nv16_to_yu12", nv16_to_yu12},
+	{"nv61_to_yu12", nv61_to_yu12},
+	{"y10b_to_yu12", y10b_to_yu12},
+	{"y41p_to_yu12", y41p_to_yu12},
+	{"grey_to_yu12", grey_to_yu12},
+	{"y16_to_yu12", y16_to_yu12},
+	{"s501_to_yu12", s501_to_yu12},
+	{"s505_to_yu12", s505_to_yu12},
+	{"s508_to_yu12", s508_to_yu12},
+	{"rgb24_to_yu12", rgb24_to_yu12},
+	{"bgr24_to_yu12", bgr24_to_yu12},
+	{"yu12_to_rgb24", yu12_to_rgb24},
+	{"yu12_to_dib24", yu12_to_dib24},
+	{"yu12_to_yuyv", yu12_to_yuyv},
+	{"yu12_planes_to_yuyv", bench_yu12_planes_to_yuyv},
+	{"yuyv2rgb", bench_yuyv2rgb},
+	{"yuyv2bgr", bench_yuyv2bgr},
+	{"y10b_to_yuyv", y10b_to_yuyv},
+	{"y16_to_yuyv", y16_to_yuyv},
+	{"yyuv_to_yuyv", yyuv_to_yuyv},
+	{"uyvy_to_yuyv", uyvy_to_yuyv},
+	{"yvyu_to_yuyv", yvyu_to_yuyv},
+	{"yvu420_to_yuyv", yvu420_to_yuyv},
+	{"nv12_to_yuyv", nv12_to_yuyv},
+	{"nv21_to_yuyv", nv21_to_yuyv},
+	{"nv16_to_yuyv", nv16_to_yuyv},
+	{"nv61_to_yuyv", nv61_to_yuyv},
+	{"y41p_to_yuyv", y41p_to_yuyv},
+	{"grey_to_yuyv", grey_to_yuyv},
+	{"s501_to_yuyv", s501_to_yuyv},
+	{"s505_to_yuyv", s505_to_yuyv},
+	{"s508_to_yuyv", s508_to_yuyv},
+	{"bayer_to_rgb24", bench_bayer_to_rgb24},
+	{"rgb2yuyv", bench_rgb2yuyv},
+	{"bgr2yuyv", bench_bgr2yuyv},
+	{NULL, NULL}
+};
+
+#if MJPG_BUILTIN
+/*
+ * jpeg decoder mcu writers: yuyv (pitch in bytes) and yu12 output
+ */
+typedef struct _bench_mcu_t
+{
+	const char *name;
+	int mcu_w;
+	int mcu_h;
+	void (*to_yuyv)(int *out, uint8_t *pic, int width);
+	void (*to_yu12)(int *out, uint8_t *py, uint8_t *pu, uint8_t *pv, int width);
+} bench_mcu_t;
+
+static bench_mcu_t bench_mcu[] =
+{
+	{"yuv420pto422", 16, 16, yuv420pto422, NULL},
+	{"yuv422pto422", 16, 8, yuv422pto422, NULL},
+	{"yuv444pto422", 8, 8, yuv444pto422, NULL},
+	{"yuv400pto422", 8, 8, yuv400pto422, NULL},
+	{"yuv420p_to_yu12_mcu", 16, 16, NULL, yuv420p_to_yu12_mcu},
+	{"yuv422p_to_yu12_mcu", 16, 8, NULL, yuv422p_to_yu12_mcu},
+	{"yuv444p_to_yu12_mcu", 8, 8, NULL, yuv444p_to_yu12_mcu},
+	{"yuv400p_to_yu12_mcu", 8, 8, NULL, yuv400p_to_yu12_mcu},
+	{NULL, 0, 0, NULL, NULL}
+};
+#endif
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * simple (reproducible) random number generator - xorshift32
+ * args:
+ *   state - pointer to generator state
+ *
+ * asserts:
+ *   none
+ *
+ * returns: random 32 bit value
+ */
+static uint32_t rand_next(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/*
+ * print the result of a converter run
+ * args:
+ *   name - converter name
+ *   width - frame width
+ *   height - frame height
+ *   nframes - number of converted frames
+ *   elapsed - run time in ns
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void bench_print(const char *name, int width, int height, int nframes, uint64_t elapsed)
+{
+	printf("{\"bench\": \"colorspaces\", \"converter\": \"%s\", \"kernels\": \"%s\", "
+		"\"width\": %i, \"height\": %i, \"frames\": %i, \"elapsed_ms\": %.1f, "
+		"\"frame_ms\": %.3f, \"fps\": %.1f}\n",
+		name, colorspaces_get_simd()->name, width, height, nframes,
+		(double) elapsed / 1E6, (double) elapsed / (nframes * 1E6),
+		(double) nframes * 1E9 / (double) (elapsed ? elapsed : 1));
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	int width = 1280;
+	int height = 720;
+	int nframes = 30;
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "s:n:c:d:t:m:i:f:")) != -1)
+	{
+		switch(opt)
+		{
+			case 's':
+				if(sscanf(optarg, "%ix%i", &width, &height) != 2)
+					width = 0;
+				break;
+			case 'n':
+				nframes = atoi(optarg);
+				break;
+			case 'c':
+			case 'd':
+			case 't':
+			case 'm':
+			case 'i':
+			case 'f':
+				break; /*other benchmarks options (BENCH_ARGS)*/
+			default:
+				fprintf(stderr, "usage: %s [-s WIDTHxHEIGHT] [-n FRAMES]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(width <= 0 || height <= 0 || (width % 16) || (height % 8) || nframes <= 0)
+	{
+		fprintf(stderr, "bench_colorspaces: invalid arguments (the size must be a multiple of 16x8)\n");
+		return 1;
+	}
+
+	/*large enough for any format (up to 4 bytes per pixel)*/
+	size_t frame_size = (size_t) width * height * 4;
+	uint8_t *in = malloc(frame_size);
+	uint8_t *out = malloc(frame_size);
+	if(in == NULL || out == NULL)
+	{
+		fprintf(stderr, "bench_colorspaces: memory allocation failure\n");
+		exit(-1);
+	}
+
+	uint32_t seed = 0x9e3779b9;
+	size_t i = 0;
+	for(i = 0; i < frame_size; ++i)
+		in[i] = rand_next(&seed);
+
+	int t = 0;
+	int n = 0;
+	for(t = 0; bench_cs[t].name != NULL; ++t)
+	{
+		/*untimed warm up*/
+		bench_cs[t].convert(out, in, width, height);
+
+		uint64_t start = bench_time_ns();
+		for(n = 0; n < nframes; ++n)
+			bench_cs[t].convert(out, in, width, height);
+		bench_print(bench_cs[t].name, width, height, nframes, bench_time_ns() - start);
+	}
+
+#if MJPG_BUILTIN
+	/*idct output (with values out of range)*/
+	int mcu[64 * 6];
+	for(i = 0; i < 64 * 6; ++i)
+		mcu[i] = (int) (rand_next(&seed) % 512) - 128;
+
+	for(t = 0; bench_mcu[t].name != NULL; ++t)
+	{
+		int mcu_w = bench_mcu[t].mcu_w;
+		int mcu_h = bench_mcu[t].mcu_h;
+		int pitch = width * 2;
+
+		uint64_t start = bench_time_ns();
+		for(n = 0; n < nframes; ++n)
+		{
+			int mx = 0;
+			int my = 0;
+			for(my = 0; my < height / mcu_h; ++my)
+			{
+				for(mx = 0; mx < width / mcu_w; ++mx)
+				{
+					if(bench_mcu[t].to_yuyv != NULL)
+						bench_mcu[t].to_yuyv(mcu, out + my * mcu_h * pitch + mx * mcu_w * 2, pitch);
+					else
+					{
+						uint8_t *py = out + my * mcu_h * width + mx * mcu_w;
+						uint8_t *pu = out + width * height +
+							(my * mcu_h / 2) * (width / 2) + mx * mcu_w / 2;
+						uint8_t *pv = pu + (width * height) / 4;
+						bench_mcu[t].to_yu12(mcu, py, pu, pv, width);
+					}
+				}
+			}
+		}
+		bench_print(bench_mcu[t].name, width, height, nframes, bench_time_ns() - start);
+	}
+#endif
+
+	free(out);
+	free(in);
+
+	return 0;
+}
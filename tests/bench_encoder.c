@@ -0,0 +1,334 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * video encoder throughput benchmark
+ *  encodes a synthetic sequence (moving gradients and a moving box)
+ *  through encoder_encode_video for every available video codec and
+ *  thread setting (no muxing), and prints one json object per run.
+ *
+ *  bench_encoder [-s WIDTHxHEIGHT] [-n FRAMES] [-c CODEC_4CC]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+#include "gviewencoder.h"
+#include "../config.h"
+
+typedef struct _bench_threads_t
+{
+	int threads;      /*0 - codec default*/
+	int thread_type;  /*ENCODER_THREAD_[AUTO|FRAME|SLICE]*/
+	const char *name;
+} bench_threads_t;
+
+static const char *thread_type_names[] = {"auto", "frame", "slice"};
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * fill a synthetic frame (internal yuv format)
+ * args:
+ *   frame - pointer to frame buffer
+ *   width - frame width
+ *   height - frame height
+ *   n - frame number
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void bench_fill_frame(uint8_t *frame, int width, int height, int n)
+{
+	int x = 0;
+	int y = 0;
+	/*16x16 aligned box moving 3 pixels per frame*/
+	int bx = (n * 3) % (width > 64 ? width - 64 : 1);
+	int by = (n * 2) % (height > 64 ? height - 64 : 1);
+
+#ifdef USE_PLANAR_YUV
+	uint8_t *py = frame;
+	uint8_t *pu = frame + width * height;
+	uint8_t *pv = pu + (width * height) / 4;
+
+	for(y = 0; y < height; ++y)
+		for(x = 0; x < width; ++x)
+		{
+			int inside = (x >= bx && x < bx + 64 && y >= by && y < by + 64);
+			py[y * width + x] = inside ? 235 - ((x ^ y) & 31) : (uint8_t) (x + y + n * 2);
+		}
+
+	for(y = 0; y < height / 2; ++y)
+		for(x = 0; x < width / 2; ++x)
+		{
+			pu[y * (width / 2) + x] = (uint8_t) (128 + ((x + n) & 63) - 32);
+			pv[y * (width / 2) + x] = (uint8_t) (128 + ((y - n) & 63) - 32);
+		}
+#else
+	for(y = 0; y < height; ++y)
+	{
+		uint8_t *p = frame + y * width * 2;
+		for(x = 0; x < width; x += 2)
+		{
+			int inside = (x >= bx && x < bx + 64 && y >= by && y < by + 64);
+			p[0] = inside ? 235 - ((x ^ y) & 31) : (uint8_t) (x + y + n * 2);
+			p[1] = (uint8_t) (128 + ((x / 2 + n) & 63) - 32);
+			p[2] = inside ? 235 - (((x + 1) ^ y) & 31) : (uint8_t) (x + 1 + y + n * 2);
+			p[3] = (uint8_t) (128 + ((y / 2 - n) & 63) - 32);
+			p += 4;
+		}
+	}
+#endif
+}
+
+/*
+ * encode the synthetic sequence and print the results
+ * args:
+ *   codec_ind - video codec index
+ *   bthreads - thread setting
+ *   width - frame width
+ *   height - frame height
+ *   nframes - number of frames
+ *   frames - pointer to the synthetic frames (nframes)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - ok)
+ */
+static int bench_run(int codec_ind, const bench_threads_t *bthreads,
+	int width, int height, int nframes, uint8_t **frames)
+{
+	encoder_set_video_threading(bthreads->threads, bthreads->thread_type, -1);
+
+	encoder_context_t *encoder_ctx = encoder_get_context(
+		V4L2_PIX_FMT_YUYV,
+		codec_ind,
+		0,
+		ENCODER_MUX_MKV,
+		width,
+		height,
+		1,
+		30,
+		0,
+		0);
+
+	if(encoder_ctx == NULL || encoder_ctx->enc_video_ctx == NULL)
+	{
+		fprintf(stderr, "bench_encoder: couldn't open codec %s\n",
+			encoder_get_video_codec_4cc(codec_ind));
+		if(encoder_ctx)
+			encoder_close(encoder_ctx);
+		return -1;
+	}
+
+	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
+
+	uint64_t bytes = 0;
+	int packets = 0;
+	int i = 0;
+
+	uint64_t start = bench_time_ns();
+	for(i = 0; i < nframes; ++i)
+	{
+		/*30 fps timestamps (nanosec)*/
+		enc_video_ctx->pts = (int64_t) i * 1000000000LL / 30;
+
+		encoder_encode_video(encoder_ctx, frames[i]);
+		if(enc_video_ctx->outbuf_coded_size > 0)
+		{
+			bytes += enc_video_ctx->outbuf_coded_size;
+			packets++;
+		}
+	}
+
+	/*delayed frames (lookahead and frame threading)*/
+	int flushed = 0;
+	enc_video_ctx->flush_delayed_frames = 1;
+	while(!enc_video_ctx->flush_done && flushed <= enc_video_ctx->delayed_frames)
+	{
+		encoder_encode_video(encoder_ctx, NULL);
+		if(enc_video_ctx->outbuf_coded_size > 0)
+		{
+			bytes += enc_video_ctx->outbuf_coded_size;
+			packets++;
+		}
+		flushed++;
+	}
+	uint64_t elapsed = bench_time_ns() - start;
+
+	printf("{\"bench\": \"encoder\", \"codec\": \"%s\", \"width\": %i, \"height\": %i, "
+		"\"threads\": \"%s\", \"thread_type\": \"%s\", \"frames\": %i, \"packets\": %i, "
+		"\"bytes\": %" PRIu64 ", \"elapsed_ms\": %.1f, \"fps\": %.1f}\n",
+		encoder_get_video_codec_4cc(codec_ind), width, height,
+		bthreads->name, thread_type_names[bthreads->thread_type],
+		nframes, packets, bytes, (double) elapsed / 1E6,
+		(double) nframes * 1E9 / (double) (elapsed ? elapsed : 1));
+	fflush(stdout);
+
+	encoder_close(encoder_ctx);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int width = 1280;
+	int height = 720;
+	int nframes = 60;
+	const char *codec_4cc = NULL;
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "s:n:c:d:t:m:i:f:")) != -1)
+	{
+		switch(opt)
+		{
+			case 's':
+				if(sscanf(optarg, "%ix%i", &width, &height) != 2)
+					width = 0;
+				break;
+			case 'n':
+				nframes = atoi(optarg);
+				break;
+			case 'c':
+				codec_4cc = optarg;
+				break;
+			case 'd':
+			case 't':
+			case 'm':
+			case 'i':
+			case 'f':
+				break; /*other benchmarks options (BENCH_ARGS)*/
+			default:
+				fprintf(stderr, "usage: %s [-s WIDTHxHEIGHT] [-n FRAMES] [-c CODEC_4CC]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(width <= 0 || height <= 0 || (width % 2) || (height % 2) || nframes <= 0)
+	{
+		fprintf(stderr, "bench_encoder: invalid arguments\n");
+		return 1;
+	}
+
+	encoder_set_verbosity(0);
+	encoder_init();
+
+	/*synthetic sequence (generated up front, not timed)*/
+#ifdef USE_PLANAR_YUV
+	size_t frame_size = (size_t) width * height * 3 / 2;
+#else
+	size_t frame_size = (size_t) width * height * 2;
+#endif
+	uint8_t **frames = calloc(nframes, sizeof(uint8_t *));
+	if(frames == NULL)
+	{
+		fprintf(stderr, "bench_encoder: memory allocation failure\n");
+		exit(-1);
+	}
+	int i = 0;
+	for(i = 0; i < nframes; ++i)
+	{
+		frames[i] = malloc(frame_size);
+		if(frames[i] == NULL)
+		{
+			fprintf(stderr, "bench_encoder: memory allocation failure\n");
+			exit(-1);
+		}
+		bench_fill_frame(frames[i], width, height, i);
+	}
+
+	/*thread settings: codec defaults, 1 thread and up to the core count*/
+	int ncores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if(ncores > ENCODER_MAX_THREADS)
+		ncores = ENCODER_MAX_THREADS;
+	if(ncores < 1)
+		ncores = 1;
+
+	bench_threads_t bthreads[16];
+	char names[16][8];
+	int nsettings = 0;
+	bthreads[nsettings].threads = 0;
+	bthreads[nsettings].thread_type = ENCODER_THREAD_AUTO;
+	bthreads[nsettings].name = "default";
+	nsettings++;
+
+	int n = 0;
+	for(n = 1; n <= ncores && nsettings < 14; n *= 2)
+	{
+		int type = 0;
+		for(type = ENCODER_THREAD_FRAME; type <= ENCODER_THREAD_SLICE; ++type)
+		{
+			/*a single thread doesn't need both types*/
+			if(n == 1 && type == ENCODER_THREAD_SLICE)
+				continue;
+			snprintf(names[nsettings], sizeof(names[nsettings]), "%i", n);
+			bthreads[nsettings].threads = n;
+			bthreads[nsettings].thread_type = type;
+			bthreads[nsettings].name = names[nsettings];
+			nsettings++;
+		}
+	}
+
+	int ret = 0;
+	int codec_ind = 0;
+	/*skip raw (0): no encoding*/
+	for(codec_ind = 1; codec_ind < encoder_get_valid_video_codecs(); ++codec_ind)
+	{
+		const char *c4cc = encoder_get_video_codec_4cc(codec_ind);
+		if(codec_4cc != NULL && (c4cc == NULL || strcasecmp(codec_4cc, c4cc) != 0))
+			continue;
+
+		int s = 0;
+		for(s = 0; s < nsettings; ++s)
+			if(bench_run(codec_ind, &bthreads[s], width, height, nframes, frames) != 0)
+				ret = 1;
+	}
+
+	for(i = 0; i < nframes; ++i)
+		free(frames[i]);
+	free(frames);
+
+	return ret;
+}
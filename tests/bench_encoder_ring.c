@@ -0,0 +1,327 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * encoder video ring buffer microbenchmark
+ *  a producer thread adds frames at a fixed rate (copied with
+ *  encoder_add_video_frame or referenced with encoder_add_video_frame_ref)
+ *  while the encoder thread (raw codec, matroska muxer) is slowed down,
+ *  and the producer side latency of each call is measured.
+ *  Results are printed as one json object per line.
+ *
+ *  bench_encoder_ring [-s WIDTHxHEIGHT] [-n FRAMES] [-i INTERVAL_US]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+#include "gview.h"
+#include "gviewencoder.h"
+
+/*consumer behaviour*/
+#define CONSUMER_STEADY (0) /*encodes as soon as a frame is available*/
+#define CONSUMER_SLOW   (1) /*every frame takes twice the frame interval*/
+#define CONSUMER_STALL  (2) /*stalls for 1/2 sec every 50 frames (disk hiccup)*/
+
+static const char *consumer_names[] = {"steady", "slow", "stall"};
+
+typedef struct _bench_ring_t
+{
+	encoder_context_t *encoder_ctx;
+	int consumer;
+	int interval_us;
+	int done;        /*producer finished (atomic)*/
+	int released;    /*frame references released (atomic)*/
+} bench_ring_t;
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * sleep until a monotonic time
+ * args:
+ *   ts - monotonic time (in nanosec)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void bench_sleep_until(uint64_t ts)
+{
+	struct timespec t;
+	t.tv_sec = ts / 1000000000ULL;
+	t.tv_nsec = ts % 1000000000ULL;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) != 0);
+}
+
+/*
+ * frame reference release callback (encoder thread)
+ * args:
+ *   data - pointer to benchmark data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void bench_frame_release(void *data)
+{
+	bench_ring_t *bench = (bench_ring_t *) data;
+	__atomic_add_fetch(&bench->released, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * encoder thread (ring buffer consumer)
+ * args:
+ *   data - pointer to benchmark data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: NULL
+ */
+static void *bench_consumer(void *data)
+{
+	bench_ring_t *bench = (bench_ring_t *) data;
+	int frames = 0;
+
+	while(!__atomic_load_n(&bench->done, __ATOMIC_ACQUIRE))
+	{
+		if(encoder_wait_video_buffer(20) != 0)
+			continue;
+
+		if(bench->consumer == CONSUMER_SLOW)
+			usleep(bench->interval_us * 2);
+		else if(bench->consumer == CONSUMER_STALL && (frames % 50) == 49)
+			usleep(500000);
+
+		encoder_process_next_video_buffer(bench->encoder_ctx);
+		frames++;
+	}
+
+	encoder_flush_video_buffer(bench->encoder_ctx);
+
+	return NULL;
+}
+
+/*
+ * compare two 64 bit values (qsort)
+ */
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t va = *((const uint64_t *) a);
+	uint64_t vb = *((const uint64_t *) b);
+	return (va > vb) - (va < vb);
+}
+
+/*
+ * run one benchmark scenario and print the results
+ * args:
+ *   width - frame width
+ *   height - frame height
+ *   nframes - number of frames to add
+ *   interval_us - frame interval (in microsec)
+ *   by_ref - add frames by reference (no copy)
+ *   consumer - consumer behaviour
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - ok)
+ */
+static int bench_run(int width, int height, int nframes, int interval_us, int by_ref, int consumer)
+{
+	int frame_size = width * height * 2; /*yuyv*/
+	uint8_t *frame = malloc(frame_size);
+	uint64_t *latency = calloc(nframes, sizeof(uint64_t));
+	if(frame == NULL || latency == NULL)
+	{
+		fprintf(stderr, "bench_encoder_ring: memory allocation failure\n");
+		exit(-1);
+	}
+	memset(frame, 0x80, frame_size);
+
+	char filename[64];
+	snprintf(filename, sizeof(filename), "bench_encoder_ring_%i.mkv", (int) getpid());
+
+	/*raw video (no encoding cost in the consumer besides the delays)*/
+	bench_ring_t bench;
+	memset(&bench, 0, sizeof(bench_ring_t));
+	bench.consumer = consumer;
+	bench.interval_us = interval_us;
+	bench.encoder_ctx = encoder_get_context(
+		V4L2_PIX_FMT_YUYV,
+		0, /*raw*/
+		0,
+		ENCODER_MUX_MKV,
+		width,
+		height,
+		1,
+		1000000 / interval_us,
+		0,
+		0);
+
+	if(bench.encoder_ctx == NULL)
+	{
+		fprintf(stderr, "bench_encoder_ring: couldn't create the encoder context\n");
+		return -1;
+	}
+
+	encoder_muxer_init(bench.encoder_ctx, filename);
+
+	__THREAD_TYPE consumer_thread;
+	if(__THREAD_CREATE(&consumer_thread, bench_consumer, (void *) &bench))
+	{
+		fprintf(stderr, "bench_encoder_ring: couldn't create the consumer thread\n");
+		return -1;
+	}
+
+	int dropped = 0;
+	int i = 0;
+	uint64_t start = bench_time_ns();
+	for(i = 0; i < nframes; ++i)
+	{
+		uint64_t ts = start + (uint64_t) i * interval_us * 1000;
+		bench_sleep_until(ts);
+
+		uint64_t t0 = bench_time_ns();
+		int ret = by_ref ?
+			encoder_add_video_frame_ref(frame, frame_size, ts, 1, bench_frame_release, &bench) :
+			encoder_add_video_frame(frame, frame_size, ts, 1);
+		latency[i] = bench_time_ns() - t0;
+
+		if(ret != 0)
+			dropped++;
+	}
+	uint64_t elapsed = bench_time_ns() - start;
+
+	__atomic_store_n(&bench.done, 1, __ATOMIC_RELEASE);
+	__THREAD_JOIN(consumer_thread);
+
+	encoder_muxer_close(bench.encoder_ctx);
+	encoder_close(bench.encoder_ctx);
+	unlink(filename);
+
+	uint64_t total = 0;
+	for(i = 0; i < nframes; ++i)
+		total += latency[i];
+	qsort(latency, nframes, sizeof(uint64_t), cmp_u64);
+
+	printf("{\"bench\": \"encoder_ring\", \"width\": %i, \"height\": %i, \"mode\": \"%s\", "
+		"\"consumer\": \"%s\", \"frames\": %i, \"dropped\": %i, \"elapsed_ms\": %.1f, "
+		"\"add_avg_ns\": %" PRIu64 ", \"add_p50_ns\": %" PRIu64 ", \"add_p99_ns\": %" PRIu64 ", "
+		"\"add_max_ns\": %" PRIu64 "}\n",
+		width, height, by_ref ? "ref" : "copy", consumer_names[consumer],
+		nframes, dropped, (double) elapsed / 1E6,
+		total / nframes,
+		latency[nframes / 2],
+		latency[(nframes * 99) / 100],
+		latency[nframes - 1]);
+	fflush(stdout);
+
+	/*every referenced frame must be released*/
+	int ret = 0;
+	if(by_ref && bench.released != nframes - dropped)
+	{
+		fprintf(stderr, "bench_encoder_ring: %i frame references not released\n",
+			nframes - dropped - bench.released);
+		ret = -1;
+	}
+
+	free(latency);
+	free(frame);
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	int width = 1280;
+	int height = 720;
+	int nframes = 500;
+	int interval_us = 5000; /*200 fps*/
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "s:n:i:c:d:t:m:f:")) != -1)
+	{
+		switch(opt)
+		{
+			case 's':
+				if(sscanf(optarg, "%ix%i", &width, &height) != 2)
+					width = 0;
+				break;
+			case 'n':
+				nframes = atoi(optarg);
+				break;
+			case 'i':
+				interval_us = atoi(optarg);
+				break;
+			case 'c':
+			case 'd':
+			case 't':
+			case 'm':
+			case 'f':
+				break; /*other benchmarks options (BENCH_ARGS)*/
+			default:
+				fprintf(stderr, "usage: %s [-s WIDTHxHEIGHT] [-n FRAMES] [-i INTERVAL_US]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(width <= 0 || height <= 0 || nframes <= 0 || interval_us <= 0)
+	{
+		fprintf(stderr, "bench_encoder_ring: invalid arguments\n");
+		return 1;
+	}
+
+	encoder_set_verbosity(0);
+	encoder_init();
+
+	int ret = 0;
+	int by_ref = 0;
+	int consumer = 0;
+	for(by_ref = 0; by_ref < 2; ++by_ref)
+		for(consumer = CONSUMER_STEADY; consumer <= CONSUMER_STALL; ++consumer)
+			if(bench_run(width, height, nframes, interval_us, by_ref, consumer) != 0)
+				ret = 1;
+
+	return ret;
+}
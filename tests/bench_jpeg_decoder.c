@@ -0,0 +1,442 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * (m)jpeg decoder benchmark
+ *  decodes a set of mjpeg frames (captured frames from a directory
+ *  or synthetic frames coded with the builtin jpeg encoder) with 1 and
+ *  up to JPEG_MAX_THREADS restart interval threads and prints one json
+ *  object per run with the frame rate and the time spent in each
+ *  decoding stage (entropy, idct and output - builtin decoder only).
+ *
+ *  bench_jpeg_decoder [-d DIR] [-s WIDTHxHEIGHT] [-n FRAMES] [-t THREADS]
+ *    -d  decode every (mjpeg) file in DIR (e.g. frames dumped by the
+ *        replay source), all with the same geometry
+ *    -s  synthetic frame size (without -d)
+ *    -n  number of decoded frames per run (frames are repeated)
+ *    -t  max restart interval threads (defaults to the core count)
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <linux/videodev2.h>
+
+#include "gviewv4l2core.h"
+#include "jpeg_decoder.h"
+#include "../config.h"
+
+typedef struct _bench_frame_t
+{
+	uint8_t *data;
+	int size;
+} bench_frame_t;
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * get the frame size from the jpeg SOF marker
+ * args:
+ *   data - pointer to jpeg data
+ *   size - jpeg data size
+ *   width - pointer to width (filled)
+ *   height - pointer to height (filled)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - ok)
+ */
+static int bench_jpeg_size(uint8_t *data, int size, int *width, int *height)
+{
+	if(size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+		return -1;
+
+	int i = 2;
+	while(i + 9 < size)
+	{
+		if(data[i] != 0xFF)
+			return -1;
+
+		uint8_t marker = data[i + 1];
+		int len = (data[i + 2] << 8) | data[i + 3];
+
+		/*SOF0 - SOF2*/
+		if(marker >= 0xC0 && marker <= 0xC2)
+		{
+			*height = (data[i + 5] << 8) | data[i + 6];
+			*width = (data[i + 7] << 8) | data[i + 8];
+			return 0;
+		}
+
+		/*start of scan: no frame header*/
+		if(marker == 0xDA)
+			return -1;
+
+		i += 2 + len;
+	}
+
+	return -1;
+}
+
+/*
+ * load every file in a directory
+ * args:
+ *   dir - directory path
+ *   frames - pointer to frame list (allocated)
+ *   width - pointer to frame width (filled)
+ *   height - pointer to frame height (filled)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of loaded frames (< 0 on error)
+ */
+static int bench_load_dir(const char *dir, bench_frame_t **frames, int *width, int *height)
+{
+	struct dirent **namelist = NULL;
+	int n = scandir(dir, &namelist, NULL, alphasort);
+	if(n < 0)
+	{
+		fprintf(stderr, "bench_jpeg_decoder: couldn't open %s\n", dir);
+		return -1;
+	}
+
+	*frames = calloc(n > 0 ? n : 1, sizeof(bench_frame_t));
+	if(*frames == NULL)
+	{
+		fprintf(stderr, "bench_jpeg_decoder: memory allocation failure\n");
+		exit(-1);
+	}
+
+	int nframes = 0;
+	int i = 0;
+	for(i = 0; i < n; ++i)
+	{
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s", dir, namelist[i]->d_name);
+		free(namelist[i]);
+
+		struct stat st;
+		if(stat(path, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+			continue;
+
+		FILE *fp = fopen(path, "rb");
+		if(fp == NULL)
+			continue;
+
+		uint8_t *data = malloc(st.st_size);
+		if(data == NULL)
+		{
+			fprintf(stderr, "bench_jpeg_decoder: memory allocation failure\n");
+			exit(-1);
+		}
+		int size = (int) fread(data, 1, st.st_size, fp);
+		fclose(fp);
+
+		int w = 0;
+		int h = 0;
+		if(bench_jpeg_size(data, size, &w, &h) != 0 ||
+			(nframes > 0 && (w != *width || h != *height)))
+		{
+			fprintf(stderr, "bench_jpeg_decoder: skipping %s (not a jpeg or a different size)\n", path);
+			free(data);
+			continue;
+		}
+
+		*width = w;
+		*height = h;
+		(*frames)[nframes].data = data;
+		(*frames)[nframes].size = size;
+		nframes++;
+	}
+	free(namelist);
+
+	return nframes;
+}
+
+/*
+ * code synthetic frames (4:2:2 like most uvc cameras)
+ * args:
+ *   frames - pointer to frame list (allocated)
+ *   width - frame width
+ *   height - frame height
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of frames (< 0 on error)
+ */
+static int bench_synthetic_frames(bench_frame_t **frames, int width, int height)
+{
+	int nframes = 8;
+
+	jpeg_encoder_context_t *jpeg_enc = v4l2core_jpeg_encoder_create(
+		width, height, V4L2_PIX_FMT_YUYV, JPEG_ENCODER_DEF_QUALITY);
+	if(jpeg_enc == NULL)
+		return -1;
+
+	int out_size = width * height * 2 + 4096;
+	uint8_t *yuyv = malloc(width * height * 2);
+	*frames = calloc(nframes, sizeof(bench_frame_t));
+	if(yuyv == NULL || *frames == NULL)
+	{
+		fprintf(stderr, "bench_jpeg_decoder: memory allocation failure\n");
+		exit(-1);
+	}
+
+	int n = 0;
+	for(n = 0; n < nframes; ++n)
+	{
+		/*gradients plus some texture and a moving box*/
+		int bx = (n * 24) % (width > 64 ? width - 64 : 1);
+		int x = 0;
+		int y = 0;
+		for(y = 0; y < height; ++y)
+		{
+			uint8_t *p = yuyv + y * width * 2;
+			for(x = 0; x < width; x += 2)
+			{
+				int inside = (x >= bx && x < bx + 64 && y >= height / 4 && y < height / 4 + 64);
+				p[0] = inside ? 16 : (uint8_t) (x + y + ((x * y) & 15));
+				p[1] = (uint8_t) (128 + ((x / 2 + n * 4) & 63) - 32);
+				p[2] = inside ? 16 : (uint8_t) (x + 1 + y + (((x + 1) * y) & 15));
+				p[3] = (uint8_t) (128 + ((y / 2 - n * 4) & 63) - 32);
+				p += 4;
+			}
+		}
+
+		(*frames)[n].data = malloc(out_size);
+		if((*frames)[n].data == NULL)
+		{
+			fprintf(stderr, "bench_jpeg_decoder: memory allocation failure\n");
+			exit(-1);
+		}
+		(*frames)[n].size = v4l2core_jpeg_encode(jpeg_enc, yuyv, (*frames)[n].data, out_size);
+		if((*frames)[n].size <= 0)
+		{
+			fprintf(stderr, "bench_jpeg_decoder: couldn't code a synthetic frame\n");
+			nframes = -1;
+			break;
+		}
+	}
+
+	free(yuyv);
+	v4l2core_jpeg_encoder_destroy(jpeg_enc);
+
+	return nframes;
+}
+
+/*
+ * decode the frames and print the results
+ * args:
+ *   frames - pointer to frame list
+ *   nframes - number of frames in list
+ *   width - frame width
+ *   height - frame height
+ *   threads - restart interval threads
+ *   ndecode - number of frames to decode
+ *   source - frame source name
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - ok)
+ */
+static int bench_run(bench_frame_t *frames, int nframes, int width, int height,
+	int threads, int ndecode, const char *source)
+{
+	jpeg_decoder_context_t *jpeg_ctx = jpeg_create_decoder(width, height);
+	if(jpeg_ctx == NULL)
+	{
+		fprintf(stderr, "bench_jpeg_decoder: couldn't create the decoder\n");
+		return -1;
+	}
+
+	jpeg_set_decoder_threads(jpeg_ctx, threads);
+
+#ifdef USE_PLANAR_YUV
+	uint8_t *out = malloc(width * height * 3 / 2);
+#else
+	uint8_t *out = malloc(width * height * 2);
+#endif
+	if(out == NULL)
+	{
+		fprintf(stderr, "bench_jpeg_decoder: memory allocation failure\n");
+		exit(-1);
+	}
+
+	int ret = 0;
+	int errors = 0;
+	int i = 0;
+
+	/*untimed warm up (starts the restart interval threads)*/
+	jpeg_decode(jpeg_ctx, out, frames[0].data, frames[0].size);
+
+	/*wall time, without the stage timing overhead*/
+	jpeg_set_decoder_profile(jpeg_ctx, 0);
+	uint64_t start = bench_time_ns();
+	for(i = 0; i < ndecode; ++i)
+		if(jpeg_decode(jpeg_ctx, out, frames[i % nframes].data, frames[i % nframes].size) < 0)
+			errors++;
+	uint64_t elapsed = bench_time_ns() - start;
+
+	/*stage times (second pass, profiled)*/
+	jpeg_decoder_stats_t stats0;
+	jpeg_decoder_stats_t stats;
+	jpeg_get_decoder_stats(jpeg_ctx, &stats0);
+	jpeg_set_decoder_profile(jpeg_ctx, 1);
+	for(i = 0; i < ndecode; ++i)
+		jpeg_decode(jpeg_ctx, out, frames[i % nframes].data, frames[i % nframes].size);
+	int has_stats = (jpeg_get_decoder_stats(jpeg_ctx, &stats) == E_OK);
+	jpeg_set_decoder_profile(jpeg_ctx, 0);
+
+	printf("{\"bench\": \"jpeg_decoder\", \"source\": \"%s\", \"width\": %i, \"height\": %i, "
+		"\"threads\": %i, \"frames\": %i, \"errors\": %i, \"elapsed_ms\": %.1f, \"fps\": %.1f",
+		source, width, height, threads, ndecode, errors, (double) elapsed / 1E6,
+		(double) ndecode * 1E9 / (double) (elapsed ? elapsed : 1));
+	if(has_stats)
+	{
+		uint32_t frames_profiled = stats.frames - stats0.frames;
+		printf(", \"idct\": \"%s\", \"parallel_frames\": %u, "
+			"\"entropy_ms\": %.3f, \"idct_ms\": %.3f, \"output_ms\": %.3f",
+			stats.idct, stats.frames_parallel - stats0.frames_parallel,
+			(double) (stats.entropy_ns - stats0.entropy_ns) / (frames_profiled * 1E6),
+			(double) (stats.idct_ns - stats0.idct_ns) / (frames_profiled * 1E6),
+			(double) (stats.output_ns - stats0.output_ns) / (frames_profiled * 1E6));
+	}
+	printf("}\n");
+	fflush(stdout);
+
+	if(errors > 0)
+		ret = -1;
+
+	free(out);
+	jpeg_destroy_decoder(jpeg_ctx);
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = NULL;
+	int width = 1280;
+	int height = 720;
+	int ndecode = 200;
+	int max_threads = 0;
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "d:s:n:t:c:m:i:f:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'd':
+				dir = optarg;
+				break;
+			case 's':
+				if(sscanf(optarg, "%ix%i", &width, &height) != 2)
+					width = 0;
+				break;
+			case 'n':
+				ndecode = atoi(optarg);
+				break;
+			case 't':
+				max_threads = atoi(optarg);
+				break;
+			case 'c':
+			case 'm':
+			case 'i':
+			case 'f':
+				break; /*other benchmarks options (BENCH_ARGS)*/
+			default:
+				fprintf(stderr, "usage: %s [-d DIR] [-s WIDTHxHEIGHT] [-n FRAMES] [-t THREADS]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(width <= 0 || height <= 0 || (width % 16) || (height % 8) || ndecode <= 0)
+	{
+		fprintf(stderr, "bench_jpeg_decoder: invalid arguments (the size must be a multiple of 16x8)\n");
+		return 1;
+	}
+
+	v4l2core_set_verbosity(0);
+
+	bench_frame_t *frames = NULL;
+	int nframes = 0;
+	if(dir != NULL)
+		nframes = bench_load_dir(dir, &frames, &width, &height);
+	else
+		nframes = bench_synthetic_frames(&frames, width, height);
+
+	if(nframes <= 0)
+	{
+		fprintf(stderr, "bench_jpeg_decoder: no frames to decode\n");
+		return 1;
+	}
+
+	int ncores = max_threads > 0 ? max_threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if(ncores < 1)
+		ncores = 1;
+	if(ncores > JPEG_MAX_THREADS)
+		ncores = JPEG_MAX_THREADS;
+
+	int ret = 0;
+	int threads = 1;
+	for(threads = 1; ; threads *= 2)
+	{
+		if(threads > ncores)
+			threads = ncores;
+		if(bench_run(frames, nframes, width, height, threads, ndecode,
+				dir != NULL ? "dir" : "synthetic") != 0)
+			ret = 1;
+		if(threads >= ncores)
+			break;
+	}
+
+	int i = 0;
+	for(i = 0; i < nframes; ++i)
+		free(frames[i].data);
+	free(frames);
+
+	return ret;
+}
@@ -0,0 +1,226 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+
+/*
+ * image writer benchmark
+ *  saves a synthetic frame with each image writer (save_image_jpeg,
+ *  save_image_bmp and save_image_png) to a temporary file and prints
+ *  one json object per format with the time per image and the file size.
+ *
+ *  bench_save_image [-s WIDTHxHEIGHT] [-n IMAGES]
+ *    -s  frame size (default 1280x720)
+ *    -n  number of saved images per format (default 10)
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "save_image.h"
+#include "../config.h"
+
+typedef struct _bench_writer_t
+{
+	const char *name;
+	int (*save)(v4l2_frame_buff_t *frame, int width, int height, const char *filename);
+} bench_writer_t;
+
+static bench_writer_t bench_writer[] =
+{
+	{"jpeg", save_image_jpeg},
+	{"bmp", save_image_bmp},
+	{"png", save_image_png},
+	{NULL, NULL}
+};
+
+/*
+ * get monotonic time (in nanosec)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * fill the frame with a gradient and some noise (so that the
+ *  compressed formats have something to work with)
+ * args:
+ *   frame - pointer to frame buffer
+ *   width - frame width
+ *   height - frame height
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void fill_frame(uint8_t *frame, int width, int height)
+{
+	uint32_t seed = 0x9e3779b9;
+	int i = 0;
+	int j = 0;
+
+#ifdef USE_PLANAR_YUV
+	uint8_t *pu = frame + width * height;
+	uint8_t *pv = pu + width * height / 4;
+	for(i = 0; i < height; ++i)
+	{
+		for(j = 0; j < width; ++j)
+		{
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			frame[i * width + j] = (uint8_t) ((i + j) + (seed & 0x0f));
+			if(!(i & 1) && !(j & 1))
+			{
+				pu[(i / 2) * (width / 2) + j / 2] = (uint8_t) (j * 255 / width);
+				pv[(i / 2) * (width / 2) + j / 2] = (uint8_t) (i * 255 / height);
+			}
+		}
+	}
+#else
+	for(i = 0; i < height; ++i)
+	{
+		for(j = 0; j < width; j += 2)
+		{
+			uint8_t *p = frame + (i * width + j) * 2;
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			p[0] = (uint8_t) ((i + j) + (seed & 0x0f));
+			p[1] = (uint8_t) (j * 255 / width);
+			p[2] = (uint8_t) ((i + j + 1) + ((seed >> 4) & 0x0f));
+			p[3] = (uint8_t) (i * 255 / height);
+		}
+	}
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	int width = 1280;
+	int height = 720;
+	int nimages = 10;
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "s:n:c:d:t:m:i:f:")) != -1)
+	{
+		switch(opt)
+		{
+			case 's':
+				if(sscanf(optarg, "%ix%i", &width, &height) != 2)
+					width = 0;
+				break;
+			case 'n':
+				nimages = atoi(optarg);
+				break;
+			case 'c':
+			case 'd':
+			case 't':
+			case 'm':
+			case 'i':
+			case 'f':
+				break; /*other benchmarks options (BENCH_ARGS)*/
+			default:
+				fprintf(stderr, "usage: %s [-s WIDTHxHEIGHT] [-n IMAGES]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if(width <= 0 || height <= 0 || (width % 16) || (height % 8) || nimages <= 0)
+	{
+		fprintf(stderr, "bench_save_image: invalid arguments (the size must be a multiple of 16x8)\n");
+		return 1;
+	}
+
+	v4l2_frame_buff_t frame;
+	memset(&frame, 0, sizeof(v4l2_frame_buff_t));
+	frame.yuv_frame = malloc(width * height * 2);
+	if(frame.yuv_frame == NULL)
+	{
+		fprintf(stderr, "bench_save_image: memory allocation failure\n");
+		exit(-1);
+	}
+	fill_frame(frame.yuv_frame, width, height);
+
+	const char *tmpdir = getenv("TMPDIR");
+	if(tmpdir == NULL || tmpdir[0] == '\0')
+		tmpdir = "/tmp";
+
+	int ret = 0;
+	int t = 0;
+	for(t = 0; bench_writer[t].name != NULL; ++t)
+	{
+		char filename[PATH_MAX];
+		snprintf(filename, PATH_MAX, "%s/bench_save_image_XXXXXX", tmpdir);
+		int fd = mkstemp(filename);
+		if(fd < 0)
+		{
+			fprintf(stderr, "bench_save_image: couldn't create a file in %s\n", tmpdir);
+			ret = 1;
+			break;
+		}
+		close(fd);
+
+		int n = 0;
+		int err = 0;
+		uint64_t start = bench_time_ns();
+		for(n = 0; n < nimages && err == 0; ++n)
+			err = bench_writer[t].save(&frame, width, height, filename);
+		uint64_t elapsed = bench_time_ns() - start;
+
+		struct stat st;
+		long long size = (stat(filename, &st) == 0) ? (long long) st.st_size : 0;
+		unlink(filename);
+
+		if(err != 0)
+		{
+			fprintf(stderr, "bench_save_image: %s writer failed (%i)\n",
+				bench_writer[t].name, err);
+			ret = 1;
+			continue;
+		}
+
+		printf("{\"bench\": \"save_image\", \"format\": \"%s\", \"width\": %i, "
+			"\"height\": %i, \"images\": %i, \"elapsed_ms\": %.1f, "
+			"\"image_ms\": %.2f, \"bytes\": %lld}\n",
+			bench_writer[t].name, width, height, nimages,
+			(double) elapsed / 1E6, (double) elapsed / (nimages * 1E6), size);
+		fflush(stdout);
+	}
+
+	free(frame.yuv_frame);
+
+	return ret;
+}
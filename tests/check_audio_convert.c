@@ -0,0 +1,291 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * check for the audio sample conversions (audio_get_next_buffer)
+ *  random buffers of 1, 2 and 6 channels (and frame counts that are not
+ *  a multiple of the vector size) are converted to every sample type
+ *  with the library code and with the scalar loops it replaced:
+ *  float output must be equal, int16 output may only differ by 1 on
+ *  exact .5 ties (rounds to nearest even instead of away from zero).
+ *  Out of range, infinite and nan samples must saturate.
+ *  The program runs again with GUVCVIEW_NO_SIMD set, for the scalar code.
+ *
+ *  check_audio_convert
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <math.h>
+
+#include "gviewaudio.h"
+#include "audio_simd.h"
+#include "audio_ref.h"
+
+static const int test_channels[] = {1, 2, 6};
+static const int test_frames[] = {1, 3, 8, 17, 33, 255, 256, 257, 1152, 4099};
+
+#define NUM_CHANNELS (int)(sizeof(test_channels) / sizeof(test_channels[0]))
+#define NUM_FRAMES (int)(sizeof(test_frames) / sizeof(test_frames[0]))
+
+static const char *type_names[] = {"s16", "float", "s16p", "floatp"};
+
+/*
+ * simple (reproducible) random number generator - xorshift32
+ * args:
+ *   state - pointer to generator state
+ *
+ * asserts:
+ *   none
+ *
+ * returns: random 32 bit value
+ */
+static uint32_t rand_next(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/*
+ * allocate memory or bail out
+ * args:
+ *   size - size in bytes
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to zeroed memory
+ */
+static void *xcalloc(size_t size)
+{
+	void *p = calloc(size, 1);
+	if(p == NULL)
+	{
+		fprintf(stderr, "check_audio_convert: memory allocation failure\n");
+		exit(-1);
+	}
+	return p;
+}
+
+/*
+ * index of the input sample for an output sample
+ * args:
+ *   type - sample type
+ *   i - output sample index
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: input sample index
+ */
+static int input_index(int type, int i, int channels, int frames)
+{
+	if(type == GV_SAMPLE_TYPE_INT16P || type == GV_SAMPLE_TYPE_FLOATP)
+		return (i % frames) * channels + i / frames; /*planar*/
+
+	return i;
+}
+
+/*
+ * compare the library and the reference conversion of random samples
+ * args:
+ *   type - sample type
+ *   channels - number of channels
+ *   frames - number of frames
+ *   ties - pointer to the number of (allowed) differences on .5 ties
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of mismatches
+ */
+static int check_random(int type, int channels, int frames, int *ties)
+{
+	int n = channels * frames;
+	float *in = xcalloc(n * sizeof(float));
+	float *out = xcalloc(n * sizeof(float));
+	float *ref = xcalloc(n * sizeof(float));
+
+	uint32_t seed = 0x9e3779b9 ^ (type << 16) ^ (channels << 8) ^ frames;
+	int i = 0;
+	for(i = 0; i < n; ++i)
+	{
+		uint32_t r = rand_next(&seed);
+		if(r % 7 == 0)
+			/*around a .5 tie*/
+			in[i] = ((float) ((int) (r >> 16) - 32768) + 0.5f) / INT16_MAX;
+		else
+			/*-1.25 to 1.25 (some out of range)*/
+			in[i] = ((float) (r >> 8) / (float) (1 << 24)) * 2.5f - 1.25f;
+	}
+
+	audio_lib_convert(type, out, in, channels, frames);
+	audio_ref_convert(type, ref, in, channels, frames);
+
+	int failed = 0;
+	if(type == GV_SAMPLE_TYPE_FLOAT || type == GV_SAMPLE_TYPE_FLOATP)
+	{
+		if(memcmp(out, ref, n * sizeof(float)) != 0)
+		{
+			fprintf(stderr, "MISMATCH %s %i channels %i frames\n",
+				type_names[type], channels, frames);
+			failed++;
+		}
+	}
+	else
+	{
+		int16_t *out16 = (int16_t *) out;
+		int16_t *ref16 = (int16_t *) ref;
+		for(i = 0; i < n; ++i)
+		{
+			int diff = out16[i] - ref16[i];
+			if(diff == 0)
+				continue;
+
+			float v = in[input_index(type, i, channels, frames)] * INT16_MAX;
+			if((diff == 1 || diff == -1) && v - floorf(v) == 0.5f)
+			{
+				(*ties)++;
+				continue;
+			}
+
+			fprintf(stderr, "MISMATCH %s %i channels %i frames: sample %i (%.9g) is %i (reference %i)\n",
+				type_names[type], channels, frames, i, v, out16[i], ref16[i]);
+			failed++;
+			break;
+		}
+	}
+
+	free(ref);
+	free(out);
+	free(in);
+	return failed;
+}
+
+/*
+ * check the int16 saturation of out of range, infinite and nan samples
+ * args:
+ *   type - sample type (GV_SAMPLE_TYPE_INT16 or GV_SAMPLE_TYPE_INT16P)
+ *   channels - number of channels
+ *   frames - number of frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of mismatches
+ */
+static int check_saturation(int type, int channels, int frames)
+{
+	static const float values[] = {NAN, INFINITY, -INFINITY, 2.0f, -2.0f, 1.0f, -1.0f, 0.0f};
+	static const int16_t expected[] = {INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX, -INT16_MAX, 0};
+	int nvalues = (int) (sizeof(values) / sizeof(values[0]));
+
+	int n = channels * frames;
+	float *in = xcalloc(n * sizeof(float));
+	int16_t *out = xcalloc(n * sizeof(int16_t));
+
+	int i = 0;
+	for(i = 0; i < n; ++i)
+		in[i] = values[i % nvalues];
+
+	audio_lib_convert(type, out, in, channels, frames);
+
+	int failed = 0;
+	for(i = 0; i < n; ++i)
+	{
+		int j = input_index(type, i, channels, frames) % nvalues;
+		if(out[i] != expected[j])
+		{
+			fprintf(stderr, "MISMATCH %s %i channels %i frames: %g is %i (expected %i)\n",
+				type_names[type], channels, frames, values[j], out[i], expected[j]);
+			failed++;
+			break;
+		}
+	}
+
+	free(out);
+	free(in);
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	const audio_simd_t *simd = audio_get_simd();
+	printf("check_audio_convert: comparing the %s code with the previous scalar loops\n", simd->name);
+
+	int failed = 0;
+	int checked = 0;
+	int ties = 0;
+	int type = 0;
+	int c = 0;
+	int f = 0;
+
+	for(type = GV_SAMPLE_TYPE_INT16; type <= GV_SAMPLE_TYPE_FLOATP; ++type)
+		for(c = 0; c < NUM_CHANNELS; ++c)
+			for(f = 0; f < NUM_FRAMES; ++f)
+			{
+				failed += check_random(type, test_channels[c], test_frames[f], &ties);
+				checked++;
+
+				if(type == GV_SAMPLE_TYPE_INT16 || type == GV_SAMPLE_TYPE_INT16P)
+				{
+					failed += check_saturation(type, test_channels[c], test_frames[f]);
+					checked++;
+				}
+			}
+
+	printf("check_audio_convert: %i conversions checked (%i samples rounded to even), %i mismatches\n",
+		checked, ties, failed);
+
+	if(failed)
+		return 1;
+
+	/*check the scalar code too*/
+	if(strcmp(simd->name, "scalar") != 0)
+	{
+		char exe[PATH_MAX];
+		ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+		if(len <= 0)
+		{
+			fprintf(stderr, "check_audio_convert: couldn't find the executable path\n");
+			return 1;
+		}
+		exe[len] = '\0';
+
+		fflush(stdout);
+		setenv("GUVCVIEW_NO_SIMD", "1", 1);
+		execl(exe, exe, (char *) NULL);
+		fprintf(stderr, "check_audio_convert: couldn't run without the vector kernels\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,280 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * bit-exactness check for the vectorized colorspace converters
+ *  the converters are run over random frames (of widths that are not
+ *  a multiple of the vector size) with the selected kernels and the
+ *  output is compared with the scalar (reference) code, obtained by
+ *  running this same program with GUVCVIEW_NO_SIMD set.
+ *
+ *  check_colorspaces [--dump]
+ *    --dump  print the output hashes for the active kernels and exit
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "colorspaces.h"
+#include "colorspaces_simd.h"
+#include "../config.h"
+
+/*automake test driver: skipped test*/
+#define EXIT_SKIP (77)
+
+typedef struct _cs_test_t
+{
+	const char *name;
+	int in_size;  /*input size in bytes for each pixel x 2*/
+	int out_size; /*output size in bytes for each pixel x 2*/
+	void (*convert)(uint8_t *out, uint8_t *in, int width, int height);
+} cs_test_t;
+
+static cs_test_t cs_tests[] =
+{
+	{"yuyv_to_yu12", 4, 3, yuyv_to_yu12},
+	{"yvyu_to_yu12", 4, 3, yvyu_to_yu12},
+	{"uyvy_to_yu12", 4, 3, uyvy_to_yu12},
+	{"nv12_to_yu12", 3, 3, nv12_to_yu12},
+	{"nv21_to_yu12", 3, 3, nv21_to_yu12},
+	{"yu12_to_yuyv", 3, 4, yu12_to_yuyv},
+	{NULL, 0, 0, NULL}
+};
+
+/*frame sizes: vector friendly, tails of every length and tiny frames*/
+static int cs_sizes[][2] =
+{
+	{2, 2},
+	{6, 4},
+	{18, 2},
+	{34, 18},
+	{66, 6},
+	{130, 10},
+	{1922, 4},
+	{640, 480},
+	{1280, 720}
+};
+
+#define CS_NUM_SIZES (int)(sizeof(cs_sizes) / sizeof(cs_sizes[0]))
+
+/*
+ * simple (reproducible) random number generator - xorshift32
+ * args:
+ *   state - pointer to generator state
+ *
+ * asserts:
+ *   none
+ *
+ * returns: random 32 bit value
+ */
+static uint32_t rand_next(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/*
+ * 64 bit FNV-1a hash
+ * args:
+ *   data - pointer to data
+ *   size - data size in bytes
+ *
+ * asserts:
+ *   none
+ *
+ * returns: hash value
+ */
+static uint64_t hash_data(const uint8_t *data, size_t size)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i = 0;
+	for(i = 0; i < size; ++i)
+	{
+		h ^= data[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/*
+ * print the output hash of every converter and frame size
+ *  (and of the jpeg mcu output writers)
+ * args:
+ *   out - output stream
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void dump_hashes(FILE *out)
+{
+	int t = 0;
+	int s = 0;
+	size_t i = 0;
+
+	for(t = 0; cs_tests[t].name != NULL; ++t)
+	{
+		for(s = 0; s < CS_NUM_SIZES; ++s)
+		{
+			int width = cs_sizes[s][0];
+			int height = cs_sizes[s][1];
+			size_t in_size = (size_t) width * height * cs_tests[t].in_size / 2;
+			size_t out_size = (size_t) width * height * cs_tests[t].out_size / 2;
+
+			uint8_t *in = malloc(in_size);
+			uint8_t *frame = calloc(out_size, 1);
+			if(in == NULL || frame == NULL)
+			{
+				fprintf(stderr, "check_colorspaces: memory allocation failure\n");
+				exit(-1);
+			}
+
+			uint32_t seed = 0x9e3779b9 ^ (t << 16) ^ s;
+			for(i = 0; i < in_size; ++i)
+				in[i] = rand_next(&seed);
+
+			cs_tests[t].convert(frame, in, width, height);
+
+			fprintf(out, "%s %ix%i %016" PRIx64 "\n", cs_tests[t].name,
+				width, height, hash_data(frame, out_size));
+
+			free(frame);
+			free(in);
+		}
+	}
+
+#if MJPG_BUILTIN
+	/*jpeg decoder mcu writers (idct output, with values out of range)*/
+	int mcu[64 * 6];
+	uint8_t pic[16 * 64 * 2];
+	uint8_t *py = pic;
+	uint8_t *pu = pic + 16 * 64;
+	uint8_t *pv = pu + 8 * 32;
+	uint32_t seed = 0x2545f491;
+
+	for(s = 0; s < 16; ++s)
+	{
+		for(i = 0; i < 64 * 6; ++i)
+			mcu[i] = (int) (rand_next(&seed) % 512) - 128;
+
+		memset(pic, 0, sizeof(pic));
+		yuv420pto422(mcu, pic, 64);
+		fprintf(out, "yuv420pto422 %i %016" PRIx64 "\n", s, hash_data(pic, sizeof(pic)));
+
+		memset(pic, 0, sizeof(pic));
+		yuv422pto422(mcu, pic, 64);
+		fprintf(out, "yuv422pto422 %i %016" PRIx64 "\n", s, hash_data(pic, sizeof(pic)));
+
+		memset(pic, 0, sizeof(pic));
+		yuv420p_to_yu12_mcu(mcu, py, pu, pv, 64);
+		fprintf(out, "yuv420p_to_yu12_mcu %i %016" PRIx64 "\n", s, hash_data(pic, sizeof(pic)));
+
+		memset(pic, 0, sizeof(pic));
+		yuv422p_to_yu12_mcu(mcu, py, pu, pv, 64);
+		fprintf(out, "yuv422p_to_yu12_mcu %i %016" PRIx64 "\n", s, hash_data(pic, sizeof(pic)));
+	}
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc > 1 && strcmp(argv[1], "--dump") == 0)
+	{
+		dump_hashes(stdout);
+		return 0;
+	}
+
+	const cs_simd_t *simd = colorspaces_get_simd();
+	if(strcmp(simd->name, "scalar") == 0)
+	{
+		printf("check_colorspaces: no vector kernels for this cpu (or build) - skipping\n");
+		return EXIT_SKIP;
+	}
+
+	printf("check_colorspaces: comparing %s kernels with the scalar code\n", simd->name);
+
+	/*scalar reference: run ourselves with the vector kernels disabled*/
+	char exe[PATH_MAX];
+	ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if(len <= 0)
+	{
+		fprintf(stderr, "check_colorspaces: couldn't find the executable path\n");
+		return 1;
+	}
+	exe[len] = '\0';
+
+	char cmd[PATH_MAX + 64];
+	snprintf(cmd, sizeof(cmd), "GUVCVIEW_NO_SIMD=1 '%s' --dump", exe);
+
+	FILE *ref = popen(cmd, "r");
+	FILE *cur = tmpfile();
+	if(ref == NULL || cur == NULL)
+	{
+		fprintf(stderr, "check_colorspaces: couldn't run the scalar reference\n");
+		return 1;
+	}
+
+	dump_hashes(cur);
+	rewind(cur);
+
+	int failed = 0;
+	int checked = 0;
+	char line_ref[256];
+	char line_cur[256];
+	while(fgets(line_cur, sizeof(line_cur), cur) != NULL)
+	{
+		if(fgets(line_ref, sizeof(line_ref), ref) == NULL)
+		{
+			fprintf(stderr, "check_colorspaces: scalar reference ended early\n");
+			failed++;
+			break;
+		}
+
+		checked++;
+		if(strcmp(line_cur, line_ref) != 0)
+		{
+			line_cur[strcspn(line_cur, "\n")] = '\0';
+			line_ref[strcspn(line_ref, "\n")] = '\0';
+			fprintf(stderr, "MISMATCH %s (scalar: %s)\n", line_cur, line_ref);
+			failed++;
+		}
+	}
+
+	fclose(cur);
+	if(pclose(ref) != 0)
+	{
+		fprintf(stderr, "check_colorspaces: scalar reference failed\n");
+		failed++;
+	}
+
+	printf("check_colorspaces: %i outputs checked, %i mismatches\n", checked, failed);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,970 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * regression and fuzz check for the uvc h264 demuxer and NAL unit index
+ *  the frames in the corpus (h264 muxed in MJPG APP4 segments, as sent
+ *  by the uvc 1.5 cameras) are demuxed with decode_v4l2_frame and the
+ *  output is compared with the expected results (expected.txt).
+ *  Every frame is then mutated (damaged markers and lengths, truncation,
+ *  start codes and zero runs, small h264 buffers) and the output is
+ *  compared with a plain byte by byte demuxer (the reference).
+ *
+ *  check_h264_demux [corpus_dir]
+ *    corpus_dir defaults to $srcdir/h264_corpus
+ *  check_h264_demux --generate corpus_dir
+ *    writes the synthetic corpus and the expected results
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "uvc_h264.h"
+#include "frame_decoder.h"
+#include "colorspaces_simd.h"
+#include "../config.h"
+
+/*h264 buffer size (1 byte per pixel - as in alloc_v4l2_frames)*/
+#define DEMUX_WIDTH  (640)
+#define DEMUX_HEIGHT (480)
+#define DEMUX_MAX_SIZE (DEMUX_WIDTH * DEMUX_HEIGHT)
+
+/*mutations of every corpus frame*/
+#define FUZZ_RUNS (400)
+
+/*APP4 segment: max length field and uvc h264 payload header length*/
+#define APP4_MAX_LENGTH (0xFFFF)
+#define UVC_HEADER_LENGTH (22)
+
+/*muxed frame layout: SOI + APP0 size and first APP4 segment data*/
+#define JFIF_SIZE (20)
+#define SEG1_DATA (JFIF_SIZE + 4 + UVC_HEADER_LENGTH + 4)
+
+/*error messages (stderr is silenced while demuxing damaged frames)*/
+static FILE *err_out = NULL;
+
+/*
+ * simple (reproducible) random number generator - xorshift32
+ * args:
+ *   state - pointer to generator state
+ *
+ * asserts:
+ *   none
+ *
+ * returns: random 32 bit value
+ */
+static uint32_t rand_next(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/*
+ * 64 bit FNV-1a hash
+ * args:
+ *   data - pointer to data
+ *   size - data size in bytes
+ *
+ * asserts:
+ *   none
+ *
+ * returns: hash value
+ */
+static uint64_t hash_data(const uint8_t *data, size_t size)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i = 0;
+	for(i = 0; i < size; ++i)
+	{
+		h ^= data[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/*
+ * allocate memory or bail out
+ * args:
+ *   size - size in bytes
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to zeroed memory
+ */
+static void *xcalloc(size_t size)
+{
+	void *p = calloc(size > 0 ? size : 1, 1);
+	if(p == NULL)
+	{
+		fprintf(stderr, "check_h264_demux: memory allocation failure\n");
+		exit(-1);
+	}
+	return p;
+}
+
+/*
+ * reference demuxer: copies the APP4 segments payload byte by byte
+ *  (same rules as demux_uvcH264: clipped to the buffer and to max)
+ * args:
+ *   buff - muxed frame
+ *   size - muxed frame size
+ *   out - h264 data buffer
+ *   max - out size
+ *
+ * asserts:
+ *   none
+ *
+ * returns: h264 data size
+ */
+static size_t ref_demux(const uint8_t *buff, size_t size, uint8_t *out, size_t max)
+{
+	size_t i = 0;
+
+	while(i + 1 < size && !(buff[i] == 0xFF && buff[i + 1] == 0xE4))
+		i++;
+
+	if(i + 1 >= size || size - (i + 2) < 8)
+		return 0;
+
+	i += 2;
+	long length = ((long) buff[i] << 8) | buff[i + 1];
+	size_t header = i + 2;
+	long header_length = buff[header + 2] | (buff[header + 3] << 8);
+
+	if((long) (size - header) < header_length + 4)
+		return 0;
+
+	i = header + header_length;
+	uint32_t remaining = (uint32_t) buff[i] |
+		((uint32_t) buff[i + 1] << 8) |
+		((uint32_t) buff[i + 2] << 16) |
+		((uint32_t) buff[i + 3] << 24);
+	i += 4;
+
+	length -= header_length + 6;
+
+	size_t out_size = 0;
+	for(;;)
+	{
+		if(length < 0 || (uint32_t) length > remaining)
+			length = (long) remaining;
+
+		for(; length > 0; --length, --remaining)
+		{
+			if(i >= size || out_size >= max)
+				return out_size;
+			out[out_size++] = buff[i++];
+		}
+
+		if(remaining == 0 ||
+		   size - i < 4 ||
+		   buff[i] != 0xFF ||
+		   buff[i + 1] != 0xE4)
+			break;
+
+		length = (((long) buff[i + 2] << 8) | buff[i + 3]) - 2;
+		i += 4;
+	}
+
+	return out_size;
+}
+
+/*
+ * reference NAL unit index: byte by byte start code search
+ * args:
+ *   data - h264 data
+ *   size - data size
+ *   nal - NAL index (H264_MAX_NALS entries)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of index entries
+ */
+static int ref_index(const uint8_t *data, size_t size, h264_nal_t *nal)
+{
+	int n = 0;
+	size_t i = 0;
+
+	for(i = 0; i + 2 < size; ++i)
+	{
+		if(data[i] != 0x00 || data[i + 1] != 0x00 || data[i + 2] != 0x01)
+			continue;
+
+		size_t sc_start = (i > 0 && data[i - 1] == 0x00) ? i - 1 : i;
+
+		if(n < H264_MAX_NALS)
+		{
+			if(n > 0)
+				nal[n - 1].size = sc_start - nal[n - 1].offset;
+			nal[n].offset = i + 3;
+			n++;
+		}
+		i += 2;
+	}
+
+	if(n > 0 && nal[n - 1].offset >= size)
+		n--;
+	else if(n > 0)
+		nal[n - 1].size = size - nal[n - 1].offset;
+
+	for(i = 0; i < (size_t) n; ++i)
+		nal[i].type = data[nal[i].offset] & 0x1F;
+
+	return n;
+}
+
+/*
+ * print the demux result: size hash nal_count type:offset:size ...
+ * args:
+ *   out - output stream
+ *   data - h264 data
+ *   size - data size
+ *   nal - NAL index
+ *   count - NAL index entries
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void print_result(FILE *out, const uint8_t *data, size_t size,
+	const h264_nal_t *nal, int count)
+{
+	fprintf(out, "%zu %016" PRIx64 " %i", size, hash_data(data, size), count);
+
+	int i = 0;
+	for(i = 0; i < count; ++i)
+		fprintf(out, " %i:%" PRIu32 ":%" PRIu32, nal[i].type, nal[i].offset, nal[i].size);
+}
+
+/*
+ * demux a frame with the library (decode_v4l2_frame)
+ * args:
+ *   vd - pointer to device data (h264_support sets the demux mode)
+ *   frame - pointer to frame buffer (gets the h264 data and index)
+ *   buff - raw frame
+ *   size - raw frame size
+ *   max - h264 buffer size
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void lib_demux(v4l2_dev_t *vd, v4l2_frame_buff_t *frame,
+	uint8_t *buff, size_t size, size_t max)
+{
+	frame->raw_frame = buff;
+	frame->raw_frame_size = size;
+	frame->h264_frame = frame->h264_frame_buffer;
+	frame->h264_frame_max_size = max;
+	frame->h264_frame_size = 0;
+	frame->h264_nal_count = 0;
+
+	/*store the SPS and PPS of every frame*/
+	free(vd->h264_SPS);
+	vd->h264_SPS = NULL;
+	free(vd->h264_PPS);
+	vd->h264_PPS = NULL;
+
+	decode_v4l2_frame(vd, frame, NULL);
+}
+
+/*
+ * compare the library and the reference output
+ * args:
+ *   name - frame name (for the error message)
+ *   frame - pointer to frame buffer (library output)
+ *   data - reference h264 data
+ *   size - reference data size
+ *   nal - reference NAL index
+ *   count - reference NAL index entries
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 0 if equal, 1 otherwise
+ */
+static int compare_result(const char *name, v4l2_frame_buff_t *frame,
+	const uint8_t *data, size_t size, const h264_nal_t *nal, int count)
+{
+	int equal = (frame->h264_frame_size == size) &&
+		(memcmp(frame->h264_frame, data, size) == 0) &&
+		(frame->h264_nal_count == count);
+
+	int i = 0;
+	for(i = 0; equal && i < count; ++i)
+		equal = frame->h264_nal[i].offset == nal[i].offset &&
+			frame->h264_nal[i].size == nal[i].size &&
+			frame->h264_nal[i].type == nal[i].type;
+
+	if(equal)
+		return 0;
+
+	fprintf(err_out, "MISMATCH %s\n  demuxer:   ", name);
+	print_result(err_out, frame->h264_frame, frame->h264_frame_size,
+		frame->h264_nal, frame->h264_nal_count);
+	fprintf(err_out, "\n  reference: ");
+	print_result(err_out, data, size, nal, count);
+	fprintf(err_out, "\n");
+	return 1;
+}
+
+/*
+ * read a file
+ * args:
+ *   path - file path
+ *   size - pointer to file size (set)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to file data (must be freed) or NULL on error
+ */
+static uint8_t *read_file(const char *path, size_t *size)
+{
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL)
+		return NULL;
+
+	fseek(fp, 0, SEEK_END);
+	long len = ftell(fp);
+	rewind(fp);
+
+	uint8_t *data = xcalloc(len);
+	if(len <= 0 || fread(data, 1, len, fp) != (size_t) len)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(fp);
+
+	*size = (size_t) len;
+	return data;
+}
+
+/*
+ * write a file
+ * args:
+ *   dir - directory
+ *   name - file name
+ *   data - file data
+ *   size - data size
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 0 on success
+ */
+static int write_file(const char *dir, const char *name, const uint8_t *data, size_t size)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+	FILE *fp = fopen(path, "wb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "check_h264_demux: couldn't create %s\n", path);
+		return -1;
+	}
+	size_t ret = fwrite(data, 1, size, fp);
+	fclose(fp);
+	return ret == size ? 0 : -1;
+}
+
+/*
+ * append a NAL unit with random (start code free) data to an h264 stream
+ *  the data has a few emulation prevention sequences (00 00 03)
+ * args:
+ *   es - h264 stream
+ *   pos - stream size (updated)
+ *   header - NAL header byte
+ *   size - NAL unit size (with header)
+ *   long_sc - use a 4 byte start code
+ *   seed - pointer to random generator state
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void add_nal(uint8_t *es, size_t *pos, uint8_t header, size_t size,
+	int long_sc, uint32_t *seed)
+{
+	uint8_t *p = es + *pos;
+
+	if(long_sc)
+		*p++ = 0x00;
+	*p++ = 0x00;
+	*p++ = 0x00;
+	*p++ = 0x01;
+	*p++ = header;
+
+	size_t i = 0;
+	for(i = 1; i < size; ++i)
+	{
+		uint8_t b = rand_next(seed);
+		if(i + 3 < size && (b & 0x7F) == 0)
+		{
+			/*emulation prevention*/
+			*p++ = 0x00;
+			*p++ = 0x00;
+			*p++ = 0x03;
+			i += 2;
+			continue;
+		}
+		/*no zero pairs (or a zero last byte)*/
+		if(b == 0x00 && (p[-1] == 0x00 || i + 1 == size))
+			b = 0x80;
+		*p++ = b;
+	}
+
+	*pos = p - es;
+}
+
+/*
+ * mux an h264 stream in MJPG APP4 segments (uvc 1.5 payload)
+ * args:
+ *   out - muxed frame
+ *   es - h264 stream
+ *   es_size - stream size
+ *   first - payload size in the first segment (0 - segment max)
+ *   tail - add a jpeg picture (just the markers) after the APP4 segments
+ *
+ * asserts:
+ *   none
+ *
+ * returns: muxed frame size
+ */
+static size_t mux_frame(uint8_t *out, const uint8_t *es, size_t es_size,
+	size_t first, int tail)
+{
+	uint8_t *p = out;
+
+	/*SOI and a JFIF APP0 segment*/
+	static const uint8_t jfif[] =
+	{
+		0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+		0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+	};
+	memcpy(p, jfif, sizeof(jfif));
+	p += sizeof(jfif);
+
+	size_t max_first = APP4_MAX_LENGTH - 2 - UVC_HEADER_LENGTH - 4;
+	size_t seg = (first > 0 && first < max_first) ? first : max_first;
+	if(seg > es_size)
+		seg = es_size;
+
+	/*first segment: length, uvc header and payload size*/
+	size_t length = seg + 2 + UVC_HEADER_LENGTH + 4;
+	*p++ = 0xFF;
+	*p++ = 0xE4;
+	*p++ = length >> 8;
+	*p++ = length & 0xFF;
+
+	uint8_t header[UVC_HEADER_LENGTH] =
+	{
+		0x00, 0x01,                                /*version 1.0*/
+		UVC_HEADER_LENGTH, 0x00,                   /*header length*/
+		0x01, 0x00,                                /*stream type (h264)*/
+		DEMUX_WIDTH & 0xFF, DEMUX_WIDTH >> 8,      /*width*/
+		DEMUX_HEIGHT & 0xFF, DEMUX_HEIGHT >> 8,    /*height*/
+		0x15, 0x16, 0x05, 0x00,                    /*frame interval (333333)*/
+		0x00, 0x00,                                /*delay*/
+		0x10, 0x27, 0x00, 0x00,                    /*presentation time*/
+		0x00, 0x00
+	};
+	memcpy(p, header, UVC_HEADER_LENGTH);
+	p += UVC_HEADER_LENGTH;
+
+	*p++ = es_size & 0xFF;
+	*p++ = (es_size >> 8) & 0xFF;
+	*p++ = (es_size >> 16) & 0xFF;
+	*p++ = (es_size >> 24) & 0xFF;
+
+	memcpy(p, es, seg);
+	p += seg;
+
+	/*next segments*/
+	size_t pos = seg;
+	while(pos < es_size)
+	{
+		seg = es_size - pos;
+		if(seg > APP4_MAX_LENGTH - 2)
+			seg = APP4_MAX_LENGTH - 2;
+
+		*p++ = 0xFF;
+		*p++ = 0xE4;
+		*p++ = (seg + 2) >> 8;
+		*p++ = (seg + 2) & 0xFF;
+		memcpy(p, es + pos, seg);
+		p += seg;
+		pos += seg;
+	}
+
+	if(tail)
+	{
+		/*an (empty) baseline picture*/
+		static const uint8_t pic[] =
+		{
+			0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x10, 0x00, 0x10, 0x01,
+			0x01, 0x11, 0x00, 0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00,
+			0x00, 0x3F, 0x00
+		};
+		memcpy(p, pic, sizeof(pic));
+		p += sizeof(pic);
+	}
+
+	*p++ = 0xFF;
+	*p++ = 0xD9;
+
+	return p - out;
+}
+
+/*
+ * write the synthetic corpus and the expected results
+ *  (the expected results are the reference demuxer output, checked
+ *   against the h264 stream that was muxed for the undamaged frames)
+ * args:
+ *   dir - corpus directory
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 0 on success
+ */
+static int generate_corpus(const char *dir)
+{
+	size_t es_max = 4 * APP4_MAX_LENGTH;
+	uint8_t *es = xcalloc(es_max);
+	uint8_t *muxed = xcalloc(es_max + 4096);
+	uint8_t *out = xcalloc(DEMUX_MAX_SIZE);
+	h264_nal_t nal[H264_MAX_NALS];
+	uint32_t seed = 0x1b873593;
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/expected.txt", dir);
+	FILE *expected = fopen(path, "w");
+	if(expected == NULL)
+	{
+		fprintf(stderr, "check_h264_demux: couldn't create %s\n", path);
+		return -1;
+	}
+	fprintf(expected, "# generated by check_h264_demux --generate\n");
+	fprintf(expected, "# name size fnv1a64 nal_count type:offset:size ...\n");
+
+	int ret = 0;
+	int f = 0;
+	for(f = 0; ret == 0; ++f)
+	{
+		const char *name = NULL;
+		size_t es_size = 0;
+		size_t size = 0;
+		int damaged = 0;
+		int i = 0;
+
+		switch(f)
+		{
+			case 0:
+				/*IDR frame in three APP4 segments*/
+				name = "idr_3seg.mjpg";
+				add_nal(es, &es_size, 0x09, 2, 1, &seed); /*AUD*/
+				add_nal(es, &es_size, 0x67, 24, 1, &seed); /*SPS*/
+				add_nal(es, &es_size, 0x68, 4, 1, &seed); /*PPS*/
+				add_nal(es, &es_size, 0x65, 135000, 1, &seed); /*IDR*/
+				size = mux_frame(muxed, es, es_size, 0, 1);
+				break;
+			case 1:
+				/*P frame in a single segment*/
+				name = "p_1seg.mjpg";
+				add_nal(es, &es_size, 0x09, 2, 1, &seed);
+				add_nal(es, &es_size, 0x41, 3000, 1, &seed);
+				size = mux_frame(muxed, es, es_size, 0, 1);
+				break;
+			case 2:
+				/*3 byte start codes, SEI and 4 slices*/
+				name = "slices_3byte.mjpg";
+				add_nal(es, &es_size, 0x06, 40, 0, &seed);
+				for(i = 0; i < 4; ++i)
+					add_nal(es, &es_size, 0x21, 700 + i * 13, 0, &seed);
+				size = mux_frame(muxed, es, es_size, 0, 0);
+				break;
+			case 3:
+				/*
+				 * start codes split by the segment boundaries
+				 *  00 00 | 00 01 (first) and 00 | 00 01 (second)
+				 */
+				name = "split_start_code.mjpg";
+				add_nal(es, &es_size, 0x41, 1000, 1, &seed);
+				add_nal(es, &es_size, 0x41, APP4_MAX_LENGTH - 5, 1, &seed);
+				add_nal(es, &es_size, 0x41, 500, 0, &seed);
+				size = mux_frame(muxed, es, es_size, 1006, 0);
+				break;
+			case 4:
+				/*more NAL units than index entries*/
+				name = "many_nals.mjpg";
+				for(i = 0; i < H264_MAX_NALS + 8; ++i)
+					add_nal(es, &es_size, 0x01, 20 + i, i & 1, &seed);
+				size = mux_frame(muxed, es, es_size, 0, 1);
+				break;
+			case 5:
+				/*start codes at the end, empty NAL units and zero runs*/
+				name = "empty_nals.mjpg";
+				add_nal(es, &es_size, 0x41, 300, 1, &seed);
+				memset(es + es_size, 0, 40);
+				es_size += 40;
+				es[es_size++] = 0x01;
+				es[es_size++] = 0x00;
+				es[es_size++] = 0x00;
+				es[es_size++] = 0x01;
+				add_nal(es, &es_size, 0x41, 200, 0, &seed);
+				es[es_size++] = 0x00;
+				es[es_size++] = 0x00;
+				es[es_size++] = 0x00;
+				es[es_size++] = 0x01;
+				size = mux_frame(muxed, es, es_size, 0, 0);
+				break;
+			case 6:
+				/*truncated (payload size bigger than the frame)*/
+				name = "truncated.mjpg";
+				damaged = 1;
+				add_nal(es, &es_size, 0x67, 24, 1, &seed);
+				add_nal(es, &es_size, 0x68, 4, 1, &seed);
+				add_nal(es, &es_size, 0x65, 12000, 1, &seed);
+				size = mux_frame(muxed, es, es_size, 0, 0);
+				size /= 2;
+				break;
+			case 7:
+				/*damaged marker of the second segment*/
+				name = "bad_marker.mjpg";
+				damaged = 1;
+				add_nal(es, &es_size, 0x65, 5000, 1, &seed);
+				size = mux_frame(muxed, es, es_size, 2000, 1);
+				muxed[SEG1_DATA + 2000 + 1] = 0xE1;
+				break;
+			case 8:
+				/*zero length second segment (takes the rest of the payload)*/
+				name = "bad_length.mjpg";
+				damaged = 1;
+				add_nal(es, &es_size, 0x65, 5000, 1, &seed);
+				size = mux_frame(muxed, es, es_size, 2000, 0);
+				muxed[SEG1_DATA + 2000 + 2] = 0x00;
+				muxed[SEG1_DATA + 2000 + 3] = 0x00;
+				break;
+			case 9:
+				/*header length bigger than the frame*/
+				name = "bad_header.mjpg";
+				damaged = 1;
+				add_nal(es, &es_size, 0x41, 500, 1, &seed);
+				size = mux_frame(muxed, es, es_size, 0, 0);
+				muxed[JFIF_SIZE + 4 + 2] = 0xFF;
+				muxed[JFIF_SIZE + 4 + 3] = 0x7F;
+				break;
+			case 10:
+				/*mjpg frame (no APP4 segments)*/
+				name = "no_app4.mjpg";
+				damaged = 1;
+				size = mux_frame(muxed, es, 0, 0, 1);
+				memmove(muxed + JFIF_SIZE, muxed + SEG1_DATA,
+					size - SEG1_DATA);
+				size -= 4 + UVC_HEADER_LENGTH + 4;
+				break;
+			default:
+				name = NULL;
+				break;
+		}
+
+		if(name == NULL)
+			break;
+
+		size_t out_size = ref_demux(muxed, size, out, DEMUX_MAX_SIZE);
+		int count = ref_index(out, out_size, nal);
+
+		if(!damaged && (out_size != es_size || memcmp(out, es, es_size) != 0))
+		{
+			fprintf(stderr, "check_h264_demux: reference demuxer failed for %s\n", name);
+			ret = -1;
+			break;
+		}
+
+		ret = write_file(dir, name, muxed, size);
+
+		fprintf(expected, "%s ", name);
+		print_result(expected, out, out_size, nal, count);
+		fprintf(expected, "\n");
+
+		printf("%s: %zu bytes (%zu bytes of h264 data, %i NAL units)\n",
+			name, size, out_size, count);
+	}
+
+	fclose(expected);
+	free(out);
+	free(muxed);
+	free(es);
+	return ret;
+}
+
+/*
+ * mutate a corpus frame
+ * args:
+ *   data - frame data (mutated)
+ *   size - pointer to frame size (updated)
+ *   max - pointer to h264 buffer size (updated)
+ *   seed - pointer to random generator state
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void mutate_frame(uint8_t *data, size_t *size, size_t *max, uint32_t *seed)
+{
+	size_t i = 0;
+	int n = 1 + rand_next(seed) % 3;
+
+	for(; n > 0; --n)
+	{
+		size_t pos = rand_next(seed) % *size;
+
+		switch(rand_next(seed) % 6)
+		{
+			case 0:
+				/*random bytes*/
+				for(i = 0; i < 1 + rand_next(seed) % 8 && pos + i < *size; ++i)
+					data[pos + i] = rand_next(seed);
+				break;
+			case 1:
+				/*truncate*/
+				*size = 1 + pos;
+				break;
+			case 2:
+			{
+				/*damage an APP4 length (or the header and payload sizes)*/
+				uint8_t *p = memchr(data + pos, 0xFF, *size - pos);
+				if(p == NULL || p + 1 >= data + *size || p[1] != 0xE4)
+					p = memchr(data, 0xFF, *size);
+				if(p != NULL && p + 36 <= data + *size)
+					p[2 + rand_next(seed) % 34] = rand_next(seed);
+				break;
+			}
+			case 3:
+				/*start code*/
+				for(i = 0; i < 4 && pos + i < *size; ++i)
+					data[pos + i] = i < 2 ? 0x00 : (rand_next(seed) & 1);
+				break;
+			case 4:
+				/*zero run*/
+				for(i = 0; i < rand_next(seed) % 100 && pos + i < *size; ++i)
+					data[pos + i] = 0x00;
+				break;
+			default:
+				/*small h264 buffer*/
+				*max = rand_next(seed) % (*max + 1);
+				break;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc > 2 && strcmp(argv[1], "--generate") == 0)
+		return generate_corpus(argv[2]) == 0 ? 0 : 1;
+
+	char dir[PATH_MAX];
+	if(argc > 1)
+		strncpy(dir, argv[1], sizeof(dir) - 1);
+	else
+		snprintf(dir, sizeof(dir), "%.*s/h264_corpus", PATH_MAX - 16,
+			getenv("srcdir") ? getenv("srcdir") : ".");
+	dir[PATH_MAX - 1] = '\0';
+
+	char path[2 * PATH_MAX];
+	snprintf(path, sizeof(path), "%s/expected.txt", dir);
+	FILE *expected = fopen(path, "r");
+	if(expected == NULL)
+	{
+		fprintf(stderr, "check_h264_demux: couldn't open %s\n", path);
+		return 1;
+	}
+
+	const cs_simd_t *simd = colorspaces_get_simd();
+	printf("check_h264_demux: start code search: %s\n",
+		simd->find_zero_pair ? simd->name : "memchr");
+
+	/*the demuxer reports damaged frames in stderr*/
+	fflush(stderr);
+	err_out = fdopen(dup(fileno(stderr)), "w");
+	int null_fd = open("/dev/null", O_WRONLY);
+	if(err_out == NULL || null_fd < 0)
+	{
+		fprintf(stderr, "check_h264_demux: couldn't redirect stderr\n");
+		return 1;
+	}
+	dup2(null_fd, fileno(stderr));
+	close(null_fd);
+	setvbuf(err_out, NULL, _IONBF, 0);
+
+	v4l2_dev_t *vd = xcalloc(sizeof(v4l2_dev_t));
+	v4l2_frame_buff_t *frame = xcalloc(sizeof(v4l2_frame_buff_t));
+
+	vd->requested_fmt = V4L2_PIX_FMT_H264;
+	vd->format.fmt.pix.width = DEMUX_WIDTH;
+	vd->format.fmt.pix.height = DEMUX_HEIGHT;
+	vd->h264_decode = 0; /*demux only*/
+	vd->h264_last_IDR = xcalloc(DEMUX_MAX_SIZE);
+	frame->h264_frame_buffer = xcalloc(DEMUX_MAX_SIZE);
+
+	uint8_t *ref = xcalloc(DEMUX_MAX_SIZE);
+	h264_nal_t ref_nal[H264_MAX_NALS];
+
+	int failed = 0;
+	int frames = 0;
+	int mutations = 0;
+	char line[4096];
+
+	while(fgets(line, sizeof(line), expected) != NULL)
+	{
+		if(line[0] == '#' || line[0] == '\n')
+			continue;
+
+		line[strcspn(line, "\n")] = '\0';
+		char *result = strchr(line, ' ');
+		if(result == NULL)
+			continue;
+		*result++ = '\0';
+
+		snprintf(path, sizeof(path), "%s/%s", dir, line);
+		size_t size = 0;
+		uint8_t *data = read_file(path, &size);
+		if(data == NULL)
+		{
+			fprintf(err_out, "check_h264_demux: couldn't read %s\n", path);
+			failed++;
+			continue;
+		}
+		frames++;
+
+		/*regression: the demuxer output must match the expected result*/
+		vd->h264_support = H264_MUXED;
+		lib_demux(vd, frame, data, size, DEMUX_MAX_SIZE);
+
+		char *res_buf = NULL;
+		size_t res_size = 0;
+		FILE *res = open_memstream(&res_buf, &res_size);
+		print_result(res, frame->h264_frame, frame->h264_frame_size,
+			frame->h264_nal, frame->h264_nal_count);
+		fclose(res);
+
+		if(strcmp(res_buf, result) != 0)
+		{
+			fprintf(err_out, "MISMATCH %s\n  demuxer:  %s\n  expected: %s\n", line, res_buf, result);
+			failed++;
+		}
+		free(res_buf);
+
+		/*the h264 stream (H264_FRAME - zero copy) gets the same index*/
+		size_t ref_size = ref_demux(data, size, ref, DEMUX_MAX_SIZE);
+		if(ref_size > 0)
+		{
+			int count = ref_index(ref, ref_size, ref_nal);
+			vd->h264_support = H264_FRAME;
+			lib_demux(vd, frame, ref, ref_size, DEMUX_MAX_SIZE);
+			failed += compare_result(line, frame, ref, ref_size, ref_nal, count);
+		}
+
+		/*fuzz: mutated frames must match the reference*/
+		vd->h264_support = H264_MUXED;
+		uint8_t *mutated = xcalloc(size);
+		uint32_t seed = (uint32_t) hash_data((uint8_t *) line, strlen(line)) | 1;
+		int run = 0;
+		for(run = 0; run < FUZZ_RUNS; ++run)
+		{
+			size_t mutated_size = size;
+			size_t max = DEMUX_MAX_SIZE;
+			memcpy(mutated, data, size);
+			mutate_frame(mutated, &mutated_size, &max, &seed);
+
+			ref_size = ref_demux(mutated, mutated_size, ref, max);
+			int count = ref_index(ref, ref_size, ref_nal);
+			lib_demux(vd, frame, mutated, mutated_size, max);
+
+			if(compare_result(line, frame, ref, ref_size, ref_nal, count))
+			{
+				fprintf(err_out, "  (mutation %i)\n", run);
+				failed++;
+				break;
+			}
+			mutations++;
+		}
+
+		free(mutated);
+		free(data);
+	}
+	fclose(expected);
+
+	free(vd->h264_SPS);
+	free(vd->h264_PPS);
+	free(vd->h264_last_IDR);
+	free(frame->h264_frame_buffer);
+	free(frame);
+	free(vd);
+	free(ref);
+
+	printf("check_h264_demux: %i frames and %i mutations checked, %i failures\n",
+		frames, mutations, failed);
+
+	if(failed || frames == 0)
+		return 1;
+
+	/*check the memchr search too*/
+	if(simd->find_zero_pair != NULL && getenv("GUVCVIEW_NO_SIMD") == NULL)
+	{
+		char exe[PATH_MAX];
+		ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+		if(len <= 0)
+		{
+			fprintf(err_out, "check_h264_demux: couldn't find the executable path\n");
+			return 1;
+		}
+		exe[len] = '\0';
+
+		fflush(stdout);
+		setenv("GUVCVIEW_NO_SIMD", "1", 1);
+		execl(exe, exe, dir, (char *) NULL);
+		fprintf(err_out, "check_h264_demux: couldn't run without the vector kernels\n");
+		return 1;
+	}
+
+	return 0;
+}